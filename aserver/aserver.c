@@ -34,6 +34,9 @@
 #include <netdb.h>
 #include <limits.h>
 #include <signal.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 
 char *command;
@@ -54,6 +57,10 @@ char *command;
 
 #define SYSERROR(string) ERROR(string ": %s", strerror(errno))
 
+#ifdef HAVE_LIBPTHREAD
+static int threaded;		/* a worker thread per local client */
+#endif
+
 static int make_local_socket(const char *filename)
 {
 	size_t l = strlen(filename);
@@ -110,8 +117,19 @@ static int make_inet_socket(int port)
 	return sock;
 }
 
-struct pollfd *pollfds;
-unsigned int pollfds_count = 0;
+/*
+ * the waiters of the thread: the main loop's, or the ones of the client
+ * served by a worker thread
+ */
+#ifdef HAVE_LIBPTHREAD
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+THREAD_LOCAL struct pollfd *pollfds;
+THREAD_LOCAL unsigned int pollfds_count = 0;
+THREAD_LOCAL unsigned int waiters_size = 0;	/* entries of pollfds and waiters */
 typedef struct waiter waiter_t;
 typedef int (*waiter_handler_t)(waiter_t *waiter, unsigned short events);
 struct waiter {
@@ -119,13 +137,38 @@ struct waiter {
 	void *private_data;
 	waiter_handler_t handler;
 };
-waiter_t *waiters;
+THREAD_LOCAL waiter_t *waiters;
+
+/* a worker starts with no waiter, its arrays grow with the fds it sees */
+static void grow_waiters(int fd)
+{
+	unsigned int size = waiters_size ? waiters_size : 16;
+	struct pollfd *p;
+	waiter_t *w;
+
+	while (size <= (unsigned int)fd)
+		size *= 2;
+	p = realloc(pollfds, size * sizeof(*pollfds));
+	w = p ? realloc(waiters, size * sizeof(*waiters)) : NULL;
+	if (!w) {
+		ERROR("cannot allocate the waiters");
+		exit(1);
+	}
+	memset(w + waiters_size, 0, (size - waiters_size) * sizeof(*w));
+	pollfds = p;
+	waiters = w;
+	waiters_size = size;
+}
 
 static void add_waiter(int fd, unsigned short events, waiter_handler_t handler,
 		void *data)
 {
-	waiter_t *w = &waiters[fd];
-	struct pollfd *pfd = &pollfds[pollfds_count];
+	waiter_t *w;
+	struct pollfd *pfd;
+	if ((unsigned int)fd >= waiters_size)
+		grow_waiters(fd);
+	w = &waiters[fd];
+	pfd = &pollfds[pollfds_count];
 	assert(!w->handler);
 	pfd->fd = fd;
 	pfd->events = events;
@@ -148,7 +191,7 @@ static void del_waiter(int fd)
 	}
 	assert(k < pollfds_count);
 	pollfds_count--;
-	memmove(&pollfds[k], &pollfds[k + 1], pollfds_count - k);
+	memmove(&pollfds[k], &pollfds[k + 1], (pollfds_count - k) * sizeof(*pollfds));
 }
 
 typedef struct client client_t;
@@ -209,6 +252,31 @@ struct client {
 };
 
 LIST_HEAD(clients);
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void clients_add(client_t *client)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&clients_mutex);
+#endif
+	list_add_tail(&client->list, &clients);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&clients_mutex);
+#endif
+}
+
+static void clients_del(client_t *client)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&clients_mutex);
+#endif
+	list_del(&client->list);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&clients_mutex);
+#endif
+}
 
 typedef struct {
 	struct list_head list;
@@ -217,30 +285,83 @@ typedef struct {
 } inet_pending_t;
 LIST_HEAD(inet_pendings);
 
-#if 0
-static int pcm_handler(waiter_t *waiter, unsigned short events)
+/*
+ * publish the state of the PCM in the status block of protocol 2, the
+ * client reads it under the sequence count without a round trip
+ */
+static void pcm_shm_status_update(client_t *client)
 {
-	client_t *client = waiter->private_data;
-	char buf[1];
-	ssize_t n;
-	if (events & POLLIN) {
-		n = write(client->poll_fd, buf, 1);
-		if (n != 1) {
-			SYSERROR("write failed");
-			return -errno;
-		}
-	} else if (events & POLLOUT) {
-		n = read(client->poll_fd, buf, 1);
-		if (n != 1) {
-			SYSERROR("read failed");
-			return -errno;
+	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	volatile snd_pcm_shm_status_t *status = &ctrl->status;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_sframes_t avail = 0, delay = 0;
+	snd_pcm_uframes_t tavail;
+	snd_htimestamp_t tstamp = { 0, 0 };
+	snd_pcm_state_t state;
+	unsigned int seq;
+
+	state = snd_pcm_state(pcm);
+	switch (state) {
+	case SND_PCM_STATE_PREPARED:
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_DRAINING:
+	case SND_PCM_STATE_PAUSED:
+		avail = snd_pcm_avail_update(pcm);
+		if (avail < 0) {
+			avail = 0;
+			state = snd_pcm_state(pcm);
+			break;
 		}
+		if (snd_pcm_htimestamp(pcm, &tavail, &tstamp) >= 0)
+			avail = tavail;
+		if (snd_pcm_delay(pcm, &delay) < 0)
+			delay = 0;
+		break;
+	default:
+		break;
 	}
+
+	seq = status->seq;
+	__atomic_store_n(&status->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	status->state = state;
+	status->avail = avail;
+	status->delay = delay;
+	status->tstamp.tv_sec = tstamp.tv_sec;
+	status->tstamp.tv_nsec = tstamp.tv_nsec;
+	__atomic_store_n(&status->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * one shot: the status is refreshed once when the PCM becomes ready,
+ * the next command of the client arms the waiter again
+ */
+static int pcm_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+{
+	client_t *client = waiter->private_data;
+
 	del_waiter(waiter->fd);
 	client->polling = 0;
+	pcm_shm_status_update(client);
 	return 0;
 }
-#endif
+
+static void pcm_shm_poll_update(client_t *client)
+{
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_state_t state = snd_pcm_state(pcm);
+	int active = state == SND_PCM_STATE_RUNNING ||
+		     state == SND_PCM_STATE_DRAINING;
+
+	if (active && !client->polling) {
+		add_waiter(client->device.pcm.fd, pcm->poll_events,
+			   pcm_handler, client);
+		client->polling = 1;
+	} else if (!active && client->polling) {
+		del_waiter(client->device.pcm.fd);
+		client->polling = 0;
+	}
+}
 
 static void pcm_shm_hw_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UNUSED)
 {
@@ -310,6 +431,9 @@ static int pcm_shm_open(client_t *client, int *cookie)
 		SYSERROR("shmat failed");
 		goto _err;
 	}
+	((snd_pcm_shm_ctrl_t *)client->transport.shm.ctrl)->status.version =
+		SND_PCM_SHM_PROTOCOL_VERSION;
+	pcm_shm_status_update(client);
 	*cookie = shmid;
 	return 0;
 
@@ -381,6 +505,38 @@ static int shm_rbptr_fd(client_t *client, snd_pcm_rbptr_t *rbptr)
 	return shm_ack_fd(client, rbptr->fd);
 }
 
+/*
+ * The channel info of the ring the PCM really uses.  The info of an
+ * exported buffer, as returned by the plugin, only asks the client to
+ * allocate a private one: describe the area mapped here instead, a memfd
+ * as a mmap area whose descriptor goes over the socket, a SHM segment by
+ * its id.
+ */
+static int shm_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
+{
+	snd_pcm_channel_info_t *i;
+	int fd;
+
+	if (!pcm->mmap_channels || info->channel >= pcm->channels ||
+	    !pcm->mmap_channels[info->channel].addr)
+		return snd_pcm_channel_info(pcm, info);
+	i = &pcm->mmap_channels[info->channel];
+	*info = *i;
+	if (i->type != SND_PCM_AREA_SHM)
+		return 0;
+	fd = snd_shm_area_fd(i->u.shm.area);
+	if (fd >= 0) {
+		info->type = SND_PCM_AREA_MMAP;
+		info->u.mmap.fd = fd;
+		info->u.mmap.offset = 0;
+	} else {
+		if (i->u.shm.shmid < 0)
+			return -EINVAL;
+		info->u.shm.area = NULL;
+	}
+	return 0;
+}
+
 static void async_handler(snd_async_handler_t *handler)
 {
 	client_t *client = snd_async_handler_get_callback_private(handler);
@@ -467,7 +623,7 @@ static int pcm_shm_cmd(client_t *client)
 		ctrl->result = snd_pcm_pause(pcm, ctrl->u.pause.enable);
 		break;
 	case SNDRV_PCM_IOCTL_CHANNEL_INFO:
-		ctrl->result = snd_pcm_channel_info(pcm, (snd_pcm_channel_info_t *) &ctrl->u.channel_info);
+		ctrl->result = shm_channel_info(pcm, (snd_pcm_channel_info_t *) &ctrl->u.channel_info);
 		if (ctrl->result >= 0 &&
 		    ctrl->u.channel_info.type == SND_PCM_AREA_MMAP)
 			return shm_ack_fd(client, ctrl->u.channel_info.u.mmap.fd);
@@ -510,7 +666,7 @@ static int pcm_shm_cmd(client_t *client)
 		return shm_ack_fd(client, _snd_pcm_poll_descriptor(pcm));
 	case SND_PCM_IOCTL_CLOSE:
 		client->ops->close(client);
-		break;
+		return shm_ack(client);
 	case SND_PCM_IOCTL_HW_PTR_FD:
 		return shm_rbptr_fd(client, &pcm->hw);
 	case SND_PCM_IOCTL_APPL_PTR_FD:
@@ -519,6 +675,8 @@ static int pcm_shm_cmd(client_t *client)
 		ERROR("Bogus cmd: %x", ctrl->cmd);
 		ctrl->result = -ENOSYS;
 	}
+	pcm_shm_status_update(client);
+	pcm_shm_poll_update(client);
 	return shm_ack(client);
 }
 
@@ -809,7 +967,7 @@ static int client_poll_handler(waiter_t *waiter, unsigned short events ATTRIBUTE
 	close(client->ctrl_fd);
 	del_waiter(client->poll_fd);
 	del_waiter(client->ctrl_fd);
-	list_del(&client->list);
+	clients_del(client);
 	free(client);
 	return 0;
 }
@@ -822,7 +980,7 @@ static int client_ctrl_handler(waiter_t *waiter, unsigned short events)
 			client->ops->close(client);
 		close(client->ctrl_fd);
 		del_waiter(client->ctrl_fd);
-		list_del(&client->list);
+		clients_del(client);
 		free(client);
 		return 0;
 	}
@@ -876,7 +1034,7 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 	add_waiter(client->ctrl_fd, POLLIN | POLLHUP, client_ctrl_handler, client);
 	add_waiter(client->poll_fd, POLLHUP, client_poll_handler, client);
 	client->open = 0;
-	list_add_tail(&client->list, &clients);
+	clients_add(client);
 	list_del(&pending->list);
 	list_del(&pdata->list);
 	free(pending);
@@ -884,6 +1042,90 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 	return 0;
 }
 
+/*
+ * wait for the waiters of the thread and run the handlers of the ready
+ * ones, pfds has room for all the waiters
+ */
+static void poll_waiters(struct pollfd *pfds)
+{
+	unsigned int k, pfds_count;
+	int err;
+
+	do {
+		err = poll(pollfds, pollfds_count, -1);
+	} while (err == 0);
+	if (err < 0) {
+		SYSERROR("poll failed");
+		return;
+	}
+
+	pfds_count = pollfds_count;
+	memcpy(pfds, pollfds, sizeof(*pfds) * pfds_count);
+	for (k = 0; k < pfds_count; k++) {
+		struct pollfd *pfd = &pfds[k];
+		if (pfd->revents) {
+			waiter_t *w = &waiters[pfd->fd];
+			if (!w->handler)
+				continue;
+			err = w->handler(w, pfd->revents);
+			if (err < 0)
+				ERROR("waiter handler failed");
+		}
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * serve a single client until it hangs up: a slow command of the client,
+ * e.g. a blocking drain, doesn't hold the other clients anymore
+ */
+static void *client_worker(void *arg)
+{
+	client_t *client = arg;
+	struct pollfd *pfds = NULL;
+	unsigned int pfds_size = 0;
+
+	add_waiter(client->ctrl_fd, POLLIN | POLLHUP, client_ctrl_handler, client);
+	/* the client is freed with its last waiter */
+	while (pollfds_count > 0) {
+		if (pfds_size < waiters_size) {
+			free(pfds);
+			pfds_size = waiters_size;
+			pfds = malloc(pfds_size * sizeof(*pfds));
+			if (!pfds) {
+				ERROR("cannot allocate the poll descriptors");
+				exit(1);
+			}
+		}
+		poll_waiters(pfds);
+	}
+	free(pfds);
+	free(pollfds);
+	free(waiters);
+	return NULL;
+}
+
+static int start_worker(client_t *client)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&thread, &attr, client_worker, client);
+	pthread_attr_destroy(&attr);
+	if (err) {
+		ERROR("cannot create a worker thread: %s", strerror(err));
+		close(client->ctrl_fd);
+		clients_del(client);
+		free(client);
+		return -err;
+	}
+	return 0;
+}
+#endif
+
 static int local_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
 {
 	int sock;
@@ -897,8 +1139,12 @@ static int local_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSE
 		client->ctrl_fd = sock;
 		client->local = 1;
 		client->open = 0;
+		clients_add(client);
+#ifdef HAVE_LIBPTHREAD
+		if (threaded)
+			return start_worker(client);
+#endif
 		add_waiter(sock, POLLIN | POLLHUP, client_ctrl_handler, client);
-		list_add_tail(&client->list, &clients);
 	}
 	return 0;
 }
@@ -923,8 +1169,7 @@ static int inet_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED
 
 static int server(const char *sockname, int port)
 {
-	int err, result, sockn = -1, socki = -1;
-	unsigned int k;
+	int result, sockn = -1, socki = -1;
 	long open_max;
 
 	if (!sockname && port < 0)
@@ -937,6 +1182,7 @@ static int server(const char *sockname, int port)
 	}
 	pollfds = calloc((size_t) open_max, sizeof(*pollfds));
 	waiters = calloc((size_t) open_max, sizeof(*waiters));
+	waiters_size = open_max;
 
 	if (sockname) {
 		sockn = make_local_socket(sockname);
@@ -973,28 +1219,7 @@ static int server(const char *sockname, int port)
 
 	while (1) {
 		struct pollfd pfds[open_max];
-		size_t pfds_count;
-		do {
-			err = poll(pollfds, pollfds_count, -1);
-		} while (err == 0);
-		if (err < 0) {
-			SYSERROR("poll failed");
-			continue;
-		}
-
-		pfds_count = pollfds_count;
-		memcpy(pfds, pollfds, sizeof(*pfds) * pfds_count);
-		for (k = 0; k < pfds_count; k++) {
-			struct pollfd *pfd = &pfds[k];
-			if (pfd->revents) {
-				waiter_t *w = &waiters[pfd->fd];
-				if (!w->handler)
-					continue;
-				err = w->handler(w, pfd->revents);
-				if (err < 0)
-					ERROR("waiter handler failed");
-			}
-		}
+		poll_waiters(pfds);
 	}
  _end:
 	if (sockn >= 0)
@@ -1011,7 +1236,11 @@ static void usage(void)
 {
 	fprintf(stderr,
 		"Usage: %s [OPTIONS] server\n"
-		"--help			help\n",
+		"--help			help\n"
+#ifdef HAVE_LIBPTHREAD
+		"--threads		serve each local client in its own thread\n"
+#endif
+		,
 		command);
 }
 
@@ -1019,6 +1248,9 @@ int main(int argc, char **argv)
 {
 	static const struct option long_options[] = {
 		{"help", 0, 0, 'h'},
+#ifdef HAVE_LIBPTHREAD
+		{"threads", 0, 0, 't'},
+#endif
 		{ 0 , 0 , 0, 0 }
 	};
 	int c;
@@ -1030,11 +1262,16 @@ int main(int argc, char **argv)
 	char *srvname;
 
 	command = argv[0];
-	while ((c = getopt_long(argc, argv, "h", long_options, 0)) != -1) {
+	while ((c = getopt_long(argc, argv, "ht", long_options, 0)) != -1) {
 		switch (c) {
 		case 'h':
 			usage();
 			return 0;
+#ifdef HAVE_LIBPTHREAD
+		case 't':
+			threaded = 1;
+			break;
+#endif
 		default:
 			fprintf(stderr, "Try `%s --help' for more information\n", command);
 			return 1;
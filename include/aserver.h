@@ -58,6 +58,25 @@ typedef struct {
 	int changed;
 } snd_pcm_shm_rbptr_t;
 
+/*
+ * Protocol 2: the server publishes the state, avail, delay and timestamp
+ * of the PCM in the status block after every command and on the wakeups
+ * of its poll descriptor, the client reads them without a round trip.
+ * seq is odd while the server is updating the block.  The block is kept
+ * at the end of the control area, with a server speaking protocol 1 the
+ * version reads as zero.
+ */
+#define SND_PCM_SHM_PROTOCOL_VERSION	2
+
+typedef struct {
+	unsigned int seq;
+	unsigned int version;
+	snd_pcm_state_t state;
+	snd_pcm_uframes_t avail;
+	snd_pcm_sframes_t delay;
+	snd_htimestamp_t tstamp;
+} snd_pcm_shm_status_t;
+
 typedef struct {
 	long result;
 	int cmd;
@@ -102,6 +121,7 @@ typedef struct {
 			off_t offset;
 		} rbptr;
 	} u;
+	snd_pcm_shm_status_t status;
 	char data[0];
 } snd_pcm_shm_ctrl_t;
 
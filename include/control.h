@@ -351,6 +351,8 @@ typedef enum _snd_ctl_type {
 	SND_CTL_TYPE_EXT,
 	/** Control functionality remapping */
 	SND_CTL_TYPE_REMAP,
+	/** Shared value cache */
+	SND_CTL_TYPE_CACHE,
 } snd_ctl_type_t;
 
 /** Non blocking mode (flag for open mode) \hideinitializer */
@@ -388,6 +390,8 @@ int snd_ctl_nonblock(snd_ctl_t *ctl, int nonblock);
 static __inline__ int snd_ctl_abort(snd_ctl_t *ctl) { return snd_ctl_nonblock(ctl, 2); }
 int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl, 
 			      snd_async_callback_t callback, void *private_data);
+int snd_async_add_ctl_thread_handler(snd_async_handler_t **handler, snd_ctl_t *ctl,
+				     snd_async_callback_t callback, void *private_data);
 snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler);
 int snd_ctl_poll_descriptors_count(snd_ctl_t *ctl);
 int snd_ctl_poll_descriptors(snd_ctl_t *ctl, struct pollfd *pfds, unsigned int space);
@@ -398,6 +402,12 @@ int snd_ctl_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list);
 int snd_ctl_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info);
 int snd_ctl_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *data);
 int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data);
+int snd_ctl_elem_info_batch(snd_ctl_t *ctl, snd_ctl_elem_info_t **infos,
+			    unsigned int count);
+int snd_ctl_elem_read_batch(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			    unsigned int count);
+int snd_ctl_elem_write_batch(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			     unsigned int count);
 int snd_ctl_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_unlock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_tlv_read(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
@@ -429,6 +439,10 @@ int snd_ctl_set_power_state(snd_ctl_t *ctl, unsigned int state);
 int snd_ctl_get_power_state(snd_ctl_t *ctl, unsigned int *state);
 
 int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event);
+int snd_ctl_read_events(snd_ctl_t *ctl, snd_ctl_event_t **events,
+			unsigned int count);
+int snd_ctl_read_values(snd_ctl_t *ctl, snd_ctl_event_t **events,
+			snd_ctl_elem_value_t **values, unsigned int count);
 int snd_ctl_wait(snd_ctl_t *ctl, int timeout);
 const char *snd_ctl_name(snd_ctl_t *ctl);
 snd_ctl_type_t snd_ctl_type(snd_ctl_t *ctl);
@@ -687,6 +701,18 @@ int snd_tlv_convert_to_dB(unsigned int *tlv, long rangemin, long rangemax,
 			  long volume, long *db_gain);
 int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 			    long db_gain, long *value, int xdir);
+
+/** Pre-parsed dB TLV for the array conversions */
+typedef struct _snd_tlv_dB snd_tlv_dB_t;
+
+int snd_tlv_dB_open(snd_tlv_dB_t **dbp, unsigned int *tlv,
+		    long rangemin, long rangemax);
+int snd_tlv_dB_close(snd_tlv_dB_t *db);
+int snd_tlv_convert_to_dB_array(const snd_tlv_dB_t *db, const long *volume,
+				long *db_gain, unsigned int count);
+int snd_tlv_convert_from_dB_array(const snd_tlv_dB_t *db, const long *db_gain,
+				  long *value, unsigned int count, int xdir);
+
 int snd_ctl_get_dB_range(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 			 long *min, long *max);
 int snd_ctl_convert_to_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
@@ -747,6 +773,8 @@ int snd_hctl_poll_descriptors(snd_hctl_t *hctl, struct pollfd *pfds, unsigned in
 int snd_hctl_poll_descriptors_revents(snd_hctl_t *ctl, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
 unsigned int snd_hctl_get_count(snd_hctl_t *hctl);
 int snd_hctl_set_compare(snd_hctl_t *hctl, snd_hctl_compare_t hsort);
+int snd_hctl_set_cache(snd_hctl_t *hctl, int enable);
+int snd_hctl_set_coalesce(snd_hctl_t *hctl, int enable);
 snd_hctl_elem_t *snd_hctl_first_elem(snd_hctl_t *hctl);
 snd_hctl_elem_t *snd_hctl_last_elem(snd_hctl_t *hctl);
 snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id);
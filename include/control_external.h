@@ -77,7 +77,7 @@ typedef int (snd_ctl_ext_tlv_rw_t)(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key, in
  */
 #define SND_CTL_EXT_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_CTL_EXT_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_CTL_EXT_VERSION_TINY	1	/**< Protocol tiny version */
+#define SND_CTL_EXT_VERSION_TINY	2	/**< Protocol tiny version */
 /**
  * external plugin protocol version
  */
@@ -254,6 +254,19 @@ struct snd_ctl_ext_callback {
 	 * mangle the revents of poll descriptors
 	 */
 	int (*poll_revents)(snd_ctl_ext_t *ext, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+	/**
+	 * fetch the attributes of several elements before their info is
+	 * queried; optional (since protocol 1.0.2)
+	 */
+	int (*prefetch_info)(snd_ctl_ext_t *ext, const snd_ctl_elem_id_t **ids, unsigned int count);
+	/**
+	 * read the current values of several elements; optional (since protocol 1.0.2)
+	 */
+	int (*read_elems)(snd_ctl_ext_t *ext, snd_ctl_elem_value_t **values, unsigned int count);
+	/**
+	 * update the current values of several elements; optional (since protocol 1.0.2)
+	 */
+	int (*write_elems)(snd_ctl_ext_t *ext, snd_ctl_elem_value_t **values, unsigned int count);
 };
 
 /**
@@ -126,6 +126,8 @@ typedef void (*snd_async_callback_t)(snd_async_handler_t *handler);
 
 int snd_async_add_handler(snd_async_handler_t **handler, int fd, 
 			  snd_async_callback_t callback, void *private_data);
+int snd_async_add_thread_handler(snd_async_handler_t **handler, int fd, short events,
+				 snd_async_callback_t callback, void *private_data);
 int snd_async_del_handler(snd_async_handler_t *handler);
 int snd_async_handler_get_fd(snd_async_handler_t *handler);
 int snd_async_handler_get_signo(snd_async_handler_t *handler);
@@ -111,6 +111,8 @@ typedef enum _snd_hwdep_type {
 /** HwDep handle */
 typedef struct _snd_hwdep snd_hwdep_t;
 
+struct iovec;
+
 int snd_hwdep_open(snd_hwdep_t **hwdep, const char *name, int mode);
 int snd_hwdep_close(snd_hwdep_t *hwdep);
 int snd_hwdep_poll_descriptors(snd_hwdep_t *hwdep, struct pollfd *pfds, unsigned int space);
@@ -123,6 +125,10 @@ int snd_hwdep_dsp_load(snd_hwdep_t *hwdep, snd_hwdep_dsp_image_t *block);
 int snd_hwdep_ioctl(snd_hwdep_t *hwdep, unsigned int request, void * arg);
 ssize_t snd_hwdep_write(snd_hwdep_t *hwdep, const void *buffer, size_t size);
 ssize_t snd_hwdep_read(snd_hwdep_t *hwdep, void *buffer, size_t size);
+ssize_t snd_hwdep_writev(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt);
+ssize_t snd_hwdep_readv(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt);
+int snd_hwdep_mmap(snd_hwdep_t *hwdep, size_t size, void **ptr);
+int snd_hwdep_munmap(snd_hwdep_t *hwdep, void *ptr, size_t size);
 
 size_t snd_hwdep_info_sizeof(void);
 /** allocate #snd_hwdep_info_t container on stack */
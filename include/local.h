@@ -243,14 +243,23 @@ struct _snd_async_handler {
 	void *private_data;
 	struct list_head glist;
 	struct list_head hlist;
+	struct snd_async_thread *thread;	/* NULL for the signal handlers */
 };
 
+int _snd_async_add_thread_handler(snd_async_handler_t **handler, int type, void *obj,
+				  struct list_head *alist, snd_async_callback_t callback,
+				  void *private_data);
+int _snd_async_signal_used(struct list_head *alist);
+
 typedef enum _snd_set_mode {
 	SND_CHANGE,
 	SND_TRY,
 	SND_TEST,
 } snd_set_mode_t;
 
+struct snd_shm_area *snd_shm_area_create_memfd(size_t size, void **ptr);
+int snd_shm_area_fd(struct snd_shm_area *area);
+
 size_t page_align(size_t size);
 size_t page_size(void);
 size_t page_ptr(size_t object_offset, size_t object_size, size_t *offset, size_t *mmap_offset);
@@ -366,6 +375,12 @@ static inline int snd_open_device(const char *filename, int fmode)
 	snd1_dlobj_cache_put
 #define snd_dlobj_cache_cleanup \
 	snd1_dlobj_cache_cleanup
+#define snd_coef_cache_get \
+	snd1_coef_cache_get
+#define snd_coef_cache_put \
+	snd1_coef_cache_put
+#define snd_coef_cache_cleanup \
+	snd1_coef_cache_cleanup
 #define snd_config_set_hop \
 	snd1_config_set_hop
 #define snd_config_check_hop \
@@ -379,6 +394,14 @@ void *snd_dlobj_cache_get2(const char *lib, const char *name, const char *versio
 int snd_dlobj_cache_put(void *open_func);
 void snd_dlobj_cache_cleanup(void);
 
+/* rate converter coefficient cache */
+void *snd_coef_cache_get(const char *converter, unsigned int in_rate,
+			 unsigned int out_rate, unsigned int quality,
+			 void *(*create)(void *arg),
+			 void (*destroy)(void *data), void *arg);
+int snd_coef_cache_put(void *data);
+void snd_coef_cache_cleanup(void);
+
 /* for recursive checks */
 void snd_config_set_hop(snd_config_t *conf, int hop);
 int snd_config_check_hop(snd_config_t *conf);
@@ -391,7 +414,24 @@ int snd_config_search_alias_hooks(snd_config_t *config,
 int _snd_conf_generic_id(const char *id);
 
 int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
-				  int override, const char * const *default_include_path);
+				  int override, const char * const *default_include_path,
+				  unsigned int *includes);
+int _snd_config_cache_encode(snd_config_t *top, void **data, size_t *size);
+int _snd_config_cache_decode(snd_config_t *top, const void *data, size_t size);
+size_t _snd_input_read(snd_input_t *input, void *buf, size_t size);
+int _snd_card_info(int card, snd_ctl_card_info_t *info);
+void _snd_card_info_prefetch(void);
+void _snd_device_name_hint_cache_free(void);
+void _snd_pcm_open_cache_free(void);
+
+typedef struct _snd_config_deps snd_config_deps_t;
+snd_config_deps_t *_snd_config_deps_start(void);
+int _snd_config_deps_stop(snd_config_deps_t *deps);
+int _snd_config_deps_check(const snd_config_deps_t *deps);
+void _snd_config_deps_free(snd_config_deps_t *deps);
+void _snd_config_dep_volatile(void);
+void _snd_config_dep_env(const char *var, const char *value);
+void _snd_config_dep_cards(void);
 
 /* convenience macros */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
@@ -114,6 +114,9 @@ int snd_mixer_poll_descriptors(snd_mixer_t *mixer, struct pollfd *pfds, unsigned
 int snd_mixer_poll_descriptors_revents(snd_mixer_t *mixer, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
 int snd_mixer_load(snd_mixer_t *mixer);
 void snd_mixer_free(snd_mixer_t *mixer);
+int snd_mixer_set_epoll(snd_mixer_t *mixer, int enable);
+int snd_mixer_begin(snd_mixer_t *mixer);
+int snd_mixer_commit(snd_mixer_t *mixer);
 int snd_mixer_wait(snd_mixer_t *mixer, int timeout);
 int snd_mixer_set_compare(snd_mixer_t *mixer, snd_mixer_compare_t msort);
 void snd_mixer_set_callback(snd_mixer_t *obj, snd_mixer_callback_t val);
@@ -144,6 +147,10 @@ int snd_mixer_elem_attach(snd_mixer_elem_t *melem, snd_hctl_elem_t *helem);
 int snd_mixer_elem_detach(snd_mixer_elem_t *melem, snd_hctl_elem_t *helem);
 int snd_mixer_elem_empty(snd_mixer_elem_t *melem);
 void *snd_mixer_elem_get_private(const snd_mixer_elem_t *melem);
+int snd_mixer_elem_read_ctl(snd_mixer_elem_t *melem, snd_hctl_elem_t *helem,
+			    snd_ctl_elem_value_t *value);
+int snd_mixer_elem_write_ctl(snd_mixer_elem_t *melem, snd_hctl_elem_t *helem,
+			     snd_ctl_elem_value_t *value);
 
 size_t snd_mixer_class_sizeof(void);
 /** \hideinitializer
@@ -72,6 +72,8 @@ int snd_output_stdio_attach(snd_output_t **outputp, FILE *fp, int _close);
 int snd_output_buffer_open(snd_output_t **outputp);
 size_t snd_output_buffer_string(snd_output_t *output, char **buf);
 size_t snd_output_buffer_steal(snd_output_t *output, char **buf);
+int snd_output_buffer_reserve(snd_output_t *output, size_t size);
+int snd_output_buffer_open_ring(snd_output_t **outputp, size_t size);
 int snd_output_close(snd_output_t *output);
 int snd_output_printf(snd_output_t *output, const char *format, ...)
 #ifndef DOC_HIDDEN
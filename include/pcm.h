@@ -545,6 +545,8 @@ int snd_pcm_nonblock(snd_pcm_t *pcm, int nonblock);
 static __inline__ int snd_pcm_abort(snd_pcm_t *pcm) { return snd_pcm_nonblock(pcm, 2); }
 int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm, 
 			      snd_async_callback_t callback, void *private_data);
+int snd_async_add_pcm_thread_handler(snd_async_handler_t **handler, snd_pcm_t *pcm,
+				     snd_async_callback_t callback, void *private_data);
 snd_pcm_t *snd_async_handler_get_pcm(snd_async_handler_t *handler);
 int snd_pcm_info(snd_pcm_t *pcm, snd_pcm_info_t *info);
 int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
@@ -555,6 +557,7 @@ int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_prepare(snd_pcm_t *pcm);
 int snd_pcm_reset(snd_pcm_t *pcm);
 int snd_pcm_status(snd_pcm_t *pcm, snd_pcm_status_t *status);
+int snd_pcm_status_fast(snd_pcm_t *pcm, snd_pcm_status_t *status);
 int snd_pcm_start(snd_pcm_t *pcm);
 int snd_pcm_drop(snd_pcm_t *pcm);
 int snd_pcm_drain(snd_pcm_t *pcm);
@@ -580,6 +583,20 @@ int snd_pcm_wait(snd_pcm_t *pcm, int timeout);
 int snd_pcm_link(snd_pcm_t *pcm1, snd_pcm_t *pcm2);
 int snd_pcm_unlink(snd_pcm_t *pcm);
 
+/** Prefault mode of the PCM buffers, see #snd_pcm_set_prefault() */
+typedef enum _snd_pcm_prefault {
+	/** fault the buffer pages in lazily, on first access */
+	SND_PCM_PREFAULT_NONE = 0,
+	/** touch all the buffer pages at prepare */
+	SND_PCM_PREFAULT_TOUCH,
+	/** touch and lock all the buffer pages in memory at prepare */
+	SND_PCM_PREFAULT_LOCK,
+	SND_PCM_PREFAULT_LAST = SND_PCM_PREFAULT_LOCK
+} snd_pcm_prefault_t;
+
+int snd_pcm_set_prefault(snd_pcm_t *pcm, snd_pcm_prefault_t mode);
+snd_pcm_prefault_t snd_pcm_get_prefault(snd_pcm_t *pcm);
+
 /** channel mapping API version number */
 #define SND_CHMAP_API_VERSION	((1 << 16) | (0 << 8) | 1)
 
@@ -915,6 +932,11 @@ int snd_pcm_hw_params_set_buffer_size_last(snd_pcm_t *pcm, snd_pcm_hw_params_t *
 #endif /* !ALSA_LIBRARY_BUILD && !ALSA_PCM_OLD_HW_PARAMS_API */
 
 int snd_pcm_hw_params_get_min_align(const snd_pcm_hw_params_t *params, snd_pcm_uframes_t *val);
+int snd_pcm_hw_params_set_batch(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+				snd_pcm_access_t access, snd_pcm_format_t format,
+				unsigned int channels, unsigned int *rate,
+				snd_pcm_uframes_t *period_size,
+				snd_pcm_uframes_t *buffer_size);
 
 /** \} */
 
@@ -946,6 +968,8 @@ int snd_pcm_sw_params_set_avail_min(snd_pcm_t *pcm, snd_pcm_sw_params_t *params,
 int snd_pcm_sw_params_get_avail_min(const snd_pcm_sw_params_t *params, snd_pcm_uframes_t *val);
 int snd_pcm_sw_params_set_period_event(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, int val);
 int snd_pcm_sw_params_get_period_event(const snd_pcm_sw_params_t *params, int *val);
+int snd_pcm_sw_params_set_timer_wakeup(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, int val);
+int snd_pcm_sw_params_get_timer_wakeup(const snd_pcm_sw_params_t *params, int *val);
 int snd_pcm_sw_params_set_start_threshold(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, snd_pcm_uframes_t val);
 int snd_pcm_sw_params_get_start_threshold(const snd_pcm_sw_params_t *paramsm, snd_pcm_uframes_t *val);
 int snd_pcm_sw_params_set_stop_threshold(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, snd_pcm_uframes_t val);
@@ -1130,6 +1154,19 @@ int snd_pcm_hw_params_dump(snd_pcm_hw_params_t *params, snd_output_t *out);
 int snd_pcm_sw_params_dump(snd_pcm_sw_params_t *params, snd_output_t *out);
 int snd_pcm_status_dump(snd_pcm_status_t *status, snd_output_t *out);
 
+/** Profiling counters of one stage of a PCM plugin chain */
+typedef struct _snd_pcm_stage_stats {
+	const char *name;		/**< PCM name of the stage, may be NULL */
+	snd_pcm_type_t type;		/**< PCM type of the stage */
+	unsigned long long calls;	/**< number of processed blocks */
+	unsigned long long frames;	/**< processed frames */
+	unsigned long long nsec;	/**< time spent in the stage in nsec */
+	unsigned long long max_nsec;	/**< longest processing of a block in nsec */
+} snd_pcm_stage_stats_t;
+
+int snd_pcm_get_stage_stats(snd_pcm_t *pcm, snd_pcm_stage_stats_t *stats,
+			    unsigned int count);
+
 /** \} */
 
 /**
@@ -1143,6 +1180,11 @@ int snd_pcm_mmap_begin(snd_pcm_t *pcm,
 		       const snd_pcm_channel_area_t **areas,
 		       snd_pcm_uframes_t *offset,
 		       snd_pcm_uframes_t *frames);
+int snd_pcm_mmap_begin2(snd_pcm_t *pcm,
+			const snd_pcm_channel_area_t **areas,
+			snd_pcm_uframes_t *offset,
+			snd_pcm_uframes_t *frames,
+			snd_pcm_uframes_t *frames2);
 snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 				      snd_pcm_uframes_t offset,
 				      snd_pcm_uframes_t frames);
@@ -1313,6 +1355,146 @@ int snd_pcm_scope_s16_open(snd_pcm_t *pcm, const char *name,
 			   snd_pcm_scope_t **scopep);
 int16_t *snd_pcm_scope_s16_get_channel_buffer(snd_pcm_scope_t *scope,
 					      unsigned int channel);
+int snd_pcm_scope_loudness_open(snd_pcm_t *pcm, const char *name,
+				snd_pcm_scope_t **scopep);
+int snd_pcm_scope_loudness_get_levels(snd_pcm_scope_t *scope,
+				      unsigned int channel,
+				      double *peak, double *rms);
+int snd_pcm_scope_loudness_get_lufs(snd_pcm_scope_t *scope,
+				    double *momentary, double *short_term,
+				    double *integrated);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Submit Submission queue
+ * \ingroup PCM
+ * See the \ref pcm_submit page for more details.
+ * \{
+ */
+
+/** PCM submission queue handle */
+typedef struct _snd_pcm_submit snd_pcm_submit_t;
+
+/** do not use io_uring, wait with a single poll() */
+#define SND_PCM_SUBMIT_NO_URING		0x00000001
+
+int snd_pcm_submit_open(snd_pcm_submit_t **subp, unsigned int entries, int flags);
+int snd_pcm_submit_close(snd_pcm_submit_t *sub);
+int snd_pcm_submit_writei(snd_pcm_submit_t *sub, snd_pcm_t *pcm,
+			  const void *buffer, snd_pcm_uframes_t size);
+int snd_pcm_submit_readi(snd_pcm_submit_t *sub, snd_pcm_t *pcm,
+			 void *buffer, snd_pcm_uframes_t size);
+int snd_pcm_submit_poll(snd_pcm_submit_t *sub, snd_pcm_t *pcm);
+int snd_pcm_submit_run(snd_pcm_submit_t *sub, int timeout);
+snd_pcm_sframes_t snd_pcm_submit_result(snd_pcm_submit_t *sub, unsigned int index);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Wakeup Wakeup groups
+ * \ingroup PCM
+ * See the \ref pcm_wakeup page for more details.
+ * \{
+ */
+
+/** PCM wakeup group handle */
+typedef struct _snd_pcm_wakeup_group snd_pcm_wakeup_group_t;
+
+int snd_pcm_wakeup_group_open(snd_pcm_wakeup_group_t **groupp);
+int snd_pcm_wakeup_group_close(snd_pcm_wakeup_group_t *group);
+int snd_pcm_wakeup_group_add(snd_pcm_wakeup_group_t *group, snd_pcm_t *pcm);
+int snd_pcm_wakeup_group_remove(snd_pcm_wakeup_group_t *group, snd_pcm_t *pcm);
+int snd_pcm_wakeup_group_poll_descriptors(snd_pcm_wakeup_group_t *group,
+					  struct pollfd *pfds, unsigned int space);
+int snd_pcm_wakeup_group_ready(snd_pcm_wakeup_group_t *group,
+			       snd_pcm_t **pcms, unsigned int space);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Pool Handle pools
+ * \ingroup PCM
+ * See the \ref pcm_pool page for more details.
+ * \{
+ */
+
+/** PCM handle pool */
+typedef struct _snd_pcm_pool snd_pcm_pool_t;
+
+int snd_pcm_pool_open(snd_pcm_pool_t **poolp, unsigned int max_idle);
+int snd_pcm_pool_close(snd_pcm_pool_t *pool);
+int snd_pcm_pool_flush(snd_pcm_pool_t *pool);
+int snd_pcm_pool_get(snd_pcm_pool_t *pool, snd_pcm_t **pcmp, const char *name,
+		     snd_pcm_stream_t stream, int mode,
+		     snd_pcm_format_t format, snd_pcm_access_t access,
+		     unsigned int channels, unsigned int rate,
+		     int soft_resample, unsigned int latency);
+int snd_pcm_pool_put(snd_pcm_pool_t *pool, snd_pcm_t *pcm);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Start_Group Start groups
+ * \ingroup PCM
+ * See the \ref pcm_start_group page for more details.
+ * \{
+ */
+
+/** PCM start group handle */
+typedef struct _snd_pcm_start_group snd_pcm_start_group_t;
+
+int snd_pcm_start_group_open(snd_pcm_start_group_t **groupp);
+int snd_pcm_start_group_close(snd_pcm_start_group_t *group);
+int snd_pcm_start_group_add(snd_pcm_start_group_t *group, snd_pcm_t *pcm);
+int snd_pcm_start_group_remove(snd_pcm_start_group_t *group, snd_pcm_t *pcm);
+int snd_pcm_start_group_prepare(snd_pcm_start_group_t *group);
+int snd_pcm_start_group_start(snd_pcm_start_group_t *group, snd_htimestamp_t *skew);
+int snd_pcm_start_group_drop(snd_pcm_start_group_t *group);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Probe Latency probes
+ * \ingroup PCM
+ * See the \ref pcm_probe page for more details.
+ * \{
+ */
+
+/** PCM latency probe */
+typedef struct _snd_pcm_latency_probe snd_pcm_latency_probe_t;
+
+/** Value measured by a latency probe */
+typedef enum _snd_pcm_latency_probe_metric {
+	/** lateness of the wakeup after avail_min */
+	SND_PCM_LATENCY_PROBE_SCHED = 0,
+	/** queued audio */
+	SND_PCM_LATENCY_PROBE_FILL,
+	/** interval between the wakeups minus the period time */
+	SND_PCM_LATENCY_PROBE_JITTER,
+	/** audio time minus system time since the start */
+	SND_PCM_LATENCY_PROBE_DRIFT,
+	SND_PCM_LATENCY_PROBE_LAST = SND_PCM_LATENCY_PROBE_DRIFT
+} snd_pcm_latency_probe_metric_t;
+
+/** Number of the histogram buckets of a latency probe */
+#define SND_PCM_LATENCY_PROBE_BUCKETS	24
+
+int snd_pcm_latency_probe_open(snd_pcm_latency_probe_t **probep, snd_pcm_t *pcm);
+int snd_pcm_latency_probe_close(snd_pcm_latency_probe_t *probe);
+void snd_pcm_latency_probe_reset(snd_pcm_latency_probe_t *probe);
+int snd_pcm_latency_probe_update(snd_pcm_latency_probe_t *probe,
+				 const snd_pcm_status_t *status);
+int snd_pcm_latency_probe_stats(const snd_pcm_latency_probe_t *probe,
+				snd_pcm_latency_probe_metric_t metric,
+				unsigned long *count, long *min, long *max,
+				long *mean);
+int snd_pcm_latency_probe_histogram(const snd_pcm_latency_probe_t *probe,
+				    snd_pcm_latency_probe_metric_t metric,
+				    unsigned long *buckets, unsigned int nbuckets);
+long snd_pcm_latency_probe_percentile(const snd_pcm_latency_probe_t *probe,
+				      snd_pcm_latency_probe_metric_t metric,
+				      unsigned int percent);
 
 /** \} */
 
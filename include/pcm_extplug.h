@@ -65,7 +65,7 @@ typedef snd_pcm_extplug_callback snd_pcm_extplug_callback_t;
  */
 #define SND_PCM_EXTPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_EXTPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_EXTPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_EXTPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * Filter-plugin protocol version
  */
@@ -128,6 +128,23 @@ struct snd_pcm_extplug {
 	 * slave_channels hw parameter; filled after hw_params is caled
 	 */
 	unsigned int slave_channels;
+	/**
+	 * preferred transfer block size in frames; optional, since v1.0.3.
+	 * Set before calling #snd_pcm_extplug_create() or in the hw_params
+	 * callback.  When non-zero, the transfer callback is always called
+	 * with exactly this many frames, at the cost of one block of latency
+	 */
+	snd_pcm_uframes_t block_size;
+	/**
+	 * alignment in bytes of the block buffers passed to the transfer
+	 * callback; a power of two or zero for the default; since v1.0.3
+	 */
+	unsigned int block_align;
+	/**
+	 * latency added by the block accumulation in frames; read-only,
+	 * filled after hw_params is called; since v1.0.3
+	 */
+	snd_pcm_uframes_t delay;
 };
 
 /** Callback table of extplug */
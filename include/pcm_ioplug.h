@@ -72,13 +72,17 @@ typedef snd_pcm_ioplug_callback snd_pcm_ioplug_callback_t;
 #define SND_PCM_IOPLUG_FLAG_MONOTONIC	(1<<1)		/**< monotonic timestamps */
 /** hw pointer wrap around at boundary instead of buffer_size */
 #define SND_PCM_IOPLUG_FLAG_BOUNDARY_WA	(1<<2)
+/** PCM buffer is mapped from mmap_fd at mmap_offset; since v1.0.3 */
+#define SND_PCM_IOPLUG_FLAG_SHARED_BUFFER	(1<<3)
+/** position is published via #snd_pcm_ioplug_publish_pointer(); since v1.0.3 */
+#define SND_PCM_IOPLUG_FLAG_PUBLISHED_POINTER	(1<<4)
 
 /*
  * Protocol version
  */
 #define SND_PCM_IOPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_IOPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_IOPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_IOPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * IO-plugin protocol version
  */
@@ -126,6 +130,17 @@ struct snd_pcm_ioplug {
 	unsigned int rate;		/**< rate; filled after hw_params is called */
 	snd_pcm_uframes_t period_size;	/**< period size; filled after hw_params is called */
 	snd_pcm_uframes_t buffer_size;	/**< buffer size; filled after hw_params is called */
+
+	/**
+	 * descriptor of the shared ring buffer (e.g. a memfd) used as the PCM
+	 * buffer with #SND_PCM_IOPLUG_FLAG_SHARED_BUFFER; must be valid when
+	 * the hw_params callback returns; since v1.0.3
+	 */
+	int mmap_fd;
+	/**
+	 * page aligned offset of the ring buffer in mmap_fd; since v1.0.3
+	 */
+	off_t mmap_offset;
 };
 
 /** Callback table of ioplug */
@@ -139,7 +154,8 @@ struct snd_pcm_ioplug_callback {
 	 */
 	int (*stop)(snd_pcm_ioplug_t *io);
 	/**
-	 * get the current DMA position; required, called inside mutex lock
+	 * get the current DMA position; required unless
+	 * #SND_PCM_IOPLUG_FLAG_PUBLISHED_POINTER is set, called inside mutex lock
 	 * \return buffer position up to buffer_size or
 	 * when #SND_PCM_IOPLUG_FLAG_BOUNDARY_WA flag is set up to boundary or
 	 * a negative error code for Xrun
@@ -216,6 +232,14 @@ struct snd_pcm_ioplug_callback {
 	 * set the channel map; optional; since v1.0.2
 	 */
 	int (*set_chmap)(snd_pcm_ioplug_t *io, const snd_pcm_chmap_t *map);
+	/**
+	 * take back frames passed to the transfer callback (playback);
+	 * optional, called inside mutex lock before the application pointer
+	 * moves; since v1.0.3
+	 * \return the number of the latest frames dropped, up to the given
+	 * count, or a negative error code
+	 */
+	snd_pcm_sframes_t (*rewind)(snd_pcm_ioplug_t *io, snd_pcm_uframes_t frames);
 };
 
 
@@ -226,6 +250,9 @@ int snd_pcm_ioplug_delete(snd_pcm_ioplug_t *io);
 /* update poll_fd and mmap_rw */
 int snd_pcm_ioplug_reinit_status(snd_pcm_ioplug_t *ioplug);
 
+/* publish the current position from the backend thread */
+void snd_pcm_ioplug_publish_pointer(snd_pcm_ioplug_t *ioplug, snd_pcm_sframes_t pos);
+
 /* get a mmap area (for mmap_rw only) */
 const snd_pcm_channel_area_t *snd_pcm_ioplug_mmap_areas(snd_pcm_ioplug_t *ioplug);
 
@@ -210,6 +210,43 @@ int _snd_pcm_jack_open(snd_pcm_t **pcmp, const char *name,
                        snd_config_t *root, snd_config_t *conf,
                        snd_pcm_stream_t stream, int mode);
 
+/*
+ *  Direct plugins (dmix, dsnoop, dshare) client statistics
+ */
+
+/** Statistics of one client of a direct plugin instance */
+typedef struct _snd_pcm_direct_client_stats {
+	int pid;			/**< client process id */
+	unsigned int state;		/**< client PCM state (#snd_pcm_state_t) */
+	unsigned int xruns;		/**< number of xruns */
+	unsigned int avail;		/**< avail frames at the last update */
+	unsigned int avail_max;		/**< maximum avail frames */
+	unsigned int updates;		/**< number of ring buffer transfers */
+	unsigned int frames;		/**< transferred frames (wraps around) */
+	unsigned int transfer_usec;	/**< time spent in transfers in usec (wraps around) */
+} snd_pcm_direct_client_stats_t;
+
+int snd_pcm_direct_stats_read(snd_pcm_t *pcm,
+			      snd_pcm_direct_client_stats_t *stats,
+			      unsigned int count);
+
+/** Totals of a direct plugin instance */
+typedef struct _snd_pcm_direct_stats {
+	unsigned int clients;		/**< clients with a statistics slot */
+	unsigned long long transfers;	/**< ring buffer transfers of all the clients */
+	unsigned long long frames;	/**< frames mixed or copied by all the clients */
+	unsigned long long transfer_nsec;	/**< time spent in the transfers in nsec */
+	unsigned long long wakeups;	/**< slave wakeups forwarded by the server */
+	unsigned long long wakeup_nsec;	/**< time spent by the server forwarding them */
+} snd_pcm_direct_stats_t;
+
+int snd_pcm_direct_stats_total(snd_pcm_t *pcm, snd_pcm_direct_stats_t *total);
+
+/*
+ *  Dmix plugin client gain
+ */
+int snd_pcm_dmix_set_gain(snd_pcm_t *pcm, long db);
+int snd_pcm_dmix_get_gain(snd_pcm_t *pcm, long *db);
 
 /** \} */
 
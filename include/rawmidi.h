@@ -112,6 +112,10 @@ int snd_rawmidi_poll_descriptors_count(snd_rawmidi_t *rmidi);
 int snd_rawmidi_poll_descriptors(snd_rawmidi_t *rmidi, struct pollfd *pfds, unsigned int space);
 int snd_rawmidi_poll_descriptors_revents(snd_rawmidi_t *rawmidi, struct pollfd *pfds, unsigned int nfds, unsigned short *revent);
 int snd_rawmidi_nonblock(snd_rawmidi_t *rmidi, int nonblock);
+int snd_rawmidi_set_busy_poll(snd_rawmidi_t *rmidi, unsigned int usec);
+unsigned int snd_rawmidi_get_busy_poll(snd_rawmidi_t *rmidi);
+int snd_rawmidi_set_read_ahead(snd_rawmidi_t *rmidi, size_t size);
+size_t snd_rawmidi_get_read_ahead(snd_rawmidi_t *rmidi);
 size_t snd_rawmidi_info_sizeof(void);
 /** \hideinitializer
  * \brief allocate an invalid #snd_rawmidi_info_t using standard alloca
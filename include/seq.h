@@ -96,6 +96,9 @@ size_t snd_seq_get_output_buffer_size(snd_seq_t *handle);
 size_t snd_seq_get_input_buffer_size(snd_seq_t *handle);
 int snd_seq_set_output_buffer_size(snd_seq_t *handle, size_t size);
 int snd_seq_set_input_buffer_size(snd_seq_t *handle, size_t size);
+int snd_seq_set_query_cache(snd_seq_t *handle, int enable);
+size_t snd_seq_get_output_buffer_limit(snd_seq_t *handle);
+int snd_seq_set_output_buffer_limit(snd_seq_t *handle, size_t size);
 
 /** system information container */
 typedef struct _snd_seq_system_info snd_seq_system_info_t;
@@ -570,12 +573,19 @@ int snd_seq_event_output(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_buffer(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_direct(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_input(snd_seq_t *handle, snd_seq_event_t **ev);
+int snd_seq_event_input_batch(snd_seq_t *seq, snd_seq_event_t **evs,
+			      unsigned int max);
 int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer);
 int snd_seq_drain_output(snd_seq_t *handle);
+int snd_seq_schedule_batch(snd_seq_t *seq, snd_seq_event_t *evs,
+			   unsigned int count);
 int snd_seq_event_output_pending(snd_seq_t *seq);
 int snd_seq_extract_output(snd_seq_t *handle, snd_seq_event_t **ev);
 int snd_seq_drop_output(snd_seq_t *handle);
 int snd_seq_drop_output_buffer(snd_seq_t *handle);
+int snd_seq_set_output_ring(snd_seq_t *handle, unsigned int slots);
+int snd_seq_event_output_ring(snd_seq_t *handle, snd_seq_event_t *ev);
+int snd_seq_drain_output_ring(snd_seq_t *handle);
 int snd_seq_drop_input(snd_seq_t *handle);
 int snd_seq_drop_input_buffer(snd_seq_t *handle);
 
@@ -625,6 +635,10 @@ int snd_seq_ump_event_output_buffer(snd_seq_t *seq, snd_seq_ump_event_t *ev);
 int snd_seq_ump_extract_output(snd_seq_t *seq, snd_seq_ump_event_t **ev_res);
 int snd_seq_ump_event_output_direct(snd_seq_t *seq, snd_seq_ump_event_t *ev);
 int snd_seq_ump_event_input(snd_seq_t *seq, snd_seq_ump_event_t **ev);
+int snd_seq_ump_event_input_batch(snd_seq_t *seq, snd_seq_ump_event_t **evs,
+				  unsigned int max);
+int snd_seq_set_ump_input_filter(snd_seq_t *seq, unsigned int groups,
+				 unsigned int channels, unsigned int types);
 
 /** \} */
 
@@ -136,7 +136,9 @@ typedef enum _snd_timer_type {
 	/** Shared memory client timer (not yet implemented) */
 	SND_TIMER_TYPE_SHM,
 	/** INET client timer (not yet implemented) */
-	SND_TIMER_TYPE_INET
+	SND_TIMER_TYPE_INET,
+	/** Userspace timer driven by a timerfd */
+	SND_TIMER_TYPE_SOFT
 } snd_timer_type_t;
 
 /** timer query handle */
@@ -158,6 +160,8 @@ int snd_timer_open_lconf(snd_timer_t **handle, const char *name, int mode, snd_c
 int snd_timer_close(snd_timer_t *handle);
 int snd_async_add_timer_handler(snd_async_handler_t **handler, snd_timer_t *timer,
 				snd_async_callback_t callback, void *private_data);
+int snd_async_add_timer_thread_handler(snd_async_handler_t **handler, snd_timer_t *timer,
+				       snd_async_callback_t callback, void *private_data);
 snd_timer_t *snd_async_handler_get_timer(snd_async_handler_t *handler);
 int snd_timer_poll_descriptors_count(snd_timer_t *handle);
 int snd_timer_poll_descriptors(snd_timer_t *handle, struct pollfd *pfds, unsigned int space);
@@ -169,6 +173,8 @@ int snd_timer_start(snd_timer_t *handle);
 int snd_timer_stop(snd_timer_t *handle);
 int snd_timer_continue(snd_timer_t *handle);
 ssize_t snd_timer_read(snd_timer_t *handle, void *buffer, size_t size);
+int snd_timer_read_events(snd_timer_t *handle, snd_timer_tread_t *events, unsigned int count);
+unsigned long snd_timer_get_ticks(snd_timer_t *handle);
 
 size_t snd_timer_id_sizeof(void);
 /** allocate #snd_timer_id_t container on stack */
@@ -772,6 +772,7 @@ enum snd_tplg_type {
 /** Flags for the snd_tplg_create */
 #define SND_TPLG_CREATE_VERBOSE		(1<<0)	/*!< Verbose output */
 #define SND_TPLG_CREATE_DAPM_NOSORT	(1<<1)	/*!< Do not sort DAPM objects by index */
+#define SND_TPLG_CREATE_PARALLEL	(1<<2)	/*!< Parse the text sections in threads */
 
 /**
  * \brief Return the version of the topology library.
@@ -816,6 +817,22 @@ int snd_tplg_load(snd_tplg_t *tplg, const char *buf, size_t size);
 int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
 			const char *outfile);
 
+/**
+ * \brief Set the build cache file of snd_tplg_build_file().
+ * \param tplg Topology instance.
+ * \param file Cache file, NULL to disable the cache.
+ * \return Zero on success, otherwise a negative error code
+ *
+ * The cache keeps the last binary built with the hash of its parsed
+ * text, including the included files. When the text did not change,
+ * snd_tplg_build_file() copies the cached binary to the output file
+ * without parsing and building the topology, so the instance holds no
+ * objects afterwards. Otherwise the topology is built and the cache
+ * updated. A cache is used for a single source, build each variant with
+ * its own cache file.
+ */
+int snd_tplg_set_cache(snd_tplg_t *tplg, const char *file);
+
 /**
  * \brief Enable verbose reporting of binary file output
  * \param tplg Topology Instance
@@ -1172,6 +1189,80 @@ int snd_tplg_save(snd_tplg_t *tplg, char **dst, int flags);
  */
 int snd_tplg_decode(snd_tplg_t *tplg, void *bin, size_t size, int dflags);
 
+/** Read-only view of a binary topology */
+typedef struct snd_tplg_view snd_tplg_view_t;
+
+/** Block of a binary topology, returned by snd_tplg_view_next_block() */
+typedef struct snd_tplg_view_block {
+	unsigned int type;		/*!< SND_SOC_TPLG_TYPE_* of the block */
+	unsigned int vendor_type;	/*!< vendor type of the block */
+	unsigned int version;		/*!< vendor specific version */
+	unsigned int index;		/*!< group index of the elements */
+	unsigned int count;		/*!< count of the elements */
+	size_t offset;			/*!< offset of the block header */
+	const void *payload;		/*!< elements, pointing into the view */
+	size_t payload_size;		/*!< size of the elements in bytes */
+} snd_tplg_view_block_t;
+
+/**
+ * \brief Map a binary topology file for inspection.
+ * \param view Returned view handle.
+ * \param file Binary topology file.
+ * \return Zero on success, otherwise a negative error code
+ *
+ * The file is mapped read-only. Blocks and elements are returned as
+ * pointers into the mapping, no element tree is built. The pointers
+ * stay valid until snd_tplg_view_close().
+ */
+int snd_tplg_view_open(snd_tplg_view_t **view, const char *file);
+
+/**
+ * \brief Create a view of a binary topology in memory.
+ * \param view Returned view handle.
+ * \param bin Binary topology, must stay valid while the view is used.
+ * \param size Size of the binary topology in bytes.
+ * \return Zero on success, otherwise a negative error code
+ */
+int snd_tplg_view_open_buffer(snd_tplg_view_t **view, const void *bin, size_t size);
+
+/**
+ * \brief Close a view and unmap its file.
+ * \param view View handle.
+ * \return Zero on success, otherwise a negative error code
+ */
+int snd_tplg_view_close(snd_tplg_view_t *view);
+
+/**
+ * \brief Restart the block iteration at the beginning of the view.
+ * \param view View handle.
+ */
+void snd_tplg_view_rewind(snd_tplg_view_t *view);
+
+/**
+ * \brief Get the next block of a view.
+ * \param view View handle.
+ * \param block Returned block description.
+ * \return 1 for a block, 0 at the end, otherwise a negative error code
+ *
+ * The headers are checked like in snd_tplg_decode().
+ */
+int snd_tplg_view_next_block(snd_tplg_view_t *view, snd_tplg_view_block_t *block);
+
+/**
+ * \brief Get the next element of the current block.
+ * \param view View handle.
+ * \param elem Returned pointer to the UAPI object of the element
+ *             (e.g. struct snd_soc_tplg_mixer_control).
+ * \param size Returned size of the element including its private data
+ *             and, for widgets, its controls.
+ * \return 1 for an element, 0 at the end of the block, otherwise
+ *         a negative error code
+ *
+ * The private data blocks and unknown block types are returned as a
+ * single element spanning the whole payload.
+ */
+int snd_tplg_view_next_elem(snd_tplg_view_t *view, const void **elem, size_t *size);
+
 /** \} */
 
 #ifdef __cplusplus
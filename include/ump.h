@@ -46,9 +46,14 @@ int snd_ump_rawmidi_params_current(snd_ump_t *ump, snd_rawmidi_params_t *params)
 int snd_ump_rawmidi_status(snd_ump_t *ump, snd_rawmidi_status_t *status);
 int snd_ump_drop(snd_ump_t *ump);
 int snd_ump_drain(snd_ump_t *ump);
+int snd_ump_set_write_combining(snd_ump_t *ump, size_t size, unsigned int usec);
+int snd_ump_flush(snd_ump_t *ump);
+long snd_ump_flush_timeout(snd_ump_t *ump);
 ssize_t snd_ump_write(snd_ump_t *ump, const void *buffer, size_t size);
 ssize_t snd_ump_read(snd_ump_t *ump, void *buffer, size_t size);
 ssize_t snd_ump_tread(snd_ump_t *ump, struct timespec *tstamp, void *buffer, size_t size);
+int snd_ump_read_packets(snd_ump_t *ump, uint32_t (*pkts)[4],
+			 struct timespec *tstamps, unsigned int n);
 
 /** Max number of UMP Groups */
 #define SND_UMP_MAX_GROUPS		16
@@ -108,6 +113,7 @@ const unsigned char *snd_ump_endpoint_info_get_sw_revision(const snd_ump_endpoin
 const char *snd_ump_endpoint_info_get_name(const snd_ump_endpoint_info_t *info);
 const char *snd_ump_endpoint_info_get_product_id(const snd_ump_endpoint_info_t *info);
 int snd_ump_endpoint_info(snd_ump_t *ump, snd_ump_endpoint_info_t *info);
+int snd_ump_set_info_cache(snd_ump_t *ump, int enable);
 
 void snd_ump_endpoint_info_set_card(snd_ump_endpoint_info_t *info, unsigned int card);
 void snd_ump_endpoint_info_set_device(snd_ump_endpoint_info_t *info, unsigned int device);
@@ -1128,6 +1128,19 @@ int snd_ump_msg_sysex_expand(const uint32_t *ump, uint8_t *buf, size_t maxlen,
 			     size_t *filled);
 int snd_ump_packet_length(unsigned int type);
 
+/** MIDI 1.0 byte stream / UMP converter */
+typedef struct _snd_ump_convert snd_ump_convert_t;
+
+int snd_ump_convert_new(snd_ump_convert_t **convp, unsigned int group);
+void snd_ump_convert_free(snd_ump_convert_t *conv);
+void snd_ump_convert_reset(snd_ump_convert_t *conv);
+int snd_ump_convert_from_bytes(snd_ump_convert_t *conv, const uint8_t *buf,
+			       size_t len, uint32_t *ump, size_t words,
+			       size_t *consumed);
+int snd_ump_convert_to_bytes(snd_ump_convert_t *conv, const uint32_t *ump,
+			     size_t words, uint8_t *buf, size_t len,
+			     size_t *consumed);
+
 #ifdef __cplusplus
 }
 #endif
@@ -480,6 +480,13 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
  * sound cards (for the default and strict card_name).
  * The application cannot expect that the device names will refer
  * only one ALSA sound card in this case.
+ *
+ * When the environment variable \c ALSA_UCM_CACHE names a directory,
+ * the trees parsed from the configuration files of the card are stored
+ * there, and later opens and reloads map them instead of parsing the
+ * unchanged files again.  The conditions are evaluated on every open.
+ * Files with include directives are not stored, and the cache must
+ * belong to the user.
  */
 int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr,
                           const char *card_name);
@@ -59,14 +59,45 @@ static int alisp_include_file(struct alisp_instance *instance, const char *filen
  *  object handling
  */
 
-static int get_string_hash(const char *s)
+static unsigned int hash_string(const char *s)
 {
-	int val = 0;
+	unsigned int val = 0;
 	if (s == NULL)
 		return val;
 	while (*s)
-		val += *s++;
-	return val & ALISP_OBJ_PAIR_HASH_MASK;
+		val = val * 31 + (unsigned char)*s++;
+	return val;
+}
+
+static int get_string_hash(const char *s)
+{
+	return hash_string(s) & ALISP_OBJ_PAIR_HASH_MASK;
+}
+
+/* spread the close integers and the aligned pointers over the buckets */
+static unsigned int hash_long(unsigned long val)
+{
+	val ^= val >> 16;
+	val *= 0x45d9f3bUL;
+	val ^= val >> 16;
+	return val;
+}
+
+static unsigned int object_hash(struct alisp_object *p)
+{
+	switch (alisp_get_type(p)) {
+	case ALISP_OBJ_IDENTIFIER:
+	case ALISP_OBJ_STRING:
+		return hash_string(p->value.s);
+	case ALISP_OBJ_INTEGER:
+		return hash_long(p->value.i);
+	case ALISP_OBJ_FLOAT:
+		return hash_long((long)p->value.f);
+	case ALISP_OBJ_POINTER:
+		return hash_long((unsigned long)p->value.ptr);
+	default:
+		return 0;
+	}
 }
 
 static void nomem(void)
@@ -126,23 +157,91 @@ static void lisp_debug(struct alisp_instance *instance, const char *fmt, ...)
 	va_end(ap);
 }
 
+static int table_init(struct alisp_object_table *t, unsigned int size)
+{
+	unsigned int i;
+
+	t->hash = malloc(size * sizeof(*t->hash));
+	if (t->hash == NULL)
+		return -ENOMEM;
+	for (i = 0; i < size; i++)
+		INIT_LIST_HEAD(&t->hash[i]);
+	t->size = size;
+	t->count = 0;
+	return 0;
+}
+
+/* keep about one object per bucket, the growth is skipped without memory */
+static void table_grow(struct alisp_object_table *t)
+{
+	struct alisp_object_table n;
+	struct list_head *pos, *pos1;
+	struct alisp_object *p;
+	unsigned int i;
+
+	if (table_init(&n, t->size * 2) < 0)
+		return;
+	for (i = 0; i < t->size; i++) {
+		list_for_each_safe(pos, pos1, &t->hash[i]) {
+			p = list_entry(pos, struct alisp_object, list);
+			list_add_tail(&p->list, &n.hash[object_hash(p) & (n.size - 1)]);
+		}
+	}
+	n.count = t->count;
+	free(t->hash);
+	*t = n;
+}
+
+static inline struct list_head *table_bucket(struct alisp_instance *instance,
+					     enum alisp_objects type,
+					     unsigned int hash)
+{
+	struct alisp_object_table *t = &instance->objs_table[type];
+
+	return &t->hash[hash & (t->size - 1)];
+}
+
+static void table_add(struct alisp_instance *instance, struct alisp_object *p,
+		      unsigned int hash)
+{
+	struct alisp_object_table *t = &instance->objs_table[alisp_get_type(p)];
+
+	list_add(&p->list, &t->hash[hash & (t->size - 1)]);
+	/* the conses are not searched, a single list is enough */
+	if (++t->count > t->size && !alisp_compare_type(p, ALISP_OBJ_CONS))
+		table_grow(t);
+}
+
+/* the objects are carved from slabs, which are freed in alsa_lisp_free() */
+static int new_slab(struct alisp_instance *instance)
+{
+	struct alisp_object_slab *slab;
+	unsigned int i;
+
+	slab = malloc(sizeof(*slab));
+	if (slab == NULL)
+		return -ENOMEM;
+	lisp_debug(instance, "allocating slab %p", slab);
+	slab->next = instance->slabs;
+	instance->slabs = slab;
+	for (i = 0; i < ALISP_OBJ_SLAB; i++)
+		list_add(&slab->objs[i].list, &instance->free_objs_list);
+	instance->free_objs += ALISP_OBJ_SLAB;
+	return 0;
+}
+
 static struct alisp_object * new_object(struct alisp_instance *instance, int type)
 {
 	struct alisp_object * p;
 
-	if (list_empty(&instance->free_objs_list)) {
-		p = (struct alisp_object *)malloc(sizeof(struct alisp_object));
-		if (p == NULL) {
-			nomem();
-			return NULL;
-		}
-		lisp_debug(instance, "allocating cons %p", p);
-	} else {
-		p = (struct alisp_object *)instance->free_objs_list.next;
-		list_del(&p->list);
-		instance->free_objs--;
-		lisp_debug(instance, "recycling cons %p", p);
+	if (list_empty(&instance->free_objs_list) && new_slab(instance) < 0) {
+		nomem();
+		return NULL;
 	}
+	p = (struct alisp_object *)instance->free_objs_list.next;
+	list_del(&p->list);
+	instance->free_objs--;
+	lisp_debug(instance, "recycling cons %p", p);
 
 	instance->used_objs++;
 
@@ -151,7 +250,7 @@ static struct alisp_object * new_object(struct alisp_instance *instance, int typ
 	if (type == ALISP_OBJ_CONS) {
 		p->value.c.car = &alsa_lisp_nil;
 		p->value.c.cdr = &alsa_lisp_nil;
-		list_add(&p->list, &instance->used_objs_list[0][ALISP_OBJ_CONS]);
+		table_add(instance, p, 0);
 	}
 
 	if (instance->used_objs + instance->free_objs > instance->max_objs)
@@ -187,13 +286,9 @@ static void delete_object(struct alisp_instance *instance, struct alisp_object *
 	if (alisp_dec_refs(p))
 		return;
 	list_del(&p->list);
+	instance->objs_table[alisp_get_type(p)].count--;
 	instance->used_objs--;
 	free_object(p);
-	if (instance->free_objs >= ALISP_FREE_OBJ_POOL) {
-		lisp_debug(instance, "freed cons %p", p);
-		free(p);
-		return;
-	}
 	lisp_debug(instance, "moved cons %p to free list", p);
 	list_add(&p->list, &instance->free_objs_list);
 	instance->free_objs++;
@@ -261,7 +356,8 @@ static void free_objects(struct alisp_instance *instance)
 	struct list_head *pos, *pos1;
 	struct alisp_object * p;
 	struct alisp_object_pair * pair;
-	int i, j;
+	struct alisp_object_slab *slab;
+	unsigned int i, j;
 
 	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++) {
 		list_for_each_safe(pos, pos1, &instance->setobjs_list[i]) {
@@ -272,9 +368,9 @@ static void free_objects(struct alisp_instance *instance)
 			free(pair);
 		}
 	}
-	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++)
-		for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++) {
-			list_for_each_safe(pos, pos1, &instance->used_objs_list[i][j]) {
+	for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++)
+		for (i = 0; i < instance->objs_table[j].size; i++) {
+			list_for_each_safe(pos, pos1, &instance->objs_table[j].hash[i]) {
 				p = list_entry(pos, struct alisp_object, list);
 				lisp_warn(instance, "object %p is still referenced %i times!", p, alisp_get_refs(p));
 #if 0
@@ -287,12 +383,16 @@ static void free_objects(struct alisp_instance *instance)
 				delete_object(instance, p);
 			}
 		}
-	list_for_each_safe(pos, pos1, &instance->free_objs_list) {
-		p = list_entry(pos, struct alisp_object, list);
-		list_del(&p->list);
-		free(p);
-		lisp_debug(instance, "freed (all) cons %p", p);
+	/* all objects are free now, release them at once */
+	while ((slab = instance->slabs) != NULL) {
+		instance->slabs = slab->next;
+		lisp_debug(instance, "freed slab %p", slab);
+		free(slab);
 	}
+	INIT_LIST_HEAD(&instance->free_objs_list);
+	instance->free_objs = 0;
+	for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++)
+		free(instance->objs_table[j].hash);
 }
 
 static struct alisp_object * search_object_identifier(struct alisp_instance *instance, const char *s)
@@ -300,7 +400,7 @@ static struct alisp_object * search_object_identifier(struct alisp_instance *ins
 	struct list_head * pos;
 	struct alisp_object * p;
 
-	list_for_each(pos, &instance->used_objs_list[get_string_hash(s)][ALISP_OBJ_IDENTIFIER]) {
+	list_for_each(pos, table_bucket(instance, ALISP_OBJ_IDENTIFIER, hash_string(s))) {
 		p = list_entry(pos, struct alisp_object, list);
 		if (alisp_get_refs(p) > ALISP_MAX_REFS_LIMIT)
 			continue;
@@ -316,7 +416,7 @@ static struct alisp_object * search_object_string(struct alisp_instance *instanc
 	struct list_head * pos;
 	struct alisp_object * p;
 
-	list_for_each(pos, &instance->used_objs_list[get_string_hash(s)][ALISP_OBJ_STRING]) {
+	list_for_each(pos, table_bucket(instance, ALISP_OBJ_STRING, hash_string(s))) {
 		p = list_entry(pos, struct alisp_object, list);
 		if (!strcmp(p->value.s, s)) {
 			if (alisp_get_refs(p) > ALISP_MAX_REFS_LIMIT)
@@ -333,7 +433,7 @@ static struct alisp_object * search_object_integer(struct alisp_instance *instan
 	struct list_head * pos;
 	struct alisp_object * p;
 
-	list_for_each(pos, &instance->used_objs_list[in & ALISP_OBJ_PAIR_HASH_MASK][ALISP_OBJ_INTEGER]) {
+	list_for_each(pos, table_bucket(instance, ALISP_OBJ_INTEGER, hash_long(in))) {
 		p = list_entry(pos, struct alisp_object, list);
 		if (p->value.i == in) {
 			if (alisp_get_refs(p) > ALISP_MAX_REFS_LIMIT)
@@ -350,9 +450,9 @@ static struct alisp_object * search_object_float(struct alisp_instance *instance
 	struct list_head * pos;
 	struct alisp_object * p;
 
-	list_for_each(pos, &instance->used_objs_list[(long)in & ALISP_OBJ_PAIR_HASH_MASK][ALISP_OBJ_FLOAT]) {
+	list_for_each(pos, table_bucket(instance, ALISP_OBJ_FLOAT, hash_long((long)in))) {
 		p = list_entry(pos, struct alisp_object, list);
-		if (p->value.i == in) {
+		if (p->value.f == in) {
 			if (alisp_get_refs(p) > ALISP_MAX_REFS_LIMIT)
 				continue;
 			return incref_object(instance, p);
@@ -367,7 +467,7 @@ static struct alisp_object * search_object_pointer(struct alisp_instance *instan
 	struct list_head * pos;
 	struct alisp_object * p;
 
-	list_for_each(pos, &instance->used_objs_list[(long)ptr & ALISP_OBJ_PAIR_HASH_MASK][ALISP_OBJ_POINTER]) {
+	list_for_each(pos, table_bucket(instance, ALISP_OBJ_POINTER, hash_long((unsigned long)ptr))) {
 		p = list_entry(pos, struct alisp_object, list);
 		if (p->value.ptr == ptr) {
 			if (alisp_get_refs(p) > ALISP_MAX_REFS_LIMIT)
@@ -388,8 +488,8 @@ static struct alisp_object * new_integer(struct alisp_instance *instance, long v
 		return obj;
 	obj = new_object(instance, ALISP_OBJ_INTEGER);
 	if (obj) {
-		list_add(&obj->list, &instance->used_objs_list[value & ALISP_OBJ_PAIR_HASH_MASK][ALISP_OBJ_INTEGER]);
 		obj->value.i = value;
+		table_add(instance, obj, hash_long(value));
 	}
 	return obj;
 }
@@ -403,8 +503,8 @@ static struct alisp_object * new_float(struct alisp_instance *instance, double v
 		return obj;
 	obj = new_object(instance, ALISP_OBJ_FLOAT);
 	if (obj) {
-		list_add(&obj->list, &instance->used_objs_list[(long)value & ALISP_OBJ_PAIR_HASH_MASK][ALISP_OBJ_FLOAT]);
 		obj->value.f = value;
+		table_add(instance, obj, hash_long((long)value));
 	}
 	return obj;
 }
@@ -417,9 +517,12 @@ static struct alisp_object * new_string(struct alisp_instance *instance, const c
 	if (obj != NULL)
 		return obj;
 	obj = new_object(instance, ALISP_OBJ_STRING);
-	if (obj)
-		list_add(&obj->list, &instance->used_objs_list[get_string_hash(str)][ALISP_OBJ_STRING]);
-	if (obj && (obj->value.s = strdup(str)) == NULL) {
+	if (obj == NULL)
+		return NULL;
+	obj->value.s = strdup(str);
+	obj->value.id.func = NULL;
+	table_add(instance, obj, hash_string(str));
+	if (obj->value.s == NULL) {
 		delete_object(instance, obj);
 		nomem();
 		return NULL;
@@ -435,9 +538,12 @@ static struct alisp_object * new_identifier(struct alisp_instance *instance, con
 	if (obj != NULL)
 		return obj;
 	obj = new_object(instance, ALISP_OBJ_IDENTIFIER);
-	if (obj)
-		list_add(&obj->list, &instance->used_objs_list[get_string_hash(id)][ALISP_OBJ_IDENTIFIER]);
-	if (obj && (obj->value.s = strdup(id)) == NULL) {
+	if (obj == NULL)
+		return NULL;
+	obj->value.s = strdup(id);
+	obj->value.id.func = NULL;
+	table_add(instance, obj, hash_string(id));
+	if (obj->value.s == NULL) {
 		delete_object(instance, obj);
 		nomem();
 		return NULL;
@@ -454,8 +560,8 @@ static struct alisp_object * new_pointer(struct alisp_instance *instance, const
 		return obj;
 	obj = new_object(instance, ALISP_OBJ_POINTER);
 	if (obj) {
-		list_add(&obj->list, &instance->used_objs_list[(long)ptr & ALISP_OBJ_PAIR_HASH_MASK][ALISP_OBJ_POINTER]);
 		obj->value.ptr = ptr;
+		table_add(instance, obj, hash_long((unsigned long)ptr));
 	}
 	return obj;
 }
@@ -1032,12 +1138,12 @@ static void print_obj_lists(struct alisp_instance *instance, snd_output_t *out)
 {
 	struct list_head *pos;
 	struct alisp_object * p;
-	int i, j;
+	unsigned int i, j;
 
 	snd_output_printf(out, "** used objects\n");
-	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++)
-		for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++)
-			list_for_each(pos, &instance->used_objs_list[i][j]) {
+	for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++)
+		for (i = 0; i < instance->objs_table[j].size; i++)
+			list_for_each(pos, &instance->objs_table[j].hash[i]) {
 				p = list_entry(pos, struct alisp_object, list);
 				snd_output_printf(out, "**   %p (%s) (", p, obj_type_str(p));
 				if (!alisp_compare_type(p, ALISP_OBJ_CONS))
@@ -3044,23 +3150,34 @@ static int compar(const void *p1, const void *p2)
 		      ((struct intrinsic *)p2)->name);
 }
 
-static inline struct alisp_object * eval_cons1(struct alisp_instance *instance, struct alisp_object * p1, struct alisp_object * p2)
+/* marks a name which is not an intrinsic */
+static const struct intrinsic no_intrinsic;
+
+static const struct intrinsic *find_intrinsic(const char *name)
 {
-	struct alisp_object * p3;
 	struct intrinsic key, *item;
 
-	key.name = p1->value.s;
+	key.name = name;
+	item = bsearch(&key, intrinsics,
+		       sizeof intrinsics / sizeof intrinsics[0],
+		       sizeof intrinsics[0], compar);
+	if (item == NULL)
+		item = bsearch(&key, snd_intrinsics,
+			       sizeof snd_intrinsics / sizeof snd_intrinsics[0],
+			       sizeof snd_intrinsics[0], compar);
+	return item ? item : &no_intrinsic;
+}
 
-	if ((item = bsearch(&key, intrinsics,
-			    sizeof intrinsics / sizeof intrinsics[0],
-			    sizeof intrinsics[0], compar)) != NULL) {
-		delete_object(instance, p1);
-		return item->func(instance, p2);
-	}
+static inline struct alisp_object * eval_cons1(struct alisp_instance *instance, struct alisp_object * p1, struct alisp_object * p2)
+{
+	struct alisp_object * p3;
+	const struct intrinsic *item;
 
-	if ((item = bsearch(&key, snd_intrinsics,
-			    sizeof snd_intrinsics / sizeof snd_intrinsics[0],
-			    sizeof snd_intrinsics[0], compar)) != NULL) {
+	/* the names are shared objects, the intrinsics are fixed */
+	item = p1->value.id.func;
+	if (item == NULL)
+		item = p1->value.id.func = find_intrinsic(p1->value.s);
+	if (item != &no_intrinsic) {
 		delete_object(instance, p1);
 		return item->func(instance, p2);
 	}
@@ -3218,10 +3335,18 @@ int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
 	instance->wout = cfg->wout;
 	instance->dout = cfg->dout;
 	INIT_LIST_HEAD(&instance->free_objs_list);
-	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++) {
-		for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++)
-			INIT_LIST_HEAD(&instance->used_objs_list[i][j]);
+	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++)
 		INIT_LIST_HEAD(&instance->setobjs_list[i]);
+	for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++) {
+		/* the conses are never searched */
+		if (table_init(&instance->objs_table[j], j == ALISP_OBJ_CONS ?
+			       1 : ALISP_OBJ_PAIR_HASH_SIZE) < 0) {
+			while (j-- > 0)
+				free(instance->objs_table[j].hash);
+			free(instance);
+			nomem();
+			return -ENOMEM;
+		}
 	}
 	
 	init_lex(instance);
@@ -44,6 +44,7 @@ enum alisp_objects {
 };
 
 struct alisp_object;
+struct intrinsic;
 
 #define ALISP_TYPE_MASK	0xf0000000
 #define ALISP_TYPE_SHIFT 28
@@ -64,6 +65,10 @@ struct alisp_object {
 			struct alisp_object *car;
 			struct alisp_object *cdr;
 		} c;
+		struct {
+			char *s;	/* aliases value.s */
+			const struct intrinsic *func;	/* resolved by the first call */
+		} id;
 	} value;
 };
 
@@ -119,7 +124,19 @@ struct alisp_object_pair {
 #define ALISP_OBJ_PAIR_HASH_SHIFT 4
 #define ALISP_OBJ_PAIR_HASH_SIZE (1<<ALISP_OBJ_PAIR_HASH_SHIFT)
 #define ALISP_OBJ_PAIR_HASH_MASK (ALISP_OBJ_PAIR_HASH_SIZE-1)
-#define ALISP_FREE_OBJ_POOL	512	/* free objects above this pool */
+#define ALISP_OBJ_SLAB		256	/* objects allocated at once */
+
+struct alisp_object_slab {
+	struct alisp_object_slab *next;
+	struct alisp_object objs[ALISP_OBJ_SLAB];
+};
+
+/* used objects of a type, hashed by the value to intern the atoms */
+struct alisp_object_table {
+	struct list_head *hash;
+	unsigned int size;		/* count of buckets, power of two */
+	unsigned long count;
+};
 
 struct alisp_instance {
 	int verbose: 1,
@@ -145,7 +162,8 @@ struct alisp_instance {
 	long used_objs;
 	long max_objs;
 	struct list_head free_objs_list;
-	struct list_head used_objs_list[ALISP_OBJ_PAIR_HASH_SIZE][ALISP_OBJ_LAST_SEARCH + 1];
+	struct alisp_object_slab *slabs;
+	struct alisp_object_table objs_table[ALISP_OBJ_LAST_SEARCH + 1];
 	/* set object */
 	struct list_head setobjs_list[ALISP_OBJ_PAIR_HASH_SIZE];
 };
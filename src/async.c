@@ -26,7 +26,16 @@
 
 #include "pcm/pcm_local.h"
 #include "control/control_local.h"
+#ifdef BUILD_PCM
+#include "timer/timer_local.h"
+#endif
 #include <signal.h>
+#include <poll.h>
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE_SYS_EVENTFD_H)
+#define ASYNC_THREAD
+#include <pthread.h>
+#include <sys/eventfd.h>
+#endif
 
 static struct sigaction previous_action;
 #ifndef DOC_HIDDEN
@@ -121,6 +130,7 @@ int snd_async_add_handler(snd_async_handler_t **handler, int fd,
 	h->fd = fd;
 	h->callback = callback;
 	h->private_data = private_data;
+	h->thread = NULL;
 	was_empty = list_empty(&snd_async_handlers);
 	list_add_tail(&h->glist, &snd_async_handlers);
 	INIT_LIST_HEAD(&h->hlist);
@@ -142,6 +152,290 @@ int snd_async_add_handler(snd_async_handler_t **handler, int fd,
 	return 0;
 }
 
+/* true when a signal handler of the object is left in alist */
+int _snd_async_signal_used(struct list_head *alist)
+{
+	struct list_head *pos;
+
+	list_for_each(pos, alist) {
+		if (!list_entry(pos, snd_async_handler_t, hlist)->thread)
+			return 1;
+	}
+	return 0;
+}
+
+#ifdef ASYNC_THREAD
+
+#ifndef DOC_HIDDEN
+struct snd_async_thread {
+	pthread_t id;
+	int stop_fd;			/* eventfd ending the thread */
+	int deleted;			/* deleted from its own callback */
+	unsigned int count;		/* descriptors of the handler */
+	struct pollfd pfds[];		/* count + the stop descriptor */
+};
+#endif /* DOC_HIDDEN */
+
+/* poll descriptors of the object, only their count when pfds is NULL */
+static int async_poll_descriptors(snd_async_handler_t *h, struct pollfd *pfds,
+				  unsigned int space)
+{
+	switch (h->type) {
+#ifdef BUILD_PCM
+	case SND_ASYNC_HANDLER_PCM:
+		if (!pfds)
+			return snd_pcm_poll_descriptors_count(h->u.pcm);
+		return snd_pcm_poll_descriptors(h->u.pcm, pfds, space);
+	case SND_ASYNC_HANDLER_TIMER:
+		if (!pfds)
+			return snd_timer_poll_descriptors_count(h->u.timer);
+		return snd_timer_poll_descriptors(h->u.timer, pfds, space);
+#endif
+	case SND_ASYNC_HANDLER_CTL:
+		if (!pfds)
+			return snd_ctl_poll_descriptors_count(h->u.ctl);
+		return snd_ctl_poll_descriptors(h->u.ctl, pfds, space);
+	default:
+		return -EINVAL;
+	}
+}
+
+static int async_poll_revents(snd_async_handler_t *h, unsigned short *revents)
+{
+	struct snd_async_thread *t = h->thread;
+
+	switch (h->type) {
+#ifdef BUILD_PCM
+	case SND_ASYNC_HANDLER_PCM:
+		return snd_pcm_poll_descriptors_revents(h->u.pcm, t->pfds, t->count, revents);
+	case SND_ASYNC_HANDLER_TIMER:
+		return snd_timer_poll_descriptors_revents(h->u.timer, t->pfds, t->count, revents);
+#endif
+	case SND_ASYNC_HANDLER_CTL:
+		return snd_ctl_poll_descriptors_revents(h->u.ctl, t->pfds, t->count, revents);
+	default:
+		*revents = t->pfds[0].revents;
+		return 0;
+	}
+}
+
+static snd_async_handler_t *async_thread_new(unsigned int count,
+					     snd_async_callback_t callback,
+					     void *private_data)
+{
+	snd_async_handler_t *h;
+	struct snd_async_thread *t;
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return NULL;
+	t = calloc(1, sizeof(*t) + (count + 1) * sizeof(struct pollfd));
+	if (!t) {
+		free(h);
+		return NULL;
+	}
+	t->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (t->stop_fd < 0) {
+		free(t);
+		free(h);
+		return NULL;
+	}
+	t->count = count;
+	h->fd = -1;
+	h->callback = callback;
+	h->private_data = private_data;
+	h->thread = t;
+	INIT_LIST_HEAD(&h->glist);
+	INIT_LIST_HEAD(&h->hlist);
+	return h;
+}
+
+static void async_thread_free(snd_async_handler_t *h)
+{
+	close(h->thread->stop_fd);
+	free(h->thread);
+	free(h);
+}
+
+static void *async_thread(void *arg)
+{
+	snd_async_handler_t *h = arg;
+	struct snd_async_thread *t = h->thread;
+	unsigned short revents;
+
+	for (;;) {
+		if (poll(t->pfds, t->count + 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (t->pfds[t->count].revents)
+			break;
+		if (async_poll_revents(h, &revents) < 0 || (revents & POLLNVAL))
+			break;
+		if (revents && h->callback)
+			h->callback(h);
+		if (t->deleted) {
+			async_thread_free(h);
+			break;
+		}
+	}
+	return NULL;
+}
+
+static int async_thread_start(snd_async_handler_t *h)
+{
+	struct snd_async_thread *t = h->thread;
+	sigset_t all, old;
+	int err;
+
+	t->pfds[t->count].fd = t->stop_fd;
+	t->pfds[t->count].events = POLLIN;
+	/* the signals stay with the threads of the application */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&t->id, NULL, async_thread, h);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return -err;
+}
+
+static int async_thread_del(snd_async_handler_t *h)
+{
+	struct snd_async_thread *t = h->thread;
+	int err;
+
+	if (pthread_equal(pthread_self(), t->id)) {
+		/* called from the callback, the thread frees the handler */
+		t->deleted = 1;
+		return -pthread_detach(t->id);
+	}
+	eventfd_write(t->stop_fd, 1);
+	err = pthread_join(t->id, NULL);
+	async_thread_free(h);
+	return -err;
+}
+
+int _snd_async_add_thread_handler(snd_async_handler_t **handler, int type, void *obj,
+				  struct list_head *alist, snd_async_callback_t callback,
+				  void *private_data)
+{
+	snd_async_handler_t *h, tmp;
+	int count, err;
+
+	assert(handler && obj);
+	tmp.type = type;
+	switch (type) {
+#ifdef BUILD_PCM
+	case SND_ASYNC_HANDLER_PCM:
+		tmp.u.pcm = obj;
+		break;
+	case SND_ASYNC_HANDLER_TIMER:
+		tmp.u.timer = obj;
+		break;
+#endif
+	case SND_ASYNC_HANDLER_CTL:
+		tmp.u.ctl = obj;
+		break;
+	default:
+		return -EINVAL;
+	}
+	count = async_poll_descriptors(&tmp, NULL, 0);
+	if (count <= 0)
+		return count < 0 ? count : -EINVAL;
+	h = async_thread_new(count, callback, private_data);
+	if (!h)
+		return -ENOMEM;
+	h->type = tmp.type;
+	h->u = tmp.u;
+	err = async_poll_descriptors(h, h->thread->pfds, count);
+	if (err < 0)
+		goto _err;
+	h->thread->count = err;
+	list_add_tail(&h->hlist, alist);
+	err = async_thread_start(h);
+	if (err < 0) {
+		list_del(&h->hlist);
+		goto _err;
+	}
+	*handler = h;
+	return 0;
+ _err:
+	async_thread_free(h);
+	return err;
+}
+
+#else /* ASYNC_THREAD */
+
+static int async_thread_del(snd_async_handler_t *h ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+int _snd_async_add_thread_handler(snd_async_handler_t **handler ATTRIBUTE_UNUSED,
+				  int type ATTRIBUTE_UNUSED, void *obj ATTRIBUTE_UNUSED,
+				  struct list_head *alist ATTRIBUTE_UNUSED,
+				  snd_async_callback_t callback ATTRIBUTE_UNUSED,
+				  void *private_data ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+#endif /* ASYNC_THREAD */
+
+/**
+ * \brief Registers an async handler called from a thread.
+ * \param handler The function puts the pointer to the new async handler
+ *                object at the address specified by \p handler.
+ * \param fd The file descriptor to be associated with the callback.
+ * \param events The poll events to wait for on \p fd.
+ * \param callback The async callback function.
+ * \param private_data Private data for the async callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * Unlike #snd_async_add_handler, no signal is used: a thread owned by the
+ * handler polls \p fd and calls the callback whenever one of \p events
+ * is signalled.  The callback runs in that thread, it may take locks and
+ * call any function except joining the thread, for example by deleting
+ * the handler from another thread while the callback waits for it.
+ * The handler may delete itself from its own callback.
+ *
+ * The descriptor is level triggered as with poll(): the callback is
+ * called again as long as the event condition persists, so the callback
+ * should consume it.
+ *
+ * Delete the handler with #snd_async_del_handler,
+ * #snd_async_handler_get_signo returns -EINVAL for it.
+ *
+ * \see snd_async_add_pcm_thread_handler, snd_async_add_ctl_thread_handler,
+ *      snd_async_add_timer_thread_handler
+ */
+int snd_async_add_thread_handler(snd_async_handler_t **handler, int fd, short events,
+				 snd_async_callback_t callback, void *private_data)
+{
+#ifdef ASYNC_THREAD
+	snd_async_handler_t *h;
+	int err;
+
+	assert(handler);
+	h = async_thread_new(1, callback, private_data);
+	if (!h)
+		return -ENOMEM;
+	h->type = SND_ASYNC_HANDLER_GENERIC;
+	h->fd = fd;
+	h->thread->pfds[0].fd = fd;
+	h->thread->pfds[0].events = events;
+	err = async_thread_start(h);
+	if (err < 0) {
+		async_thread_free(h);
+		return err;
+	}
+	*handler = h;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 /**
  * \brief Deletes an async handler.
  * \param handler Handle of the async handler to delete.
@@ -159,6 +453,11 @@ int snd_async_del_handler(snd_async_handler_t *handler)
 		case SND_ASYNC_HANDLER_PCM:
 			alist = &handler->u.pcm->async_handlers;
 			break;
+#endif
+#ifdef BUILD_PCM
+		case SND_ASYNC_HANDLER_TIMER:
+			alist = &handler->u.timer->async_handlers;
+			break;
 #endif
 		case SND_ASYNC_HANDLER_CTL:
 			alist = &handler->u.ctl->async_handlers;
@@ -168,13 +467,17 @@ int snd_async_del_handler(snd_async_handler_t *handler)
 		}
 		if (!list_empty(alist))
 			list_del(&handler->hlist);
-		if (!list_empty(alist))
+		/* the thread handlers never switched the object to async mode */
+		if (handler->thread || _snd_async_signal_used(alist))
 			goto _glist;
 		switch (handler->type) {
 #ifdef BUILD_PCM
 		case SND_ASYNC_HANDLER_PCM:
 			err2 = snd_pcm_async(handler->u.pcm, -1, 1);
 			break;
+		case SND_ASYNC_HANDLER_TIMER:
+			err2 = snd_timer_async(handler->u.timer, -1, 1);
+			break;
 #endif
 		case SND_ASYNC_HANDLER_CTL:
 			err2 = snd_ctl_async(handler->u.ctl, -1, 1);
@@ -184,6 +487,10 @@ int snd_async_del_handler(snd_async_handler_t *handler)
 		}
 	}
  _glist:
+	if (handler->thread) {
+		err = async_thread_del(handler);
+		return err ? err : err2;
+	}
 	was_empty = list_empty(&snd_async_handlers);
 	list_del(&handler->glist);
 	if (!was_empty && list_empty(&snd_async_handlers)) {
@@ -210,6 +517,8 @@ int snd_async_del_handler(snd_async_handler_t *handler)
 int snd_async_handler_get_signo(snd_async_handler_t *handler)
 {
 	assert(handler);
+	if (handler->thread)
+		return -EINVAL;
 	return snd_async_signo;
 }
 
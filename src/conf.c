@@ -429,8 +429,13 @@ beginning:</P>
 #include <stdbool.h>
 #include <limits.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <locale.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
 #ifdef HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -440,8 +445,50 @@ beginning:</P>
 #ifdef HAVE_LIBPTHREAD
 static pthread_mutex_t snd_config_update_mutex;
 static pthread_once_t snd_config_update_mutex_once = PTHREAD_ONCE_INIT;
+/* guards snd_config and its update info for the lock-free readers */
+static pthread_rwlock_t snd_config_global_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 #endif
 
+/*
+ * searches in compounds with at least this count of children go through
+ * a hash index of the ids instead of the list
+ */
+#define SND_CONFIG_INDEX_MIN	16
+
+struct snd_config_index {
+	unsigned int mask;		/* count of buckets - 1 */
+	unsigned int count;
+	snd_config_t *buckets[];
+};
+
+/*
+ * the global tree allocates its nodes and interned strings in large
+ * chunks owned by the top node, they go away with it at once; copies
+ * of its nodes reference the interned strings and keep the chunks
+ * until they are deleted too
+ */
+#define SND_CONFIG_ARENA_CHUNK	65536
+
+struct snd_config_chunk {
+	struct snd_config_chunk *next;
+	size_t size;
+	long long data[];
+};
+
+struct snd_config_arena {
+	int refs;			/* top node and copies */
+	struct snd_config_chunk *chunks;
+	char *ptr;
+	size_t left;
+	unsigned int mask, count;	/* interned strings */
+	const char **strings;
+};
+
+#define CONFIG_MEM_NODE		(1 << 0)	/* node from the arena */
+#define CONFIG_MEM_ID		(1 << 1)	/* interned id */
+#define CONFIG_MEM_STRING	(1 << 2)	/* interned string value */
+#define CONFIG_MEM_OWNER	(1 << 3)	/* frees the arena */
+
 struct _snd_config {
 	char *id;
 	snd_config_type_t type;
@@ -455,19 +502,32 @@ struct _snd_config {
 		struct {
 			struct list_head fields;
 			bool join;
+			bool noindex;	/* duplicated ids, keep the list order */
+			unsigned int count;
+			struct snd_config_index *index;
 		} compound;
 	} u;
 	struct list_head list;
 	snd_config_t *parent;
+	snd_config_t *hash_next;
+	struct snd_config_arena *arena;	/* of the tree, for the children */
+	struct snd_config_arena *shared; /* of the strings of a copy */
+	unsigned int mem;		/* CONFIG_MEM_* */
 	int hop;
 };
 
+#define FILEDESC_BUFSIZE	4096
+
 struct filedesc {
 	char *name;
 	snd_input_t *in;
 	unsigned int line, column;
 	struct filedesc *next;
 
+	/* read ahead from in, the parser consumes the whole input */
+	unsigned char *ptr, *end;
+	unsigned char buf[FILEDESC_BUFSIZE];
+
 	/* list of the include paths (configuration directories),
 	 * defined by <searchdir:relative-path/to/top-alsa-conf-dir>,
 	 * for searching its included files.
@@ -492,6 +552,7 @@ typedef struct {
 	struct filedesc *current;
 	int unget;
 	int ch;
+	unsigned int includes;	/* count of the included files */
 } input_t;
 
 #ifdef HAVE_LIBPTHREAD
@@ -519,12 +580,168 @@ static inline void snd_config_unlock(void)
 	pthread_mutex_unlock(&snd_config_update_mutex);
 }
 
+static inline void snd_config_rdlock(void)
+{
+	pthread_rwlock_rdlock(&snd_config_global_rwlock);
+}
+
+static inline void snd_config_rdunlock(void)
+{
+	pthread_rwlock_unlock(&snd_config_global_rwlock);
+}
+
+static inline void snd_config_wrlock(void)
+{
+	pthread_rwlock_wrlock(&snd_config_global_rwlock);
+}
+
+static inline void snd_config_wrunlock(void)
+{
+	pthread_rwlock_unlock(&snd_config_global_rwlock);
+}
+
 #else
 
 static inline void snd_config_lock(void) { }
 static inline void snd_config_unlock(void) { }
+static inline void snd_config_rdlock(void) { }
+static inline void snd_config_rdunlock(void) { }
+static inline void snd_config_wrlock(void) { }
+static inline void snd_config_wrunlock(void) { }
+
+#endif
+
+/* the references of a tree are taken and dropped without any lock */
+static inline void config_ref(snd_config_t *config)
+{
+	__atomic_add_fetch(&config->refcount, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * With ALSA_CONFIG_PROFILE set, the time spent in the configuration files,
+ * hooks and functions is reported, to the file named by the variable when
+ * it is an absolute path, to stderr otherwise.
+ */
+#define ALSA_CONFIG_PROFILE_VAR	"ALSA_CONFIG_PROFILE"
+
+static snd_output_t *config_profile_out;
+
+static void config_profile_init(void)
+{
+	const char *env = getenv(ALSA_CONFIG_PROFILE_VAR);
+
+	if (!env || !*env)
+		return;
+	if (*env != '/' ||
+	    snd_output_stdio_open(&config_profile_out, env, "a") < 0)
+		snd_output_stdio_attach(&config_profile_out, stderr, 0);
+}
+
+/* the output of the profile, NULL when not profiling */
+static snd_output_t *config_profile(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	pthread_once(&once, config_profile_init);
+#else
+	static bool done;
 
+	if (!done) {
+		config_profile_init();
+		done = true;
+	}
 #endif
+	return config_profile_out;
+}
+
+/* a timestamp in ns when profiling, zero otherwise */
+static long long config_profile_start(void)
+{
+	struct timespec ts;
+
+	if (!config_profile())
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* reports the time since start from config_profile_start() */
+static void config_profile_end(long long start, const char *what,
+			       const char *name)
+{
+	struct timespec ts;
+
+	if (!start)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	snd_output_printf(config_profile_out, "conf: %s%s%s %lld us\n", what,
+			  name ? " " : "", name ? name : "",
+			  (ts.tv_sec * 1000000000LL + ts.tv_nsec - start) / 1000);
+}
+
+static void config_profile_count(snd_config_t *config, unsigned int *nodes,
+				 size_t *bytes)
+{
+	snd_config_iterator_t i, next;
+
+	(*nodes)++;
+	if (!(config->mem & CONFIG_MEM_NODE))
+		*bytes += sizeof(*config);
+	if (config->id && !(config->mem & CONFIG_MEM_ID))
+		*bytes += strlen(config->id) + 1;
+	switch (config->type) {
+	case SND_CONFIG_TYPE_STRING:
+		if (config->u.string && !(config->mem & CONFIG_MEM_STRING))
+			*bytes += strlen(config->u.string) + 1;
+		break;
+	case SND_CONFIG_TYPE_COMPOUND:
+		if (config->u.compound.index)
+			*bytes += sizeof(*config->u.compound.index) +
+				  (config->u.compound.index->mask + 1) *
+				  sizeof(snd_config_t *);
+		snd_config_for_each(i, next, config)
+			config_profile_count(snd_config_iterator_entry(i),
+					     nodes, bytes);
+		break;
+	default:
+		break;
+	}
+}
+
+/* reports the size of a tree read from the files */
+static void config_profile_tree(snd_config_t *top)
+{
+	struct snd_config_chunk *c;
+	unsigned int nodes = 0;
+	size_t bytes = 0;
+
+	if (!config_profile())
+		return;
+	config_profile_count(top, &nodes, &bytes);
+	if (top->mem & CONFIG_MEM_OWNER) {
+		for (c = top->arena->chunks; c; c = c->next)
+			bytes += sizeof(*c) + c->size;
+		if (top->arena->strings)
+			bytes += (top->arena->mask + 1) * sizeof(char *);
+	}
+	snd_output_printf(config_profile_out, "conf: tree %u nodes %zu bytes\n",
+			  nodes, bytes);
+}
+
+/* drops a reference, false when the caller holds the last one */
+static inline bool config_unref(snd_config_t *config)
+{
+	int refs = __atomic_load_n(&config->refcount, __ATOMIC_ACQUIRE);
+
+	while (refs > 0) {
+		if (__atomic_compare_exchange_n(&config->refcount, &refs, refs - 1,
+						false, __ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE))
+			return true;
+	}
+	return false;
+}
 
 /*
  * Add a directory to the paths to search included files.
@@ -743,6 +960,31 @@ int _snd_safe_strtod(const char *str, double *val)
 	return 0;
 }
 
+static void init_filedesc(struct filedesc *fd, char *name, snd_input_t *in,
+			  struct filedesc *next)
+{
+	fd->name = name;
+	fd->in = in;
+	fd->line = 1;
+	fd->column = 0;
+	fd->next = next;
+	fd->ptr = fd->end = fd->buf;
+	INIT_LIST_HEAD(&fd->include_paths);
+}
+
+/* makes the buffer of fd non-empty, false at the end of the input */
+static inline bool fill_filedesc(struct filedesc *fd)
+{
+	size_t n;
+
+	if (fd->ptr < fd->end)
+		return true;
+	n = _snd_input_read(fd->in, fd->buf, sizeof(fd->buf));
+	fd->ptr = fd->buf;
+	fd->end = fd->buf + n;
+	return n > 0;
+}
+
 static int get_char(input_t *input)
 {
 	int c;
@@ -753,7 +995,7 @@ static int get_char(input_t *input)
 	}
  again:
 	fd = input->current;
-	c = snd_input_getc(fd->in);
+	c = fill_filedesc(fd) ? *fd->ptr++ : EOF;
 	switch (c) {
 	case '\n':
 		fd->column = 0;
@@ -849,18 +1091,29 @@ static int get_char_skip_comments(input_t *input)
 				free(str);
 				return -ENOMEM;
 			}
-			fd->name = str;
-			fd->in = in;
-			fd->next = input->current;
-			fd->line = 1;
-			fd->column = 0;
-			INIT_LIST_HEAD(&fd->include_paths);
+			init_filedesc(fd, str, in, input->current);
 			input->current = fd;
+			input->includes++;
 			continue;
 		}
 		if (c != '#')
 			break;
+		/* skip to the end of the line within the buffer */
 		while (1) {
+			struct filedesc *fd = input->current;
+			unsigned char *nl;
+
+			if (!input->unget && fd->ptr < fd->end) {
+				nl = memchr(fd->ptr, '\n', fd->end - fd->ptr);
+				if (!nl) {
+					fd->ptr = fd->end;
+					continue;
+				}
+				fd->ptr = nl + 1;
+				fd->column = 0;
+				fd->line++;
+				break;
+			}
 			c = get_char(input);
 			if (c < 0)
 				return c;
@@ -988,6 +1241,32 @@ static int add_char_local_string(struct local_string *s, int c)
 	return 0;
 }
 
+static int add_buf_local_string(struct local_string *s, const void *buf,
+				size_t len)
+{
+	size_t nalloc = s->alloc;
+
+	if (s->idx + len > s->alloc) {
+		while (nalloc < s->idx + len)
+			nalloc *= 2;
+		if (s->buf == s->tmpbuf) {
+			s->buf = malloc(nalloc);
+			if (s->buf == NULL)
+				return -ENOMEM;
+			memcpy(s->buf, s->tmpbuf, s->idx);
+		} else {
+			char *ptr = realloc(s->buf, nalloc);
+			if (ptr == NULL)
+				return -ENOMEM;
+			s->buf = ptr;
+		}
+		s->alloc = nalloc;
+	}
+	memcpy(s->buf + s->idx, buf, len);
+	s->idx += len;
+	return 0;
+}
+
 static char *copy_local_string(struct local_string *s)
 {
 	char *dst = malloc(s->idx + 1);
@@ -998,6 +1277,33 @@ static char *copy_local_string(struct local_string *s)
 	return dst;
 }
 
+static inline bool freestring_delim(int c, int id)
+{
+	switch (c) {
+	case '.':
+		return id;
+	case ' ':
+	case '\f':
+	case '\t':
+	case '\n':
+	case '\r':
+	case '=':
+	case ',':
+	case ';':
+	case '{':
+	case '}':
+	case '[':
+	case ']':
+	case '\'':
+	case '"':
+	case '\\':
+	case '#':
+		return true;
+	default:
+		return false;
+	}
+}
+
 static int get_freestring(char **string, int id, input_t *input)
 {
 	struct local_string str;
@@ -1005,6 +1311,24 @@ static int get_freestring(char **string, int id, input_t *input)
 
 	init_local_string(&str);
 	while (1) {
+		struct filedesc *fd = input->current;
+		unsigned char *p = fd->ptr;
+
+		/* take the run of plain characters straight from the buffer */
+		if (!input->unget) {
+			while (p < fd->end && !freestring_delim(*p, id))
+				p++;
+			if (p > fd->ptr) {
+				if (add_buf_local_string(&str, fd->ptr, p - fd->ptr) < 0) {
+					c = -ENOMEM;
+					break;
+				}
+				fd->column += p - fd->ptr;
+				fd->ptr = p;
+				if (p == fd->end)
+					continue;
+			}
+		}
 		c = get_char(input);
 		if (c < 0) {
 			if (c == LOCAL_UNEXPECTED_EOF) {
@@ -1123,11 +1447,269 @@ static int get_string(char **string, int id, input_t *input)
 	}
 }
 
-static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
+static unsigned int config_hash(const char *id, int len)
 {
-	snd_config_t *n;
+	unsigned int h = 2166136261u;
+
+	for (; len < 0 ? *id : len-- > 0; id++)
+		h = (h ^ (unsigned char)*id) * 16777619u;
+	return h;
+}
+
+static void config_index_free(snd_config_t *config)
+{
+	free(config->u.compound.index);
+	config->u.compound.index = NULL;
+}
+
+/* (re)build the index of all children, dropped for duplicated ids */
+static void config_index_build(snd_config_t *config)
+{
+	struct snd_config_index *index;
+	snd_config_iterator_t i, next;
+	unsigned int size = SND_CONFIG_INDEX_MIN;
+
+	config_index_free(config);
+	while (size < config->u.compound.count * 2)
+		size *= 2;
+	index = calloc(1, sizeof(*index) + size * sizeof(index->buckets[0]));
+	if (!index)
+		return;		/* the search falls back to the list */
+	index->mask = size - 1;
+	config->u.compound.index = index;
+	snd_config_for_each(i, next, config) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		snd_config_t **b, *c;
+
+		if (!n->id)
+			goto _dup;
+		b = &index->buckets[config_hash(n->id, -1) & index->mask];
+		for (c = *b; c; c = c->hash_next)
+			if (!strcmp(c->id, n->id))
+				goto _dup;
+		n->hash_next = *b;
+		*b = n;
+		index->count++;
+	}
+	return;
+ _dup:
+	config_index_free(config);
+	config->u.compound.noindex = true;
+}
+
+/* account a child just linked to the list of parent */
+static void config_index_add(snd_config_t *parent, snd_config_t *child)
+{
+	struct snd_config_index *index;
+	snd_config_t **b, *c;
+
+	parent->u.compound.count++;
+	index = parent->u.compound.index;
+	if (!index) {
+		if (parent->u.compound.count >= SND_CONFIG_INDEX_MIN &&
+		    !parent->u.compound.noindex)
+			config_index_build(parent);
+		return;
+	}
+	if (parent->u.compound.count > index->mask + 1) {
+		config_index_build(parent);
+		return;
+	}
+	if (!child->id) {
+		config_index_free(parent);
+		parent->u.compound.noindex = true;
+		return;
+	}
+	b = &index->buckets[config_hash(child->id, -1) & index->mask];
+	for (c = *b; c; c = c->hash_next) {
+		if (!strcmp(c->id, child->id)) {
+			config_index_free(parent);
+			parent->u.compound.noindex = true;
+			return;
+		}
+	}
+	child->hash_next = *b;
+	*b = child;
+	index->count++;
+}
+
+/* account a child about to be unlinked from the list of its parent */
+static void config_index_del(snd_config_t *child)
+{
+	snd_config_t *parent = child->parent;
+	struct snd_config_index *index = parent->u.compound.index;
+	snd_config_t **b;
+
+	parent->u.compound.count--;
+	if (!index)
+		return;
+	b = &index->buckets[config_hash(child->id, -1) & index->mask];
+	for (; *b; b = &(*b)->hash_next) {
+		if (*b == child) {
+			*b = child->hash_next;
+			index->count--;
+			break;
+		}
+	}
+	child->hash_next = NULL;
+}
+
+static struct snd_config_arena *config_arena_new(void)
+{
+	struct snd_config_arena *arena = calloc(1, sizeof(*arena));
+
+	if (arena)
+		arena->refs = 1;
+	return arena;
+}
+
+static void config_arena_ref(struct snd_config_arena *arena)
+{
+	__atomic_add_fetch(&arena->refs, 1, __ATOMIC_RELAXED);
+}
+
+static void config_arena_unref(struct snd_config_arena *arena)
+{
+	struct snd_config_chunk *c, *next;
+
+	if (!arena || __atomic_sub_fetch(&arena->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+	for (c = arena->chunks; c; c = next) {
+		next = c->next;
+		free(c);
+	}
+	free(arena->strings);
+	free(arena);
+}
+
+static void *config_arena_alloc(struct snd_config_arena *arena, size_t size,
+				size_t align)
+{
+	struct snd_config_chunk *c;
+	size_t pad = -(uintptr_t)arena->ptr & (align - 1);
+	void *p;
+
+	if (arena->left >= size + pad) {
+		p = arena->ptr + pad;
+		arena->ptr += size + pad;
+		arena->left -= size + pad;
+		return p;
+	}
+	if (size > SND_CONFIG_ARENA_CHUNK / 4) {
+		/* own chunk, behind the current one */
+		c = malloc(sizeof(*c) + size);
+		if (!c)
+			return NULL;
+		c->size = size;
+		if (arena->chunks) {
+			c->next = arena->chunks->next;
+			arena->chunks->next = c;
+		} else {
+			c->next = NULL;
+			arena->chunks = c;
+		}
+		return c->data;
+	}
+	c = malloc(sizeof(*c) + SND_CONFIG_ARENA_CHUNK);
+	if (!c)
+		return NULL;
+	c->size = SND_CONFIG_ARENA_CHUNK;
+	c->next = arena->chunks;
+	arena->chunks = c;
+	arena->ptr = (char *)c->data + size;
+	arena->left = SND_CONFIG_ARENA_CHUNK - size;
+	return c->data;
+}
+
+/* returns the single copy of str in the arena */
+static const char *config_arena_intern(struct snd_config_arena *arena,
+				       const char *str)
+{
+	unsigned int h = config_hash(str, -1), k;
+	const char **strings;
+	size_t len;
+	char *p;
+
+	if (arena->count * 2 >= arena->mask) {
+		unsigned int size = arena->mask ? (arena->mask + 1) * 2 : 1024;
+
+		strings = calloc(size, sizeof(*strings));
+		if (!strings)
+			return NULL;
+		for (k = 0; arena->mask && k <= arena->mask; k++) {
+			unsigned int j;
+			if (!arena->strings[k])
+				continue;
+			j = config_hash(arena->strings[k], -1) & (size - 1);
+			while (strings[j])
+				j = (j + 1) & (size - 1);
+			strings[j] = arena->strings[k];
+		}
+		free(arena->strings);
+		arena->strings = strings;
+		arena->mask = size - 1;
+	}
+	for (k = h & arena->mask; arena->strings[k]; k = (k + 1) & arena->mask)
+		if (!strcmp(arena->strings[k], str))
+			return arena->strings[k];
+	len = strlen(str) + 1;
+	p = config_arena_alloc(arena, len, 1);
+	if (!p)
+		return NULL;
+	memcpy(p, str, len);
+	arena->strings[k] = p;
+	arena->count++;
+	return p;
+}
+
+static void config_free_id(snd_config_t *n)
+{
+	if (!(n->mem & CONFIG_MEM_ID))
+		free(n->id);
+	n->id = NULL;
+	n->mem &= ~CONFIG_MEM_ID;
+}
+
+static void config_free_string(snd_config_t *n)
+{
+	if (!(n->mem & CONFIG_MEM_STRING))
+		free(n->u.string);
+	n->u.string = NULL;
+	n->mem &= ~CONFIG_MEM_STRING;
+}
+
+/* stores the allocated string s, interned for nodes of an arena */
+static void config_take_string(snd_config_t *n, char *s)
+{
+	const char *str;
+
+	if (n->arena && s) {
+		str = config_arena_intern(n->arena, s);
+		if (str) {
+			free(s);
+			n->u.string = (char *)str;
+			n->mem |= CONFIG_MEM_STRING;
+			return;
+		}
+	}
+	n->u.string = s;
+}
+
+static int config_make(snd_config_t **config, char **id, snd_config_type_t type,
+		       struct snd_config_arena *arena)
+{
+	snd_config_t *n = NULL;
+	const char *str;
 	assert(config);
-	n = calloc(1, sizeof(*n));
+	if (arena) {
+		n = config_arena_alloc(arena, sizeof(*n), __alignof__(*n));
+		if (n) {
+			memset(n, 0, sizeof(*n));
+			n->mem = CONFIG_MEM_NODE;
+		}
+	}
+	if (n == NULL)
+		n = calloc(1, sizeof(*n));
 	if (n == NULL) {
 		if (*id) {
 			free(*id);
@@ -1135,8 +1717,15 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 		}
 		return -ENOMEM;
 	}
+	n->arena = arena;
 	if (id) {
-		n->id = *id;
+		str = arena && *id ? config_arena_intern(arena, *id) : NULL;
+		if (str) {
+			free(*id);
+			n->id = (char *)str;
+			n->mem |= CONFIG_MEM_ID;
+		} else
+			n->id = *id;
 		*id = NULL;
 	}
 	n->type = type;
@@ -1145,7 +1734,24 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 	*config = n;
 	return 0;
 }
-	
+
+static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
+{
+	return config_make(config, id, type, NULL);
+}
+
+/* top level node owning an arena for the nodes added by the parser */
+static int config_top_arena(snd_config_t **config)
+{
+	int err = _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND);
+
+	if (err < 0)
+		return err;
+	(*config)->arena = config_arena_new();
+	if ((*config)->arena)
+		(*config)->mem |= CONFIG_MEM_OWNER;
+	return 0;
+}
 
 static int _snd_config_make_add(snd_config_t **config, char **id,
 				snd_config_type_t type, snd_config_t *parent)
@@ -1153,11 +1759,12 @@ static int _snd_config_make_add(snd_config_t **config, char **id,
 	snd_config_t *n;
 	int err;
 	assert(parent->type == SND_CONFIG_TYPE_COMPOUND);
-	err = _snd_config_make(&n, id, type);
+	err = config_make(&n, id, type, parent->arena);
 	if (err < 0)
 		return err;
 	n->parent = parent;
 	list_add_tail(&n->list, &parent->u.compound.fields);
+	config_index_add(parent, n);
 	*config = n;
 	return 0;
 }
@@ -1166,6 +1773,24 @@ static int _snd_config_search(snd_config_t *config,
 			      const char *id, int len, snd_config_t **result)
 {
 	snd_config_iterator_t i, next;
+	struct snd_config_index *index = config->type == SND_CONFIG_TYPE_COMPOUND ?
+					 config->u.compound.index : NULL;
+
+	if (index) {
+		snd_config_t *n = index->buckets[config_hash(id, len) & index->mask];
+		for (; n; n = n->hash_next) {
+			if (len < 0) {
+				if (strcmp(n->id, id) != 0)
+					continue;
+			} else if (strncmp(n->id, id, (size_t) len) != 0 ||
+				   n->id[len] != '\0')
+				continue;
+			if (result)
+				*result = n;
+			return 0;
+		}
+		return -ENOENT;
+	}
 	snd_config_for_each(i, next, config) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		if (len < 0) {
@@ -1181,6 +1806,23 @@ static int _snd_config_search(snd_config_t *config,
 	return -ENOENT;
 }
 
+/* check if a child of parent other than except has the id */
+static bool config_has_id(snd_config_t *parent, const char *id,
+			  snd_config_t *except)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *n;
+
+	if (parent->u.compound.index)
+		return _snd_config_search(parent, id, -1, &n) == 0 && n != except;
+	snd_config_for_each(i, next, parent) {
+		n = snd_config_iterator_entry(i);
+		if (n != except && strcmp(id, n->id) == 0)
+			return true;
+	}
+	return false;
+}
+
 static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input, char **id, int skip)
 {
 	snd_config_t *n = *_n;
@@ -1251,8 +1893,8 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 		if (err < 0)
 			return err;
 	}
-	free(n->u.string);
-	n->u.string = s;
+	config_free_string(n);
+	config_take_string(n, s);
 	*_n = n;
 	return 0;
 }
@@ -1734,6 +2376,7 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		int err = snd_config_delete_compound_members(dst);
 		if (err < 0)
 			return err;
+		config_index_free(dst);
 	}
 	if (dst->type == SND_CONFIG_TYPE_COMPOUND &&
 	    src->type == SND_CONFIG_TYPE_COMPOUND) {	/* overwrite */
@@ -1745,15 +2388,25 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		src->u.compound.fields.next->prev = &dst->u.compound.fields;
 		src->u.compound.fields.prev->next = &dst->u.compound.fields;
 	}
-	free(dst->id);
+	if (dst->parent)
+		config_index_del(dst);
+	config_free_id(dst);
 	if (dst->type == SND_CONFIG_TYPE_STRING)
-		free(dst->u.string);
-	if (src->parent)	/* like snd_config_remove */
+		config_free_string(dst);
+	if (src->parent) {	/* like snd_config_remove */
+		config_index_del(src);
 		list_del(&src->list);
+	}
 	dst->id = src->id;
 	dst->type = src->type;
 	dst->u = src->u;
-	free(src);
+	dst->mem |= src->mem & (CONFIG_MEM_ID | CONFIG_MEM_STRING);
+	config_arena_unref(dst->shared);
+	dst->shared = src->shared;
+	if (dst->parent)
+		config_index_add(dst->parent, dst);
+	if (!(src->mem & CONFIG_MEM_NODE))
+		free(src);
 	return 0;
 }
 
@@ -1909,16 +2562,12 @@ int snd_config_get_id(const snd_config_t *config, const char **id)
  */
 int snd_config_set_id(snd_config_t *config, const char *id)
 {
-	snd_config_iterator_t i, next;
 	char *new_id;
 	assert(config);
 	if (id) {
 		if (config->parent) {
-			snd_config_for_each(i, next, config->parent) {
-				snd_config_t *n = snd_config_iterator_entry(i);
-				if (n != config && strcmp(id, n->id) == 0)
-					return -EEXIST;
-			}
+			if (config_has_id(config->parent, id, config))
+				return -EEXIST;
 		}
 		new_id = strdup(id);
 		if (!new_id)
@@ -1928,8 +2577,12 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 			return -EINVAL;
 		new_id = NULL;
 	}
-	free(config->id);
+	if (config->parent)
+		config_index_del(config);
+	config_free_id(config);
 	config->id = new_id;
+	if (config->parent)
+		config_index_add(config->parent, config);
 	return 0;
 }
 
@@ -1956,8 +2609,8 @@ int snd_config_top(snd_config_t **config)
 }
 
 #ifndef DOC_HIDDEN
-int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
-				  int override, const char * const *include_paths)
+static int config_load(snd_config_t *config, snd_input_t *in, int override,
+		       const char * const *include_paths, unsigned int *includes)
 {
 	int err;
 	input_t input;
@@ -1967,12 +2620,7 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 	fd = malloc(sizeof(*fd));
 	if (!fd)
 		return -ENOMEM;
-	fd->name = NULL;
-	fd->in = in;
-	fd->line = 1;
-	fd->column = 0;
-	fd->next = NULL;
-	INIT_LIST_HEAD(&fd->include_paths);
+	init_filedesc(fd, NULL, in, NULL);
 	if (include_paths) {
 		for (; *include_paths; include_paths++) {
 			err = add_include_path(fd, *include_paths);
@@ -1986,7 +2634,10 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 	}
 	input.current = fd;
 	input.unget = 0;
+	input.includes = 0;
 	err = parse_defs(config, &input, 0, override);
+	if (includes)
+		*includes += input.includes;
 	fd = input.current;
 	if (err < 0) {
 		const char *str;
@@ -2036,6 +2687,13 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 	free(fd);
 	return err;
 }
+
+int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
+				  int override, const char * const *include_paths,
+				  unsigned int *includes)
+{
+	return config_load(config, in, override, include_paths, includes);
+}
 #endif
 
 /**
@@ -2056,7 +2714,7 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
  */
 int snd_config_load(snd_config_t *config, snd_input_t *in)
 {
-	return _snd_config_load_with_include(config, in, 0, NULL);
+	return _snd_config_load_with_include(config, in, 0, NULL, NULL);
 }
 
 /**
@@ -2114,7 +2772,7 @@ int snd_config_load_string(snd_config_t **config, const char *s, size_t size)
  */
 int snd_config_load_override(snd_config_t *config, snd_input_t *in)
 {
-	return _snd_config_load_with_include(config, in, 1, NULL);
+	return _snd_config_load_with_include(config, in, 1, NULL, NULL);
 }
 
 /**
@@ -2143,17 +2801,14 @@ int snd_config_load_override(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_add(snd_config_t *parent, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	assert(parent && child);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
+	if (config_has_id(parent, child->id, NULL))
+		return -EEXIST;
 	child->parent = parent;
 	list_add_tail(&child->list, &parent->u.compound.fields);
+	config_index_add(parent, child);
 	return 0;
 }
 
@@ -2181,20 +2836,17 @@ int snd_config_add(snd_config_t *parent, snd_config_t *child)
  */
 int snd_config_add_after(snd_config_t *after, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	snd_config_t *parent;
 	assert(after && child);
 	parent = after->parent;
 	assert(parent);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
+	if (config_has_id(parent, child->id, NULL))
+		return -EEXIST;
 	child->parent = parent;
 	list_insert(&child->list, &after->list, after->list.next);
+	config_index_add(parent, child);
 	return 0;
 }
 
@@ -2222,20 +2874,17 @@ int snd_config_add_after(snd_config_t *after, snd_config_t *child)
  */
 int snd_config_add_before(snd_config_t *before, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	snd_config_t *parent;
 	assert(before && child);
 	parent = before->parent;
 	assert(parent);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
+	if (config_has_id(parent, child->id, NULL))
+		return -EEXIST;
 	child->parent = parent;
 	list_insert(&child->list, before->list.prev, &before->list);
+	config_index_add(parent, child);
 	return 0;
 }
 
@@ -2259,6 +2908,7 @@ static int _snd_config_array_merge(snd_config_t *dst, snd_config_t *src, int ind
 		}
 		sn->parent = dst;
 		list_add_tail(&sn->list, &dst->u.compound.fields);
+		config_index_add(dst, sn);
 	}
 	snd_config_delete(src);
 	return 0;
@@ -2291,8 +2941,7 @@ static int _snd_config_array_merge(snd_config_t *dst, snd_config_t *src, int ind
  */
 int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 {
-	snd_config_iterator_t di, si, dnext, snext;
-	bool found;
+	snd_config_iterator_t si, snext;
 	int err, array;
 
 	assert(dst);
@@ -2305,30 +2954,25 @@ int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 		return _snd_config_array_merge(dst, src, array);
 	snd_config_for_each(si, snext, src) {
 		snd_config_t *sn = snd_config_iterator_entry(si);
-		found = false;
-		snd_config_for_each(di, dnext, dst) {
-			snd_config_t *dn = snd_config_iterator_entry(di);
-			if (strcmp(sn->id, dn->id) == 0) {
-				if (override ||
-				    sn->type != SND_CONFIG_TYPE_COMPOUND ||
-				    dn->type != SND_CONFIG_TYPE_COMPOUND) {
-					err = snd_config_substitute(dn, sn);
-					if (err < 0)
-						return err;
-				} else {
-					err = snd_config_merge(dn, sn, 0);
-					if (err < 0)
-						return err;
-				}
-				found = true;
-				break;
+		snd_config_t *dn;
+		if (_snd_config_search(dst, sn->id, -1, &dn) == 0) {
+			if (override ||
+			    sn->type != SND_CONFIG_TYPE_COMPOUND ||
+			    dn->type != SND_CONFIG_TYPE_COMPOUND) {
+				err = snd_config_substitute(dn, sn);
+				if (err < 0)
+					return err;
+			} else {
+				err = snd_config_merge(dn, sn, 0);
+				if (err < 0)
+					return err;
 			}
-		}
-		if (!found) {
+		} else {
 			/* move config from src to dst */
 			snd_config_remove(sn);
 			sn->parent = dst;
 			list_add_tail(&sn->list, &dst->u.compound.fields);
+			config_index_add(dst, sn);
 		}
 	}
 	snd_config_delete(src);
@@ -2351,8 +2995,10 @@ int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 int snd_config_remove(snd_config_t *config)
 {
 	assert(config);
-	if (config->parent)
+	if (config->parent) {
+		config_index_del(config);
 		list_del(&config->list);
+	}
 	config->parent = NULL;
 	return 0;
 }
@@ -2382,15 +3028,14 @@ int snd_config_remove(snd_config_t *config)
 int snd_config_delete(snd_config_t *config)
 {
 	assert(config);
-	if (config->refcount > 0) {
-		config->refcount--;
+	if (config_unref(config))
 		return 0;
-	}
 	switch (config->type) {
 	case SND_CONFIG_TYPE_COMPOUND:
 	{
 		int err;
 		struct list_head *i;
+		config_index_free(config);
 		i = config->u.compound.fields.next;
 		while (i != &config->u.compound.fields) {
 			struct list_head *nexti = i->next;
@@ -2403,15 +3048,21 @@ int snd_config_delete(snd_config_t *config)
 		break;
 	}
 	case SND_CONFIG_TYPE_STRING:
-		free(config->u.string);
+		config_free_string(config);
 		break;
 	default:
 		break;
 	}
-	if (config->parent)
+	if (config->parent) {
+		config_index_del(config);
 		list_del(&config->list);
-	free(config->id);
-	free(config);
+	}
+	config_free_id(config);
+	if (config->mem & CONFIG_MEM_OWNER)
+		config_arena_unref(config->arena);
+	config_arena_unref(config->shared);
+	if (!(config->mem & CONFIG_MEM_NODE))
+		free(config);
 	return 0;
 }
 
@@ -3053,7 +3704,7 @@ int snd_config_set_string(snd_config_t *config, const char *value)
 	} else {
 		new_string = NULL;
 	}
-	free(config->u.string);
+	config_free_string(config);
 	config->u.string = new_string;
 	return 0;
 }
@@ -3141,7 +3792,7 @@ int snd_config_set_ascii(snd_config_t *config, const char *ascii)
 			char *ptr = strdup(ascii);
 			if (ptr == NULL)
 				return -ENOMEM;
-			free(config->u.string);
+			config_free_string(config);
 			config->u.string = ptr;
 		}
 		break;
@@ -3948,6 +4599,7 @@ struct finfo {
 	dev_t dev;
 	ino64_t ino;
 	time_t mtime;
+	off64_t size;
 };
 
 struct _snd_config_update {
@@ -4037,8 +4689,10 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 	if (func_conf)
 		snd_config_delete(func_conf);
 	if (err >= 0) {
+		long long start = config_profile_start();
 		snd_config_t *nroot;
 		err = func(root, config, &nroot, private_data);
+		config_profile_end(start, "hook", str);
 		if (err < 0)
 			SNDERR("function %s returned error: %s", func_name, snd_strerror(err));
 		snd_dlclose(h);
@@ -4110,6 +4764,7 @@ static int config_filename_filter(const struct dirent64 *dirent)
 
 static int config_file_open(snd_config_t *root, const char *filename)
 {
+	long long start = config_profile_start();
 	snd_input_t *in;
 	int err;
 
@@ -4121,6 +4776,7 @@ static int config_file_open(snd_config_t *root, const char *filename)
 			SNDERR("%s may be old or corrupted: consider to remove or fix it", filename);
 	} else
 		SNDERR("cannot access file %s", filename);
+	config_profile_end(start, "file", filename);
 
 	return err;
 }
@@ -4402,6 +5058,12 @@ static int _snd_config_hook_table(snd_config_t *root, snd_config_t *config, snd_
  * This function works like #snd_config_hook_load, but the files are
  * loaded once for each sound card.  The driver name is available with
  * the \c private_string function to customize the file name.
+ *
+ * Only the drivers reported by snd_determine_driver() for the present
+ * cards are loaded, and a driver shared by several cards is loaded once.
+ * The \c cards hooks of alsa.conf call this function on the first search
+ * through the \c cards node, so the tree holds no card configuration
+ * until a card device is opened.
  */
 int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data ATTRIBUTE_UNUSED)
 {
@@ -4485,46 +5147,384 @@ __fin_err:
 SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VERSION_HOOK);
 #endif
 
-/** 
- * \brief Updates a configuration tree by rereading the configuration files (if needed).
- * \param[in,out] _top Address of the handle to the top-level node.
- * \param[in,out] _update Address of a pointer to private update information.
- * \param[in] cfgs A list of configuration file names, delimited with ':'.
- *                 If \p cfgs is \c NULL, the default global
- *                 configuration file is used.
- * \return 0 if \a _top was up to date, 1 if the configuration files
- *         have been reread, otherwise a negative error code.
- *
- * The variables pointed to by \a _top and \a _update can be initialized
- * to \c NULL before the first call to this function.  The private
- * update information holds information about all used configuration
- * files that allows this function to detects changes to them; this data
- * can be freed with #snd_config_update_free.
- *
- * The global configuration files are specified in the environment variable
- * \c ALSA_CONFIG_PATH.
- *
- * \warning If the configuration tree is reread, all string pointers and
- * configuration node handles previously obtained from this tree become
- * invalid.
- *
- * \par Errors:
- * Any errors encountered when parsing the input or returned by hooks or
- * functions.
+#ifndef DOC_HIDDEN
+/*
+ * binary cache of the tree parsed from the global configuration files,
+ * before the hooks run; the hooks depend on the cards and on the user
+ * files and still run on every reread
  */
-int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, const char *cfgs)
+#define ALSA_CONFIG_CACHE_VAR	"ALSA_CONFIG_CACHE"
+#define CONFIG_CACHE_MAGIC	"ALSACFG"
+#define CONFIG_CACHE_VERSION	1
+#define CONFIG_CACHE_DEPTH	128
+#define CONFIG_CACHE_NULL	0xffffffffu	/* length of a NULL string */
+
+struct config_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t count;		/* count of the files */
+	uint64_t size;		/* size of the cache */
+};
+
+struct config_cache_out {
+	char *data;
+	size_t len, alloc;
+	int err;
+};
+
+struct config_cache_in {
+	const char *ptr, *end;
+};
+
+static void cache_put(struct config_cache_out *out, const void *data, size_t len)
+{
+	char *p;
+	size_t alloc;
+
+	if (out->err)
+		return;
+	if (out->len + len > out->alloc) {
+		for (alloc = out->alloc ? out->alloc : 16384;
+		     alloc < out->len + len; alloc *= 2)
+			;
+		p = realloc(out->data, alloc);
+		if (!p) {
+			out->err = -ENOMEM;
+			return;
+		}
+		out->data = p;
+		out->alloc = alloc;
+	}
+	memcpy(out->data + out->len, data, len);
+	out->len += len;
+}
+
+static void cache_put_u32(struct config_cache_out *out, uint32_t val)
+{
+	cache_put(out, &val, sizeof(val));
+}
+
+static void cache_put_u64(struct config_cache_out *out, uint64_t val)
+{
+	cache_put(out, &val, sizeof(val));
+}
+
+static void cache_put_str(struct config_cache_out *out, const char *str)
+{
+	uint32_t len = str ? strlen(str) : CONFIG_CACHE_NULL;
+
+	cache_put_u32(out, len);
+	if (str)
+		cache_put(out, str, len);
+}
+
+static void cache_put_node(struct config_cache_out *out, snd_config_t *n)
+{
+	snd_config_iterator_t i, next;
+	uint32_t hdr[2] = { n->type, 0 };	/* type and join */
+
+	if (n->type == SND_CONFIG_TYPE_COMPOUND)
+		hdr[1] = n->u.compound.join;
+	cache_put(out, hdr, sizeof(hdr));
+	cache_put_str(out, n->id);
+	switch (n->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		cache_put_u64(out, n->u.integer);
+		break;
+	case SND_CONFIG_TYPE_INTEGER64:
+		cache_put_u64(out, n->u.integer64);
+		break;
+	case SND_CONFIG_TYPE_REAL:
+		cache_put(out, &n->u.real, sizeof(n->u.real));
+		break;
+	case SND_CONFIG_TYPE_STRING:
+		cache_put_str(out, n->u.string);
+		break;
+	case SND_CONFIG_TYPE_COMPOUND:
+		cache_put_u32(out, n->u.compound.count);
+		snd_config_for_each(i, next, n)
+			cache_put_node(out, snd_config_iterator_entry(i));
+		break;
+	default:
+		out->err = -EINVAL;	/* pointers cannot be stored */
+		break;
+	}
+}
+
+static int cache_get(struct config_cache_in *in, void *data, size_t len)
+{
+	if ((size_t)(in->end - in->ptr) < len)
+		return -EINVAL;
+	memcpy(data, in->ptr, len);
+	in->ptr += len;
+	return 0;
+}
+
+static int cache_get_str(struct config_cache_in *in, char **str)
+{
+	uint32_t len;
+	int err;
+
+	*str = NULL;
+	err = cache_get(in, &len, sizeof(len));
+	if (err < 0 || len == CONFIG_CACHE_NULL)
+		return err;
+	if ((size_t)(in->end - in->ptr) < len)
+		return -EINVAL;
+	*str = malloc(len + 1);
+	if (!*str)
+		return -ENOMEM;
+	memcpy(*str, in->ptr, len);
+	(*str)[len] = '\0';
+	in->ptr += len;
+	return 0;
+}
+
+static int cache_get_children(struct config_cache_in *in, snd_config_t *parent,
+			      int depth);
+
+static int cache_get_node(struct config_cache_in *in, snd_config_t *parent,
+			  int depth)
+{
+	uint32_t hdr[2];
+	snd_config_t *n;
+	uint64_t val;
+	char *id, *str;
+	int err;
+
+	err = cache_get(in, hdr, sizeof(hdr));
+	if (err < 0)
+		return err;
+	switch (hdr[0]) {
+	case SND_CONFIG_TYPE_INTEGER:
+	case SND_CONFIG_TYPE_INTEGER64:
+	case SND_CONFIG_TYPE_REAL:
+	case SND_CONFIG_TYPE_STRING:
+	case SND_CONFIG_TYPE_COMPOUND:
+		break;
+	default:
+		return -EINVAL;
+	}
+	err = cache_get_str(in, &id);
+	if (err < 0)
+		return err;
+	if (!id)
+		return -EINVAL;
+	err = _snd_config_make_add(&n, &id, hdr[0], parent);
+	if (err < 0)
+		return err;
+	str = NULL;
+	switch (n->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		err = cache_get(in, &val, sizeof(val));
+		if (err >= 0)
+			n->u.integer = val;
+		break;
+	case SND_CONFIG_TYPE_INTEGER64:
+		err = cache_get(in, &val, sizeof(val));
+		if (err >= 0)
+			n->u.integer64 = val;
+		break;
+	case SND_CONFIG_TYPE_REAL:
+		err = cache_get(in, &n->u.real, sizeof(n->u.real));
+		break;
+	case SND_CONFIG_TYPE_STRING:
+		err = cache_get_str(in, &str);
+		config_take_string(n, str);
+		break;
+	default:
+		n->u.compound.join = hdr[1];
+		err = cache_get_children(in, n, depth + 1);
+		break;
+	}
+	return err;
+}
+
+static int cache_get_children(struct config_cache_in *in, snd_config_t *parent,
+			      int depth)
+{
+	uint32_t count;
+	int err;
+
+	if (depth > CONFIG_CACHE_DEPTH)
+		return -EINVAL;
+	err = cache_get(in, &count, sizeof(count));
+	while (err >= 0 && count--)
+		err = cache_get_node(in, parent, depth);
+	return err;
+}
+
+static int config_cache_check_file(struct config_cache_in *in, struct finfo *f)
+{
+	uint64_t dev, ino, size, mtime;
+	char *name;
+	int err;
+
+	if ((err = cache_get(in, &dev, sizeof(dev))) < 0 ||
+	    (err = cache_get(in, &ino, sizeof(ino))) < 0 ||
+	    (err = cache_get(in, &size, sizeof(size))) < 0 ||
+	    (err = cache_get(in, &mtime, sizeof(mtime))) < 0 ||
+	    (err = cache_get_str(in, &name)) < 0)
+		return err;
+	if (!name || strcmp(name, f->name) ||
+	    dev != (uint64_t)f->dev || ino != (uint64_t)f->ino ||
+	    size != (uint64_t)f->size || mtime != (uint64_t)f->mtime)
+		err = -ESTALE;
+	free(name);
+	return err;
+}
+
+/*
+ * build the tree from the cache if it was written for the same files;
+ * the cache must belong to the user as hooks can load any library
+ */
+static int config_cache_load(snd_config_t *top, snd_config_update_t *update)
+{
+	const char *path = getenv(ALSA_CONFIG_CACHE_VAR);
+	struct config_cache_header hdr;
+	struct config_cache_in in;
+	struct stat64 st;
+	unsigned int k;
+	void *map;
+	int fd, err;
+
+	if (!path || !*path)
+		return -ENOENT;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat64(fd, &st) < 0 || st.st_uid != geteuid() ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH)) ||
+	    (size_t)st.st_size < sizeof(hdr)) {
+		close(fd);
+		return -EINVAL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+	in.ptr = map;
+	in.end = in.ptr + st.st_size;
+	err = cache_get(&in, &hdr, sizeof(hdr));
+	if (err < 0)
+		goto _end;
+	if (memcmp(hdr.magic, CONFIG_CACHE_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != CONFIG_CACHE_VERSION ||
+	    hdr.count != update->count || hdr.size != (uint64_t)st.st_size) {
+		err = -ESTALE;
+		goto _end;
+	}
+	for (k = 0; k < update->count; k++) {
+		err = config_cache_check_file(&in, &update->finfo[k]);
+		if (err < 0)
+			goto _end;
+	}
+	err = cache_get_children(&in, top, 0);
+	if (err >= 0 && in.ptr != in.end)
+		err = -EINVAL;
+ _end:
+	munmap(map, st.st_size);
+	return err;
+}
+
+/*
+ * replace the cache atomically; files changed within the last second are
+ * skipped as a further change in the same second keeps the mtime
+ */
+static void config_cache_save(snd_config_t *top, snd_config_update_t *update)
+{
+	const char *path = getenv(ALSA_CONFIG_CACHE_VAR);
+	struct config_cache_out out = { NULL, 0, 0, 0 };
+	struct config_cache_header hdr;
+	snd_config_iterator_t i, next;
+	time_t now = time(NULL);
+	unsigned int k;
+	char *tmp;
+	int fd;
+
+	if (!path || !*path)
+		return;
+	for (k = 0; k < update->count; k++)
+		if (update->finfo[k].mtime >= now - 1)
+			return;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CONFIG_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = CONFIG_CACHE_VERSION;
+	hdr.count = update->count;
+	cache_put(&out, &hdr, sizeof(hdr));
+	for (k = 0; k < update->count; k++) {
+		struct finfo *f = &update->finfo[k];
+		cache_put_u64(&out, f->dev);
+		cache_put_u64(&out, f->ino);
+		cache_put_u64(&out, f->size);
+		cache_put_u64(&out, f->mtime);
+		cache_put_str(&out, f->name);
+	}
+	cache_put_u32(&out, top->u.compound.count);
+	snd_config_for_each(i, next, top)
+		cache_put_node(&out, snd_config_iterator_entry(i));
+	if (out.err)
+		goto _end;
+	hdr.size = out.len;
+	memcpy(out.data, &hdr, sizeof(hdr));
+
+	tmp = malloc(strlen(path) + 8);
+	if (!tmp)
+		goto _end;
+	sprintf(tmp, "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (fd >= 0) {
+		ssize_t n = write(fd, out.data, out.len);
+		if (close(fd) < 0 || n != (ssize_t)out.len ||
+		    rename(tmp, path) < 0)
+			unlink(tmp);
+	}
+	free(tmp);
+ _end:
+	free(out.data);
+}
+
+/* the binary form of the children of top, for the caches of other modules */
+int _snd_config_cache_encode(snd_config_t *top, void **data, size_t *size)
+{
+	struct config_cache_out out = { NULL, 0, 0, 0 };
+	snd_config_iterator_t i, next;
+
+	cache_put_u32(&out, top->u.compound.count);
+	snd_config_for_each(i, next, top)
+		cache_put_node(&out, snd_config_iterator_entry(i));
+	if (out.err) {
+		free(out.data);
+		return out.err;
+	}
+	*data = out.data;
+	*size = out.len;
+	return 0;
+}
+
+/* add the children stored by _snd_config_cache_encode() to top */
+int _snd_config_cache_decode(snd_config_t *top, const void *data, size_t size)
+{
+	struct config_cache_in in = { data, (const char *)data + size };
+	int err;
+
+	err = cache_get_children(&in, top, 0);
+	if (err >= 0 && in.ptr != in.end)
+		err = -EINVAL;
+	return err;
+}
+#endif /* DOC_HIDDEN */
+
+/* lists the configuration files with their status, NULL without any */
+static int config_update_files(const char *cfgs, snd_config_update_t **plocal)
 {
 	int err;
 	const char *configs, *c;
 	unsigned int k;
 	size_t l;
 	snd_config_update_t *local;
-	snd_config_update_t *update;
-	snd_config_t *top;
-	
-	assert(_top && _update);
-	top = *_top;
-	update = *_update;
+
+	*plocal = NULL;
 	configs = cfgs;
 	if (!configs) {
 		configs = getenv(ALSA_CONFIG_PATH_VAR);
@@ -4543,10 +5543,8 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			break;
 		c++;
 	}
-	if (k == 0) {
-		local = NULL;
-		goto _reread;
-	}
+	if (k == 0)
+		return 0;
 	local = (snd_config_update_t *)calloc(1, sizeof(snd_config_update_t));
 	if (!local)
 		return -ENOMEM;
@@ -4561,8 +5559,10 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		memcpy(name, c, l);
 		name[l] = 0;
 		err = snd_user_file(name, &local->finfo[k].name);
-		if (err < 0)
-			goto _end;
+		if (err < 0) {
+			snd_config_update_free(local);
+			return err;
+		}
 		c += l;
 		k++;
 		if (!*c)
@@ -4576,6 +5576,7 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			lf->dev = st.st_dev;
 			lf->ino = st.st_ino;
 			lf->mtime = st.st_mtime;
+			lf->size = st.st_size;
 		} else {
 			SNDERR("Cannot access file %s", lf->name);
 			free(lf->name);
@@ -4584,10 +5585,18 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			local->count--;
 		}
 	}
-	if (!update)
-		goto _reread;
-	if (local->count != update->count)
-		goto _reread;
+	*plocal = local;
+	return 0;
+}
+
+/* nonzero when the files of local did not change since update */
+static int config_update_same(snd_config_update_t *local,
+			      snd_config_update_t *update)
+{
+	unsigned int k;
+
+	if (!local || !update || local->count != update->count)
+		return 0;
 	for (k = 0; k < local->count; ++k) {
 		struct finfo *lf = &local->finfo[k];
 		struct finfo *uf = &update->finfo[k];
@@ -4595,46 +5604,38 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		    lf->dev != uf->dev ||
 		    lf->ino != uf->ino ||
 		    lf->mtime != uf->mtime)
-			goto _reread;
+			return 0;
 	}
-	err = 0;
+	return 1;
+}
 
- _end:
-	if (err < 0) {
-		if (top) {
-			snd_config_delete(top);
-			*_top = NULL;
-		}
-		if (update) {
-			snd_config_update_free(update);
-			*_update = NULL;
-		}
-	}
-	if (local)
-		snd_config_update_free(local);
-	return err;
+/* reads the files of local (can be NULL) into a new tree and runs its hooks */
+static int config_update_read(snd_config_update_t *local, snd_config_t **ptop)
+{
+	long long start = config_profile_start(), fstart;
+	snd_config_t *top;
+	unsigned int k, includes = 0;
+	int err;
 
- _reread:
- 	*_top = NULL;
- 	*_update = NULL;
- 	if (update) {
- 		snd_config_update_free(update);
- 		update = NULL;
- 	}
-	if (top) {
-		snd_config_delete(top);
-		top = NULL;
-	}
-	err = snd_config_top(&top);
+	err = config_top_arena(&top);
 	if (err < 0)
-		goto _end;
+		return err;
 	if (!local)
 		goto _skip;
+	fstart = config_profile_start();
+	if (config_cache_load(top, local) >= 0) {
+		config_profile_end(fstart, "cache", getenv(ALSA_CONFIG_CACHE_VAR));
+		goto _skip;
+	}
+	err = snd_config_delete_compound_members(top);
+	if (err < 0)
+		goto _end;
 	for (k = 0; k < local->count; ++k) {
 		snd_input_t *in;
+		fstart = config_profile_start();
 		err = snd_input_stdio_open(&in, local->finfo[k].name, "r");
 		if (err >= 0) {
-			err = snd_config_load(top, in);
+			err = config_load(top, in, 0, NULL, &includes);
 			snd_input_close(in);
 			if (err < 0) {
 				SNDERR("%s may be old or corrupted: consider to remove or fix it", local->finfo[k].name);
@@ -4643,18 +5644,392 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		} else {
 			SNDERR("cannot access file %s", local->finfo[k].name);
 		}
+		config_profile_end(fstart, "file", local->finfo[k].name);
 	}
+	if (!includes)
+		config_cache_save(top, local);
  _skip:
 	err = snd_config_hooks(top, NULL);
 	if (err < 0) {
 		SNDERR("hooks failed, removing configuration");
 		goto _end;
 	}
+	config_profile_end(start, "update", NULL);
+	config_profile_tree(top);
+	*ptop = top;
+	return 0;
+ _end:
+	snd_config_delete(top);
+	return err;
+}
+
+#if defined(__linux__)
+
+#define ALSA_CONFIG_WATCH_VAR	"ALSA_CONFIG_WATCH"
+
+/*
+ * With ALSA_CONFIG_WATCH set, the directories of the global configuration
+ * files are watched with inotify, and the files are only checked again
+ * after an event for one of them.  The watch belongs to the process that
+ * set it up and to the value of ALSA_CONFIG_PATH it was set up for.
+ * It is changed with the write lock held, the readers use it with the
+ * read lock.
+ */
+struct config_watch_file {
+	int wd;			/* of the directory */
+	char *name;		/* in the directory */
+};
+
+static struct {
+	int fd;
+	pid_t pid;
+	int dirty;
+	char *path;		/* ALSA_CONFIG_PATH, NULL when unset */
+	unsigned int count;
+	struct config_watch_file *files;
+} snd_config_watch = { .fd = -1 };
+
+static void config_watch_stop(void)
+{
+	unsigned int k;
+
+	if (snd_config_watch.fd >= 0)
+		close(snd_config_watch.fd);
+	snd_config_watch.fd = -1;
+	for (k = 0; k < snd_config_watch.count; k++)
+		free(snd_config_watch.files[k].name);
+	free(snd_config_watch.files);
+	snd_config_watch.files = NULL;
+	snd_config_watch.count = 0;
+	free(snd_config_watch.path);
+	snd_config_watch.path = NULL;
+}
+
+static int config_watch_add(const char *file)
+{
+	struct config_watch_file *files, *f;
+	struct stat st;
+	const char *base = strrchr(file, '/');
+	char *dir;
+
+	/* a symlink can change without an event in the watched directory */
+	if (!base || (lstat(file, &st) == 0 && S_ISLNK(st.st_mode)))
+		return -EINVAL;
+	files = realloc(snd_config_watch.files,
+			(snd_config_watch.count + 1) * sizeof(*files));
+	if (!files)
+		return -ENOMEM;
+	snd_config_watch.files = files;
+	f = &files[snd_config_watch.count];
+	f->name = strdup(base + 1);
+	if (!f->name)
+		return -ENOMEM;
+	dir = strndup(file, base > file ? (size_t)(base - file) : 1);
+	if (!dir) {
+		free(f->name);
+		return -ENOMEM;
+	}
+	f->wd = inotify_add_watch(snd_config_watch.fd, dir,
+				  IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+				  IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+				  IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+	free(dir);
+	if (f->wd < 0) {
+		free(f->name);
+		return -errno;
+	}
+	snd_config_watch.count++;
+	return 0;
+}
+
+/* (re)starts the watch of the files in cfgs of snd_config_update_r() */
+static void config_watch_start(void)
+{
+	const char *path = getenv(ALSA_CONFIG_PATH_VAR);
+	const char *env = getenv(ALSA_CONFIG_WATCH_VAR);
+	const char *configs, *c;
+	size_t l;
+	int err;
+
+	snd_config_wrlock();
+	config_watch_stop();
+	if (!env || !*env || *env == '0')
+		goto _unlock;
+	if (path && !*path)
+		path = NULL;
+	configs = path;
+	if (!configs) {
+		const char *topdir = snd_config_topdir();
+		char *s = alloca(strlen(topdir) +
+				 strlen("alsa.conf") + 2);
+		sprintf(s, "%s/alsa.conf", topdir);
+		configs = s;
+	}
+	snd_config_watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (snd_config_watch.fd < 0)
+		goto _unlock;
+	snd_config_watch.pid = getpid();
+	if (path) {
+		snd_config_watch.path = strdup(path);
+		if (!snd_config_watch.path)
+			goto _error;
+	}
+	for (c = configs; (l = strcspn(c, ": ")) > 0; ) {
+		char name[l + 1], *file;
+		memcpy(name, c, l);
+		name[l] = 0;
+		err = snd_user_file(name, &file);
+		if (err < 0)
+			goto _error;
+		err = config_watch_add(file);
+		free(file);
+		if (err < 0)
+			goto _error;
+		c += l;
+		if (!*c)
+			break;
+		c++;
+	}
+	__atomic_store_n(&snd_config_watch.dirty, 0, __ATOMIC_RELEASE);
+	goto _unlock;
+ _error:
+	config_watch_stop();
+ _unlock:
+	snd_config_wrunlock();
+}
+
+static bool config_watch_event(const struct inotify_event *ev)
+{
+	unsigned int k;
+
+	if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF |
+			IN_MOVE_SELF | IN_UNMOUNT))
+		return true;
+	for (k = 0; k < snd_config_watch.count; k++) {
+		struct config_watch_file *f = &snd_config_watch.files[k];
+		if (f->wd == ev->wd && ev->len && strcmp(f->name, ev->name) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * true when the watched files did not change, with the read lock held;
+ * false also without a usable watch
+ */
+static bool config_watch_clean(void)
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const char *path = getenv(ALSA_CONFIG_PATH_VAR);
+	ssize_t len;
+	char *p;
+
+	if (snd_config_watch.fd < 0 ||
+	    __atomic_load_n(&snd_config_watch.dirty, __ATOMIC_ACQUIRE))
+		return false;
+	if (path && !*path)
+		path = NULL;
+	if (!path != !snd_config_watch.path ||
+	    (path && strcmp(path, snd_config_watch.path) != 0) ||
+	    snd_config_watch.pid != getpid())
+		return false;
+	while ((len = read(snd_config_watch.fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+			if (config_watch_event(ev))
+				__atomic_store_n(&snd_config_watch.dirty, 1,
+						 __ATOMIC_RELEASE);
+			p += sizeof(*ev) + ev->len;
+		}
+	}
+	return !__atomic_load_n(&snd_config_watch.dirty, __ATOMIC_ACQUIRE);
+}
+
+static inline bool config_watch_active(void)
+{
+	return __atomic_load_n(&snd_config_watch.fd, __ATOMIC_RELAXED) >= 0;
+}
+
+#else
+
+static inline void config_watch_stop(void) { }
+static inline void config_watch_start(void) { }
+static inline bool config_watch_clean(void) { return false; }
+static inline bool config_watch_active(void) { return false; }
+
+#endif
+
+/** 
+ * \brief Updates a configuration tree by rereading the configuration files (if needed).
+ * \param[in,out] _top Address of the handle to the top-level node.
+ * \param[in,out] _update Address of a pointer to private update information.
+ * \param[in] cfgs A list of configuration file names, delimited with ':'.
+ *                 If \p cfgs is \c NULL, the default global
+ *                 configuration file is used.
+ * \return 0 if \a _top was up to date, 1 if the configuration files
+ *         have been reread, otherwise a negative error code.
+ *
+ * The variables pointed to by \a _top and \a _update can be initialized
+ * to \c NULL before the first call to this function.  The private
+ * update information holds information about all used configuration
+ * files that allows this function to detects changes to them; this data
+ * can be freed with #snd_config_update_free.
+ *
+ * The global configuration files are specified in the environment variable
+ * \c ALSA_CONFIG_PATH.
+ *
+ * When the environment variable \c ALSA_CONFIG_CACHE names a file, the
+ * tree parsed from the configuration files is stored there in a binary
+ * form, and later rereads of the same unchanged files map it instead of
+ * parsing them again.  The hooks run on every reread.  Files with include
+ * directives are not stored, and the cache must belong to the user.
+ *
+ * When the environment variable \c ALSA_CONFIG_PROFILE is set, the time
+ * spent reading each file, in each hook and in each \c \@func evaluation
+ * is reported together with the node count and memory use of the read
+ * tree, to the file named by the variable when it is an absolute path,
+ * to stderr otherwise.
+ *
+ * The nodes parsed from the files are allocated in chunks owned by the
+ * top-level node and released together with it.  Take them out of the
+ * tree with #snd_config_copy, not by moving them to another tree.
+ *
+ * \warning If the configuration tree is reread, all string pointers and
+ * configuration node handles previously obtained from this tree become
+ * invalid.
+ *
+ * \par Errors:
+ * Any errors encountered when parsing the input or returned by hooks or
+ * functions.
+ */
+int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, const char *cfgs)
+{
+	int err;
+	snd_config_update_t *local;
+	snd_config_update_t *update;
+	snd_config_t *top;
+	
+	assert(_top && _update);
+	top = *_top;
+	update = *_update;
+	err = config_update_files(cfgs, &local);
+	if (err < 0) {
+		if (top) {
+			snd_config_delete(top);
+			*_top = NULL;
+		}
+		if (update) {
+			snd_config_update_free(update);
+			*_update = NULL;
+		}
+		return err;
+	}
+	if (config_update_same(local, update)) {
+		snd_config_update_free(local);
+		return 0;
+	}
+ 	*_top = NULL;
+ 	*_update = NULL;
+ 	if (update)
+ 		snd_config_update_free(update);
+	if (top)
+		snd_config_delete(top);
+	err = config_update_read(local, &top);
+	if (err < 0) {
+		if (local)
+			snd_config_update_free(local);
+		return err;
+	}
 	*_top = top;
 	*_update = local;
 	return 1;
 }
 
+/*
+ * Rereads the global configuration when the files changed and takes a
+ * reference of it for top when not NULL.  The check and the reference
+ * only need the shared lock, the tree is replaced as a whole and the
+ * previous one lives on until its last reference is dropped.
+ */
+static int snd_config_update_global(snd_config_t **top)
+{
+	snd_config_update_t *local, *old_update;
+	snd_config_t *new_top = NULL, *old_top;
+	int err;
+
+	if (config_watch_active()) {
+		snd_config_rdlock();
+		if (snd_config && config_watch_clean()) {
+			if (top) {
+				config_ref(snd_config);
+				*top = snd_config;
+			}
+			snd_config_rdunlock();
+			return 0;
+		}
+		snd_config_rdunlock();
+		/* an event, check the files with the lock below */
+		err = -EAGAIN;
+		local = NULL;
+	} else {
+		err = config_update_files(NULL, &local);
+	}
+	if (err >= 0) {
+		snd_config_rdlock();
+		if (snd_config &&
+		    config_update_same(local, snd_config_global_update)) {
+			if (top) {
+				config_ref(snd_config);
+				*top = snd_config;
+			}
+			snd_config_rdunlock();
+			snd_config_update_free(local);
+			return 0;
+		}
+		snd_config_rdunlock();
+	}
+
+	snd_config_lock();
+	/* watch before the check, the changes after it cause an event */
+	config_watch_start();
+	if (err == -EAGAIN)
+		err = config_update_files(NULL, &local);
+	/* the globals change only with this lock held */
+	if (err >= 0 && snd_config &&
+	    config_update_same(local, snd_config_global_update)) {
+		if (top) {
+			config_ref(snd_config);
+			*top = snd_config;
+		}
+		snd_config_unlock();
+		snd_config_update_free(local);
+		return 0;
+	}
+	if (err >= 0) {
+		err = config_update_read(local, &new_top);
+		if (err < 0 && local) {
+			snd_config_update_free(local);
+			local = NULL;
+		}
+	}
+	snd_config_wrlock();
+	old_top = snd_config;
+	old_update = snd_config_global_update;
+	snd_config = new_top;
+	snd_config_global_update = err < 0 ? NULL : local;
+	if (top && new_top) {
+		config_ref(new_top);
+		*top = new_top;
+	}
+	snd_config_wrunlock();
+	snd_config_unlock();
+	if (old_top)
+		snd_config_delete(old_top);
+	if (old_update)
+		snd_config_update_free(old_update);
+	return err < 0 ? err : 1;
+}
+
 /** 
  * \brief Updates #snd_config by rereading the global configuration files (if needed).
  * \return 0 if #snd_config was up to date, 1 if #snd_config was
@@ -4666,6 +6041,12 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
  * For safer operations, use #snd_config_update_ref and release the config
  * via #snd_config_unref.
  *
+ * The files are checked for changes with stat() on every call.  On Linux,
+ * with the environment variable \c ALSA_CONFIG_WATCH set to a nonzero
+ * value, their directories are watched with inotify instead and the files
+ * are only checked after a change was reported, which suits processes
+ * opening devices often.  Files given as symbolic links are not watched.
+ *
  * \par Errors:
  * Any errors encountered when parsing the input or returned by hooks or
  * functions.
@@ -4675,12 +6056,7 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
  */
 int snd_config_update(void)
 {
-	int err;
-
-	snd_config_lock();
-	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
-	snd_config_unlock();
-	return err;
+	return snd_config_update_global(NULL);
 }
 
 /**
@@ -4692,7 +6068,8 @@ int snd_config_update(void)
  * so that the obtained tree won't be deleted until unreferenced by
  * #snd_config_unref.
  *
- * This function is supposed to be thread-safe.
+ * This function is supposed to be thread-safe.  While the configuration
+ * files are unchanged, concurrent callers do not wait for each other.
  */
 int snd_config_update_ref(snd_config_t **top)
 {
@@ -4700,19 +6077,16 @@ int snd_config_update_ref(snd_config_t **top)
 
 	if (top)
 		*top = NULL;
-	snd_config_lock();
-	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
-	if (err >= 0) {
-		if (snd_config) {
-			if (top) {
-				snd_config->refcount++;
-				*top = snd_config;
-			}
-		} else {
+	err = snd_config_update_global(top);
+	if (err >= 0 && top && !*top)
+		err = -ENODEV;
+	else if (err >= 0 && !top) {
+		/* no reference taken, check the tree itself */
+		snd_config_rdlock();
+		if (!snd_config)
 			err = -ENODEV;
-		}
+		snd_config_rdunlock();
 	}
-	snd_config_unlock();
 	return err;
 }
 
@@ -4725,10 +6099,8 @@ int snd_config_update_ref(snd_config_t **top)
  */
 void snd_config_ref(snd_config_t *cfg)
 {
-	snd_config_lock();
 	if (cfg)
-		cfg->refcount++;
-	snd_config_unlock();
+		config_ref(cfg);
 }
 
 /**
@@ -4745,10 +6117,8 @@ void snd_config_ref(snd_config_t *cfg)
  */
 void snd_config_unref(snd_config_t *cfg)
 {
-	snd_config_lock();
 	if (cfg)
 		snd_config_delete(cfg);
-	snd_config_unlock();
 }
 
 /** 
@@ -4780,14 +6150,26 @@ int snd_config_update_free(snd_config_update_t *update)
  */
 int snd_config_update_free_global(void)
 {
+	snd_config_t *top;
+	snd_config_update_t *update;
+
 	snd_config_lock();
-	if (snd_config)
-		snd_config_delete(snd_config);
+	snd_config_wrlock();
+	top = snd_config;
+	update = snd_config_global_update;
 	snd_config = NULL;
-	if (snd_config_global_update)
-		snd_config_update_free(snd_config_global_update);
 	snd_config_global_update = NULL;
+	config_watch_stop();
+	snd_config_wrunlock();
 	snd_config_unlock();
+	if (top)
+		snd_config_delete(top);
+	if (update)
+		snd_config_update_free(update);
+	_snd_device_name_hint_cache_free();
+#ifdef BUILD_PCM
+	_snd_pcm_open_cache_free();
+#endif
 	/* FIXME: better to place this in another place... */
 	snd_dlobj_cache_cleanup();
 
@@ -4929,6 +6311,68 @@ static int snd_config_walk(snd_config_t *src,
 	return err;
 }
 
+/* arena holding the interned strings of n, NULL when ambiguous */
+static struct snd_config_arena *config_strings_arena(snd_config_t *n)
+{
+	if (n->shared)
+		return n->arena ? NULL : n->shared;
+	return n->arena;
+}
+
+/*
+ * copies src without its children, the interned strings are not
+ * duplicated, the copy references them and holds their arena
+ */
+static int config_copy_node(snd_config_t **dst, snd_config_t *src)
+{
+	struct snd_config_arena *arena = config_strings_arena(src);
+	unsigned int mem = arena ? src->mem & (CONFIG_MEM_ID | CONFIG_MEM_STRING) : 0;
+	snd_config_t *n;
+	char *id = NULL;
+	int err;
+
+	if (src->id && !(mem & CONFIG_MEM_ID)) {
+		id = strdup(src->id);
+		if (!id)
+			return -ENOMEM;
+	}
+	err = _snd_config_make(&n, &id, src->type);
+	if (err < 0)
+		return err;
+	if (mem & CONFIG_MEM_ID)
+		n->id = src->id;
+	switch (src->type) {
+	case SND_CONFIG_TYPE_COMPOUND:
+		n->u.compound.join = src->u.compound.join;
+		break;
+	case SND_CONFIG_TYPE_INTEGER:
+	case SND_CONFIG_TYPE_INTEGER64:
+	case SND_CONFIG_TYPE_REAL:
+		n->u = src->u;
+		break;
+	case SND_CONFIG_TYPE_STRING:
+		if (mem & CONFIG_MEM_STRING) {
+			n->u.string = src->u.string;
+		} else if (src->u.string) {
+			n->u.string = strdup(src->u.string);
+			if (!n->u.string) {
+				snd_config_delete(n);
+				return -ENOMEM;
+			}
+		}
+		break;
+	default:
+		assert(0);
+	}
+	if (mem) {
+		n->mem |= mem;
+		n->shared = arena;
+		config_arena_ref(arena);
+	}
+	*dst = n;
+	return 0;
+}
+
 static int _snd_config_copy(snd_config_t *src,
 			    snd_config_t *root ATTRIBUTE_UNUSED,
 			    snd_config_t **dst,
@@ -4937,56 +6381,12 @@ static int _snd_config_copy(snd_config_t *src,
 			    void *private_data ATTRIBUTE_UNUSED)
 {
 	int err;
-	const char *id = src->id;
-	snd_config_type_t type = snd_config_get_type(src);
 	switch (pass) {
 	case SND_CONFIG_WALK_PASS_PRE:
-		err = snd_config_make_compound(dst, id, src->u.compound.join);
-		if (err < 0)
-			return err;
-		break;
 	case SND_CONFIG_WALK_PASS_LEAF:
-		err = snd_config_make(dst, id, type);
+		err = config_copy_node(dst, src);
 		if (err < 0)
 			return err;
-		switch (type) {
-		case SND_CONFIG_TYPE_INTEGER:
-		{
-			long v;
-			err = snd_config_get_integer(src, &v);
-			assert(err >= 0);
-			snd_config_set_integer(*dst, v);
-			break;
-		}
-		case SND_CONFIG_TYPE_INTEGER64:
-		{
-			long long v;
-			err = snd_config_get_integer64(src, &v);
-			assert(err >= 0);
-			snd_config_set_integer64(*dst, v);
-			break;
-		}
-		case SND_CONFIG_TYPE_REAL:
-		{
-			double v;
-			err = snd_config_get_real(src, &v);
-			assert(err >= 0);
-			snd_config_set_real(*dst, v);
-			break;
-		}
-		case SND_CONFIG_TYPE_STRING:
-		{
-			const char *s;
-			err = snd_config_get_string(src, &s);
-			assert(err >= 0);
-			err = snd_config_set_string(*dst, s);
-			if (err < 0)
-				return err;
-			break;
-		}
-		default:
-			assert(0);
-		}
 		break;
 	default:
 		break;
@@ -5043,7 +6443,7 @@ static int _snd_config_expand(snd_config_t *src,
 	{
 		if (id && strcmp(id, "@args") == 0)
 			return 0;
-		err = snd_config_make_compound(dst, id, src->u.compound.join);
+		err = config_copy_node(dst, src);
 		if (err < 0)
 			return err;
 		break;
@@ -5051,35 +6451,12 @@ static int _snd_config_expand(snd_config_t *src,
 	case SND_CONFIG_WALK_PASS_LEAF:
 		switch (type) {
 		case SND_CONFIG_TYPE_INTEGER:
-		{
-			long v;
-			err = snd_config_get_integer(src, &v);
-			assert(err >= 0);
-			err = snd_config_imake_integer(dst, id, v);
-			if (err < 0)
-				return err;
-			break;
-		}
 		case SND_CONFIG_TYPE_INTEGER64:
-		{
-			long long v;
-			err = snd_config_get_integer64(src, &v);
-			assert(err >= 0);
-			err = snd_config_imake_integer64(dst, id, v);
-			if (err < 0)
-				return err;
-			break;
-		}
 		case SND_CONFIG_TYPE_REAL:
-		{
-			double v;
-			err = snd_config_get_real(src, &v);
-			assert(err >= 0);
-			err = snd_config_imake_real(dst, id, v);
+			err = config_copy_node(dst, src);
 			if (err < 0)
 				return err;
 			break;
-		}
 		case SND_CONFIG_TYPE_STRING:
 		{
 			const char *s;
@@ -5097,7 +6474,7 @@ static int _snd_config_expand(snd_config_t *src,
 					return err;
 				}
 			} else {
-				err = snd_config_imake_string(dst, id, s);
+				err = config_copy_node(dst, src);
 				if (err < 0)
 					return err;
 			}
@@ -5113,6 +6490,202 @@ static int _snd_config_expand(snd_config_t *src,
 	return 1;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * The environment variables, the cards and the functions an expansion
+ * depends on, so that its result can be kept and reused as long as they
+ * do not change.  Only the functions of alsa-lib known to depend on
+ * nothing else than the configuration, the environment and the cards
+ * are tracked, any other one makes the result volatile.
+ */
+struct config_dep_env {
+	char *var;
+	char *value;			/* NULL when not set */
+};
+
+struct _snd_config_deps {
+	int unstable;
+	int cards;			/* the device directory was stat'ed */
+	int dir_valid;
+	struct timespec dir_mtime;
+	struct timespec dir_ctime;
+	unsigned int env_count;
+	struct config_dep_env *env;
+};
+
+#ifdef HAVE___THREAD
+static __thread snd_config_deps_t *config_deps;
+
+static const char * const config_deps_funcs[] = {
+	"concat", "iadd", "imul", "datadir", "refer",
+	"getenv", "igetenv",
+	"card_inum", "card_driver", "card_id", "card_name",
+};
+#endif
+
+void _snd_config_deps_free(snd_config_deps_t *deps)
+{
+	unsigned int k;
+
+	if (!deps)
+		return;
+	for (k = 0; k < deps->env_count; k++) {
+		free(deps->env[k].var);
+		free(deps->env[k].value);
+	}
+	free(deps->env);
+	free(deps);
+}
+
+/*
+ * Starts to record the dependencies of the expansions made by this
+ * thread.  Returns NULL when they cannot be recorded.
+ */
+snd_config_deps_t *_snd_config_deps_start(void)
+{
+#ifdef HAVE___THREAD
+	snd_config_deps_t *deps;
+
+	if (config_deps)
+		return NULL;
+	deps = calloc(1, sizeof(*deps));
+	config_deps = deps;
+	return deps;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Stops the recording, returns 0 when the result only depends on what
+ * _snd_config_deps_check() verifies.
+ */
+int _snd_config_deps_stop(snd_config_deps_t *deps)
+{
+#ifdef HAVE___THREAD
+	if (deps && config_deps == deps) {
+		config_deps = NULL;
+		return deps->unstable ? -EAGAIN : 0;
+	}
+#endif
+	return -EINVAL;
+}
+
+static int config_deps_stat(struct timespec *mtime, struct timespec *ctime)
+{
+	struct stat st;
+
+	if (stat(ALSA_DEVICE_DIRECTORY, &st) < 0)
+		return 0;
+	*mtime = st.st_mtim;
+	*ctime = st.st_ctim;
+	return 1;
+}
+
+static int config_deps_ts_equal(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+/*
+ * Returns 1 when the recorded environment and cards are the same.  The
+ * cards are created and removed together with their nodes in the device
+ * directory, so its stat() catches hotplug, as for the name hints.
+ */
+int _snd_config_deps_check(const snd_config_deps_t *deps)
+{
+	struct timespec mtime, ctime;
+	const char *value;
+	unsigned int k;
+
+	for (k = 0; k < deps->env_count; k++) {
+		value = getenv(deps->env[k].var);
+		if (!value != !deps->env[k].value ||
+		    (value && strcmp(value, deps->env[k].value)))
+			return 0;
+	}
+	if (deps->cards) {
+		if (config_deps_stat(&mtime, &ctime) != deps->dir_valid)
+			return 0;
+		if (deps->dir_valid &&
+		    (!config_deps_ts_equal(&mtime, &deps->dir_mtime) ||
+		     !config_deps_ts_equal(&ctime, &deps->dir_ctime)))
+			return 0;
+	}
+	return 1;
+}
+
+/* the result depends on something not tracked */
+void _snd_config_dep_volatile(void)
+{
+#ifdef HAVE___THREAD
+	if (config_deps)
+		config_deps->unstable = 1;
+#endif
+}
+
+/* records a getenv() made by a function and its result */
+void _snd_config_dep_env(const char *var, const char *value)
+{
+#ifdef HAVE___THREAD
+	snd_config_deps_t *deps = config_deps;
+	struct config_dep_env *env;
+	unsigned int k;
+
+	if (!deps || deps->unstable)
+		return;
+	for (k = 0; k < deps->env_count; k++)
+		if (strcmp(deps->env[k].var, var) == 0)
+			return;
+	env = realloc(deps->env, (deps->env_count + 1) * sizeof(*env));
+	if (!env)
+		goto nomem;
+	deps->env = env;
+	env = &env[deps->env_count];
+	env->var = strdup(var);
+	env->value = value ? strdup(value) : NULL;
+	if (!env->var || (value && !env->value)) {
+		free(env->var);
+		free(env->value);
+		goto nomem;
+	}
+	deps->env_count++;
+	return;
+ nomem:
+	deps->unstable = 1;
+#endif
+}
+
+/* a function looks up a card, call it before the lookup */
+void _snd_config_dep_cards(void)
+{
+#ifdef HAVE___THREAD
+	snd_config_deps_t *deps = config_deps;
+
+	if (!deps || deps->cards)
+		return;
+	deps->cards = 1;
+	deps->dir_valid = config_deps_stat(&deps->dir_mtime, &deps->dir_ctime);
+#endif
+}
+
+static void config_dep_func(const char *lib, const char *func_name,
+			    const char *str)
+{
+#ifdef HAVE___THREAD
+	unsigned int k;
+
+	if (!config_deps || config_deps->unstable)
+		return;
+	if (!lib && !func_name)
+		for (k = 0; k < ARRAY_SIZE(config_deps_funcs); k++)
+			if (strcmp(str, config_deps_funcs[k]) == 0)
+				return;
+	config_deps->unstable = 1;
+#endif
+}
+#endif /* DOC_HIDDEN */
+
 static int _snd_config_evaluate(snd_config_t *src,
 				snd_config_t *root,
 				snd_config_t **dst ATTRIBUTE_UNUSED,
@@ -5170,6 +6743,7 @@ static int _snd_config_evaluate(snd_config_t *src,
 				SNDERR("Unknown field %s", id);
 			}
 		}
+		config_dep_func(lib, func_name, str);
 		if (!func_name) {
 			int len = 9 + strlen(str) + 1;
 			buf = malloc(len);
@@ -5199,8 +6773,10 @@ static int _snd_config_evaluate(snd_config_t *src,
 		if (func_conf)
 			snd_config_delete(func_conf);
 		if (err >= 0) {
+			long long start = config_profile_start();
 			snd_config_t *eval;
 			err = func(&eval, root, src, private_data);
+			config_profile_end(start, "func", str);
 			if (err < 0)
 				SNDERR("function %s returned error: %s", func_name, snd_strerror(err));
 			snd_dlclose(h);
@@ -5737,6 +7313,22 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 	return err;
 }
 
+/* true when a node of the subtree still has hooks to run */
+static bool config_has_hooks(snd_config_t *config)
+{
+	snd_config_iterator_t i, next;
+
+	if (config->type != SND_CONFIG_TYPE_COMPOUND)
+		return false;
+	snd_config_for_each(i, next, config) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		if ((n->id && strcmp(n->id, "@hooks") == 0) ||
+		    config_has_hooks(n))
+			return true;
+	}
+	return false;
+}
+
 /**
  * \brief Searches for a definition in a configuration tree, using
  *        aliases and expanding hooks and arguments.
@@ -5792,6 +7384,14 @@ int snd_config_search_definition(snd_config_t *config,
 		snd_config_unlock();
 		return err;
 	}
+	/*
+	 * the hooks on the path ran, the definition is not modified any
+	 * more unless it has hooks of its own, expand it without the lock
+	 */
+	if (!config_has_hooks(conf)) {
+		snd_config_unlock();
+		return snd_config_expand(conf, config, args, NULL, result);
+	}
 	err = snd_config_expand(conf, config, args, NULL, result);
 	snd_config_unlock();
 	return err;
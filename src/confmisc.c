@@ -71,6 +71,11 @@
       The result is a string.
 </UL>
 
+The card functions (card_driver, card_id, card_name and the card lookups
+by id) keep the information of each card once queried and only open the
+control device again when its device node changed, i.e. the card was
+removed or plugged in.
+
 */
 
 
@@ -314,6 +319,7 @@ int snd_func_getenv(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 					goto __error;
 				}
 				res = getenv(ptr);
+				_snd_config_dep_env(ptr, res);
 				if (res != NULL && *res != '\0')
 					goto __ok;
 				hit = 1;
@@ -751,20 +757,15 @@ SND_DLSYM_BUILD_VERSION(snd_func_private_integer, SND_CONFIG_DLSYM_VERSION_EVALU
 #ifndef DOC_HIDDEN
 int snd_determine_driver(int card, char **driver)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	char *res = NULL;
 	int err;
 
 	assert(card >= 0 && card <= SND_MAX_CARDS);
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
+	err = _snd_card_info(card, &info);
 	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
+		SNDERR("could not obtain the information of card %i: %s",
+		       card, snd_strerror(err));
 		goto __error;
 	}
 	res = strdup(snd_ctl_card_info_get_driver(&info));
@@ -775,8 +776,6 @@ int snd_determine_driver(int card, char **driver)
 		err = 0;
 	}
       __error:
-	if (ctl)
-		snd_ctl_close(ctl);
 	return err;
 }
 #endif
@@ -850,6 +849,7 @@ static int parse_card(snd_config_t *root, snd_config_t *src,
 		SNDERR("field card is not an integer or a string");
 		return err;
 	}
+	_snd_config_dep_cards();
 	card = snd_card_get_index(str);
 	if (card < 0)
 		SNDERR("cannot find card '%s'", str);
@@ -949,7 +949,6 @@ SND_DLSYM_BUILD_VERSION(snd_func_card_driver, SND_CONFIG_DLSYM_VERSION_EVALUATE)
 int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 		     snd_config_t *private_data)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	const char *id;
 	int card, err;
@@ -957,14 +956,10 @@ int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 	card = parse_card(root, src, private_data);
 	if (card < 0)
 		return card;
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
+	err = _snd_card_info(card, &info);
 	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
+		SNDERR("could not obtain the information of card %i: %s",
+		       card, snd_strerror(err));
 		goto __error;
 	}
 	err = snd_config_get_id(src, &id);
@@ -972,8 +967,6 @@ int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 		err = snd_config_imake_string(dst, id,
 					      snd_ctl_card_info_get_id(&info));
       __error:
-      	if (ctl)
-      		snd_ctl_close(ctl);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -1000,7 +993,6 @@ SND_DLSYM_BUILD_VERSION(snd_func_card_id, SND_CONFIG_DLSYM_VERSION_EVALUATE);
 int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 		       snd_config_t *src, snd_config_t *private_data)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	const char *id;
 	int card, err;
@@ -1008,14 +1000,10 @@ int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 	card = parse_card(root, src, private_data);
 	if (card < 0)
 		return card;
-	err = open_ctl(card, &ctl);
+	err = _snd_card_info(card, &info);
 	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
-	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
+		SNDERR("could not obtain the information of card %i: %s",
+		       card, snd_strerror(err));
 		goto __error;
 	}
 	err = snd_config_get_id(src, &id);
@@ -1023,8 +1011,6 @@ int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 		err = snd_config_imake_safe_string(dst, id,
 					snd_ctl_card_info_get_name(&info));
       __error:
-      	if (ctl)
-      		snd_ctl_close(ctl);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -1355,6 +1341,8 @@ int snd_func_refer(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 	}
 	if (file) {
 		snd_input_t *input;
+		/* the file is read again at each evaluation */
+		_snd_config_dep_volatile();
 		err = snd_input_stdio_open(&input, file, "r");
 		if (err < 0) {
 			SNDERR("Unable to open file %s: %s", file, snd_strerror(err));
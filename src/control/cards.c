@@ -33,12 +33,70 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define SND_FILE_CONTROL	ALSA_DEVICE_DIRECTORY "controlC%i"
 #define SND_FILE_LOAD		ALOAD_DEVICE_DIRECTORY "aloadC%i"
 #endif
 
+#ifndef DOC_HIDDEN
+/*
+ * The card information queried by the configuration functions on every
+ * open.  An entry stays valid as long as the control device node is the
+ * same, a hotplugged card gets a new node.
+ */
+struct card_info_cache {
+	int valid;
+	dev_t rdev;
+	ino_t ino;
+	time_t ctime;
+	snd_ctl_card_info_t info;
+};
+
+static struct card_info_cache card_info_cache[SND_MAX_CARDS];
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t card_info_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void card_info_lock(void)
+{
+	pthread_mutex_lock(&card_info_mutex);
+}
+
+static inline void card_info_unlock(void)
+{
+	pthread_mutex_unlock(&card_info_mutex);
+}
+#else
+static inline void card_info_lock(void) { }
+static inline void card_info_unlock(void) { }
+#endif
+
+/* the entry matches the control device node st, call with the lock held */
+static inline int card_info_valid(struct card_info_cache *c, const struct stat *st)
+{
+	return c->valid && c->rdev == st->st_rdev &&
+	       c->ino == st->st_ino && c->ctime == st->st_ctime;
+}
+
+/*
+ * The indexes of the present cards, for snd_card_next() and the lookups
+ * by ID.  The nodes of a card are created and removed in the device
+ * directory when it is plugged or unplugged, so the list stays valid as
+ * long as the directory is not modified.
+ */
+static struct {
+	int valid;
+	struct timespec mtime;
+	struct timespec ctime;
+	unsigned char present[SND_MAX_CARDS];
+} card_list;
+#endif /* DOC_HIDDEN */
+
 static int snd_card_load2(const char *control)
 {
 	int open_dev;
@@ -60,10 +118,19 @@ static int snd_card_load2(const char *control)
 
 static int snd_card_load1(int card)
 {
-	int res;
+	struct stat st;
+	int res, cached;
 	char control[sizeof(SND_FILE_CONTROL) + 10];
 
 	sprintf(control, SND_FILE_CONTROL, card);
+	/* a card with the information cached is present while its node is */
+	if (stat(control, &st) == 0) {
+		card_info_lock();
+		cached = card_info_valid(&card_info_cache[card], &st);
+		card_info_unlock();
+		if (cached)
+			return card;
+	}
 	res = snd_card_load2(control);
 #ifdef SUPPORT_ALOAD
 	if (res < 0) {
@@ -85,6 +152,150 @@ int snd_card_load(int card)
 	return !!(snd_card_load1(card) >= 0);
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Obtains the card information of a physical card like snd_ctl_card_info()
+ * without opening the control device when it did not change since the last
+ * call.
+ */
+int _snd_card_info(int card, snd_ctl_card_info_t *info)
+{
+	struct card_info_cache *c;
+	char control[sizeof(SND_FILE_CONTROL) + 10];
+	struct stat st;
+	snd_ctl_t *handle;
+	int cached;
+	int err;
+
+	if (card < 0 || card >= SND_MAX_CARDS)
+		return -EINVAL;
+	c = &card_info_cache[card];
+	sprintf(control, SND_FILE_CONTROL, card);
+	cached = stat(control, &st) == 0;
+	card_info_lock();
+	if (cached && card_info_valid(c, &st)) {
+		*info = c->info;
+		card_info_unlock();
+		return 0;
+	}
+	c->valid = 0;
+	card_info_unlock();
+
+	err = snd_ctl_hw_open(&handle, NULL, card, 0);
+	if (err < 0)
+		return err;
+	err = snd_ctl_card_info(handle, info);
+	snd_ctl_close(handle);
+	if (err < 0 || !cached)
+		return err;
+
+	card_info_lock();
+	c->rdev = st.st_rdev;
+	c->ino = st.st_ino;
+	c->ctime = st.st_ctime;
+	c->info = *info;
+	c->valid = 1;
+	card_info_unlock();
+	return 0;
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *card_info_prefetch1(void *arg)
+{
+	snd_ctl_card_info_t info;
+
+	_snd_card_info((int)(intptr_t)arg, &info);
+	return NULL;
+}
+#endif
+
+/*
+ * Fills the card information cache for all present cards.  Opening the
+ * control device can take long (a USB card resumes from autosuspend), so
+ * the cards not cached yet are probed in parallel threads instead of one
+ * by one by the following snd_card_next() and _snd_card_info() calls.
+ */
+void _snd_card_info_prefetch(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_t threads[SND_MAX_CARDS];
+	int started[SND_MAX_CARDS];
+#endif
+	char control[sizeof(SND_FILE_CONTROL) + 10];
+	int cards[SND_MAX_CARDS];
+	snd_ctl_card_info_t info;
+	struct stat st;
+	int card, i, count = 0, valid;
+
+	for (card = 0; card < SND_MAX_CARDS; card++) {
+		sprintf(control, SND_FILE_CONTROL, card);
+		if (stat(control, &st) < 0)
+			continue;
+		card_info_lock();
+		valid = card_info_valid(&card_info_cache[card], &st);
+		card_info_unlock();
+		if (!valid)
+			cards[count++] = card;
+	}
+#ifdef HAVE_LIBPTHREAD
+	if (count > 1) {
+		for (i = 0; i < count; i++)
+			started[i] = pthread_create(&threads[i], NULL, card_info_prefetch1,
+						    (void *)(intptr_t)cards[i]) == 0;
+		for (i = 0; i < count; i++) {
+			if (started[i])
+				pthread_join(threads[i], NULL);
+			else
+				_snd_card_info(cards[i], &info);
+		}
+		return;
+	}
+#endif
+	for (i = 0; i < count; i++)
+		_snd_card_info(cards[i], &info);
+}
+#endif
+
+static inline int timespec_same(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+/*
+ * Copies the presence of the cards to present, probing them again when
+ * the device directory changed.  Returns -ENOENT without the directory,
+ * the caller then probes each card itself.
+ */
+static int card_list_get(unsigned char *present)
+{
+	struct stat st;
+	int card;
+
+	if (stat(ALSA_DEVICE_DIRECTORY, &st) < 0)
+		return -ENOENT;
+	card_info_lock();
+	if (card_list.valid && timespec_same(&card_list.mtime, &st.st_mtim) &&
+	    timespec_same(&card_list.ctime, &st.st_ctim)) {
+		memcpy(present, card_list.present, sizeof(card_list.present));
+		card_info_unlock();
+		return 0;
+	}
+	card_info_unlock();
+
+	/* a change during the probe is seen by the next call: the times
+	 * stored are the ones from before the probe
+	 */
+	for (card = 0; card < SND_MAX_CARDS; card++)
+		present[card] = snd_card_load(card);
+	card_info_lock();
+	memcpy(card_list.present, present, sizeof(card_list.present));
+	card_list.mtime = st.st_mtim;
+	card_list.ctime = st.st_ctim;
+	card_list.valid = 1;
+	card_info_unlock();
+	return 0;
+}
+
 /**
  * \brief Iterate over physical sound cards.
  *
@@ -101,20 +312,26 @@ int snd_card_load(int card)
  *
  * This does not work for virtual sound cards.
  *
+ * The cards present are probed again only when the device directory
+ * changed since the previous call, so iterating takes a single stat()
+ * per step.
+ *
  * \param rcard Index of current card. The index of the next card is stored
  *        here.
  * \result zero if success, otherwise a negative error code.
  */
 int snd_card_next(int *rcard)
 {
-	int card;
+	unsigned char present[SND_MAX_CARDS];
+	int card, listed;
 	
 	if (rcard == NULL)
 		return -EINVAL;
 	card = *rcard;
 	card = card < 0 ? 0 : card + 1;
+	listed = card_list_get(present) == 0;
 	for (; card < SND_MAX_CARDS; card++) {
-		if (snd_card_load(card)) {
+		if (listed ? present[card] : snd_card_load(card)) {
 			*rcard = card;
 			return 0;
 		}
@@ -139,8 +356,8 @@ int snd_card_next(int *rcard)
  */
 int snd_card_get_index(const char *string)
 {
-	int card, err;
-	snd_ctl_t *handle;
+	unsigned char present[SND_MAX_CARDS];
+	int card, err, listed;
 	snd_ctl_card_info_t info;
 
 	if (!string || *string == '\0')
@@ -161,18 +378,16 @@ int snd_card_get_index(const char *string)
 		/* We got a device name */
 		return snd_card_load2(string);
 	/* We got in ID */
+	listed = card_list_get(present) == 0;
 	for (card = 0; card < SND_MAX_CARDS; card++) {
+		if (listed && !present[card])
+			continue;
 #ifdef SUPPORT_ALOAD
-		if (! snd_card_load(card))
+		if (!listed && ! snd_card_load(card))
 			continue;
 #endif
-		if (snd_ctl_hw_open(&handle, NULL, card, 0) < 0)
-			continue;
-		if (snd_ctl_card_info(handle, &info) < 0) {
-			snd_ctl_close(handle);
+		if (_snd_card_info(card, &info) < 0)
 			continue;
-		}
-		snd_ctl_close(handle);
 		if (!strcmp((const char *)info.id, string))
 			return card;
 	}
@@ -191,19 +406,13 @@ int snd_card_get_index(const char *string)
  */
 int snd_card_get_name(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if ((err = _snd_card_info(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.name);
 	if (*name == NULL)
 		return -ENOMEM;
@@ -221,19 +430,13 @@ int snd_card_get_name(int card, char **name)
  */
 int snd_card_get_longname(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if ((err = _snd_card_info(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.longname);
 	if (*name == NULL)
 		return -ENOMEM;
@@ -273,6 +273,7 @@ int snd_ctl_new(snd_ctl_t **ctlp, snd_ctl_type_t type, const char *name, int mod
 		return -ENOMEM;
 	ctl->type = type;
 	ctl->mode = mode;
+	ctl->nonblock = !!(mode & SND_CTL_NONBLOCK);
 	if (name)
 		ctl->name = strdup(name);
 	INIT_LIST_HEAD(&ctl->async_handlers);
@@ -428,6 +429,38 @@ int snd_ctl_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
 	return ctl->ops->element_info(ctl, info);
 }
 
+/**
+ * \brief Get the information of several CTL elements.
+ *
+ * Gets the information like snd_ctl_elem_info() for each of \p infos in
+ * turn and stops at the first error, see snd_ctl_elem_read_batch().
+ *
+ * \param ctl CTL handle.
+ * \param infos The element id/information pointers, the IDs must be set
+ *              before calling the function.
+ * \param count The number of \p infos.
+ *
+ * \return The number of elements done, the failing one is the next.  When
+ *         the first fails, its negative error code.
+ */
+int snd_ctl_elem_info_batch(snd_ctl_t *ctl, snd_ctl_elem_info_t **infos,
+			    unsigned int count)
+{
+	unsigned int k;
+	int err;
+
+	assert(ctl && (infos || !count));
+	if (ctl->ops->element_info_batch && count)
+		return ctl->ops->element_info_batch(ctl, infos, count);
+	for (k = 0; k < count; k++) {
+		assert(infos[k] && (infos[k]->id.name[0] || infos[k]->id.numid));
+		err = ctl->ops->element_info(ctl, infos[k]);
+		if (err < 0)
+			return k ? (int)k : err;
+	}
+	return count;
+}
+
 #ifndef DOC_HIDDEN
 #if 0 /* deprecated */
 static bool validate_element_member_dimension(snd_ctl_elem_info_t *info)
@@ -1037,6 +1070,72 @@ int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data)
 	return ctl->ops->element_write(ctl, data);
 }
 
+/**
+ * \brief Get the values of several CTL elements.
+ *
+ * Reads the values like snd_ctl_elem_read() for each of \p values in turn
+ * and stops at the first error.  The kernel interface has no request for
+ * several elements, so on a hw device this saves the per call overhead of
+ * the library only.  An external plugin with the batch callbacks (see
+ * #snd_ctl_ext_callback_t) gets all the elements in one call.
+ *
+ * \param ctl CTL handle.
+ * \param values The element values, the IDs must be set before calling
+ *               the function.
+ * \param count The number of \p values.
+ *
+ * \return The number of values read, the failing one is the next.  When
+ *         the first read fails, its negative error code.
+ */
+int snd_ctl_elem_read_batch(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			    unsigned int count)
+{
+	unsigned int k;
+	int err;
+
+	assert(ctl && (values || !count));
+	if (ctl->ops->element_read_batch && count)
+		return ctl->ops->element_read_batch(ctl, values, count);
+	for (k = 0; k < count; k++) {
+		assert(values[k] && (values[k]->id.name[0] || values[k]->id.numid));
+		err = ctl->ops->element_read(ctl, values[k]);
+		if (err < 0)
+			return k ? (int)k : err;
+	}
+	return count;
+}
+
+/**
+ * \brief Set the values of several CTL elements.
+ *
+ * Writes the values like snd_ctl_elem_write() for each of \p values in
+ * turn and stops at the first error, see snd_ctl_elem_read_batch().
+ *
+ * \param ctl CTL handle.
+ * \param values The new values, with the IDs set.
+ * \param count The number of \p values.
+ *
+ * \return The number of values written, the failing one is the next.
+ *         When the first write fails, its negative error code.
+ */
+int snd_ctl_elem_write_batch(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			     unsigned int count)
+{
+	unsigned int k;
+	int err;
+
+	assert(ctl && (values || !count));
+	if (ctl->ops->element_write_batch && count)
+		return ctl->ops->element_write_batch(ctl, values, count);
+	for (k = 0; k < count; k++) {
+		assert(values[k] && (values[k]->id.name[0] || values[k]->id.numid));
+		err = ctl->ops->element_write(ctl, values[k]);
+		if (err < 0)
+			return k ? (int)k : err;
+	}
+	return count;
+}
+
 static int snd_ctl_tlv_do(snd_ctl_t *ctl, int op_flag,
 			  const snd_ctl_elem_id_t *id,
 		          unsigned int *tlv, unsigned int tlv_size)
@@ -1353,6 +1452,104 @@ int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 	return (ctl->ops->read)(ctl, event);
 }
 
+/**
+ * \brief Read several events
+ * \param ctl CTL handle
+ * \param events Array of event pointers
+ * \param count Number of \p events
+ * \return number of events read otherwise a negative error code on failure
+ *
+ * Reads like snd_ctl_read() but returns as many of the pending events as
+ * fit in \p events.  The hardware control device returns up to 32 of them
+ * with a single system call.  Other handles read the events one by one, in
+ * the blocking mode only the first one is read.
+ */
+int snd_ctl_read_events(snd_ctl_t *ctl, snd_ctl_event_t **events,
+			unsigned int count)
+{
+	unsigned int k;
+	int err;
+
+	assert(ctl && (events || !count));
+	if (count == 0)
+		return 0;
+	if (ctl->ops->read_events)
+		return ctl->ops->read_events(ctl, events, count);
+	err = ctl->ops->read(ctl, events[0]);
+	if (err <= 0 || !ctl->nonblock)
+		return err;
+	for (k = 1; k < count; k++) {
+		err = ctl->ops->read(ctl, events[k]);
+		if (err <= 0)
+			break;
+	}
+	return k;
+}
+
+/* reads the values, the ones which fail are cleared */
+static void ctl_read_values(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			    unsigned int count)
+{
+	unsigned int done;
+	int err;
+
+	for (done = 0; done < count; done += err) {
+		err = snd_ctl_elem_read_batch(ctl, values + done, count - done);
+		if (err < 0) {
+			snd_ctl_elem_value_clear(values[done]);
+			err = 1;
+		}
+	}
+}
+
+/**
+ * \brief Read several events with the new values of the elements
+ * \param ctl CTL handle
+ * \param events Array of event pointers
+ * \param values Array of element value pointers, one for each of \p events
+ * \param count Number of \p events and \p values
+ * \return number of events read otherwise a negative error code on failure
+ *
+ * Reads the pending events like snd_ctl_read_events().  For each element
+ * event with #SND_CTL_EVENT_MASK_VALUE set, except a removal, the current
+ * value of the element is read into the value of the same index, with the
+ * element reads done in one snd_ctl_elem_read_batch() call.  The values of
+ * the other events and of the elements which could not be read are
+ * cleared, their numid is zero.
+ *
+ * The value read is the one at the time of this call, a later change of
+ * the element has its own event.
+ */
+int snd_ctl_read_values(snd_ctl_t *ctl, snd_ctl_event_t **events,
+			snd_ctl_elem_value_t **values, unsigned int count)
+{
+	snd_ctl_event_t *ev;
+	snd_ctl_elem_value_t *read[32];
+	unsigned int k, n;
+	int err;
+
+	assert(values || !count);
+	err = snd_ctl_read_events(ctl, events, count);
+	if (err <= 0)
+		return err;
+	count = err;
+	for (k = n = 0; k < count; k++) {
+		ev = events[k];
+		snd_ctl_elem_value_clear(values[k]);
+		if (ev->type == SND_CTL_EVENT_ELEM &&
+		    ev->data.elem.mask != SND_CTL_EVENT_MASK_REMOVE &&
+		    (ev->data.elem.mask & SND_CTL_EVENT_MASK_VALUE)) {
+			values[k]->id = ev->data.elem.id;
+			read[n++] = values[k];
+		}
+		if (n == ARRAY_SIZE(read) || (n > 0 && k + 1 == count)) {
+			ctl_read_values(ctl, read, n);
+			n = 0;
+		}
+	}
+	return count;
+}
+
 /**
  * \brief Wait for a CTL to become ready (i.e. at least one event pending)
  * \param ctl CTL handle
@@ -1414,7 +1611,7 @@ int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl,
 		return err;
 	h->type = SND_ASYNC_HANDLER_CTL;
 	h->u.ctl = ctl;
-	was_empty = list_empty(&ctl->async_handlers);
+	was_empty = !_snd_async_signal_used(&ctl->async_handlers);
 	list_add_tail(&h->hlist, &ctl->async_handlers);
 	if (was_empty) {
 		err = snd_ctl_async(ctl, snd_async_handler_get_signo(h), getpid());
@@ -1427,6 +1624,28 @@ int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl,
 	return 0;
 }
 
+/**
+ * \brief Add an async handler for a CTL called from a thread
+ * \param handler Returned handler handle
+ * \param ctl CTL handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback is called from a thread polling the descriptors of the CTL
+ * while events are pending, it should read them with #snd_ctl_read().
+ * No signal is used.  See #snd_async_add_thread_handler for the rules
+ * of the thread callbacks.
+ */
+int snd_async_add_ctl_thread_handler(snd_async_handler_t **handler, snd_ctl_t *ctl,
+				     snd_async_callback_t callback, void *private_data)
+{
+	assert(ctl);
+	return _snd_async_add_thread_handler(handler, SND_ASYNC_HANDLER_CTL, ctl,
+					     &ctl->async_handlers, callback,
+					     private_data);
+}
+
 /**
  * \brief Return CTL handle related to an async handler
  * \param handler Async handler handle
@@ -1439,7 +1658,7 @@ snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler)
 }
 
 static const char *const build_in_ctls[] = {
-	"hw", "empty", "remap", "shm", NULL
+	"hw", "empty", "remap", "shm", "cache", NULL
 };
 
 static int snd_ctl_open_conf(snd_ctl_t **ctlp, const char *name,
@@ -0,0 +1,714 @@
+/**
+ * \file control/control_cache.c
+ * \ingroup Control_Plugins
+ * \brief CTL Value Cache Plugin Interface
+ * \date 2026
+ */
+/*
+ *  Control - Shared Value Cache
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "control_local.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_control_cache = "";
+#endif
+
+#ifndef DOC_HIDDEN
+#define CACHE_MAGIC		(0x63746c63 ^ (unsigned int)sizeof(snd_ctl_cache_slot_t))
+#define CACHE_READ_TRIES	4
+#define CACHE_WRITE_TRIES	1000
+
+typedef struct {
+	unsigned int seq;		/* odd while the slot is written */
+	unsigned int valid;		/* the value is up to date */
+	snd_ctl_elem_value_t value;	/* the ID is set at creation */
+} snd_ctl_cache_slot_t;
+
+typedef struct {
+	unsigned int magic;		/* set when the segment is initialized */
+	unsigned int count;		/* number of slots, sorted by numid */
+	pid_t updater;			/* process keeping the values, 0 = none */
+	unsigned int reserved;
+	snd_ctl_cache_slot_t slots[];
+} snd_ctl_cache_share_t;
+
+typedef struct {
+	snd_ctl_t *child;
+	key_t ipc_key;
+	mode_t ipc_perm;
+	int shmid;
+	size_t size;
+	snd_ctl_cache_share_t *share;
+	int ready;			/* the shared header was checked */
+	int updater;			/* this handle keeps the values */
+	time_t alive_checked;		/* last check of the updater process */
+} snd_ctl_cache_t;
+#endif
+
+static int cache_ready(snd_ctl_cache_t *priv)
+{
+	snd_ctl_cache_share_t *share = priv->share;
+
+	if (priv->ready)
+		return 1;
+	if (__atomic_load_n(&share->magic, __ATOMIC_ACQUIRE) != CACHE_MAGIC)
+		return 0;
+	if (share->count > (priv->size - offsetof(snd_ctl_cache_share_t, slots)) /
+			   sizeof(snd_ctl_cache_slot_t))
+		return 0;
+	priv->ready = 1;
+	return 1;
+}
+
+/* drop an updater which died without cleaning up, checked once a second */
+static int cache_alive(snd_ctl_cache_t *priv)
+{
+	snd_ctl_cache_share_t *share = priv->share;
+	pid_t pid = __atomic_load_n(&share->updater, __ATOMIC_ACQUIRE);
+	struct timespec now;
+
+	if (!pid)
+		return 0;
+	if (priv->updater)
+		return 1;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec == priv->alive_checked)
+		return 1;
+	priv->alive_checked = now.tv_sec;
+	if (kill(pid, 0) < 0 && errno == ESRCH) {
+		__atomic_compare_exchange_n(&share->updater, &pid, 0, 0,
+					    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+		return 0;
+	}
+	return 1;
+}
+
+static snd_ctl_cache_slot_t *cache_find(snd_ctl_cache_t *priv, unsigned int numid)
+{
+	snd_ctl_cache_share_t *share = priv->share;
+	unsigned int l = 0, u = share->count, idx;
+
+	while (l < u) {
+		idx = (l + u) / 2;
+		if (numid < share->slots[idx].value.id.numid)
+			u = idx;
+		else if (numid > share->slots[idx].value.id.numid)
+			l = idx + 1;
+		else
+			return &share->slots[idx];
+	}
+	return NULL;
+}
+
+static int cache_slot_get(snd_ctl_cache_slot_t *slot, snd_ctl_elem_value_t *control)
+{
+	unsigned int seq, tries;
+
+	for (tries = 0; tries < CACHE_READ_TRIES; tries++) {
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		if (!__atomic_load_n(&slot->valid, __ATOMIC_RELAXED))
+			return -EAGAIN;
+		memcpy(control, &slot->value, sizeof(*control));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -EAGAIN;
+}
+
+/* store the value, or invalidate the slot when control is NULL */
+static void cache_slot_put(snd_ctl_cache_slot_t *slot,
+			   const snd_ctl_elem_value_t *control)
+{
+	unsigned int seq, tries;
+
+	for (tries = 0; ; tries++) {
+		if (tries >= CACHE_WRITE_TRIES)
+			return;	/* a writer died in the middle, leave it */
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+		if (!(seq & 1) &&
+		    __atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+		sched_yield();
+	}
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (control) {
+		memcpy(&slot->value.value, &control->value,
+		       sizeof(slot->value.value));
+		slot->valid = 1;
+	} else {
+		slot->valid = 0;
+	}
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* read the value from the child and store it */
+static void cache_refresh(snd_ctl_cache_t *priv, snd_ctl_cache_slot_t *slot)
+{
+	snd_ctl_elem_value_t control = {0};
+
+	control.id = slot->value.id;
+	if (snd_ctl_elem_read(priv->child, &control) < 0)
+		cache_slot_put(slot, NULL);
+	else
+		cache_slot_put(slot, &control);
+}
+
+static void cache_take_updater(snd_ctl_cache_t *priv)
+{
+	snd_ctl_cache_share_t *share = priv->share;
+	pid_t pid;
+	unsigned int idx;
+
+	if (priv->updater || !cache_ready(priv))
+		return;
+	pid = __atomic_load_n(&share->updater, __ATOMIC_ACQUIRE);
+	if (pid && (kill(pid, 0) == 0 || errno != ESRCH))
+		return;
+	if (!__atomic_compare_exchange_n(&share->updater, &pid, getpid(), 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return;
+	priv->updater = 1;
+	for (idx = 0; idx < share->count; idx++)
+		cache_refresh(priv, &share->slots[idx]);
+}
+
+static void cache_release_updater(snd_ctl_cache_t *priv)
+{
+	snd_ctl_cache_share_t *share = priv->share;
+	unsigned int idx;
+
+	if (!priv->updater)
+		return;
+	for (idx = 0; idx < share->count; idx++)
+		cache_slot_put(&share->slots[idx], NULL);
+	__atomic_store_n(&share->updater, 0, __ATOMIC_RELEASE);
+	priv->updater = 0;
+}
+
+static void cache_free(snd_ctl_cache_t *priv)
+{
+	struct shmid_ds buf;
+
+	if (priv->share) {
+		cache_release_updater(priv);
+		shmdt(priv->share);
+	}
+	/* the last user destroys the segment */
+	if (priv->shmid >= 0 && shmctl(priv->shmid, IPC_STAT, &buf) == 0 &&
+	    buf.shm_nattch == 0)
+		shmctl(priv->shmid, IPC_RMID, NULL);
+	free(priv);
+}
+
+static int cache_numid_compare(const void *a, const void *b)
+{
+	const snd_ctl_elem_id_t *id1 = a, *id2 = b;
+
+	return id1->numid < id2->numid ? -1 : id1->numid > id2->numid;
+}
+
+/* fill the slots with the element IDs of the child */
+static int cache_init_share(snd_ctl_cache_t *priv, snd_ctl_elem_list_t *list)
+{
+	snd_ctl_cache_share_t *share = priv->share;
+	unsigned int idx;
+
+	qsort(list->pids, list->used, sizeof(list->pids[0]), cache_numid_compare);
+	for (idx = 0; idx < list->used; idx++)
+		share->slots[idx].value.id = list->pids[idx];
+	share->count = list->used;
+	__atomic_store_n(&share->magic, CACHE_MAGIC, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int cache_attach(snd_ctl_cache_t *priv)
+{
+	snd_ctl_elem_list_t list;
+	struct shmid_ds buf;
+	int created = 0, err;
+
+	memset(&list, 0, sizeof(list));
+	err = snd_ctl_elem_list(priv->child, &list);
+	if (err < 0)
+		return err;
+	while (list.count != list.used) {
+		err = snd_ctl_elem_list_alloc_space(&list, list.count);
+		if (err < 0)
+			goto _end;
+		err = snd_ctl_elem_list(priv->child, &list);
+		if (err < 0)
+			goto _end;
+	}
+	priv->size = offsetof(snd_ctl_cache_share_t, slots) +
+		     list.used * sizeof(snd_ctl_cache_slot_t);
+	priv->shmid = shmget(priv->ipc_key, priv->size,
+			     IPC_CREAT | IPC_EXCL | priv->ipc_perm);
+	if (priv->shmid >= 0) {
+		created = 1;
+	} else if (errno == EEXIST) {
+		priv->shmid = shmget(priv->ipc_key, 0, priv->ipc_perm);
+	}
+	if (priv->shmid < 0) {
+		err = -errno;
+		SNDERR("unable to get the shared value cache (key 0x%x)",
+		       (unsigned int)priv->ipc_key);
+		goto _end;
+	}
+	priv->share = shmat(priv->shmid, NULL, 0);
+	if (priv->share == (void *)-1) {
+		err = -errno;
+		priv->share = NULL;
+		SNDERR("unable to attach the shared value cache");
+		goto _end;
+	}
+	if (shmctl(priv->shmid, IPC_STAT, &buf) < 0) {
+		err = -errno;
+		goto _end;
+	}
+	priv->size = buf.shm_segsz;
+	if (priv->size < offsetof(snd_ctl_cache_share_t, slots)) {
+		SNDERR("the shared value cache (key 0x%x) is too small",
+		       (unsigned int)priv->ipc_key);
+		err = -EINVAL;
+		goto _end;
+	}
+	if (created)
+		err = cache_init_share(priv, &list);
+	else
+		err = 0;
+ _end:
+	free(list.pids);
+	return err;
+}
+
+static int snd_ctl_cache_close(snd_ctl_t *ctl)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	int err = snd_ctl_close(priv->child);
+	cache_free(priv);
+	return err;
+}
+
+static int snd_ctl_cache_nonblock(snd_ctl_t *ctl, int nonblock)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_nonblock(priv->child, nonblock);
+}
+
+static int snd_ctl_cache_async(snd_ctl_t *ctl, int sig, pid_t pid)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_async(priv->child, sig, pid);
+}
+
+static int snd_ctl_cache_subscribe_events(snd_ctl_t *ctl, int subscribe)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	int err = snd_ctl_subscribe_events(priv->child, subscribe);
+
+	if (err < 0 || subscribe < 0)
+		return err;
+	if (subscribe)
+		cache_take_updater(priv);
+	else
+		cache_release_updater(priv);
+	return err;
+}
+
+static int snd_ctl_cache_card_info(snd_ctl_t *ctl, snd_ctl_card_info_t *info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_card_info(priv->child, info);
+}
+
+static int snd_ctl_cache_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_elem_list(priv->child, list);
+}
+
+static int snd_ctl_cache_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_elem_info(priv->child, info);
+}
+
+static int snd_ctl_cache_elem_add(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return priv->child->ops->element_add(priv->child, info);
+}
+
+static int snd_ctl_cache_elem_replace(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return priv->child->ops->element_replace(priv->child, info);
+}
+
+static int snd_ctl_cache_elem_remove(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_elem_remove(priv->child, id);
+}
+
+static int snd_ctl_cache_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	snd_ctl_cache_slot_t *slot;
+
+	if (control->id.numid && cache_ready(priv) && cache_alive(priv)) {
+		slot = cache_find(priv, control->id.numid);
+		if (slot && cache_slot_get(slot, control) == 0)
+			return 0;
+	}
+	return snd_ctl_elem_read(priv->child, control);
+}
+
+static int snd_ctl_cache_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	snd_ctl_cache_slot_t *slot;
+	int err;
+
+	err = snd_ctl_elem_write(priv->child, control);
+	if (err < 0)
+		return err;
+	/* the updater sees the change event later, make the own write
+	 * visible to the readers right away
+	 */
+	if (control->id.numid && cache_ready(priv) && cache_alive(priv)) {
+		slot = cache_find(priv, control->id.numid);
+		if (slot)
+			cache_refresh(priv, slot);
+	}
+	return err;
+}
+
+static int snd_ctl_cache_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_elem_lock(priv->child, id);
+}
+
+static int snd_ctl_cache_elem_unlock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_elem_unlock(priv->child, id);
+}
+
+static int snd_ctl_cache_elem_tlv(snd_ctl_t *ctl, int op_flag,
+				  unsigned int numid,
+				  unsigned int *tlv, unsigned int tlv_size)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return priv->child->ops->element_tlv(priv->child, op_flag, numid, tlv, tlv_size);
+}
+
+static int snd_ctl_cache_hwdep_next_device(snd_ctl_t *ctl, int * device)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_hwdep_next_device(priv->child, device);
+}
+
+static int snd_ctl_cache_hwdep_info(snd_ctl_t *ctl, snd_hwdep_info_t * info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_hwdep_info(priv->child, info);
+}
+
+static int snd_ctl_cache_pcm_next_device(snd_ctl_t *ctl, int * device)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_pcm_next_device(priv->child, device);
+}
+
+static int snd_ctl_cache_pcm_info(snd_ctl_t *ctl, snd_pcm_info_t * info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_pcm_info(priv->child, info);
+}
+
+static int snd_ctl_cache_pcm_prefer_subdevice(snd_ctl_t *ctl, int subdev)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_pcm_prefer_subdevice(priv->child, subdev);
+}
+
+static int snd_ctl_cache_rawmidi_next_device(snd_ctl_t *ctl, int * device)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_rawmidi_next_device(priv->child, device);
+}
+
+static int snd_ctl_cache_rawmidi_info(snd_ctl_t *ctl, snd_rawmidi_info_t * info)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_rawmidi_info(priv->child, info);
+}
+
+static int snd_ctl_cache_rawmidi_prefer_subdevice(snd_ctl_t *ctl, int subdev)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_rawmidi_prefer_subdevice(priv->child, subdev);
+}
+
+static int snd_ctl_cache_set_power_state(snd_ctl_t *ctl, unsigned int state)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_set_power_state(priv->child, state);
+}
+
+static int snd_ctl_cache_get_power_state(snd_ctl_t *ctl, unsigned int *state)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_get_power_state(priv->child, state);
+}
+
+static int snd_ctl_cache_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	snd_ctl_cache_slot_t *slot;
+	int err;
+
+	err = snd_ctl_read(priv->child, event);
+	if (err <= 0 || !priv->updater || event->type != SNDRV_CTL_EVENT_ELEM)
+		return err;
+	slot = cache_find(priv, event->data.elem.id.numid);
+	if (!slot)
+		return err;
+	if (event->data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE)
+		cache_slot_put(slot, NULL);
+	else if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
+					  SNDRV_CTL_EVENT_MASK_INFO))
+		cache_refresh(priv, slot);
+	return err;
+}
+
+static int snd_ctl_cache_poll_descriptors_count(snd_ctl_t *ctl)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_poll_descriptors_count(priv->child);
+}
+
+static int snd_ctl_cache_poll_descriptors(snd_ctl_t *ctl, struct pollfd *pfds,
+					  unsigned int space)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_poll_descriptors(priv->child, pfds, space);
+}
+
+static int snd_ctl_cache_poll_revents(snd_ctl_t *ctl, struct pollfd *pfds,
+				      unsigned int nfds,
+				      unsigned short *revents)
+{
+	snd_ctl_cache_t *priv = ctl->private_data;
+	return snd_ctl_poll_descriptors_revents(priv->child, pfds, nfds, revents);
+}
+
+static const snd_ctl_ops_t snd_ctl_cache_ops = {
+	.close = snd_ctl_cache_close,
+	.nonblock = snd_ctl_cache_nonblock,
+	.async = snd_ctl_cache_async,
+	.subscribe_events = snd_ctl_cache_subscribe_events,
+	.card_info = snd_ctl_cache_card_info,
+	.element_list = snd_ctl_cache_elem_list,
+	.element_info = snd_ctl_cache_elem_info,
+	.element_add = snd_ctl_cache_elem_add,
+	.element_replace = snd_ctl_cache_elem_replace,
+	.element_remove = snd_ctl_cache_elem_remove,
+	.element_read = snd_ctl_cache_elem_read,
+	.element_write = snd_ctl_cache_elem_write,
+	.element_lock = snd_ctl_cache_elem_lock,
+	.element_unlock = snd_ctl_cache_elem_unlock,
+	.element_tlv = snd_ctl_cache_elem_tlv,
+	.hwdep_next_device = snd_ctl_cache_hwdep_next_device,
+	.hwdep_info = snd_ctl_cache_hwdep_info,
+	.pcm_next_device = snd_ctl_cache_pcm_next_device,
+	.pcm_info = snd_ctl_cache_pcm_info,
+	.pcm_prefer_subdevice = snd_ctl_cache_pcm_prefer_subdevice,
+	.rawmidi_next_device = snd_ctl_cache_rawmidi_next_device,
+	.rawmidi_info = snd_ctl_cache_rawmidi_info,
+	.rawmidi_prefer_subdevice = snd_ctl_cache_rawmidi_prefer_subdevice,
+	.set_power_state = snd_ctl_cache_set_power_state,
+	.get_power_state = snd_ctl_cache_get_power_state,
+	.read = snd_ctl_cache_read,
+	.poll_descriptors_count = snd_ctl_cache_poll_descriptors_count,
+	.poll_descriptors = snd_ctl_cache_poll_descriptors,
+	.poll_revents = snd_ctl_cache_poll_revents,
+};
+
+/*! \page control_plugins
+
+\section control_plugins_cache Plugin: Cache
+
+This plugin keeps a snapshot of the element values of the child in a
+System V shared memory segment, so that several processes using the same
+card share one copy of the values.  The reads of elements addressed by
+numid are served from the snapshot, without a call to the child.
+
+The values are kept up to date by one process, the updater.  The first
+handle subscribing to the events with snd_ctl_subscribe_events() becomes
+the updater, it reads all values and then refreshes the value of an
+element with each value or info event it reads with snd_ctl_read().  The
+snapshot is therefore only as fresh as the updater handles its events,
+e.g. with snd_hctl_handle_events() or snd_mixer_handle_events().  When the
+updater unsubscribes or closes the handle, the snapshot is dropped and the
+next subscriber takes over; an updater which died is detected within a
+second.  Without an updater all reads go to the child.  A write goes to
+the child and refreshes the written element in the snapshot right away.
+
+The slots are guarded by sequence counters: the readers never block and
+take no lock, a reader racing with an update retries and falls back to the
+child.  The element set is taken by the process creating the segment,
+elements added later are always read from the child.  The segment is
+removed when the last handle is closed.
+
+\code
+ctl.name {
+	type cache              # Shared value cache
+	child STR               # Child name
+	# or
+	child {                 # Child definition
+		type STR
+		...
+	}
+	ipc_key INT             # unique IPC key of the segment, one per card
+	[ipc_perm INT]          # IPC permissions (octal, default 0600)
+}
+\endcode
+
+\subsection control_plugins_cache_funcref Function reference
+
+<UL>
+  <LI>_snd_ctl_cache_open()
+</UL>
+
+*/
+
+/**
+ * \brief Creates a new shared value cache control plugin
+ * \param handlep Returns created control handle
+ * \param name Name of control
+ * \param root Root configuration node
+ * \param conf Configuration node with the cache description
+ * \param mode Control handle mode
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int _snd_ctl_cache_open(snd_ctl_t **handlep, char *name, snd_config_t *root,
+			snd_config_t *conf, int mode)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *child = NULL;
+	snd_ctl_cache_t *priv;
+	snd_ctl_t *ctl;
+	long key = 0, perm = 0600;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (_snd_conf_generic_id(id))
+			continue;
+		if (strcmp(id, "child") == 0) {
+			child = n;
+			continue;
+		}
+		if (strcmp(id, "ipc_key") == 0) {
+			err = snd_config_get_integer(n, &key);
+			if (err < 0) {
+				SNDERR("The field ipc_key must be an integer type");
+				return err;
+			}
+			continue;
+		}
+		if (strcmp(id, "ipc_perm") == 0) {
+			err = snd_config_get_integer(n, &perm);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if ((perm & ~0777) != 0) {
+				SNDERR("The field ipc_perm must be a valid file permission");
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (!child) {
+		SNDERR("child is not defined");
+		return -EINVAL;
+	}
+	if (!key) {
+		SNDERR("Unique IPC key is not defined");
+		return -EINVAL;
+	}
+	priv = calloc(1, sizeof(*priv));
+	if (priv == NULL)
+		return -ENOMEM;
+	priv->shmid = -1;
+	priv->ipc_key = key;
+	priv->ipc_perm = perm;
+	err = _snd_ctl_open_child(&priv->child, root, child, mode, conf);
+	if (err < 0) {
+		free(priv);
+		return err;
+	}
+	err = cache_attach(priv);
+	if (err < 0)
+		goto _err;
+	err = snd_ctl_new(&ctl, SND_CTL_TYPE_CACHE, name, mode);
+	if (err < 0)
+		goto _err;
+	ctl->ops = &snd_ctl_cache_ops;
+	ctl->private_data = priv;
+	ctl->poll_fd = priv->child->poll_fd;
+	*handlep = ctl;
+	return 0;
+
+ _err:
+	snd_ctl_close(priv->child);
+	cache_free(priv);
+	return err;
+}
+#ifndef DOC_HIDDEN
+SND_DLSYM_BUILD_VERSION(_snd_ctl_cache_open, SND_CONTROL_DLSYM_VERSION);
+#endif
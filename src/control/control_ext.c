@@ -115,7 +115,8 @@ static int snd_ctl_ext_elem_list(snd_ctl_t *handle, snd_ctl_elem_list_t *list)
 	return 0;
 }
 
-static snd_ctl_ext_key_t get_elem(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id)
+/* fill the id of the fake numid given by snd_ctl_ext_elem_list() */
+static void resolve_id(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id)
 {
 	int numid = id->numid;
 	if (numid > 0) {
@@ -123,9 +124,18 @@ static snd_ctl_ext_key_t get_elem(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id)
 		id->numid = numid;
 	} else
 		id->numid = 0;
+}
+
+static snd_ctl_ext_key_t get_elem(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id)
+{
+	resolve_id(ext, id);
 	return ext->callback->find_elem(ext, id);
 }
 
+/* the batch callbacks are read since protocol 1.0.2 */
+#define HAS_BATCH_CALLBACK(ext, cb) \
+	((ext)->version >= SNDRV_PROTOCOL_VERSION(1, 0, 2) && (ext)->callback->cb)
+
 static int snd_ctl_ext_elem_info(snd_ctl_t *handle, snd_ctl_elem_info_t *info)
 {
 	snd_ctl_ext_t *ext = handle->private_data;
@@ -187,6 +197,36 @@ static int snd_ctl_ext_elem_info(snd_ctl_t *handle, snd_ctl_elem_info_t *info)
 	return ret;
 }
 
+static int snd_ctl_ext_elem_info_batch(snd_ctl_t *handle,
+				       snd_ctl_elem_info_t **infos,
+				       unsigned int count)
+{
+	snd_ctl_ext_t *ext = handle->private_data;
+	const snd_ctl_elem_id_t **ids;
+	unsigned int k;
+	int err;
+
+	if (HAS_BATCH_CALLBACK(ext, prefetch_info)) {
+		ids = malloc(count * sizeof(*ids));
+		if (!ids)
+			return -ENOMEM;
+		for (k = 0; k < count; k++) {
+			resolve_id(ext, &infos[k]->id);
+			ids[k] = &infos[k]->id;
+		}
+		err = ext->callback->prefetch_info(ext, ids, count);
+		free(ids);
+		if (err < 0)
+			return err;
+	}
+	for (k = 0; k < count; k++) {
+		err = snd_ctl_ext_elem_info(handle, infos[k]);
+		if (err < 0)
+			return k ? (int)k : err;
+	}
+	return count;
+}
+
 static int snd_ctl_ext_elem_add(snd_ctl_t *handle ATTRIBUTE_UNUSED,
 				snd_ctl_elem_info_t *info ATTRIBUTE_UNUSED)
 {
@@ -312,6 +352,45 @@ static int snd_ctl_ext_elem_write(snd_ctl_t *handle, snd_ctl_elem_value_t *contr
 	return ret;
 }
 
+static int snd_ctl_ext_elem_rw_batch(snd_ctl_t *handle,
+				     snd_ctl_elem_value_t **values,
+				     unsigned int count, int write)
+{
+	snd_ctl_ext_t *ext = handle->private_data;
+	unsigned int k;
+	int err;
+
+	if (write ? !HAS_BATCH_CALLBACK(ext, write_elems) :
+		    !HAS_BATCH_CALLBACK(ext, read_elems)) {
+		for (k = 0; k < count; k++) {
+			err = write ? snd_ctl_ext_elem_write(handle, values[k]) :
+				      snd_ctl_ext_elem_read(handle, values[k]);
+			if (err < 0)
+				return k ? (int)k : err;
+		}
+		return count;
+	}
+	for (k = 0; k < count; k++)
+		resolve_id(ext, &values[k]->id);
+	if (write)
+		return ext->callback->write_elems(ext, values, count);
+	return ext->callback->read_elems(ext, values, count);
+}
+
+static int snd_ctl_ext_elem_read_batch(snd_ctl_t *handle,
+				       snd_ctl_elem_value_t **values,
+				       unsigned int count)
+{
+	return snd_ctl_ext_elem_rw_batch(handle, values, count, 0);
+}
+
+static int snd_ctl_ext_elem_write_batch(snd_ctl_t *handle,
+					snd_ctl_elem_value_t **values,
+					unsigned int count)
+{
+	return snd_ctl_ext_elem_rw_batch(handle, values, count, 1);
+}
+
 static int snd_ctl_ext_elem_lock(snd_ctl_t *handle ATTRIBUTE_UNUSED,
 				 snd_ctl_elem_id_t *id ATTRIBUTE_UNUSED)
 {
@@ -476,6 +555,9 @@ static const snd_ctl_ops_t snd_ctl_ext_ops = {
 	.element_remove = snd_ctl_ext_elem_remove,
 	.element_read = snd_ctl_ext_elem_read,
 	.element_write = snd_ctl_ext_elem_write,
+	.element_info_batch = snd_ctl_ext_elem_info_batch,
+	.element_read_batch = snd_ctl_ext_elem_read_batch,
+	.element_write_batch = snd_ctl_ext_elem_write_batch,
 	.element_lock = snd_ctl_ext_elem_lock,
 	.element_unlock = snd_ctl_ext_elem_unlock,
 	.element_tlv = snd_ctl_ext_elem_tlv,
@@ -693,6 +775,21 @@ set the static poll_fd, you can define these callbacks to return dynamically.
 Also, when multiple poll descriptors are required, use these callbacks.
 The poll_revents callback is used for handle poll revents.
 
+The prefetch_info, read_elems and write_elems callbacks are optional and
+read since the protocol version 1.0.2.  They serve a plugin whose elements
+live in another process, where each callback would cost a round trip.
+The read_elems and write_elems callbacks get the values of several elements
+from #snd_ctl_elem_read_batch() and #snd_ctl_elem_write_batch(), with the
+ids filled as for find_elem.  They access the values with the standard
+functions like #snd_ctl_elem_value_get_id and
+#snd_ctl_elem_value_set_integer, and return the number of elements done,
+the failing one being the next, or a negative error code when the first one
+fails.  The prefetch_info callback is called by #snd_ctl_elem_info_batch()
+with the ids of the elements before their info is queried with the
+callbacks above, e.g. when an HCTL is loaded, so that the plugin can fetch
+the attributes of all of them at once.  It returns 0 or a negative error
+code.
+
 */
 
 /**
@@ -382,6 +382,31 @@ static int snd_ctl_hw_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 	return 1;
 }
 
+/* the kernel returns all the queued events which fit in one read */
+static int snd_ctl_hw_read_events(snd_ctl_t *handle, snd_ctl_event_t **events,
+				  unsigned int count)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	snd_ctl_event_t buf[32];
+	unsigned int k;
+	ssize_t res;
+
+	if (count > ARRAY_SIZE(buf))
+		count = ARRAY_SIZE(buf);
+	res = read(hw->fd, buf, count * sizeof(buf[0]));
+	if (res <= 0)
+		return -errno;
+	if (CHECK_SANITY(res % sizeof(buf[0]))) {
+		SNDMSG("snd_ctl_hw_read_events: read size error (req:%d, got:%d)",
+		       sizeof(buf[0]), res);
+		return -EINVAL;
+	}
+	count = res / sizeof(buf[0]);
+	for (k = 0; k < count; k++)
+		*events[k] = buf[k];
+	return count;
+}
+
 static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.close = snd_ctl_hw_close,
 	.nonblock = snd_ctl_hw_nonblock,
@@ -412,6 +437,7 @@ static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.set_power_state = snd_ctl_hw_set_power_state,
 	.get_power_state = snd_ctl_hw_get_power_state,
 	.read = snd_ctl_hw_read,
+	.read_events = snd_ctl_hw_read_events,
 };
 
 /**
@@ -35,6 +35,9 @@ typedef struct _snd_ctl_ops {
 	int (*element_remove)(snd_ctl_t *handle, snd_ctl_elem_id_t *id);
 	int (*element_read)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
 	int (*element_write)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
+	int (*element_info_batch)(snd_ctl_t *handle, snd_ctl_elem_info_t **infos, unsigned int count);
+	int (*element_read_batch)(snd_ctl_t *handle, snd_ctl_elem_value_t **values, unsigned int count);
+	int (*element_write_batch)(snd_ctl_t *handle, snd_ctl_elem_value_t **values, unsigned int count);
 	int (*element_lock)(snd_ctl_t *handle, snd_ctl_elem_id_t *lock);
 	int (*element_unlock)(snd_ctl_t *handle, snd_ctl_elem_id_t *unlock);
 	int (*element_tlv)(snd_ctl_t *handle, int op_flag, unsigned int numid,
@@ -53,6 +56,7 @@ typedef struct _snd_ctl_ops {
 	int (*set_power_state)(snd_ctl_t *handle, unsigned int state);
 	int (*get_power_state)(snd_ctl_t *handle, unsigned int *state);
 	int (*read)(snd_ctl_t *handle, snd_ctl_event_t *event);
+	int (*read_events)(snd_ctl_t *handle, snd_ctl_event_t **events, unsigned int count);
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -75,6 +79,13 @@ struct _snd_hctl_elem {
 	snd_ctl_elem_id_t id; 		/* must be always on top */
 	struct list_head list;		/* links for list of all helems */
 	int compare_weight;		/* compare weight (reversed) */
+	unsigned int hash;		/* hash of the name, index and location */
+	snd_hctl_elem_t *numid_next;	/* next in the numid hash chain */
+	snd_hctl_elem_t *name_next;	/* next in the name hash chain */
+	snd_ctl_elem_info_t *info;	/* cached info, see snd_hctl_set_cache() */
+	unsigned int *tlv;		/* cached TLV data */
+	unsigned int pending;		/* coalesced event mask */
+	struct list_head pending_list;	/* link in the pending events */
 	/* event callback */
 	snd_hctl_elem_callback_t callback;
 	void *callback_private;
@@ -88,7 +99,12 @@ struct _snd_hctl {
 	unsigned int alloc;	
 	unsigned int count;
 	snd_hctl_elem_t **pelems;
+	unsigned int hash_size;		/* buckets of each hash, 0 = no index */
+	snd_hctl_elem_t **hash;		/* numid buckets, then name buckets */
 	snd_hctl_compare_t compare;
+	int cache;			/* keep the element info and TLV */
+	int coalesce;			/* merge the events of a batch */
+	struct list_head pending;	/* elements with coalesced events */
 	snd_hctl_callback_t callback;
 	void *callback_private;
 };
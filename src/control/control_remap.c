@@ -78,9 +78,21 @@ typedef struct {
 		size_t channel_map_alloc;
 		long *channel_map;
 	} *controls;
+	snd_ctl_elem_value_t *values;	/* child values of the sync */
+	snd_ctl_elem_value_t **pvalues;
 	unsigned int event_mask;
 } snd_ctl_map_t;
 
+/* chained hash of array indexes, the chain links are item + 1 */
+typedef struct {
+	unsigned int size;		/* buckets, a power of two */
+	size_t count;			/* linked items */
+	size_t alloc;			/* items in next and key */
+	unsigned int *head;		/* first item + 1 of each bucket */
+	unsigned int *next;		/* next item + 1 of the chain */
+	unsigned int *key;		/* key of each linked item */
+} snd_ctl_remap_hash_t;
+
 typedef struct {
 	snd_ctl_t *child;
 	int numid_remap_active;
@@ -89,18 +101,129 @@ typedef struct {
 	size_t numid_alloc;
 	snd_ctl_numid_t *numid;
 	snd_ctl_numid_t numid_temp;
+	snd_ctl_remap_hash_t numid_child_hash;
+	snd_ctl_remap_hash_t numid_app_hash;
 	size_t remap_items;
 	size_t remap_alloc;
 	snd_ctl_remap_id_t *remap;
+	snd_ctl_remap_hash_t remap_child_hash;	/* by the name, index, ... */
+	snd_ctl_remap_hash_t remap_app_hash;
+	snd_ctl_remap_hash_t remap_child_numid_hash;
+	snd_ctl_remap_hash_t remap_app_numid_hash;
 	size_t map_items;
 	size_t map_alloc;
 	snd_ctl_map_t *map;
+	snd_ctl_remap_hash_t map_hash;
+	snd_ctl_remap_hash_t map_numid_hash;
+	size_t mctl_items;		/* child controls of all maps */
+	size_t mctl_alloc;
+	struct snd_ctl_map_ref {
+		unsigned int map;
+		unsigned int ctl;
+	} *mctl;
+	snd_ctl_remap_hash_t mctl_hash;
+	snd_ctl_remap_hash_t mctl_numid_hash;
 	size_t map_read_queue_head;
 	size_t map_read_queue_tail;
 	snd_ctl_map_t **map_read_queue;
 } snd_ctl_remap_t;
+
+#define remap_hash_for_each(hash, hkey, item) \
+	for (item = (hash)->size ? (hash)->head[(hkey) & ((hash)->size - 1)] : 0; \
+	     item; item = (hash)->next[item - 1])
 #endif
 
+static unsigned int remap_hash_id(const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *p = id->name;
+	unsigned int h = 2166136261u;
+
+	while (*p)
+		h = (h ^ *p++) * 16777619u;
+	h ^= id->index * 0x9e3779b1u;
+	h ^= (id->iface << 24) ^ (id->device << 16) ^ id->subdevice;
+	return h;
+}
+
+static unsigned int remap_hash_numid(unsigned int numid)
+{
+	return numid * 0x9e3779b1u;
+}
+
+static int remap_hash_resize(snd_ctl_remap_hash_t *hash, unsigned int size)
+{
+	unsigned int *head, b, item, next, *p;
+
+	head = calloc(size, sizeof(*head));
+	if (head == NULL)
+		return -ENOMEM;
+	for (b = 0; b < hash->size; b++) {
+		for (item = hash->head[b]; item; item = next) {
+			next = hash->next[item - 1];
+			p = &head[hash->key[item - 1] & (size - 1)];
+			hash->next[item - 1] = *p;
+			*p = item;
+		}
+	}
+	free(hash->head);
+	hash->head = head;
+	hash->size = size;
+	return 0;
+}
+
+static int remap_hash_add(snd_ctl_remap_hash_t *hash, size_t item, unsigned int key)
+{
+	unsigned int *p;
+	size_t alloc;
+	int err;
+
+	if (item >= hash->alloc) {
+		alloc = item + 16;
+		p = realloc(hash->next, alloc * sizeof(*p));
+		if (p == NULL)
+			return -ENOMEM;
+		hash->next = p;
+		p = realloc(hash->key, alloc * sizeof(*p));
+		if (p == NULL)
+			return -ENOMEM;
+		hash->key = p;
+		hash->alloc = alloc;
+	}
+	if (hash->count >= hash->size) {
+		err = remap_hash_resize(hash, hash->size ? hash->size * 2 : 16);
+		if (err < 0)
+			return err;
+	}
+	p = &hash->head[key & (hash->size - 1)];
+	hash->key[item] = key;
+	hash->next[item] = *p;
+	*p = item + 1;
+	hash->count++;
+	return 0;
+}
+
+static void remap_hash_del(snd_ctl_remap_hash_t *hash, size_t item)
+{
+	unsigned int *p;
+
+	if (hash->size == 0)
+		return;
+	for (p = &hash->head[hash->key[item] & (hash->size - 1)]; *p; p = &hash->next[*p - 1]) {
+		if (*p == item + 1) {
+			*p = hash->next[item];
+			hash->count--;
+			return;
+		}
+	}
+}
+
+static void remap_hash_free(snd_ctl_remap_hash_t *hash)
+{
+	free(hash->head);
+	free(hash->next);
+	free(hash->key);
+}
+
 static snd_ctl_numid_t *remap_numid_temp(snd_ctl_remap_t *priv, unsigned int numid)
 {
 	priv->numid_temp.numid_child = numid;
@@ -110,22 +233,24 @@ static snd_ctl_numid_t *remap_numid_temp(snd_ctl_remap_t *priv, unsigned int num
 
 static snd_ctl_numid_t *remap_find_numid_app(snd_ctl_remap_t *priv, unsigned int numid_app)
 {
-	snd_ctl_numid_t *numid;
-	size_t count;
+	snd_ctl_numid_t *numid, *res = NULL;
+	unsigned int item;
 
 	if (!priv->numid_remap_active)
 		return remap_numid_temp(priv, numid_app);
-	numid = priv->numid;
-	for (count = priv->numid_items; count > 0; count--, numid++)
-		if (numid_app == numid->numid_app)
-			return numid;
-	return NULL;
+	remap_hash_for_each(&priv->numid_app_hash, remap_hash_numid(numid_app), item) {
+		numid = &priv->numid[item - 1];
+		if (numid_app == numid->numid_app && (res == NULL || numid < res))
+			res = numid;
+	}
+	return res;
 }
 
 static snd_ctl_numid_t *remap_numid_new(snd_ctl_remap_t *priv, unsigned int numid_child,
 					unsigned int numid_app)
 {
 	snd_ctl_numid_t *numid;
+	size_t item;
 
 	if (priv->numid_alloc == priv->numid_items) {
 		numid = realloc(priv->numid, (priv->numid_alloc + 16) * sizeof(*numid));
@@ -135,6 +260,14 @@ static snd_ctl_numid_t *remap_numid_new(snd_ctl_remap_t *priv, unsigned int numi
 		priv->numid_alloc += 16;
 		priv->numid = numid;
 	}
+	item = priv->numid_items;
+	if (remap_hash_add(&priv->numid_app_hash, item, remap_hash_numid(numid_app)) < 0)
+		return NULL;
+	if (numid_child > 0 &&
+	    remap_hash_add(&priv->numid_child_hash, item, remap_hash_numid(numid_child)) < 0) {
+		remap_hash_del(&priv->numid_app_hash, item);
+		return NULL;
+	}
 	numid = &priv->numid[priv->numid_items++];
 	numid->numid_child = numid_child;
 	numid->numid_app = numid_app;
@@ -160,63 +293,108 @@ static snd_ctl_numid_t *remap_numid_child_new(snd_ctl_remap_t *priv, unsigned in
 
 static snd_ctl_numid_t *remap_find_numid_child(snd_ctl_remap_t *priv, unsigned int numid_child)
 {
-	snd_ctl_numid_t *numid;
-	size_t count;
+	snd_ctl_numid_t *numid, *res = NULL;
+	unsigned int item;
 
 	if (!priv->numid_remap_active)
 		return remap_numid_temp(priv, numid_child);
-	numid = priv->numid;
-	for (count = priv->numid_items; count > 0; count--, numid++)
-		if (numid_child == numid->numid_child)
-			return numid;
+	remap_hash_for_each(&priv->numid_child_hash, remap_hash_numid(numid_child), item) {
+		numid = &priv->numid[item - 1];
+		if (numid_child == numid->numid_child && (res == NULL || numid < res))
+			res = numid;
+	}
+	if (res)
+		return res;
 	return remap_numid_child_new(priv, numid_child);
 }
 
+/* update the numids of the remap entry and its numid hash links */
+static int remap_set_numid(snd_ctl_remap_t *priv, snd_ctl_remap_id_t *rid,
+			   unsigned int numid_child, unsigned int numid_app)
+{
+	size_t item = rid - priv->remap;
+	int err;
+
+	if (rid->id_child.numid != numid_child) {
+		if (rid->id_child.numid > 0)
+			remap_hash_del(&priv->remap_child_numid_hash, item);
+		rid->id_child.numid = 0;
+		if (numid_child > 0) {
+			err = remap_hash_add(&priv->remap_child_numid_hash, item,
+					     remap_hash_numid(numid_child));
+			if (err < 0)
+				return err;
+			rid->id_child.numid = numid_child;
+		}
+	}
+	if (rid->id_app.numid != numid_app) {
+		if (rid->id_app.numid > 0)
+			remap_hash_del(&priv->remap_app_numid_hash, item);
+		rid->id_app.numid = 0;
+		if (numid_app > 0) {
+			err = remap_hash_add(&priv->remap_app_numid_hash, item,
+					     remap_hash_numid(numid_app));
+			if (err < 0)
+				return err;
+			rid->id_app.numid = numid_app;
+		}
+	}
+	return 0;
+}
+
 static snd_ctl_remap_id_t *remap_find_id_child(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id)
 {
-	size_t count;
-	snd_ctl_remap_id_t *rid;
+	snd_ctl_remap_id_t *rid, *res = NULL;
+	unsigned int item;
 
 	if (id->numid > 0) {
-		rid = priv->remap;
-		for (count = priv->remap_items; count > 0; count--, rid++)
-			if (id->numid == rid->id_child.numid)
-				return rid;
+		remap_hash_for_each(&priv->remap_child_numid_hash, remap_hash_numid(id->numid), item) {
+			rid = &priv->remap[item - 1];
+			if (id->numid == rid->id_child.numid && (res == NULL || rid < res))
+				res = rid;
+		}
+		if (res)
+			return res;
 	}
-	rid = priv->remap;
-	for (count = priv->remap_items; count > 0; count--, rid++)
-		if (snd_ctl_elem_id_compare_set(id, &rid->id_child) == 0)
-			return rid;
-	return NULL;
+	remap_hash_for_each(&priv->remap_child_hash, remap_hash_id(id), item) {
+		rid = &priv->remap[item - 1];
+		if (snd_ctl_elem_id_compare_set(id, &rid->id_child) == 0 && (res == NULL || rid < res))
+			res = rid;
+	}
+	return res;
 }
 
 static snd_ctl_remap_id_t *remap_find_id_app(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id)
 {
-	size_t count;
-	snd_ctl_remap_id_t *rid;
+	snd_ctl_remap_id_t *rid, *res = NULL;
+	unsigned int item;
 
 	if (id->numid > 0) {
-		rid = priv->remap;
-		for (count = priv->remap_items; count > 0; count--, rid++)
-			if (id->numid == rid->id_app.numid)
-				return rid;
+		remap_hash_for_each(&priv->remap_app_numid_hash, remap_hash_numid(id->numid), item) {
+			rid = &priv->remap[item - 1];
+			if (id->numid == rid->id_app.numid && (res == NULL || rid < res))
+				res = rid;
+		}
+		if (res)
+			return res;
 	}
-	rid = priv->remap;
-	for (count = priv->remap_items; count > 0; count--, rid++)
-		if (snd_ctl_elem_id_compare_set(id, &rid->id_app) == 0)
-			return rid;
-	return NULL;
+	remap_hash_for_each(&priv->remap_app_hash, remap_hash_id(id), item) {
+		rid = &priv->remap[item - 1];
+		if (snd_ctl_elem_id_compare_set(id, &rid->id_app) == 0 && (res == NULL || rid < res))
+			res = rid;
+	}
+	return res;
 }
 
 static snd_ctl_map_t *remap_find_map_numid(snd_ctl_remap_t *priv, unsigned int numid)
 {
-	size_t count;
 	snd_ctl_map_t *map;
+	unsigned int item;
 
 	if (numid == 0)
 		return NULL;
-	map = priv->map;
-	for (count = priv->map_items; count > 0; count--, map++) {
+	remap_hash_for_each(&priv->map_numid_hash, remap_hash_numid(numid), item) {
+		map = &priv->map[item - 1];
 		if (numid == map->map_id.numid)
 			return map;
 	}
@@ -225,22 +403,24 @@ static snd_ctl_map_t *remap_find_map_numid(snd_ctl_remap_t *priv, unsigned int n
 
 static snd_ctl_map_t *remap_find_map_id(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id)
 {
-	size_t count;
-	snd_ctl_map_t *map;
+	snd_ctl_map_t *map, *res = NULL;
+	unsigned int item;
 
 	if (id->numid > 0)
 		return remap_find_map_numid(priv, id->numid);
-	map = priv->map;
-	for (count = priv->map_items; count > 0; count--, map++)
-		if (snd_ctl_elem_id_compare_set(id, &map->map_id) == 0)
-			return map;
-	return NULL;
+	remap_hash_for_each(&priv->map_hash, remap_hash_id(id), item) {
+		map = &priv->map[item - 1];
+		if (snd_ctl_elem_id_compare_set(id, &map->map_id) == 0 && (res == NULL || map < res))
+			res = map;
+	}
+	return res;
 }
 
 static int remap_id_to_child(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id, snd_ctl_remap_id_t **_rid)
 {
 	snd_ctl_remap_id_t *rid;
 	snd_ctl_numid_t *numid;
+	int err;
 
 	debug_id(id, "%s enter\n", __func__);
 	rid = remap_find_id_app(priv, id);
@@ -248,8 +428,10 @@ static int remap_id_to_child(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id, snd_c
 		if (rid->id_app.numid == 0) {
 			numid = remap_find_numid_app(priv, id->numid);
 			if (numid) {
-				rid->id_child.numid = numid->numid_child;
-				rid->id_app.numid = numid->numid_app;
+				err = remap_set_numid(priv, rid, numid->numid_child,
+						      numid->numid_app);
+				if (err < 0)
+					return err;
 			}
 		}
 		*id = rid->id_child;
@@ -270,14 +452,17 @@ static int remap_id_to_child(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id, snd_c
 static int remap_id_to_app(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id, snd_ctl_remap_id_t *rid, int err)
 {
 	snd_ctl_numid_t *numid;
+	int res;
 
 	if (rid) {
 		if (err >= 0 && rid->id_app.numid == 0) {
 			numid = remap_numid_child_new(priv, id->numid);
 			if (numid == NULL)
 				return -EIO;
-			rid->id_child.numid = numid->numid_child;
-			rid->id_app.numid = numid->numid_app;
+			res = remap_set_numid(priv, rid, numid->numid_child,
+					      numid->numid_app);
+			if (res < 0)
+				return res;
 		}
 		*id = rid->id_app;
 	} else {
@@ -301,11 +486,24 @@ static void remap_free(snd_ctl_remap_t *priv)
 		for (idx2 = 0; idx2 < map->controls_items; idx2++)
 			free(map->controls[idx2].channel_map);
 		free(map->controls);
+		free(map->values);
+		free(map->pvalues);
 	}
 	free(priv->map_read_queue);
 	free(priv->map);
+	free(priv->mctl);
 	free(priv->remap);
 	free(priv->numid);
+	remap_hash_free(&priv->numid_child_hash);
+	remap_hash_free(&priv->numid_app_hash);
+	remap_hash_free(&priv->remap_child_hash);
+	remap_hash_free(&priv->remap_app_hash);
+	remap_hash_free(&priv->remap_child_numid_hash);
+	remap_hash_free(&priv->remap_app_numid_hash);
+	remap_hash_free(&priv->map_hash);
+	remap_hash_free(&priv->map_numid_hash);
+	remap_hash_free(&priv->mctl_hash);
+	remap_hash_free(&priv->mctl_numid_hash);
 	free(priv);
 }
 
@@ -359,7 +557,9 @@ static int snd_ctl_remap_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list)
 		id = &list->pids[index];
 		rid = remap_find_id_child(priv, id);
 		if (rid) {
-			rid->id_app.numid = id->numid;
+			err = remap_set_numid(priv, rid, rid->id_child.numid, id->numid);
+			if (err < 0)
+				return err;
 			*id = rid->id_app;
 		}
 		numid = remap_find_numid_child(priv, id->numid);
@@ -476,11 +676,67 @@ static int snd_ctl_remap_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
 	return remap_id_to_app(priv, &info->id, rid, err);
 }
 
+/* the values of the child controls, allocated on the first sync */
+static int remap_map_values(snd_ctl_map_t *map)
+{
+	size_t item;
+
+	if (map->pvalues)
+		return 0;
+	map->values = calloc(map->controls_items, sizeof(*map->values));
+	if (map->values == NULL)
+		return -ENOMEM;
+	map->pvalues = malloc(map->controls_items * sizeof(*map->pvalues));
+	if (map->pvalues == NULL) {
+		free(map->values);
+		map->values = NULL;
+		return -ENOMEM;
+	}
+	for (item = 0; item < map->controls_items; item++)
+		map->pvalues[item] = &map->values[item];
+	return 0;
+}
+
+static int remap_child_batch(snd_ctl_remap_t *priv, snd_ctl_elem_value_t **values,
+			     unsigned int count, int write)
+{
+	int err;
+
+	while (count > 0) {
+		if (write)
+			err = snd_ctl_elem_write_batch(priv->child, values, count);
+		else
+			err = snd_ctl_elem_read_batch(priv->child, values, count);
+		if (err < 0)
+			return err;
+		values += err;
+		count -= err;
+	}
+	return 0;
+}
+
+/* read the child controls of the map in one batch */
+static int remap_map_read_children(snd_ctl_remap_t *priv, snd_ctl_map_t *map)
+{
+	size_t item;
+	int err;
+
+	err = remap_map_values(map);
+	if (err < 0)
+		return err;
+	for (item = 0; item < map->controls_items; item++) {
+		snd_ctl_elem_value_clear(&map->values[item]);
+		map->values[item].id = map->controls[item].id_child;
+		debug_id(&map->values[item].id, "%s controls[%zd]\n", __func__, item);
+	}
+	return remap_child_batch(priv, map->pvalues, map->controls_items, 0);
+}
+
 static int remap_map_elem_read(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *control)
 {
 	snd_ctl_map_t *map;
 	struct snd_ctl_map_ctl *mctl;
-	snd_ctl_elem_value_t control2;
+	snd_ctl_elem_value_t *control2;
 	size_t item, index;
 	int err;
 
@@ -488,34 +744,32 @@ static int remap_map_elem_read(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *cont
 	if (map == NULL)
 		return -EREMAPNOTFOUND;
 	debug_id(&control->id, "%s\n", __func__);
+	err = remap_map_read_children(priv, map);
+	if (err < 0)
+		return err;
 	snd_ctl_elem_value_clear(control);
 	control->id = map->map_id;
 	for (item = 0; item < map->controls_items; item++) {
 		mctl = &map->controls[item];
-		snd_ctl_elem_value_clear(&control2);
-		control2.id = mctl->id_child;
-		debug_id(&control2.id, "%s controls[%zd]\n", __func__, item);
-		err = snd_ctl_elem_read(priv->child, &control2);
-		if (err < 0)
-			return err;
+		control2 = &map->values[item];
 		if (map->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
 		    map->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
 			for (index = 0; index < mctl->channel_map_items; index++) {
 				long src = mctl->channel_map[index];
 				if ((unsigned long)src < ARRAY_SIZE(control->value.integer.value))
-					control->value.integer.value[index] = control2.value.integer.value[src];
+					control->value.integer.value[index] = control2->value.integer.value[src];
 			}
 		} else if (map->type == SNDRV_CTL_ELEM_TYPE_INTEGER64) {
 			for (index = 0; index < mctl->channel_map_items; index++) {
 				long src = mctl->channel_map[index];
 				if ((unsigned long)src < ARRAY_SIZE(control->value.integer64.value))
-					control->value.integer64.value[index] = control2.value.integer64.value[src];
+					control->value.integer64.value[index] = control2->value.integer64.value[src];
 			}
 		} else if (map->type == SNDRV_CTL_ELEM_TYPE_BYTES) {
 			for (index = 0; index < mctl->channel_map_items; index++) {
 				long src = mctl->channel_map[index];
 				if ((unsigned long)src < ARRAY_SIZE(control->value.bytes.data))
-					control->value.bytes.data[index] = control2.value.bytes.data[src];
+					control->value.bytes.data[index] = control2->value.bytes.data[src];
 			}
 		}
 	}
@@ -543,8 +797,8 @@ static int remap_map_elem_write(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *con
 {
 	snd_ctl_map_t *map;
 	struct snd_ctl_map_ctl *mctl;
-	snd_ctl_elem_value_t control2;
-	size_t item, index;
+	snd_ctl_elem_value_t *control2;
+	size_t item, index, changed;
 	int err, changes;
 
 	map = remap_find_map_id(priv, &control->id);
@@ -552,49 +806,51 @@ static int remap_map_elem_write(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *con
 		return -EREMAPNOTFOUND;
 	debug_id(&control->id, "%s\n", __func__);
 	control->id = map->map_id;
+	err = remap_map_read_children(priv, map);
+	if (err < 0)
+		return err;
+	/* the changed child values are moved to the front for the write */
+	changed = 0;
 	for (item = 0; item < map->controls_items; item++) {
 		mctl = &map->controls[item];
-		snd_ctl_elem_value_clear(&control2);
-		control2.id = mctl->id_child;
-		debug_id(&control2.id, "%s controls[%zd]\n", __func__, item);
-		err = snd_ctl_elem_read(priv->child, &control2);
-		if (err < 0)
-			return err;
+		control2 = map->pvalues[item];
 		changes = 0;
 		if (map->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
 		    map->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
 			for (index = 0; index < mctl->channel_map_items; index++) {
 				long dst = mctl->channel_map[index];
 				if ((unsigned long)dst < ARRAY_SIZE(control->value.integer.value)) {
-					changes |= control2.value.integer.value[dst] != control->value.integer.value[index];
-					control2.value.integer.value[dst] = control->value.integer.value[index];
+					changes |= control2->value.integer.value[dst] != control->value.integer.value[index];
+					control2->value.integer.value[dst] = control->value.integer.value[index];
 				}
 			}
 		} else if (map->type == SNDRV_CTL_ELEM_TYPE_INTEGER64) {
 			for (index = 0; index < mctl->channel_map_items; index++) {
 				long dst = mctl->channel_map[index];
 				if ((unsigned long)dst < ARRAY_SIZE(control->value.integer64.value)) {
-					changes |= control2.value.integer64.value[dst] != control->value.integer64.value[index];
-					control2.value.integer64.value[dst] = control->value.integer64.value[index];
+					changes |= control2->value.integer64.value[dst] != control->value.integer64.value[index];
+					control2->value.integer64.value[dst] = control->value.integer64.value[index];
 				}
 			}
 		} else if (map->type == SNDRV_CTL_ELEM_TYPE_BYTES) {
 			for (index = 0; index < mctl->channel_map_items; index++) {
 				long dst = mctl->channel_map[index];
 				if ((unsigned long)dst < ARRAY_SIZE(control->value.bytes.data)) {
-					changes |= control2.value.bytes.data[dst] != control->value.bytes.data[index];
-					control2.value.bytes.data[dst] = control->value.bytes.data[index];
+					changes |= control2->value.bytes.data[dst] != control->value.bytes.data[index];
+					control2->value.bytes.data[dst] = control->value.bytes.data[index];
 				}
 			}
 		}
-		debug_id(&control2.id, "%s changes %d\n", __func__, changes);
+		debug_id(&control2->id, "%s changes %d\n", __func__, changes);
 		if (changes > 0) {
-			err = snd_ctl_elem_write(priv->child, &control2);
-			if (err < 0)
-				return err;
+			map->pvalues[item] = map->pvalues[changed];
+			map->pvalues[changed++] = control2;
 		}
 	}
-	return 0;
+	err = remap_child_batch(priv, map->pvalues, changed, 1);
+	for (item = 0; item < map->controls_items; item++)
+		map->pvalues[item] = &map->values[item];
+	return err;
 }
 
 static int snd_ctl_remap_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
@@ -794,45 +1050,46 @@ static void _next_ptr(size_t *ptr, size_t count)
 	*ptr = (*ptr + 1) % count;
 }
 
+static void remap_event_for_map_control(snd_ctl_remap_t *priv,
+					snd_ctl_elem_id_t *id,
+					unsigned int event_mask,
+					struct snd_ctl_map_ref *ref)
+{
+	snd_ctl_map_t *map = &priv->map[ref->map];
+	struct snd_ctl_map_ctl *mctl = &map->controls[ref->ctl];
+
+	if (mctl->id_child.numid == 0) {
+		if (snd_ctl_elem_id_compare_set(id, &mctl->id_child))
+			return;
+		mctl->id_child.numid = id->numid;
+	}
+	if (id->numid != mctl->id_child.numid)
+		return;
+	debug_id(&map->map_id, "%s found (all)\n", __func__);
+	/* a pending mask means the map is queued already */
+	if (map->event_mask) {
+		map->event_mask |= event_mask;
+		return;
+	}
+	map->event_mask = event_mask;
+	debug_id(&map->map_id, "%s marking for read\n", __func__);
+	priv->map_read_queue[priv->map_read_queue_tail] = map;
+	_next_ptr(&priv->map_read_queue_tail, priv->map_items);
+}
+
 static void remap_event_for_all_map_controls(snd_ctl_remap_t *priv,
 					     snd_ctl_elem_id_t *id,
 					     unsigned int event_mask)
 {
-	size_t count, index, head;
-	snd_ctl_map_t *map;
-	struct snd_ctl_map_ctl *mctl;
-	int found;
+	unsigned int item;
 
 	if (event_mask == SNDRV_CTL_EVENT_MASK_REMOVE)
 		event_mask = SNDRV_CTL_EVENT_MASK_INFO;
-	map = priv->map;
-	for (count = priv->map_items; count > 0; count--, map++) {
-		for (index = 0; index < map->controls_items; index++) {
-			mctl = &map->controls[index];
-			if (mctl->id_child.numid == 0) {
-				if (snd_ctl_elem_id_compare_set(id, &mctl->id_child))
-					continue;
-				mctl->id_child.numid = id->numid;
-			}
-			if (id->numid != mctl->id_child.numid)
-				continue;
-			debug_id(&map->map_id, "%s found (all)\n", __func__);
-			map->event_mask |= event_mask;
-			found = 0;
-			for (head = priv->map_read_queue_head;
-			     head != priv->map_read_queue_tail;
-			     _next_ptr(&head, priv->map_items))
-				if (priv->map_read_queue[head] == map) {
-					found = 1;
-					break;
-				}
-			if (found)
-				continue;
-			debug_id(&map->map_id, "%s marking for read\n", __func__);
-			priv->map_read_queue[priv->map_read_queue_tail] = map;
-			_next_ptr(&priv->map_read_queue_tail, priv->map_items);
-		}
-	}
+	if (id->numid > 0)
+		remap_hash_for_each(&priv->mctl_numid_hash, remap_hash_numid(id->numid), item)
+			remap_event_for_map_control(priv, id, event_mask, &priv->mctl[item - 1]);
+	remap_hash_for_each(&priv->mctl_hash, remap_hash_id(id), item)
+		remap_event_for_map_control(priv, id, event_mask, &priv->mctl[item - 1]);
 }
 
 static int snd_ctl_remap_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
@@ -841,7 +1098,7 @@ static int snd_ctl_remap_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 	snd_ctl_remap_id_t *rid;
 	snd_ctl_numid_t *numid;
 	snd_ctl_map_t *map;
-	int err;
+	int err, res;
 
 	if (priv->map_read_queue_head != priv->map_read_queue_tail) {
 		map = priv->map_read_queue[priv->map_read_queue_head];
@@ -868,8 +1125,10 @@ static int snd_ctl_remap_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 				numid = remap_find_numid_child(priv, event->data.elem.id.numid);
 				if (numid == NULL)
 					return -EIO;
-				rid->id_child.numid = numid->numid_child;
-				rid->id_app.numid = numid->numid_app;
+				res = remap_set_numid(priv, rid, numid->numid_child,
+						      numid->numid_app);
+				if (res < 0)
+					return res;
 			}
 			event->data.elem.id = rid->id_app;
 		} else {
@@ -913,6 +1172,8 @@ static int add_to_remap(snd_ctl_remap_t *priv,
 			snd_ctl_elem_id_t *app)
 {
 	snd_ctl_remap_id_t *rid;
+	size_t item;
+	int err;
 
 	if (priv->remap_alloc == priv->remap_items) {
 		rid = realloc(priv->remap, (priv->remap_alloc + 16) * sizeof(*rid));
@@ -922,9 +1183,21 @@ static int add_to_remap(snd_ctl_remap_t *priv,
 		priv->remap_alloc += 16;
 		priv->remap = rid;
 	}
+	item = priv->remap_items;
+	err = remap_hash_add(&priv->remap_child_hash, item, remap_hash_id(child));
+	if (err < 0)
+		return err;
+	err = remap_hash_add(&priv->remap_app_hash, item, remap_hash_id(app));
+	if (err < 0)
+		return err;
 	rid = &priv->remap[priv->remap_items++];
 	rid->id_child = *child;
 	rid->id_app = *app;
+	rid->id_child.numid = 0;
+	rid->id_app.numid = 0;
+	err = remap_set_numid(priv, rid, child->numid, app->numid);
+	if (err < 0)
+		return err;
 	debug_id(&rid->id_child, "%s remap child\n", __func__);
 	debug_id(&rid->id_app, "%s remap app\n", __func__);
 	return 0;
@@ -979,6 +1252,7 @@ static int new_map(snd_ctl_remap_t *priv, snd_ctl_map_t **_map, snd_ctl_elem_id_
 {
 	snd_ctl_map_t *map;
 	snd_ctl_numid_t *numid;
+	int err;
 
 	if (priv->map_alloc == priv->map_items) {
 		map = realloc(priv->map, (priv->map_alloc + 16) * sizeof(*map));
@@ -988,20 +1262,47 @@ static int new_map(snd_ctl_remap_t *priv, snd_ctl_map_t **_map, snd_ctl_elem_id_
 		priv->map_alloc += 16;
 		priv->map = map;
 	}
-	map = &priv->map[priv->map_items++];
-	map->map_id = *id;
 	numid = remap_numid_new(priv, 0, ++priv->numid_app_last);
 	if (numid == NULL)
 		return -ENOMEM;
+	err = remap_hash_add(&priv->map_hash, priv->map_items, remap_hash_id(id));
+	if (err < 0)
+		return err;
+	err = remap_hash_add(&priv->map_numid_hash, priv->map_items,
+			     remap_hash_numid(numid->numid_app));
+	if (err < 0)
+		return err;
+	map = &priv->map[priv->map_items++];
+	map->map_id = *id;
 	map->map_id.numid = numid->numid_app;
 	debug_id(&map->map_id, "%s created\n", __func__);
 	*_map = map;
 	return 0;
 }
 
-static int add_ctl_to_map(snd_ctl_map_t *map, struct snd_ctl_map_ctl **_mctl, snd_ctl_elem_id_t *id)
+static int add_ctl_to_map(snd_ctl_remap_t *priv, snd_ctl_map_t *map,
+			  struct snd_ctl_map_ctl **_mctl, snd_ctl_elem_id_t *id)
 {
 	struct snd_ctl_map_ctl *mctl;
+	struct snd_ctl_map_ref *ref;
+	int err;
+
+	if (priv->mctl_alloc == priv->mctl_items) {
+		ref = realloc(priv->mctl, (priv->mctl_alloc + 16) * sizeof(*ref));
+		if (ref == NULL)
+			return -ENOMEM;
+		priv->mctl_alloc += 16;
+		priv->mctl = ref;
+	}
+	/* the events carry the full id, a numid only id is found by numid */
+	if (id->numid > 0)
+		err = remap_hash_add(&priv->mctl_numid_hash, priv->mctl_items,
+				     remap_hash_numid(id->numid));
+	else
+		err = remap_hash_add(&priv->mctl_hash, priv->mctl_items,
+				     remap_hash_id(id));
+	if (err < 0)
+		return err;
 
 	if (map->controls_alloc == map->controls_items) {
 		mctl = realloc(map->controls, (map->controls_alloc + 4) * sizeof(*mctl));
@@ -1011,6 +1312,9 @@ static int add_ctl_to_map(snd_ctl_map_t *map, struct snd_ctl_map_ctl **_mctl, sn
 		map->controls_alloc += 4;
 		map->controls = mctl;
 	}
+	ref = &priv->mctl[priv->mctl_items++];
+	ref->map = map - priv->map;
+	ref->ctl = map->controls_items;
 	mctl = &map->controls[map->controls_items++];
 	mctl->id_child = *id;
 	*_mctl = mctl;
@@ -1080,7 +1384,7 @@ static int parse_map_config(struct snd_ctl_map_ctl *mctl, snd_config_t *conf)
 	return 0;
 }
 
-static int parse_map1(snd_ctl_map_t *map, snd_config_t *conf)
+static int parse_map1(snd_ctl_remap_t *priv, snd_ctl_map_t *map, snd_config_t *conf)
 {
 	snd_config_iterator_t i, next;
 	snd_ctl_elem_id_t cid;
@@ -1098,7 +1402,7 @@ static int parse_map1(snd_ctl_map_t *map, snd_config_t *conf)
 			SNDERR("unable to parse control id '%s'!", id);
 			return -EINVAL;
 		}
-		err = add_ctl_to_map(map, &mctl, &cid);
+		err = add_ctl_to_map(priv, map, &mctl, &cid);
 		if (err < 0)
 			return err;
 		err = parse_map_config(mctl, n);
@@ -1132,7 +1436,7 @@ static int parse_map(snd_ctl_remap_t *priv, snd_config_t *conf)
 		err = new_map(priv, &map, &eid);
 		if (err < 0)
 			return 0;
-		err = parse_map1(map, n);
+		err = parse_map1(priv, map, n);
 		if (err < 0)
 			return err;
 	}
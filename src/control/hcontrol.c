@@ -95,6 +95,7 @@ int snd_hctl_open_ctl(snd_hctl_t **hctlp, snd_ctl_t *ctl)
 	if ((hctl = (snd_hctl_t *)calloc(1, sizeof(snd_hctl_t))) == NULL)
 		return -ENOMEM;
 	INIT_LIST_HEAD(&hctl->elems);
+	INIT_LIST_HEAD(&hctl->pending);
 	hctl->ctl = ctl;
 	*hctlp = hctl;
 	return 0;
@@ -343,11 +344,133 @@ static int _snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id, in
 	return idx;
 }
 
+static unsigned int hctl_hash_id(const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *p = id->name;
+	unsigned int h = 2166136261u;
+
+	while (*p)
+		h = (h ^ *p++) * 16777619u;
+	h ^= id->index * 0x9e3779b1u;
+	h ^= (id->iface << 24) ^ (id->device << 16) ^ id->subdevice;
+	return h;
+}
+
+/* the ID fields the default compare function looks at */
+static int hctl_id_equal(const snd_ctl_elem_id_t *id1,
+			 const snd_ctl_elem_id_t *id2)
+{
+	return id1->iface == id2->iface &&
+	       id1->device == id2->device &&
+	       id1->subdevice == id2->subdevice &&
+	       id1->index == id2->index &&
+	       !strcmp((const char *)id1->name, (const char *)id2->name);
+}
+
+static void hctl_hash_link(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	unsigned int mask = hctl->hash_size - 1;
+	snd_hctl_elem_t **numid = &hctl->hash[elem->id.numid & mask];
+	snd_hctl_elem_t **name = &hctl->hash[hctl->hash_size + (elem->hash & mask)];
+
+	elem->numid_next = *numid;
+	*numid = elem;
+	elem->name_next = *name;
+	*name = elem;
+}
+
+static void hctl_hash_unlink(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	unsigned int mask = hctl->hash_size - 1;
+	snd_hctl_elem_t **p;
+
+	if (!hctl->hash)
+		return;
+	for (p = &hctl->hash[elem->id.numid & mask]; *p; p = &(*p)->numid_next) {
+		if (*p == elem) {
+			*p = elem->numid_next;
+			break;
+		}
+	}
+	for (p = &hctl->hash[hctl->hash_size + (elem->hash & mask)]; *p;
+	     p = &(*p)->name_next) {
+		if (*p == elem) {
+			*p = elem->name_next;
+			break;
+		}
+	}
+}
+
+static void hctl_hash_free(snd_hctl_t *hctl)
+{
+	free(hctl->hash);
+	hctl->hash = NULL;
+	hctl->hash_size = 0;
+}
+
+/* size the index for at least count elements, on failure the lookups
+ * fall back to the binary search
+ */
+static void hctl_hash_build(snd_hctl_t *hctl, unsigned int count)
+{
+	unsigned int size = 16, idx;
+
+	while (size < count)
+		size <<= 1;
+	if (hctl->hash && size <= hctl->hash_size)
+		return;
+	hctl_hash_free(hctl);
+	hctl->hash = calloc(size * 2, sizeof(*hctl->hash));
+	if (!hctl->hash)
+		return;
+	hctl->hash_size = size;
+	for (idx = 0; idx < hctl->count; idx++)
+		hctl_hash_link(hctl, hctl->pelems[idx]);
+}
+
+/* the index matches the default and fast compare functions only */
+static int hctl_hash_find(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id,
+			  snd_hctl_elem_t **res)
+{
+	unsigned int mask = hctl->hash_size - 1;
+	snd_hctl_elem_t *elem;
+
+	if (!hctl->hash)
+		return -ENOENT;
+	if (hctl->compare == snd_hctl_compare_fast) {
+		for (elem = hctl->hash[id->numid & mask]; elem;
+		     elem = elem->numid_next)
+			if (elem->id.numid == id->numid)
+				break;
+		*res = elem;
+		return 0;
+	}
+	if (hctl->compare != snd_hctl_compare_default)
+		return -ENOENT;
+	if (id->numid) {
+		for (elem = hctl->hash[id->numid & mask]; elem;
+		     elem = elem->numid_next)
+			if (elem->id.numid == id->numid)
+				break;
+		if (elem && hctl_id_equal(&elem->id, id)) {
+			*res = elem;
+			return 0;
+		}
+	}
+	for (elem = hctl->hash[hctl->hash_size + (hctl_hash_id(id) & mask)];
+	     elem; elem = elem->name_next)
+		if (hctl_id_equal(&elem->id, id))
+			break;
+	*res = elem;
+	return 0;
+}
+
 static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 {
 	int dir;
 	int idx; 
 	elem->compare_weight = get_compare_weight(&elem->id);
+	elem->hash = hctl_hash_id(&elem->id);
 	if (hctl->count == hctl->alloc) {
 		snd_hctl_elem_t **h;
 		hctl->alloc += 32;
@@ -376,15 +499,31 @@ static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 		hctl->pelems[idx] = elem;
 	}
 	hctl->count++;
+	if (hctl->hash && hctl->count <= hctl->hash_size)
+		hctl_hash_link(hctl, elem);
+	else
+		hctl_hash_build(hctl, hctl->count);
 	return snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elem);
 }
 
+static void hctl_elem_drop_cache(snd_hctl_elem_t *elem)
+{
+	free(elem->info);
+	elem->info = NULL;
+	free(elem->tlv);
+	elem->tlv = NULL;
+}
+
 static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
 {
 	snd_hctl_elem_t *elem = hctl->pelems[idx];
 	unsigned int m;
 	snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
+	hctl_hash_unlink(hctl, elem);
+	if (elem->pending)
+		list_del(&elem->pending_list);
 	list_del(&elem->list);
+	hctl_elem_drop_cache(elem);
 	free(elem);
 	hctl->count--;
 	m = hctl->count - idx;
@@ -401,6 +540,7 @@ static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
  */
 int snd_hctl_free(snd_hctl_t *hctl)
 {
+	hctl_hash_free(hctl);
 	while (hctl->count > 0)
 		snd_hctl_elem_remove(hctl, hctl->count - 1);
 	free(hctl->pelems);
@@ -453,6 +593,38 @@ int snd_hctl_set_compare(snd_hctl_t *hctl, snd_hctl_compare_t compare)
 	return 0;
 }
 
+/**
+ * \brief Keep the element info and TLV data of an HCTL
+ * \param hctl HCTL handle
+ * \param enable 1 to keep the data, 0 to query the driver each time
+ * \return 0 on success otherwise a negative error code
+ *
+ * With the cache enabled, snd_hctl_elem_info() and snd_hctl_elem_tlv_read()
+ * ask the driver on the first call for an element only and return a copy
+ * of the answer afterwards.  The data is dropped when the driver reports
+ * a change of the element info or TLV, so the events must be handled with
+ * snd_hctl_handle_events() to keep it up to date.  The lock state and the
+ * owner in the returned info are as of the first call.  The item names of
+ * enumerated elements other than the first one are not cached.  When the
+ * cache is enabled before snd_hctl_load(), the info of all the elements is
+ * fetched there with one snd_ctl_elem_info_batch() call.
+ *
+ * The cache is disabled by default.  The handles opened by
+ * snd_mixer_attach() enable it.
+ */
+int snd_hctl_set_cache(snd_hctl_t *hctl, int enable)
+{
+	unsigned int idx;
+
+	assert(hctl);
+	hctl->cache = !!enable;
+	if (!hctl->cache) {
+		for (idx = 0; idx < hctl->count; idx++)
+			hctl_elem_drop_cache(hctl->pelems[idx]);
+	}
+	return 0;
+}
+
 /**
  * \brief A "don't care" fast compare functions that may be used with #snd_hctl_set_compare
  * \param c1 First HCTL element
@@ -550,13 +722,54 @@ snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem)
  */
 snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
 {
-	int dir;
-	int res = _snd_hctl_find_elem(hctl, id, &dir);
+	snd_hctl_elem_t *elem;
+	int dir, res;
+
+	assert(hctl && id);
+	if (hctl_hash_find(hctl, id, &elem) == 0)
+		return elem;
+	res = _snd_hctl_find_elem(hctl, id, &dir);
 	if (res < 0 || dir != 0)
 		return NULL;
 	return hctl->pelems[res];
 }
 
+/* fill the info cache of all the elements with a single batch call, the
+ * elements failing are left to snd_hctl_elem_info()
+ */
+static void hctl_prefetch_info(snd_hctl_t *hctl)
+{
+	snd_ctl_elem_info_t *infos, **pinfos;
+	snd_hctl_elem_t *elem;
+	unsigned int idx, done = 0;
+	int err;
+
+	infos = calloc(hctl->count, sizeof(*infos));
+	pinfos = malloc(hctl->count * sizeof(*pinfos));
+	if (!infos || !pinfos)
+		goto _end;
+	for (idx = 0; idx < hctl->count; idx++) {
+		infos[idx].id = hctl->pelems[idx]->id;
+		pinfos[idx] = &infos[idx];
+	}
+	while (done < hctl->count) {
+		err = snd_ctl_elem_info_batch(hctl->ctl, pinfos + done,
+					      hctl->count - done);
+		if (err < 0)
+			err = 0;
+		for (idx = done; idx < done + err; idx++) {
+			elem = hctl->pelems[idx];
+			elem->info = malloc(sizeof(*elem->info));
+			if (elem->info)
+				*elem->info = infos[idx];
+		}
+		done += err + 1;	/* skip the failing one */
+	}
+ _end:
+	free(pinfos);
+	free(infos);
+}
+
 /**
  * \brief Load an HCTL with all elements and sort them
  * \param hctl HCTL handle
@@ -602,6 +815,7 @@ int snd_hctl_load(snd_hctl_t *hctl)
 		elem->id = list.pids[idx];
 		elem->hctl = hctl;
 		elem->compare_weight = get_compare_weight(&elem->id);
+		elem->hash = hctl_hash_id(&elem->id);
 		hctl->pelems[idx] = elem;
 		list_add_tail(&elem->list, &hctl->elems);
 		hctl->count++;
@@ -609,6 +823,9 @@ int snd_hctl_load(snd_hctl_t *hctl)
 	if (!hctl->compare)
 		hctl->compare = snd_hctl_compare_default;
 	snd_hctl_sort(hctl);
+	hctl_hash_build(hctl, hctl->count);
+	if (hctl->cache && hctl->count)
+		hctl_prefetch_info(hctl);
 	for (idx = 0; idx < hctl->count; idx++) {
 		int res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD,
 					       hctl->pelems[idx]);
@@ -757,11 +974,28 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		if (res < 0)
 			return res;
 	}
+	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_TLV) {
+		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		if (elem) {
+			free(elem->tlv);
+			elem->tlv = NULL;
+		}
+	}
 	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
 				     SNDRV_CTL_EVENT_MASK_INFO)) {
 		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
 		if (!elem)
 			return -ENOENT;
+		if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_INFO)
+			hctl_elem_drop_cache(elem);
+		if (hctl->coalesce) {
+			if (!elem->pending)
+				list_add_tail(&elem->pending_list, &hctl->pending);
+			elem->pending |= event->data.elem.mask &
+					 (SNDRV_CTL_EVENT_MASK_VALUE |
+					  SNDRV_CTL_EVENT_MASK_INFO);
+			return 0;
+		}
 		res = snd_hctl_elem_throw_event(elem, event->data.elem.mask &
 						(SNDRV_CTL_EVENT_MASK_VALUE |
 						 SNDRV_CTL_EVENT_MASK_INFO));
@@ -771,6 +1005,51 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 	return 0;
 }
 
+/* deliver the coalesced events, all of them even when one callback fails */
+static int hctl_flush_pending(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem;
+	unsigned int mask;
+	int res, err = 0;
+
+	while (!list_empty(&hctl->pending)) {
+		elem = list_entry(hctl->pending.next, snd_hctl_elem_t,
+				  pending_list);
+		list_del(&elem->pending_list);
+		mask = elem->pending;
+		elem->pending = 0;
+		res = snd_hctl_elem_throw_event(elem, mask);
+		if (res < 0 && !err)
+			err = res;
+	}
+	return err;
+}
+
+/**
+ * \brief Merge the value and info events of an HCTL element
+ * \param hctl HCTL handle
+ * \param enable 1 to merge the events, 0 to deliver each one
+ * \return 0 on success otherwise a negative error code
+ *
+ * With the merging enabled, snd_hctl_handle_events() reads all the
+ * pending events first and calls the callback of each element once, with
+ * the value and info bits of all its events.  The add and remove events
+ * are still delivered as they are read, so the merged events of a batch
+ * follow them.  This saves the callbacks for the storms of value events
+ * some drivers send while they reconfigure.
+ *
+ * The merging is disabled by default.  The handles opened by
+ * snd_mixer_attach() enable it.
+ */
+int snd_hctl_set_coalesce(snd_hctl_t *hctl, int enable)
+{
+	assert(hctl);
+	hctl->coalesce = !!enable;
+	if (!hctl->coalesce)
+		return hctl_flush_pending(hctl);
+	return 0;
+}
+
 /**
  * \brief Handle pending HCTL events invoking callbacks
  * \param hctl HCTL handle
@@ -779,7 +1058,7 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 int snd_hctl_handle_events(snd_hctl_t *hctl)
 {
 	snd_ctl_event_t event;
-	int res;
+	int res, err;
 	unsigned int count = 0;
 	
 	assert(hctl);
@@ -787,12 +1066,17 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
 	while ((res = snd_ctl_read(hctl->ctl, &event)) != 0 &&
 	       res != -EAGAIN) {
 		if (res < 0)
-			return res;
+			break;
 		res = snd_hctl_handle_event(hctl, &event);
 		if (res < 0)
-			return res;
+			break;
 		count++;
 	}
+	err = hctl_flush_pending(hctl);
+	if (res < 0 && res != -EAGAIN)
+		return res;
+	if (err < 0)
+		return err;
 	return count;
 }
 
@@ -804,11 +1088,29 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
  */
 int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 {
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(info);
+	if (elem->info &&
+	    (elem->info->type != SND_CTL_ELEM_TYPE_ENUMERATED ||
+	     info->value.enumerated.item == elem->info->value.enumerated.item)) {
+		*info = *elem->info;
+		return 0;
+	}
 	info->id = elem->id;
-	return snd_ctl_elem_info(elem->hctl->ctl, info);
+	err = snd_ctl_elem_info(elem->hctl->ctl, info);
+	if (err < 0 || !elem->hctl->cache)
+		return err;
+	if (info->type == SND_CTL_ELEM_TYPE_ENUMERATED &&
+	    info->value.enumerated.item != 0)
+		return 0;
+	if (!elem->info)
+		elem->info = malloc(sizeof(*elem->info));
+	if (elem->info)
+		*elem->info = *info;
+	return 0;
 }
 
 /**
@@ -852,10 +1154,30 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
  */
 int snd_hctl_elem_tlv_read(snd_hctl_elem_t *elem, unsigned int *tlv, unsigned int tlv_size)
 {
+	unsigned int len;
+	int err;
+
 	assert(elem);
 	assert(tlv);
 	assert(tlv_size >= 12);
-	return snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
+	if (elem->tlv) {
+		len = elem->tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(unsigned int);
+		if (len <= tlv_size) {
+			memcpy(tlv, elem->tlv, len);
+			return 0;
+		}
+	}
+	err = snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
+	if (err < 0 || !elem->hctl->cache)
+		return err;
+	if (tlv[SNDRV_CTL_TLVO_LEN] > tlv_size - 2 * sizeof(unsigned int))
+		return err;
+	len = tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(unsigned int);
+	free(elem->tlv);
+	elem->tlv = malloc(len);
+	if (elem->tlv)
+		memcpy(elem->tlv, tlv, len);
+	return err;
 }
 
 /**
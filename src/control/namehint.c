@@ -27,6 +27,10 @@
  */
 
 #include "local.h"
+#include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define DEV_SKIP	9999 /* some non-existing device number */
@@ -46,6 +50,46 @@ struct hint_list {
 	int show_all;
 	char *cardname;
 };
+
+/*
+ * The hints of the previous calls.  They are valid as long as the
+ * configuration is not reloaded and the device directory, where the
+ * nodes of the cards and their devices are created and removed, is not
+ * modified.
+ */
+struct hint_cache_entry {
+	struct hint_cache_entry *next;
+	int card;
+	char *iface;
+	unsigned int count;
+	char **list;
+};
+
+static struct {
+	snd_config_t *config;
+	snd_config_update_t *update;
+	int dir_valid;
+	struct timespec dir_mtime;
+	struct timespec dir_ctime;
+	struct hint_cache_entry *entries;
+} hint_cache;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t hint_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void hint_cache_lock(void)
+{
+	pthread_mutex_lock(&hint_cache_mutex);
+}
+
+static inline void hint_cache_unlock(void)
+{
+	pthread_mutex_unlock(&hint_cache_mutex);
+}
+#else
+static inline void hint_cache_lock(void) { }
+static inline void hint_cache_unlock(void) { }
+#endif
 #endif
 
 static int hint_list_add(struct hint_list *list,
@@ -554,6 +598,112 @@ static int add_software_devices(snd_config_t *config, snd_config_t *rw_config,
 	return 0;
 }
 
+static void hint_cache_drop(void)
+{
+	struct hint_cache_entry *e;
+
+	while ((e = hint_cache.entries) != NULL) {
+		hint_cache.entries = e->next;
+		snd_device_name_free_hint((void **)e->list);
+		free(e->iface);
+		free(e);
+	}
+}
+
+/* checks the device directory, drops the hints when it was modified */
+static void hint_cache_check_devices(void)
+{
+	struct stat st;
+
+	if (stat(ALSA_DEVICE_DIRECTORY, &st) < 0) {
+		if (hint_cache.dir_valid)
+			hint_cache_drop();
+		hint_cache.dir_valid = 0;
+		return;
+	}
+	if (hint_cache.dir_valid &&
+	    hint_cache.dir_mtime.tv_sec == st.st_mtim.tv_sec &&
+	    hint_cache.dir_mtime.tv_nsec == st.st_mtim.tv_nsec &&
+	    hint_cache.dir_ctime.tv_sec == st.st_ctim.tv_sec &&
+	    hint_cache.dir_ctime.tv_nsec == st.st_ctim.tv_nsec)
+		return;
+	hint_cache_drop();
+	hint_cache.dir_mtime = st.st_mtim;
+	hint_cache.dir_ctime = st.st_ctim;
+	hint_cache.dir_valid = 1;
+}
+
+static char **hint_list_dup(char **list, unsigned int count)
+{
+	char **n;
+	unsigned int k;
+
+	n = calloc(count + 1, sizeof(*n));
+	if (n == NULL)
+		return NULL;
+	for (k = 0; k < count; k++) {
+		if (list[k] == NULL)
+			continue;
+		n[k] = strdup(list[k]);
+		if (n[k] == NULL) {
+			snd_device_name_free_hint((void **)n);
+			return NULL;
+		}
+	}
+	return n;
+}
+
+static struct hint_cache_entry *hint_cache_find(int card, const char *iface)
+{
+	struct hint_cache_entry *e;
+
+	for (e = hint_cache.entries; e; e = e->next)
+		if (e->card == card && strcmp(e->iface, iface) == 0)
+			return e;
+	return NULL;
+}
+
+/* keeps a copy of the hints, a failure only means no caching */
+static void hint_cache_add(int card, const char *iface, char **list,
+			   unsigned int count)
+{
+	struct hint_cache_entry *e;
+
+	e = calloc(1, sizeof(*e));
+	if (e == NULL)
+		return;
+	e->card = card;
+	e->iface = strdup(iface);
+	e->list = hint_list_dup(list, count);
+	if (e->iface == NULL || e->list == NULL) {
+		free(e->iface);
+		snd_device_name_free_hint((void **)e->list);
+		free(e);
+		return;
+	}
+	e->count = count;
+	e->next = hint_cache.entries;
+	hint_cache.entries = e;
+}
+
+/*
+ * Frees the cached hints and their configuration, called by
+ * snd_config_update_free_global().
+ */
+void _snd_device_name_hint_cache_free(void)
+{
+	hint_cache_lock();
+	hint_cache_drop();
+	if (hint_cache.config)
+		snd_config_delete(hint_cache.config);
+	if (hint_cache.update)
+		snd_config_update_free(hint_cache.update);
+	hint_cache.config = NULL;
+	hint_cache.update = NULL;
+	hint_cache.dir_valid = 0;
+	hint_cache_unlock();
+}
+
 /**
  * \brief Get a set of device name hints
  * \param card Card number or -1 (means all cards)
@@ -579,25 +729,47 @@ static int add_software_devices(snd_config_t *config, snd_config_t *rw_config,
  *
  * Special variables: defaults.namehint.showall specifies if all device
  * definitions are accepted (boolean type).
+ *
+ * The configuration is kept between the calls and the hints are cached
+ * until the configuration files change or a device node is created or
+ * removed in the device directory (like a card being hotplugged), so
+ * repeated calls do not probe the cards again.  The cache is disabled by
+ * setting defaults.namehint.cache to false.
  */
 int snd_device_name_hint(int card, const char *iface, void ***hints)
 {
 	struct hint_list list;
 	char ehints[24];
 	const char *str;
-	snd_config_t *conf, *local_config = NULL, *local_config_rw = NULL;
-	snd_config_update_t *local_config_update = NULL;
+	snd_config_t *conf, *local_config, *local_config_rw = NULL;
 	snd_config_iterator_t i, next;
-	int err;
+	struct hint_cache_entry *e;
+	int cache = 1, err;
 
 	if (hints == NULL)
 		return -EINVAL;
-	err = snd_config_update_r(&local_config, &local_config_update, NULL);
-	if (err < 0)
+	hint_cache_lock();
+	err = snd_config_update_r(&hint_cache.config, &hint_cache.update, NULL);
+	if (err < 0) {
+		hint_cache_unlock();
 		return err;
+	}
+	if (err > 0)
+		hint_cache_drop();
+	hint_cache_check_devices();
+	local_config = hint_cache.config;
+	if (snd_config_search(local_config, "defaults.namehint.cache", &conf) >= 0)
+		cache = snd_config_get_bool(conf) != 0;
+	if (cache && (e = hint_cache_find(card, iface)) != NULL) {
+		*hints = (void **)hint_list_dup(e->list, e->count);
+		hint_cache_unlock();
+		return *hints ? 0 : -ENOMEM;
+	}
 	err = snd_config_copy(&local_config_rw, local_config);
-	if (err < 0)
+	if (err < 0) {
+		hint_cache_unlock();
 		return err;
+	}
 	list.list = NULL;
 	list.count = list.allocated = 0;
 	list.siface = iface;
@@ -662,17 +834,17 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 	 */
 	if (!err && !list.list)
 		err = hint_list_add(&list, NULL, NULL);
-	if (err < 0)
+	if (err < 0) {
       		snd_device_name_free_hint((void **)list.list);
-	else
+	} else {
+		if (cache)
+			hint_cache_add(card, iface, list.list, list.count);
       		*hints = (void **)list.list;
+	}
 	free(list.cardname);
 	if (local_config_rw)
 		snd_config_delete(local_config_rw);
-	if (local_config)
-		snd_config_delete(local_config);
-	if (local_config_update)
-		snd_config_update_free(local_config_update);
+	hint_cache_unlock();
 	return err;
 }
 
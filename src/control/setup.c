@@ -53,6 +53,8 @@ struct _snd_sctl {
 	int mode;
 	snd_ctl_t *ctl;
 	struct list_head elems;
+	unsigned int count;		/* of elems */
+	snd_ctl_elem_value_t **values;	/* for the batch transfers */
 };
 #endif /* DOC_HIDDEN */
 
@@ -71,10 +73,28 @@ static int free_elems(snd_sctl_t *h)
 	}
 	if ((h->mode & SND_SCTL_NOFREE) == 0)
 		err = snd_ctl_close(h->ctl);
+	free(h->values);
 	free(h);
 	return err;
 }
 
+/* transfer all the values at once, the batch calls stop at an error */
+static int sctl_batch(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+		      unsigned int count,
+		      int (*batch)(snd_ctl_t *, snd_ctl_elem_value_t **,
+				   unsigned int))
+{
+	unsigned int done;
+	int err;
+
+	for (done = 0; done < count; done += err) {
+		err = batch(ctl, values + done, count - done);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
 /**
  * \brief Install given values to control elements
  * \param h Setup control handle
@@ -84,12 +104,11 @@ int snd_sctl_install(snd_sctl_t *h)
 {
 	struct list_head *pos;
 	int err;
-	unsigned int k;
+	unsigned int k, n = 0;
 	assert(h);
+	/* lock all, then read all the old values in one batch */
 	list_for_each(pos, &h->elems) {
 		snd_sctl_elem_t *elem = list_entry(pos, snd_sctl_elem_t, list);
-		unsigned int count;
-		snd_ctl_elem_type_t type;
 		if (elem->lock) {
 			err = snd_ctl_elem_lock(h->ctl, elem->id);
 			if (err < 0) {
@@ -97,11 +116,18 @@ int snd_sctl_install(snd_sctl_t *h)
 				return err;
 			}
 		}
-		err = snd_ctl_elem_read(h->ctl, elem->old);
-		if (err < 0) {
-			SNDERR("Cannot read ctl elem");
-			return err;
-		}
+		h->values[n++] = elem->old;
+	}
+	err = sctl_batch(h->ctl, h->values, n, snd_ctl_elem_read_batch);
+	if (err < 0) {
+		SNDERR("Cannot read ctl elem");
+		return err;
+	}
+	n = 0;
+	list_for_each(pos, &h->elems) {
+		snd_sctl_elem_t *elem = list_entry(pos, snd_sctl_elem_t, list);
+		unsigned int count;
+		snd_ctl_elem_type_t type;
 		count = snd_ctl_elem_info_get_count(elem->info);
 		type = snd_ctl_elem_info_get_type(elem->info);
 		switch (type) {
@@ -164,11 +190,16 @@ int snd_sctl_install(snd_sctl_t *h)
 			assert(0);
 			break;
 		}
-		err = snd_ctl_elem_write(h->ctl, elem->val);
-		if (err < 0) {
-			SNDERR("Cannot write ctl elem");
-			return err;
-		}
+		/* the elements already set, e.g. by an earlier hw_params */
+		if (memcmp(&elem->val->value, &elem->old->value,
+			   sizeof(elem->val->value)) == 0)
+			continue;
+		h->values[n++] = elem->val;
+	}
+	err = sctl_batch(h->ctl, h->values, n, snd_ctl_elem_write_batch);
+	if (err < 0) {
+		SNDERR("Cannot write ctl elem");
+		return err;
 	}
 	return 0;
 }
@@ -182,6 +213,7 @@ int snd_sctl_remove(snd_sctl_t *h)
 {
 	struct list_head *pos;
 	int err;
+	unsigned int n = 0;
 	assert(h);
 	list_for_each(pos, &h->elems) {
 		snd_sctl_elem_t *elem = list_entry(pos, snd_sctl_elem_t, list);
@@ -202,13 +234,13 @@ int snd_sctl_remove(snd_sctl_t *h)
 		 * modem "on the phone" now that there isn't any playback or
 		 * recording active.
 		 */
-		if (elem->preserve && snd_ctl_elem_value_compare(elem->val, elem->old)) {
-			err = snd_ctl_elem_write(h->ctl, elem->old);
-			if (err < 0) {
-				SNDERR("Cannot restore ctl elem");
-				return err;
-			}
-		}
+		if (elem->preserve && snd_ctl_elem_value_compare(elem->val, elem->old))
+			h->values[n++] = elem->old;
+	}
+	err = sctl_batch(h->ctl, h->values, n, snd_ctl_elem_write_batch);
+	if (err < 0) {
+		SNDERR("Cannot restore ctl elem");
+		return err;
 	}
 	return 0;
 }
@@ -569,6 +601,7 @@ static int add_elem(snd_sctl_t *h, snd_config_t *_conf, snd_config_t *private_da
 	if (err < 0)
 		goto _err;
 	list_add_tail(&elem->list, &h->elems);
+	h->count++;
 
  _err:
  	if (err < 0 && elem) {
@@ -632,6 +665,13 @@ int snd_sctl_build(snd_sctl_t **sctl, snd_ctl_t *handle, snd_config_t *conf, snd
 		if (quit)
 			break;
 	}
+	if (h->count) {
+		h->values = malloc(h->count * sizeof(*h->values));
+		if (!h->values) {
+			free_elems(h);
+			return -ENOMEM;
+		}
+	}
 	*sctl = h;
 	return 0;
 }
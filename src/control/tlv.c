@@ -419,6 +419,391 @@ int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 	return -EINVAL;
 }
 
+#ifndef DOC_HIDDEN
+/* max raw range of a DB_LINEAR curve to tabulate for the array conversion */
+#define MAX_TLV_DB_TABLE	4096
+
+/* one curve of a pre-parsed TLV; a DB_RANGE gives one per sub-range */
+struct tlv_dB_seg {
+	unsigned int type;
+	long min, max;		/* raw range, as used by the dB conversion */
+	long submax;		/* max clamped to the control range */
+	long dbmin, dbmax;	/* dB range of min..submax */
+	int mindb, maxdb;
+	int step, mute;		/* DB_SCALE */
+#ifndef HAVE_SOFT_FLOAT
+	double lmin, lmax;	/* DB_LINEAR bounds as linear gains */
+	int *table;		/* DB_LINEAR gains of min..max, or NULL */
+#endif
+};
+
+struct _snd_tlv_dB {
+	long rangemin, rangemax;
+	unsigned int nsegs;
+	unsigned int nfrom;	/* segments searched by the dB to raw conversion */
+	int is_range;
+	struct tlv_dB_seg segs[];
+};
+#endif
+
+static long seg_to_dB(const struct tlv_dB_seg *s, long volume)
+{
+	switch (s->type) {
+	case SND_CTL_TLVT_DB_SCALE:
+		if (s->mute && volume <= s->min)
+			return SND_CTL_TLV_DB_GAIN_MUTE;
+		return (volume - s->min) * s->step + s->mindb;
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE:
+		if (volume <= s->min || s->max <= s->min)
+			return s->type == SND_CTL_TLVT_DB_MINMAX_MUTE ?
+				SND_CTL_TLV_DB_GAIN_MUTE : s->mindb;
+		if (volume >= s->max)
+			return s->maxdb;
+		return (s->maxdb - s->mindb) * (volume - s->min) /
+			(s->max - s->min) + s->mindb;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		double val;
+		if (volume <= s->min || s->max <= s->min)
+			return s->mindb;
+		if (volume >= s->max)
+			return s->maxdb;
+		val = (double)(volume - s->min) / (double)(s->max - s->min);
+		if (s->mindb <= SND_CTL_TLV_DB_GAIN_MUTE)
+			return (long)(100.0 * 20.0 * log10(val)) + s->maxdb;
+		val = (s->lmax - s->lmin) * val + s->lmin;
+		return (long)(100.0 * 20.0 * log10(val));
+	}
+#endif
+	}
+	return SND_CTL_TLV_DB_GAIN_MUTE;
+}
+
+/* convert a whole array through one curve, the type switch out of the loops */
+static void seg_to_dB_array(const struct tlv_dB_seg *s, const long *volume,
+			    long *db_gain, unsigned int count)
+{
+	unsigned int i;
+	long v;
+
+	switch (s->type) {
+	case SND_CTL_TLVT_DB_SCALE:
+		for (i = 0; i < count; i++)
+			db_gain[i] = (volume[i] - s->min) * s->step + s->mindb;
+		if (s->mute)
+			for (i = 0; i < count; i++)
+				if (volume[i] <= s->min)
+					db_gain[i] = SND_CTL_TLV_DB_GAIN_MUTE;
+		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR:
+		if (s->table) {
+			for (i = 0; i < count; i++) {
+				v = volume[i];
+				if (v <= s->min)
+					db_gain[i] = s->mindb;
+				else if (v >= s->max)
+					db_gain[i] = s->maxdb;
+				else
+					db_gain[i] = s->table[v - s->min];
+			}
+			break;
+		}
+#endif
+		/* fallthrough */
+	default:
+		for (i = 0; i < count; i++)
+			db_gain[i] = seg_to_dB(s, volume[i]);
+		break;
+	}
+}
+
+static long seg_from_dB(const struct tlv_dB_seg *s, long rangemin, long rangemax,
+			long db_gain, int xdir)
+{
+	long v;
+
+	switch (s->type) {
+	case SND_CTL_TLVT_DB_SCALE: {
+		int max = s->mindb + (int)(s->step * (rangemax - rangemin));
+		if (db_gain <= s->mindb) {
+			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
+			    s->mute)
+				return rangemin + 1;
+			return rangemin;
+		}
+		if (db_gain >= max)
+			return rangemax;
+		v = (db_gain - s->mindb) * (rangemax - rangemin);
+		if (xdir > 0)
+			v += (max - s->mindb) - 1;
+		else if (xdir == 0)
+			v += ((max - s->mindb) + 1) / 2;
+		return v / (max - s->mindb) + rangemin;
+	}
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE:
+		if (db_gain <= s->mindb) {
+			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
+			    s->type == SND_CTL_TLVT_DB_MINMAX_MUTE)
+				return rangemin + 1;
+			return rangemin;
+		}
+		if (db_gain >= s->maxdb)
+			return rangemax;
+		v = (db_gain - s->mindb) * (rangemax - rangemin);
+		if (xdir > 0)
+			v += (s->maxdb - s->mindb) - 1;
+		else if (xdir == 0)
+			v += ((s->maxdb - s->mindb) + 1) / 2;
+		return v / (s->maxdb - s->mindb) + rangemin;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		double vmin, vmax, d;
+		if (db_gain <= s->mindb)
+			return rangemin;
+		if (db_gain >= s->maxdb)
+			return rangemax;
+		vmin = s->mindb <= SND_CTL_TLV_DB_GAIN_MUTE ? 0.0 : s->lmin;
+		vmax = !s->maxdb ? 1.0 : s->lmax;
+		d = pow(10.0, (double)db_gain / 2000.0);
+		d = (d - vmin) * (rangemax - rangemin) / (vmax - vmin);
+		if (xdir > 0)
+			d = ceil(d);
+		else if (xdir == 0)
+			d = lrint(d);
+		return (long)d + rangemin;
+	}
+#endif
+	}
+	return rangemin;
+}
+
+static int seg_init(struct tlv_dB_seg *s, unsigned int *tlv, long min, long max)
+{
+	s->type = tlv[SNDRV_CTL_TLVO_TYPE];
+	s->min = min;
+	s->max = max;
+	switch (s->type) {
+	case SND_CTL_TLVT_DB_SCALE:
+		s->mindb = (int)tlv[SNDRV_CTL_TLVO_DB_SCALE_MIN];
+		s->step = tlv[SNDRV_CTL_TLVO_DB_SCALE_MUTE_AND_STEP] & 0xffff;
+		s->mute = (tlv[SNDRV_CTL_TLVO_DB_SCALE_MUTE_AND_STEP] >> 16) & 1;
+		return 0;
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE:
+		s->mindb = (int)tlv[SNDRV_CTL_TLVO_DB_MINMAX_MIN];
+		s->maxdb = (int)tlv[SNDRV_CTL_TLVO_DB_MINMAX_MAX];
+		return 0;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		long v;
+		s->mindb = (int)tlv[SNDRV_CTL_TLVO_DB_LINEAR_MIN];
+		s->maxdb = (int)tlv[SNDRV_CTL_TLVO_DB_LINEAR_MAX];
+		s->lmin = pow(10.0, s->mindb / 2000.0);
+		s->lmax = pow(10.0, s->maxdb / 2000.0);
+		if (max <= min || max - min >= MAX_TLV_DB_TABLE)
+			return 0;
+		s->table = malloc((max - min + 1) * sizeof(*s->table));
+		if (!s->table)
+			return -ENOMEM;
+		for (v = min; v <= max; v++)
+			s->table[v - min] = seg_to_dB(s, v);
+		return 0;
+	}
+#endif
+	}
+	return -EINVAL;
+}
+
+/**
+ * \brief Close a pre-parsed dB TLV
+ * \param db the handle returned by #snd_tlv_dB_open()
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_dB_close(snd_tlv_dB_t *db)
+{
+#ifndef HAVE_SOFT_FLOAT
+	unsigned int i;
+
+	for (i = 0; i < db->nsegs; i++)
+		free(db->segs[i].table);
+#endif
+	free(db);
+	return 0;
+}
+
+/**
+ * \brief Pre-parse a dB TLV for the array conversions
+ * \param dbp the pointer to store the new handle
+ * \param tlv the TLV source returned by #snd_tlv_parse_dB_info()
+ * \param rangemin the minimum value of the raw volume
+ * \param rangemax the maximum value of the raw volume
+ * \return 0 if successful, or a negative error code
+ *
+ * The sub-ranges of a DB_RANGE TLV are resolved, and the constants of
+ * the conversions are computed once.  The gains of a DB_LINEAR curve
+ * over a raw range of up to 4096 values are tabulated.  The TLV source
+ * is not referenced by the handle and can be freed.
+ *
+ * The conversions give the same results as #snd_tlv_convert_to_dB() and
+ * #snd_tlv_convert_from_dB().  A DB_RANGE nested in a DB_RANGE is not
+ * supported.
+ */
+int snd_tlv_dB_open(snd_tlv_dB_t **dbp, unsigned int *tlv,
+		    long rangemin, long rangemax)
+{
+	snd_tlv_dB_t *db;
+	unsigned int pos, len, nsegs = 1;
+	int err;
+
+	len = int_index(tlv[SNDRV_CTL_TLVO_LEN]) + 2;
+	if (tlv[SNDRV_CTL_TLVO_TYPE] == SND_CTL_TLVT_DB_RANGE) {
+		if (len < 6 || len > MAX_TLV_RANGE_SIZE)
+			return -EINVAL;
+		nsegs = 0;
+		for (pos = 2; pos + 4 <= len; pos += int_index(tlv[pos + 3]) + 4)
+			nsegs++;
+	}
+	db = calloc(1, sizeof(*db) + nsegs * sizeof(db->segs[0]));
+	if (!db)
+		return -ENOMEM;
+	db->rangemin = rangemin;
+	db->rangemax = rangemax;
+	db->nsegs = nsegs;
+	db->nfrom = nsegs;
+	if (tlv[SNDRV_CTL_TLVO_TYPE] != SND_CTL_TLVT_DB_RANGE) {
+		err = seg_init(&db->segs[0], tlv, rangemin, rangemax);
+		if (err < 0)
+			goto error;
+		db->segs[0].submax = rangemax;
+		*dbp = db;
+		return 0;
+	}
+
+	db->is_range = 1;
+	db->nfrom = 0;
+	db->nsegs = 0;
+	for (pos = 2; pos + 4 <= len; pos += int_index(tlv[pos + 3]) + 4) {
+		struct tlv_dB_seg *s = &db->segs[db->nsegs];
+		unsigned int *sub = tlv + pos + 2;
+		err = -EINVAL;
+		if (pos + 4 + int_index(sub[SNDRV_CTL_TLVO_LEN]) > len ||
+		    sub[SNDRV_CTL_TLVO_TYPE] == SND_CTL_TLVT_DB_RANGE)
+			goto error;
+		err = seg_init(s, sub, (int)tlv[pos], (int)tlv[pos + 1]);
+		db->nsegs++;
+		if (err < 0)
+			goto error;
+		s->submax = s->max < rangemax ? s->max : rangemax;
+		err = snd_tlv_get_dB_range(sub, s->min, s->submax,
+					   &s->dbmin, &s->dbmax);
+		if (err < 0)
+			goto error;
+		/* as snd_tlv_convert_from_dB(), stop at the end of the control range */
+		if (!db->nfrom && s->submax == rangemax)
+			db->nfrom = db->nsegs;
+	}
+	if (!db->nfrom)
+		db->nfrom = db->nsegs;
+	*dbp = db;
+	return 0;
+
+ error:
+	snd_tlv_dB_close(db);
+	return err;
+}
+
+/**
+ * \brief Convert an array of raw volume values to dB gains
+ * \param db the handle returned by #snd_tlv_dB_open()
+ * \param volume the raw volume values to convert
+ * \param db_gain the array to store the dB gains (in 0.01dB unit)
+ * \param count the number of values
+ * \return 0 if successful, or a negative error code
+ *
+ * When a volume is outside of all the sub-ranges of a DB_RANGE TLV, its
+ * gain is set to #SND_CTL_TLV_DB_GAIN_MUTE, the other values are still
+ * converted and -EINVAL is returned.
+ */
+int snd_tlv_convert_to_dB_array(const snd_tlv_dB_t *db, const long *volume,
+				long *db_gain, unsigned int count)
+{
+	const struct tlv_dB_seg *s;
+	unsigned int i, j;
+	int err = 0;
+
+	if (!db->is_range) {
+		seg_to_dB_array(&db->segs[0], volume, db_gain, count);
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < db->nsegs; j++) {
+			s = &db->segs[j];
+			if (volume[i] >= s->min && volume[i] <= s->max)
+				break;
+		}
+		if (j == db->nsegs) {
+			db_gain[i] = SND_CTL_TLV_DB_GAIN_MUTE;
+			err = -EINVAL;
+			continue;
+		}
+#ifndef HAVE_SOFT_FLOAT
+		if (s->table) {
+			db_gain[i] = s->table[volume[i] - s->min];
+			continue;
+		}
+#endif
+		db_gain[i] = seg_to_dB(s, volume[i]);
+	}
+	return err;
+}
+
+/**
+ * \brief Convert an array of dB gains to the corresponding raw values
+ * \param db the handle returned by #snd_tlv_dB_open()
+ * \param db_gain the dB gains to convert (in 0.01dB unit)
+ * \param value the array to store the converted raw volume values
+ * \param count the number of values
+ * \param xdir the direction for round-up, as for #snd_tlv_convert_from_dB()
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_convert_from_dB_array(const snd_tlv_dB_t *db, const long *db_gain,
+				  long *value, unsigned int count, int xdir)
+{
+	const struct tlv_dB_seg *s;
+	unsigned int i, j;
+	long prev_submax;
+
+	if (!db->is_range) {
+		s = &db->segs[0];
+		for (i = 0; i < count; i++)
+			value[i] = seg_from_dB(s, db->rangemin, db->rangemax,
+					       db_gain[i], xdir);
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		prev_submax = 0;
+		for (j = 0; j < db->nfrom; j++) {
+			s = &db->segs[j];
+			if (db_gain[i] >= s->dbmin && db_gain[i] <= s->dbmax) {
+				prev_submax = seg_from_dB(s, s->min, s->submax,
+							  db_gain[i], xdir);
+				break;
+			}
+			if (db_gain[i] < s->dbmin) {
+				if (xdir > 0 || j == 0)
+					prev_submax = s->min;
+				break;
+			}
+			prev_submax = s->submax;
+		}
+		value[i] = prev_submax;
+	}
+	return 0;
+}
+
 #ifndef DOC_HIDDEN
 #define TEMP_TLV_SIZE		4096
 struct tlv_info {
@@ -286,6 +286,8 @@ struct dlobj_cache {
 	void *func;
 	unsigned int refcnt;
 	struct list_head list;
+	struct list_head name_list;	/* in the bucket of lib and name */
+	struct list_head func_list;	/* in the bucket of func */
 };
 
 #ifdef HAVE_LIBPTHREAD
@@ -307,17 +309,64 @@ static inline void snd_dlobj_unlock(void) {}
 
 static LIST_HEAD(pcm_dlobj_list);
 
+/*
+ * Every open of a plugin looks up its open function, so the entries are
+ * also hashed by the library and the symbol name, and by the function
+ * for snd_dlobj_cache_put().
+ */
+#define DLOBJ_HASH_SIZE	64
+
+static struct list_head dlobj_name_hash[DLOBJ_HASH_SIZE];
+static struct list_head dlobj_func_hash[DLOBJ_HASH_SIZE];
+static int dlobj_hash_init;
+
+static void dlobj_hash_setup(void)
+{
+	unsigned int i;
+
+	if (dlobj_hash_init)
+		return;
+	for (i = 0; i < DLOBJ_HASH_SIZE; i++) {
+		INIT_LIST_HEAD(&dlobj_name_hash[i]);
+		INIT_LIST_HEAD(&dlobj_func_hash[i]);
+	}
+	dlobj_hash_init = 1;
+}
+
+static unsigned int dlobj_name_hash_key(const char *lib, const char *name)
+{
+	unsigned int h = 5381;
+
+	if (lib) {
+		while (*lib)
+			h = h * 33 + (unsigned char)*lib++;
+	}
+	h = h * 33;	/* separate the library from the name */
+	while (*name)
+		h = h * 33 + (unsigned char)*name++;
+	return h % DLOBJ_HASH_SIZE;
+}
+
+static unsigned int dlobj_func_hash_key(void *func)
+{
+	uintptr_t v = (uintptr_t)func;
+
+	return (unsigned int)((v >> 4) ^ (v >> 12)) % DLOBJ_HASH_SIZE;
+}
+
 static struct dlobj_cache *
 snd_dlobj_cache_get0(const char *lib, const char *name,
 		     const char *version, int verbose)
 {
-	struct list_head *p;
+	struct list_head *p, *bucket;
 	struct dlobj_cache *c;
 	void *func, *dlobj;
 	char errbuf[256];
 
-	list_for_each(p, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
+	dlobj_hash_setup();
+	bucket = &dlobj_name_hash[dlobj_name_hash_key(lib, name)];
+	list_for_each(p, bucket) {
+		c = list_entry(p, struct dlobj_cache, name_list);
 		if (c->lib && lib && strcmp(c->lib, lib) != 0)
 			continue;
 		if (!c->lib && lib)
@@ -366,6 +415,8 @@ snd_dlobj_cache_get0(const char *lib, const char *name,
 	c->dlobj = dlobj;
 	c->func = func;
 	list_add_tail(&c->list, &pcm_dlobj_list);
+	list_add_tail(&c->name_list, bucket);
+	list_add_tail(&c->func_list, &dlobj_func_hash[dlobj_func_hash_key(func)]);
 	return c;
 }
 
@@ -410,8 +461,12 @@ int snd_dlobj_cache_put(void *func)
 		return -ENOENT;
 
 	snd_dlobj_lock();
-	list_for_each(p, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
+	if (!dlobj_hash_init) {
+		snd_dlobj_unlock();
+		return -ENOENT;
+	}
+	list_for_each(p, &dlobj_func_hash[dlobj_func_hash_key(func)]) {
+		c = list_entry(p, struct dlobj_cache, func_list);
 		if (c->func == func) {
 			refcnt = c->refcnt;
 			if (c->refcnt > 0)
@@ -424,6 +479,144 @@ int snd_dlobj_cache_put(void *func)
 	return -ENOENT;
 }
 
+/*
+ * coefficient cache
+ *
+ * Filter tables of the rate converters shared by all instances in the
+ * process.  The entries are keyed by the converter name, the (reduced)
+ * conversion ratio and the quality.  A few unused entries are kept,
+ * so that streams opened and closed in a row don't rebuild the tables.
+ */
+
+#define SND_COEF_CACHE_UNUSED_MAX	4
+
+struct coef_cache {
+	const char *converter;
+	unsigned int in_rate;
+	unsigned int out_rate;
+	unsigned int quality;
+	void *data;
+	void (*destroy)(void *data);
+	unsigned int refcnt;
+	struct list_head list;
+};
+
+static LIST_HEAD(coef_cache_list);
+
+static void coef_cache_free(struct coef_cache *c)
+{
+	list_del(&c->list);
+	if (c->destroy)
+		c->destroy(c->data);
+	free((void *)c->converter);
+	free(c);
+}
+
+/* drop the oldest unused entries above the limit */
+static void coef_cache_trim(unsigned int max)
+{
+	struct list_head *p, *npos;
+	struct coef_cache *c;
+	unsigned int unused = 0;
+
+	list_for_each(p, &coef_cache_list) {
+		c = list_entry(p, struct coef_cache, list);
+		if (!c->refcnt)
+			unused++;
+	}
+	list_for_each_safe(p, npos, &coef_cache_list) {
+		if (unused <= max)
+			break;
+		c = list_entry(p, struct coef_cache, list);
+		if (c->refcnt)
+			continue;
+		coef_cache_free(c);
+		unused--;
+	}
+}
+
+/*
+ * The returned table is shared with other instances and must not be
+ * modified.  The create callback is called with the cache locked.
+ */
+void *snd_coef_cache_get(const char *converter, unsigned int in_rate,
+			 unsigned int out_rate, unsigned int quality,
+			 void *(*create)(void *arg),
+			 void (*destroy)(void *data), void *arg)
+{
+	struct list_head *p;
+	struct coef_cache *c;
+	void *data = NULL;
+
+	snd_dlobj_lock();
+	list_for_each(p, &coef_cache_list) {
+		c = list_entry(p, struct coef_cache, list);
+		if (c->in_rate == in_rate && c->out_rate == out_rate &&
+		    c->quality == quality &&
+		    strcmp(c->converter, converter) == 0) {
+			c->refcnt++;
+			data = c->data;
+			goto __unlock;
+		}
+	}
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		goto __unlock;
+	c->converter = strdup(converter);
+	if (!c->converter)
+		goto __free;
+	data = create(arg);
+	if (!data) {
+		free((void *)c->converter);
+	      __free:
+		free(c);
+		goto __unlock;
+	}
+	c->in_rate = in_rate;
+	c->out_rate = out_rate;
+	c->quality = quality;
+	c->data = data;
+	c->destroy = destroy;
+	c->refcnt = 1;
+	list_add_tail(&c->list, &coef_cache_list);
+      __unlock:
+	snd_dlobj_unlock();
+	return data;
+}
+
+int snd_coef_cache_put(void *data)
+{
+	struct list_head *p;
+	struct coef_cache *c;
+
+	if (!data)
+		return -ENOENT;
+
+	snd_dlobj_lock();
+	list_for_each(p, &coef_cache_list) {
+		c = list_entry(p, struct coef_cache, list);
+		if (c->data != data)
+			continue;
+		if (c->refcnt > 0 && --c->refcnt == 0) {
+			/* the most recently used entries are the last ones */
+			list_del(&c->list);
+			list_add_tail(&c->list, &coef_cache_list);
+			coef_cache_trim(SND_COEF_CACHE_UNUSED_MAX);
+		}
+		snd_dlobj_unlock();
+		return 0;
+	}
+	snd_dlobj_unlock();
+	return -ENOENT;
+}
+
+void snd_coef_cache_cleanup(void)
+{
+	snd_dlobj_lock();
+	coef_cache_trim(0);
+	snd_dlobj_unlock();
+}
+
 void snd_dlobj_cache_cleanup(void)
 {
 	struct list_head *p, *npos;
@@ -435,12 +628,15 @@ void snd_dlobj_cache_cleanup(void)
 		if (c->refcnt)
 			continue;
 		list_del(p);
+		list_del(&c->name_list);
+		list_del(&c->func_list);
 		snd_dlclose(c->dlobj);
 		free((void *)c->name); /* shut up gcc warning */
 		free((void *)c->lib); /* shut up gcc warning */
 		free(c);
 	}
 	snd_dlobj_unlock();
+	snd_coef_cache_cleanup();
 	snd_dlpath_lock();
 	snd_plugin_dir_set = 0;
 	free(snd_plugin_dir);
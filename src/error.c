@@ -33,6 +33,11 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#ifdef HAVE_LIBPTHREAD
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#endif
 
 /**
  * Array of error codes in US ASCII.
@@ -82,6 +87,205 @@ snd_local_error_handler_t snd_lib_error_set_local(snd_local_error_handler_t func
 	return old;
 }
 
+#ifdef HAVE_LIBPTHREAD
+
+/*
+ * Asynchronous error log
+ *
+ * The messages are formatted to the slots of a bounded lock-free queue,
+ * the sequence number of a slot tells whether it is free (== position),
+ * filled (== position + 1) or not consumed yet from the previous round.
+ * A thread writes the filled slots to stderr. Each call site (hashed)
+ * is limited to ERR_LOG_BURST messages per second, the next message
+ * which passes tells how many were suppressed.
+ */
+
+#define ERR_LOG_SLOTS		64	/* power of two */
+#define ERR_LOG_TEXT		256
+#define ERR_LOG_SITES		64	/* power of two */
+#define ERR_LOG_BURST		10
+#define ERR_LOG_PERIOD_MS	50
+
+struct err_log_slot {
+	unsigned int seq;
+	char text[ERR_LOG_TEXT];
+};
+
+struct err_log_site {
+	unsigned int sec;
+	unsigned int count;
+	unsigned int suppressed;
+};
+
+static struct err_log_slot err_log_slots[ERR_LOG_SLOTS];
+static struct err_log_site err_log_sites[ERR_LOG_SITES];
+static unsigned int err_log_head, err_log_tail;
+static unsigned int err_log_dropped;
+static int err_log_ready, err_log_enabled, err_log_stop;
+static pthread_t err_log_thread;
+
+/* count the message for its call site, 0 when it is over the limit */
+static int err_log_allow(const char *file, int line, unsigned int *suppressed)
+{
+	struct err_log_site *site;
+	struct timespec ts;
+	unsigned int h, sec;
+
+	h = ((unsigned int)(uintptr_t)file + line) * 2654435761U;
+	site = &err_log_sites[h >> 26 & (ERR_LOG_SITES - 1)];
+#ifdef CLOCK_MONOTONIC_COARSE
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+	sec = ts.tv_sec;
+	if (__atomic_load_n(&site->sec, __ATOMIC_RELAXED) != sec) {
+		__atomic_store_n(&site->sec, sec, __ATOMIC_RELAXED);
+		__atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+	}
+	if (__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) >= ERR_LOG_BURST) {
+		__atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	*suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+	return 1;
+}
+
+static void err_log_queue(const char *file, int line, const char *function,
+			  int err, const char *fmt, va_list arg)
+{
+	struct err_log_slot *slot;
+	unsigned int pos, seq, suppressed;
+	int n;
+
+	if (!err_log_allow(file, line, &suppressed))
+		return;
+	pos = __atomic_load_n(&err_log_head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &err_log_slots[pos & (ERR_LOG_SLOTS - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			/* on failure, pos is updated to the current head */
+			if (__atomic_compare_exchange_n(&err_log_head, &pos, pos + 1, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if ((int)(seq - pos) < 0) {
+			/* the queue is full */
+			__atomic_fetch_add(&err_log_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&err_log_head, __ATOMIC_RELAXED);
+		}
+	}
+	n = snprintf(slot->text, ERR_LOG_TEXT, "ALSA lib %s:%i:(%s) ", file, line, function);
+	if (n >= 0 && n < ERR_LOG_TEXT)
+		n += vsnprintf(slot->text + n, ERR_LOG_TEXT - n, fmt, arg);
+	if (err && n >= 0 && n < ERR_LOG_TEXT)
+		n += snprintf(slot->text + n, ERR_LOG_TEXT - n, ": %s", snd_strerror(err));
+	if (suppressed && n >= 0 && n < ERR_LOG_TEXT)
+		snprintf(slot->text + n, ERR_LOG_TEXT - n,
+			 " (%u similar messages suppressed)", suppressed);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* write the queued messages, there is a single consumer at a time */
+static void err_log_flush(void)
+{
+	struct err_log_slot *slot;
+	unsigned int dropped;
+
+	for (;;) {
+		slot = &err_log_slots[err_log_tail & (ERR_LOG_SLOTS - 1)];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != err_log_tail + 1)
+			break;
+		fprintf(stderr, "%s\n", slot->text);
+		__atomic_store_n(&slot->seq, err_log_tail + ERR_LOG_SLOTS, __ATOMIC_RELEASE);
+		err_log_tail++;
+	}
+	dropped = __atomic_exchange_n(&err_log_dropped, 0, __ATOMIC_RELAXED);
+	if (dropped)
+		fprintf(stderr, "ALSA lib: %u error messages dropped\n", dropped);
+}
+
+static void *err_log_thread_func(void *arg ATTRIBUTE_UNUSED)
+{
+	struct timespec ts = { 0, ERR_LOG_PERIOD_MS * 1000000 };
+
+	while (!__atomic_load_n(&err_log_stop, __ATOMIC_ACQUIRE)) {
+		err_log_flush();
+		nanosleep(&ts, NULL);
+	}
+	return NULL;
+}
+
+static void err_log_exit(void) __attribute__ ((destructor));
+
+static void err_log_exit(void)
+{
+	snd_lib_error_set_async(0);
+}
+
+#endif /* HAVE_LIBPTHREAD */
+
+/**
+ * \brief Enables or disables the asynchronous error log.
+ * \param enable 1 to enable, 0 to disable.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * With the asynchronous log, the default error handler does not write
+ * to \c stderr from the thread hitting the error. The message is put to
+ * a lock-free queue instead, and a thread of the library writes the
+ * queue to \c stderr every 50 ms. This keeps the error reports from the
+ * audio threads (e.g. during an xrun recovery) off the stdio locks and
+ * the system calls.
+ *
+ * Each source location reports at most 10 messages per second, the
+ * suppressed messages are counted in the next report. Messages are
+ * truncated to 255 characters, and dropped (and counted) when the queue
+ * is full.
+ *
+ * The queue is flushed when the log is disabled and at the unload of the
+ * library. Handlers set with #snd_lib_error_set_handler or
+ * #snd_lib_error_set_local are not affected. Call this function from
+ * one thread only.
+ */
+int snd_lib_error_set_async(int enable)
+{
+#ifdef HAVE_LIBPTHREAD
+	sigset_t all, old;
+	unsigned int i;
+	int err;
+
+	enable = !!enable;
+	if (enable == err_log_enabled)
+		return 0;
+	if (!enable) {
+		__atomic_store_n(&err_log_enabled, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&err_log_stop, 1, __ATOMIC_RELEASE);
+		pthread_join(err_log_thread, NULL);
+		err_log_flush();
+		return 0;
+	}
+	if (!err_log_ready) {
+		for (i = 0; i < ERR_LOG_SLOTS; i++)
+			err_log_slots[i].seq = i;
+		err_log_ready = 1;
+	}
+	err_log_stop = 0;
+	/* the signals stay with the threads of the application */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&err_log_thread, NULL, err_log_thread_func, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err)
+		return -err;
+	__atomic_store_n(&err_log_enabled, 1, __ATOMIC_RELEASE);
+	return 0;
+#else
+	return enable ? -ENOSYS : 0;
+#endif
+}
+
 /**
  * \brief The default error handler function.
  * \param file The filename where the error was hit.
@@ -93,7 +297,8 @@ snd_local_error_handler_t snd_lib_error_set_local(snd_local_error_handler_t func
  *
  * If a local error function has been installed for the current thread by
  * \ref snd_lib_error_set_local, it is called. Otherwise, prints the error
- * message including location to \c stderr.
+ * message including location to \c stderr, or queues it for the
+ * asynchronous log (#snd_lib_error_set_async).
  */
 static void snd_lib_error_default(const char *file, int line, const char *function, int err, const char *fmt, ...)
 {
@@ -104,6 +309,13 @@ static void snd_lib_error_default(const char *file, int line, const char *functi
 		va_end(arg);
 		return;
 	}
+#ifdef HAVE_LIBPTHREAD
+	if (__atomic_load_n(&err_log_enabled, __ATOMIC_ACQUIRE)) {
+		err_log_queue(file, line, function, err, fmt, arg);
+		va_end(arg);
+		return;
+	}
+#endif
 	fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
 	vfprintf(stderr, fmt, arg);
 	if (err)
@@ -158,11 +370,18 @@ static void snd_err_msg_default(const char *file, int line, const char *function
 	if (! verbose || ! *verbose)
 		return;
 	va_start(arg, fmt);
-	fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
-	vfprintf(stderr, fmt, arg);
-	if (err)
-		fprintf(stderr, ": %s", snd_strerror(err));
-	putc('\n', stderr);
+#ifdef HAVE_LIBPTHREAD
+	if (__atomic_load_n(&err_log_enabled, __ATOMIC_ACQUIRE)) {
+		err_log_queue(file, line, function, err, fmt, arg);
+	} else
+#endif
+	{
+		fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
+		vfprintf(stderr, fmt, arg);
+		if (err)
+			fprintf(stderr, ": %s", snd_strerror(err));
+		putc('\n', stderr);
+	}
 	va_end(arg);
 #ifdef ALSA_DEBUG_ASSERT
 	verbose = getenv("LIBASOUND_DEBUG_ASSERT");
@@ -35,6 +35,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 
 static int snd_hwdep_open_conf(snd_hwdep_t **hwdep,
 			       const char *name, snd_config_t *hwdep_root,
@@ -493,6 +494,86 @@ ssize_t snd_hwdep_read(snd_hwdep_t *hwdep, void *buffer, size_t size)
 	return (hwdep->ops->read)(hwdep, buffer, size);
 }
 
+/**
+ * \brief write bytes from several buffers using HwDep handle
+ * \param hwdep HwDep handle
+ * \param iov array of the buffers to write, like for writev(2)
+ * \param iovcnt count of the buffers
+ * \return count of written bytes otherwise a negative error code
+ *
+ * The buffers are written in the order of \p iov with a single call to
+ * the driver, which saves the per-call overhead of #snd_hwdep_write when
+ * many blocks are streamed (e.g. a firmware image with its headers).
+ * A short write stops in the middle of the buffers as with writev(2).
+ */
+ssize_t snd_hwdep_writev(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt)
+{
+	assert(hwdep);
+	assert(((hwdep->mode & O_ACCMODE) == O_WRONLY) || ((hwdep->mode & O_ACCMODE) == O_RDWR));
+	assert(iov || iovcnt == 0);
+	if (!hwdep->ops->writev)
+		return -ENOSYS;
+	return hwdep->ops->writev(hwdep, iov, iovcnt);
+}
+
+/**
+ * \brief read bytes to several buffers using HwDep handle
+ * \param hwdep HwDep handle
+ * \param iov array of the buffers to fill, like for readv(2)
+ * \param iovcnt count of the buffers
+ * \return count of read bytes otherwise a negative error code
+ *
+ * The buffers are filled in the order of \p iov with a single call to
+ * the driver, see #snd_hwdep_writev.
+ */
+ssize_t snd_hwdep_readv(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt)
+{
+	assert(hwdep);
+	assert(((hwdep->mode & O_ACCMODE) == O_RDONLY) || ((hwdep->mode & O_ACCMODE) == O_RDWR));
+	assert(iov || iovcnt == 0);
+	if (!hwdep->ops->readv)
+		return -ENOSYS;
+	return hwdep->ops->readv(hwdep, iov, iovcnt);
+}
+
+/**
+ * \brief map the memory of a HwDep device
+ * \param hwdep HwDep handle
+ * \param size size of the mapping in bytes
+ * \param ptr returned address of the mapping
+ * \return 0 on success otherwise a negative error code
+ *
+ * Some drivers export a buffer (e.g. a DSP trace or a shared status
+ * area) which can be read without a copy through a shared mapping. The
+ * layout of the memory is defined by the driver. The mapping is writable
+ * unless the device was opened read only. Drivers without the support
+ * return -ENODEV. Unmap the memory with #snd_hwdep_munmap.
+ */
+int snd_hwdep_mmap(snd_hwdep_t *hwdep, size_t size, void **ptr)
+{
+	assert(hwdep && ptr);
+	if (size == 0)
+		return -EINVAL;
+	if (!hwdep->ops->mmap)
+		return -ENODEV;
+	return hwdep->ops->mmap(hwdep, size, ptr);
+}
+
+/**
+ * \brief unmap the memory mapped by #snd_hwdep_mmap
+ * \param hwdep HwDep handle
+ * \param ptr address of the mapping
+ * \param size size of the mapping in bytes
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_hwdep_munmap(snd_hwdep_t *hwdep, void *ptr, size_t size)
+{
+	assert(hwdep && ptr);
+	if (munmap(ptr, size) < 0)
+		return -errno;
+	return 0;
+}
+
 /**
  * \brief get the DSP status information
  * \param hwdep HwDep handle
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 
 #ifndef PIC
 /* entry for static linking */
@@ -94,6 +95,38 @@ static ssize_t snd_hwdep_hw_read(snd_hwdep_t *hwdep, void *buffer, size_t size)
 	return result;
 }
 
+static ssize_t snd_hwdep_hw_writev(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt)
+{
+	ssize_t result;
+	result = writev(hwdep->poll_fd, iov, iovcnt);
+	if (result < 0)
+		return -errno;
+	return result;
+}
+
+static ssize_t snd_hwdep_hw_readv(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt)
+{
+	ssize_t result;
+	result = readv(hwdep->poll_fd, iov, iovcnt);
+	if (result < 0)
+		return -errno;
+	return result;
+}
+
+static int snd_hwdep_hw_mmap(snd_hwdep_t *hwdep, size_t size, void **ptr)
+{
+	int prot = PROT_READ;
+	void *map;
+
+	if ((hwdep->mode & O_ACCMODE) != O_RDONLY)
+		prot |= PROT_WRITE;
+	map = mmap(NULL, size, prot, MAP_SHARED, hwdep->poll_fd, 0);
+	if (map == MAP_FAILED)
+		return -errno;
+	*ptr = map;
+	return 0;
+}
+
 static const snd_hwdep_ops_t snd_hwdep_hw_ops = {
 	.close = snd_hwdep_hw_close,
 	.nonblock = snd_hwdep_hw_nonblock,
@@ -101,6 +134,9 @@ static const snd_hwdep_ops_t snd_hwdep_hw_ops = {
 	.ioctl = snd_hwdep_hw_ioctl,
 	.write = snd_hwdep_hw_write,
 	.read = snd_hwdep_hw_read,
+	.writev = snd_hwdep_hw_writev,
+	.readv = snd_hwdep_hw_readv,
+	.mmap = snd_hwdep_hw_mmap,
 };
 
 int snd_hwdep_hw_open(snd_hwdep_t **handle, const char *name, int card, int device, int mode)
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <sys/uio.h>
 
 typedef struct {
 	int (*close)(snd_hwdep_t *hwdep);
@@ -31,6 +32,9 @@ typedef struct {
 	int (*ioctl)(snd_hwdep_t *hwdep, unsigned int request, void * arg);
 	ssize_t (*write)(snd_hwdep_t *hwdep, const void *buffer, size_t size);
 	ssize_t (*read)(snd_hwdep_t *hwdep, void *buffer, size_t size);
+	ssize_t (*writev)(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt);
+	ssize_t (*readv)(snd_hwdep_t *hwdep, const struct iovec *iov, int iovcnt);
+	int (*mmap)(snd_hwdep_t *hwdep, size_t size, void **ptr);
 } snd_hwdep_ops_t;
 
 struct _snd_hwdep {
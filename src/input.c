@@ -41,6 +41,7 @@ typedef struct _snd_input_ops {
 	char *(*(gets))(snd_input_t *input, char *str, size_t size);
 	int (*getch)(snd_input_t *input);
 	int (*ungetch)(snd_input_t *input, int c);
+	size_t (*read)(snd_input_t *input, void *buf, size_t size);
 } snd_input_ops_t;
 
 struct _snd_input {
@@ -117,6 +118,22 @@ int snd_input_ungetc(snd_input_t *input, int c)
 	return input->ops->ungetch(input, c);
 }
 
+#ifndef DOC_HIDDEN
+/* reads up to size bytes, returns zero at the end of the input */
+size_t _snd_input_read(snd_input_t *input, void *buf, size_t size)
+{
+	unsigned char *p = buf;
+	size_t n;
+	int c;
+
+	if (input->ops->read)
+		return input->ops->read(input, buf, size);
+	for (n = 0; n < size && (c = input->ops->getch(input)) != EOF; n++)
+		p[n] = c;
+	return n;
+}
+#endif
+
 #ifndef DOC_HIDDEN
 typedef struct _snd_input_stdio {
 	int close;
@@ -157,12 +174,19 @@ static int snd_input_stdio_ungetc(snd_input_t *input, int c)
 	return ungetc(c, stdio->fp);
 }
 
+static size_t snd_input_stdio_read(snd_input_t *input, void *buf, size_t size)
+{
+	snd_input_stdio_t *stdio = input->private_data;
+	return fread(buf, 1, size, stdio->fp);
+}
+
 static const snd_input_ops_t snd_input_stdio_ops = {
 	.close		= snd_input_stdio_close,
 	.scan		= snd_input_stdio_scan,
 	.gets		= snd_input_stdio_gets,
 	.getch		= snd_input_stdio_getc,
 	.ungetch	= snd_input_stdio_ungetc,
+	.read		= snd_input_stdio_read,
 };
 #endif
 
@@ -283,12 +307,24 @@ static int snd_input_buffer_ungetc(snd_input_t *input, int c)
 	return c;
 }
 
+static size_t snd_input_buffer_read(snd_input_t *input, void *buf, size_t size)
+{
+	snd_input_buffer_t *buffer = input->private_data;
+	if (size > buffer->size)
+		size = buffer->size;
+	memcpy(buf, buffer->ptr, size);
+	buffer->ptr += size;
+	buffer->size -= size;
+	return size;
+}
+
 static const snd_input_ops_t snd_input_buffer_ops = {
 	.close		= snd_input_buffer_close,
 	.scan		= snd_input_buffer_scan,
 	.gets		= snd_input_buffer_gets,
 	.getch		= snd_input_buffer_getc,
 	.ungetch	= snd_input_buffer_ungetc,
+	.read		= snd_input_buffer_read,
 };
 #endif
 
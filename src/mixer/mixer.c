@@ -46,11 +46,16 @@ This is an abstraction layer over the hcontrol layer.
 #include <string.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #ifndef DOC_HIDDEN
 typedef struct _snd_mixer_slave {
 	snd_hctl_t *hctl;
 	struct list_head list;
+	struct pollfd *pfds;		/* descriptors in the epoll set */
+	int npfds;
 } snd_mixer_slave_t;
 
 #endif
@@ -76,6 +81,7 @@ int snd_mixer_open(snd_mixer_t **mixerp, int mode ATTRIBUTE_UNUSED)
 	INIT_LIST_HEAD(&mixer->classes);
 	INIT_LIST_HEAD(&mixer->elems);
 	mixer->compare = snd_mixer_compare_default;
+	mixer->epoll_fd = -1;
 	*mixerp = mixer;
 	return 0;
 }
@@ -140,6 +146,8 @@ int snd_mixer_elem_empty(snd_mixer_elem_t *melem)
 	return bag_empty(&melem->helems);
 }
 
+static void mixer_writes_drop(snd_mixer_t *mixer, snd_hctl_elem_t *helem);
+
 static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 				   unsigned int mask)
 {
@@ -148,6 +156,10 @@ static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 		int res = 0;
 		int err;
 		bag_iterator_t i, n;
+		if (!bag_empty(bag)) {
+			snd_mixer_elem_t *melem = bag_iterator_entry(bag->next);
+			mixer_writes_drop(melem->class->mixer, helem);
+		}
 		bag_for_each_safe(i, n, bag) {
 			snd_mixer_elem_t *melem = bag_iterator_entry(i);
 			snd_mixer_class_t *class = melem->class;
@@ -201,6 +213,119 @@ static int hctl_event_handler(snd_hctl_t *hctl, unsigned int mask,
 }
 
 
+#ifdef HAVE_SYS_EPOLL_H
+/* add the descriptors of a slave to the epoll set */
+static int slave_epoll_add(snd_mixer_t *mixer, snd_mixer_slave_t *s)
+{
+	struct epoll_event ev;
+	int i, n, err;
+
+	n = snd_hctl_poll_descriptors_count(s->hctl);
+	if (n < 0)
+		return n;
+	s->pfds = calloc(n ? n : 1, sizeof(*s->pfds));
+	if (!s->pfds)
+		return -ENOMEM;
+	n = snd_hctl_poll_descriptors(s->hctl, s->pfds, n);
+	if (n < 0) {
+		err = n;
+		goto error;
+	}
+	for (s->npfds = 0; s->npfds < n; s->npfds++) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = s->pfds[s->npfds].events & (POLLIN | POLLOUT | POLLPRI);
+		ev.data.ptr = s;
+		if (epoll_ctl(mixer->epoll_fd, EPOLL_CTL_ADD,
+			      s->pfds[s->npfds].fd, &ev) < 0) {
+			err = -errno;
+			goto error;
+		}
+	}
+	return 0;
+
+ error:
+	for (i = 0; i < s->npfds; i++)
+		epoll_ctl(mixer->epoll_fd, EPOLL_CTL_DEL, s->pfds[i].fd, NULL);
+	free(s->pfds);
+	s->pfds = NULL;
+	s->npfds = 0;
+	return err;
+}
+
+static void slave_epoll_del(snd_mixer_t *mixer, snd_mixer_slave_t *s)
+{
+	int i;
+
+	for (i = 0; i < s->npfds; i++)
+		epoll_ctl(mixer->epoll_fd, EPOLL_CTL_DEL, s->pfds[i].fd, NULL);
+	free(s->pfds);
+	s->pfds = NULL;
+	s->npfds = 0;
+}
+#else
+static int slave_epoll_add(snd_mixer_t *mixer ATTRIBUTE_UNUSED,
+			   snd_mixer_slave_t *s ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static void slave_epoll_del(snd_mixer_t *mixer ATTRIBUTE_UNUSED,
+			    snd_mixer_slave_t *s ATTRIBUTE_UNUSED)
+{
+}
+#endif
+
+/**
+ * \brief Use a persistent epoll set for the descriptors of a mixer
+ * \param mixer Mixer handle
+ * \param enable 1 to use the set, 0 to go back to the poll descriptors
+ *        of each HCTL
+ * \return 0 on success otherwise a negative error code
+ *
+ * A mixer attached to many cards builds the descriptor array of all of
+ * them at each #snd_mixer_wait() and handles the events of all of them at
+ * each #snd_mixer_handle_events().  With the epoll set, which the attach
+ * and detach functions keep up to date, the mixer has a single poll
+ * descriptor, #snd_mixer_wait() waits on it, and #snd_mixer_handle_events()
+ * handles the events of the HCTLs which are ready only, at most 64 of
+ * them per call: the others are still ready at the next wait.
+ *
+ * The HCTLs must not be polled or handled directly while the set is in
+ * use.  -ENOSYS is returned when epoll is not available.
+ */
+int snd_mixer_set_epoll(snd_mixer_t *mixer, int enable)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	struct list_head *pos;
+	int err;
+
+	assert(mixer);
+	if (!enable == (mixer->epoll_fd < 0))
+		return 0;
+	if (!enable) {
+		list_for_each(pos, &mixer->slaves)
+			slave_epoll_del(mixer, list_entry(pos, snd_mixer_slave_t, list));
+		close(mixer->epoll_fd);
+		mixer->epoll_fd = -1;
+		return 0;
+	}
+	mixer->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (mixer->epoll_fd < 0)
+		return -errno;
+	list_for_each(pos, &mixer->slaves) {
+		err = slave_epoll_add(mixer, list_entry(pos, snd_mixer_slave_t, list));
+		if (err < 0) {
+			snd_mixer_set_epoll(mixer, 0);
+			return err;
+		}
+	}
+	return 0;
+#else
+	assert(mixer);
+	return enable ? -ENOSYS : 0;
+#endif
+}
+
 /**
  * \brief Attach an HCTL specified with the CTL device name to an opened mixer
  * \param mixer Mixer handle
@@ -215,6 +340,8 @@ int snd_mixer_attach(snd_mixer_t *mixer, const char *name)
 	err = snd_hctl_open(&hctl, name, 0);
 	if (err < 0)
 		return err;
+	snd_hctl_set_cache(hctl, 1);
+	snd_hctl_set_coalesce(hctl, 1);
 	err = snd_mixer_attach_hctl(mixer, hctl);
 	if (err < 0)
 		return err;
@@ -249,6 +376,14 @@ int snd_mixer_attach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl)
 	snd_hctl_set_callback(hctl, hctl_event_handler);
 	snd_hctl_set_callback_private(hctl, mixer);
 	slave->hctl = hctl;
+	if (mixer->epoll_fd >= 0) {
+		err = slave_epoll_add(mixer, slave);
+		if (err < 0) {
+			snd_hctl_close(hctl);
+			free(slave);
+			return err;
+		}
+	}
 	list_add_tail(&slave->list, &mixer->slaves);
 	return 0;
 }
@@ -266,6 +401,7 @@ int snd_mixer_detach(snd_mixer_t *mixer, const char *name)
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
 		if (strcmp(name, snd_hctl_name(s->hctl)) == 0) {
+			slave_epoll_del(mixer, s);
 			snd_hctl_close(s->hctl);
 			list_del(pos);
 			free(s);
@@ -290,6 +426,7 @@ int snd_mixer_detach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl)
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
 		if (hctl == s->hctl) {
+			slave_epoll_del(mixer, s);
 			list_del(pos);
 			free(s);
 			return 0;
@@ -359,6 +496,24 @@ static int _snd_mixer_find_elem(snd_mixer_t *mixer, snd_mixer_elem_t *elem, int
 	return idx;
 }
 
+static int snd_mixer_sort(snd_mixer_t *mixer);
+
+/*
+ * While loading, the new elements are appended and the array is sorted
+ * once at the end instead of inserting each of them at its place.  The
+ * element list is in the final order only after the load.
+ */
+static void snd_mixer_bulk_begin(snd_mixer_t *mixer)
+{
+	mixer->bulk++;
+}
+
+static void snd_mixer_bulk_end(snd_mixer_t *mixer)
+{
+	if (--mixer->bulk == 0)
+		snd_mixer_sort(mixer);
+}
+
 /**
  * \brief Get private data associated to give mixer element
  * \param elem Mixer element
@@ -424,9 +579,9 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 		}
 		mixer->pelems = m;
 	}
-	if (mixer->count == 0) {
+	if (mixer->count == 0 || mixer->bulk) {
 		list_add_tail(&elem->list, &mixer->elems);
-		mixer->pelems[0] = elem;
+		mixer->pelems[mixer->count] = elem;
 	} else {
 		idx = _snd_mixer_find_elem(mixer, elem, &dir);
 		assert(dir != 0);
@@ -460,9 +615,17 @@ int snd_mixer_elem_remove(snd_mixer_elem_t *elem)
 	unsigned int m;
 	assert(elem);
 	assert(mixer->count);
-	idx = _snd_mixer_find_elem(mixer, elem, &dir);
-	if (dir != 0)
-		return -EINVAL;
+	if (mixer->bulk) {
+		for (idx = 0; idx < (int)mixer->count; idx++)
+			if (mixer->pelems[idx] == elem)
+				break;
+		if (idx == (int)mixer->count)
+			return -EINVAL;
+	} else {
+		idx = _snd_mixer_find_elem(mixer, elem, &dir);
+		if (dir != 0)
+			return -EINVAL;
+	}
 	bag_for_each_safe(i, n, &elem->helems) {
 		snd_hctl_elem_t *helem = bag_iterator_entry(i);
 		snd_mixer_elem_detach(elem, helem);
@@ -527,12 +690,14 @@ int snd_mixer_elem_value(snd_mixer_elem_t *elem)
 int snd_mixer_class_register(snd_mixer_class_t *class, snd_mixer_t *mixer)
 {
 	struct list_head *pos;
+	int err = 0;
+
 	class->mixer = mixer;
 	list_add_tail(&class->list, &mixer->classes);
 	if (!class->event)
 		return 0;
+	snd_mixer_bulk_begin(mixer);
 	list_for_each(pos, &mixer->slaves) {
-		int err;
 		snd_mixer_slave_t *slave;
 		snd_hctl_elem_t *elem;
 		slave = list_entry(pos, snd_mixer_slave_t, list);
@@ -540,11 +705,13 @@ int snd_mixer_class_register(snd_mixer_class_t *class, snd_mixer_t *mixer)
 		while (elem) {
 			err = class->event(class, SND_CTL_EVENT_MASK_ADD, elem, NULL);
 			if (err < 0)
-				return err;
+				goto _end;
 			elem = snd_hctl_elem_next(elem);
 		}
 	}
-	return 0;
+ _end:
+	snd_mixer_bulk_end(mixer);
+	return err;
 }
 
 /**
@@ -579,15 +746,18 @@ int snd_mixer_class_unregister(snd_mixer_class_t *class)
 int snd_mixer_load(snd_mixer_t *mixer)
 {
 	struct list_head *pos;
+	int err = 0;
+
+	snd_mixer_bulk_begin(mixer);
 	list_for_each(pos, &mixer->slaves) {
-		int err;
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
 		err = snd_hctl_load(s->hctl);
 		if (err < 0)
-			return err;
+			break;
 	}
-	return 0;
+	snd_mixer_bulk_end(mixer);
+	return err;
 }
 
 /**
@@ -620,18 +790,22 @@ int snd_mixer_close(snd_mixer_t *mixer)
 	}
 	assert(list_empty(&mixer->elems));
 	assert(mixer->count == 0);
+	free(mixer->writes);
 	free(mixer->pelems);
 	mixer->pelems = NULL;
 	while (!list_empty(&mixer->slaves)) {
 		int err;
 		snd_mixer_slave_t *s;
 		s = list_entry(mixer->slaves.next, snd_mixer_slave_t, list);
+		slave_epoll_del(mixer, s);
 		err = snd_hctl_close(s->hctl);
 		if (err < 0)
 			res = err;
 		list_del(&s->list);
 		free(s);
 	}
+	if (mixer->epoll_fd >= 0)
+		close(mixer->epoll_fd);
 	free(mixer);
 	return res;
 }
@@ -699,6 +873,8 @@ int snd_mixer_poll_descriptors_count(snd_mixer_t *mixer)
 	struct list_head *pos;
 	unsigned int c = 0;
 	assert(mixer);
+	if (mixer->epoll_fd >= 0)
+		return 1;
 	list_for_each(pos, &mixer->slaves) {
 		snd_mixer_slave_t *s;
 		int n;
@@ -723,6 +899,14 @@ int snd_mixer_poll_descriptors(snd_mixer_t *mixer, struct pollfd *pfds, unsigned
 	struct list_head *pos;
 	unsigned int count = 0;
 	assert(mixer);
+	if (mixer->epoll_fd >= 0) {
+		if (space < 1)
+			return 0;
+		pfds->fd = mixer->epoll_fd;
+		pfds->events = POLLIN;
+		pfds->revents = 0;
+		return 1;
+	}
 	list_for_each(pos, &mixer->slaves) {
 		snd_mixer_slave_t *s;
 		int n;
@@ -774,17 +958,29 @@ int snd_mixer_wait(snd_mixer_t *mixer, int timeout)
 	struct pollfd *pfds = spfds;
 	int err;
 	int count;
-	count = snd_mixer_poll_descriptors(mixer, pfds, sizeof(spfds) / sizeof(spfds[0]));
+#ifdef HAVE_SYS_EPOLL_H
+	if (mixer->epoll_fd >= 0) {
+		struct epoll_event ev;
+
+		/* level triggered, the events stay for snd_mixer_handle_events() */
+		if (epoll_wait(mixer->epoll_fd, &ev, 1, timeout) < 0)
+			return -errno;
+		return 0;
+	}
+#endif
+	/* the fill returns the descriptors that fit only, get the count first */
+	count = snd_mixer_poll_descriptors_count(mixer);
 	if (count < 0)
 		return count;
 	if ((unsigned int) count > sizeof(spfds) / sizeof(spfds[0])) {
 		pfds = alloca(count * sizeof(*pfds));
 		if (!pfds)
 			return -ENOMEM;
-		err = snd_mixer_poll_descriptors(mixer, pfds, 
-						 (unsigned int) count);
-		assert(err == count);
 	}
+	err = snd_mixer_poll_descriptors(mixer, pfds, (unsigned int) count);
+	if (err < 0)
+		return err;
+	count = err;
 	err = poll(pfds, (unsigned int) count, timeout);
 	if (err < 0)
 		return -errno;
@@ -843,6 +1039,33 @@ snd_mixer_elem_t *snd_mixer_elem_prev(snd_mixer_elem_t *elem)
 	return list_entry(elem->list.prev, snd_mixer_elem_t, list);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+/* handle the events of the slaves the epoll set reports ready */
+static int mixer_handle_ready(snd_mixer_t *mixer)
+{
+	struct epoll_event ev[64];
+	int i, n, err;
+
+	/* the slaves beyond the batch stay ready for the next call */
+	n = epoll_wait(mixer->epoll_fd, ev, ARRAY_SIZE(ev), 0);
+	if (n < 0)
+		return -errno;
+	for (i = 0; i < n; i++) {
+		snd_mixer_slave_t *s = ev[i].data.ptr;
+
+		err = snd_hctl_handle_events(s->hctl);
+		if (err < 0)
+			return err;
+	}
+	return mixer->events;
+}
+#else
+static int mixer_handle_ready(snd_mixer_t *mixer ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+#endif
+
 /**
  * \brief Handle pending mixer events invoking callbacks
  * \param mixer Mixer handle
@@ -853,6 +1076,8 @@ int snd_mixer_handle_events(snd_mixer_t *mixer)
 	struct list_head *pos;
 	assert(mixer);
 	mixer->events = 0;
+	if (mixer->epoll_fd >= 0)
+		return mixer_handle_ready(mixer);
 	list_for_each(pos, &mixer->slaves) {
 		int err;
 		snd_mixer_slave_t *s;
@@ -864,6 +1089,190 @@ int snd_mixer_handle_events(snd_mixer_t *mixer)
 	return mixer->events;
 }
 
+#ifndef DOC_HIDDEN
+struct mixer_write {
+	snd_hctl_elem_t *helem;
+	snd_ctl_elem_value_t value;
+};
+#endif
+
+static struct mixer_write *mixer_writes_find(snd_mixer_t *mixer,
+					     snd_hctl_elem_t *helem)
+{
+	unsigned int i;
+
+	for (i = 0; i < mixer->writes_count; i++)
+		if (mixer->writes[i].helem == helem)
+			return &mixer->writes[i];
+	return NULL;
+}
+
+/* the element is going away, forget its queued value */
+static void mixer_writes_drop(snd_mixer_t *mixer, snd_hctl_elem_t *helem)
+{
+	struct mixer_write *w = mixer_writes_find(mixer, helem);
+
+	if (!w)
+		return;
+	mixer->writes_count--;
+	memmove(w, w + 1, (mixer->writes_count - (w - mixer->writes)) * sizeof(*w));
+}
+
+/**
+ * \brief Start a transaction of mixer element changes
+ * \param mixer Mixer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * Until #snd_mixer_commit(), the changes of the simple elements are kept
+ * in the library instead of being written to the controls.  A control
+ * changed several times, e.g. by the volume of each channel or by several
+ * elements sharing it, is then written once with its last value, and the
+ * reads the library does before a write are saved too.
+ *
+ * The elements report the new values at once.  The other applications
+ * and the events handled with #snd_mixer_handle_events() see them after
+ * the commit only.  Transactions cannot be nested.
+ */
+int snd_mixer_begin(snd_mixer_t *mixer)
+{
+	assert(mixer);
+	if (mixer->transaction)
+		return -EBUSY;
+	mixer->transaction = 1;
+	return 0;
+}
+
+/**
+ * \brief Write the changes of a mixer transaction
+ * \param mixer Mixer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The controls changed since #snd_mixer_begin() are written in the order
+ * of their first change, the ones of a card in one batch (see
+ * #snd_ctl_elem_write_batch()).  The transaction ends even when a write
+ * fails: the controls not written are then read back, so that the
+ * elements show their actual values again.
+ */
+int snd_mixer_commit(snd_mixer_t *mixer)
+{
+	snd_ctl_elem_value_t *batch[32];
+	snd_ctl_t *ctl, *next;
+	unsigned int i, first, count, done;
+	int err = 0;
+
+	assert(mixer);
+	if (!mixer->transaction)
+		return -EINVAL;
+	for (first = 0; first < mixer->writes_count; first += count) {
+		ctl = snd_hctl_ctl(snd_hctl_elem_get_hctl(mixer->writes[first].helem));
+		for (count = 0; count < ARRAY_SIZE(batch) &&
+		     first + count < mixer->writes_count; count++) {
+			struct mixer_write *w = &mixer->writes[first + count];
+
+			next = snd_hctl_ctl(snd_hctl_elem_get_hctl(w->helem));
+			if (next != ctl)
+				break;
+			snd_hctl_elem_get_id(w->helem, &w->value.id);
+			batch[count] = &w->value;
+		}
+		for (done = 0; done < count; done += err) {
+			err = snd_ctl_elem_write_batch(ctl, batch + done,
+						       count - done);
+			if (err < 0)
+				break;
+		}
+		if (err < 0) {
+			first += done;
+			break;
+		}
+	}
+
+	mixer->transaction = 0;
+	if (err >= 0) {
+		mixer->writes_count = 0;
+		return 0;
+	}
+	for (i = first; i < mixer->writes_count; i++)
+		hctl_elem_event_handler(mixer->writes[i].helem,
+					SND_CTL_EVENT_MASK_VALUE);
+	mixer->writes_count = 0;
+	return err;
+}
+
+/**
+ * \brief Read the value of an HCTL element of a mixer element
+ * \param melem Mixer element
+ * \param helem HCTL element attached to \p melem
+ * \param value Returned value
+ * \return 0 on success otherwise a negative error code
+ *
+ * For use by mixer element class specific code.
+ *
+ * Like #snd_hctl_elem_read(), but in a transaction a value queued by
+ * #snd_mixer_elem_write_ctl() is returned instead of the one of the
+ * control.
+ */
+int snd_mixer_elem_read_ctl(snd_mixer_elem_t *melem, snd_hctl_elem_t *helem,
+			    snd_ctl_elem_value_t *value)
+{
+	snd_mixer_t *mixer;
+	struct mixer_write *w;
+
+	assert(melem && helem && value);
+	mixer = melem->class->mixer;
+	if (mixer->transaction) {
+		w = mixer_writes_find(mixer, helem);
+		if (w) {
+			*value = w->value;
+			return 0;
+		}
+	}
+	return snd_hctl_elem_read(helem, value);
+}
+
+/**
+ * \brief Write the value of an HCTL element of a mixer element
+ * \param melem Mixer element
+ * \param helem HCTL element attached to \p melem
+ * \param value New value
+ * \return 0 when written, 1 when queued, otherwise a negative error code
+ *
+ * For use by mixer element class specific code.
+ *
+ * Outside of a transaction, the value is written with
+ * #snd_hctl_elem_write().  In a transaction, it replaces the value queued
+ * for the element, if any, and it is written by #snd_mixer_commit().
+ */
+int snd_mixer_elem_write_ctl(snd_mixer_elem_t *melem, snd_hctl_elem_t *helem,
+			     snd_ctl_elem_value_t *value)
+{
+	snd_mixer_t *mixer;
+	struct mixer_write *w;
+	int err;
+
+	assert(melem && helem && value);
+	mixer = melem->class->mixer;
+	if (!mixer->transaction) {
+		err = snd_hctl_elem_write(helem, value);
+		return err < 0 ? err : 0;
+	}
+	w = mixer_writes_find(mixer, helem);
+	if (!w) {
+		if (mixer->writes_count == mixer->writes_alloc) {
+			w = realloc(mixer->writes,
+				    (mixer->writes_alloc + 16) * sizeof(*w));
+			if (!w)
+				return -ENOMEM;
+			mixer->writes = w;
+			mixer->writes_alloc += 16;
+		}
+		w = &mixer->writes[mixer->writes_count++];
+		w->helem = helem;
+	}
+	w->value = *value;
+	return 1;
+}
+
 /**
  * \brief Set callback function for a mixer
  * \param obj mixer handle
@@ -71,6 +71,12 @@ struct _snd_mixer {
 	unsigned int count;
 	unsigned int alloc;
 	unsigned int events;
+	int bulk;			/* add unsorted, sort after the load */
+	int transaction;		/* between snd_mixer_begin() and commit */
+	struct mixer_write *writes;	/* ctl values queued by the transaction */
+	unsigned int writes_count;
+	unsigned int writes_alloc;
+	int epoll_fd;			/* set of the slave descriptors, or -1 */
 	snd_mixer_callback_t callback;
 	void *callback_private;
 	snd_mixer_compare_t compare;
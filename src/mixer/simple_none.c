@@ -47,6 +47,9 @@
 #define MIXER_COMPARE_WEIGHT_NEXT_BASE          10000000
 #define MIXER_COMPARE_WEIGHT_NOT_FOUND          1000000000
 
+/* largest volume range with a dB table */
+#define DB_TABLE_MAX_SIZE	4096
+
 typedef enum _selem_ctl_type {
 	CTL_SINGLE,
 	CTL_GLOBAL_ENUM,
@@ -81,11 +84,14 @@ typedef struct _selem_none {
 		unsigned int range: 1;	/* Forced range */
 		unsigned int db_initialized: 1;
 		unsigned int db_init_error: 1;
+		unsigned int db_table_error: 1;
 		long min, max;
 		unsigned int channels;
 		long vol[32];
 		unsigned int sw;
 		unsigned int *db_info;
+		long *db_table;		/* dB gain of each volume step */
+		long db_table_min, db_table_max;
 	} str[2];
 } selem_none_t;
 
@@ -231,56 +237,50 @@ static long from_user(selem_none_t *s, int dir, selem_ctl_t *c, long value)
 	return c->min + (n + (s->str[dir].max - s->str[dir].min) / 2) / (s->str[dir].max - s->str[dir].min);
 }
 
-static int elem_read_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_read_volume(selem_none_t *s, int dir, selem_ctl_type_t type,
+			    const snd_ctl_elem_value_t *vals)
 {
-	snd_ctl_elem_value_t ctl = {0};
+	const snd_ctl_elem_value_t *ctl = &vals[type];
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
 		if (idx >= c->values)
 			idx1 = 0;
 		s->str[dir].vol[idx] =
 			to_user(s, dir, c,
-				snd_ctl_elem_value_get_integer(&ctl, idx1));
+				snd_ctl_elem_value_get_integer(ctl, idx1));
 	}
 	return 0;
 }
 
-static int elem_read_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_read_switch(selem_none_t *s, int dir, selem_ctl_type_t type,
+			    const snd_ctl_elem_value_t *vals)
 {
-	snd_ctl_elem_value_t ctl = {0};
+	const snd_ctl_elem_value_t *ctl = &vals[type];
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
 		if (idx >= c->values)
 			idx1 = 0;
-		if (!snd_ctl_elem_value_get_integer(&ctl, idx1))
+		if (!snd_ctl_elem_value_get_integer(ctl, idx1))
 			s->str[dir].sw &= ~(1 << idx);
 	}
 	return 0;
 }
 
-static int elem_read_route(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_read_route(selem_none_t *s, int dir, selem_ctl_type_t type,
+			    const snd_ctl_elem_value_t *vals)
 {
-	snd_ctl_elem_value_t ctl = {0};
+	const snd_ctl_elem_value_t *ctl = &vals[type];
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
 		if (idx >= c->values)
 			idx1 = 0;
-		if (!snd_ctl_elem_value_get_integer(&ctl,
+		if (!snd_ctl_elem_value_get_integer(ctl,
 						    idx1 * c->values + idx1))
 			s->str[dir].sw &= ~(1 << idx);
 	}
@@ -315,55 +315,81 @@ static int elem_read_enum(selem_none_t *s)
 	return 0;
 }
 
-static int selem_read(snd_mixer_elem_t *elem)
+static int selem_read_batch(snd_ctl_t *ctl, snd_ctl_elem_value_t **batch,
+			    unsigned int count)
 {
-	selem_none_t *s;
-	unsigned int idx;
-	int err = 0;
-	long pvol[32], cvol[32];
-	unsigned int psw, csw;
-
-	assert(snd_mixer_elem_get_type(elem) == SND_MIXER_ELEM_SIMPLE);
-	s = snd_mixer_elem_get_private(elem);
-
-	memcpy(pvol, s->str[SM_PLAY].vol, sizeof(pvol));
-	memset(&s->str[SM_PLAY].vol, 0, sizeof(s->str[SM_PLAY].vol));
-	psw = s->str[SM_PLAY].sw;
-	s->str[SM_PLAY].sw = ~0U;
-	memcpy(cvol, s->str[SM_CAPT].vol, sizeof(cvol));
-	memset(&s->str[SM_CAPT].vol, 0, sizeof(s->str[SM_CAPT].vol));
-	csw = s->str[SM_CAPT].sw;
-	s->str[SM_CAPT].sw = ~0U;
+	unsigned int done = 0;
+	int err;
 
-	if (s->ctls[CTL_GLOBAL_ENUM].elem) {
-		err = elem_read_enum(s);
+	while (done < count) {
+		err = snd_ctl_elem_read_batch(ctl, batch + done, count - done);
 		if (err < 0)
 			return err;
-		goto __skip_cswitch;
+		done += err;
 	}
+	return 0;
+}
 
-	if (s->ctls[CTL_CAPTURE_ENUM].elem) {
-		err = elem_read_enum(s);
-		if (err < 0)
-			return err;
-		goto __skip_cswitch;
-	}
+/* read the values of all attached controls but the enums, shared controls
+ * such as the global ones are read once for both directions
+ */
+static int selem_read_values(selem_none_t *s, snd_ctl_elem_value_t *vals)
+{
+	snd_ctl_elem_value_t *batch[CTL_LAST + 1];
+	snd_hctl_elem_t *helem;
+	snd_ctl_t *ctl = NULL;
+	unsigned int k, j, count = 0;
+	int err;
 
-	if (s->ctls[CTL_PLAYBACK_ENUM].elem) {
-		err = elem_read_enum(s);
+	for (k = 0; k <= CTL_LAST; k++) {
+		helem = s->ctls[k].elem;
+		if (!helem || k == CTL_GLOBAL_ENUM || k == CTL_PLAYBACK_ENUM ||
+		    k == CTL_CAPTURE_ENUM)
+			continue;
+		for (j = 0; j < k; j++)
+			if (s->ctls[j].elem == helem)
+				break;
+		if (j < k)
+			continue;
+		if (ctl != snd_hctl_ctl(snd_hctl_elem_get_hctl(helem))) {
+			if (count) {
+				err = selem_read_batch(ctl, batch, count);
+				if (err < 0)
+					return err;
+			}
+			ctl = snd_hctl_ctl(snd_hctl_elem_get_hctl(helem));
+			count = 0;
+		}
+		snd_hctl_elem_get_id(helem, &vals[k].id);
+		batch[count++] = &vals[k];
+	}
+	if (count) {
+		err = selem_read_batch(ctl, batch, count);
 		if (err < 0)
 			return err;
-		goto __skip_cswitch;
 	}
+	for (k = 0; k <= CTL_LAST; k++) {
+		for (j = 0; j < k; j++)
+			if (s->ctls[j].elem && s->ctls[j].elem == s->ctls[k].elem)
+				break;
+		if (j < k)
+			vals[k] = vals[j];
+	}
+	return 0;
+}
 
+static int selem_read_ctls(selem_none_t *s, const snd_ctl_elem_value_t *vals)
+{
+	unsigned int idx;
+	int err = 0;
 
 	if (s->ctls[CTL_PLAYBACK_VOLUME].elem)
-		err = elem_read_volume(s, SM_PLAY, CTL_PLAYBACK_VOLUME);
+		err = elem_read_volume(s, SM_PLAY, CTL_PLAYBACK_VOLUME, vals);
 	else if (s->ctls[CTL_GLOBAL_VOLUME].elem)
-		err = elem_read_volume(s, SM_PLAY, CTL_GLOBAL_VOLUME);
+		err = elem_read_volume(s, SM_PLAY, CTL_GLOBAL_VOLUME, vals);
 	else if (s->ctls[CTL_SINGLE].elem &&
 		 s->ctls[CTL_SINGLE].type == SND_CTL_ELEM_TYPE_INTEGER)
-		err = elem_read_volume(s, SM_PLAY, CTL_SINGLE);
+		err = elem_read_volume(s, SM_PLAY, CTL_SINGLE, vals);
 	if (err < 0)
 		return err;
 
@@ -372,88 +398,138 @@ static int selem_read(snd_mixer_elem_t *elem)
 		goto __skip_pswitch;
 	}
 	if (s->ctls[CTL_PLAYBACK_SWITCH].elem) {
-		err = elem_read_switch(s, SM_PLAY, CTL_PLAYBACK_SWITCH);
+		err = elem_read_switch(s, SM_PLAY, CTL_PLAYBACK_SWITCH, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_SWITCH].elem) {
-		err = elem_read_switch(s, SM_PLAY, CTL_GLOBAL_SWITCH);
+		err = elem_read_switch(s, SM_PLAY, CTL_GLOBAL_SWITCH, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_SINGLE].elem &&
 	    s->ctls[CTL_SINGLE].type == SND_CTL_ELEM_TYPE_BOOLEAN) {
-		err = elem_read_switch(s, SM_PLAY, CTL_SINGLE);
+		err = elem_read_switch(s, SM_PLAY, CTL_SINGLE, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_PLAYBACK_ROUTE].elem) {
-		err = elem_read_route(s, SM_PLAY, CTL_PLAYBACK_ROUTE);
+		err = elem_read_route(s, SM_PLAY, CTL_PLAYBACK_ROUTE, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_ROUTE].elem) {
-		err = elem_read_route(s, SM_PLAY, CTL_GLOBAL_ROUTE);
+		err = elem_read_route(s, SM_PLAY, CTL_GLOBAL_ROUTE, vals);
 		if (err < 0)
 			return err;
 	}
       __skip_pswitch:
 
 	if (s->ctls[CTL_CAPTURE_VOLUME].elem)
-		err = elem_read_volume(s, SM_CAPT, CTL_CAPTURE_VOLUME);
+		err = elem_read_volume(s, SM_CAPT, CTL_CAPTURE_VOLUME, vals);
 	else if (s->ctls[CTL_GLOBAL_VOLUME].elem)
-		err = elem_read_volume(s, SM_CAPT, CTL_GLOBAL_VOLUME);
+		err = elem_read_volume(s, SM_CAPT, CTL_GLOBAL_VOLUME, vals);
 	else if (s->ctls[CTL_SINGLE].elem &&
 		 s->ctls[CTL_SINGLE].type == SND_CTL_ELEM_TYPE_INTEGER)
-		err = elem_read_volume(s, SM_CAPT, CTL_SINGLE);
+		err = elem_read_volume(s, SM_CAPT, CTL_SINGLE, vals);
 	if (err < 0)
 		return err;
 
 	if ((s->selem.caps & (SM_CAP_GSWITCH|SM_CAP_CSWITCH)) == 0) {
 		s->str[SM_CAPT].sw = 0;
-		goto __skip_cswitch;
+		return 0;
 	}
 	if (s->ctls[CTL_CAPTURE_SWITCH].elem) {
-		err = elem_read_switch(s, SM_CAPT, CTL_CAPTURE_SWITCH);
+		err = elem_read_switch(s, SM_CAPT, CTL_CAPTURE_SWITCH, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_SWITCH].elem) {
-		err = elem_read_switch(s, SM_CAPT, CTL_GLOBAL_SWITCH);
+		err = elem_read_switch(s, SM_CAPT, CTL_GLOBAL_SWITCH, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_SINGLE].elem &&
 	    s->ctls[CTL_SINGLE].type == SND_CTL_ELEM_TYPE_BOOLEAN) {
-		err = elem_read_switch(s, SM_CAPT, CTL_SINGLE);
+		err = elem_read_switch(s, SM_CAPT, CTL_SINGLE, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_ROUTE].elem) {
-		err = elem_read_route(s, SM_CAPT, CTL_CAPTURE_ROUTE);
+		err = elem_read_route(s, SM_CAPT, CTL_CAPTURE_ROUTE, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_ROUTE].elem) {
-		err = elem_read_route(s, SM_CAPT, CTL_GLOBAL_ROUTE);
+		err = elem_read_route(s, SM_CAPT, CTL_GLOBAL_ROUTE, vals);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_SOURCE].elem) {
-		snd_ctl_elem_value_t ctl = {0};
 		selem_ctl_t *c = &s->ctls[CTL_CAPTURE_SOURCE];
-		err = snd_hctl_elem_read(c->elem, &ctl);
-		if (err < 0)
-			return err;
 		for (idx = 0; idx < s->str[SM_CAPT].channels; idx++) {
 			unsigned int idx1 = idx;
 			if (idx >= c->values)
 				idx1 = 0;
-			if (snd_ctl_elem_value_get_enumerated(&ctl, idx1) !=
+			if (snd_ctl_elem_value_get_enumerated(&vals[CTL_CAPTURE_SOURCE], idx1) !=
 								s->capture_item)
 				s->str[SM_CAPT].sw &= ~(1 << idx);
 		}
 	}
+	return 0;
+}
+
+static int selem_read(snd_mixer_elem_t *elem)
+{
+	selem_none_t *s;
+	int err = 0;
+	long pvol[32], cvol[32];
+	unsigned int psw, csw;
+	snd_ctl_elem_value_t *vals;
+
+	assert(snd_mixer_elem_get_type(elem) == SND_MIXER_ELEM_SIMPLE);
+	s = snd_mixer_elem_get_private(elem);
+
+	memcpy(pvol, s->str[SM_PLAY].vol, sizeof(pvol));
+	memset(&s->str[SM_PLAY].vol, 0, sizeof(s->str[SM_PLAY].vol));
+	psw = s->str[SM_PLAY].sw;
+	s->str[SM_PLAY].sw = ~0U;
+	memcpy(cvol, s->str[SM_CAPT].vol, sizeof(cvol));
+	memset(&s->str[SM_CAPT].vol, 0, sizeof(s->str[SM_CAPT].vol));
+	csw = s->str[SM_CAPT].sw;
+	s->str[SM_CAPT].sw = ~0U;
+
+	if (s->ctls[CTL_GLOBAL_ENUM].elem) {
+		err = elem_read_enum(s);
+		if (err < 0)
+			return err;
+		goto __skip_cswitch;
+	}
+
+	if (s->ctls[CTL_CAPTURE_ENUM].elem) {
+		err = elem_read_enum(s);
+		if (err < 0)
+			return err;
+		goto __skip_cswitch;
+	}
+
+	if (s->ctls[CTL_PLAYBACK_ENUM].elem) {
+		err = elem_read_enum(s);
+		if (err < 0)
+			return err;
+		goto __skip_cswitch;
+	}
+
+	vals = calloc(CTL_LAST + 1, sizeof(*vals));
+	if (!vals)
+		return -ENOMEM;
+	err = selem_read_values(s, vals);
+	if (err >= 0)
+		err = selem_read_ctls(s, vals);
+	free(vals);
+	if (err < 0)
+		return err;
+
       __skip_cswitch:
 
 	if (memcmp(pvol, s->str[SM_PLAY].vol, sizeof(pvol)) ||
@@ -464,77 +540,74 @@ static int selem_read(snd_mixer_elem_t *elem)
 	return 0;
 }
 
-static int elem_write_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_write_volume(snd_mixer_elem_t *elem, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx,
 				from_user(s, dir, c, s->str[dir].vol[idx]));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = snd_mixer_elem_write_ctl(elem, c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
 
-static int elem_write_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_write_switch(snd_mixer_elem_t *elem, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx,
 					!!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = snd_mixer_elem_write_ctl(elem, c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
 
-static int elem_write_switch_constant(selem_none_t *s, selem_ctl_type_t type, int val)
+static int elem_write_switch_constant(snd_mixer_elem_t *elem, selem_ctl_type_t type, int val)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx, !!val);
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = snd_mixer_elem_write_ctl(elem, c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
 
-static int elem_write_route(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_write_route(snd_mixer_elem_t *elem, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values * c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx, 0);
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx * c->values + idx,
 					       !!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = snd_mixer_elem_write_ctl(elem, c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
 
-static int elem_write_enum(selem_none_t *s)
+static int elem_write_enum(snd_mixer_elem_t *elem)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
 	int type;
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
 	selem_ctl_t *c;
 	type = CTL_GLOBAL_ENUM;
 	if ((s->selem.caps & (SM_CAP_CENUM | SM_CAP_PENUM)) ==
@@ -545,12 +618,10 @@ static int elem_write_enum(selem_none_t *s)
 	else if (s->selem.caps & SM_CAP_CENUM)
 		type = CTL_CAPTURE_ENUM;
 	c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_enumerated(&ctl, idx,
 					(unsigned int)s->str[0].vol[idx]);
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = snd_mixer_elem_write_ctl(elem, c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -565,79 +636,85 @@ static int selem_write_main(snd_mixer_elem_t *elem)
 	s = snd_mixer_elem_get_private(elem);
 
 	if (s->ctls[CTL_GLOBAL_ENUM].elem)
-		return elem_write_enum(s);
+		return elem_write_enum(elem);
 
 	if (s->ctls[CTL_PLAYBACK_ENUM].elem)
-		return elem_write_enum(s);
+		return elem_write_enum(elem);
 
 	if (s->ctls[CTL_CAPTURE_ENUM].elem)
-		return elem_write_enum(s);
+		return elem_write_enum(elem);
 
 	if (s->ctls[CTL_SINGLE].elem) {
 		if (s->ctls[CTL_SINGLE].type == SND_CTL_ELEM_TYPE_INTEGER)
-			err = elem_write_volume(s, SM_PLAY, CTL_SINGLE);
+			err = elem_write_volume(elem, SM_PLAY, CTL_SINGLE);
 		else
-			err = elem_write_switch(s, SM_PLAY, CTL_SINGLE);
+			err = elem_write_switch(elem, SM_PLAY, CTL_SINGLE);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_VOLUME].elem) {
-		err = elem_write_volume(s, SM_PLAY, CTL_GLOBAL_VOLUME);
+		err = elem_write_volume(elem, SM_PLAY, CTL_GLOBAL_VOLUME);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_SWITCH].elem) {
 		if (s->ctls[CTL_PLAYBACK_SWITCH].elem &&
 					s->ctls[CTL_CAPTURE_SWITCH].elem)
-			err = elem_write_switch_constant(s, CTL_GLOBAL_SWITCH,
+			err = elem_write_switch_constant(elem, CTL_GLOBAL_SWITCH,
 							 1);
 		else
-			err = elem_write_switch(s, SM_PLAY, CTL_GLOBAL_SWITCH);
+			err = elem_write_switch(elem, SM_PLAY, CTL_GLOBAL_SWITCH);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_PLAYBACK_VOLUME].elem) {
-		err = elem_write_volume(s, SM_PLAY, CTL_PLAYBACK_VOLUME);
+		err = elem_write_volume(elem, SM_PLAY, CTL_PLAYBACK_VOLUME);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_PLAYBACK_SWITCH].elem) {
-		err = elem_write_switch(s, SM_PLAY, CTL_PLAYBACK_SWITCH);
+		err = elem_write_switch(elem, SM_PLAY, CTL_PLAYBACK_SWITCH);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_PLAYBACK_ROUTE].elem) {
-		err = elem_write_route(s, SM_PLAY, CTL_PLAYBACK_ROUTE);
+		err = elem_write_route(elem, SM_PLAY, CTL_PLAYBACK_ROUTE);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_VOLUME].elem) {
-		err = elem_write_volume(s, SM_CAPT, CTL_CAPTURE_VOLUME);
+		err = elem_write_volume(elem, SM_CAPT, CTL_CAPTURE_VOLUME);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_SWITCH].elem) {
-		err = elem_write_switch(s, SM_CAPT, CTL_CAPTURE_SWITCH);
+		err = elem_write_switch(elem, SM_CAPT, CTL_CAPTURE_SWITCH);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_ROUTE].elem) {
-		err = elem_write_route(s, SM_CAPT, CTL_CAPTURE_ROUTE);
+		err = elem_write_route(elem, SM_CAPT, CTL_CAPTURE_ROUTE);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_SOURCE].elem) {
 		snd_ctl_elem_value_t ctl = {0};
 		selem_ctl_t *c = &s->ctls[CTL_CAPTURE_SOURCE];
-		if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+		/* the control may be shared with other elements of the
+		 * transaction, take the value they queued
+		 */
+		if ((err = snd_mixer_elem_read_ctl(elem, c->elem, &ctl)) < 0)
 			return err;
 		for (idx = 0; idx < c->values; idx++) {
 			if (s->str[SM_CAPT].sw & (1 << idx))
 				snd_ctl_elem_value_set_enumerated(&ctl,
 							idx, s->capture_item);
 		}
-		if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+		if ((err = snd_mixer_elem_write_ctl(elem, c->elem, &ctl)) < 0)
 			return err;
+		/* queued, the value event after the commit updates it */
+		if (err > 0)
+			return 0;
 		/* update the element, don't remove */
 		err = selem_read(elem);
 		if (err < 0)
@@ -665,6 +742,8 @@ static void selem_free(snd_mixer_elem_t *elem)
 	/* free db range information */
 	free(simple->str[0].db_info);
 	free(simple->str[1].db_info);
+	free(simple->str[0].db_table);
+	free(simple->str[1].db_table);
 	free(simple);
 }
 
@@ -1095,11 +1174,54 @@ static int get_volume_ops(snd_mixer_elem_t *elem, int dir,
 
 static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec);
 
+/* convert all the volume steps of the current range once, the
+ * conversion of the linear and range TLVs is costly and the dB gain is
+ * polled by the mixer applications
+ */
+static long *get_db_table(struct selem_str *rec)
+{
+	long volume, *table;
+
+	if (rec->db_table_min == rec->min && rec->db_table_max == rec->max &&
+	    (rec->db_table || rec->db_table_error))
+		return rec->db_table;
+	free(rec->db_table);
+	rec->db_table = NULL;
+	rec->db_table_min = rec->min;
+	rec->db_table_max = rec->max;
+	rec->db_table_error = 1;
+	if (rec->max < rec->min ||
+	    (unsigned long)rec->max - (unsigned long)rec->min >= DB_TABLE_MAX_SIZE)
+		return NULL;
+	table = malloc((rec->max - rec->min + 1) * sizeof(*table));
+	if (!table)
+		return NULL;
+	for (volume = rec->min; volume <= rec->max; volume++) {
+		if (snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
+					  volume, &table[volume - rec->min]) < 0) {
+			free(table);
+			return NULL;
+		}
+	}
+	rec->db_table = table;
+	rec->db_table_error = 0;
+	return table;
+}
+
 static int convert_to_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			 long volume, long *db_gain)
 {
+	long *table;
+
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
+	if (volume >= rec->min && volume <= rec->max) {
+		table = get_db_table(rec);
+		if (table) {
+			*db_gain = table[volume - rec->min];
+			return 0;
+		}
+	}
 	return snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
 				     volume, db_gain);
 }
@@ -29,6 +29,7 @@
 
 #include "local.h"
 #include <stdarg.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -235,6 +236,7 @@ typedef struct _snd_output_buffer {
 	unsigned char *buf;
 	size_t alloc;
 	size_t size;
+	size_t ring;		/* fixed size of a ring buffer, 0 when growing */
 } snd_output_buffer_t;
 
 static int snd_output_buffer_close(snd_output_t *output)
@@ -245,6 +247,43 @@ static int snd_output_buffer_close(snd_output_t *output)
 	return 0;
 }
 
+/*
+ * make room in a ring buffer by dropping the oldest output
+ *
+ * At least a quarter of the buffer is dropped, up to the end of a line,
+ * so that the moves stay rare. When size does not fit at all, the whole
+ * buffer is free for the tail of the new output.
+ */
+static int snd_output_ring_need(snd_output_buffer_t *buffer, size_t size)
+{
+	unsigned char *nl;
+	size_t drop;
+
+	if (!buffer->buf) {
+		buffer->buf = malloc(buffer->ring);
+		if (!buffer->buf)
+			return -ENOMEM;
+		buffer->alloc = buffer->ring;
+	}
+	if (buffer->alloc - buffer->size >= size)
+		return buffer->alloc - buffer->size;
+	if (size >= buffer->alloc) {
+		buffer->size = 0;
+		return buffer->alloc;
+	}
+	drop = buffer->size + size - buffer->alloc;
+	if (drop < buffer->alloc / 4)
+		drop = buffer->alloc / 4;
+	if (drop > buffer->size)
+		drop = buffer->size;
+	nl = memchr(buffer->buf + drop, '\n', buffer->size - drop);
+	if (nl)
+		drop = nl + 1 - buffer->buf;
+	memmove(buffer->buf, buffer->buf + drop, buffer->size - drop);
+	buffer->size -= drop;
+	return buffer->alloc - buffer->size;
+}
+
 static int snd_output_buffer_need(snd_output_t *output, size_t size)
 {
 	snd_output_buffer_t *buffer = output->private_data;
@@ -257,6 +296,8 @@ static int snd_output_buffer_need(snd_output_t *output, size_t size)
 	size++;
 	if (_free >= size)
 		return _free;
+	if (buffer->ring)
+		return snd_output_ring_need(buffer, size);
 	if (buffer->alloc == 0)
 		alloc = 256;
 	else
@@ -271,30 +312,6 @@ static int snd_output_buffer_need(snd_output_t *output, size_t size)
 	return buffer->alloc - buffer->size;
 }
 
-static int snd_output_buffer_print(snd_output_t *output, const char *format, va_list args)
-{
-	snd_output_buffer_t *buffer = output->private_data;
-	size_t size = 256;
-	int result;
-	result = snd_output_buffer_need(output, size);
-	if (result < 0)
-		return result;
-	result = vsnprintf((char *)buffer->buf + buffer->size, size, format, args);
-	assert(result >= 0);
-	if ((size_t)result <= size) {
-		buffer->size += result;
-		return result;
-	}
-	size = result;
-	result = snd_output_buffer_need(output, size);
-	if (result < 0)
-		return result;
-	result = vsnprintf((char *)buffer->buf + buffer->size, result, format, args);
-	assert(result == (int)size);
-	buffer->size += result;
-	return result;
-}
-
 static int snd_output_buffer_puts(snd_output_t *output, const char *str)
 {
 	snd_output_buffer_t *buffer = output->private_data;
@@ -303,11 +320,56 @@ static int snd_output_buffer_puts(snd_output_t *output, const char *str)
 	err = snd_output_buffer_need(output, size);
 	if (err < 0)
 		return err;
+	/* a ring buffer keeps the tail */
+	if (size >= (size_t)err) {
+		str += size - (err - 1);
+		size = err - 1;
+	}
 	memcpy(buffer->buf + buffer->size, str, size);
 	buffer->size += size;
 	return size;
 }
-			
+
+static int snd_output_buffer_print(snd_output_t *output, const char *format, va_list args)
+{
+	snd_output_buffer_t *buffer = output->private_data;
+	va_list copy;
+	char *tmp;
+	int result, avail;
+
+	/* format straight to the free space, again only when it is short */
+	avail = snd_output_buffer_need(output, 0);
+	if (avail < 0)
+		return avail;
+	va_copy(copy, args);
+	result = vsnprintf((char *)buffer->buf + buffer->size, avail, format, copy);
+	va_end(copy);
+	if (result < 0)
+		return -EINVAL;
+	if (result < avail) {
+		buffer->size += result;
+		return result;
+	}
+	avail = snd_output_buffer_need(output, result);
+	if (avail < 0)
+		return avail;
+	if (result >= avail) {
+		/* a ring buffer keeps the tail, as for puts */
+		tmp = malloc(result + 1);
+		if (!tmp)
+			return -ENOMEM;
+		vsnprintf(tmp, result + 1, format, args);
+		result = snd_output_buffer_puts(output, tmp);
+		free(tmp);
+		return result;
+	}
+	result = vsnprintf((char *)buffer->buf + buffer->size, avail, format, args);
+	if (result < 0)
+		return -EINVAL;
+	buffer->size += result;
+	return result;
+}
+
 static int snd_output_buffer_putc(snd_output_t *output, int c)
 {
 	snd_output_buffer_t *buffer = output->private_data;
@@ -402,3 +464,68 @@ int snd_output_buffer_open(snd_output_t **outputp)
 	*outputp = output;
 	return 0;
 }
+
+/**
+ * \brief Preallocates the buffer of a #SND_OUTPUT_BUFFER output handle.
+ * \param output The output handle.
+ * \param size The size of the output to make room for.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The following output up to \p size bytes in total does not allocate.
+ * A ring buffer (#snd_output_buffer_open_ring) has a fixed size, -EINVAL is
+ * returned for it.
+ */
+int snd_output_buffer_reserve(snd_output_t *output, size_t size)
+{
+	snd_output_buffer_t *buffer;
+	int err;
+
+	assert(output);
+	if (output->type != SND_OUTPUT_BUFFER)
+		return -EINVAL;
+	buffer = output->private_data;
+	if (buffer->ring)
+		return -EINVAL;
+	if (size <= buffer->size)
+		return 0;
+	err = snd_output_buffer_need(output, size - buffer->size);
+	return err < 0 ? err : 0;
+}
+
+/**
+ * \brief Creates a new output object with a fixed size memory buffer.
+ * \param outputp The function puts the pointer to the new output object
+ *                at the address specified by \p outputp.
+ * \param size The size of the buffer in bytes, including the terminator.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The buffer is allocated here and does not grow: when it is full, the
+ * oldest output, at least a quarter of the buffer and up to the end of a
+ * line, is dropped. This keeps the most recent output of a long running
+ * process at no allocation cost, e.g. for dumps from a realtime thread.
+ * A single output larger than the buffer keeps its tail; a print that
+ * large is formatted in a temporary allocation first.
+ * The output handle is a #SND_OUTPUT_BUFFER one otherwise.
+ */
+int snd_output_buffer_open_ring(snd_output_t **outputp, size_t size)
+{
+	snd_output_t *output;
+	snd_output_buffer_t *buffer;
+	int err;
+
+	assert(outputp);
+	if (size < 2 || size > INT_MAX)
+		return -EINVAL;
+	err = snd_output_buffer_open(&output);
+	if (err < 0)
+		return err;
+	buffer = output->private_data;
+	buffer->ring = size;
+	err = snd_output_ring_need(buffer, 0);
+	if (err < 0) {
+		snd_output_close(output);
+		return err;
+	}
+	*outputp = output;
+	return 0;
+}
@@ -29,9 +29,20 @@
 
 #define MASK_OFS(i)	((i) >> 5)
 #define MASK_BIT(i)	(1U << ((i) & 31))
+#define MASK_LAST	(MASK_SIZE * 32 - 1)	/* highest bit held in bits[] */
+
+/*
+ * The operations below work on whole 32-bit words and avoid early exits
+ * where possible, so that the loops over the MASK_SIZE words are cheap
+ * and can be vectorized by the compiler; they run many times for every
+ * refine during the hw_params negotiation.
+ */
 
 MASK_INLINE unsigned int ld2(uint32_t v)
 {
+#ifdef __GNUC__
+	return v ? 31 - __builtin_clz(v) : 0;
+#else
         unsigned r = 0;
 
         if (v >= 0x10000) {
@@ -53,6 +64,7 @@ MASK_INLINE unsigned int ld2(uint32_t v)
         if (v >= 2)
                 r++;
         return r;
+#endif
 }
 
 MASK_INLINE unsigned int hweight32(uint32_t v)
@@ -81,20 +93,20 @@ MASK_INLINE void snd_mask_any(snd_mask_t *mask)
 
 MASK_INLINE int snd_mask_empty(const snd_mask_t *mask)
 {
+	uint32_t any = 0;
 	int i;
 	for (i = 0; i < MASK_SIZE; i++)
-		if (mask->bits[i])
-			return 0;
-	return 1;
+		any |= mask->bits[i];
+	return !any;
 }
 
 MASK_INLINE int snd_mask_full(const snd_mask_t *mask)
 {
+	uint32_t all = 0xffffffff;
 	int i;
 	for (i = 0; i < MASK_SIZE; i++)
-		if (mask->bits[i] != 0xffffffff)
-			return 0;
-	return 1;
+		all &= mask->bits[i];
+	return all == 0xffffffff;
 }
 
 MASK_INLINE unsigned int snd_mask_count(const snd_mask_t *mask)
@@ -139,20 +151,40 @@ MASK_INLINE void snd_mask_reset(snd_mask_t *mask, unsigned int val)
 	mask->bits[MASK_OFS(val)] &= ~MASK_BIT(val);
 }
 
+/* bits from..to of the word holding bit 32 * ofs */
+MASK_INLINE uint32_t snd_mask_range_word(unsigned int ofs, unsigned int from,
+					 unsigned int to)
+{
+	uint32_t w = 0xffffffff;
+	if (MASK_OFS(from) == ofs)
+		w &= 0xffffffff << (from & 31);
+	else if (MASK_OFS(from) > ofs)
+		return 0;
+	if (MASK_OFS(to) == ofs)
+		w &= 0xffffffff >> (31 - (to & 31));
+	else if (MASK_OFS(to) < ofs)
+		return 0;
+	return w;
+}
+
 MASK_INLINE void snd_mask_set_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
-	unsigned int i;
+	int i;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] |= MASK_BIT(i);
+	if (to > MASK_LAST)
+		to = MASK_LAST;
+	for (i = 0; i < MASK_SIZE; i++)
+		mask->bits[i] |= snd_mask_range_word(i, from, to);
 }
 
 MASK_INLINE void snd_mask_reset_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
-	unsigned int i;
+	int i;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] &= ~MASK_BIT(i);
+	if (to > MASK_LAST)
+		to = MASK_LAST;
+	for (i = 0; i < MASK_SIZE; i++)
+		mask->bits[i] &= ~snd_mask_range_word(i, from, to);
 }
 
 MASK_INLINE void snd_mask_leave(snd_mask_t *mask, unsigned int val)
@@ -196,30 +228,34 @@ MASK_INLINE int snd_mask_test(const snd_mask_t *mask, unsigned int val)
 
 MASK_INLINE int snd_mask_single(const snd_mask_t *mask)
 {
+	uint32_t multi = 0;
 	int i, c = 0;
 	assert(!snd_mask_empty(mask));
 	for (i = 0; i < MASK_SIZE; i++) {
-		if (! mask->bits[i])
-			continue;
-		if (mask->bits[i] & (mask->bits[i] - 1))
-			return 0;
-		if (c)
-			return 0;
-		c++;
+		uint32_t w = mask->bits[i];
+		c += w != 0;
+		multi |= w & (w - 1);
 	}
-	return 1;
+	return c == 1 && !multi;
 }
 
 MASK_INLINE int snd_mask_refine(snd_mask_t *mask, const snd_mask_t *v)
 {
-	snd_mask_t old;
-	if (snd_mask_empty(mask))
+	uint32_t old = 0, res = 0, diff = 0;
+	int i;
+	/* intersect and classify the result in one pass */
+	for (i = 0; i < MASK_SIZE; i++) {
+		uint32_t m = mask->bits[i], r = m & v->bits[i];
+		old |= m;
+		res |= r;
+		diff |= m ^ r;
+		mask->bits[i] = r;
+	}
+	if (!old)
 		return -ENOENT;
-	snd_mask_copy(&old, mask);
-	snd_mask_intersect(mask, v);
-	if (snd_mask_empty(mask))
+	if (!res)
 		return -EINVAL;
-	return !snd_mask_eq(mask, &old);
+	return diff != 0;
 }
 
 MASK_INLINE int snd_mask_refine_first(snd_mask_t *mask)
@@ -292,9 +328,9 @@ MASK_INLINE int snd_mask_always_eq(const snd_mask_t *m1, const snd_mask_t *m2)
 
 MASK_INLINE int snd_mask_never_eq(const snd_mask_t *m1, const snd_mask_t *m2)
 {
+	uint32_t common = 0;
 	int i;
 	for (i = 0; i < MASK_SIZE; i++)
-		if (m1->bits[i] & m2->bits[i])
-			return 0;
-	return 1;
+		common |= m1->bits[i] & m2->bits[i];
+	return !common;
 }
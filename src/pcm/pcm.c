@@ -509,6 +509,17 @@ aren't thread-safe, and application needs to call them carefully when they
 are called from multiple threads.  In general, all the functions that are
 often called during streaming are covered as thread-safe.
 
+The plugins share one lock per PCM handle, which the transfer functions
+hold while they move the data.  Instead of waiting for it, #snd_pcm_state(),
+#snd_pcm_avail_update() and #snd_pcm_delay() called from another thread
+(e.g. the UI or a level meter) while the PCM is busy answer from the values
+published by the last call that took the lock, corrected by the frames
+transferred since and, for the delay of a running stream, by the elapsed
+time.  These values are dropped on any state change or error and are never
+used when older than a period, in which case the call waits for the lock
+as usual.  #snd_pcm_avail() and #snd_pcm_avail_delay() always sync with the
+hardware under the lock.
+
 This thread-safe behavior can be disabled also by passing 0 to the environment
 variable LIBASOUND_THREAD_SAFE, e.g.
 \code
@@ -516,6 +527,22 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+\section pcm_profile Plugin chain profiling
+
+When the environment variable ALSA_PCM_PROFILE is set to a value other
+than 0 when the PCM is opened, each PCM of a plugin chain counts the
+blocks and frames it processes and the time its own processing takes,
+i.e. the conversion in the plugins and the mixing in the direct plugins
+without the time spent in the slaves, as well as the longest single
+block.  The counters are shown by #snd_pcm_dump() for each set up stage
+and returned by #snd_pcm_get_stage_stats(), which tells which plugin of
+the chain eats the time when the stream glitches, e.g.
+\code
+ALSA_PCM_PROFILE=1 aplay -v foo.wav
+\endcode
+The counters are updated during the transfers without extra locking, so
+a reader running concurrently may see them slightly out of date.
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -680,6 +707,18 @@ playback devices.
 #include <poll.h>
 #include <sys/mman.h>
 #include <limits.h>
+#include <sched.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define AREAS_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define AREAS_SIMD_NEON
+#include <arm_neon.h>
+#endif
 
 #ifndef DOC_HIDDEN
 /* return specific error codes for known bad PCM states */
@@ -723,6 +762,250 @@ static int bad_pcm_state(snd_pcm_t *pcm, unsigned int supported_states,
 		return err;
 	return -EBADFD;
 }
+
+/* published values of the lockless snapshot, see below */
+#define SND_PCM_SNAP_STATE	(1U << 0)
+#define SND_PCM_SNAP_AVAIL	(1U << 1)
+#define SND_PCM_SNAP_DELAY	(1U << 2)
+
+#ifdef THREAD_SAFE_API
+/*
+ * Lockless snapshot of the state, avail and delay
+ *
+ * The locked snd_pcm_state(), snd_pcm_avail_update(), snd_pcm_avail(),
+ * snd_pcm_delay() and snd_pcm_avail_delay() publish their results in
+ * pcm->snap under a sequence counter.  They hold the PCM lock, so there
+ * is a single writer at a time.  A caller finding the lock taken, e.g.
+ * a UI or metering thread racing the audio thread, answers from the
+ * snapshot instead of sleeping on the lock:
+ *
+ * - the frames transferred since the publication (counted with the lock
+ *   held in the transfer and commit paths) are applied to avail and delay,
+ * - the delay of a running stream is advanced by the elapsed time,
+ * - nothing older than a period is used, so the stream stopping on its
+ *   own (xrun, suspend) shows up quickly,
+ * - every state change or transfer error bumps the epoch before it is
+ *   run, which discards all the published values.
+ *
+ * When the snapshot can't answer, the caller falls back to the lock.
+ */
+#define SNAP_SET(snap, field, val) \
+	__atomic_store_n(&(snap)->field, (val), __ATOMIC_RELAXED)
+#define SNAP_GET(snap, field) \
+	__atomic_load_n(&(snap)->field, __ATOMIC_RELAXED)
+
+static inline int snap_enabled(snd_pcm_t *pcm)
+{
+	return pcm->lock_enabled && pcm->need_lock;
+}
+
+static long long snap_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* called with the lock held */
+static void snap_publish(snd_pcm_t *pcm, unsigned int what,
+			 snd_pcm_state_t state, snd_pcm_sframes_t avail,
+			 snd_pcm_sframes_t delay)
+{
+	struct snd_pcm_snapshot *snap = &pcm->snap;
+	unsigned int epoch;
+	snd_pcm_uframes_t xfer;
+	long long now;
+
+	if (!snap_enabled(pcm))
+		return;
+	epoch = __atomic_load_n(&snap->epoch, __ATOMIC_ACQUIRE);
+	xfer = SNAP_GET(snap, xfer);
+	now = snap_clock();
+	SNAP_SET(snap, seq, snap->seq + 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (what & SND_PCM_SNAP_STATE) {
+		SNAP_SET(snap, state, state);
+		SNAP_SET(snap, state_epoch, epoch);
+		SNAP_SET(snap, state_xfer, xfer);
+		SNAP_SET(snap, state_nsec, now);
+	}
+	if (what & SND_PCM_SNAP_AVAIL) {
+		SNAP_SET(snap, avail, avail);
+		SNAP_SET(snap, avail_epoch, epoch);
+		SNAP_SET(snap, avail_xfer, xfer);
+		SNAP_SET(snap, avail_nsec, now);
+	}
+	if (what & SND_PCM_SNAP_DELAY) {
+		SNAP_SET(snap, delay, delay);
+		SNAP_SET(snap, delay_running, state == SND_PCM_STATE_RUNNING);
+		SNAP_SET(snap, delay_epoch, epoch);
+		SNAP_SET(snap, delay_xfer, xfer);
+		SNAP_SET(snap, delay_nsec, now);
+	}
+	SNAP_SET(snap, valid, snap->valid | what);
+	__atomic_store_n(&snap->seq, snap->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* called with the lock held after moving the application pointer */
+static inline void snap_xfer_add(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	__atomic_add_fetch(&pcm->snap.xfer, frames, __ATOMIC_RELAXED);
+}
+
+static inline snd_pcm_uframes_t snap_xfer_count(snd_pcm_t *pcm)
+{
+	return SNAP_GET(&pcm->snap, xfer);
+}
+
+/*
+ * plugins forwarding the transfers to their slave (e.g. hooks) don't go
+ * through the counted paths for this handle; drop what they published
+ */
+static inline void snap_xfer_check(snd_pcm_t *pcm, snd_pcm_uframes_t count,
+				   snd_pcm_sframes_t result)
+{
+	if (result && result != -EAGAIN && snap_xfer_count(pcm) == count)
+		snd_pcm_snap_invalidate(pcm);
+}
+
+/*
+ * copy a consistent snapshot and the current epoch; gives up when the
+ * publisher looks preempted in the middle of an update
+ */
+static int snap_read(snd_pcm_t *pcm, struct snd_pcm_snapshot *copy,
+		     unsigned int *epoch)
+{
+	struct snd_pcm_snapshot *snap = &pcm->snap;
+	unsigned int seq, retries = 64;
+
+	for (;; retries--) {
+		if (!retries)
+			return -EAGAIN;
+		seq = __atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		copy->valid = SNAP_GET(snap, valid);
+		copy->state_epoch = SNAP_GET(snap, state_epoch);
+		copy->avail_epoch = SNAP_GET(snap, avail_epoch);
+		copy->delay_epoch = SNAP_GET(snap, delay_epoch);
+		copy->state_xfer = SNAP_GET(snap, state_xfer);
+		copy->avail_xfer = SNAP_GET(snap, avail_xfer);
+		copy->delay_xfer = SNAP_GET(snap, delay_xfer);
+		copy->state_nsec = SNAP_GET(snap, state_nsec);
+		copy->avail_nsec = SNAP_GET(snap, avail_nsec);
+		copy->delay_nsec = SNAP_GET(snap, delay_nsec);
+		copy->state = SNAP_GET(snap, state);
+		copy->delay_running = SNAP_GET(snap, delay_running);
+		copy->avail = SNAP_GET(snap, avail);
+		copy->delay = SNAP_GET(snap, delay);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (SNAP_GET(snap, seq) == seq)
+			break;
+	}
+	copy->xfer = snap_xfer_count(pcm);
+	*epoch = __atomic_load_n(&snap->epoch, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+/* age limit of the published values: one period */
+static inline int snap_expired(snd_pcm_t *pcm, long long nsec, long long now)
+{
+	return !pcm->rate ||
+		now - nsec > (long long)pcm->period_size * 1000000000LL / pcm->rate;
+}
+
+static int snap_get_state(snd_pcm_t *pcm, snd_pcm_state_t *statep)
+{
+	struct snd_pcm_snapshot s;
+	unsigned int epoch;
+
+	if (snap_read(pcm, &s, &epoch) < 0)
+		return -EAGAIN;
+	if (!(s.valid & SND_PCM_SNAP_STATE) || s.state_epoch != epoch)
+		return -EAGAIN;
+	/* the first transfer may start the stream */
+	if (s.state == SND_PCM_STATE_PREPARED && s.xfer != s.state_xfer)
+		return -EAGAIN;
+	if (snap_expired(pcm, s.state_nsec, snap_clock()))
+		return -EAGAIN;
+	*statep = s.state;
+	return 0;
+}
+
+static int snap_get_avail(snd_pcm_t *pcm, snd_pcm_sframes_t *availp)
+{
+	struct snd_pcm_snapshot s;
+	unsigned int epoch;
+	snd_pcm_sframes_t avail;
+
+	if (snap_read(pcm, &s, &epoch) < 0)
+		return -EAGAIN;
+	if (!(s.valid & SND_PCM_SNAP_AVAIL) || s.avail_epoch != epoch)
+		return -EAGAIN;
+	if (snap_expired(pcm, s.avail_nsec, snap_clock()))
+		return -EAGAIN;
+	/* the pointer moved by the application since; the hardware
+	 * side can only have moved towards a larger avail
+	 */
+	avail = s.avail - (snd_pcm_sframes_t)(s.xfer - s.avail_xfer);
+	*availp = avail > 0 ? avail : 0;
+	return 0;
+}
+
+static int snap_get_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	struct snd_pcm_snapshot s;
+	unsigned int epoch;
+	snd_pcm_sframes_t moved, elapsed = 0, delay;
+	long long now;
+
+	if (snap_read(pcm, &s, &epoch) < 0)
+		return -EAGAIN;
+	if (!(s.valid & SND_PCM_SNAP_DELAY) || s.delay_epoch != epoch)
+		return -EAGAIN;
+	now = snap_clock();
+	if (snap_expired(pcm, s.delay_nsec, now))
+		return -EAGAIN;
+	moved = s.xfer - s.delay_xfer;
+	if (s.delay_running)
+		elapsed = (now - s.delay_nsec) * pcm->rate / 1000000000LL;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		delay = s.delay + moved - elapsed;
+		if (delay < 0)
+			delay = 0;
+	} else {
+		delay = s.delay - moved + elapsed;
+	}
+	*delayp = delay;
+	return 0;
+}
+#else /* THREAD_SAFE_API */
+static inline void snap_publish(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				unsigned int what ATTRIBUTE_UNUSED,
+				snd_pcm_state_t state ATTRIBUTE_UNUSED,
+				snd_pcm_sframes_t avail ATTRIBUTE_UNUSED,
+				snd_pcm_sframes_t delay ATTRIBUTE_UNUSED)
+{
+}
+static inline void snap_xfer_add(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				 snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+{
+}
+static inline snd_pcm_uframes_t snap_xfer_count(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+static inline void snap_xfer_check(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				   snd_pcm_uframes_t count ATTRIBUTE_UNUSED,
+				   snd_pcm_sframes_t result ATTRIBUTE_UNUSED)
+{
+}
+#define snap_enabled(pcm)		0
+#define snap_get_state(pcm, statep)	(-EAGAIN)
+#define snap_get_avail(pcm, availp)	(-EAGAIN)
+#define snap_get_delay(pcm, delayp)	(-EAGAIN)
+#endif /* THREAD_SAFE_API */
 #endif
 
 /**
@@ -947,6 +1230,13 @@ int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
  *
  * The configuration space will be updated to reflect the chosen
  * parameters.
+ *
+ * Installing again the current configuration of a stopped stream, with
+ * the same configuration space as before or the one updated by the
+ * previous call, keeps the resources allocated for it:
+ * only the default software parameters are installed again and the
+ * stream is prepared.  After #snd_pcm_hw_free() the configuration is
+ * always installed from scratch.
  */
 int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
@@ -968,6 +1258,7 @@ int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 int snd_pcm_hw_free(snd_pcm_t *pcm)
 {
 	int err;
+	snd_pcm_hw_refine_cache_free(pcm);
 	if (! pcm->setup)
 		return 0;
 	if (pcm->mmap_channels) {
@@ -977,6 +1268,7 @@ int snd_pcm_hw_free(snd_pcm_t *pcm)
 	}
 	// assert(snd_pcm_state(pcm) == SND_PCM_STATE_SETUP ||
 	//        snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->ops->hw_free)
 		err = pcm->ops->hw_free(pcm->op_arg);
 	else
@@ -1034,6 +1326,9 @@ int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 	pcm->period_step = params->period_step;
 	pcm->avail_min = params->avail_min;
 	pcm->period_event = sw_get_period_event(params);
+	if (sw_get_timer_wakeup(params) && !pcm->timer_wakeup)
+		pcm->wakeup_margin = 1000000;
+	pcm->timer_wakeup = sw_get_timer_wakeup(params);
 	pcm->start_threshold = params->start_threshold;
 	pcm->stop_threshold = params->stop_threshold;
 	pcm->silence_threshold = params->silence_threshold;
@@ -1066,6 +1361,37 @@ int snd_pcm_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
 	return err;
 }
 
+/**
+ * \brief Obtain a status snapshot without a system call
+ * \param pcm PCM handle
+ * \param status Status container
+ * \return 0 on success otherwise a negative error code
+ *
+ * The state, hw_ptr, appl_ptr, tstamp, audio_tstamp and avail fields are
+ * read from the status record mapped from the kernel, so the cost is a
+ * few memory reads, suitable for the synchronization loops querying the
+ * position at high rates.  The snapshot is retried while the kernel
+ * updates the record and -EAGAIN is returned if it does not settle.
+ *
+ * Unlike snd_pcm_status(), the position is not synchronized with the
+ * hardware first: hw_ptr and tstamp are those of the last kernel update,
+ * the delay is derived from the avail only and avail_max is not tracked.
+ *
+ * Returns -ENOSYS when the PCM is not a hw PCM with the status record
+ * mapped.  No lock is taken, the function can be called from any thread.
+ */
+int snd_pcm_status_fast(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	assert(pcm && status);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	if (pcm->type != SND_PCM_TYPE_HW)
+		return -ENOSYS;
+	return snd_pcm_hw_status_fast(pcm, status);
+}
+
 /**
  * \brief Return PCM state
  * \param pcm PCM handle
@@ -1085,8 +1411,13 @@ snd_pcm_state_t snd_pcm_state(snd_pcm_t *pcm)
 	snd_pcm_state_t state;
 
 	assert(pcm);
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!snd_pcm_trylock(pcm->fast_op_arg)) {
+		if (!snap_get_state(pcm->fast_op_arg, &state))
+			return state;
+		snd_pcm_lock(pcm->fast_op_arg);
+	}
 	state = __snd_pcm_state(pcm);
+	snap_publish(pcm->fast_op_arg, SND_PCM_SNAP_STATE, state, 0, 0);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return state;
 }
@@ -1158,8 +1489,18 @@ int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 		SNDMSG("PCM not set up");
 		return -EIO;
 	}
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!snd_pcm_trylock(pcm->fast_op_arg)) {
+		if (!snap_get_delay(pcm->fast_op_arg, delayp))
+			return 0;
+		snd_pcm_lock(pcm->fast_op_arg);
+	}
 	err = __snd_pcm_delay(pcm, delayp);
+	if (err < 0)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
+	else if (snap_enabled(pcm->fast_op_arg))
+		snap_publish(pcm->fast_op_arg,
+			     SND_PCM_SNAP_STATE | SND_PCM_SNAP_DELAY,
+			     __snd_pcm_state(pcm), 0, *delayp);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return err;
 }
@@ -1188,10 +1529,12 @@ int snd_pcm_resume(snd_pcm_t *pcm)
 		return -EIO;
 	}
 	/* lock handled in the callback */
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->resume)
 		err = pcm->fast_ops->resume(pcm->fast_op_arg);
 	else
 		err = -ENOSYS;
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	return err;
 }
 
@@ -1225,6 +1568,24 @@ int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_
 	return err;
 }
 
+/* fault in the buffers of the PCM, the slaves do it in their own prepare */
+static void snd_pcm_prefault(snd_pcm_t *pcm)
+{
+	int lock = pcm->prefault == SND_PCM_PREFAULT_LOCK;
+	int err, err1;
+
+	err = snd_pcm_mmap_prefault(pcm, lock);
+	err1 = snd_pcm_arena_prefault(pcm, lock);
+	if (err >= 0)
+		err = err1;
+	if (err < 0) {
+		/* typically RLIMIT_MEMLOCK, do not retry at each prepare */
+		SNDERR("cannot lock the buffers of PCM %s: %s",
+		       pcm->name ? pcm->name : "", snd_strerror(err));
+		pcm->prefault = SND_PCM_PREFAULT_TOUCH;
+	}
+}
+
 /**
  * \brief Prepare PCM for use
  * \param pcm PCM handle
@@ -1245,10 +1606,13 @@ int snd_pcm_prepare(snd_pcm_t *pcm)
 	if (err < 0)
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->prepare)
 		err = pcm->fast_ops->prepare(pcm->fast_op_arg);
 	else
 		err = -ENOSYS;
+	if (err >= 0 && pcm->fast_op_arg->prefault)
+		snd_pcm_prefault(pcm->fast_op_arg);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return err;
 }
@@ -1272,6 +1636,7 @@ int snd_pcm_reset(snd_pcm_t *pcm)
 		return -EIO;
 	}
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->reset)
 		err = pcm->fast_ops->reset(pcm->fast_op_arg);
 	else
@@ -1332,6 +1697,7 @@ int snd_pcm_drop(snd_pcm_t *pcm)
 	if (err < 0)
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->drop)
 		err = pcm->fast_ops->drop(pcm->fast_op_arg);
 	else
@@ -1370,10 +1736,12 @@ int snd_pcm_drain(snd_pcm_t *pcm)
 	if (err == 1)
 		return 0;
 	/* lock handled in the callback */
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->drain)
 		err = pcm->fast_ops->drain(pcm->fast_op_arg);
 	else
 		err = -ENOSYS;
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	return err;
 }
 
@@ -1402,6 +1770,7 @@ int snd_pcm_pause(snd_pcm_t *pcm, int enable)
 	if (err < 0)
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->pause)
 		err = pcm->fast_ops->pause(pcm->fast_op_arg, enable);
 	else
@@ -1468,6 +1837,7 @@ snd_pcm_sframes_t snd_pcm_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 	if (err < 0)
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->rewind)
 		result = pcm->fast_ops->rewind(pcm->fast_op_arg, frames);
 	else
@@ -1538,6 +1908,7 @@ snd_pcm_sframes_t snd_pcm_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 	if (err < 0)
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	if (pcm->fast_ops->forward)
 		result = pcm->fast_ops->forward(pcm->fast_op_arg, frames);
 	else
@@ -1568,6 +1939,8 @@ use_default_symbol_version(__snd_pcm_forward, snd_pcm_forward, ALSA_0.9.0rc8);
  */ 
 snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
 {
+	snd_pcm_uframes_t count;
+	snd_pcm_sframes_t result;
 	int err;
 
 	assert(pcm);
@@ -1583,7 +1956,10 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_writei(pcm, buffer, size);
+	count = snap_xfer_count(pcm->fast_op_arg);
+	result = _snd_pcm_writei(pcm, buffer, size);
+	snap_xfer_check(pcm->fast_op_arg, count, result);
+	return result;
 }
 
 /**
@@ -1607,6 +1983,8 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
  */ 
 snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size)
 {
+	snd_pcm_uframes_t count;
+	snd_pcm_sframes_t result;
 	int err;
 
 	assert(pcm);
@@ -1622,7 +2000,10 @@ snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_writen(pcm, bufs, size);
+	count = snap_xfer_count(pcm->fast_op_arg);
+	result = _snd_pcm_writen(pcm, bufs, size);
+	snap_xfer_check(pcm->fast_op_arg, count, result);
+	return result;
 }
 
 /**
@@ -1646,6 +2027,8 @@ snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t
  */ 
 snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t size)
 {
+	snd_pcm_uframes_t count;
+	snd_pcm_sframes_t result;
 	int err;
 
 	assert(pcm);
@@ -1661,7 +2044,10 @@ snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_readi(pcm, buffer, size);
+	count = snap_xfer_count(pcm->fast_op_arg);
+	result = _snd_pcm_readi(pcm, buffer, size);
+	snap_xfer_check(pcm->fast_op_arg, count, result);
+	return result;
 }
 
 /**
@@ -1685,6 +2071,8 @@ snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t
  */ 
 snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size)
 {
+	snd_pcm_uframes_t count;
+	snd_pcm_sframes_t result;
 	int err;
 
 	assert(pcm);
@@ -1700,7 +2088,10 @@ snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t s
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_readn(pcm, bufs, size);
+	count = snap_xfer_count(pcm->fast_op_arg);
+	result = _snd_pcm_readn(pcm, bufs, size);
+	snap_xfer_check(pcm->fast_op_arg, count, result);
+	return result;
 }
 
 /**
@@ -1741,6 +2132,48 @@ int snd_pcm_unlink(snd_pcm_t *pcm)
 	return err;
 }
 
+/**
+ * \brief Set the prefault mode of the PCM buffers
+ * \param pcm PCM handle
+ * \param mode #SND_PCM_PREFAULT_NONE, #SND_PCM_PREFAULT_TOUCH or
+ *        #SND_PCM_PREFAULT_LOCK
+ * \return 0 on success otherwise a negative error code
+ *
+ * The pages of the buffers are faulted in lazily, on their first access,
+ * which may take long enough to cause an xrun in the first periods after
+ * #snd_pcm_start() with a short period.  With a prefault mode, each
+ * #snd_pcm_prepare() touches the mmap buffers of the PCM and of its
+ * slaves and the intermediate buffers of the plugin chain, and with
+ * #SND_PCM_PREFAULT_LOCK it also locks them in memory (see mlock(2)).
+ * When the buffers cannot be locked, e.g. because of RLIMIT_MEMLOCK, an
+ * error is reported once and the PCM falls back to
+ * #SND_PCM_PREFAULT_TOUCH.
+ *
+ * The slaves inherit the mode at #snd_pcm_hw_params(), so set it
+ * before.  The default is taken from the defaults.pcm.prefault
+ * configuration key, the LIBASOUND_PREFAULT environment variable
+ * (0, 1 or 2) overrides it.
+ */
+int snd_pcm_set_prefault(snd_pcm_t *pcm, snd_pcm_prefault_t mode)
+{
+	assert(pcm);
+	if ((unsigned int)mode > SND_PCM_PREFAULT_LAST)
+		return -EINVAL;
+	pcm->prefault = mode;
+	return 0;
+}
+
+/**
+ * \brief Get the prefault mode of the PCM buffers
+ * \param pcm PCM handle
+ * \return the current mode, see #snd_pcm_set_prefault()
+ */
+snd_pcm_prefault_t snd_pcm_get_prefault(snd_pcm_t *pcm)
+{
+	assert(pcm);
+	return pcm->prefault;
+}
+
 /* locked version */
 static int __snd_pcm_poll_descriptors_count(snd_pcm_t *pcm)
 {
@@ -1867,6 +2300,7 @@ int snd_pcm_poll_descriptors_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsign
 	int err;
 
 	assert(pcm && pfds && revents);
+	snd_pcm_wakeup_new_seq();
 	snd_pcm_lock(pcm->fast_op_arg);
 	err = __snd_pcm_poll_revents(pcm, pfds, nfds, revents);
 	snd_pcm_unlock(pcm->fast_op_arg);
@@ -2378,6 +2812,7 @@ int snd_pcm_dump_sw_setup(snd_pcm_t *pcm, snd_output_t *out)
 	snd_output_printf(out, "  period_step  : %d\n", pcm->period_step);
 	snd_output_printf(out, "  avail_min    : %ld\n", pcm->avail_min);
 	snd_output_printf(out, "  period_event : %i\n", pcm->period_event);
+	snd_output_printf(out, "  timer_wakeup : %i\n", pcm->timer_wakeup);
 	snd_output_printf(out, "  start_threshold  : %ld\n", pcm->start_threshold);
 	snd_output_printf(out, "  stop_threshold   : %ld\n", pcm->stop_threshold);
 	snd_output_printf(out, "  silence_threshold: %ld\n", pcm->silence_threshold);
@@ -2394,8 +2829,14 @@ int snd_pcm_dump_sw_setup(snd_pcm_t *pcm, snd_output_t *out)
  */
 int snd_pcm_dump_setup(snd_pcm_t *pcm, snd_output_t *out)
 {
+	struct snd_pcm_profile *prof = pcm->profile;
+
 	snd_pcm_dump_hw_setup(pcm, out);
 	snd_pcm_dump_sw_setup(pcm, out);
+	if (prof)
+		snd_output_printf(out, "  profile      : %llu blocks, %llu frames, %llu us (max %llu us)\n",
+				  prof->calls, prof->frames, prof->nsec / 1000,
+				  prof->max_nsec / 1000);
 	return 0;
 }
 
@@ -2439,6 +2880,44 @@ int snd_pcm_dump(snd_pcm_t *pcm, snd_output_t *out)
 	return err;
 }
 
+/**
+ * \brief Read the profiling counters of the stages of a plugin chain
+ * \param pcm PCM handle
+ * \param stats Array filled with the counters, from \a pcm to the hardware
+ * \param count Number of entries in \a stats
+ * \return the number of stages of the chain, which may be larger than
+ *         \a count, otherwise a negative error code
+ *
+ * The counters are collected only when the environment variable
+ * ALSA_PCM_PROFILE was set at open time, -ENOSYS is returned otherwise.
+ * The chain is known once the PCM is set up with #snd_pcm_hw_params();
+ * before that only \a pcm itself is reported.  See \ref pcm_profile.
+ */
+int snd_pcm_get_stage_stats(snd_pcm_t *pcm, snd_pcm_stage_stats_t *stats,
+			    unsigned int count)
+{
+	struct snd_pcm_profile *prof;
+	unsigned int n = 0;
+
+	assert(pcm);
+	assert(stats || count == 0);
+	if (!pcm->profile)
+		return -ENOSYS;
+	while (pcm && (prof = pcm->profile) != NULL) {
+		if (n < count) {
+			stats[n].name = pcm->name;
+			stats[n].type = pcm->type;
+			stats[n].calls = prof->calls;
+			stats[n].frames = prof->frames;
+			stats[n].nsec = prof->nsec;
+			stats[n].max_nsec = prof->max_nsec;
+		}
+		n++;
+		pcm = pcm->setup ? prof->slave : NULL;
+	}
+	return n;
+}
+
 /**
  * \brief Convert bytes in frames for a PCM
  * \param pcm PCM handle
@@ -2525,7 +3004,7 @@ int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm,
 		return err;
 	h->type = SND_ASYNC_HANDLER_PCM;
 	h->u.pcm = pcm;
-	was_empty = list_empty(&pcm->async_handlers);
+	was_empty = !_snd_async_signal_used(&pcm->async_handlers);
 	list_add_tail(&h->hlist, &pcm->async_handlers);
 	if (was_empty) {
 		err = snd_pcm_async(pcm, snd_async_handler_get_signo(h), getpid());
@@ -2538,6 +3017,30 @@ int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm,
 	return 0;
 }
 
+/**
+ * \brief Add an async handler for a PCM called from a thread
+ * \param handler Returned handler handle
+ * \param pcm PCM handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback is called from a thread polling the descriptors of the PCM
+ * whenever #snd_pcm_poll_descriptors_revents() reports an event, that is
+ * as long as avail_min frames are available or the PCM is in an error
+ * state.  No signal is used.  The poll descriptors are taken when the
+ * handler is added.  See #snd_async_add_thread_handler for the rules
+ * of the thread callbacks.
+ */
+int snd_async_add_pcm_thread_handler(snd_async_handler_t **handler, snd_pcm_t *pcm,
+				     snd_async_callback_t callback, void *private_data)
+{
+	assert(pcm);
+	return _snd_async_add_thread_handler(handler, SND_ASYNC_HANDLER_PCM, pcm,
+					     &pcm->async_handlers, callback,
+					     private_data);
+}
+
 /**
  * \brief Return PCM handle related to an async handler
  * \param handler Async handler handle
@@ -2552,11 +3055,80 @@ snd_pcm_t *snd_async_handler_get_pcm(snd_async_handler_t *handler)
 	return handler->u.pcm;
 }
 
-static const char *const build_in_pcms[] = {
-	"adpcm", "alaw", "copy", "dmix", "file", "hooks", "hw", "ladspa", "lfloat",
-	"linear", "meter", "mulaw", "multi", "null", "empty", "plug", "rate", "route", "share",
-	"shm", "dsnoop", "dshare", "asym", "iec958", "softvol", "mmap_emul",
-	NULL
+typedef int (*snd_pcm_open_func_t)(snd_pcm_t **, const char *,
+				   snd_config_t *, snd_config_t *,
+				   snd_pcm_stream_t, int);
+
+/*
+ * The open functions of the built in types are referenced weak, the
+ * types left out of the build are NULL and go through snd_dlsym() to
+ * report the missing symbol as before.  The table is built with the
+ * library, so the functions match SND_PCM_DLSYM_VERSION.
+ */
+#define BUILD_IN_PCM(type) \
+	extern int _snd_pcm_##type##_open(snd_pcm_t **, const char *, \
+					  snd_config_t *, snd_config_t *, \
+					  snd_pcm_stream_t, int) \
+		__attribute__((weak))
+
+BUILD_IN_PCM(adpcm);
+BUILD_IN_PCM(alaw);
+BUILD_IN_PCM(copy);
+BUILD_IN_PCM(dmix);
+BUILD_IN_PCM(file);
+BUILD_IN_PCM(hooks);
+BUILD_IN_PCM(hw);
+BUILD_IN_PCM(ladspa);
+BUILD_IN_PCM(lfloat);
+BUILD_IN_PCM(linear);
+BUILD_IN_PCM(meter);
+BUILD_IN_PCM(mulaw);
+BUILD_IN_PCM(multi);
+BUILD_IN_PCM(null);
+BUILD_IN_PCM(empty);
+BUILD_IN_PCM(plug);
+BUILD_IN_PCM(rate);
+BUILD_IN_PCM(route);
+BUILD_IN_PCM(share);
+BUILD_IN_PCM(shm);
+BUILD_IN_PCM(dsnoop);
+BUILD_IN_PCM(dshare);
+BUILD_IN_PCM(asym);
+BUILD_IN_PCM(iec958);
+BUILD_IN_PCM(softvol);
+BUILD_IN_PCM(mmap_emul);
+
+static const struct {
+	const char *type;
+	snd_pcm_open_func_t open_func;
+} build_in_pcms[] = {
+	{ "adpcm", _snd_pcm_adpcm_open },
+	{ "alaw", _snd_pcm_alaw_open },
+	{ "copy", _snd_pcm_copy_open },
+	{ "dmix", _snd_pcm_dmix_open },
+	{ "file", _snd_pcm_file_open },
+	{ "hooks", _snd_pcm_hooks_open },
+	{ "hw", _snd_pcm_hw_open },
+	{ "ladspa", _snd_pcm_ladspa_open },
+	{ "lfloat", _snd_pcm_lfloat_open },
+	{ "linear", _snd_pcm_linear_open },
+	{ "meter", _snd_pcm_meter_open },
+	{ "mulaw", _snd_pcm_mulaw_open },
+	{ "multi", _snd_pcm_multi_open },
+	{ "null", _snd_pcm_null_open },
+	{ "empty", _snd_pcm_empty_open },
+	{ "plug", _snd_pcm_plug_open },
+	{ "rate", _snd_pcm_rate_open },
+	{ "route", _snd_pcm_route_open },
+	{ "share", _snd_pcm_share_open },
+	{ "shm", _snd_pcm_shm_open },
+	{ "dsnoop", _snd_pcm_dsnoop_open },
+	{ "dshare", _snd_pcm_dshare_open },
+	{ "asym", _snd_pcm_asym_open },
+	{ "iec958", _snd_pcm_iec958_open },
+	{ "softvol", _snd_pcm_softvol_open },
+	{ "mmap_emul", _snd_pcm_mmap_emul_open },
+	{ NULL, NULL }
 };
 
 static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
@@ -2570,9 +3142,8 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	const char *id;
 	const char *lib = NULL, *open_name = NULL;
-	int (*open_func)(snd_pcm_t **, const char *, 
-			 snd_config_t *, snd_config_t *, 
-			 snd_pcm_stream_t, int) = NULL;
+	snd_pcm_open_func_t open_func = NULL;
+	int cached = 1;
 #ifndef PIC
 	extern void *snd_pcm_open_symbols(void);
 #endif
@@ -2636,23 +3207,13 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 			goto _err;
 		}
 	}
-	if (!open_name) {
-		buf = malloc(strlen(str) + 32);
-		if (buf == NULL) {
-			err = -ENOMEM;
-			goto _err;
-		}
-		open_name = buf;
-		sprintf(buf, "_snd_pcm_%s_open", str);
-	}
 	if (!lib) {
-		const char *const *build_in = build_in_pcms;
-		while (*build_in) {
-			if (!strcmp(*build_in, str))
+		unsigned int k;
+		for (k = 0; build_in_pcms[k].type; k++) {
+			if (!strcmp(build_in_pcms[k].type, str))
 				break;
-			build_in++;
 		}
-		if (*build_in == NULL) {
+		if (!build_in_pcms[k].type) {
 			buf1 = malloc(strlen(str) + 32);
 			if (buf1 == NULL) {
 				err = -ENOMEM;
@@ -2660,24 +3221,39 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 			}
 			lib = buf1;
 			sprintf(buf1, "libasound_module_pcm_%s.so", str);
+		} else if (!open_name) {
+			open_func = build_in_pcms[k].open_func;
+			cached = open_func == NULL;
 		}
 	}
+	if (!open_name && cached) {
+		buf = malloc(strlen(str) + 32);
+		if (buf == NULL) {
+			err = -ENOMEM;
+			goto _err;
+		}
+		open_name = buf;
+		sprintf(buf, "_snd_pcm_%s_open", str);
+	}
 #ifndef PIC
 	snd_pcm_open_symbols();	/* this call is for static linking only */
 #endif
-	open_func = snd_dlobj_cache_get(lib, open_name,
-			SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION), 1);
+	if (cached)
+		open_func = snd_dlobj_cache_get(lib, open_name,
+				SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION), 1);
 	if (open_func) {
 		err = open_func(pcmp, name, pcm_root, pcm_conf, stream, mode);
 		if (err >= 0) {
 			if ((*pcmp)->open_func) {
 				/* only init plugin (like empty, asym) */
-				snd_dlobj_cache_put(open_func);
+				if (cached)
+					snd_dlobj_cache_put(open_func);
 			} else {
 				(*pcmp)->open_func = open_func;
+				(*pcmp)->open_func_ref = cached;
 			}
 			err = 0;
-		} else {
+		} else if (cached) {
 			snd_dlobj_cache_put(open_func);
 		}
 	} else {
@@ -2699,6 +3275,17 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 		err = snd_config_search(pcm_root, "defaults.pcm.minperiodtime", &tmp);
 		if (err >= 0)
 			snd_config_get_integer(tmp, &(*pcmp)->minperiodtime);
+		err = snd_config_search(pcm_root, "defaults.pcm.prefault", &tmp);
+		if (err >= 0) {
+			long i;
+			if (snd_config_get_integer(tmp, &i) >= 0 &&
+			    i > 0 && i <= SND_PCM_PREFAULT_LAST)
+				(*pcmp)->prefault = i;
+		}
+		/* the environment overrides the configuration */
+		str = getenv("LIBASOUND_PREFAULT");
+		if (str && *str >= '0' && *str <= '0' + SND_PCM_PREFAULT_LAST)
+			(*pcmp)->prefault = *str - '0';
 		err = 0;
 	}
        _err:
@@ -2709,6 +3296,181 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * The expanded definitions of the PCMs opened from the global
+ * configuration.  They are valid as long as the configuration is not
+ * reloaded and the environment variables and the cards their functions
+ * read did not change.
+ */
+#define PCM_OPEN_CACHE_MAX	16
+
+struct pcm_open_plan {
+	struct pcm_open_plan *next;
+	char *name;
+	snd_config_t *conf;
+	snd_config_deps_t *deps;
+};
+
+static struct {
+	snd_config_t *root;		/* referenced */
+	unsigned int count;
+	struct pcm_open_plan *plans;	/* the most recently used first */
+} pcm_open_cache;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t pcm_open_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void pcm_open_cache_lock(void)
+{
+	pthread_mutex_lock(&pcm_open_cache_mutex);
+}
+
+static inline void pcm_open_cache_unlock(void)
+{
+	pthread_mutex_unlock(&pcm_open_cache_mutex);
+}
+#else
+static inline void pcm_open_cache_lock(void) { }
+static inline void pcm_open_cache_unlock(void) { }
+#endif
+#endif
+
+static void pcm_open_plan_free(struct pcm_open_plan *p)
+{
+	free(p->name);
+	if (p->conf)
+		snd_config_delete(p->conf);
+	_snd_config_deps_free(p->deps);
+	free(p);
+}
+
+static void pcm_open_cache_drop(void)
+{
+	struct pcm_open_plan *p;
+
+	while ((p = pcm_open_cache.plans) != NULL) {
+		pcm_open_cache.plans = p->next;
+		pcm_open_plan_free(p);
+	}
+	pcm_open_cache.count = 0;
+	if (pcm_open_cache.root)
+		snd_config_unref(pcm_open_cache.root);
+	pcm_open_cache.root = NULL;
+}
+
+/*
+ * Frees the cached definitions, called by snd_config_update_free_global().
+ */
+void _snd_pcm_open_cache_free(void)
+{
+	pcm_open_cache_lock();
+	pcm_open_cache_drop();
+	pcm_open_cache_unlock();
+}
+
+/* returns a copy of the cached definition, -ENOENT when there is none */
+static int pcm_open_cache_find(snd_config_t *root, const char *name,
+			       snd_config_t **result)
+{
+	struct pcm_open_plan *p, **pp;
+	int err = -ENOENT;
+
+	pcm_open_cache_lock();
+	if (pcm_open_cache.root != root)
+		goto unlock;
+	for (pp = &pcm_open_cache.plans; (p = *pp) != NULL; pp = &p->next) {
+		if (strcmp(p->name, name))
+			continue;
+		*pp = p->next;
+		if (!_snd_config_deps_check(p->deps)) {
+			pcm_open_cache.count--;
+			pcm_open_plan_free(p);
+			break;
+		}
+		p->next = pcm_open_cache.plans;
+		pcm_open_cache.plans = p;
+		err = snd_config_copy(result, p->conf);
+		break;
+	}
+ unlock:
+	pcm_open_cache_unlock();
+	return err;
+}
+
+/* keeps a copy of the definition, a failure only means no caching */
+static void pcm_open_cache_add(snd_config_t *root, const char *name,
+			       snd_config_t *conf, snd_config_deps_t *deps)
+{
+	struct pcm_open_plan *p, **pp;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		goto nomem;
+	p->deps = deps;
+	p->name = strdup(name);
+	if (!p->name || snd_config_copy(&p->conf, conf) < 0) {
+		pcm_open_plan_free(p);
+		return;
+	}
+	pcm_open_cache_lock();
+	if (pcm_open_cache.root != root) {
+		pcm_open_cache_drop();
+		snd_config_ref(root);
+		pcm_open_cache.root = root;
+	}
+	/* a concurrent open of the same PCM may have added it meanwhile */
+	for (pp = &pcm_open_cache.plans; *pp; pp = &(*pp)->next)
+		if (strcmp((*pp)->name, name) == 0) {
+			pcm_open_cache_unlock();
+			pcm_open_plan_free(p);
+			return;
+		}
+	p->next = pcm_open_cache.plans;
+	pcm_open_cache.plans = p;
+	if (++pcm_open_cache.count > PCM_OPEN_CACHE_MAX) {
+		for (pp = &pcm_open_cache.plans; (*pp)->next; pp = &(*pp)->next)
+			;
+		pcm_open_plan_free(*pp);
+		*pp = NULL;
+		pcm_open_cache.count--;
+	}
+	pcm_open_cache_unlock();
+	return;
+ nomem:
+	_snd_config_deps_free(deps);
+}
+
+/*
+ * Searches and expands the definition of a PCM.  With open_cache set, the
+ * result is kept for the next opens when it comes from the global
+ * configuration and depends only on it, on environment variables and on
+ * the cards.
+ */
+static int snd_pcm_search_definition(snd_config_t *root, const char *name,
+				     snd_config_t **result)
+{
+	snd_config_deps_t *deps;
+	snd_config_t *n;
+	int err;
+
+	if (root != snd_config ||
+	    snd_config_search(root, "defaults.pcm.open_cache", &n) < 0 ||
+	    snd_config_get_bool(n) <= 0)
+		return snd_config_search_definition(root, "pcm", name, result);
+	err = pcm_open_cache_find(root, name, result);
+	if (err != -ENOENT)
+		return err;
+	deps = _snd_config_deps_start();
+	err = snd_config_search_definition(root, "pcm", name, result);
+	if (_snd_config_deps_stop(deps) < 0 || err < 0) {
+		_snd_config_deps_free(deps);
+		return err;
+	}
+	pcm_open_cache_add(root, name, *result, deps);
+	return err;
+}
+
 static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 				 const char *name, snd_pcm_stream_t stream,
 				 int mode, int hop)
@@ -2717,7 +3479,7 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 	snd_config_t *pcm_conf;
 	const char *str;
 
-	err = snd_config_search_definition(root, "pcm", name, &pcm_conf);
+	err = snd_pcm_search_definition(root, name, &pcm_conf);
 	if (err < 0) {
 		SNDERR("Unknown PCM %s", name);
 		return err;
@@ -2740,6 +3502,15 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
  * \param stream Wanted stream
  * \param mode Open mode (see #SND_PCM_NONBLOCK, #SND_PCM_ASYNC)
  * \return 0 on success otherwise a negative error code
+ *
+ * When defaults.pcm.open_cache is set to true, the expanded definition
+ * of \a name in the global configuration is kept for the next opens,
+ * until the configuration files change or one of the environment
+ * variables or cards its functions read changes.  The definitions using
+ * other functions are expanded at each open.  The kept definitions do not
+ * follow the changes made to #snd_config in place, so an application
+ * doing them leaves the cache off or calls snd_config_update_free_global()
+ * afterwards.
  */
 int snd_pcm_open(snd_pcm_t **pcmp, const char *name, 
 		 snd_pcm_stream_t stream, int mode)
@@ -2804,6 +3575,51 @@ int snd_pcm_open_fallback(snd_pcm_t **pcmp, snd_config_t *root,
 }
 
 #ifndef DOC_HIDDEN
+/* check $ALSA_PCM_PROFILE only once at the first open for consistency */
+static int snd_pcm_profile_enabled(void)
+{
+	static int enabled = -1;
+
+	if (enabled == -1) {
+		const char *p = getenv("ALSA_PCM_PROFILE");
+		enabled = p && *p && *p != '0';
+	}
+	return enabled;
+}
+
+unsigned long long snd_pcm_profile_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void snd_pcm_profile_account(struct snd_pcm_profile *prof,
+			     unsigned long long start, snd_pcm_uframes_t frames)
+{
+	unsigned long long nsec = snd_pcm_profile_clock() - start;
+
+	prof->calls++;
+	prof->frames += frames;
+	prof->nsec += nsec;
+	if (nsec > prof->max_nsec)
+		prof->max_nsec = nsec;
+}
+
+/* record the next stage of the chain, called at hw_params;
+ * the slave inherits the prefault mode too
+ */
+void snd_pcm_profile_link(snd_pcm_t *pcm, snd_pcm_t *slave)
+{
+	if (slave == pcm)
+		return;
+	if (pcm->profile)
+		pcm->profile->slave = slave;
+	if (slave->prefault < pcm->prefault)
+		slave->prefault = pcm->prefault;
+}
+
 int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		snd_pcm_stream_t stream, int mode)
 {
@@ -2851,6 +3667,13 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		pcm->lock_enabled = do_lock_enable;
 	}
 #endif
+	if (snd_pcm_profile_enabled()) {
+		pcm->profile = calloc(1, sizeof(*pcm->profile));
+		if (!pcm->profile) {
+			snd_pcm_free(pcm);
+			return -ENOMEM;
+		}
+	}
 	*pcmp = pcm;
 	return 0;
 }
@@ -2861,7 +3684,12 @@ int snd_pcm_free(snd_pcm_t *pcm)
 	free(pcm->name);
 	free(pcm->hw.link_dst);
 	free(pcm->appl.link_dst);
-	snd_dlobj_cache_put(pcm->open_func);
+	snd_pcm_hw_refine_cache_free(pcm);
+	free(pcm->setup_key);
+	snd_pcm_arena_put(pcm);
+	free(pcm->profile);
+	if (pcm->open_func_ref)
+		snd_dlobj_cache_put(pcm->open_func);
 #ifdef THREAD_SAFE_API
 	pthread_mutex_destroy(&pcm->lock);
 #endif
@@ -2911,6 +3739,8 @@ int snd_pcm_wait(snd_pcm_t *pcm, int timeout)
 }
 
 #ifndef DOC_HIDDEN
+static int snd_pcm_wait_timer(snd_pcm_t *pcm, int timeout);
+
 /* locked version */
 int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout)
 {
@@ -2923,6 +3753,11 @@ int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout)
 		err = pcm_state_to_error(__snd_pcm_state(pcm));
 		return err < 0 ? err : 1;
 	}
+	/* without the period wakeups no poll event comes before an error */
+	if ((pcm->timer_wakeup ||
+	     (pcm->hw_flags & SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP)) && pcm->rate &&
+	    __snd_pcm_state(pcm) == SND_PCM_STATE_RUNNING)
+		return snd_pcm_wait_timer(pcm, timeout);
 	return snd_pcm_wait_nocheck(pcm, timeout);
 }
 
@@ -2957,19 +3792,127 @@ static int __snd_pcm_wait_drain_timeout(snd_pcm_t *pcm)
 	return timeout;
 }
 
-/* 
- * like snd_pcm_wait() but doesn't check mmap_avail before calling poll()
+/* bumped at each poll wakeup, for the drivers caching the stream status */
+static unsigned int wakeup_seq;
+
+unsigned int snd_pcm_wakeup_seq(void)
+{
+	return __atomic_load_n(&wakeup_seq, __ATOMIC_ACQUIRE);
+}
+
+/* forget the status cached by all PCMs */
+void snd_pcm_wakeup_new_seq(void)
+{
+	__atomic_add_fetch(&wakeup_seq, 1, __ATOMIC_RELEASE);
+}
+
+/* 
+ * like snd_pcm_wait() but doesn't check mmap_avail before calling poll()
+ *
+ * used in drain code in some plugins
+ *
+ * This function is called inside pcm lock.
+ */
+int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
+{
+	struct pollfd *pfd;
+	unsigned short revents = 0;
+	int npfds, err, err_poll;
+	
+	npfds = __snd_pcm_poll_descriptors_count(pcm);
+	if (npfds <= 0 || npfds >= 16) {
+		SNDERR("Invalid poll_fds %d", npfds);
+		return -EIO;
+	}
+	pfd = alloca(sizeof(*pfd) * npfds);
+	err = __snd_pcm_poll_descriptors(pcm, pfd, npfds);
+	if (err < 0)
+		return err;
+	if (err != npfds) {
+		SNDMSG("invalid poll descriptors %d", err);
+		return -EIO;
+	}
+	if (timeout == SND_PCM_WAIT_IO)
+		timeout = __snd_pcm_wait_io_timeout(pcm);
+	else if (timeout == SND_PCM_WAIT_DRAIN)
+		timeout = __snd_pcm_wait_drain_timeout(pcm);
+	else if (timeout < -1)
+		SNDMSG("invalid snd_pcm_wait timeout argument %d", timeout);
+	do {
+		__snd_pcm_unlock(pcm->fast_op_arg);
+		err_poll = poll(pfd, npfds, timeout);
+		__snd_pcm_lock(pcm->fast_op_arg);
+		if (err_poll < 0) {
+			if (errno == EINTR && !PCMINABORT(pcm) && !(pcm->mode & SND_PCM_EINTR))
+		                continue;
+			return -errno;
+                }
+		if (! err_poll)
+			break;
+		snd_pcm_wakeup_new_seq();
+		err = __snd_pcm_poll_revents(pcm, pfd, npfds, &revents);
+		if (err < 0)
+			return err;
+		if (revents & (POLLERR | POLLNVAL)) {
+			/* check more precisely */
+			err = pcm_state_to_error(__snd_pcm_state(pcm));
+			return err < 0 ? err : -EIO;
+		}
+	} while (!(revents & (POLLIN | POLLOUT)));
+#if 0 /* very useful code to test poll related problems */
+	{
+		snd_pcm_sframes_t avail_update;
+		__snd_pcm_hwsync(pcm);
+		avail_update = __snd_pcm_avail_update(pcm);
+		if (avail_update < (snd_pcm_sframes_t)pcm->avail_min) {
+			printf("*** snd_pcm_wait() FATAL ERROR!!!\n");
+			printf("avail_min = %li, avail_update = %li\n", pcm->avail_min, avail_update);
+		}
+	}
+#endif
+	return err_poll > 0 ? 1 : 0;
+}
+
+static long long timespec_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static clockid_t snd_pcm_tstamp_clock(snd_pcm_t *pcm)
+{
+	switch (pcm->tstamp_type) {
+	case SND_PCM_TSTAMP_TYPE_MONOTONIC:
+		return CLOCK_MONOTONIC;
+#ifdef CLOCK_MONOTONIC_RAW
+	case SND_PCM_TSTAMP_TYPE_MONOTONIC_RAW:
+		return CLOCK_MONOTONIC_RAW;
+#endif
+	default:
+		return CLOCK_REALTIME;
+	}
+}
+
+/* shortest sleep, so that a wrong prediction does not spin */
+#define TIMER_WAKEUP_MIN_SLEEP	50000LL
+
+/*
+ * snd_pcm_wait() with the timer driven wakeups
  *
- * used in drain code in some plugins
+ * Sleeps until the predicted time of avail reaching avail_min.  The
+ * first sleep ends wakeup_margin earlier, to absorb the scheduling
+ * latency and the clock drift; the margin follows twice the lateness
+ * measured in frames at the final wakeup, and doubles on xruns.
  *
  * This function is called inside pcm lock.
  */
-int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
+static int snd_pcm_wait_timer(snd_pcm_t *pcm, int timeout)
 {
 	struct pollfd *pfd;
-	unsigned short revents = 0;
-	int npfds, err, err_poll;
-	
+	unsigned short revents;
+	struct timespec start, now, ts;
+	long long limit = 0, max_margin;
+	int npfds, err, first = 1;
+
 	npfds = __snd_pcm_poll_descriptors_count(pcm);
 	if (npfds <= 0 || npfds >= 16) {
 		SNDERR("Invalid poll_fds %d", npfds);
@@ -2987,40 +3930,109 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 		timeout = __snd_pcm_wait_io_timeout(pcm);
 	else if (timeout == SND_PCM_WAIT_DRAIN)
 		timeout = __snd_pcm_wait_drain_timeout(pcm);
-	else if (timeout < -1)
-		SNDMSG("invalid snd_pcm_wait timeout argument %d", timeout);
-	do {
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (timeout >= 0)
+		limit = timespec_to_ns(&start) + timeout * 1000000LL;
+	max_margin = pcm->buffer_size * 1000000000LL / pcm->rate / 4;
+
+	for (;;) {
+		snd_pcm_uframes_t avail = 0;
+		snd_htimestamp_t tstamp;
+		snd_pcm_sframes_t sf;
+		long long sleep_ns, age;
+		int err_poll;
+
+		err = -ENOSYS;
+		if (pcm->fast_ops->htimestamp)
+			err = pcm->fast_ops->htimestamp(pcm->fast_op_arg, &avail, &tstamp);
+		if (err < 0) {
+			tstamp.tv_sec = tstamp.tv_nsec = 0;
+			__snd_pcm_hwsync(pcm);
+			sf = __snd_pcm_avail_update(pcm);
+			if (sf < 0) {
+				err = sf;
+				goto error;
+			}
+			avail = sf;
+		}
+		if (avail >= pcm->avail_min) {
+			if (!first) {
+				long long late = (avail - pcm->avail_min) *
+					1000000000LL / pcm->rate;
+
+				pcm->wakeup_margin += (2 * late - pcm->wakeup_margin) / 8;
+				if (pcm->wakeup_margin > max_margin)
+					pcm->wakeup_margin = max_margin;
+			}
+			return 1;
+		}
+		if (__snd_pcm_state(pcm) != SND_PCM_STATE_RUNNING) {
+			err = pcm_state_to_error(__snd_pcm_state(pcm));
+			if (err < 0)
+				goto error;
+			/* paused or stopped meanwhile */
+			timeout = -1;
+			if (limit) {
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				timeout = (limit - timespec_to_ns(&now)) / 1000000;
+				if (timeout < 0)
+					timeout = 0;
+			}
+			return snd_pcm_wait_nocheck(pcm, timeout);
+		}
+
+		sleep_ns = (pcm->avail_min - avail) * 1000000000LL / pcm->rate;
+		if (tstamp.tv_sec || tstamp.tv_nsec) {
+			/* the avail was sampled at tstamp, not now */
+			clock_gettime(snd_pcm_tstamp_clock(pcm), &now);
+			age = timespec_to_ns(&now) - timespec_to_ns(&tstamp);
+			if (age > 0 && age < sleep_ns)
+				sleep_ns -= age;
+		}
+		if (first)
+			sleep_ns -= pcm->wakeup_margin;
+		if (sleep_ns < TIMER_WAKEUP_MIN_SLEEP)
+			sleep_ns = TIMER_WAKEUP_MIN_SLEEP;
+		if (limit) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (timespec_to_ns(&now) >= limit)
+				return 0;
+			if (limit - timespec_to_ns(&now) < sleep_ns)
+				sleep_ns = limit - timespec_to_ns(&now);
+		}
+		ts.tv_sec = sleep_ns / 1000000000LL;
+		ts.tv_nsec = sleep_ns % 1000000000LL;
+		first = 0;
+
 		__snd_pcm_unlock(pcm->fast_op_arg);
-		err_poll = poll(pfd, npfds, timeout);
+		err_poll = ppoll(pfd, npfds, &ts, NULL);
 		__snd_pcm_lock(pcm->fast_op_arg);
 		if (err_poll < 0) {
 			if (errno == EINTR && !PCMINABORT(pcm) && !(pcm->mode & SND_PCM_EINTR))
-		                continue;
+				continue;
 			return -errno;
-                }
-		if (! err_poll)
-			break;
+		}
+		snd_pcm_wakeup_new_seq();
+		if (!err_poll)
+			continue;
 		err = __snd_pcm_poll_revents(pcm, pfd, npfds, &revents);
 		if (err < 0)
 			return err;
 		if (revents & (POLLERR | POLLNVAL)) {
-			/* check more precisely */
 			err = pcm_state_to_error(__snd_pcm_state(pcm));
-			return err < 0 ? err : -EIO;
-		}
-	} while (!(revents & (POLLIN | POLLOUT)));
-#if 0 /* very useful code to test poll related problems */
-	{
-		snd_pcm_sframes_t avail_update;
-		__snd_pcm_hwsync(pcm);
-		avail_update = __snd_pcm_avail_update(pcm);
-		if (avail_update < (snd_pcm_sframes_t)pcm->avail_min) {
-			printf("*** snd_pcm_wait() FATAL ERROR!!!\n");
-			printf("avail_min = %li, avail_update = %li\n", pcm->avail_min, avail_update);
+			err = err < 0 ? err : -EIO;
+			goto error;
 		}
 	}
-#endif
-	return err_poll > 0 ? 1 : 0;
+
+ error:
+	if (err == -EPIPE) {
+		/* woken up too late, be more careful */
+		pcm->wakeup_margin = pcm->wakeup_margin * 2 + 1000000;
+		if (pcm->wakeup_margin > max_margin)
+			pcm->wakeup_margin = max_margin;
+	}
+	return err;
 }
 #endif
 
@@ -3051,8 +4063,16 @@ snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_sframes_t result;
 
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!snd_pcm_trylock(pcm->fast_op_arg)) {
+		if (!snap_get_avail(pcm->fast_op_arg, &result))
+			return result;
+		snd_pcm_lock(pcm->fast_op_arg);
+	}
 	result = __snd_pcm_avail_update(pcm);
+	if (result < 0)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
+	else
+		snap_publish(pcm->fast_op_arg, SND_PCM_SNAP_AVAIL, 0, result, 0);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return result;
 }
@@ -3087,6 +4107,10 @@ snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm)
 		result = err;
 	else
 		result = __snd_pcm_avail_update(pcm);
+	if (result < 0)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
+	else
+		snap_publish(pcm->fast_op_arg, SND_PCM_SNAP_AVAIL, 0, result, 0);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return result;
 }
@@ -3128,7 +4152,13 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 		goto unlock;
 	*availp = sf;
 	err = 0;
+	if (snap_enabled(pcm->fast_op_arg))
+		snap_publish(pcm->fast_op_arg, SND_PCM_SNAP_STATE |
+			     SND_PCM_SNAP_AVAIL | SND_PCM_SNAP_DELAY,
+			     __snd_pcm_state(pcm), sf, *delayp);
  unlock:
+	if (err < 0)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return err;
 }
@@ -3154,21 +4184,76 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 	width = snd_pcm_format_physical_width(format);
 	silence = snd_pcm_format_silence_64(format);
-        /*
-         * Iterate copying silent sample for sample data aligned to 64 bit.
-         * This is a fast path.
-         */
-        if (dst_area->step == (unsigned int) width &&
-            width != 24 &&
-            ((intptr_t)dst & 7) == 0) {
-		unsigned int dwords = samples * width / 64;
-		uint64_t *dstp = (uint64_t *)dst;
-		samples -= dwords * 64 / width;
-		while (dwords-- > 0)
-			*dstp++ = silence;
+	/*
+	 * Contiguous samples are a fast path: a memset() when the silence
+	 * is made of a repeated byte, otherwise 64 bit stores of the pattern
+	 * once the destination is aligned.
+	 */
+	if (dst_area->step == (unsigned int) width && width >= 8 &&
+	    (dst_area->first & 7) == 0) {
+		if (silence == (silence & 0xff) * 0x0101010101010101ULL) {
+			memset(dst, silence & 0xff, (size_t)samples * (width / 8));
+			return 0;
+		}
+		if (width == 24) {
+			/* 8 samples make 3 whole words */
+			unsigned int groups = samples / 8;
+			unsigned char pattern[24];
+			unsigned int i;
+
+			for (i = 0; i < 8; i++) {
+#ifdef SNDRV_LITTLE_ENDIAN
+				pattern[i * 3 + 0] = silence >> 0;
+				pattern[i * 3 + 1] = silence >> 8;
+				pattern[i * 3 + 2] = silence >> 16;
+#else
+				pattern[i * 3 + 2] = silence >> 0;
+				pattern[i * 3 + 1] = silence >> 8;
+				pattern[i * 3 + 0] = silence >> 16;
+#endif
+			}
+			samples -= groups * 8;
+			while (groups-- > 0) {
+				memcpy(dst, pattern, sizeof(pattern));
+				dst += sizeof(pattern);
+			}
+		} else if (((intptr_t)dst & (width / 8 - 1)) == 0) {
+			unsigned int dwords;
+			uint64_t *dstp;
+
+			/* the pattern repeats at each sample boundary */
+			while (((intptr_t)dst & 7) && samples) {
+				switch (width) {
+				case 16:
+					*(uint16_t *)dst = silence;
+					break;
+				case 32:
+					*(uint32_t *)dst = silence;
+					break;
+				default:
+					*dst = silence;
+					break;
+				}
+				dst += width / 8;
+				samples--;
+			}
+			dwords = samples * width / 64;
+			dstp = (uint64_t *)dst;
+			samples -= dwords * 64 / width;
+			while (dwords >= 4) {
+				dstp[0] = silence;
+				dstp[1] = silence;
+				dstp[2] = silence;
+				dstp[3] = silence;
+				dstp += 4;
+				dwords -= 4;
+			}
+			while (dwords-- > 0)
+				*dstp++ = silence;
+			dst = (char *)dstp;
+		}
 		if (samples == 0)
 			return 0;
-		dst = (char *)dstp;
 	}
 	dst_step = dst_area->step / 8;
 	switch (width) {
@@ -3417,6 +4502,218 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Stereo interleave / deinterleave kernels: one side holds both channels
+ * packed in each frame, the other one a contiguous run of samples per
+ * channel.  The SIMD loops are used when available, the scalar one does
+ * the rest.
+ */
+typedef void (*areas_transpose_t)(void *inter, void * const *planar,
+				  snd_pcm_uframes_t frames);
+
+static void interleave2_16(void *inter, void * const *planar,
+			   snd_pcm_uframes_t frames)
+{
+	const uint16_t *l = planar[0], *r = planar[1];
+	uint16_t *d = inter;
+	snd_pcm_uframes_t f = 0;
+
+#if defined(AREAS_SIMD_SSE2)
+	for (; f + 8 <= frames; f += 8, d += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(l + f));
+		__m128i b = _mm_loadu_si128((const __m128i *)(r + f));
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(a, b));
+		_mm_storeu_si128((__m128i *)(d + 8), _mm_unpackhi_epi16(a, b));
+	}
+#elif defined(AREAS_SIMD_NEON)
+	for (; f + 8 <= frames; f += 8, d += 16) {
+		uint16x8x2_t v = { { vld1q_u16(l + f), vld1q_u16(r + f) } };
+		vst2q_u16(d, v);
+	}
+#endif
+	for (; f < frames; f++) {
+		*d++ = l[f];
+		*d++ = r[f];
+	}
+}
+
+static void deinterleave2_16(void *inter, void * const *planar,
+			     snd_pcm_uframes_t frames)
+{
+	uint16_t *l = planar[0], *r = planar[1];
+	const uint16_t *s = inter;
+	snd_pcm_uframes_t f = 0;
+
+#if defined(AREAS_SIMD_SSE2)
+	for (; f + 8 <= frames; f += 8, s += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + 8));
+		/* sign extended halves pack back without saturation */
+		__m128i la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		__m128i lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		_mm_storeu_si128((__m128i *)(l + f), _mm_packs_epi32(la, lb));
+		_mm_storeu_si128((__m128i *)(r + f),
+				 _mm_packs_epi32(_mm_srai_epi32(a, 16),
+						 _mm_srai_epi32(b, 16)));
+	}
+#elif defined(AREAS_SIMD_NEON)
+	for (; f + 8 <= frames; f += 8, s += 16) {
+		uint16x8x2_t v = vld2q_u16(s);
+		vst1q_u16(l + f, v.val[0]);
+		vst1q_u16(r + f, v.val[1]);
+	}
+#endif
+	for (; f < frames; f++) {
+		l[f] = *s++;
+		r[f] = *s++;
+	}
+}
+
+static void interleave2_32(void *inter, void * const *planar,
+			   snd_pcm_uframes_t frames)
+{
+	const uint32_t *l = planar[0], *r = planar[1];
+	uint32_t *d = inter;
+	snd_pcm_uframes_t f = 0;
+
+#if defined(AREAS_SIMD_SSE2)
+	for (; f + 4 <= frames; f += 4, d += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(l + f));
+		__m128i b = _mm_loadu_si128((const __m128i *)(r + f));
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi32(a, b));
+		_mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi32(a, b));
+	}
+#elif defined(AREAS_SIMD_NEON)
+	for (; f + 4 <= frames; f += 4, d += 8) {
+		uint32x4x2_t v = { { vld1q_u32(l + f), vld1q_u32(r + f) } };
+		vst2q_u32(d, v);
+	}
+#endif
+	for (; f < frames; f++) {
+		*d++ = l[f];
+		*d++ = r[f];
+	}
+}
+
+static void deinterleave2_32(void *inter, void * const *planar,
+			     snd_pcm_uframes_t frames)
+{
+	uint32_t *l = planar[0], *r = planar[1];
+	const uint32_t *s = inter;
+	snd_pcm_uframes_t f = 0;
+
+#if defined(AREAS_SIMD_SSE2)
+	for (; f + 4 <= frames; f += 4, s += 8) {
+		/* the float shuffle only moves the bits around */
+		__m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)s));
+		__m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(s + 4)));
+		_mm_storeu_si128((__m128i *)(l + f),
+				 _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+		_mm_storeu_si128((__m128i *)(r + f),
+				 _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+	}
+#elif defined(AREAS_SIMD_NEON)
+	for (; f + 4 <= frames; f += 4, s += 8) {
+		uint32x4x2_t v = vld2q_u32(s);
+		vst1q_u32(l + f, v.val[0]);
+		vst1q_u32(r + f, v.val[1]);
+	}
+#endif
+	for (; f < frames; f++) {
+		l[f] = *s++;
+		r[f] = *s++;
+	}
+}
+
+/* the channels packed at consecutive offsets of one frame */
+static int areas_interleaved(const snd_pcm_channel_area_t *areas,
+			     unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	if (areas->step != channels * width || (areas->first & 7))
+		return 0;
+	for (c = 1; c < channels; c++) {
+		if (areas[c].addr != areas->addr ||
+		    areas[c].step != areas->step ||
+		    areas[c].first != areas->first + c * width)
+			return 0;
+	}
+	return 1;
+}
+
+/* one contiguous run of samples per channel */
+static int areas_planar(const snd_pcm_channel_area_t *areas,
+			unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		if (!areas[c].addr || areas[c].step != width ||
+		    (areas[c].first & 7))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * copy stereo between an interleaved and a non-interleaved layout in one
+ * pass instead of a strided pass per channel;
+ * returns -ENOSYS when the layouts don't qualify
+ */
+static int snd_pcm_areas_transpose(const snd_pcm_channel_area_t *dst_areas,
+				   snd_pcm_uframes_t dst_offset,
+				   const snd_pcm_channel_area_t *src_areas,
+				   snd_pcm_uframes_t src_offset,
+				   unsigned int channels,
+				   snd_pcm_uframes_t frames,
+				   unsigned int width)
+{
+	const snd_pcm_channel_area_t *inter_areas, *planar_areas;
+	snd_pcm_uframes_t inter_offset, planar_offset;
+	size_t inter_len, planar_len;
+	areas_transpose_t func;
+	void *planar[2];
+	char *inter;
+	unsigned int c;
+
+	if (channels != 2 || (width != 16 && width != 32))
+		return -ENOSYS;
+	if (!dst_areas->addr || !src_areas->addr)
+		return -ENOSYS;
+	if (areas_interleaved(dst_areas, channels, width) &&
+	    areas_planar(src_areas, channels, width)) {
+		func = width == 16 ? interleave2_16 : interleave2_32;
+		inter_areas = dst_areas;
+		inter_offset = dst_offset;
+		planar_areas = src_areas;
+		planar_offset = src_offset;
+	} else if (areas_interleaved(src_areas, channels, width) &&
+		   areas_planar(dst_areas, channels, width)) {
+		func = width == 16 ? deinterleave2_16 : deinterleave2_32;
+		inter_areas = src_areas;
+		inter_offset = src_offset;
+		planar_areas = dst_areas;
+		planar_offset = dst_offset;
+	} else {
+		return -ENOSYS;
+	}
+	inter = snd_pcm_channel_area_addr(inter_areas, inter_offset);
+	inter_len = (size_t)frames * channels * (width / 8);
+	planar_len = (size_t)frames * (width / 8);
+	for (c = 0; c < channels; c++) {
+		planar[c] = snd_pcm_channel_area_addr(&planar_areas[c], planar_offset);
+		/* not in place */
+		if ((char *)planar[c] < inter + inter_len &&
+		    inter < (char *)planar[c] + planar_len)
+			return -ENOSYS;
+	}
+	func(inter, planar, frames);
+	return 0;
+}
+#endif /* DOC_HIDDEN */
+
 /**
  * \brief Copy one or more areas
  * \param dst_areas destination areas specification (one for each channel)
@@ -3443,6 +4740,10 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 		SNDMSG("invalid frames %ld", frames);
 		return -EINVAL;
 	}
+	if (src_areas->step != dst_areas->step &&
+	    !snd_pcm_areas_transpose(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, width))
+		return 0;
 	while (channels > 0) {
 		unsigned int step = src_areas->step;
 		void *src_addr = src_areas->addr;
@@ -3983,6 +5284,7 @@ const unsigned char *snd_pcm_hw_params_get_sync(const snd_pcm_hw_params_t *param
 int snd_pcm_hw_params_any(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	_snd_pcm_hw_params_any(params);
+	snd_pcm_hw_refine_new_generation();
 	return snd_pcm_hw_refine(pcm, params);
 }
 
@@ -5055,6 +6357,13 @@ int snd_pcm_hw_params_get_export_buffer(snd_pcm_t *pcm, snd_pcm_hw_params_t *par
  * that could block on this device. The use of poll should be limited to error
  * cases. The application needs to use an external event or a timer to
  * check the state of the ring buffer and refill it apropriately.
+ * snd_pcm_wait() of a running stream does so itself: it sleeps until the
+ * avail is predicted to reach avail_min, as with
+ * #snd_pcm_sw_params_set_timer_wakeup().
+ *
+ * The flag is passed down a plugin chain to its hardware slave.  The direct
+ * plugins (dmix, dsnoop, dshare) support it per client whatever the
+ * hardware: the client does not get the wakeups of the shared timer.
  */
 int snd_pcm_hw_params_set_period_wakeup(snd_pcm_t *pcm, snd_pcm_hw_params_t *params, unsigned int val)
 {
@@ -6354,6 +7663,82 @@ int snd_pcm_hw_params_get_min_align(const snd_pcm_hw_params_t *params, snd_pcm_u
 	return 0;
 }
 
+/**
+ * \brief Restrict a configuration space with the common targets in one pass
+ * \param pcm PCM handle
+ * \param params Configuration space
+ * \param access access type
+ * \param format sample format
+ * \param channels channels count
+ * \param rate approximate rate / returned approximate set rate, may be NULL
+ * \param period_size approximate period size in frames / returned chosen approximate period size, may be NULL
+ * \param buffer_size approximate buffer size in frames / returned chosen approximate buffer size, may be NULL
+ * \return 0 otherwise a negative error code if configuration space would be empty
+ *
+ * The result is the same as calling snd_pcm_hw_params_set_access(),
+ * snd_pcm_hw_params_set_format(), snd_pcm_hw_params_set_channels(),
+ * snd_pcm_hw_params_set_rate_near(), snd_pcm_hw_params_set_period_size_near()
+ * and snd_pcm_hw_params_set_buffer_size_near() in this order, but each
+ * of those walks the whole plugin chain.  Here the exact targets are
+ * applied together and refined once; when the configuration space also
+ * contains the requested rate, period size and buffer size, they are
+ * fixed with a single further refine.  Only otherwise the nearest
+ * values are searched one by one.
+ *
+ * On error the configuration space is left unchanged.
+ */
+int snd_pcm_hw_params_set_batch(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+				snd_pcm_access_t access, snd_pcm_format_t format,
+				unsigned int channels, unsigned int *rate,
+				snd_pcm_uframes_t *period_size,
+				snd_pcm_uframes_t *buffer_size)
+{
+	snd_pcm_hw_params_t save = *params, exact;
+	unsigned int val;
+	int err;
+
+	if ((err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_ACCESS, access, 0)) < 0 ||
+	    (err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_FORMAT, format, 0)) < 0 ||
+	    (err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_CHANNELS, channels, 0)) < 0 ||
+	    (err = snd_pcm_hw_refine(pcm, params)) < 0)
+		goto _fail;
+
+	/* the usual case: all the targets are available as they are */
+	exact = *params;
+	if ((!rate || _snd_pcm_hw_param_set(&exact, SND_PCM_HW_PARAM_RATE, *rate, 0) >= 0) &&
+	    (!period_size || _snd_pcm_hw_param_set(&exact, SND_PCM_HW_PARAM_PERIOD_SIZE, *period_size, 0) >= 0) &&
+	    (!buffer_size || _snd_pcm_hw_param_set(&exact, SND_PCM_HW_PARAM_BUFFER_SIZE, *buffer_size, 0) >= 0) &&
+	    snd_pcm_hw_refine(pcm, &exact) >= 0) {
+		*params = exact;
+		return 0;
+	}
+
+	if (rate) {
+		err = snd_pcm_hw_param_set_near(pcm, params, SND_PCM_HW_PARAM_RATE, rate, NULL);
+		if (err < 0)
+			goto _fail;
+	}
+	if (period_size) {
+		val = *period_size;
+		err = snd_pcm_hw_param_set_near(pcm, params, SND_PCM_HW_PARAM_PERIOD_SIZE, &val, NULL);
+		if (err < 0)
+			goto _fail;
+		*period_size = val;
+	}
+	if (buffer_size) {
+		val = *buffer_size;
+		err = snd_pcm_hw_param_set_near(pcm, params, SND_PCM_HW_PARAM_BUFFER_SIZE, &val, NULL);
+		if (err < 0)
+			goto _fail;
+		*buffer_size = val;
+	}
+	return 0;
+
+ _fail:
+	*params = save;
+	return err;
+}
+
 #ifndef DOXYGEN
 void snd_pcm_sw_params_current_no_lock(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 {
@@ -6364,6 +7749,7 @@ void snd_pcm_sw_params_current_no_lock(snd_pcm_t *pcm, snd_pcm_sw_params_t *para
 	params->sleep_min = 0;
 	params->avail_min = pcm->avail_min;
 	sw_set_period_event(params, pcm->period_event);
+	sw_set_timer_wakeup(params, pcm->timer_wakeup);
 	params->xfer_align = 1;
 	params->start_threshold = pcm->start_threshold;
 	params->stop_threshold = pcm->stop_threshold;
@@ -6744,6 +8130,42 @@ int snd_pcm_sw_params_get_period_event(const snd_pcm_sw_params_t *params, int *v
 	return 0;
 }
 
+/**
+ * \brief Set timer driven wakeups inside a software configuration container
+ * \param pcm PCM handle
+ * \param params Software configuration container
+ * \param val 0 = wake up on the poll events only, 1 = wake up by a timer
+ * \return 0 otherwise a negative error code
+ *
+ * When enabled, snd_pcm_wait() of a running stream does not rely on the
+ * period wakeups: it predicts from snd_pcm_htimestamp() when the avail
+ * reaches avail_min and sleeps until then, minus a safety margin learned
+ * from how late the previous wakeups were.  The poll descriptors are still
+ * watched for errors and early wakeups.  This allows a large buffer with
+ * few periods (and with the period event disabled) to be refilled at any
+ * fill level, with about one wakeup per refill.  The timestamp mode should
+ * be enabled for the most precise predictions.
+ */
+int snd_pcm_sw_params_set_timer_wakeup(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, int val)
+{
+	assert(pcm && params);
+	sw_set_timer_wakeup(params, !!val);
+	return 0;
+}
+
+/**
+ * \brief Get timer driven wakeups from a software configuration container
+ * \param params Software configuration container
+ * \param val returned timer wakeup state
+ * \return 0 otherwise a negative error code
+ */
+int snd_pcm_sw_params_get_timer_wakeup(const snd_pcm_sw_params_t *params, int *val)
+{
+	assert(params && val);
+	*val = sw_get_timer_wakeup(params);
+	return 0;
+}
+
 /**
  * \brief (DEPRECATED) Set xfer align inside a software configuration container
  * \param pcm PCM handle
@@ -7435,6 +8857,59 @@ int snd_pcm_mmap_begin(snd_pcm_t *pcm,
 	return err;
 }
 
+/**
+ * \brief Application request to access both parts of a direct (mmap) area
+ * \param pcm PCM handle
+ * \param areas Returned mmap channel areas
+ * \param offset Returned mmap area offset in area steps (== frames)
+ * \param frames mmap area portion size in frames (wanted on entry, contiguous available from \p offset on exit)
+ * \param frames2 Returned count of frames available from the start of the areas
+ * \return 0 on success otherwise a negative error code
+ *
+ * Works like snd_pcm_mmap_begin(), but when the wanted frames wrap around
+ * the end of the ring buffer, the part following the wrap is returned too:
+ * \p frames2 frames from the offset 0 of the same areas.  \p frames2 is
+ * zero when nothing wraps, or when the PCM lends its areas in a special
+ * way (e.g. the file plugin).
+ *
+ * Both parts are finished with a single call of snd_pcm_mmap_commit()
+ * for up to \p frames + \p frames2 frames, instead of a second round of
+ * snd_pcm_mmap_begin() and snd_pcm_mmap_commit() at each wrap.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+int snd_pcm_mmap_begin2(snd_pcm_t *pcm,
+			const snd_pcm_channel_area_t **areas,
+			snd_pcm_uframes_t *offset,
+			snd_pcm_uframes_t *frames,
+			snd_pcm_uframes_t *frames2)
+{
+	snd_pcm_uframes_t want, avail;
+	int err;
+
+	assert(pcm && frames2);
+	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
+	if (err < 0)
+		return err;
+	want = *frames;
+	*frames2 = 0;
+	snd_pcm_lock(pcm->fast_op_arg);
+	err = __snd_pcm_mmap_begin(pcm, areas, offset, frames);
+	if (err >= 0 && !pcm->fast_ops->mmap_begin && *frames < want &&
+	    *offset + *frames == pcm->buffer_size) {
+		avail = snd_pcm_mmap_avail(pcm);
+		if (avail > pcm->buffer_size)
+			avail = pcm->buffer_size;
+		if (avail > *frames) {
+			*frames2 = avail - *frames;
+			if (*frames2 > want - *frames)
+				*frames2 = want - *frames;
+		}
+	}
+	snd_pcm_unlock(pcm->fast_op_arg);
+	return err;
+}
+
 #ifndef DOC_HIDDEN
 int __snd_pcm_mmap_begin_generic(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas,
 				 snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames)
@@ -7489,7 +8964,8 @@ int __snd_pcm_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas,
  * snd_pcm_mmap_begin() returned. The frames parameter should hold the
  * number of frames you have written or read to/from the audio
  * buffer. The frames parameter must never exceed the contiguous frames
- * count that snd_pcm_mmap_begin() returned. Each call to snd_pcm_mmap_begin()
+ * count that snd_pcm_mmap_begin() returned, or the sum of both parts
+ * returned by snd_pcm_mmap_begin2(). Each call to snd_pcm_mmap_begin()
  * must be followed by a call to snd_pcm_mmap_commit().
  *
  * Example:
@@ -7544,6 +9020,10 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
 	result = __snd_pcm_mmap_commit(pcm, offset, frames);
+	if (result > 0)
+		snap_xfer_add(pcm->fast_op_arg, result);
+	else if (result < 0)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return result;
 }
@@ -7565,10 +9045,20 @@ snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
 		       snd_pcm_mmap_avail(pcm));
 		return -EPIPE;
 	}
-	if (pcm->fast_ops->mmap_commit)
-		return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
-	else
+	if (!pcm->fast_ops->mmap_commit)
 		return -ENOSYS;
+	if (offset + frames > pcm->buffer_size) {
+		/* both parts of snd_pcm_mmap_begin2(), one after the other */
+		snd_pcm_uframes_t cont = pcm->buffer_size - offset;
+		snd_pcm_sframes_t result;
+
+		result = pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, cont);
+		if (result != (snd_pcm_sframes_t)cont)
+			return result;
+		result = pcm->fast_ops->mmap_commit(pcm->fast_op_arg, 0, frames - cont);
+		return result < 0 ? (snd_pcm_sframes_t)cont : (snd_pcm_sframes_t)(cont + result);
+	}
+	return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
 }
 
 int _snd_pcm_poll_descriptor(snd_pcm_t *pcm)
@@ -7674,11 +9164,14 @@ snd_pcm_sframes_t snd_pcm_read_areas(snd_pcm_t *pcm, const snd_pcm_channel_area_
 		if (err < 0)
 			break;
 		frames = err;
+		snap_xfer_add(pcm->fast_op_arg, frames);
 		offset += frames;
 		size -= frames;
 		xfer += frames;
 	}
  _end:
+	if (err < 0 && err != -EAGAIN)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	__snd_pcm_unlock(pcm->fast_op_arg);
 	return xfer > 0 ? (snd_pcm_sframes_t) xfer : snd_pcm_check_error(pcm, err);
 }
@@ -7751,6 +9244,7 @@ snd_pcm_sframes_t snd_pcm_write_areas(snd_pcm_t *pcm, const snd_pcm_channel_area
 		if (err < 0)
 			break;
 		frames = err;
+		snap_xfer_add(pcm->fast_op_arg, frames);
 		if (state == SND_PCM_STATE_PREPARED) {
 			snd_pcm_sframes_t hw_avail = pcm->buffer_size - avail;
 			hw_avail += frames;
@@ -7769,6 +9263,8 @@ snd_pcm_sframes_t snd_pcm_write_areas(snd_pcm_t *pcm, const snd_pcm_channel_area
 		xfer += frames;
 	}
  _end:
+	if (err < 0 && err != -EAGAIN)
+		snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	__snd_pcm_unlock(pcm->fast_op_arg);
 	return xfer > 0 ? (snd_pcm_sframes_t) xfer : snd_pcm_check_error(pcm, err);
 }
@@ -7930,6 +9426,130 @@ int snd_pcm_slave_conf(snd_config_t *root, snd_config_t *conf,
 		snd_config_delete(conf);
 	return err;
 }
+
+/* parse a CPU list like "0,2-3" into the affinity mask */
+static int thread_conf_cpus(snd_pcm_thread_conf_t *tc, const char *str)
+{
+	long first, last;
+	char *end;
+
+	memset(tc->cpus, 0, sizeof(tc->cpus));
+	tc->affinity = 0;
+	while (*str) {
+		first = strtol(str, &end, 10);
+		if (end == str || first < 0)
+			return -EINVAL;
+		last = first;
+		if (*end == '-') {
+			str = end + 1;
+			last = strtol(str, &end, 10);
+			if (end == str || last < first)
+				return -EINVAL;
+		}
+		if (last >= SND_PCM_THREAD_MAX_CPUS)
+			return -EINVAL;
+		for (; first <= last; first++)
+			tc->cpus[first / 8] |= 1 << (first % 8);
+		tc->affinity = 1;
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -EINVAL;
+		str = end;
+	}
+	return tc->affinity ? 0 : -EINVAL;
+}
+
+/*
+ * parse the scheduling fields of a helper thread:
+ *
+ *   thread_policy STR	# "other", "fifo" or "rr"
+ *   thread_priority INT	# the priority of "fifo" and "rr"
+ *   cpu_affinity INT or STR	# a CPU or a list like "0,2-3"
+ *
+ * returns 1 when the field was one of them, 0 otherwise
+ */
+int snd_pcm_thread_conf_parse(snd_pcm_thread_conf_t *tc, snd_config_t *n,
+			      const char *id)
+{
+	const char *str;
+	long val;
+	char buf[16];
+	int err;
+
+	if (strcmp(id, "thread_policy") == 0) {
+		err = snd_config_get_string(n, &str);
+		if (err < 0) {
+			SNDERR("Invalid type for %s", id);
+			return -EINVAL;
+		}
+		if (strcmp(str, "other") == 0)
+			tc->policy = SCHED_OTHER;
+		else if (strcmp(str, "fifo") == 0)
+			tc->policy = SCHED_FIFO;
+		else if (strcmp(str, "rr") == 0)
+			tc->policy = SCHED_RR;
+		else {
+			SNDERR("The field thread_policy must be other, fifo or rr");
+			return -EINVAL;
+		}
+		return 1;
+	}
+	if (strcmp(id, "thread_priority") == 0) {
+		err = snd_config_get_integer(n, &val);
+		if (err < 0 || val < 0 || val > 99) {
+			SNDERR("The field thread_priority must be in range 0-99");
+			return -EINVAL;
+		}
+		tc->priority = val;
+		return 1;
+	}
+	if (strcmp(id, "cpu_affinity") == 0) {
+		if (snd_config_get_integer(n, &val) >= 0) {
+			snprintf(buf, sizeof(buf), "%ld", val);
+			str = buf;
+		} else if (snd_config_get_string(n, &str) < 0) {
+			SNDERR("Invalid type for %s", id);
+			return -EINVAL;
+		}
+		if (thread_conf_cpus(tc, str) < 0) {
+			SNDERR("Invalid CPU list %s for %s", str, id);
+			return -EINVAL;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * apply the scheduling to the calling thread, the helpers call it when
+ * they start; a failure (e.g. no permission for a real-time policy) is
+ * reported and the thread goes on with the inherited scheduling
+ */
+void snd_pcm_thread_conf_apply(const snd_pcm_thread_conf_t *tc, const char *who)
+{
+	struct sched_param param;
+#ifdef CPU_SET
+	cpu_set_t set;
+	int cpu;
+
+	if (tc->affinity) {
+		CPU_ZERO(&set);
+		for (cpu = 0; cpu < SND_PCM_THREAD_MAX_CPUS; cpu++)
+			if (tc->cpus[cpu / 8] & (1 << (cpu % 8)))
+				CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) < 0)
+			SYSERR("%s: cannot set the CPU affinity", who);
+	}
+#endif
+	if (tc->policy < 0)
+		return;
+	memset(&param, 0, sizeof(param));
+	if (tc->policy != SCHED_OTHER)
+		param.sched_priority = tc->priority;
+	if (sched_setscheduler(0, tc->policy, &param) < 0)
+		SYSERR("%s: cannot set the scheduling policy", who);
+}
 		
 static void snd_pcm_set_ptr(snd_pcm_t *pcm, snd_pcm_rbptr_t *rbptr,
 			    volatile snd_pcm_uframes_t *hw_ptr, int fd, off_t offset)
@@ -103,23 +103,42 @@ static const short StepSize[89] = {
 	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
 };
 
-static char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
+/*
+ * The coders below avoid the data dependent branches: the codes of audio
+ * are close to random, so the branches would be mispredicted half of the
+ * time.  The callers pass a local copy of the channel state, which the
+ * compiler keeps in registers over the whole period.
+ */
+
+static inline int adpcm_clamp_sample(int val)
+{
+	val = val > 32767 ? 32767 : val;
+	return val < -32768 ? -32768 : val;
+}
+
+static inline int adpcm_clamp_index(int idx)
 {
-	short diff;		/* Difference between sl and predicted sample */
-	short pred_diff;	/* Predicted difference to next sample */
+	idx = idx < 0 ? 0 : idx;
+	return idx > 88 ? 88 : idx;
+}
+
+static inline char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
+{
+	int diff;		/* Difference between sl and predicted sample */
+	int pred_diff;		/* Predicted difference to next sample */
 
-	unsigned char sign;	/* sign of diff */
-	short step;		/* holds previous StepSize value */
-	unsigned char adjust_idx;	/* Index to IndexAdjust lookup table */
+	int sign;		/* sign of diff */
+	int step;		/* holds previous StepSize value */
+	int adjust_idx;		/* Index to IndexAdjust lookup table */
+	int mask;
 
 	int i;
 
 	/* Compute difference to previous predicted value */
-	diff = sl - state->pred_val;
-	sign = (diff < 0) ? 0x8 : 0x0;
-	if (sign) {
-		diff = -diff;
-	}
+	/* the short truncations of the original coder are kept */
+	diff = (short)(sl - state->pred_val);
+	sign = diff < 0 ? 0x8 : 0x0;
+	diff = (short)(diff < 0 ? -diff : diff);
 
 	/*
 	 * This code *approximately* computes:
@@ -136,41 +155,28 @@ static char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
 	/* Divide and clamp */
 	pred_diff = step >> 3;
 	for (adjust_idx = 0, i = 0x4; i; i >>= 1, step >>= 1) {
-		if (diff >= step) {
-			adjust_idx |= i;
-			diff -= step;
-			pred_diff += step;
-		}
+		mask = -(diff >= step);
+		adjust_idx |= i & mask;
+		diff -= step & mask;
+		pred_diff += step & mask;
 	}
 
 	/* Update and clamp previous predicted value */
-	state->pred_val += sign ? -pred_diff : pred_diff;
-
-	if (state->pred_val > 32767) {
-		state->pred_val = 32767;
-	} else if (state->pred_val < -32768) {
-		state->pred_val = -32768;
-	}
+	pred_diff = (short)pred_diff;
+	state->pred_val = adpcm_clamp_sample(state->pred_val +
+					     (sign ? -pred_diff : pred_diff));
 
 	/* Update and clamp StepSize lookup table index */
-	state->step_idx += IndexAdjust[adjust_idx];
-
-	if (state->step_idx < 0) {
-		state->step_idx = 0;
-	} else if (state->step_idx > 88) {
-		state->step_idx = 88;
-	}
+	state->step_idx = adpcm_clamp_index(state->step_idx + IndexAdjust[adjust_idx]);
 	return (sign | adjust_idx);
 }
 
 
-static int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
+static inline int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
 {
-	short pred_diff;	/* Predicted difference to next sample */
-	short step;		/* holds previous StepSize value */
-	char sign;
-
-	int i;
+	int pred_diff;		/* Predicted difference to next sample */
+	int step;		/* holds previous StepSize value */
+	int sign;
 
 	/* Separate sign and magnitude */
 	sign = code & 0x8;
@@ -184,29 +190,16 @@ static int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
 	step = StepSize[state->step_idx];
 
 	/* Compute difference and new predicted value */
-	pred_diff = step >> 3;
-	for (i = 0x4; i; i >>= 1, step >>= 1) {
-		if (code & i) {
-			pred_diff += step;
-		}
-	}
-	state->pred_val += (sign) ? -pred_diff : pred_diff;
-
-	/* Clamp output value */
-	if (state->pred_val > 32767) {
-		state->pred_val = 32767;
-	} else if (state->pred_val < -32768) {
-		state->pred_val = -32768;
-	}
+	pred_diff = (step >> 3) +
+		    (step & -((code >> 2) & 1)) +
+		    ((step >> 1) & -((code >> 1) & 1)) +
+		    ((step >> 2) & -(code & 1));
+	pred_diff = (short)pred_diff;
+	state->pred_val = adpcm_clamp_sample(state->pred_val +
+					     (sign ? -pred_diff : pred_diff));
 
 	/* Find new StepSize index value */
-	state->step_idx += IndexAdjust[code];
-
-	if (state->step_idx < 0) {
-		state->step_idx = 0;
-	} else if (state->step_idx > 88) {
-		state->step_idx = 88;
-	}
+	state->step_idx = adpcm_clamp_index(state->step_idx + IndexAdjust[code]);
 	return (state->pred_val);
 }
 
@@ -224,6 +217,7 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
+	snd_pcm_adpcm_state_t state;
 	unsigned int channel;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
@@ -241,6 +235,7 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
+		state = *states;
 		while (frames1-- > 0) {
 			int16_t sample;
 			unsigned char v;
@@ -248,7 +243,7 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 				v = *src & 0x0f;
 			else
 				v = (*src >> 4) & 0x0f;
-			sample = adpcm_decoder(v, states);
+			sample = adpcm_decoder(v, &state);
 			goto *put;
 #define PUT16_END after
 #include "plugin_ops.h"
@@ -262,6 +257,7 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 			}
 			dst += dst_step;
 		}
+		*states = state;
 	}
 }
 
@@ -277,6 +273,7 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef GET16_LABELS
 	void *get = get16_labels[getidx];
+	snd_pcm_adpcm_state_t state;
 	unsigned int channel;
 	int16_t sample = 0;
 	for (channel = 0; channel < channels; ++channel, ++states) {
@@ -295,6 +292,7 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 		dst_step = dst_area->step / 8;
 		dstbit_step = dst_area->step % 8;
 		frames1 = frames;
+		state = *states;
 		while (frames1-- > 0) {
 			int v;
 			goto *get;
@@ -302,7 +300,7 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef GET16_END
 		after:
-			v = adpcm_encoder(sample, states);
+			v = adpcm_encoder(sample, &state);
 			if (dstbit)
 				*dst = (*dst & 0xf0) | v;
 			else
@@ -315,6 +313,7 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 				dstbit = 0;
 			}
 		}
+		*states = state;
 	}
 }
 
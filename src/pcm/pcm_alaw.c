@@ -56,21 +56,14 @@ typedef struct {
 
 #endif
 
+/*
+ * Segment of a magnitude (0x100 - 0x7fff), one more than the position
+ * of its leading one above bit 8.  The magnitudes below 0x100 give 1,
+ * the shift of their quantization bits.
+ */
 static inline int val_seg(int val)
 {
-	int r = 1;
-	val >>= 8;
-	if (val & 0xf0) {
-		val >>= 4;
-		r += 4;
-	}
-	if (val & 0x0c) {
-		val >>= 2;
-		r += 2;
-	}
-	if (val & 0x02)
-		r += 1;
-	return r;
+	return 32 - __builtin_clz((val >> 8) | 1);
 }
 
 /*
@@ -99,44 +92,68 @@ static unsigned char s16_to_alaw(int pcm_val)
 	int		seg;
 	unsigned char	aval;
 
-	if (pcm_val >= 0) {
-		mask = 0xD5;
-	} else {
-		mask = 0x55;
-		pcm_val = -pcm_val;
-		if (pcm_val > 0x7fff)
-			pcm_val = 0x7fff;
-	}
+	/* the signs are random in audio, keep this free of branches */
+	mask = pcm_val >= 0 ? 0xD5 : 0x55;
+	pcm_val = pcm_val >= 0 ? pcm_val : -pcm_val;
+	pcm_val = pcm_val > 0x7fff ? 0x7fff : pcm_val;
 
-	if (pcm_val < 256)
-		aval = pcm_val >> 4;
-	else {
-		/* Convert the scaled magnitude to segment number. */
-		seg = val_seg(pcm_val);
-		aval = (seg << 4) | ((pcm_val >> (seg + 3)) & 0x0f);
-	}
+	/* Convert the scaled magnitude to segment number. */
+	seg = val_seg(pcm_val);
+	aval = ((pcm_val < 256 ? 0 : seg) << 4) | ((pcm_val >> (seg + 3)) & 0x0f);
 	return aval ^ mask;
 }
 
 /*
  * alaw_to_s16() - Convert an A-law value to 16-bit linear PCM
  *
+ * The table holds the results of all the 256 code words:
+ *
+ *	a_val ^= 0x55;
+ *	t = a_val & 0x7f;
+ *	if (t < 16)
+ *		t = (t << 4) + 8;
+ *	else
+ *		t = (((t & 0x0f) << 4) + 0x108) << (((t >> 4) & 0x07) - 1);
+ *	return (a_val & 0x80) ? t : -t;
  */
-static int alaw_to_s16(unsigned char a_val)
-{
-	int		t;
-	int		seg;
+static const int16_t alaw_to_s16_table[256] = {
+	-5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736,
+	-7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784,
+	-2752, -2624, -3008, -2880, -2240, -2112, -2496, -2368,
+	-3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392,
+	-22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
+	-30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
+	-11008, -10496, -12032, -11520, -8960, -8448, -9984, -9472,
+	-15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
+	-344, -328, -376, -360, -280, -264, -312, -296,
+	-472, -456, -504, -488, -408, -392, -440, -424,
+	-88, -72, -120, -104, -24, -8, -56, -40,
+	-216, -200, -248, -232, -152, -136, -184, -168,
+	-1376, -1312, -1504, -1440, -1120, -1056, -1248, -1184,
+	-1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696,
+	-688, -656, -752, -720, -560, -528, -624, -592,
+	-944, -912, -1008, -976, -816, -784, -880, -848,
+	5504, 5248, 6016, 5760, 4480, 4224, 4992, 4736,
+	7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784,
+	2752, 2624, 3008, 2880, 2240, 2112, 2496, 2368,
+	3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392,
+	22016, 20992, 24064, 23040, 17920, 16896, 19968, 18944,
+	30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136,
+	11008, 10496, 12032, 11520, 8960, 8448, 9984, 9472,
+	15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568,
+	344, 328, 376, 360, 280, 264, 312, 296,
+	472, 456, 504, 488, 408, 392, 440, 424,
+	88, 72, 120, 104, 24, 8, 56, 40,
+	216, 200, 248, 232, 152, 136, 184, 168,
+	1376, 1312, 1504, 1440, 1120, 1056, 1248, 1184,
+	1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696,
+	688, 656, 752, 720, 560, 528, 624, 592,
+	944, 912, 1008, 976, 816, 784, 880, 848,
+};
 
-	a_val ^= 0x55;
-	t = a_val & 0x7f;
-	if (t < 16)
-		t = (t << 4) + 8;
-	else {
-		seg = (t >> 4) & 0x07;
-		t = ((t & 0x0f) << 4) + 0x108;
-		t <<= seg -1;
-	}
-	return ((a_val & 0x80) ? t : -t);
+static inline int alaw_to_s16(unsigned char a_val)
+{
+	return alaw_to_s16_table[a_val];
 }
 
 #ifndef DOC_HIDDEN
@@ -39,8 +39,16 @@
 #include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 #include "pcm_direct.h"
 
+#define SNDRV_FILE_TIMER	ALSA_DEVICE_DIRECTORY "timer"
+
 /*
  *
  */
@@ -154,6 +162,29 @@ retryget:
 	return 0;
 }
 
+/*
+ * fault in the pages of a shared area in advance (prefault option),
+ * so that the first accesses from the mixing path do not have to wait
+ * for the page allocation; mlock() does the same, but it is limited by
+ * RLIMIT_MEMLOCK for the normal users
+ */
+void snd_pcm_direct_prefault(snd_pcm_direct_t *dmix, const void *ptr, size_t size)
+{
+	const volatile char *p = ptr;
+	long page_size;
+	size_t ofs;
+
+	if (!dmix->prefault || ptr == (void *) -1)
+		return;
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		page_size = 4096;
+	for (ofs = 0; ofs < size; ofs += page_size)
+		(void)p[ofs];
+	if (size)
+		(void)p[size - 1];
+}
+
 /* discard shared memory */
 /*
  * Define snd_* functions to be used in server.
@@ -265,6 +296,18 @@ static int make_local_socket(const char *filename, int server, mode_t ipc_perm,
 #define server_printf(fmt, args...) /* nothing */
 #endif
 
+/* accesses of the shared statistics, see the client statistics below */
+#ifdef HAVE_GCC_ATOMICS
+#define stats_load(p)		__atomic_load_n(p, __ATOMIC_RELAXED)
+#define stats_store(p, v)	__atomic_store_n(p, v, __ATOMIC_RELAXED)
+#else
+#define stats_load(p)		(*(volatile __typeof__(*(p)) *)(p))
+#define stats_store(p, v)	(*(volatile __typeof__(*(p)) *)(p) = (v))
+#endif
+/* no libatomic for the 64-bit counters, a torn read is fine */
+#define stats_load64(p)		(*(volatile unsigned long long *)(p))
+#define stats_store64(p, v)	(*(volatile unsigned long long *)(p) = (v))
+
 static snd_pcm_direct_t *server_job_dmix;
 
 static void server_cleanup(snd_pcm_direct_t *dmix)
@@ -320,13 +363,108 @@ static int _snd_send_fd(int sock, void *data, size_t len, int fd)
 	return ret;
 }
 
-static void server_job(snd_pcm_direct_t *dmix)
+#ifdef HAVE_SYS_EVENTFD_H
+/*
+ * Open the slave PCM timer for the shared wakeups; the timer is read
+ * only by the server and each tick is forwarded to the clients.
+ * Plain ioctls are used, only the file descriptor is passed to the
+ * server job.
+ */
+static int server_open_timer(snd_pcm_direct_t *dmix)
+{
+	struct snd_timer_select sel;
+	struct snd_timer_params params;
+	snd_pcm_info_t info = {0};
+	int fd, ver = 0, arg = 1;
+
+	if (snd_pcm_info(dmix->spcm, &info) < 0)
+		return -1;
+	fd = open(SNDRV_FILE_TIMER, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	if (ioctl(fd, SNDRV_TIMER_IOCTL_PVERSION, &ver) < 0 ||
+	    ver < SNDRV_PROTOCOL_VERSION(2, 0, 6))
+		goto __error;
+	/* the events are passed, clients check the state on wakeup */
+	if (ioctl(fd, SNDRV_TIMER_IOCTL_TREAD, &arg) < 0)
+		goto __error;
+	memset(&sel, 0, sizeof(sel));
+	sel.id.dev_class = SND_TIMER_CLASS_PCM;
+	sel.id.dev_sclass = SND_TIMER_SCLASS_NONE;
+	sel.id.card = snd_pcm_info_get_card(&info);
+	sel.id.device = snd_pcm_info_get_device(&info);
+	sel.id.subdevice = snd_pcm_info_get_subdevice(&info) * 2 +
+			   (dmix->type == SND_PCM_TYPE_DSNOOP ? 1 : 0);
+	if (ioctl(fd, SNDRV_TIMER_IOCTL_SELECT, &sel) < 0)
+		goto __error;
+	memset(&params, 0, sizeof(params));
+	params.flags = SNDRV_TIMER_PSFLG_AUTO;
+	if (dmix->type != SND_PCM_TYPE_DSNOOP)
+		params.flags |= SNDRV_TIMER_PSFLG_EARLY_EVENT;
+	params.ticks = 1;
+	params.filter = (1<<SND_TIMER_EVENT_TICK) |
+			(1<<SND_TIMER_EVENT_MSUSPEND) |
+			(1<<SND_TIMER_EVENT_MRESUME) |
+			(1<<SND_TIMER_EVENT_MSTOP) |
+			(1<<SND_TIMER_EVENT_STOP);
+	if (ioctl(fd, SNDRV_TIMER_IOCTL_PARAMS, &params) < 0)
+		goto __error;
+	if (ioctl(fd, SNDRV_TIMER_IOCTL_START) < 0)
+		goto __error;
+	return fd;
+
+ __error:
+	close(fd);
+	return -1;
+}
+
+static void server_wakeup_clients(snd_pcm_direct_t *dmix, int timer_fd,
+				  int *wakeup_fds, int count)
+{
+	snd_pcm_direct_stage_stats_t *st = &dmix->shmptr->stats.server;
+	snd_htimestamp_t start, now;
+	char buf[256];
+	int i;
+
+	gettimestamp(&start, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	while (read(timer_fd, buf, sizeof(buf)) > 0)
+		;
+	for (i = 0; i < count; i++)
+		if (wakeup_fds[i] >= 0)
+			eventfd_write(wakeup_fds[i], 1);
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	stats_store64(&st->transfers, st->transfers + 1);
+	stats_store64(&st->nsec, st->nsec + (now.tv_sec - start.tv_sec) * 1000000000LL +
+		      (now.tv_nsec - start.tv_nsec));
+}
+#endif
+
+static int server_last_user(snd_pcm_direct_t *dmix)
+{
+	struct shmid_ds buf;
+
+	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+	if (shmctl(dmix->shmid, IPC_STAT, &buf) < 0) {
+		_snd_pcm_direct_shm_discard(dmix);
+		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+		return 0;
+	}
+	server_printf("DIRECT SERVER: nattch = %i\n", (int)buf.shm_nattch);
+	if (buf.shm_nattch == 1)	/* server is the last user, exit */
+		return 1;
+	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+	return 0;
+}
+
+static void server_job(snd_pcm_direct_t *dmix, int timer_fd)
 {
 	int ret, sck, i;
 	int max = 128, current = 0;
-	struct pollfd pfds[max + 1];
+	struct pollfd pfds[max + 2];
+	int wakeup_fds[max];
 
 	server_job_dmix = dmix;
+	snd_pcm_thread_conf_apply(&dmix->thread_conf, "direct server");
 	/* don't allow to be killed */
 	signal(SIGHUP, server_job_signal);
 	signal(SIGQUIT, server_job_signal);
@@ -339,7 +477,7 @@ static void server_job(snd_pcm_direct_t *dmix)
 #else
 	while (--i >= 0) {
 #endif
-		if (i != dmix->server_fd && i != dmix->hw_fd)
+		if (i != dmix->server_fd && i != dmix->hw_fd && i != timer_fd)
 			close(i);
 	}
 	
@@ -348,10 +486,16 @@ static void server_job(snd_pcm_direct_t *dmix)
 
 	pfds[0].fd = dmix->server_fd;
 	pfds[0].events = POLLIN | POLLERR | POLLHUP;
+	pfds[1].fd = -1;
+	pfds[1].events = POLLIN;
 
 	server_printf("DIRECT SERVER STARTED\n");
 	while (1) {
-		ret = poll(pfds, current + 1, 500);
+		/* the timer is not watched without clients, so that
+		 * the poll timeout can detect the last user
+		 */
+		pfds[1].fd = current > 0 ? timer_fd : -1;
+		ret = poll(pfds, current + 2, 500);
 		server_printf("DIRECT SERVER: poll ret = %i, revents[0] = 0x%x, errno = %i\n", ret, pfds[0].revents, errno);
 		if (ret < 0) {
 			if (errno == EINTR)
@@ -360,19 +504,16 @@ static void server_job(snd_pcm_direct_t *dmix)
 			break;
 		}
 		if (ret == 0 || (pfds[0].revents & (POLLERR | POLLHUP))) {	/* timeout or error? */
-			struct shmid_ds buf;
-			snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
-			if (shmctl(dmix->shmid, IPC_STAT, &buf) < 0) {
-				_snd_pcm_direct_shm_discard(dmix);
-				snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
-				continue;
-			}
-			server_printf("DIRECT SERVER: nattch = %i\n", (int)buf.shm_nattch);
-			if (buf.shm_nattch == 1)	/* server is the last user, exit */
+			if (server_last_user(dmix))
 				break;
-			snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 			continue;
 		}
+#ifdef HAVE_SYS_EVENTFD_H
+		if (pfds[1].revents & POLLIN) {
+			ret--;
+			server_wakeup_clients(dmix, timer_fd, wakeup_fds, current);
+		}
+#endif
 		if (pfds[0].revents & POLLIN) {
 			ret--;
 			sck = accept(dmix->server_fd, 0, 0);
@@ -382,16 +523,25 @@ static void server_job(snd_pcm_direct_t *dmix)
 					close(sck);
 				} else {
 					unsigned char buf = 'A';
-					pfds[current+1].fd = sck;
-					pfds[current+1].events = POLLIN | POLLERR | POLLHUP;
+					pfds[current+2].fd = sck;
+					pfds[current+2].events = POLLIN | POLLERR | POLLHUP;
 					_snd_send_fd(sck, &buf, 1, dmix->hw_fd);
 					server_printf("DIRECT SERVER: fd sent ok\n");
+					wakeup_fds[current] = -1;
+#ifdef HAVE_SYS_EVENTFD_H
+					if (timer_fd >= 0) {
+						buf = 'W';
+						wakeup_fds[current] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+						if (wakeup_fds[current] >= 0)
+							_snd_send_fd(sck, &buf, 1, wakeup_fds[current]);
+					}
+#endif
 					current++;
 				}
 			}
 		}
 		for (i = 0; i < current && ret > 0; i++) {
-			struct pollfd *pfd = &pfds[i+1];
+			struct pollfd *pfd = &pfds[i+2];
 			unsigned char cmd;
 			server_printf("client %i revents = 0x%x\n", pfd->fd, pfd->revents);
 			if (pfd->revents & (POLLERR | POLLHUP)) {
@@ -406,12 +556,16 @@ static void server_job(snd_pcm_direct_t *dmix)
 			if (read(pfd->fd, &cmd, 1) == 1)
 				cmd = 0 /*process command */;
 		}
-		for (i = 0; i < current; i++) {
-			if (pfds[i+1].fd < 0) {
-				if (i + 1 != max)
-					memcpy(&pfds[i+1], &pfds[i+2], sizeof(struct pollfd) * (max - i - 1));
-				current--;
+		for (i = 0; i < current; ) {
+			if (pfds[i+2].fd >= 0) {
+				i++;
+				continue;
 			}
+			if (wakeup_fds[i] >= 0)
+				close(wakeup_fds[i]);
+			memmove(&pfds[i+2], &pfds[i+3], sizeof(struct pollfd) * (current - i - 1));
+			memmove(&wakeup_fds[i], &wakeup_fds[i+1], sizeof(int) * (current - i - 1));
+			current--;
 		}
 	}
 	server_cleanup(dmix);
@@ -424,7 +578,7 @@ static void server_job(snd_pcm_direct_t *dmix)
 
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 {
-	int ret;
+	int ret, timer_fd = -1;
 
 	dmix->server_fd = -1;
 
@@ -442,19 +596,31 @@ int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 		close(dmix->server_fd);
 		return ret;
 	}
+
+#ifdef HAVE_SYS_EVENTFD_H
+	if (dmix->shmptr->shared_wakeup)
+		timer_fd = server_open_timer(dmix);
+#endif
+	/* fall back to the per-client timers */
+	if (timer_fd < 0)
+		dmix->shmptr->shared_wakeup = 0;
 	
 	ret = fork();
 	if (ret < 0) {
 		close(dmix->server_fd);
+		if (timer_fd >= 0)
+			close(timer_fd);
 		return ret;
 	} else if (ret == 0) {
 		ret = fork();
 		if (ret == 0)
-			server_job(dmix);
+			server_job(dmix, timer_fd);
 		_exit(EXIT_SUCCESS);
 	} else {
 		waitpid(ret, NULL, 0);
 	}
+	if (timer_fd >= 0)
+		close(timer_fd);
 	dmix->server_pid = ret;
 	dmix->server = 1;
 	return 0;
@@ -500,12 +666,49 @@ int snd_pcm_direct_client_connect(snd_pcm_direct_t *dmix)
 	return 0;
 }
 
+/*
+ * receive the eventfd used for the shared wakeups; the first instance
+ * connects to its own server here
+ */
+static int snd_pcm_direct_wakeup_connect(snd_pcm_direct_t *dmix)
+{
+	int ret, fd;
+	unsigned char buf;
+
+	if (!dmix->client) {
+		ret = make_local_socket(dmix->shmptr->socket_name, 0, -1, -1);
+		if (ret < 0)
+			return ret;
+		dmix->comm_fd = ret;
+		dmix->client = 1;
+		ret = snd_receive_fd(dmix->comm_fd, &buf, 1, &fd);
+		if (ret < 1)
+			return ret < 0 ? ret : -EIO;
+		/* the slave is already opened */
+		if (fd >= 0)
+			close(fd);
+	}
+	ret = snd_receive_fd(dmix->comm_fd, &buf, 1, &fd);
+	if (ret < 1 || fd < 0)
+		return ret < 0 ? ret : -EIO;
+	dmix->shared_wakeup = 1;
+	dmix->timer_fd.fd = fd;
+	dmix->timer_fd.events = POLLIN;
+	dmix->poll_fd = fd;
+	return 0;
+}
+
 int snd_pcm_direct_client_discard(snd_pcm_direct_t *dmix)
 {
 	if (dmix->client) {
 		close(dmix->comm_fd);
 		dmix->comm_fd = -1;
 	}
+	if (dmix->shared_wakeup) {
+		close(dmix->poll_fd);
+		dmix->poll_fd = -1;
+		dmix->shared_wakeup = 0;
+	}
 	return 0;
 }
 
@@ -522,6 +725,8 @@ int snd_pcm_direct_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIB
 int snd_pcm_direct_async(snd_pcm_t *pcm, int sig, pid_t pid)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
+	if (dmix->shared_wakeup || dmix->period_timer)
+		return -ENOSYS;
 	return snd_timer_async(dmix->timer, sig, pid);
 }
 
@@ -529,13 +734,25 @@ int snd_pcm_direct_async(snd_pcm_t *pcm, int sig, pid_t pid)
 int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 {
 	int changed = 0;
+#ifdef HAVE_SYS_EVENTFD_H
+	if (dmix->shared_wakeup) {
+		eventfd_t val;
+		/* a single read resets the counter */
+		return eventfd_read(dmix->poll_fd, &val) == 0;
+	}
+#endif
+	if (dmix->period_timer) {
+		uint64_t expired;
+		/* the expiration counter is reset by a read */
+		return read(dmix->poll_fd, &expired, sizeof(expired)) > 0;
+	}
 	if (dmix->timer_need_poll) {
 		while (poll(&dmix->timer_fd, 1, 0) > 0) {
 			changed++;
 			/* we don't need the value */
 			if (dmix->tread) {
-				snd_timer_tread_t rbuf[4];
-				snd_timer_read(dmix->timer, rbuf, sizeof(rbuf));
+				snd_timer_tread_t rbuf[16];
+				snd_timer_read_events(dmix->timer, rbuf, ARRAY_SIZE(rbuf));
 			} else {
 				snd_timer_read_t rbuf;
 				snd_timer_read(dmix->timer, &rbuf, sizeof(rbuf));
@@ -543,13 +760,15 @@ int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 		}
 	} else {
 		if (dmix->tread) {
-			snd_timer_tread_t rbuf[4];
-			int len;
-			while ((len = snd_timer_read(dmix->timer, rbuf,
-						     sizeof(rbuf))) > 0
-						     && (++changed) &&
-			       len != sizeof(rbuf[0]))
-				;
+			snd_timer_tread_t rbuf[16];
+			int n;
+			/* a short batch means the queue is empty */
+			while ((n = snd_timer_read_events(dmix->timer, rbuf,
+							  ARRAY_SIZE(rbuf))) > 0) {
+				changed++;
+				if (n < (int)ARRAY_SIZE(rbuf))
+					break;
+			}
 		} else {
 			snd_timer_read_t rbuf;
 			while (snd_timer_read(dmix->timer, &rbuf, sizeof(rbuf)) > 0)
@@ -559,12 +778,65 @@ int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 	return changed;
 }
 
+#ifdef HAVE_SYS_TIMERFD_H
+/* arm the client timer to expire every period_ns, 0 disarms it */
+static int period_timer_arm(snd_pcm_direct_t *dmix, unsigned long long period_ns)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = period_ns / 1000000000;
+	its.it_value.tv_nsec = period_ns % 1000000000;
+	its.it_interval = its.it_value;
+	if (timerfd_settime(dmix->poll_fd, 0, &its, NULL) < 0)
+		return -errno;
+	return 0;
+}
+#else
+static int period_timer_arm(snd_pcm_direct_t *dmix ATTRIBUTE_UNUSED,
+			    unsigned long long period_ns ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+#endif
+
+/*
+ * with the shared wakeups the timer is owned by the server, a client
+ * without the period wakeups leaves it stopped and snd_pcm_wait() of
+ * the client sleeps on a prediction of avail instead
+ */
+int snd_pcm_direct_timer_start(snd_pcm_direct_t *dmix)
+{
+	if (dmix->shared_wakeup || dmix->client_no_wakeup)
+		return 0;
+	if (dmix->period_timer)
+		return period_timer_arm(dmix, dmix->timer_period_ns);
+	return snd_timer_start(dmix->timer);
+}
+
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix)
 {
+	if (dmix->shared_wakeup)
+		return 0;
+	if (dmix->period_timer)
+		return period_timer_arm(dmix, 0);
 	snd_timer_stop(dmix->timer);
 	return 0;
 }
 
+/* close the timer the poll_fd is taken from */
+void snd_pcm_direct_timer_discard(snd_pcm_direct_t *dmix)
+{
+	if (dmix->timer) {
+		snd_timer_close(dmix->timer);
+		dmix->timer = NULL;
+	}
+	if (dmix->period_timer && dmix->poll_fd >= 0) {
+		close(dmix->poll_fd);
+		dmix->poll_fd = -1;
+	}
+}
+
 #define RECOVERIES_FLAG_SUSPENDED	(1U << 31)
 #define RECOVERIES_MASK			((1U << 31) - 1)
 
@@ -701,6 +973,7 @@ int snd_pcm_direct_check_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm)
 			return -ESTRPIPE;
 		} else {
 			direct->state = SND_PCM_STATE_XRUN;
+			snd_pcm_direct_stats_update(pcm, direct);
 			return -EPIPE;
 		}
 	}
@@ -922,7 +1195,7 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			return -EINVAL;
 		}
 		if (snd_mask_refine_set(hw_param_mask(params, SND_PCM_HW_PARAM_FORMAT),
-					dshare->shmptr->hw.format))
+					snd_pcm_direct_client_format(dshare)))
 			params->cmask |= 1<<SND_PCM_HW_PARAM_FORMAT;
 	}
 	//snd_mask_none(hw_param_mask(params, SND_PCM_HW_PARAM_SUBFORMAT));
@@ -966,14 +1239,31 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				    (1<<SND_PCM_HW_PARAM_PERIOD_BYTES))) {
 		snd_interval_t period_size = dshare->shmptr->hw.period_size;
 		snd_interval_t period_time = dshare->shmptr->hw.period_time;
+		snd_pcm_uframes_t min_period = dshare->slave_period_size;
 		int changed;
-		unsigned int max_periods = dshare->max_periods;
+		unsigned int max_periods;
+
+		if (dshare->period_timer) {
+			/* the client timer allows periods below the slave one */
+			min_period = dshare->shmptr->s.rate * DIRECT_MIN_PERIOD_TIME / 1000000;
+			if (min_period < 1)
+				min_period = 1;
+			if (period_size.min > min_period) {
+				period_size.min = min_period;
+				period_size.openmin = 0;
+			}
+			if (period_time.min > DIRECT_MIN_PERIOD_TIME) {
+				period_time.min = DIRECT_MIN_PERIOD_TIME;
+				period_time.openmin = 0;
+			}
+		}
+		max_periods = dshare->max_periods;
 		if (max_periods < 2)
-			max_periods = dshare->slave_buffer_size / dshare->slave_period_size;
+			max_periods = dshare->slave_buffer_size / min_period;
 
 		/* make sure buffer size does not exceed slave buffer size */
 		err = hw_param_interval_refine_minmax(params, SND_PCM_HW_PARAM_BUFFER_SIZE,
-					2 * dshare->slave_period_size, dshare->slave_buffer_size);
+					2 * min_period, dshare->slave_buffer_size);
 		if (err < 0)
 			return err;
 		if (dshare->var_periodsize) {
@@ -1007,6 +1297,9 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			if (err < 0)
 				return err;
 			changed |= err;
+			/* the slave timer ticks only at the slave period boundaries */
+			if (dshare->period_timer)
+				continue;
 			err = snd_interval_step(hw_param_interval(params, SND_PCM_HW_PARAM_PERIOD_SIZE),
 								0, dshare->slave_period_size);
 			if (err < 0)
@@ -1019,6 +1312,8 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	dshare->timer_ticks = hw_param_interval(params, SND_PCM_HW_PARAM_PERIOD_SIZE)->max / dshare->slave_period_size;
 	params->info = dshare->shmptr->s.info;
 	params->info &= ~(SND_PCM_INFO_RESUME | SND_PCM_INFO_PAUSE);
+	/* the wakeups of each client are ours, see snd_pcm_direct_timer_start() */
+	params->info |= SND_PCM_INFO_NO_PERIOD_WAKEUP;
 #ifdef REFINE_DEBUG
 	snd_output_puts(log, "DMIX REFINE (end):\n");
 	snd_pcm_hw_params_dump(params, log);
@@ -1033,10 +1328,19 @@ int snd_pcm_direct_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 
 	params->info = dmix->shmptr->s.info;
 	params->info &= ~(SND_PCM_INFO_RESUME | SND_PCM_INFO_PAUSE);
+	params->info |= SND_PCM_INFO_NO_PERIOD_WAKEUP;
 	params->rate_num = dmix->shmptr->s.rate;
 	params->rate_den = 1;
 	params->fifo_size = 0;
 	params->msbits = dmix->shmptr->s.msbits;
+	/* dsnoop converting to a narrower format */
+	if (snd_pcm_direct_client_format(dmix) != (snd_pcm_format_t)dmix->shmptr->hw.format &&
+	    params->msbits > (unsigned int)snd_pcm_format_width(snd_pcm_direct_client_format(dmix)))
+		params->msbits = snd_pcm_format_width(snd_pcm_direct_client_format(dmix));
+	dmix->client_no_wakeup = !!(params->flags & SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP);
+	if (dmix->period_timer)
+		dmix->timer_period_ns = hw_param_interval(params, SND_PCM_HW_PARAM_PERIOD_SIZE)->min *
+					1000000000ULL / dmix->shmptr->s.rate;
 	return 0;
 }
 
@@ -1055,8 +1359,61 @@ int snd_pcm_direct_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 	return 0;
 }
 
+/*
+ * check whether the client can use the slave ring buffer directly,
+ * i.e. the client buffer has exactly the same layout as the slave one
+ */
+int snd_pcm_direct_shared_ring_usable(snd_pcm_t *pcm, snd_pcm_direct_t *dsnoop)
+{
+	snd_pcm_t *spcm = dsnoop->spcm;
+	unsigned int chn;
+
+	if (dsnoop->type != SND_PCM_TYPE_DSNOOP || !dsnoop->u.dsnoop.zero_copy)
+		return 0;
+	if (!spcm->running_areas)
+		return 0;
+	if (pcm->buffer_size != dsnoop->slave_buffer_size ||
+	    pcm->format != spcm->format ||
+	    pcm->channels != spcm->channels)
+		return 0;
+	if (pcm->access != SND_PCM_ACCESS_MMAP_INTERLEAVED &&
+	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED)
+		return 0;
+	if (spcm->access != SND_PCM_ACCESS_MMAP_INTERLEAVED &&
+	    spcm->access != SND_PCM_ACCESS_RW_INTERLEAVED)
+		return 0;
+	if (dsnoop->bindings) {
+		for (chn = 0; chn < pcm->channels; chn++)
+			if (dsnoop->bindings[chn] != chn)
+				return 0;
+	}
+	return 1;
+}
+
 int snd_pcm_direct_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t * info)
 {
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	const snd_pcm_channel_area_t *area;
+
+	if (dmix->type == SND_PCM_TYPE_DSNOOP) {
+		if (info->channel == 0)
+			dmix->u.dsnoop.shared_ring =
+				snd_pcm_direct_shared_ring_usable(pcm, dmix);
+		if (dmix->u.dsnoop.shared_ring) {
+			/* hand out the slave ring buffer, it's owned (and
+			 * unmapped) by the slave, so use a SHM area without
+			 * an attached segment
+			 */
+			area = &dmix->spcm->running_areas[info->channel];
+			info->addr = area->addr;
+			info->first = area->first;
+			info->step = area->step;
+			info->type = SND_PCM_AREA_SHM;
+			info->u.shm.shmid = -1;
+			info->u.shm.area = NULL;
+			return 0;
+		}
+	}
         return snd_pcm_channel_info_shm(pcm, info, -1);
 }
 
@@ -1237,6 +1594,9 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 			SND_PCM_FORMAT_S24_LE,
 			SND_PCM_FORMAT_S24_3LE,
 			SND_PCM_FORMAT_U8,
+#ifndef HAVE_SOFT_FLOAT
+			SND_PCM_FORMAT_FLOAT,
+#endif
 		};
 		snd_pcm_format_t format;
 		unsigned int i;
@@ -1329,6 +1689,14 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 			return ret;
 		}
 	}
+
+	/* the clients wake up from their own timers instead */
+	if (dmix->shmptr->no_period_wakeup) {
+		if (snd_pcm_hw_params_can_disable_period_wakeup(&hw_params))
+			hw_params.flags |= SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP;
+		else
+			dmix->shmptr->no_period_wakeup = 0;
+	}
 	
 	ret = snd_pcm_hw_params(spcm, &hw_params);
 	if (ret < 0) {
@@ -1456,9 +1824,13 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 			dmix->shmptr->use_server = 1;
 	}
 
+	snd_pcm_direct_prefault(dmix, dmix->shmptr, sizeof(snd_pcm_direct_share_t));
 	return 0;
 }
 
+/* set when the kernel refused SND_TIMER_OPEN_TREAD once */
+static int direct_timer_no_tread;
+
 /*
  * the trick is used here; we cannot use effectively the hardware handle because
  * we cannot drive multiple accesses to appl_ptr; so we use slave timer of given
@@ -1466,7 +1838,7 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
  */
 int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 {
-	int ret;
+	int ret, err, card, device, subdevice;
 	snd_pcm_info_t info = {0};
 	char name[128];
 	int capture = dmix->type == SND_PCM_TYPE_DSNOOP ? 1 : 0;
@@ -1474,26 +1846,68 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 	dmix->tread = 1;
 	dmix->timer_need_poll = 0;
 	dmix->timer_ticks = 1;
+	/* without the slave period interrupts the slave timer never ticks */
+	if (dmix->shmptr->no_period_wakeup)
+		dmix->period_timer = 1;
+	if (dmix->period_timer) {
+#ifdef HAVE_SYS_TIMERFD_H
+		ret = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (ret < 0) {
+			ret = -errno;
+			SNDERR("unable to create the period timer");
+			return ret;
+		}
+		/* the slave pointer has to be read at each wakeup */
+		dmix->slowptr = 1;
+		dmix->timer_fd.fd = ret;
+		dmix->timer_fd.events = POLLIN;
+		dmix->poll_fd = ret;
+		return 0;
+#else
+		dmix->period_timer = 0;
+#endif
+	}
+	if (dmix->shmptr->shared_wakeup) {
+		ret = snd_pcm_direct_wakeup_connect(dmix);
+		if (ret < 0)
+			SNDERR("unable to connect the shared wakeup");
+		return ret;
+	}
 	ret = snd_pcm_info(dmix->spcm, &info);
 	if (ret < 0) {
 		SNDERR("unable to info for slave pcm");
 		return ret;
 	}
+	card = snd_pcm_info_get_card(&info);
+	device = snd_pcm_info_get_device(&info);
+	subdevice = snd_pcm_info_get_subdevice(&info) * 2 + capture;
 	sprintf(name, "hw:CLASS=%i,SCLASS=0,CARD=%i,DEV=%i,SUBDEV=%i",
-		(int)SND_TIMER_CLASS_PCM,
-		snd_pcm_info_get_card(&info),
-		snd_pcm_info_get_device(&info),
-		snd_pcm_info_get_subdevice(&info) * 2 + capture);
-	ret = snd_timer_open(&dmix->timer, name,
-			     SND_TIMER_OPEN_NONBLOCK | SND_TIMER_OPEN_TREAD);
+		(int)SND_TIMER_CLASS_PCM, card, device, subdevice);
+	/*
+	 * the slave timer is always a kernel one, so open it directly
+	 * instead of resolving the "hw" timer definition from the
+	 * configuration on every open; the tread probe is done only once
+	 */
+	err = -ENOTTY;
+	if (!direct_timer_no_tread)
+		err = snd_timer_hw_open(&dmix->timer, name,
+					SND_TIMER_CLASS_PCM, SND_TIMER_SCLASS_NONE,
+					card, device, subdevice,
+					SND_TIMER_OPEN_NONBLOCK | SND_TIMER_OPEN_TREAD);
+	ret = err;
 	if (ret < 0) {
 		dmix->tread = 0;
-		ret = snd_timer_open(&dmix->timer, name,
-				     SND_TIMER_OPEN_NONBLOCK);
-		if (ret < 0) {
-			SNDERR("unable to open timer '%s'", name);
-			return ret;
-		}
+		ret = snd_timer_hw_open(&dmix->timer, name,
+					SND_TIMER_CLASS_PCM, SND_TIMER_SCLASS_NONE,
+					card, device, subdevice,
+					SND_TIMER_OPEN_NONBLOCK);
+		/* an old kernel without the extended read */
+		if (ret >= 0 && (err == -ENOTTY || err == -EINVAL))
+			direct_timer_no_tread = 1;
+	}
+	if (ret < 0) {
+		SNDERR("unable to open timer '%s'", name);
+		return ret;
 	}
 
 	if (snd_timer_poll_descriptors_count(dmix->timer) != 1) {
@@ -1646,6 +2060,7 @@ int snd_pcm_direct_initialize_secondary_slave(snd_pcm_direct_t *dmix,
 		SNDERR("unable to mmap channels");
 		return ret;
 	}
+	snd_pcm_direct_prefault(dmix, dmix->shmptr, sizeof(snd_pcm_direct_share_t));
 	return 0;
 }
 
@@ -1655,6 +2070,8 @@ int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix)
 	unsigned int filter;
 	int ret;
 
+	if (dmix->shared_wakeup || dmix->period_timer)
+		return 0;
 	snd_timer_params_set_auto_start(&params, 1);
 	if (dmix->type != SND_PCM_TYPE_DSNOOP)
 		snd_timer_params_set_early_event(&params, 1);
@@ -1937,6 +2354,18 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 #else
 	rec->direct_memory_access = 0;
 #endif
+	rec->lockless_mix = 0;
+	rec->gain_db = 0;
+	rec->mix_threads = 0;
+	rec->zero_copy = 0;
+	rec->convert_format = SND_PCM_FORMAT_UNKNOWN;
+	rec->rewind_history = 0;
+	rec->hugepages = 0;
+	rec->prefault = 0;
+	rec->shared_wakeup = 0;
+	rec->period_timer = 0;
+	rec->slave_period_wakeup = 1;
+	snd_pcm_thread_conf_init(&rec->thread_conf);
 	rec->hw_ptr_alignment = SND_PCM_HW_PTR_ALIGNMENT_AUTO;
 	rec->tstamp_type = -1;
 
@@ -2102,6 +2531,126 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->direct_memory_access = err;
 			continue;
 		}
+		if (strcmp(id, "lockless_mix") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->lockless_mix = err;
+			continue;
+		}
+		if (strcmp(id, "gain") == 0) {
+			double val;
+			err = snd_config_get_ireal(n, &val);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (val > 24.0) {
+				SNDERR("The field gain must be at most 24 (dB)");
+				return -EINVAL;
+			}
+			rec->gain_db = val < -99999.0 ? SND_CTL_TLV_DB_GAIN_MUTE :
+				(long)(val * 100.0 + (val < 0 ? -0.5 : 0.5));
+			continue;
+		}
+		if (strcmp(id, "mix_threads") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (val < 0 || val > 64) {
+				SNDERR("The field mix_threads must be in range 0-64");
+				return -EINVAL;
+			}
+			rec->mix_threads = val;
+			continue;
+		}
+		if (strcmp(id, "zero_copy") == 0) {
+			if (stream != SND_PCM_STREAM_CAPTURE) {
+				SNDERR("The field zero_copy is supported only for capture");
+				return -EINVAL;
+			}
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->zero_copy = err;
+			continue;
+		}
+		if (strcmp(id, "convert_format") == 0) {
+			snd_pcm_format_t format;
+			const char *str;
+			if (stream != SND_PCM_STREAM_CAPTURE) {
+				SNDERR("The field convert_format is supported only for capture");
+				return -EINVAL;
+			}
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			format = snd_pcm_format_value(str);
+			if (format == SND_PCM_FORMAT_UNKNOWN ||
+			    !snd_pcm_format_linear(format) ||
+			    snd_pcm_format_float(format)) {
+				SNDERR("The field convert_format must be a linear integer format: %s", str);
+				return -EINVAL;
+			}
+			rec->convert_format = format;
+			continue;
+		}
+		if (strcmp(id, "rewind_history") == 0) {
+			if (stream != SND_PCM_STREAM_PLAYBACK) {
+				SNDERR("The field rewind_history is supported only for playback");
+				return -EINVAL;
+			}
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->rewind_history = err;
+			continue;
+		}
+		if (strcmp(id, "hugepages") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->hugepages = err;
+			continue;
+		}
+		if (strcmp(id, "prefault") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->prefault = err;
+			continue;
+		}
+		if (strcmp(id, "shared_wakeup") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->shared_wakeup = err;
+			continue;
+		}
+		if (strcmp(id, "period_timer") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->period_timer = err;
+			continue;
+		}
+		if (strcmp(id, "slave_period_wakeup") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->slave_period_wakeup = err;
+			continue;
+		}
+		err = snd_pcm_thread_conf_parse(&rec->thread_conf, n, id);
+		if (err < 0)
+			return err;
+		if (err > 0)
+			continue;
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -2127,6 +2676,10 @@ void snd_pcm_direct_reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix,
 				    snd_pcm_uframes_t hw_ptr)
 {
 	dmix->slave_appl_ptr = dmix->slave_hw_ptr = hw_ptr;
+	/* a client woken by its own timer needs no period alignment */
+	if (dmix->period_timer &&
+	    dmix->hw_ptr_alignment == SND_PCM_HW_PTR_ALIGNMENT_AUTO)
+		return;
 	if (dmix->hw_ptr_alignment == SND_PCM_HW_PTR_ALIGNMENT_ROUNDUP ||
 	    (dmix->hw_ptr_alignment == SND_PCM_HW_PTR_ALIGNMENT_AUTO &&
 	     pcm->buffer_size <= pcm->period_size * 2))
@@ -2141,6 +2694,231 @@ void snd_pcm_direct_reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix,
 							dmix->slave_period_size);
 }
 
+/*
+ *  client statistics
+ *
+ *  Each slot is written only by its owner, the readers might see a partial
+ *  update, which is fine for the monitoring purposes.  The counters of a
+ *  slot are added to the retired totals when it is released, with the
+ *  client semaphore held, and the server writes only its own counters.
+ */
+/* move the counters of a released slot to the retired totals */
+static void stats_retire(snd_pcm_direct_share_t *shm,
+			 snd_pcm_direct_stage_stats_t *stage)
+{
+	shm->stats.retired.transfers += stage->transfers;
+	shm->stats.retired.frames += stage->frames;
+	shm->stats.retired.nsec += stage->nsec;
+	memset(stage, 0, sizeof(*stage));
+}
+
+/* allocate a stats slot, called with the client semaphore held */
+static void snd_pcm_direct_stats_attach(snd_pcm_direct_t *direct, int first_instance)
+{
+	snd_pcm_direct_share_t *shm = direct->shmptr;
+	snd_pcm_direct_client_stats_t *st;
+	unsigned int i;
+
+	if (first_instance) {
+		shm->stats.version = DIRECT_STATS_VERSION;
+		shm->stats.count = DIRECT_STATS_CLIENTS;
+	}
+	for (i = 0; i < DIRECT_STATS_CLIENTS; i++) {
+		st = &shm->stats.clients[i];
+		/* reuse the slots of crashed clients, too */
+		if (st->pid == 0 ||
+		    (kill(st->pid, 0) < 0 && errno == ESRCH)) {
+			stats_retire(shm, &shm->stats.stage[i]);
+			memset(st, 0, sizeof(*st));
+			st->state = SND_PCM_STATE_OPEN;
+			stats_store(&st->pid, (int)getpid());
+			direct->stats = st;
+			direct->stage = &shm->stats.stage[i];
+			return;
+		}
+	}
+	/* no free slot, this client is not accounted */
+}
+
+/* release the stats slot, called with the client semaphore held */
+void snd_pcm_direct_stats_detach(snd_pcm_direct_t *direct)
+{
+	if (!direct->stats)
+		return;
+	stats_retire(direct->shmptr, direct->stage);
+	stats_store(&direct->stats->pid, 0);
+	direct->stats = NULL;
+	direct->stage = NULL;
+}
+
+void snd_pcm_direct_stats_update(snd_pcm_t *pcm, snd_pcm_direct_t *direct)
+{
+	snd_pcm_direct_client_stats_t *st = direct->stats;
+	snd_pcm_uframes_t avail;
+
+	if (!st)
+		return;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		avail = snd_pcm_mmap_playback_avail(pcm);
+	else
+		avail = snd_pcm_mmap_capture_avail(pcm);
+	if (direct->state == SND_PCM_STATE_XRUN &&
+	    st->state != SND_PCM_STATE_XRUN)
+		stats_store(&st->xruns, st->xruns + 1);
+	stats_store(&st->state, (unsigned int)direct->state);
+	stats_store(&st->avail, (unsigned int)avail);
+	if (avail > st->avail_max)
+		stats_store(&st->avail_max, (unsigned int)avail);
+}
+
+void snd_pcm_direct_stats_transfer(snd_pcm_direct_t *direct,
+				   const snd_htimestamp_t *start,
+				   snd_pcm_uframes_t frames)
+{
+	snd_pcm_direct_client_stats_t *st = direct->stats;
+	snd_pcm_direct_stage_stats_t *stage = direct->stage;
+	snd_htimestamp_t now;
+	unsigned long long nsec;
+
+	if (!st)
+		return;
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	nsec = (now.tv_sec - start->tv_sec) * 1000000000LL +
+	       (now.tv_nsec - start->tv_nsec);
+	stats_store64(&stage->transfers, stage->transfers + 1);
+	stats_store64(&stage->frames, stage->frames + frames);
+	stats_store64(&stage->nsec, stage->nsec + nsec);
+	stats_store(&st->updates, st->updates + 1);
+	stats_store(&st->frames, st->frames + (unsigned int)frames);
+	/* the sum is truncated, not each transfer */
+	stats_store(&st->transfer_usec, (unsigned int)(stage->nsec / 1000));
+}
+
+/* the instance must be of a direct plugin */
+static snd_pcm_direct_share_t *stats_shm(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *direct;
+
+	switch (pcm->type) {
+	case SND_PCM_TYPE_DMIX:
+	case SND_PCM_TYPE_DSNOOP:
+	case SND_PCM_TYPE_DSHARE:
+		break;
+	default:
+		return NULL;
+	}
+	direct = pcm->private_data;
+	return direct->shmptr;
+}
+
+/**
+ * \brief Read the client statistics of a direct plugin instance
+ * \param pcm dmix, dsnoop or dshare PCM handle
+ * \param stats Array filled with the statistics of the active clients
+ * \param count Number of entries in \a stats
+ * \return the number of filled entries, otherwise a negative error code
+ *
+ * The statistics are kept in the shared memory of the plugin instance,
+ * so all clients of the instance are reported, including \a pcm itself.
+ * The handle does not need to be set up.
+ */
+int snd_pcm_direct_stats_read(snd_pcm_t *pcm,
+			      snd_pcm_direct_client_stats_t *stats,
+			      unsigned int count)
+{
+	snd_pcm_direct_share_t *shm;
+	snd_pcm_direct_client_stats_t *st;
+	unsigned int i, filled = 0;
+	int pid;
+
+	assert(pcm);
+	assert(stats || count == 0);
+	shm = stats_shm(pcm);
+	if (!shm)
+		return -EINVAL;
+	if (shm->stats.version != DIRECT_STATS_VERSION)
+		return -EPROTO;
+	for (i = 0; i < shm->stats.count && i < DIRECT_STATS_CLIENTS; i++) {
+		if (filled >= count)
+			break;
+		st = &shm->stats.clients[i];
+		pid = stats_load(&st->pid);
+		if (pid == 0)
+			continue;
+		stats[filled].pid = pid;
+		stats[filled].state = stats_load(&st->state);
+		stats[filled].xruns = stats_load(&st->xruns);
+		stats[filled].avail = stats_load(&st->avail);
+		stats[filled].avail_max = stats_load(&st->avail_max);
+		stats[filled].updates = stats_load(&st->updates);
+		stats[filled].frames = stats_load(&st->frames);
+		stats[filled].transfer_usec = stats_load(&st->transfer_usec);
+		filled++;
+	}
+	return filled;
+}
+
+/**
+ * \brief Read the totals of a direct plugin instance
+ * \param pcm dmix, dsnoop or dshare PCM handle
+ * \param total Returned totals
+ * \return 0 on success otherwise a negative error code
+ *
+ * The transfers are the stage of the plugin done by its clients: the
+ * mixing of dmix, the copies of dsnoop and of dshare.  They are counted
+ * since the creation of the instance, i.e. since its slave (one device of
+ * a card) was opened, the closed clients included.  The wakeups are the
+ * slave timer ticks forwarded by the server with the shared wakeups.
+ * The handle does not need to be set up.
+ */
+int snd_pcm_direct_stats_total(snd_pcm_t *pcm, snd_pcm_direct_stats_t *total)
+{
+	snd_pcm_direct_share_t *shm;
+	snd_pcm_direct_stage_stats_t *stage;
+	unsigned int i;
+
+	assert(pcm && total);
+	shm = stats_shm(pcm);
+	if (!shm)
+		return -EINVAL;
+	if (shm->stats.version != DIRECT_STATS_VERSION)
+		return -EPROTO;
+	memset(total, 0, sizeof(*total));
+	total->transfers = stats_load64(&shm->stats.retired.transfers);
+	total->frames = stats_load64(&shm->stats.retired.frames);
+	total->transfer_nsec = stats_load64(&shm->stats.retired.nsec);
+	for (i = 0; i < shm->stats.count && i < DIRECT_STATS_CLIENTS; i++) {
+		if (stats_load(&shm->stats.clients[i].pid) == 0)
+			continue;
+		stage = &shm->stats.stage[i];
+		total->clients++;
+		total->transfers += stats_load64(&stage->transfers);
+		total->frames += stats_load64(&stage->frames);
+		total->transfer_nsec += stats_load64(&stage->nsec);
+	}
+	total->wakeups = stats_load64(&shm->stats.server.transfers);
+	total->wakeup_nsec = stats_load64(&shm->stats.server.nsec);
+	return 0;
+}
+
+void snd_pcm_direct_stats_dump(snd_pcm_t *pcm, snd_output_t *out)
+{
+	snd_pcm_direct_stats_t total;
+
+	if (snd_pcm_direct_stats_total(pcm, &total) < 0)
+		return;
+	snd_output_printf(out, "  stats        : %u clients, %llu transfers, %llu frames, %llu us",
+			  total.clients, total.transfers, total.frames,
+			  total.transfer_nsec / 1000);
+	if (total.frames)
+		snd_output_printf(out, " (%llu ns/frame)",
+				  total.transfer_nsec / total.frames);
+	snd_output_printf(out, "\n");
+	if (total.wakeups)
+		snd_output_printf(out, "  wakeups      : %llu forwarded, %llu us\n",
+				  total.wakeups, total.wakeup_nsec / 1000);
+}
+
 int _snd_pcm_direct_new(snd_pcm_t **pcmp, snd_pcm_direct_t **_dmix, int type,
 			const char *name, struct snd_pcm_direct_open_conf *opts,
 			struct slave_params *params, snd_pcm_stream_t stream, int mode)
@@ -2163,8 +2941,12 @@ int _snd_pcm_direct_new(snd_pcm_t **pcmp, snd_pcm_direct_t **_dmix, int type,
 	dmix->ipc_perm = opts->ipc_perm;
 	dmix->ipc_gid = opts->ipc_gid;
 	dmix->tstamp_type = opts->tstamp_type;
+	dmix->prefault = opts->prefault;
+	dmix->period_timer = opts->period_timer;
+	dmix->thread_conf = opts->thread_conf;
 	dmix->semid = -1;
 	dmix->shmid = -1;
+	dmix->poll_fd = -1;
 	dmix->shmptr = (void *) -1;
 	dmix->type = type;
 
@@ -2196,6 +2978,13 @@ int _snd_pcm_direct_new(snd_pcm_t **pcmp, snd_pcm_direct_t **_dmix, int type,
 	} else {
 		*_dmix = dmix;
 	}
+	/* the shared wakeups are served by the server process */
+	if (ret > 0 && opts->shared_wakeup)
+		dmix->shmptr->use_server = dmix->shmptr->shared_wakeup = 1;
+	/* the first instance decides, the slave is shared */
+	if (ret > 0)
+		dmix->shmptr->no_period_wakeup = !opts->slave_period_wakeup;
+	snd_pcm_direct_stats_attach(dmix, ret > 0);
 
 	return ret;
 _err_nosem_free:
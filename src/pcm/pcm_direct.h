@@ -28,6 +28,8 @@
 #define SEC_TO_MS               1000
 /* slave_period time for low latency requirements in ms */
 #define LOW_LATENCY_PERIOD_TIME 10
+/* shortest client period in us with the period_timer option */
+#define DIRECT_MIN_PERIOD_TIME	1000
 
 
 typedef void (mix_areas_t)(unsigned int size,
@@ -55,6 +57,20 @@ typedef void (mix_areas_u8_t)(unsigned int size,
 			      volatile signed int *sum, size_t dst_step,
 			      size_t src_step, size_t sum_step);
 
+typedef void (mix_areas_float_t)(unsigned int size,
+				 volatile float *dst, float *src,
+				 volatile float *sum, size_t dst_step,
+				 size_t src_step, size_t sum_step);
+
+/* mixing with the client gain, see snd_pcm_dmix_set_gain() */
+typedef void (mix_gain_t)(unsigned int size,
+			  volatile void *dst, void *src,
+			  volatile void *sum, size_t dst_step,
+			  size_t src_step, size_t sum_step, int gain);
+
+/* the gain is in the Q16 format */
+#define DMIX_GAIN_UNITY		0x10000
+
 typedef enum snd_pcm_direct_hw_ptr_alignment {
 	SND_PCM_HW_PTR_ALIGNMENT_NO = 0,	/* use the hw_ptr as is and do no rounding */
 	SND_PCM_HW_PTR_ALIGNMENT_ROUNDUP = 1,	/* round the slave_appl_ptr up to slave_period */
@@ -73,12 +89,24 @@ struct slave_params {
 	unsigned int periods;
 };
 
+#define DIRECT_STATS_VERSION	2
+#define DIRECT_STATS_CLIENTS	64
+
+/* 64-bit transfer counters, see snd_pcm_direct_stats_total() */
+typedef struct {
+	unsigned long long transfers;
+	unsigned long long frames;
+	unsigned long long nsec;
+} snd_pcm_direct_stage_stats_t;
+
 /* shared among direct plugin clients - be careful to be 32/64bit compatible! */
 typedef struct {
 	unsigned int magic;			/* magic number */
 	char socket_name[256];			/* name of communication socket */
 	snd_pcm_type_t type;			/* PCM type (currently only hw) */
 	int use_server;
+	int shared_wakeup;			/* server fans out the slave timer wakeups */
+	int no_period_wakeup;			/* slave runs without period interrupts */
 	struct {
 		unsigned int format;
 		snd_interval_t rate;
@@ -125,6 +153,14 @@ typedef struct {
 			unsigned long long chn_mask;
 		} dshare;
 	} u;
+	struct {
+		unsigned int version;		/* DIRECT_STATS_VERSION */
+		unsigned int count;		/* number of client slots */
+		snd_pcm_direct_client_stats_t clients[DIRECT_STATS_CLIENTS];
+		snd_pcm_direct_stage_stats_t stage[DIRECT_STATS_CLIENTS];
+		snd_pcm_direct_stage_stats_t retired;	/* detached clients */
+		snd_pcm_direct_stage_stats_t server;	/* forwarded wakeups */
+	} stats;
 } snd_pcm_direct_share_t;
 
 typedef struct snd_pcm_direct snd_pcm_direct_t;
@@ -157,6 +193,11 @@ struct snd_pcm_direct {
 	int hw_fd;			/* hardware file descriptor */
 	struct pollfd timer_fd;
 	int poll_fd;
+	int shared_wakeup;		/* poll_fd is an eventfd fed by the server */
+	int period_timer;		/* poll_fd is a timerfd at the client period */
+	unsigned long long timer_period_ns;
+	int client_no_wakeup;		/* the client disabled its period wakeups */
+	snd_pcm_thread_conf_t thread_conf; /* of the server and the mix workers */
 	int tread: 1;
 	int timer_need_poll: 1;
 	unsigned int timer_events;
@@ -174,9 +215,11 @@ struct snd_pcm_direct {
 	int direct_memory_access;	/* use arch-optimized buffer RW */
 	snd_pcm_direct_hw_ptr_alignment_t hw_ptr_alignment;
 	int tstamp_type;		/* cached from conf, can be -1(default) on top of real types */
+	int prefault;			/* touch the shared pages at open */
 	union {
 		struct {
 			int shmid_sum;			/* IPC global sum ring buffer memory identification */
+			int hugepages;			/* allocate the sum buffer with huge pages */
 			signed int *sum_buffer;		/* shared sum buffer */
 			mix_areas_16_t *mix_areas_16;
 			mix_areas_32_t *mix_areas_32;
@@ -186,13 +229,37 @@ struct snd_pcm_direct {
 			mix_areas_32_t *remix_areas_32;
 			mix_areas_24_t *remix_areas_24;
 			mix_areas_u8_t *remix_areas_u8;
+			mix_areas_float_t *mix_areas_float;
+			mix_areas_float_t *remix_areas_float;
+			mix_gain_t *mix_gain;		/* NULL when the format has no gain */
+			mix_gain_t *remix_gain;
+			int gain;			/* client gain, DMIX_GAIN_UNITY = 0dB */
+			long gain_db;			/* the gain as set, in 0.01dB */
 			unsigned int use_sem;
+			int lockless_mix;		/* mix with atomic operations, no semaphore */
+			struct snd_pcm_direct_mix_pool *mix_pool;	/* mixing worker threads */
+			void *history;			/* mixed samples at slave positions */
+			snd_pcm_channel_area_t *history_areas;
 		} dmix;
 		struct {
 			unsigned long long chn_mask;
 		} dshare;
+		struct {
+			int zero_copy;			/* allow aliasing the slave ring buffer */
+			int shared_ring;		/* mmap areas point to the slave ring buffer */
+			snd_pcm_format_t convert_format;	/* client format, UNKNOWN = slave one */
+			int use_getput;			/* 24-bit or 20-bit samples involved */
+			unsigned int conv_idx;		/* snd_pcm_linear_convert() index */
+			unsigned int get_idx, put_idx;	/* snd_pcm_linear_getput() indexes */
+			int shmid_conv;			/* IPC shared conversions memory identification */
+			struct snd_pcm_dsnoop_conv *conv;	/* shared conversions */
+			int conv_slot;			/* our conversion, -1 = private */
+			snd_pcm_channel_area_t *conv_areas;	/* the ring of our conversion */
+		} dsnoop;
 	} u;
 	void (*server_free)(snd_pcm_direct_t *direct);
+	snd_pcm_direct_client_stats_t *stats;	/* own slot in shm, or NULL */
+	snd_pcm_direct_stage_stats_t *stage;	/* counters of the slot */
 };
 
 /* make local functions really local */
@@ -240,6 +307,8 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_sw_params
 #define snd_pcm_direct_channel_info \
 	snd1_pcm_direct_channel_info
+#define snd_pcm_direct_shared_ring_usable \
+	snd1_pcm_direct_shared_ring_usable
 #define snd_pcm_direct_mmap \
 	snd1_pcm_direct_mmap
 #define snd_pcm_direct_munmap \
@@ -248,8 +317,12 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_prepare
 #define snd_pcm_direct_resume \
 	snd1_pcm_direct_resume
+#define snd_pcm_direct_timer_start \
+	snd1_pcm_direct_timer_start
 #define snd_pcm_direct_timer_stop \
 	snd1_pcm_direct_timer_stop
+#define snd_pcm_direct_timer_discard \
+	snd1_pcm_direct_timer_discard
 #define snd_pcm_direct_clear_timer_queue \
 	snd1_pcm_direct_clear_timer_queue
 #define snd_pcm_direct_set_timer_params \
@@ -270,6 +343,16 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_check_xrun
 #define snd_pcm_direct_slave_recover \
 	snd1_pcm_direct_slave_recover
+#define snd_pcm_direct_prefault \
+	snd1_pcm_direct_prefault
+#define snd_pcm_direct_stats_detach \
+	snd1_pcm_direct_stats_detach
+#define snd_pcm_direct_stats_update \
+	snd1_pcm_direct_stats_update
+#define snd_pcm_direct_stats_transfer \
+	snd1_pcm_direct_stats_transfer
+#define snd_pcm_direct_stats_dump \
+	snd1_pcm_direct_stats_dump
 
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix);
 
@@ -314,8 +397,18 @@ static inline int snd_pcm_direct_semaphore_final(snd_pcm_direct_t *dmix, int sem
 	return snd_pcm_direct_semaphore_up(dmix, sem_num);
 }
 
+/* the format seen by the client, dsnoop may convert the slave one */
+static inline snd_pcm_format_t snd_pcm_direct_client_format(snd_pcm_direct_t *dmix)
+{
+	if (dmix->type == SND_PCM_TYPE_DSNOOP &&
+	    dmix->u.dsnoop.convert_format != SND_PCM_FORMAT_UNKNOWN)
+		return dmix->u.dsnoop.convert_format;
+	return (snd_pcm_format_t)dmix->shmptr->hw.format;
+}
+
 int snd_pcm_direct_shm_create_or_connect(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_prefault(snd_pcm_direct_t *dmix, const void *ptr, size_t size);
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_server_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_client_connect(snd_pcm_direct_t *dmix);
@@ -338,11 +431,14 @@ int snd_pcm_direct_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params);
 int snd_pcm_direct_hw_free(snd_pcm_t *pcm);
 int snd_pcm_direct_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params);
 int snd_pcm_direct_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t * info);
+int snd_pcm_direct_shared_ring_usable(snd_pcm_t *pcm, snd_pcm_direct_t *dsnoop);
 int snd_pcm_direct_mmap(snd_pcm_t *pcm);
 int snd_pcm_direct_munmap(snd_pcm_t *pcm);
 int snd_pcm_direct_prepare(snd_pcm_t *pcm);
 int snd_pcm_direct_resume(snd_pcm_t *pcm);
+int snd_pcm_direct_timer_start(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_timer_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_open_secondary_client(snd_pcm_t **spcmp, snd_pcm_direct_t *dmix, const char *client_name);
@@ -355,6 +451,20 @@ int snd_pcm_direct_check_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm);
 int snd_timer_async(snd_timer_t *timer, int sig, pid_t pid);
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm);
 void snd_pcm_direct_reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix, snd_pcm_uframes_t hw_ptr);
+void snd_pcm_direct_stats_detach(snd_pcm_direct_t *direct);
+void snd_pcm_direct_stats_update(snd_pcm_t *pcm, snd_pcm_direct_t *direct);
+void snd_pcm_direct_stats_transfer(snd_pcm_direct_t *direct,
+				   const snd_htimestamp_t *start,
+				   snd_pcm_uframes_t frames);
+void snd_pcm_direct_stats_dump(snd_pcm_t *pcm, snd_output_t *out);
+
+/* take the start time of a transfer accounted in the client stats */
+static inline void snd_pcm_direct_stats_start(snd_pcm_direct_t *direct,
+					      snd_htimestamp_t *start)
+{
+	if (direct->stats)
+		gettimestamp(start, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+}
 
 struct snd_pcm_direct_open_conf {
 	key_t ipc_key;
@@ -364,6 +474,18 @@ struct snd_pcm_direct_open_conf {
 	int max_periods;
 	int var_periodsize;
 	int direct_memory_access;
+	int lockless_mix;
+	long gain_db;
+	int mix_threads;
+	int zero_copy;
+	snd_pcm_format_t convert_format;
+	int rewind_history;
+	int hugepages;
+	int prefault;
+	int shared_wakeup;
+	int period_timer;
+	int slave_period_wakeup;
+	snd_pcm_thread_conf_t thread_conf;
 	snd_pcm_direct_hw_ptr_alignment_t hw_ptr_alignment;
 	int tstamp_type;
 	snd_config_t *slave;
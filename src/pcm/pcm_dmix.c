@@ -37,6 +37,7 @@
 #include <ctype.h>
 #include <grp.h>
 #include <sys/ioctl.h>
+#include <math.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
 #include <sys/sem.h>
@@ -44,6 +45,9 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 #include "pcm_direct.h"
 
 #ifndef PIC
@@ -75,6 +79,15 @@ static int shm_sum_create_or_connect(snd_pcm_direct_t *dmix)
 	       dmix->shmptr->s.buffer_size *
 	       sizeof(signed int);	
 retryshm:
+	dmix->u.dmix.shmid_sum = -1;
+#ifdef SHM_HUGETLB
+	/* the flag is ignored when the segment exists already */
+	if (dmix->u.dmix.hugepages)
+		dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
+						IPC_CREAT | SHM_HUGETLB |
+						dmix->ipc_perm);
+	if (dmix->u.dmix.shmid_sum < 0)
+#endif
 	dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
 					IPC_CREAT | dmix->ipc_perm);
 	err = -errno;
@@ -104,6 +117,7 @@ retryshm:
 		return err;
 	}
 	mlock(dmix->u.dmix.sum_buffer, size);
+	snd_pcm_direct_prefault(dmix, dmix->u.dmix.sum_buffer, size);
 	return 0;
 }
 
@@ -152,6 +166,366 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
 #endif
 #endif
 
+/*
+ * mix the given part of the areas, the interleaved buffers are split
+ * by frames and the non-interleaved ones by channels
+ */
+static void mix_areas_part(snd_pcm_direct_t *dmix,
+			   mix_areas_t *do_mix_areas,
+			   mix_gain_t *do_gain,
+			   unsigned int sample_size,
+			   const snd_pcm_channel_area_t *src_areas,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t src_ofs,
+			   snd_pcm_uframes_t dst_ofs,
+			   snd_pcm_uframes_t size,
+			   unsigned int part, unsigned int parts)
+{
+	unsigned int src_step, dst_step;
+	unsigned int chn, dchn, channels, chn_start, chn_end;
+	snd_pcm_uframes_t start;
+
+	channels = dmix->channels;
+	if (dmix->interleaved) {
+		start = size * part / parts;
+		size = size * (part + 1) / parts - start;
+		if (!size)
+			return;
+		src_ofs += start;
+		dst_ofs += start;
+		/*
+		 * process all areas in one loop
+		 * it optimizes the memory accesses for this case
+		 */
+		if (do_gain) {
+			do_gain(size * channels,
+				(unsigned char *)dst_areas[0].addr + sample_size * dst_ofs * channels,
+				(unsigned char *)src_areas[0].addr + sample_size * src_ofs * channels,
+				dmix->u.dmix.sum_buffer + dst_ofs * channels,
+				sample_size,
+				sample_size,
+				sizeof(signed int),
+				dmix->u.dmix.gain);
+			return;
+		}
+		do_mix_areas(size * channels,
+			     (unsigned char *)dst_areas[0].addr + sample_size * dst_ofs * channels,
+			     (unsigned char *)src_areas[0].addr + sample_size * src_ofs * channels,
+			     dmix->u.dmix.sum_buffer + dst_ofs * channels,
+			     sample_size,
+			     sample_size,
+			     sizeof(signed int));
+		return;
+	}
+	chn_start = channels * part / parts;
+	chn_end = channels * (part + 1) / parts;
+	for (chn = chn_start; chn < chn_end; chn++) {
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= dmix->shmptr->s.channels)
+			continue;
+		src_step = src_areas[chn].step / 8;
+		dst_step = dst_areas[dchn].step / 8;
+		if (do_gain) {
+			do_gain(size,
+				((unsigned char *)dst_areas[dchn].addr + dst_areas[dchn].first / 8) + dst_ofs * dst_step,
+				((unsigned char *)src_areas[chn].addr + src_areas[chn].first / 8) + src_ofs * src_step,
+				dmix->u.dmix.sum_buffer + dmix->shmptr->s.channels * dst_ofs + dchn,
+				dst_step,
+				src_step,
+				dmix->shmptr->s.channels * sizeof(signed int),
+				dmix->u.dmix.gain);
+			continue;
+		}
+		do_mix_areas(size,
+			     ((unsigned char *)dst_areas[dchn].addr + dst_areas[dchn].first / 8) + dst_ofs * dst_step,
+			     ((unsigned char *)src_areas[chn].addr + src_areas[chn].first / 8) + src_ofs * src_step,
+			     dmix->u.dmix.sum_buffer + dmix->shmptr->s.channels * dst_ofs + dchn,
+			     dst_step,
+			     src_step,
+			     dmix->shmptr->s.channels * sizeof(signed int));
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ *  worker pool for mixing of high channel counts (mix_threads option)
+ *
+ *  The caller mixes the first part itself and the workers mix the
+ *  remaining parts.  The parts do not overlap, so no additional locking
+ *  of the mix buffers is required.
+ */
+
+/* don't wake up the workers for less samples than this per part */
+#define MIX_POOL_MIN_SAMPLES	512
+
+struct snd_pcm_direct_mix_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+	snd_pcm_direct_t *dmix;
+	pid_t pid;			/* the workers exist only in this process */
+	unsigned int threads;		/* number of worker threads */
+	unsigned int generation;	/* incremented for each job */
+	unsigned int parts;		/* parts of the current job */
+	unsigned int pending;		/* workers still running */
+	int quit;
+	struct {
+		mix_areas_t *func;
+		mix_gain_t *gain_func;
+		unsigned int sample_size;
+		const snd_pcm_channel_area_t *src_areas;
+		const snd_pcm_channel_area_t *dst_areas;
+		snd_pcm_uframes_t src_ofs;
+		snd_pcm_uframes_t dst_ofs;
+		snd_pcm_uframes_t size;
+	} job;
+	pthread_t tids[];
+};
+
+static void *mix_pool_worker(void *arg)
+{
+	struct snd_pcm_direct_mix_pool *pool = arg;
+	unsigned int generation = 0, idx;
+
+	snd_pcm_thread_conf_apply(&pool->dmix->thread_conf, "dmix mix worker");
+	pthread_mutex_lock(&pool->mutex);
+	idx = pool->pending++;
+	pthread_cond_signal(&pool->done_cond);
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+		/* part 0 is mixed by the caller */
+		if (idx + 1 < pool->parts)
+			mix_areas_part(pool->dmix, pool->job.func,
+				       pool->job.gain_func,
+				       pool->job.sample_size,
+				       pool->job.src_areas, pool->job.dst_areas,
+				       pool->job.src_ofs, pool->job.dst_ofs,
+				       pool->job.size, idx + 1, pool->parts);
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void mix_pool_free(snd_pcm_direct_t *dmix)
+{
+	struct snd_pcm_direct_mix_pool *pool = dmix->u.dmix.mix_pool;
+	unsigned int i;
+
+	if (!pool)
+		return;
+	if (pool->pid == getpid()) {
+		pthread_mutex_lock(&pool->mutex);
+		pool->quit = 1;
+		pthread_cond_broadcast(&pool->start_cond);
+		pthread_mutex_unlock(&pool->mutex);
+		for (i = 0; i < pool->threads; i++)
+			pthread_join(pool->tids[i], NULL);
+	}
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+	dmix->u.dmix.mix_pool = NULL;
+}
+
+static int mix_pool_create(snd_pcm_direct_t *dmix, unsigned int threads)
+{
+	struct snd_pcm_direct_mix_pool *pool;
+	unsigned int i;
+	int err;
+
+	if (threads < 2)
+		return 0;
+	/* the caller is one of the threads */
+	threads--;
+	pool = calloc(1, sizeof(*pool) + threads * sizeof(pthread_t));
+	if (!pool)
+		return -ENOMEM;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	pool->dmix = dmix;
+	pool->pid = getpid();
+	dmix->u.dmix.mix_pool = pool;
+	for (i = 0; i < threads; i++) {
+		err = pthread_create(&pool->tids[i], NULL, mix_pool_worker, pool);
+		if (err) {
+			mix_pool_free(dmix);
+			return -err;
+		}
+		pool->threads++;
+	}
+	/* wait until all workers picked their index */
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending < pool->threads)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pool->pending = 0;
+	pthread_mutex_unlock(&pool->mutex);
+	return 0;
+}
+
+static unsigned int mix_pool_parts(snd_pcm_direct_t *dmix,
+				   struct snd_pcm_direct_mix_pool *pool,
+				   snd_pcm_uframes_t size)
+{
+	unsigned int parts;
+
+	if (!pool || pool->pid != getpid())
+		return 1;
+	parts = size * dmix->channels / MIX_POOL_MIN_SAMPLES;
+	if (parts > pool->threads + 1)
+		parts = pool->threads + 1;
+	if (!dmix->interleaved && parts > dmix->channels)
+		parts = dmix->channels;
+	return parts ? parts : 1;
+}
+
+static void mix_areas_run(snd_pcm_direct_t *dmix,
+			  mix_areas_t *do_mix_areas,
+			  mix_gain_t *do_gain,
+			  unsigned int sample_size,
+			  const snd_pcm_channel_area_t *src_areas,
+			  const snd_pcm_channel_area_t *dst_areas,
+			  snd_pcm_uframes_t src_ofs,
+			  snd_pcm_uframes_t dst_ofs,
+			  snd_pcm_uframes_t size)
+{
+	struct snd_pcm_direct_mix_pool *pool = dmix->u.dmix.mix_pool;
+	unsigned int parts = mix_pool_parts(dmix, pool, size);
+
+	if (parts <= 1) {
+		mix_areas_part(dmix, do_mix_areas, do_gain, sample_size,
+			       src_areas, dst_areas, src_ofs, dst_ofs, size,
+			       0, 1);
+		return;
+	}
+	pthread_mutex_lock(&pool->mutex);
+	pool->job.func = do_mix_areas;
+	pool->job.gain_func = do_gain;
+	pool->job.sample_size = sample_size;
+	pool->job.src_areas = src_areas;
+	pool->job.dst_areas = dst_areas;
+	pool->job.src_ofs = src_ofs;
+	pool->job.dst_ofs = dst_ofs;
+	pool->job.size = size;
+	pool->parts = parts;
+	pool->pending = pool->threads;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	mix_areas_part(dmix, do_mix_areas, do_gain, sample_size, src_areas,
+		       dst_areas, src_ofs, dst_ofs, size, 0, parts);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+#else
+static inline void mix_pool_free(snd_pcm_direct_t *dmix ATTRIBUTE_UNUSED)
+{
+}
+
+static inline int mix_pool_create(snd_pcm_direct_t *dmix ATTRIBUTE_UNUSED,
+				  unsigned int threads ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static void mix_areas_run(snd_pcm_direct_t *dmix,
+			  mix_areas_t *do_mix_areas,
+			  mix_gain_t *do_gain,
+			  unsigned int sample_size,
+			  const snd_pcm_channel_area_t *src_areas,
+			  const snd_pcm_channel_area_t *dst_areas,
+			  snd_pcm_uframes_t src_ofs,
+			  snd_pcm_uframes_t dst_ofs,
+			  snd_pcm_uframes_t size)
+{
+	mix_areas_part(dmix, do_mix_areas, do_gain, sample_size, src_areas,
+		       dst_areas, src_ofs, dst_ofs, size, 0, 1);
+}
+#endif /* HAVE_LIBPTHREAD */
+
+/*
+ * silent clients
+ *
+ * Mixing silence does not change the sum: a sample mixed onto a silent
+ * slave sample replaces the sum anyway.  So the blocks of an idle client
+ * that are all silence are not mixed (nor remixed at rewind), and the
+ * cost of the mixing follows the clients which actually play.
+ */
+
+/* the bytes are all equal to pattern, checked a word at a time */
+static int buffer_is_silence(const unsigned char *p, size_t len,
+			     unsigned char pattern)
+{
+	uint64_t pat = pattern * 0x0101010101010101ULL;
+	uint64_t w[8], acc;
+	unsigned int i;
+
+	while (len && ((uintptr_t)p & 7)) {
+		if (*p++ != pattern)
+			return 0;
+		len--;
+	}
+	/* no early exit inside the block, so that it is vectorized */
+	while (len >= sizeof(w)) {
+		memcpy(w, p, sizeof(w));
+		acc = 0;
+		for (i = 0; i < 8; i++)
+			acc |= w[i] ^ pat;
+		if (acc)
+			return 0;
+		p += sizeof(w);
+		len -= sizeof(w);
+	}
+	while (len--)
+		if (*p++ != pattern)
+			return 0;
+	return 1;
+}
+
+static int areas_are_silence(snd_pcm_direct_t *dmix,
+			     const snd_pcm_channel_area_t *areas,
+			     snd_pcm_uframes_t ofs, snd_pcm_uframes_t size,
+			     unsigned int sample_size)
+{
+	unsigned char pattern = snd_pcm_format_silence(dmix->shmptr->s.format);
+	unsigned int chn, channels = dmix->channels;
+	unsigned int bits = sample_size * 8;
+
+	for (chn = 0; chn < channels; chn++) {
+		if (areas[chn].addr != areas[0].addr ||
+		    areas[chn].step != channels * bits ||
+		    areas[chn].first != areas[0].first + chn * bits)
+			break;
+	}
+	if (chn == channels && areas[0].first % 8 == 0)
+		return buffer_is_silence((const unsigned char *)areas[0].addr +
+					 areas[0].first / 8 + ofs * sample_size * channels,
+					 size * sample_size * channels, pattern);
+	for (chn = 0; chn < channels; chn++) {
+		/* only the packed channels can be checked in one run */
+		if (areas[chn].step != bits || areas[chn].first % 8)
+			return 0;
+		if (!buffer_is_silence((const unsigned char *)areas[chn].addr +
+				       areas[chn].first / 8 + ofs * sample_size,
+				       size * sample_size, pattern))
+			return 0;
+	}
+	return 1;
+}
+
 static void mix_areas(snd_pcm_direct_t *dmix,
 		      const snd_pcm_channel_area_t *src_areas,
 		      const snd_pcm_channel_area_t *dst_areas,
@@ -159,11 +533,9 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		      snd_pcm_uframes_t dst_ofs,
 		      snd_pcm_uframes_t size)
 {
-	unsigned int src_step, dst_step;
-	unsigned int chn, dchn, channels, sample_size;
+	unsigned int sample_size;
 	mix_areas_t *do_mix_areas;
 	
-	channels = dmix->channels;
 	switch (dmix->shmptr->s.format) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -187,37 +559,23 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_u8;
 		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_float;
+		break;
+#endif
 	default:
 		return;
 	}
-	if (dmix->interleaved) {
-		/*
-		 * process all areas in one loop
-		 * it optimizes the memory accesses for this case
-		 */
-		do_mix_areas(size * channels,
-			     (unsigned char *)dst_areas[0].addr + sample_size * dst_ofs * channels,
-			     (unsigned char *)src_areas[0].addr + sample_size * src_ofs * channels,
-			     dmix->u.dmix.sum_buffer + dst_ofs * channels,
-			     sample_size,
-			     sample_size,
-			     sizeof(signed int));
+	if (areas_are_silence(dmix, src_areas, src_ofs, size, sample_size))
 		return;
-	}
-	for (chn = 0; chn < channels; chn++) {
-		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
-		if (dchn >= dmix->shmptr->s.channels)
-			continue;
-		src_step = src_areas[chn].step / 8;
-		dst_step = dst_areas[dchn].step / 8;
-		do_mix_areas(size,
-			     ((unsigned char *)dst_areas[dchn].addr + dst_areas[dchn].first / 8) + dst_ofs * dst_step,
-			     ((unsigned char *)src_areas[chn].addr + src_areas[chn].first / 8) + src_ofs * src_step,
-			     dmix->u.dmix.sum_buffer + dmix->shmptr->s.channels * dst_ofs + dchn,
-			     dst_step,
-			     src_step,
-			     dmix->shmptr->s.channels * sizeof(signed int));
-	}
+	/* a muted client adds nothing either */
+	if (dmix->u.dmix.gain == 0)
+		return;
+	mix_areas_run(dmix, do_mix_areas,
+		      dmix->u.dmix.gain != DMIX_GAIN_UNITY ? dmix->u.dmix.mix_gain : NULL,
+		      sample_size, src_areas, dst_areas, src_ofs, dst_ofs, size);
 }
 
 static void remix_areas(snd_pcm_direct_t *dmix,
@@ -227,11 +585,9 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 			snd_pcm_uframes_t dst_ofs,
 			snd_pcm_uframes_t size)
 {
-	unsigned int src_step, dst_step;
-	unsigned int chn, dchn, channels, sample_size;
+	unsigned int sample_size;
 	mix_areas_t *do_remix_areas;
 	
-	channels = dmix->channels;
 	switch (dmix->shmptr->s.format) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -255,37 +611,75 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_u8;
 		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_float;
+		break;
+#endif
 	default:
 		return;
 	}
-	if (dmix->interleaved) {
-		/*
-		 * process all areas in one loop
-		 * it optimizes the memory accesses for this case
-		 */
-		do_remix_areas(size * channels,
-			       (unsigned char *)dst_areas[0].addr + sample_size * dst_ofs * channels,
-			       (unsigned char *)src_areas[0].addr + sample_size * src_ofs * channels,
-			       dmix->u.dmix.sum_buffer + dst_ofs * channels,
-			       sample_size,
-			       sample_size,
-			       sizeof(signed int));
+	if (areas_are_silence(dmix, src_areas, src_ofs, size, sample_size))
+		return;
+	/* a muted client adds nothing either */
+	if (dmix->u.dmix.gain == 0)
 		return;
+	mix_areas_run(dmix, do_remix_areas,
+		      dmix->u.dmix.gain != DMIX_GAIN_UNITY ? dmix->u.dmix.remix_gain : NULL,
+		      sample_size, src_areas, dst_areas, src_ofs, dst_ofs, size);
+}
+
+/*
+ * history of the mixed samples (rewind_history option)
+ *
+ * A private interleaved copy of what this client has mixed, indexed by the
+ * slave position.  The rewind subtracts the samples from here, so it does
+ * not depend on the client buffer contents (which may have been changed
+ * by the application in the meantime) and the interleaved mixing path is
+ * used even for non-interleaved clients.
+ */
+static void history_free(snd_pcm_direct_t *dmix)
+{
+	free(dmix->u.dmix.history_areas);
+	dmix->u.dmix.history_areas = NULL;
+	free(dmix->u.dmix.history);
+	dmix->u.dmix.history = NULL;
+}
+
+static int history_create(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_channel_area_t *areas;
+	unsigned int chn, width;
+
+	width = snd_pcm_format_physical_width(dmix->shmptr->s.format);
+	dmix->u.dmix.history = calloc(dmix->slave_buffer_size,
+				      dmix->channels * width / 8);
+	areas = calloc(dmix->channels, sizeof(*areas));
+	dmix->u.dmix.history_areas = areas;
+	if (!dmix->u.dmix.history || !areas) {
+		history_free(dmix);
+		return -ENOMEM;
 	}
-	for (chn = 0; chn < channels; chn++) {
-		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
-		if (dchn >= dmix->shmptr->s.channels)
-			continue;
-		src_step = src_areas[chn].step / 8;
-		dst_step = dst_areas[dchn].step / 8;
-		do_remix_areas(size,
-			       ((unsigned char *)dst_areas[dchn].addr + dst_areas[dchn].first / 8) + dst_ofs * dst_step,
-			       ((unsigned char *)src_areas[chn].addr + src_areas[chn].first / 8) + src_ofs * src_step,
-			       dmix->u.dmix.sum_buffer + dmix->shmptr->s.channels * dst_ofs + dchn,
-			       dst_step,
-			       src_step,
-			       dmix->shmptr->s.channels * sizeof(signed int));
+	for (chn = 0; chn < dmix->channels; chn++) {
+		areas[chn].addr = dmix->u.dmix.history;
+		areas[chn].first = chn * width;
+		areas[chn].step = dmix->channels * width;
 	}
+	return 0;
+}
+
+static void history_store(snd_pcm_direct_t *dmix,
+			  const snd_pcm_channel_area_t *src_areas,
+			  snd_pcm_uframes_t src_ofs,
+			  snd_pcm_uframes_t dst_ofs,
+			  snd_pcm_uframes_t size)
+{
+	if (!dmix->u.dmix.history)
+		return;
+	snd_pcm_areas_copy(dmix->u.dmix.history_areas, dst_ofs, src_areas,
+			   src_ofs, dmix->channels, size,
+			   dmix->shmptr->s.format);
 }
 
 /*
@@ -313,8 +707,10 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
-	snd_pcm_uframes_t appl_ptr, size, transfer;
+	snd_pcm_uframes_t appl_ptr, size, transfer, frames;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
+	snd_htimestamp_t tstamp;
+	unsigned long long start;
 	
 	/* calculate the size to transfer */
 	/* check the available size in the local buffer
@@ -364,6 +760,9 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
 	dmix->slave_appl_ptr += size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
+	frames = size;
+	snd_pcm_direct_stats_start(dmix, &tstamp);
+	start = snd_pcm_profile_start(pcm);
 	dmix_down_sem(dmix);
 	for (;;) {
 		transfer = size;
@@ -372,6 +771,7 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
 		mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		history_store(dmix, src_areas, appl_ptr, slave_appl_ptr, transfer);
 		size -= transfer;
 		if (! size)
 			break;
@@ -381,6 +781,8 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 		appl_ptr %= pcm->buffer_size;
 	}
 	dmix_up_sem(dmix);
+	snd_pcm_profile_stop(pcm, start, frames);
+	snd_pcm_direct_stats_transfer(dmix, &tstamp, frames);
 }
 
 /*
@@ -403,16 +805,18 @@ static int snd_pcm_dmix_sync_ptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_ptr
 		return 0;
 	dmix->hw_ptr += diff;
 	dmix->hw_ptr %= pcm->boundary;
+	snd_pcm_direct_stats_update(pcm, dmix);
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
 	avail = snd_pcm_mmap_playback_avail(pcm);
 	if (avail > dmix->avail_max)
 		dmix->avail_max = avail;
 	if (avail >= pcm->stop_threshold) {
-		snd_timer_stop(dmix->timer);
+		snd_pcm_direct_timer_stop(dmix);
 		gettimestamp(&dmix->trigger_tstamp, pcm->tstamp_type);
 		if (dmix->state == SND_PCM_STATE_RUNNING) {
 			dmix->state = SND_PCM_STATE_XRUN;
+			snd_pcm_direct_stats_update(pcm, dmix);
 			return -EPIPE;
 		}
 		dmix->state = SND_PCM_STATE_SETUP;
@@ -542,7 +946,7 @@ static int snd_pcm_dmix_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 
 	snd_pcm_hwsync(dmix->spcm);
 	snd_pcm_direct_reset_slave_ptr(pcm, dmix, *dmix->spcm->hw.ptr);
-	err = snd_timer_start(dmix->timer);
+	err = snd_pcm_direct_timer_start(dmix);
 	if (err < 0)
 		return err;
 	dmix->state = SND_PCM_STATE_RUNNING;
@@ -724,20 +1128,36 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
 	dmix_down_sem(dmix);
-	for (;;) {
-		transfer = size;
-		if (appl_ptr + transfer > pcm->buffer_size)
-			transfer = pcm->buffer_size - appl_ptr;
-		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
-			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
-		size -= transfer;
-		if (! size)
-			break;
-		slave_appl_ptr += transfer;
-		slave_appl_ptr %= dmix->slave_buffer_size;
-		appl_ptr += transfer;
-		appl_ptr %= pcm->buffer_size;
+	if (dmix->u.dmix.history) {
+		/* the history is indexed by the slave position */
+		src_areas = dmix->u.dmix.history_areas;
+		for (;;) {
+			transfer = size;
+			if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
+				transfer = dmix->slave_buffer_size - slave_appl_ptr;
+			remix_areas(dmix, src_areas, dst_areas, slave_appl_ptr, slave_appl_ptr, transfer);
+			size -= transfer;
+			if (! size)
+				break;
+			slave_appl_ptr += transfer;
+			slave_appl_ptr %= dmix->slave_buffer_size;
+		}
+	} else {
+		for (;;) {
+			transfer = size;
+			if (appl_ptr + transfer > pcm->buffer_size)
+				transfer = pcm->buffer_size - appl_ptr;
+			if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
+				transfer = dmix->slave_buffer_size - slave_appl_ptr;
+			remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+			size -= transfer;
+			if (! size)
+				break;
+			slave_appl_ptr += transfer;
+			slave_appl_ptr %= dmix->slave_buffer_size;
+			appl_ptr += transfer;
+			appl_ptr %= pcm->buffer_size;
+		}
 	}
 	dmix_up_sem(dmix);
 
@@ -780,8 +1200,9 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 
-	if (dmix->timer)
-		snd_timer_close(dmix->timer);
+	snd_pcm_direct_timer_discard(dmix);
+	mix_pool_free(dmix);
+	history_free(dmix);
 	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
 	snd_pcm_close(dmix->spcm);
  	if (dmix->server)
@@ -789,6 +1210,7 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
  	if (dmix->client)
  		snd_pcm_direct_client_discard(dmix);
  	shm_sum_discard(dmix);
+	snd_pcm_direct_stats_detach(dmix);
 	if (snd_pcm_direct_shm_discard(dmix)) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
 			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
@@ -889,6 +1311,7 @@ static void snd_pcm_dmix_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_direct_stats_dump(pcm, out);
 	if (dmix->spcm)
 		snd_pcm_dump(dmix->spcm, out);
 }
@@ -942,6 +1365,67 @@ static const snd_pcm_fast_ops_t snd_pcm_dmix_fast_ops = {
 	.poll_revents = snd_pcm_dmix_poll_revents,
 };
 
+/**
+ * \brief Set the gain of a dmix client
+ * \param pcm dmix PCM handle
+ * \param db Gain in 0.01dB, at most +24dB, #SND_CTL_TLV_DB_GAIN_MUTE
+ *        or less mutes the client
+ * \return 0 on success otherwise a negative error code
+ *
+ * The samples of this client are scaled while they are mixed, which
+ * replaces a separate softvol plugin in front of dmix.  Each client has
+ * its own gain.  A new gain applies to the frames committed after the
+ * call.  The gain is available for the S16, S32 and FLOAT formats of the
+ * slave; -EINVAL is returned for the other formats, unless \a db is 0.
+ * A build without floating point accepts only 0 and the mute.
+ */
+int snd_pcm_dmix_set_gain(snd_pcm_t *pcm, long db)
+{
+	snd_pcm_direct_t *dmix;
+	int gain;
+
+	assert(pcm);
+	if (pcm->type != SND_PCM_TYPE_DMIX || db > 2400)
+		return -EINVAL;
+	dmix = pcm->private_data;
+	if (db <= SND_CTL_TLV_DB_GAIN_MUTE)
+		gain = 0;
+#ifndef HAVE_SOFT_FLOAT
+	else
+		gain = (int)(DMIX_GAIN_UNITY * pow(10.0, db / 2000.0) + 0.5);
+#else
+	else if (db == 0)
+		gain = DMIX_GAIN_UNITY;
+	else
+		return -EINVAL;
+#endif
+	if (gain != DMIX_GAIN_UNITY && !dmix->u.dmix.mix_gain)
+		return -EINVAL;
+	snd_pcm_lock(pcm);
+	dmix->u.dmix.gain = gain;
+	dmix->u.dmix.gain_db = db;
+	snd_pcm_unlock(pcm);
+	return 0;
+}
+
+/**
+ * \brief Get the gain of a dmix client
+ * \param pcm dmix PCM handle
+ * \param db Returns the gain in 0.01dB as set by snd_pcm_dmix_set_gain()
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_dmix_get_gain(snd_pcm_t *pcm, long *db)
+{
+	snd_pcm_direct_t *dmix;
+
+	assert(pcm && db);
+	if (pcm->type != SND_PCM_TYPE_DMIX)
+		return -EINVAL;
+	dmix = pcm->private_data;
+	*db = dmix->u.dmix.gain_db;
+	return 0;
+}
+
 /**
  * \brief Creates a new dmix PCM
  * \param pcmp Returns created PCM handle
@@ -989,6 +1473,9 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	dmix->hw_ptr_alignment = opts->hw_ptr_alignment;
 	dmix->sync_ptr = snd_pcm_dmix_sync_ptr;
 	dmix->direct_memory_access = opts->direct_memory_access;
+	dmix->u.dmix.lockless_mix = opts->lockless_mix;
+	dmix->u.dmix.gain = DMIX_GAIN_UNITY;
+	dmix->u.dmix.hugepages = opts->hugepages;
 
  retry:
 	if (first_instance) {
@@ -1086,7 +1573,22 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	}
 
 	mix_select_callbacks(dmix);
-		
+	gain_select_callbacks(dmix);
+	if (opts->gain_db) {
+		ret = snd_pcm_dmix_set_gain(pcm, opts->gain_db);
+		if (ret < 0) {
+			SNDERR("gain is not supported for the format %s",
+			       snd_pcm_format_name(dmix->shmptr->s.format));
+			goto _err;
+		}
+	}
+
+	ret = mix_pool_create(dmix, opts->mix_threads);
+	if (ret < 0) {
+		SNDERR("unable to create mixing threads");
+		goto _err;
+	}
+
 	pcm->poll_fd = dmix->poll_fd;
 	pcm->poll_events = POLLIN;	/* it's different than other plugins */
 	pcm->tstamp_type = spcm->tstamp_type;
@@ -1097,14 +1599,23 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	if (dmix->channels == UINT_MAX)
 		dmix->channels = dmix->shmptr->s.channels;
 
+	if (opts->rewind_history) {
+		ret = history_create(dmix);
+		if (ret < 0) {
+			SNDERR("unable to allocate rewind history");
+			goto _err;
+		}
+	}
+
 	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 
 	*pcmp = pcm;
 	return 0;
 	
  _err:
-	if (dmix->timer)
-		snd_timer_close(dmix->timer);
+	mix_pool_free(dmix);
+	history_free(dmix);
+	snd_pcm_direct_timer_discard(dmix);
 	if (dmix->server)
 		snd_pcm_direct_server_discard(dmix);
 	if (dmix->client)
@@ -1113,12 +1624,14 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_close(spcm);
 	if (dmix->u.dmix.shmid_sum >= 0)
 		shm_sum_discard(dmix);
+	snd_pcm_direct_stats_detach(dmix);
 	if ((dmix->shmid >= 0) && (snd_pcm_direct_shm_discard(dmix))) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
 			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
 	} else
 		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
  _err_nosem:
+	snd_pcm_direct_stats_detach(dmix);
 	free(dmix->bindings);
 	free(dmix);
 	snd_pcm_free(pcm);
@@ -1133,6 +1646,11 @@ This plugin provides direct mixing of multiple streams. The resolution
 for 32-bit mixing is only 24-bit. The low significant byte is filled with
 zeros. The extra 8 bits are used for the saturation.
 
+The native endian \c FLOAT format is mixed in floating point. The sum
+buffer keeps the unclipped values and the output is clipped to the
+range -1.0 to 1.0, so a float slave does not need a conversion in
+front of the mixer.
+
 \code
 pcm.name {
 	type dmix		# Direct mix
@@ -1169,6 +1687,24 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	lockless_mix BOOL	# mix with atomic operations instead of
+				# the semaphore (S16 and S32 only)
+	gain REAL		# gain of this client in dB (at most 24)
+	mix_threads INT		# number of threads used for mixing
+				# (default 0 = mix in the caller only)
+	rewind_history BOOL	# keep a copy of the mixed samples for rewind
+	hugepages BOOL		# allocate the sum buffer with huge pages
+	prefault BOOL		# fault in the shared memory pages at open
+	shared_wakeup BOOL	# wake up the clients from one server process
+	period_timer BOOL	# wake up this client with its own timer
+				# at the client period
+	slave_period_wakeup BOOL # period interrupts of the slave
+				# (default yes)
+	thread_policy STR	# scheduling of the helpers: other, fifo or rr
+	thread_priority INT	# priority for fifo and rr
+	cpu_affinity INT	# CPU of the helpers
+	# or
+	cpu_affinity STR	# CPU list like "0,2-3"
 }
 \endcode
 
@@ -1201,6 +1737,95 @@ the possible configurations:
   case of a dependency to another sound device (e.g. forwarding of
   microphone to speaker). Else "no" will be chosen.
 
+When the mixing is protected by the semaphore (the default, unless
+<code>direct_memory_access</code> is set), the S16, S32 and S24_LE
+mixing routines for interleaved buffers use SSE2, AVX2 or NEON
+instructions if the CPU supports them. The instruction set is detected
+at open time, the generic code is used otherwise.
+
+<code>lockless_mix</code> lets the clients mix into the shared sum
+buffer concurrently using atomic operations, so the clients do not
+serialize on the IPC semaphore. It is available for the native endian
+S16 and S32 formats when the compiler supports the atomic builtins,
+other formats fall back to the semaphore protected mixing. All clients
+of one dmix instance must use the same setting.
+
+<code>gain</code> scales the samples of the client while they are mixed,
+so a per-stream volume does not need a softvol plugin with its extra
+pass over the buffer.  The gain can be changed at run time with
+snd_pcm_dmix_set_gain().  It is available for the S16, S32 and FLOAT
+slave formats; the SIMD and assembler mixing routines are used only
+while the gain is 0dB.
+
+<code>mix_threads</code> splits each mixing call into parts which are
+processed in parallel by the calling thread and a pool of worker
+threads (the given number includes the caller). Interleaved buffers
+are split by frames, non-interleaved buffers by channels. The workers
+are woken up only for large transfers, which makes this useful mainly
+for cards with many channels.
+
+<code>thread_policy</code>, <code>thread_priority</code> and
+<code>cpu_affinity</code> set the scheduling of the helpers of the
+plugin: the mix workers and the server process sharing the slave
+between the clients (which also wakes them with
+<code>shared_wakeup</code>).  By default they inherit the scheduling of
+the thread opening the PCM.  A real-time policy needs the permission
+(e.g. RLIMIT_RTPRIO); when it is refused, an error is reported and the
+helper runs with the inherited scheduling.
+
+<code>rewind_history</code> keeps a private copy of the samples which
+the client has mixed into the slave buffer. A rewind subtracts the
+samples from this copy instead of the application buffer, so the result
+is exact even when the application has modified the already committed
+area, and the remix always runs on an interleaved buffer. The cost is
+one extra copy of each mixed period and a buffer of the slave buffer
+size per client. This is useful for clients which rewind often, like
+sound servers with timer based scheduling.
+
+<code>hugepages</code> allocates the shared sum buffer with huge pages
+(SHM_HUGETLB), which avoids the TLB misses during mixing of large
+buffers. The huge pages must be reserved in the system (see
+/proc/sys/vm/nr_hugepages) and the user must be allowed to use them
+(/proc/sys/vm/hugetlb_shm_group), otherwise the normal pages are used.
+The first client decides about the page type of the segment.
+<code>prefault</code> lets each client fault in all pages of the shared
+memory segments at open time, so that the mixing code does not hit the
+page faults later. Note that the segments are always locked with
+mlock(), when the RLIMIT_MEMLOCK resource limit allows it.
+
+<code>shared_wakeup</code> starts the helper server process, which reads
+the slave PCM timer once and wakes up each client through its own
+eventfd, instead of each client driving its own instance of the slave
+timer. This saves the timer ioctls and wakeups with many clients on one
+card. The setting of the first client is used for the whole instance.
+The clients cannot use the async (signal) notification in this mode.
+The dsnoop and dshare plugins support this option as well.
+
+Normally a client wakes up at the slave period boundaries only, so its
+period must be a multiple of the slave period.  <code>period_timer</code>
+gives the client its own high resolution timer running at the client
+period instead: the period (down to 1 ms) and the buffer of each client
+are then independent of the slave period, so a low-latency client can
+share the card with clients using long periods.  Such a client starts
+on the current slave position unless <code>hw_ptr_alignment</code> says
+otherwise.  With <code>slave_period_wakeup</code> set to false, the slave
+is set up without the period interrupts (when the hardware can do that)
+and all clients use their own timers; the first client decides.  The
+latency is still bounded by the granularity of the slave hardware
+pointer.  The async notification is not available with the client timer.
+The dsnoop and dshare plugins support these options as well.
+
+The direct plugins keep statistics for each client (state, xruns,
+avail frames and the time spent in the ring buffer transfers) in the
+shared memory of the instance. Monitoring tools can read the statistics
+of all clients with snd_pcm_direct_stats_read() using any handle of the
+instance.  snd_pcm_direct_stats_total() returns the totals of the
+instance since the slave was opened, the closed clients included: the
+frames mixed (dmix) or copied (dsnoop, dshare) and the time spent on
+them, and the work of the server forwarding the shared wakeups.
+snd_pcm_dump() prints the same totals, and test/direct-stats shows them
+for each card.
+
 Note that the dmix plugin itself supports only a single configuration.
 That is, it supports only the fixed rate (default 48000), format
 (\c S16), channels (2), and period_time (125000).
@@ -118,11 +118,16 @@ static void mix_select_callbacks(snd_pcm_direct_t *dmix)
 #else
 
 /* non-concurrent version, supporting both endians */
+#ifndef HAVE_SOFT_FLOAT
+#define generic_dmix_float_format	(1ULL << SND_PCM_FORMAT_FLOAT)
+#else
+#define generic_dmix_float_format	0
+#endif
 #define generic_dmix_supported_format \
 	((1ULL << SND_PCM_FORMAT_S16_LE) | (1ULL << SND_PCM_FORMAT_S32_LE) |\
 	 (1ULL << SND_PCM_FORMAT_S16_BE) | (1ULL << SND_PCM_FORMAT_S32_BE) |\
 	 (1ULL << SND_PCM_FORMAT_S24_LE) | (1ULL << SND_PCM_FORMAT_S24_3LE) | \
-	 (1ULL << SND_PCM_FORMAT_U8))
+	 (1ULL << SND_PCM_FORMAT_U8) | generic_dmix_float_format)
 
 #include "bswap.h"
 
@@ -510,7 +515,525 @@ static void generic_remix_areas_u8(unsigned int size,
 		sum = (signed int *) ((char *)sum + sum_step);
 	}
 }
+#ifndef HAVE_SOFT_FLOAT
+/*
+ * native endian float, the sum buffer holds the unclipped float values
+ * so there is no overflow while mixing, the output is clipped to +-1.0
+ */
+static void generic_mix_areas_float(unsigned int size,
+				    volatile float *dst,
+				    float *src,
+				    volatile float *sum,
+				    size_t dst_step,
+				    size_t src_step,
+				    size_t sum_step)
+{
+	register float sample;
+
+	for (;;) {
+		sample = *src;
+		if (*dst == 0.0f) {
+			*sum = sample;
+		} else {
+			sample += *sum;
+			*sum = sample;
+		}
+		if (sample > 1.0f)
+			sample = 1.0f;
+		else if (sample < -1.0f)
+			sample = -1.0f;
+		*dst = sample;
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
 
+static void generic_remix_areas_float(unsigned int size,
+				      volatile float *dst,
+				      float *src,
+				      volatile float *sum,
+				      size_t dst_step,
+				      size_t src_step,
+				      size_t sum_step)
+{
+	register float sample;
+
+	for (;;) {
+		sample = *src;
+		if (*dst == 0.0f)
+			sample = -sample;
+		else
+			sample = *sum - sample;
+		*sum = sample;
+		if (sample > 1.0f)
+			sample = 1.0f;
+		else if (sample < -1.0f)
+			sample = -1.0f;
+		*dst = sample;
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
+#endif
+
+#ifdef HAVE_GCC_ATOMICS
+/*
+ * lockless versions used with the lockless_mix option (native endian only)
+ *
+ * this is the same protocol as used in the i386/x86-64 assembler code:
+ * the first writer to a cleared destination sample marks it with
+ * cmpxchg and drops the old sum, then the sample is accumulated with
+ * an atomic add and the destination is rewritten until the sum is stable
+ */
+static inline int atomic_claim_16(volatile signed short *dst)
+{
+	signed short zero = 0;
+
+	return __atomic_compare_exchange_n(dst, &zero, 1, 0,
+					   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static inline int atomic_claim_32(volatile signed int *dst)
+{
+	signed int zero = 0;
+
+	return __atomic_compare_exchange_n(dst, &zero, 1, 0,
+					   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static void atomic_mix_areas_16(unsigned int size,
+				volatile signed short *dst,
+				signed short *src,
+				volatile signed int *sum,
+				size_t dst_step,
+				size_t src_step,
+				size_t sum_step)
+{
+	register signed int sample, old_sample;
+
+	for (;;) {
+		sample = *src;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		if (atomic_claim_16(dst))
+			sample -= old_sample;
+		__atomic_add_fetch(sum, sample, __ATOMIC_SEQ_CST);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+			if (old_sample > 0x7fff)
+				sample = 0x7fff;
+			else if (old_sample < -0x8000)
+				sample = -0x8000;
+			else
+				sample = old_sample;
+			__atomic_store_n(dst, sample, __ATOMIC_RELAXED);
+		} while (__atomic_load_n(sum, __ATOMIC_SEQ_CST) != old_sample);
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static void atomic_remix_areas_16(unsigned int size,
+				  volatile signed short *dst,
+				  signed short *src,
+				  volatile signed int *sum,
+				  size_t dst_step,
+				  size_t src_step,
+				  size_t sum_step)
+{
+	register signed int sample, old_sample;
+
+	for (;;) {
+		sample = *src;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		if (atomic_claim_16(dst))
+			sample += old_sample;
+		__atomic_sub_fetch(sum, sample, __ATOMIC_SEQ_CST);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+			if (old_sample > 0x7fff)
+				sample = 0x7fff;
+			else if (old_sample < -0x8000)
+				sample = -0x8000;
+			else
+				sample = old_sample;
+			__atomic_store_n(dst, sample, __ATOMIC_RELAXED);
+		} while (__atomic_load_n(sum, __ATOMIC_SEQ_CST) != old_sample);
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static void atomic_mix_areas_32(unsigned int size,
+				volatile signed int *dst,
+				signed int *src,
+				volatile signed int *sum,
+				size_t dst_step,
+				size_t src_step,
+				size_t sum_step)
+{
+	register signed int sample, old_sample;
+
+	for (;;) {
+		sample = *src >> 8;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		if (atomic_claim_32(dst))
+			sample -= old_sample;
+		__atomic_add_fetch(sum, sample, __ATOMIC_SEQ_CST);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+			if (old_sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (old_sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample = old_sample * 256;
+			__atomic_store_n(dst, sample, __ATOMIC_RELAXED);
+		} while (__atomic_load_n(sum, __ATOMIC_SEQ_CST) != old_sample);
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+static void atomic_remix_areas_32(unsigned int size,
+				  volatile signed int *dst,
+				  signed int *src,
+				  volatile signed int *sum,
+				  size_t dst_step,
+				  size_t src_step,
+				  size_t sum_step)
+{
+	register signed int sample, old_sample;
+
+	for (;;) {
+		sample = *src >> 8;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		if (atomic_claim_32(dst))
+			sample += old_sample;
+		__atomic_sub_fetch(sum, sample, __ATOMIC_SEQ_CST);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+			if (old_sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (old_sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample = old_sample * 256;
+			__atomic_store_n(dst, sample, __ATOMIC_RELAXED);
+		} while (__atomic_load_n(sum, __ATOMIC_SEQ_CST) != old_sample);
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+#define atomic_dmix_supported_format \
+	((1ULL << SND_PCM_FORMAT_S16) | (1ULL << SND_PCM_FORMAT_S32))
+
+/*
+ * select the lockless callbacks, returns zero if the format cannot be
+ * mixed without the semaphore
+ */
+static int atomic_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	if (!((1ULL << dmix->shmptr->s.format) & atomic_dmix_supported_format))
+		return 0;
+	dmix->u.dmix.mix_areas_16 = atomic_mix_areas_16;
+	dmix->u.dmix.mix_areas_32 = atomic_mix_areas_32;
+	dmix->u.dmix.remix_areas_16 = atomic_remix_areas_16;
+	dmix->u.dmix.remix_areas_32 = atomic_remix_areas_32;
+	dmix->u.dmix.use_sem = 0;
+	return 1;
+}
+#else
+static inline int atomic_mix_select_callbacks(snd_pcm_direct_t *dmix ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+#endif /* HAVE_GCC_ATOMICS */
+
+/*
+ * mixing with the client gain
+ *
+ * The samples are scaled while they are accumulated, so the volume of a
+ * client costs no extra pass over its buffer.  The same protocols as in
+ * the versions without the gain are used: the semaphore protected code
+ * for any byte order, the atomic one when the semaphore is not used (the
+ * lockless_mix option or the assembler code).  A remix subtracts the
+ * samples scaled by the current gain, so a rewind over a gain change
+ * leaves a small difference in the already mixed part.
+ */
+static inline signed int gain_scale(signed int sample, int gain)
+{
+	return (signed int)(((long long)sample * gain) >> 16);
+}
+
+static inline void gain_mix_16(unsigned int size,
+			       volatile signed short *dst, signed short *src,
+			       volatile signed int *sum, size_t dst_step,
+			       size_t src_step, size_t sum_step, int gain,
+			       int remix, int swap)
+{
+	register signed int sample;
+
+	for (;;) {
+		sample = swap ? (signed short) bswap_16(*src) : *src;
+		sample = gain_scale(sample, gain);
+		if (remix)
+			sample = -sample;
+		/* a cleared destination drops the old sum, in both byte orders */
+		if (*dst)
+			sample += *sum;
+		*sum = sample;
+		if (sample > 0x7fff)
+			sample = 0x7fff;
+		else if (sample < -0x8000)
+			sample = -0x8000;
+		*dst = swap ? (signed short) bswap_16((signed short) sample) : sample;
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static inline void gain_mix_32(unsigned int size,
+			       volatile signed int *dst, signed int *src,
+			       volatile signed int *sum, size_t dst_step,
+			       size_t src_step, size_t sum_step, int gain,
+			       int remix, int swap)
+{
+	register signed int sample;
+
+	for (;;) {
+		sample = (swap ? (signed int) bswap_32(*src) : *src) >> 8;
+		sample = gain_scale(sample, gain);
+		if (remix)
+			sample = -sample;
+		if (*dst)
+			sample += *sum;
+		*sum = sample;
+		if (sample > 0x7fffff)
+			sample = 0x7fffffff;
+		else if (sample < -0x800000)
+			sample = -0x80000000;
+		else
+			sample *= 256;
+		*dst = swap ? (signed int) bswap_32(sample) : sample;
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+#define GAIN_MIX(name, helper, type, sum_type, remix, swap) \
+static void name(unsigned int size, volatile void *dst, void *src, \
+		 volatile void *sum, size_t dst_step, size_t src_step, \
+		 size_t sum_step, int gain) \
+{ \
+	helper(size, (volatile type *)dst, (type *)src, \
+	       (volatile sum_type *)sum, dst_step, src_step, sum_step, \
+	       gain, remix, swap); \
+}
+
+GAIN_MIX(gain_mix_areas_16_native, gain_mix_16, signed short, signed int, 0, 0)
+GAIN_MIX(gain_remix_areas_16_native, gain_mix_16, signed short, signed int, 1, 0)
+GAIN_MIX(gain_mix_areas_16_swap, gain_mix_16, signed short, signed int, 0, 1)
+GAIN_MIX(gain_remix_areas_16_swap, gain_mix_16, signed short, signed int, 1, 1)
+GAIN_MIX(gain_mix_areas_32_native, gain_mix_32, signed int, signed int, 0, 0)
+GAIN_MIX(gain_remix_areas_32_native, gain_mix_32, signed int, signed int, 1, 0)
+GAIN_MIX(gain_mix_areas_32_swap, gain_mix_32, signed int, signed int, 0, 1)
+GAIN_MIX(gain_remix_areas_32_swap, gain_mix_32, signed int, signed int, 1, 1)
+
+#ifndef HAVE_SOFT_FLOAT
+static inline void gain_mix_float(unsigned int size,
+				  volatile float *dst, float *src,
+				  volatile float *sum, size_t dst_step,
+				  size_t src_step, size_t sum_step, int gain,
+				  int remix, int swap ATTRIBUTE_UNUSED)
+{
+	float g = (float)gain / DMIX_GAIN_UNITY;
+	register float sample;
+
+	for (;;) {
+		sample = *src * g;
+		if (remix)
+			sample = -sample;
+		if (*dst != 0.0f)
+			sample += *sum;
+		*sum = sample;
+		if (sample > 1.0f)
+			sample = 1.0f;
+		else if (sample < -1.0f)
+			sample = -1.0f;
+		*dst = sample;
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
+
+GAIN_MIX(gain_mix_areas_float, gain_mix_float, float, float, 0, 0)
+GAIN_MIX(gain_remix_areas_float, gain_mix_float, float, float, 1, 0)
+#endif
+
+#ifdef HAVE_GCC_ATOMICS
+static inline void atomic_gain_mix_16(unsigned int size,
+				      volatile signed short *dst,
+				      signed short *src,
+				      volatile signed int *sum,
+				      size_t dst_step, size_t src_step,
+				      size_t sum_step, int gain, int remix,
+				      int swap ATTRIBUTE_UNUSED)
+{
+	register signed int sample, old_sample;
+
+	for (;;) {
+		sample = gain_scale(*src, gain);
+		if (remix)
+			sample = -sample;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		if (atomic_claim_16(dst))
+			sample -= old_sample;
+		__atomic_add_fetch(sum, sample, __ATOMIC_SEQ_CST);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+			if (old_sample > 0x7fff)
+				sample = 0x7fff;
+			else if (old_sample < -0x8000)
+				sample = -0x8000;
+			else
+				sample = old_sample;
+			__atomic_store_n(dst, sample, __ATOMIC_RELAXED);
+		} while (__atomic_load_n(sum, __ATOMIC_SEQ_CST) != old_sample);
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static inline void atomic_gain_mix_32(unsigned int size,
+				      volatile signed int *dst,
+				      signed int *src,
+				      volatile signed int *sum,
+				      size_t dst_step, size_t src_step,
+				      size_t sum_step, int gain, int remix,
+				      int swap ATTRIBUTE_UNUSED)
+{
+	register signed int sample, old_sample;
+
+	for (;;) {
+		sample = gain_scale(*src >> 8, gain);
+		if (remix)
+			sample = -sample;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		if (atomic_claim_32(dst))
+			sample -= old_sample;
+		__atomic_add_fetch(sum, sample, __ATOMIC_SEQ_CST);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+			if (old_sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (old_sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample = old_sample * 256;
+			__atomic_store_n(dst, sample, __ATOMIC_RELAXED);
+		} while (__atomic_load_n(sum, __ATOMIC_SEQ_CST) != old_sample);
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+GAIN_MIX(atomic_gain_mix_areas_16, atomic_gain_mix_16, signed short, signed int, 0, 0)
+GAIN_MIX(atomic_gain_remix_areas_16, atomic_gain_mix_16, signed short, signed int, 1, 0)
+GAIN_MIX(atomic_gain_mix_areas_32, atomic_gain_mix_32, signed int, signed int, 0, 0)
+GAIN_MIX(atomic_gain_remix_areas_32, atomic_gain_mix_32, signed int, signed int, 1, 0)
+#endif /* HAVE_GCC_ATOMICS */
+
+#undef GAIN_MIX
+
+/*
+ * select the gain callbacks matching the mixing protocol chosen by
+ * mix_select_callbacks(), they stay NULL when the format has none
+ */
+static void gain_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_format_t format = dmix->shmptr->s.format;
+	int native = snd_pcm_format_cpu_endian(format);
+
+	dmix->u.dmix.mix_gain = NULL;
+	dmix->u.dmix.remix_gain = NULL;
+	if (!dmix->u.dmix.use_sem) {
+#ifdef HAVE_GCC_ATOMICS
+		if (!native)
+			return;
+		switch (format) {
+		case SND_PCM_FORMAT_S16_LE:
+		case SND_PCM_FORMAT_S16_BE:
+			dmix->u.dmix.mix_gain = atomic_gain_mix_areas_16;
+			dmix->u.dmix.remix_gain = atomic_gain_remix_areas_16;
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+		case SND_PCM_FORMAT_S32_BE:
+			dmix->u.dmix.mix_gain = atomic_gain_mix_areas_32;
+			dmix->u.dmix.remix_gain = atomic_gain_remix_areas_32;
+			break;
+		default:
+			break;
+		}
+#endif
+		return;
+	}
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		dmix->u.dmix.mix_gain = native ? gain_mix_areas_16_native : gain_mix_areas_16_swap;
+		dmix->u.dmix.remix_gain = native ? gain_remix_areas_16_native : gain_remix_areas_16_swap;
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		dmix->u.dmix.mix_gain = native ? gain_mix_areas_32_native : gain_mix_areas_32_swap;
+		dmix->u.dmix.remix_gain = native ? gain_remix_areas_32_native : gain_remix_areas_32_swap;
+		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		dmix->u.dmix.mix_gain = gain_mix_areas_float;
+		dmix->u.dmix.remix_gain = gain_remix_areas_float;
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+#include "pcm_dmix_simd.c"
 
 static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 {
@@ -529,7 +1052,14 @@ static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 	dmix->u.dmix.mix_areas_u8 = generic_mix_areas_u8;
 	dmix->u.dmix.remix_areas_24 = generic_remix_areas_24;
 	dmix->u.dmix.remix_areas_u8 = generic_remix_areas_u8;
+#ifndef HAVE_SOFT_FLOAT
+	dmix->u.dmix.mix_areas_float = generic_mix_areas_float;
+	dmix->u.dmix.remix_areas_float = generic_remix_areas_float;
+#endif
 	dmix->u.dmix.use_sem = 1;
+	if (dmix->u.dmix.lockless_mix && atomic_mix_select_callbacks(dmix))
+		return;
+	simd_mix_select_callbacks(dmix);
 }
 
 #endif
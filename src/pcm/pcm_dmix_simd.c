@@ -0,0 +1,330 @@
+/*
+ * SIMD optimized mixing code (SSE2, AVX2 and NEON)
+ *
+ * These routines replace the generic non-concurrent ones when the CPU
+ * supports the instruction set.  They still require the client semaphore.
+ * Only the contiguous case (interleaved buffers) is vectorized, everything
+ * else is passed to the generic code.
+ */
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define DMIX_SIMD_X86
+#include <immintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && \
+      __BYTE_ORDER == __LITTLE_ENDIAN
+#define DMIX_SIMD_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON	(1 << 12)
+#endif
+#endif
+#endif
+
+#ifdef DMIX_SIMD_X86
+
+/*
+ *  SSE2
+ */
+#define SIMD_TARGET		__attribute__((target("sse2")))
+#define V_TYPE			__m128i
+#define V_LANES			4
+#define V_LOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v)		_mm_storeu_si128((__m128i *)(p), v)
+#define V_ADD(a, b)		_mm_add_epi32(a, b)
+#define V_SUB(a, b)		_mm_sub_epi32(a, b)
+#define V_AND(a, b)		_mm_and_si128(a, b)
+#define V_ANDNOT(m, v)		_mm_andnot_si128(m, v)
+#define V_OR(a, b)		_mm_or_si128(a, b)
+#define V_SET1(x)		_mm_set1_epi32(x)
+#define V_SRAI(v, n)		_mm_srai_epi32(v, n)
+#define V_SLLI(v, n)		_mm_slli_epi32(v, n)
+#define V_CMPEQ0(v)		_mm_cmpeq_epi32(v, _mm_setzero_si128())
+#define V_CMPGT(a, b)		_mm_cmpgt_epi32(a, b)
+#define V_BLEND(m, a, b)	_mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+#define V_SWAP16(t)		_mm_or_si128(_mm_slli_epi16(t, 8), _mm_srli_epi16(t, 8))
+#define V_WIDEN16(t)		_mm_srai_epi32(_mm_unpacklo_epi16(t, t), 16)
+#define V_LOAD16(p)		V_WIDEN16(_mm_loadl_epi64((const __m128i *)(p)))
+#define V_LOAD16_SWAP(p)	V_WIDEN16(V_SWAP16(_mm_loadl_epi64((const __m128i *)(p))))
+#define V_STORE16(p, v)		_mm_storel_epi64((__m128i *)(p), _mm_packs_epi32(v, v))
+#define V_STORE16_SWAP(p, v)	_mm_storel_epi64((__m128i *)(p), V_SWAP16(_mm_packs_epi32(v, v)))
+#define V_BSWAP32(v) \
+	_mm_or_si128(_mm_or_si128(_mm_slli_epi32(v, 24), _mm_srli_epi32(v, 24)), \
+		     _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 8), _mm_set1_epi32(0xff0000)), \
+				  _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xff00))))
+
+#define MIX_AREAS_16 sse2_mix_areas_16_native
+#define MIX_AREAS_32 sse2_mix_areas_32_native
+#define MIX_AREAS_24 sse2_mix_areas_24
+#define SIMD_REMIX 0
+#define SIMD_SWAP 0
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef MIX_AREAS_24
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 sse2_remix_areas_16_native
+#define MIX_AREAS_32 sse2_remix_areas_32_native
+#define MIX_AREAS_24 sse2_remix_areas_24
+#define SIMD_REMIX 1
+#define SIMD_SWAP 0
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef MIX_AREAS_24
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 sse2_mix_areas_16_swap
+#define MIX_AREAS_32 sse2_mix_areas_32_swap
+#define SIMD_REMIX 0
+#define SIMD_SWAP 1
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 sse2_remix_areas_16_swap
+#define MIX_AREAS_32 sse2_remix_areas_32_swap
+#define SIMD_REMIX 1
+#define SIMD_SWAP 1
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#undef SIMD_TARGET
+#undef V_TYPE
+#undef V_LANES
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_AND
+#undef V_ANDNOT
+#undef V_OR
+#undef V_SET1
+#undef V_SRAI
+#undef V_SLLI
+#undef V_CMPEQ0
+#undef V_CMPGT
+#undef V_BLEND
+#undef V_SWAP16
+#undef V_WIDEN16
+#undef V_LOAD16
+#undef V_LOAD16_SWAP
+#undef V_STORE16
+#undef V_STORE16_SWAP
+#undef V_BSWAP32
+
+/*
+ *  AVX2
+ */
+#define SIMD_TARGET		__attribute__((target("avx2")))
+#define V_TYPE			__m256i
+#define V_LANES			8
+#define V_LOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v)		_mm256_storeu_si256((__m256i *)(p), v)
+#define V_ADD(a, b)		_mm256_add_epi32(a, b)
+#define V_SUB(a, b)		_mm256_sub_epi32(a, b)
+#define V_AND(a, b)		_mm256_and_si256(a, b)
+#define V_ANDNOT(m, v)		_mm256_andnot_si256(m, v)
+#define V_OR(a, b)		_mm256_or_si256(a, b)
+#define V_SET1(x)		_mm256_set1_epi32(x)
+#define V_SRAI(v, n)		_mm256_srai_epi32(v, n)
+#define V_SLLI(v, n)		_mm256_slli_epi32(v, n)
+#define V_CMPEQ0(v)		_mm256_cmpeq_epi32(v, _mm256_setzero_si256())
+#define V_CMPGT(a, b)		_mm256_cmpgt_epi32(a, b)
+#define V_BLEND(m, a, b)	_mm256_blendv_epi8(b, a, m)
+#define V_SWAP16(t)		_mm_or_si128(_mm_slli_epi16(t, 8), _mm_srli_epi16(t, 8))
+/* packs works per 128-bit lane, gather the two low quadwords */
+#define V_NARROW16(v) \
+	_mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packs_epi32(v, v), 0x08))
+#define V_LOAD16(p)		_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#define V_LOAD16_SWAP(p)	_mm256_cvtepi16_epi32(V_SWAP16(_mm_loadu_si128((const __m128i *)(p))))
+#define V_STORE16(p, v)		_mm_storeu_si128((__m128i *)(p), V_NARROW16(v))
+#define V_STORE16_SWAP(p, v)	_mm_storeu_si128((__m128i *)(p), V_SWAP16(V_NARROW16(v)))
+#define V_BSWAP32(v) \
+	_mm256_shuffle_epi8(v, _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, \
+					       4, 5, 6, 7, 0, 1, 2, 3, \
+					       12, 13, 14, 15, 8, 9, 10, 11, \
+					       4, 5, 6, 7, 0, 1, 2, 3))
+
+#define MIX_AREAS_16 avx2_mix_areas_16_native
+#define MIX_AREAS_32 avx2_mix_areas_32_native
+#define MIX_AREAS_24 avx2_mix_areas_24
+#define SIMD_REMIX 0
+#define SIMD_SWAP 0
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef MIX_AREAS_24
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 avx2_remix_areas_16_native
+#define MIX_AREAS_32 avx2_remix_areas_32_native
+#define MIX_AREAS_24 avx2_remix_areas_24
+#define SIMD_REMIX 1
+#define SIMD_SWAP 0
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef MIX_AREAS_24
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 avx2_mix_areas_16_swap
+#define MIX_AREAS_32 avx2_mix_areas_32_swap
+#define SIMD_REMIX 0
+#define SIMD_SWAP 1
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 avx2_remix_areas_16_swap
+#define MIX_AREAS_32 avx2_remix_areas_32_swap
+#define SIMD_REMIX 1
+#define SIMD_SWAP 1
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#endif /* DMIX_SIMD_X86 */
+
+#ifdef DMIX_SIMD_NEON
+
+/*
+ *  NEON
+ */
+#define SIMD_TARGET
+#define V_TYPE			int32x4_t
+#define V_LANES			4
+#define V_LOAD(p)		vld1q_s32((const int32_t *)(p))
+#define V_STORE(p, v)		vst1q_s32((int32_t *)(p), v)
+#define V_ADD(a, b)		vaddq_s32(a, b)
+#define V_SUB(a, b)		vsubq_s32(a, b)
+#define V_AND(a, b)		vandq_s32(a, b)
+#define V_ANDNOT(m, v)		vbicq_s32(v, m)
+#define V_OR(a, b)		vorrq_s32(a, b)
+#define V_SET1(x)		vdupq_n_s32(x)
+#define V_SRAI(v, n)		vshrq_n_s32(v, n)
+#define V_SLLI(v, n)		vshlq_n_s32(v, n)
+#define V_CMPEQ0(v)		vreinterpretq_s32_u32(vceqq_s32(v, vdupq_n_s32(0)))
+#define V_CMPGT(a, b)		vreinterpretq_s32_u32(vcgtq_s32(a, b))
+#define V_BLEND(m, a, b)	vbslq_s32(vreinterpretq_u32_s32(m), a, b)
+#define V_SWAP16(t)		vreinterpret_s16_s8(vrev16_s8(vreinterpret_s8_s16(t)))
+#define V_LOAD16(p)		vmovl_s16(vld1_s16((const int16_t *)(p)))
+#define V_LOAD16_SWAP(p)	vmovl_s16(V_SWAP16(vld1_s16((const int16_t *)(p))))
+#define V_STORE16(p, v)		vst1_s16((int16_t *)(p), vqmovn_s32(v))
+#define V_STORE16_SWAP(p, v)	vst1_s16((int16_t *)(p), V_SWAP16(vqmovn_s32(v)))
+#define V_BSWAP32(v)		vreinterpretq_s32_s8(vrev32q_s8(vreinterpretq_s8_s32(v)))
+
+#define MIX_AREAS_16 neon_mix_areas_16_native
+#define MIX_AREAS_32 neon_mix_areas_32_native
+#define MIX_AREAS_24 neon_mix_areas_24
+#define SIMD_REMIX 0
+#define SIMD_SWAP 0
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef MIX_AREAS_24
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 neon_remix_areas_16_native
+#define MIX_AREAS_32 neon_remix_areas_32_native
+#define MIX_AREAS_24 neon_remix_areas_24
+#define SIMD_REMIX 1
+#define SIMD_SWAP 0
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef MIX_AREAS_24
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 neon_mix_areas_16_swap
+#define MIX_AREAS_32 neon_mix_areas_32_swap
+#define SIMD_REMIX 0
+#define SIMD_SWAP 1
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#define MIX_AREAS_16 neon_remix_areas_16_swap
+#define MIX_AREAS_32 neon_remix_areas_32_swap
+#define SIMD_REMIX 1
+#define SIMD_SWAP 1
+#include "pcm_dmix_simd.h"
+#undef MIX_AREAS_16
+#undef MIX_AREAS_32
+#undef SIMD_REMIX
+#undef SIMD_SWAP
+
+#endif /* DMIX_SIMD_NEON */
+
+/*
+ * select the SIMD version of the generic callbacks,
+ * returns zero when the CPU has no supported instruction set
+ */
+static int simd_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	int native = snd_pcm_format_cpu_endian(dmix->shmptr->s.format);
+
+#if defined(DMIX_SIMD_X86)
+	static int avx2 = -1, sse2;
+
+	if (avx2 < 0) {
+		__builtin_cpu_init();
+		sse2 = __builtin_cpu_supports("sse2");
+		avx2 = __builtin_cpu_supports("avx2");
+	}
+	if (avx2) {
+		dmix->u.dmix.mix_areas_16 = native ? avx2_mix_areas_16_native : avx2_mix_areas_16_swap;
+		dmix->u.dmix.mix_areas_32 = native ? avx2_mix_areas_32_native : avx2_mix_areas_32_swap;
+		dmix->u.dmix.remix_areas_16 = native ? avx2_remix_areas_16_native : avx2_remix_areas_16_swap;
+		dmix->u.dmix.remix_areas_32 = native ? avx2_remix_areas_32_native : avx2_remix_areas_32_swap;
+		dmix->u.dmix.mix_areas_24 = avx2_mix_areas_24;
+		dmix->u.dmix.remix_areas_24 = avx2_remix_areas_24;
+		return 1;
+	}
+	if (sse2) {
+		dmix->u.dmix.mix_areas_16 = native ? sse2_mix_areas_16_native : sse2_mix_areas_16_swap;
+		dmix->u.dmix.mix_areas_32 = native ? sse2_mix_areas_32_native : sse2_mix_areas_32_swap;
+		dmix->u.dmix.remix_areas_16 = native ? sse2_remix_areas_16_native : sse2_remix_areas_16_swap;
+		dmix->u.dmix.remix_areas_32 = native ? sse2_remix_areas_32_native : sse2_remix_areas_32_swap;
+		dmix->u.dmix.mix_areas_24 = sse2_mix_areas_24;
+		dmix->u.dmix.remix_areas_24 = sse2_remix_areas_24;
+		return 1;
+	}
+#elif defined(DMIX_SIMD_NEON)
+#if !defined(__aarch64__)
+	if (!(getauxval(AT_HWCAP) & HWCAP_NEON))
+		return 0;
+#endif
+	dmix->u.dmix.mix_areas_16 = native ? neon_mix_areas_16_native : neon_mix_areas_16_swap;
+	dmix->u.dmix.mix_areas_32 = native ? neon_mix_areas_32_native : neon_mix_areas_32_swap;
+	dmix->u.dmix.remix_areas_16 = native ? neon_remix_areas_16_native : neon_remix_areas_16_swap;
+	dmix->u.dmix.remix_areas_32 = native ? neon_remix_areas_32_native : neon_remix_areas_32_swap;
+	dmix->u.dmix.mix_areas_24 = neon_mix_areas_24;
+	dmix->u.dmix.remix_areas_24 = neon_remix_areas_24;
+	return 1;
+#else
+	(void)native;
+	(void)dmix;
+#endif
+	return 0;
+}
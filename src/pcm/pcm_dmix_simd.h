@@ -0,0 +1,206 @@
+/**
+ * \file pcm/pcm_dmix_simd.h
+ * \ingroup PCM_Plugins
+ * \brief PCM Direct Stream Mixing (dmix) Plugin Interface - SIMD mixing template
+ * \author Jaroslav Kysela <perex@perex.cz>
+ * \date 2026
+ */
+/*
+ *  PCM - Direct Stream Mixing
+ *  Copyright (c) 2003 by Jaroslav Kysela <perex@perex.cz>
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The template is expanded by pcm_dmix_simd.c once for each combination
+ * of mix/remix and native/swapped byte order.  The instruction set is
+ * described by the V_* macros:
+ *
+ *   V_TYPE                vector of V_LANES signed 32-bit lanes
+ *   V_LOAD(p)/V_STORE     unaligned 32-bit lane load/store
+ *   V_LOAD16(p)           load V_LANES 16-bit samples, sign-extended
+ *   V_STORE16(p, v)       store V_LANES lanes saturated to 16-bit
+ *   V_LOAD16_SWAP, V_STORE16_SWAP, V_BSWAP32  byte swapped variants
+ *   V_ADD, V_SUB, V_AND, V_ANDNOT(m, v), V_OR, V_SET1, V_SRAI, V_SLLI
+ *   V_CMPEQ0(v), V_CMPGT(a, b), V_BLEND(m, a, b) (i.e. m ? a : b)
+ *
+ * and the generated functions are named by MIX_AREAS_16, MIX_AREAS_32 and
+ * MIX_AREAS_24 (MIX_AREAS_24 is omitted for the swapped variant).
+ * SIMD_REMIX selects subtraction instead of addition and SIMD_SWAP
+ * selects the byte swapped sample format.  The matching generic
+ * functions are used for the strided case and for the tail of each call.
+ *
+ * As in the generic code, a zero sample in the destination means that
+ * the driver has already played (and cleared) this position, so the
+ * accumulated value in the sum buffer is dropped.  These routines are
+ * not safe against concurrent access, they are always used with the
+ * client semaphore held.
+ */
+
+#if SIMD_REMIX
+#define V_ACC(a, b)	V_SUB(a, b)
+#define GENERIC_24	generic_remix_areas_24
+#if SIMD_SWAP
+#define GENERIC_16	generic_remix_areas_16_swap
+#define GENERIC_32	generic_remix_areas_32_swap
+#else
+#define GENERIC_16	generic_remix_areas_16_native
+#define GENERIC_32	generic_remix_areas_32_native
+#endif
+#else
+#define V_ACC(a, b)	V_ADD(a, b)
+#define GENERIC_24	generic_mix_areas_24
+#if SIMD_SWAP
+#define GENERIC_16	generic_mix_areas_16_swap
+#define GENERIC_32	generic_mix_areas_32_swap
+#else
+#define GENERIC_16	generic_mix_areas_16_native
+#define GENERIC_32	generic_mix_areas_32_native
+#endif
+#endif
+
+SIMD_TARGET
+static void MIX_AREAS_16(unsigned int size,
+			 volatile signed short *dst, signed short *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	signed short *d = (signed short *)dst;
+	signed int *s = (signed int *)sum;
+	V_TYPE sample, old, mask;
+
+	if (dst_step != 2 || src_step != 2 || sum_step != 4) {
+		GENERIC_16(size, dst, src, sum, dst_step, src_step, sum_step);
+		return;
+	}
+	while (size >= V_LANES) {
+#if SIMD_SWAP
+		sample = V_LOAD16_SWAP(src);
+		old = V_LOAD16_SWAP(d);
+#else
+		sample = V_LOAD16(src);
+		old = V_LOAD16(d);
+#endif
+		mask = V_CMPEQ0(old);
+		sample = V_ACC(V_ANDNOT(mask, V_LOAD(s)), sample);
+		V_STORE(s, sample);
+#if SIMD_SWAP
+		V_STORE16_SWAP(d, sample);
+#else
+		V_STORE16(d, sample);
+#endif
+		src += V_LANES;
+		d += V_LANES;
+		s += V_LANES;
+		size -= V_LANES;
+	}
+	if (size)
+		GENERIC_16(size, d, src, s, dst_step, src_step, sum_step);
+}
+
+SIMD_TARGET
+static void MIX_AREAS_32(unsigned int size,
+			 volatile signed int *dst, signed int *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	signed int *d = (signed int *)dst;
+	signed int *s = (signed int *)sum;
+	V_TYPE raw, sample, mask, hi, lo;
+
+	if (dst_step != 4 || src_step != 4 || sum_step != 4) {
+		GENERIC_32(size, dst, src, sum, dst_step, src_step, sum_step);
+		return;
+	}
+	while (size >= V_LANES) {
+		raw = V_LOAD(src);
+#if SIMD_SWAP
+		sample = V_SRAI(V_BSWAP32(raw), 8);
+#else
+		sample = V_SRAI(raw, 8);
+#endif
+		/* zero is zero in both byte orders */
+		mask = V_CMPEQ0(V_LOAD(d));
+		sample = V_ACC(V_ANDNOT(mask, V_LOAD(s)), sample);
+		V_STORE(s, sample);
+		hi = V_CMPGT(sample, V_SET1(0x7fffff));
+		lo = V_CMPGT(V_SET1(-0x800000), sample);
+		sample = V_SLLI(sample, 8);
+		sample = V_BLEND(hi, V_SET1(0x7fffffff), sample);
+		sample = V_BLEND(lo, V_SET1((int)0x80000000), sample);
+#if SIMD_SWAP
+		sample = V_BSWAP32(sample);
+#endif
+#if !SIMD_REMIX
+		/* the first writer keeps the full 32-bit resolution */
+		sample = V_BLEND(mask, raw, sample);
+#endif
+		V_STORE(d, sample);
+		src += V_LANES;
+		d += V_LANES;
+		s += V_LANES;
+		size -= V_LANES;
+	}
+	if (size)
+		GENERIC_32(size, d, src, s, dst_step, src_step, sum_step);
+}
+
+#if !SIMD_SWAP && __BYTE_ORDER == __LITTLE_ENDIAN
+/* S24_LE in a 32-bit container, the upper byte is left untouched */
+SIMD_TARGET
+static void MIX_AREAS_24(unsigned int size,
+			 volatile unsigned char *dst, unsigned char *src,
+			 volatile signed int *sum, size_t dst_step,
+			 size_t src_step, size_t sum_step)
+{
+	signed int *d = (signed int *)dst;
+	signed int *p = (signed int *)src;
+	signed int *s = (signed int *)sum;
+	V_TYPE old, sample, mask, hi, lo;
+
+	if (dst_step != 4 || src_step != 4 || sum_step != 4) {
+		GENERIC_24(size, dst, src, sum, dst_step, src_step, sum_step);
+		return;
+	}
+	while (size >= V_LANES) {
+		sample = V_SRAI(V_SLLI(V_LOAD(p), 8), 8);
+		old = V_LOAD(d);
+		mask = V_CMPEQ0(V_AND(old, V_SET1(0xffffff)));
+		sample = V_ACC(V_ANDNOT(mask, V_LOAD(s)), sample);
+		V_STORE(s, sample);
+		hi = V_CMPGT(sample, V_SET1(0x7fffff));
+		lo = V_CMPGT(V_SET1(-0x800000), sample);
+		sample = V_BLEND(hi, V_SET1(0x7fffff), sample);
+		sample = V_BLEND(lo, V_SET1(-0x800000), sample);
+		V_STORE(d, V_OR(V_AND(old, V_SET1((int)0xff000000)),
+				V_AND(sample, V_SET1(0xffffff))));
+		p += V_LANES;
+		d += V_LANES;
+		s += V_LANES;
+		size -= V_LANES;
+	}
+	if (size)
+		GENERIC_24(size, (unsigned char *)d, (unsigned char *)p, s,
+			   dst_step, src_step, sum_step);
+}
+#endif
+
+#undef V_ACC
+#undef GENERIC_16
+#undef GENERIC_32
+#undef GENERIC_24
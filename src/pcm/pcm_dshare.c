@@ -109,8 +109,10 @@ static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
 	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
-	snd_pcm_uframes_t appl_ptr, size;
+	snd_pcm_uframes_t appl_ptr, size, frames;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
+	snd_htimestamp_t tstamp;
+	unsigned long long start;
 	
 	/* calculate the size to transfer */
 	size = pcm_frame_diff(dshare->appl_ptr, dshare->last_appl_ptr, pcm->boundary);
@@ -139,6 +141,9 @@ static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
 	slave_appl_ptr = dshare->slave_appl_ptr % dshare->slave_buffer_size;
 	dshare->slave_appl_ptr += size;
 	dshare->slave_appl_ptr %= dshare->slave_boundary;
+	frames = size;
+	snd_pcm_direct_stats_start(dshare, &tstamp);
+	start = snd_pcm_profile_start(pcm);
 	for (;;) {
 		snd_pcm_uframes_t transfer = size;
 		if (appl_ptr + transfer > pcm->buffer_size)
@@ -154,6 +159,8 @@ static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
 		appl_ptr += transfer;
 		appl_ptr %= pcm->buffer_size;
 	}
+	snd_pcm_profile_stop(pcm, start, frames);
+	snd_pcm_direct_stats_transfer(dshare, &tstamp, frames);
 }
 
 /*
@@ -176,6 +183,7 @@ static int snd_pcm_dshare_sync_ptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_p
 		return 0;
 	dshare->hw_ptr += diff;
 	dshare->hw_ptr %= pcm->boundary;
+	snd_pcm_direct_stats_update(pcm, dshare);
 	// printf("sync ptr diff = %li\n", diff);
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
@@ -183,11 +191,12 @@ static int snd_pcm_dshare_sync_ptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_p
 	if (avail > dshare->avail_max)
 		dshare->avail_max = avail;
 	if (avail >= pcm->stop_threshold) {
-		snd_timer_stop(dshare->timer);
+		snd_pcm_direct_timer_stop(dshare);
 		do_silence(pcm);
 		gettimestamp(&dshare->trigger_tstamp, pcm->tstamp_type);
 		if (dshare->state == SND_PCM_STATE_RUNNING) {
 			dshare->state = SND_PCM_STATE_XRUN;
+			snd_pcm_direct_stats_update(pcm, dshare);
 			return -EPIPE;
 		}
 		dshare->state = SND_PCM_STATE_SETUP;
@@ -316,7 +325,7 @@ static int snd_pcm_dshare_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dshare)
 
 	snd_pcm_hwsync(dshare->spcm);
 	snd_pcm_direct_reset_slave_ptr(pcm, dshare, *dshare->spcm->hw.ptr);
-	err = snd_timer_start(dshare->timer);
+	err = snd_pcm_direct_timer_start(dshare);
 	if (err < 0)
 		return err;
 	dshare->state = SND_PCM_STATE_RUNNING;
@@ -477,8 +486,7 @@ static int snd_pcm_dshare_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
 
-	if (dshare->timer)
-		snd_timer_close(dshare->timer);
+	snd_pcm_direct_timer_discard(dshare);
 	if (dshare->bindings)
 		do_silence(pcm);
 	snd_pcm_direct_semaphore_down(dshare, DIRECT_IPC_SEM_CLIENT);
@@ -488,6 +496,7 @@ static int snd_pcm_dshare_close(snd_pcm_t *pcm)
  		snd_pcm_direct_server_discard(dshare);
  	if (dshare->client)
  		snd_pcm_direct_client_discard(dshare);
+	snd_pcm_direct_stats_detach(dshare);
 	if (snd_pcm_direct_shm_discard(dshare)) {
 		if (snd_pcm_direct_semaphore_discard(dshare))
 			snd_pcm_direct_semaphore_final(dshare, DIRECT_IPC_SEM_CLIENT);
@@ -580,6 +589,7 @@ static void snd_pcm_dshare_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_direct_stats_dump(pcm, out);
 	if (dshare->spcm)
 		snd_pcm_dump(dshare->spcm, out);
 }
@@ -774,8 +784,17 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 
 	for (chn = 0; dshare->bindings && (chn < dshare->channels); chn++) {
 		unsigned int dchn = dshare->bindings ? dshare->bindings[chn] : chn;
-		if (dchn != UINT_MAX)
-			dshare->u.dshare.chn_mask |= (1ULL << dchn);
+		if (dchn == UINT_MAX)
+			continue;
+		/* the ownership of the slave channels is a bitmap in the shm */
+		if (dchn >= sizeof(dshare->u.dshare.chn_mask) * 8) {
+			SNDERR("destination channel %u in bindings is out of range (max %u)",
+			       dchn, (unsigned int)sizeof(dshare->u.dshare.chn_mask) * 8 - 1);
+			dshare->u.dshare.chn_mask = 0;
+			ret = -EINVAL;
+			goto _err;
+		}
+		dshare->u.dshare.chn_mask |= (1ULL << dchn);
 	}
 	if (dshare->shmptr->u.dshare.chn_mask & dshare->u.dshare.chn_mask) {
 		SNDERR("destination channel specified in bindings is already used");
@@ -806,20 +825,21 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
  _err:
 	if (dshare->shmptr != (void *) -1)
 		dshare->shmptr->u.dshare.chn_mask &= ~dshare->u.dshare.chn_mask;
-	if (dshare->timer)
-		snd_timer_close(dshare->timer);
+	snd_pcm_direct_timer_discard(dshare);
 	if (dshare->server)
 		snd_pcm_direct_server_discard(dshare);
 	if (dshare->client)
 		snd_pcm_direct_client_discard(dshare);
 	if (spcm)
 		snd_pcm_close(spcm);
+	snd_pcm_direct_stats_detach(dshare);
 	if ((dshare->shmid >= 0) && (snd_pcm_direct_shm_discard(dshare))) {
 		if (snd_pcm_direct_semaphore_discard(dshare))
 			snd_pcm_direct_semaphore_final(dshare, DIRECT_IPC_SEM_CLIENT);
 	} else
 		snd_pcm_direct_semaphore_up(dshare, DIRECT_IPC_SEM_CLIENT);
  _err_nosem:
+	snd_pcm_direct_stats_detach(dshare);
 	free(dshare->bindings);
 	free(dshare);
 	snd_pcm_free(pcm);
@@ -873,6 +893,18 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	shared_wakeup BOOL	# wake up the clients from one server process
+	prefault BOOL		# fault in the shared memory pages at open
+	period_timer BOOL	# wake up this client with its own timer
+				# at the client period
+	slave_period_wakeup BOOL # period interrupts of the slave
+				# (default yes)
+	thread_policy STR	# scheduling of the server process:
+				# other, fifo or rr
+	thread_priority INT	# priority for fifo and rr
+	cpu_affinity INT	# CPU of the server
+	# or
+	cpu_affinity STR	# CPU list like "0,2-3"
 }
 \endcode
 
@@ -45,6 +45,7 @@
 #include <sys/un.h>
 #include <sys/mman.h>
 #include "pcm_direct.h"
+#include "pcm_plugin.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -97,6 +98,281 @@ static void snoop_areas(snd_pcm_direct_t *dsnoop,
 	}
 }
 
+/* convert the slave samples to the client format */
+static void convert_areas(snd_pcm_direct_t *dsnoop,
+			  const snd_pcm_channel_area_t *src_areas,
+			  const snd_pcm_channel_area_t *dst_areas,
+			  snd_pcm_uframes_t src_ofs,
+			  snd_pcm_uframes_t dst_ofs,
+			  snd_pcm_uframes_t size)
+{
+	unsigned int chn, schn;
+
+	for (chn = 0; chn < dsnoop->channels; chn++) {
+		schn = dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+		if (dsnoop->u.dsnoop.use_getput)
+			snd_pcm_linear_getput(&dst_areas[chn], dst_ofs,
+					      &src_areas[schn], src_ofs, 1, size,
+					      dsnoop->u.dsnoop.get_idx,
+					      dsnoop->u.dsnoop.put_idx);
+		else
+			snd_pcm_linear_convert(&dst_areas[chn], dst_ofs,
+					       &src_areas[schn], src_ofs, 1, size,
+					       dsnoop->u.dsnoop.conv_idx);
+	}
+}
+
+/* copy the samples already converted by the shared conversion */
+static void copy_converted(snd_pcm_direct_t *dsnoop,
+			   const snd_pcm_channel_area_t *src_areas,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t src_ofs,
+			   snd_pcm_uframes_t dst_ofs,
+			   snd_pcm_uframes_t size)
+{
+	snd_pcm_areas_copy(dst_areas, dst_ofs, src_areas, src_ofs,
+			   dsnoop->channels, size, dsnoop->u.dsnoop.convert_format);
+}
+
+/*
+ *  shared conversions
+ *
+ *  The clients converting to the same format with the same channels
+ *  share one converted copy of the slave ring buffer, kept in a separate
+ *  shm segment at the same offsets as the slave ring buffer.  The first
+ *  client seeing the new slave frames converts them under the client
+ *  semaphore, the others only copy the result.
+ */
+#define DSNOOP_CONV_SLOTS	4
+/* the shared positions wrap at this many slave buffers */
+#define DSNOOP_CONV_WRAP	16
+#define DSNOOP_CONV_ALIGN(x)	(((x) + 63) & ~(size_t)63)
+
+/* shared among the clients - be careful to be 32/64bit compatible! */
+struct snd_pcm_dsnoop_conv_slot {
+	unsigned int users;
+	unsigned int format;
+	unsigned int channels;
+	unsigned int key;		/* hash of the channel bindings */
+	unsigned int ptr;		/* slave position converted up to */
+	unsigned int valid;		/* converted frames before ptr */
+	unsigned int recoveries;	/* the slave restarts at zero on a recovery */
+};
+
+struct snd_pcm_dsnoop_conv {
+	struct snd_pcm_dsnoop_conv_slot slot[DSNOOP_CONV_SLOTS];
+	/* the rings follow, one per slot */
+};
+
+static size_t conv_ring_size(snd_pcm_direct_t *dsnoop)
+{
+	/* room for 32-bit samples of all slave channels */
+	return DSNOOP_CONV_ALIGN(dsnoop->shmptr->s.buffer_size *
+				 dsnoop->shmptr->s.channels * 4);
+}
+
+static unsigned int conv_key(snd_pcm_direct_t *dsnoop)
+{
+	unsigned int chn, key = 2166136261U;
+
+	for (chn = 0; chn < dsnoop->channels; chn++) {
+		key ^= dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+		key *= 16777619U;
+	}
+	return key;
+}
+
+/* release the conversion slot and the segment, called with the client semaphore held */
+static int shm_conv_discard(snd_pcm_direct_t *dsnoop)
+{
+	struct shmid_ds buf;
+	int ret = 0;
+
+	free(dsnoop->u.dsnoop.conv_areas);
+	dsnoop->u.dsnoop.conv_areas = NULL;
+	if (dsnoop->u.dsnoop.shmid_conv < 0)
+		return 0;
+	if (dsnoop->u.dsnoop.conv) {
+		if (dsnoop->u.dsnoop.conv_slot >= 0)
+			dsnoop->u.dsnoop.conv->slot[dsnoop->u.dsnoop.conv_slot].users--;
+		if (shmdt(dsnoop->u.dsnoop.conv) < 0)
+			return -errno;
+	}
+	dsnoop->u.dsnoop.conv = NULL;
+	dsnoop->u.dsnoop.conv_slot = -1;
+	if (shmctl(dsnoop->u.dsnoop.shmid_conv, IPC_STAT, &buf) < 0)
+		return -errno;
+	if (buf.shm_nattch == 0) {	/* we're the last user, destroy the segment */
+		if (shmctl(dsnoop->u.dsnoop.shmid_conv, IPC_RMID, NULL) < 0)
+			return -errno;
+		ret = 1;
+	}
+	dsnoop->u.dsnoop.shmid_conv = -1;
+	return ret;
+}
+
+/*
+ * attach the shared conversions and join (or start) the one for our
+ * format and channels, called with the client semaphore held
+ */
+static int shm_conv_create_or_connect(snd_pcm_direct_t *dsnoop)
+{
+	struct snd_pcm_dsnoop_conv *conv;
+	struct snd_pcm_dsnoop_conv_slot *slot;
+	snd_pcm_channel_area_t *areas;
+	struct shmid_ds buf;
+	unsigned int i, chn, key, width;
+	int free_slot = -1, err;
+	size_t ring_size, size;
+	char *ring;
+
+	width = snd_pcm_format_physical_width(dsnoop->u.dsnoop.convert_format);
+	/* the channels don't fit in the rings, convert privately */
+	if (dsnoop->channels * width > dsnoop->shmptr->s.channels * 32)
+		return 0;
+	ring_size = conv_ring_size(dsnoop);
+	size = DSNOOP_CONV_ALIGN(sizeof(*conv)) + DSNOOP_CONV_SLOTS * ring_size;
+	dsnoop->u.dsnoop.shmid_conv = shmget(dsnoop->ipc_key + 1, size,
+					     IPC_CREAT | dsnoop->ipc_perm);
+	if (dsnoop->u.dsnoop.shmid_conv < 0)
+		return -errno;
+	if (dsnoop->ipc_gid >= 0 &&
+	    shmctl(dsnoop->u.dsnoop.shmid_conv, IPC_STAT, &buf) == 0) {
+		buf.shm_perm.gid = dsnoop->ipc_gid;
+		shmctl(dsnoop->u.dsnoop.shmid_conv, IPC_SET, &buf);
+	}
+	conv = shmat(dsnoop->u.dsnoop.shmid_conv, 0, 0);
+	if (conv == (void *) -1) {
+		err = -errno;
+		shm_conv_discard(dsnoop);
+		return err;
+	}
+	dsnoop->u.dsnoop.conv = conv;
+	snd_pcm_direct_prefault(dsnoop, conv, size);
+
+	key = conv_key(dsnoop);
+	for (i = 0; i < DSNOOP_CONV_SLOTS; i++) {
+		slot = &conv->slot[i];
+		if (!slot->users) {
+			if (free_slot < 0)
+				free_slot = i;
+			continue;
+		}
+		if (slot->format == (unsigned int)dsnoop->u.dsnoop.convert_format &&
+		    slot->channels == dsnoop->channels && slot->key == key)
+			break;
+	}
+	if (i == DSNOOP_CONV_SLOTS) {
+		/* all slots taken by other conversions */
+		if (free_slot < 0)
+			return 0;
+		i = free_slot;
+		slot = &conv->slot[i];
+		slot->format = dsnoop->u.dsnoop.convert_format;
+		slot->channels = dsnoop->channels;
+		slot->key = key;
+		slot->ptr = 0;
+		slot->valid = 0;
+		slot->recoveries = dsnoop->shmptr->s.recoveries;
+	}
+
+	areas = calloc(dsnoop->channels, sizeof(*areas));
+	if (!areas)
+		return -ENOMEM;
+	ring = (char *)conv + DSNOOP_CONV_ALIGN(sizeof(*conv)) + i * ring_size;
+	for (chn = 0; chn < dsnoop->channels; chn++) {
+		areas[chn].addr = ring;
+		areas[chn].first = chn * width;
+		areas[chn].step = dsnoop->channels * width;
+	}
+	slot->users++;
+	dsnoop->u.dsnoop.conv_slot = i;
+	dsnoop->u.dsnoop.conv_areas = areas;
+	return 0;
+}
+
+/*
+ * bring the shared conversion up to the slave position ptr + size;
+ * returns 0 when the frames from ptr on are converted in the ring
+ */
+static int conv_update(snd_pcm_direct_t *dsnoop, snd_pcm_uframes_t ptr,
+		       snd_pcm_uframes_t size)
+{
+	struct snd_pcm_dsnoop_conv_slot *slot =
+		&dsnoop->u.dsnoop.conv->slot[dsnoop->u.dsnoop.conv_slot];
+	const snd_pcm_channel_area_t *src_areas = snd_pcm_mmap_areas(dsnoop->spcm);
+	snd_pcm_uframes_t bsize = dsnoop->slave_buffer_size;
+	snd_pcm_uframes_t wrap = bsize * DSNOOP_CONV_WRAP;
+	snd_pcm_uframes_t start, end, frames, ofs, transfer;
+	int err = 0;
+
+	start = ptr % wrap;
+	end = (start + size) % wrap;
+	snd_pcm_direct_semaphore_down(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	if (slot->recoveries != dsnoop->shmptr->s.recoveries) {
+		slot->recoveries = dsnoop->shmptr->s.recoveries;
+		slot->ptr = start;
+		slot->valid = 0;
+	}
+	/* nothing to do when another client converted past us already */
+	if ((slot->ptr + wrap - end) % wrap > bsize) {
+		frames = (end + wrap - slot->ptr) % wrap;
+		if (frames > bsize) {
+			/* nobody converted for a whole buffer */
+			frames = size;
+			slot->valid = 0;
+		}
+		ofs = (end + wrap - frames) % bsize;
+		slot->valid = slot->valid + frames > bsize ? bsize : slot->valid + frames;
+		slot->ptr = end;
+		while (frames > 0) {
+			transfer = ofs + frames > bsize ? bsize - ofs : frames;
+			convert_areas(dsnoop, src_areas, dsnoop->u.dsnoop.conv_areas,
+				      ofs, ofs, transfer);
+			frames -= transfer;
+			ofs = (ofs + transfer) % bsize;
+		}
+	}
+	if ((slot->ptr + wrap - start) % wrap > slot->valid)
+		err = -EAGAIN;
+	snd_pcm_direct_semaphore_up(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	return err;
+}
+
+/*
+ *  set up the conversion to convert_format, shared when possible
+ */
+static int snd_pcm_dsnoop_conv_init(snd_pcm_direct_t *dsnoop)
+{
+	snd_pcm_format_t sformat = dsnoop->shmptr->s.format;
+	snd_pcm_format_t format = dsnoop->u.dsnoop.convert_format;
+
+	if (format == SND_PCM_FORMAT_UNKNOWN)
+		return 0;
+	if (!snd_pcm_format_linear(sformat) || snd_pcm_format_float(sformat)) {
+		SNDERR("convert_format requires a linear integer slave format");
+		return -EINVAL;
+	}
+	if (format == sformat) {
+		dsnoop->u.dsnoop.convert_format = SND_PCM_FORMAT_UNKNOWN;
+		return 0;
+	}
+	dsnoop->u.dsnoop.use_getput = (snd_pcm_format_physical_width(sformat) == 24 ||
+				       snd_pcm_format_physical_width(format) == 24 ||
+				       snd_pcm_format_width(sformat) == 20 ||
+				       snd_pcm_format_width(format) == 20);
+	if (dsnoop->u.dsnoop.use_getput) {
+		dsnoop->u.dsnoop.get_idx = snd_pcm_linear_get_index(sformat, SND_PCM_FORMAT_S32);
+		dsnoop->u.dsnoop.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, format);
+	} else {
+		dsnoop->u.dsnoop.conv_idx = snd_pcm_linear_convert_index(sformat, format);
+	}
+	/* without the shared segment each client converts on its own */
+	if (shm_conv_create_or_connect(dsnoop) < 0)
+		shm_conv_discard(dsnoop);
+	return 0;
+}
+
 /*
  *  synchronize shm ring buffer with hardware
  */
@@ -104,25 +380,73 @@ static void snd_pcm_dsnoop_sync_area(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 	snd_pcm_uframes_t hw_ptr = dsnoop->hw_ptr;
-	snd_pcm_uframes_t transfer;
+	snd_pcm_uframes_t transfer, frames;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
-	
+	void (*transfer_areas)(snd_pcm_direct_t *dsnoop,
+			       const snd_pcm_channel_area_t *src_areas,
+			       const snd_pcm_channel_area_t *dst_areas,
+			       snd_pcm_uframes_t src_ofs,
+			       snd_pcm_uframes_t dst_ofs,
+			       snd_pcm_uframes_t size) = snoop_areas;
+	snd_htimestamp_t tstamp;
+	unsigned long long start;
+
+	/* the client reads the slave ring buffer directly */
+	if (dsnoop->u.dsnoop.shared_ring)
+		return;
+
+	/* when the client is behind, only the newest buffer_size frames
+	 * survive in the local buffer, don't copy the older ones
+	 */
+	if (size > pcm->buffer_size) {
+		transfer = size - pcm->buffer_size;
+		hw_ptr += transfer;
+		slave_hw_ptr += transfer;
+		size = pcm->buffer_size;
+	}
+
 	/* add sample areas here */
 	dst_areas = snd_pcm_mmap_areas(pcm);
 	src_areas = snd_pcm_mmap_areas(dsnoop->spcm);
+	if (dsnoop->u.dsnoop.convert_format != SND_PCM_FORMAT_UNKNOWN) {
+		transfer_areas = convert_areas;
+		if (dsnoop->u.dsnoop.conv_slot >= 0 &&
+		    conv_update(dsnoop, slave_hw_ptr, size) == 0) {
+			src_areas = dsnoop->u.dsnoop.conv_areas;
+			transfer_areas = copy_converted;
+		}
+	}
 	hw_ptr %= pcm->buffer_size;
 	slave_hw_ptr %= dsnoop->slave_buffer_size;
+	frames = size;
+	snd_pcm_direct_stats_start(dsnoop, &tstamp);
+	start = snd_pcm_profile_start(pcm);
 	while (size > 0) {
 		transfer = hw_ptr + size > pcm->buffer_size ? pcm->buffer_size - hw_ptr : size;
 		transfer = slave_hw_ptr + transfer > dsnoop->slave_buffer_size ?
 			dsnoop->slave_buffer_size - slave_hw_ptr : transfer;
 		size -= transfer;
-		snoop_areas(dsnoop, src_areas, dst_areas, slave_hw_ptr, hw_ptr, transfer);
+		transfer_areas(dsnoop, src_areas, dst_areas, slave_hw_ptr, hw_ptr, transfer);
 		slave_hw_ptr += transfer;
 	 	slave_hw_ptr %= dsnoop->slave_buffer_size;
 		hw_ptr += transfer;
 		hw_ptr %= pcm->buffer_size;
 	}
+	snd_pcm_profile_stop(pcm, start, frames);
+	snd_pcm_direct_stats_transfer(dsnoop, &tstamp, frames);
+}
+
+/*
+ *  with the shared ring, the client ring offset must follow the slave one
+ */
+static void snd_pcm_dsnoop_align_shared_ring(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+
+	if (!dsnoop->u.dsnoop.shared_ring)
+		return;
+	dsnoop->hw_ptr = dsnoop->slave_hw_ptr % pcm->buffer_size;
+	dsnoop->appl_ptr = dsnoop->hw_ptr;
 }
 
 /*
@@ -146,9 +470,13 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 	diff = pcm_frame_diff(slave_hw_ptr, old_slave_hw_ptr, dsnoop->slave_boundary);
 	if (diff == 0)		/* fast path */
 		return 0;
-	snd_pcm_dsnoop_sync_area(pcm, old_slave_hw_ptr, diff);
+	/* the data is dropped anyway if this update ends in an xrun */
+	if (pcm->stop_threshold >= pcm->boundary ||
+	    snd_pcm_mmap_capture_avail(pcm) + diff < pcm->stop_threshold)
+		snd_pcm_dsnoop_sync_area(pcm, old_slave_hw_ptr, diff);
 	dsnoop->hw_ptr += diff;
 	dsnoop->hw_ptr %= pcm->boundary;
+	snd_pcm_direct_stats_update(pcm, dsnoop);
 	// printf("sync ptr diff = %li\n", diff);
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
@@ -156,6 +484,7 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 		gettimestamp(&dsnoop->trigger_tstamp, pcm->tstamp_type);
 		dsnoop->state = SND_PCM_STATE_XRUN;
 		dsnoop->avail_max = avail;
+		snd_pcm_direct_stats_update(pcm, dsnoop);
 		return -EPIPE;
 	}
 	if (avail > dsnoop->avail_max)
@@ -253,6 +582,7 @@ static int snd_pcm_dsnoop_reset(snd_pcm_t *pcm)
 	dsnoop->hw_ptr %= pcm->period_size;
 	dsnoop->appl_ptr = dsnoop->hw_ptr;
 	snd_pcm_direct_reset_slave_ptr(pcm, dsnoop, dsnoop->slave_hw_ptr);
+	snd_pcm_dsnoop_align_shared_ring(pcm);
 	return 0;
 }
 
@@ -266,7 +596,8 @@ static int snd_pcm_dsnoop_start(snd_pcm_t *pcm)
 	snd_pcm_hwsync(dsnoop->spcm);
 	snoop_timestamp(pcm);
 	snd_pcm_direct_reset_slave_ptr(pcm, dsnoop, dsnoop->slave_hw_ptr);
-	err = snd_timer_start(dsnoop->timer);
+	snd_pcm_dsnoop_align_shared_ring(pcm);
+	err = snd_pcm_direct_timer_start(dsnoop);
 	if (err < 0)
 		return err;
 	dsnoop->state = SND_PCM_STATE_RUNNING;
@@ -280,7 +611,7 @@ static int snd_pcm_dsnoop_drop(snd_pcm_t *pcm)
 	if (dsnoop->state == SND_PCM_STATE_OPEN)
 		return -EBADFD;
 	dsnoop->state = SND_PCM_STATE_SETUP;
-	snd_timer_stop(dsnoop->timer);
+	snd_pcm_direct_timer_stop(dsnoop);
 	return 0;
 }
 
@@ -369,14 +700,15 @@ static int snd_pcm_dsnoop_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 
-	if (dsnoop->timer)
-		snd_timer_close(dsnoop->timer);
+	snd_pcm_direct_timer_discard(dsnoop);
 	snd_pcm_direct_semaphore_down(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	shm_conv_discard(dsnoop);
 	snd_pcm_close(dsnoop->spcm);
  	if (dsnoop->server)
  		snd_pcm_direct_server_discard(dsnoop);
  	if (dsnoop->client)
  		snd_pcm_direct_client_discard(dsnoop);
+	snd_pcm_direct_stats_detach(dsnoop);
 	if (snd_pcm_direct_shm_discard(dsnoop)) {
 		if (snd_pcm_direct_semaphore_discard(dsnoop))
 			snd_pcm_direct_semaphore_final(dsnoop, DIRECT_IPC_SEM_CLIENT);
@@ -456,7 +788,11 @@ static void snd_pcm_dsnoop_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
+		snd_output_printf(out, "  zero_copy    : %s\n",
+				  dsnoop->u.dsnoop.shared_ring ? "active" :
+				  dsnoop->u.dsnoop.zero_copy ? "inactive" : "off");
 	}
+	snd_pcm_direct_stats_dump(pcm, out);
 	if (dsnoop->spcm)
 		snd_pcm_dump(dsnoop->spcm, out);
 }
@@ -556,6 +892,10 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	dsnoop->var_periodsize = opts->var_periodsize;
 	dsnoop->sync_ptr = snd_pcm_dsnoop_sync_ptr;
 	dsnoop->hw_ptr_alignment = opts->hw_ptr_alignment;
+	dsnoop->u.dsnoop.zero_copy = opts->zero_copy;
+	dsnoop->u.dsnoop.convert_format = opts->convert_format;
+	dsnoop->u.dsnoop.shmid_conv = -1;
+	dsnoop->u.dsnoop.conv_slot = -1;
 
  retry:
 	if (first_instance) {
@@ -653,6 +993,10 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	
 	if (dsnoop->channels == UINT_MAX)
 		dsnoop->channels = dsnoop->shmptr->s.channels;
+
+	ret = snd_pcm_dsnoop_conv_init(dsnoop);
+	if (ret < 0)
+		goto _err;
 	
 	snd_pcm_direct_semaphore_up(dsnoop, DIRECT_IPC_SEM_CLIENT);
 
@@ -660,14 +1004,15 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 	
  _err:
- 	if (dsnoop->timer)
-		snd_timer_close(dsnoop->timer);
+ 	snd_pcm_direct_timer_discard(dsnoop);
+	shm_conv_discard(dsnoop);
 	if (dsnoop->server)
 		snd_pcm_direct_server_discard(dsnoop);
 	if (dsnoop->client)
 		snd_pcm_direct_client_discard(dsnoop);
 	if (spcm)
 		snd_pcm_close(spcm);
+	snd_pcm_direct_stats_detach(dsnoop);
 	if ((dsnoop->shmid >= 0) && (snd_pcm_direct_shm_discard(dsnoop))) {
 		if (snd_pcm_direct_semaphore_discard(dsnoop))
 			snd_pcm_direct_semaphore_final(dsnoop, DIRECT_IPC_SEM_CLIENT);
@@ -675,6 +1020,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_direct_semaphore_up(dsnoop, DIRECT_IPC_SEM_CLIENT);
 
  _err_nosem:
+	snd_pcm_direct_stats_detach(dsnoop);
 	free(dsnoop->bindings);
 	free(dsnoop);
 	snd_pcm_free(pcm);
@@ -727,6 +1073,21 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	zero_copy BOOL		# read the slave ring buffer directly
+	convert_format STR	# client format, converted once for all
+				# clients using the same one
+	shared_wakeup BOOL	# wake up the clients from one server process
+	prefault BOOL		# fault in the shared memory pages at open
+	period_timer BOOL	# wake up this client with its own timer
+				# at the client period
+	slave_period_wakeup BOOL # period interrupts of the slave
+				# (default yes)
+	thread_policy STR	# scheduling of the server process:
+				# other, fifo or rr
+	thread_priority INT	# priority for fifo and rr
+	cpu_affinity INT	# CPU of the server
+	# or
+	cpu_affinity STR	# CPU list like "0,2-3"
 }
 \endcode
 
@@ -749,6 +1110,26 @@ the possible configurations:
   requirements. Therefore "rounddown" will be chosen to avoid long
   wakeup times. Else "no" will be chosen.
 
+<code>zero_copy</code> lets the client read the captured data directly
+from the slave ring buffer instead of copying it to a private buffer.
+It takes effect only when the client buffer matches the slave buffer
+exactly (same format, channels, buffer size and interleaved access,
+no channel remapping by bindings); otherwise the data is copied as
+usual.  Since the hardware keeps overwriting the ring buffer, the
+client must not let more than the buffer size minus one period
+accumulate, the data may be overwritten before the xrun is detected.
+The default is no.
+
+<code>convert_format</code> makes the plugin offer this linear integer
+format instead of the slave one.  The clients with the same
+convert_format and the same channels (bindings) share one converted copy
+of the slave ring buffer in a separate shared memory segment: the
+samples are converted once, by the first client reading them, and the
+other clients only copy the result.  Up to four distinct conversions are
+shared per slave, a client which finds no free slot converts on its own.
+The rate is not converted, a rate plugin on top still runs for each
+client.
+
 \subsection pcm_plugins_dsnoop_funcref Function reference
 
 <UL>
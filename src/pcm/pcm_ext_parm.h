@@ -1,8 +1,8 @@
 /* hw_params */
 struct snd_ext_parm {
+	unsigned int *list;
 	unsigned int min, max;
 	unsigned int num_list;
-	unsigned int *list;
 	unsigned int active: 1;
 	unsigned int integer: 1;
 	unsigned int keep_link: 1;
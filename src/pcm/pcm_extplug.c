@@ -43,6 +43,18 @@ typedef struct snd_pcm_extplug_priv {
 	snd_pcm_extplug_t *data;
 	struct snd_ext_parm params[SND_PCM_EXTPLUG_HW_PARAMS];
 	struct snd_ext_parm sparams[SND_PCM_EXTPLUG_HW_PARAMS];
+	snd_pcm_fast_ops_t fops;
+	/* block transfer (v1.0.3); block == 0 means direct transfer */
+	snd_pcm_uframes_t block;
+	snd_pcm_uframes_t blk_pos;	/* filled input == sent output */
+	snd_pcm_uframes_t blk_flush;	/* frames left to flush at drain */
+	int blk_used;			/* any data went in since init */
+	int blk_draining;
+	void *blk_buf;
+	snd_pcm_channel_area_t *blk_src;	/* transfer input */
+	snd_pcm_channel_area_t *blk_dst;	/* transfer output */
+	snd_pcm_format_t src_format, dst_format;
+	unsigned int src_channels, dst_channels;
 } extplug_priv_t;
 
 static const int hw_params_type[SND_PCM_EXTPLUG_HW_PARAMS] = {
@@ -286,6 +298,134 @@ static int snd_pcm_extplug_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 	return err;
 }
 
+/*
+ * block transfer buffers
+ */
+static void snd_pcm_extplug_free_block(extplug_priv_t *ext)
+{
+	free(ext->blk_buf);
+	free(ext->blk_src);
+	ext->blk_buf = NULL;
+	ext->blk_src = NULL;
+	ext->blk_dst = NULL;
+	ext->block = 0;
+	ext->data->delay = 0;
+}
+
+static void snd_pcm_extplug_setup_areas(snd_pcm_channel_area_t *areas,
+					char *buf, unsigned int channels,
+					unsigned int width, size_t stride)
+{
+	unsigned int chn;
+
+	for (chn = 0; chn < channels; chn++) {
+		areas[chn].addr = buf + chn * stride;
+		areas[chn].first = 0;
+		areas[chn].step = width;
+	}
+}
+
+static int snd_pcm_extplug_alloc_block(snd_pcm_t *pcm)
+{
+	extplug_priv_t *ext = pcm->private_data;
+	snd_pcm_extplug_t *data = ext->data;
+	unsigned int align, swidth, dwidth;
+	size_t sstride, dstride;
+
+	snd_pcm_extplug_free_block(ext);
+	if (data->version < 0x010003 || !data->block_size)
+		return 0;
+	align = data->block_align;
+	if (align & (align - 1)) {
+		SNDERR("extplug: invalid block alignment %u", align);
+		return -EINVAL;
+	}
+	if (align < sizeof(void *))
+		align = sizeof(void *);
+
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		ext->src_format = data->format;
+		ext->src_channels = data->channels;
+		ext->dst_format = data->slave_format;
+		ext->dst_channels = data->slave_channels;
+	} else {
+		ext->src_format = data->slave_format;
+		ext->src_channels = data->slave_channels;
+		ext->dst_format = data->format;
+		ext->dst_channels = data->channels;
+	}
+	swidth = snd_pcm_format_physical_width(ext->src_format);
+	dwidth = snd_pcm_format_physical_width(ext->dst_format);
+	sstride = (data->block_size * swidth / 8 + align - 1) & ~(size_t)(align - 1);
+	dstride = (data->block_size * dwidth / 8 + align - 1) & ~(size_t)(align - 1);
+
+	ext->blk_src = calloc(ext->src_channels + ext->dst_channels,
+			      sizeof(snd_pcm_channel_area_t));
+	if (!ext->blk_src)
+		return -ENOMEM;
+	ext->blk_dst = ext->blk_src + ext->src_channels;
+	if (posix_memalign(&ext->blk_buf, align,
+			   sstride * ext->src_channels +
+			   dstride * ext->dst_channels)) {
+		ext->blk_buf = NULL;
+		snd_pcm_extplug_free_block(ext);
+		return -ENOMEM;
+	}
+	snd_pcm_extplug_setup_areas(ext->blk_src, ext->blk_buf,
+				    ext->src_channels, swidth, sstride);
+	snd_pcm_extplug_setup_areas(ext->blk_dst,
+				    (char *)ext->blk_buf + sstride * ext->src_channels,
+				    ext->dst_channels, dwidth, dstride);
+	ext->block = data->block_size;
+	data->delay = ext->block;
+	return 0;
+}
+
+/*
+ * pass the data through the block buffers: the input is accumulated
+ * at blk_pos while the output of the previous block is handed out from
+ * the same position, so both sides always move in lockstep with a
+ * constant latency of one block.  NULL src_areas feeds silence.
+ */
+static snd_pcm_uframes_t
+snd_pcm_extplug_block_xfer(extplug_priv_t *ext,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   snd_pcm_uframes_t size)
+{
+	snd_pcm_uframes_t frames = ext->block - ext->blk_pos;
+	snd_pcm_sframes_t result;
+
+	if (frames > size)
+		frames = size;
+	if (src_areas) {
+		snd_pcm_areas_copy(ext->blk_src, ext->blk_pos,
+				   src_areas, src_offset,
+				   ext->src_channels, frames, ext->src_format);
+		ext->blk_used = 1;
+	} else
+		snd_pcm_areas_silence(ext->blk_src, ext->blk_pos,
+				      ext->src_channels, frames, ext->src_format);
+	snd_pcm_areas_copy(dst_areas, dst_offset, ext->blk_dst, ext->blk_pos,
+			   ext->dst_channels, frames, ext->dst_format);
+	ext->blk_pos += frames;
+	if (ext->blk_pos == ext->block) {
+		result = ext->data->callback->transfer(ext->data, ext->blk_dst, 0,
+						       ext->blk_src, 0, ext->block);
+		if (result < 0)
+			result = 0;
+		if ((snd_pcm_uframes_t)result < ext->block)
+			snd_pcm_areas_silence(ext->blk_dst, result,
+					      ext->dst_channels,
+					      ext->block - result,
+					      ext->dst_format);
+		ext->blk_pos = 0;
+	}
+	return frames;
+}
+
 /*
  * hw_params callback
  */
@@ -314,7 +454,7 @@ static int snd_pcm_extplug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 		if (err < 0)
 			return err;
 	}
-	return 0;
+	return snd_pcm_extplug_alloc_block(pcm);
 }
 
 /*
@@ -324,6 +464,7 @@ static int snd_pcm_extplug_hw_free(snd_pcm_t *pcm)
 {
 	extplug_priv_t *ext = pcm->private_data;
 
+	snd_pcm_extplug_free_block(ext);
 	snd_pcm_hw_free(ext->plug.gen.slave);
 	if (ext->data->callback->hw_free)
 		return ext->data->callback->hw_free(ext->data);
@@ -346,8 +487,13 @@ snd_pcm_extplug_write_areas(snd_pcm_t *pcm,
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	size = ext->data->callback->transfer(ext->data, slave_areas, slave_offset,
-					     areas, offset, size);
+	if (ext->block)
+		size = snd_pcm_extplug_block_xfer(ext, slave_areas, slave_offset,
+						  areas, offset, size);
+	else
+		size = ext->data->callback->transfer(ext->data, slave_areas,
+						     slave_offset, areas,
+						     offset, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -368,8 +514,14 @@ snd_pcm_extplug_read_areas(snd_pcm_t *pcm,
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	size = ext->data->callback->transfer(ext->data, areas, offset,
-					     slave_areas, slave_offset, size);
+	if (ext->block)
+		size = snd_pcm_extplug_block_xfer(ext, areas, offset,
+						  slave_areas, slave_offset,
+						  size);
+	else
+		size = ext->data->callback->transfer(ext->data, areas, offset,
+						     slave_areas, slave_offset,
+						     size);
 	*slave_sizep = size;
 	return size;
 }
@@ -380,7 +532,125 @@ snd_pcm_extplug_read_areas(snd_pcm_t *pcm,
 static int snd_pcm_extplug_init(snd_pcm_t *pcm)
 {
 	extplug_priv_t *ext = pcm->private_data;
-	return ext->data->callback->init(ext->data);
+
+	if (ext->block) {
+		ext->blk_pos = 0;
+		ext->blk_flush = 0;
+		ext->blk_used = 0;
+		ext->blk_draining = 0;
+		snd_pcm_areas_silence(ext->blk_dst, 0, ext->dst_channels,
+				      ext->block, ext->dst_format);
+	}
+	if (ext->data->version >= 0x010001 && ext->data->callback->init)
+		return ext->data->callback->init(ext->data);
+	return 0;
+}
+
+/*
+ * fast ops overridden for the block transfer
+ */
+static int snd_pcm_extplug_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	extplug_priv_t *ext = pcm->private_data;
+	int err = snd_pcm_plugin_fast_ops.status(pcm, status);
+
+	if (err < 0)
+		return err;
+	status->delay += ext->block;
+	return 0;
+}
+
+static int snd_pcm_extplug_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	extplug_priv_t *ext = pcm->private_data;
+	int err = snd_pcm_plugin_fast_ops.delay(pcm, delayp);
+
+	if (err < 0)
+		return err;
+	*delayp += ext->block;
+	return 0;
+}
+
+static snd_pcm_sframes_t snd_pcm_extplug_rewindable(snd_pcm_t *pcm)
+{
+	extplug_priv_t *ext = pcm->private_data;
+
+	/* the accumulated part of a block can't be taken back */
+	if (ext->block)
+		return 0;
+	return snd_pcm_plugin_fast_ops.rewindable(pcm);
+}
+
+static snd_pcm_sframes_t snd_pcm_extplug_rewind(snd_pcm_t *pcm,
+						snd_pcm_uframes_t frames)
+{
+	extplug_priv_t *ext = pcm->private_data;
+
+	if (ext->block)
+		return 0;
+	return snd_pcm_plugin_rewind(pcm, frames);
+}
+
+/*
+ * push the pending block through to the slave before draining it;
+ * feeding one block of silence hands out both the rest of the previous
+ * output block and the processed tail of the current one
+ */
+static int snd_pcm_extplug_drain(snd_pcm_t *pcm)
+{
+	extplug_priv_t *ext = pcm->private_data;
+	snd_pcm_t *slave = ext->plug.gen.slave;
+	int err = 0;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK || !ext->block)
+		return snd_pcm_generic_drain(pcm);
+
+	__snd_pcm_lock(pcm);
+	if (!ext->blk_draining) {
+		ext->blk_draining = 1;
+		ext->blk_flush = ext->blk_used ? ext->block : 0;
+	}
+	while (ext->blk_flush > 0) {
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset, frames = ext->blk_flush;
+		snd_pcm_sframes_t result;
+
+		result = snd_pcm_avail_update(slave);
+		if (result < 0) {
+			err = result;
+			break;
+		}
+		if (result == 0) {
+			if (pcm->mode & SND_PCM_NONBLOCK) {
+				err = -EAGAIN;
+				break;
+			}
+			if (snd_pcm_state(slave) == SND_PCM_STATE_PREPARED) {
+				err = snd_pcm_start(slave);
+				if (err < 0)
+					break;
+			}
+			err = __snd_pcm_wait_in_lock(slave, SND_PCM_WAIT_DRAIN);
+			if (err < 0)
+				break;
+			continue;
+		}
+		err = snd_pcm_mmap_begin(slave, &areas, &offset, &frames);
+		if (err < 0)
+			break;
+		frames = snd_pcm_extplug_block_xfer(ext, areas, offset,
+						    NULL, 0, frames);
+		result = snd_pcm_mmap_commit(slave, offset, frames);
+		if (result < 0) {
+			err = result;
+			break;
+		}
+		ext->blk_flush -= frames;
+	}
+	__snd_pcm_unlock(pcm);
+	if (err < 0)
+		return err;
+	return snd_pcm_generic_drain(pcm);
 }
 
 /*
@@ -402,6 +672,8 @@ static void snd_pcm_extplug_dump(snd_pcm_t *pcm, snd_output_t *out)
 			snd_pcm_dump_setup(pcm, out);
 		}
 	}
+	if (ext->block)
+		snd_output_printf(out, "Block size: %lu\n", ext->block);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(ext->plug.gen.slave, out);
 }
@@ -420,6 +692,7 @@ static int snd_pcm_extplug_close(snd_pcm_t *pcm)
 	extplug_priv_t *ext = pcm->private_data;
 
 	snd_pcm_close(ext->plug.gen.slave);
+	snd_pcm_extplug_free_block(ext);
 	clear_ext_params(ext);
 	if (ext->data->callback->close)
 		ext->data->callback->close(ext->data);
@@ -624,6 +897,17 @@ The init callback is called when the PCM is at prepare state or any
 initialization is issued.  Use this callback to reset the PCM instance
 to a sane initial state.
 
+Since version 1.0.3, the plugin may ask for a fixed transfer size by
+setting the block_size field, either before calling
+#snd_pcm_extplug_create() or in the hw_params callback (e.g. to a
+multiple of the period size).  Then alsa-lib accumulates the data in
+its own buffers and calls the transfer callback only with exactly
+block_size frames at offset zero, in non-interleaved areas whose
+channel buffers are aligned to block_align bytes.  This costs one
+block of latency, which is reported in the delay field and included
+in #snd_pcm_delay(); the PCM can't be rewound in this mode.  At drain,
+the last partial block is padded with silence and processed.
+
 The hw_params constraints can be defined via either
 #snd_pcm_extplug_set_param_minmax() and #snd_pcm_extplug_set_param_list()
 functions after calling #snd_pcm_extplug_create().
@@ -717,8 +1001,7 @@ int snd_pcm_extplug_create(snd_pcm_extplug_t *extplug, const char *name,
 	ext->plug.undo_write = snd_pcm_plugin_undo_write_generic;
 	ext->plug.gen.slave = spcm;
 	ext->plug.gen.close_slave = 1;
-	if (extplug->version >= 0x010001 && extplug->callback->init)
-		ext->plug.init = snd_pcm_extplug_init;
+	ext->plug.init = snd_pcm_extplug_init;
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_EXTPLUG, name, stream, mode);
 	if (err < 0) {
@@ -728,7 +1011,13 @@ int snd_pcm_extplug_create(snd_pcm_extplug_t *extplug, const char *name,
 
 	extplug->pcm = pcm;
 	pcm->ops = &snd_pcm_extplug_ops;
-	pcm->fast_ops = &snd_pcm_plugin_fast_ops;
+	ext->fops = snd_pcm_plugin_fast_ops;
+	ext->fops.status = snd_pcm_extplug_status;
+	ext->fops.delay = snd_pcm_extplug_delay;
+	ext->fops.drain = snd_pcm_extplug_drain;
+	ext->fops.rewindable = snd_pcm_extplug_rewindable;
+	ext->fops.rewind = snd_pcm_extplug_rewind;
+	pcm->fast_ops = &ext->fops;
 	pcm->private_data = ext;
 	pcm->poll_fd = spcm->poll_fd;
 	pcm->poll_events = spcm->poll_events;
@@ -31,6 +31,11 @@
 #include "bswap.h"
 #include <ctype.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -51,7 +56,8 @@ const char *_snd_module_pcm_file = "";
 
 typedef enum _snd_pcm_file_format {
 	SND_PCM_FILE_FORMAT_RAW,
-	SND_PCM_FILE_FORMAT_WAV
+	SND_PCM_FILE_FORMAT_WAV,
+	SND_PCM_FILE_FORMAT_LOSSLESS
 } snd_pcm_file_format_t;
 
 /* WAV format chunk */
@@ -64,6 +70,12 @@ struct wav_fmt {
 	short bits;
 };
 
+/* default size of the async_write ring in bytes */
+#define ASYNC_BUFFER_DEFAULT	(1024 * 1024)
+
+struct snd_pcm_file_async;
+struct snd_pcm_file_lossless;
+
 typedef struct {
 	snd_pcm_generic_t gen;
 	char *fname;
@@ -74,6 +86,10 @@ typedef struct {
 	FILE *pipe;
 	char *ifname;
 	int ifd;
+	int ifloop;			/* restart the input at its end */
+	char *ifmap;			/* infile_mmap mapping */
+	size_t ifmap_size;
+	size_t ifmap_pos;
 	int format;
 	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_uframes_t file_ptr_bytes;
@@ -90,6 +106,9 @@ typedef struct {
 	struct wav_fmt wav_header;
 	size_t filelen;
 	char ifmmap_overwritten;
+	size_t async_size;		/* requested ring size, 0 = sync writes */
+	struct snd_pcm_file_async *async;
+	struct snd_pcm_file_lossless *lossless;
 } snd_pcm_file_t;
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -115,6 +134,475 @@ static ssize_t safe_write(int fd, const void *buf, size_t len)
 	}
 }
 
+/*
+ * lossless format: the stream is cut into blocks of LOSSLESS_BLOCK frames,
+ * and each channel of a block is coded with the best of the fixed
+ * polynomial predictors of order 0 to 3 and Rice coded residuals, or
+ * stored verbatim when that is smaller.
+ *
+ * file header (little endian):
+ *	"ALSALOSS", u16 version (1), u16 channels, u32 rate,
+ *	u32 format (snd_pcm_format_t), u32 block frames
+ * block:
+ *	u32 frames, u32 payload bytes, payload
+ * payload, MSB first bit stream padded to a byte, for each channel:
+ *	3 bits order (0-3, or 7 for verbatim)
+ *	verbatim: frames samples of width bits
+ *	predicted: 5 bits Rice parameter k, order warm-up samples of width
+ *	bits, then for each further sample the zigzag mapped residual u:
+ *	(u >> k) one bits, a zero bit and the low k bits of u, or when
+ *	u >> k reaches LOSSLESS_ESCAPE, LOSSLESS_ESCAPE one bits and u in
+ *	40 bits
+ */
+#define LOSSLESS_BLOCK		4096
+#define LOSSLESS_ESCAPE		24
+#define LOSSLESS_VERBATIM	7
+
+struct snd_pcm_file_lossless {
+	unsigned int channels;
+	unsigned int width;		/* significant sample bits */
+	unsigned int bytes;		/* sample container bytes */
+	size_t frame_bytes;
+	char *raw;			/* pending interleaved frames */
+	size_t raw_used;
+	int32_t *samples;		/* one channel of a block */
+	unsigned char *out;
+	unsigned char *ptr;
+	uint64_t acc;
+	unsigned int nbits;
+	int header;			/* file header written */
+};
+
+static void lossless_put(struct snd_pcm_file_lossless *l, uint32_t val, unsigned int bits)
+{
+	if (bits < 32)
+		val &= (1U << bits) - 1;
+	l->acc = (l->acc << bits) | val;
+	l->nbits += bits;
+	while (l->nbits >= 8) {
+		l->nbits -= 8;
+		*l->ptr++ = l->acc >> l->nbits;
+	}
+}
+
+static void lossless_put_ones(struct snd_pcm_file_lossless *l, unsigned int count)
+{
+	for (; count >= 16; count -= 16)
+		lossless_put(l, 0xffff, 16);
+	if (count)
+		lossless_put(l, 0xffff, count);
+}
+
+static inline uint64_t lossless_residual(const int32_t *x, unsigned int i,
+					 unsigned int order)
+{
+	int64_t e;
+
+	switch (order) {
+	case 0:
+		e = x[i];
+		break;
+	case 1:
+		e = (int64_t)x[i] - x[i - 1];
+		break;
+	case 2:
+		e = (int64_t)x[i] - 2 * (int64_t)x[i - 1] + x[i - 2];
+		break;
+	default:
+		e = (int64_t)x[i] - 3 * (int64_t)x[i - 1] +
+			3 * (int64_t)x[i - 2] - x[i - 3];
+		break;
+	}
+	return ((uint64_t)e << 1) ^ (uint64_t)(e >> 63);
+}
+
+static void lossless_encode_channel(struct snd_pcm_file_lossless *l,
+				    const int32_t *x, unsigned int n)
+{
+	uint64_t sum[4] = { 0, 0, 0, 0 }, bits, u;
+	unsigned int i, order, best = 0, k = 0;
+
+	for (i = 3; i < n; i++)
+		for (order = 0; order < 4; order++)
+			sum[order] += lossless_residual(x, i, order);
+	for (order = 1; order < 4; order++)
+		if (sum[order] < sum[best])
+			best = order;
+	if (n > best) {
+		sum[best] = 0;
+		for (i = best; i < n; i++)
+			sum[best] += lossless_residual(x, i, best);
+		while (k < 31 &&
+		       ((uint64_t)(n - best) << (k + 1)) < sum[best])
+			k++;
+	}
+	bits = 5 + (uint64_t)best * l->width;
+	for (i = best; i < n; i++) {
+		u = lossless_residual(x, i, best) >> k;
+		bits += u < LOSSLESS_ESCAPE ? u + 1 + k : LOSSLESS_ESCAPE + 40;
+	}
+
+	if (n <= best || bits >= (uint64_t)n * l->width) {
+		lossless_put(l, LOSSLESS_VERBATIM, 3);
+		for (i = 0; i < n; i++)
+			lossless_put(l, x[i], l->width);
+		return;
+	}
+	lossless_put(l, best, 3);
+	lossless_put(l, k, 5);
+	for (i = 0; i < best; i++)
+		lossless_put(l, x[i], l->width);
+	for (i = best; i < n; i++) {
+		u = lossless_residual(x, i, best);
+		if ((u >> k) < LOSSLESS_ESCAPE) {
+			lossless_put_ones(l, u >> k);
+			lossless_put(l, 0, 1);
+			if (k)
+				lossless_put(l, u, k);
+		} else {
+			lossless_put_ones(l, LOSSLESS_ESCAPE);
+			lossless_put(l, u >> 32, 8);
+			lossless_put(l, u, 32);
+		}
+	}
+}
+
+static ssize_t safe_write_all(int fd, const void *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t r = safe_write(fd, (const char *)buf + done, len - done);
+		if (r < 0)
+			return r;
+		done += r;
+	}
+	return len;
+}
+
+static void lossless_put_le(unsigned char *p, uint32_t val, unsigned int bytes)
+{
+	while (bytes--) {
+		*p++ = val;
+		val >>= 8;
+	}
+}
+
+/* code the pending frames as one block */
+static int snd_pcm_file_lossless_flush(struct snd_pcm_file_lossless *l, int fd)
+{
+	unsigned int frames = l->raw_used / l->frame_bytes;
+	unsigned int chn, i;
+	ssize_t err;
+
+	if (!frames)
+		return 0;
+	l->ptr = l->out + 8;
+	l->acc = 0;
+	l->nbits = 0;
+	for (chn = 0; chn < l->channels; chn++) {
+		const char *src = l->raw + chn * l->bytes;
+		for (i = 0; i < frames; i++, src += l->frame_bytes) {
+			switch (l->bytes) {
+			case 2:
+				l->samples[i] = *(const int16_t *)src;
+				break;
+			default:
+				l->samples[i] = *(const int32_t *)src;
+				if (l->width == 24)
+					l->samples[i] = (int32_t)((uint32_t)l->samples[i] << 8) >> 8;
+				break;
+			}
+		}
+		lossless_encode_channel(l, l->samples, frames);
+	}
+	if (l->nbits)
+		lossless_put(l, 0, 8 - l->nbits);
+	lossless_put_le(l->out, frames, 4);
+	lossless_put_le(l->out + 4, l->ptr - l->out - 8, 4);
+	l->raw_used = 0;
+	err = safe_write_all(fd, l->out, l->ptr - l->out);
+	return err < 0 ? err : 0;
+}
+
+static ssize_t snd_pcm_file_lossless_write(struct snd_pcm_file_lossless *l,
+					   int fd, const char *buf, size_t len)
+{
+	size_t block_bytes = LOSSLESS_BLOCK * l->frame_bytes;
+	size_t done = 0, n;
+	int err;
+
+	while (done < len) {
+		n = block_bytes - l->raw_used;
+		if (n > len - done)
+			n = len - done;
+		memcpy(l->raw + l->raw_used, buf + done, n);
+		l->raw_used += n;
+		done += n;
+		if (l->raw_used == block_bytes) {
+			err = snd_pcm_file_lossless_flush(l, fd);
+			if (err < 0)
+				return err;
+		}
+	}
+	return len;
+}
+
+static int write_lossless_header(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	unsigned char header[24];
+	ssize_t res;
+
+	memcpy(header, "ALSALOSS", 8);
+	lossless_put_le(header + 8, 1, 2);
+	lossless_put_le(header + 10, pcm->channels, 2);
+	lossless_put_le(header + 12, pcm->rate, 4);
+	lossless_put_le(header + 16, pcm->format, 4);
+	lossless_put_le(header + 20, LOSSLESS_BLOCK, 4);
+	res = safe_write_all(file->fd, header, sizeof(header));
+	if (res < 0) {
+		SYSERR("%s write header failed", file->fname);
+		return res;
+	}
+	file->lossless->header = 1;
+	return 0;
+}
+
+static void snd_pcm_file_lossless_free(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_lossless *l = file->lossless;
+
+	if (!l)
+		return;
+	free(l->raw);
+	free(l->samples);
+	free(l->out);
+	free(l);
+	file->lossless = NULL;
+}
+
+/* called from hw_params, the setup of pcm itself isn't filled yet */
+static int snd_pcm_file_lossless_setup(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_t *slave = file->gen.slave;
+	struct snd_pcm_file_lossless *l = file->lossless;
+	unsigned int bytes, width;
+
+	switch (slave->format) {
+	case SND_PCM_FORMAT_S16:
+	case SND_PCM_FORMAT_S24:
+	case SND_PCM_FORMAT_S32:
+		break;
+	default:
+		SNDERR("lossless file format supports only native S16, S24 and S32");
+		return -EINVAL;
+	}
+	bytes = snd_pcm_format_physical_width(slave->format) / 8;
+	width = snd_pcm_format_width(slave->format);
+	if (l) {
+		/* the file header is written once */
+		if (l->channels != slave->channels || l->width != width ||
+		    l->bytes != bytes) {
+			SNDERR("lossless file %s can't change its format", file->fname);
+			return -EINVAL;
+		}
+		return 0;
+	}
+	l = calloc(1, sizeof(*l));
+	if (!l)
+		return -ENOMEM;
+	file->lossless = l;
+	l->channels = slave->channels;
+	l->width = width;
+	l->bytes = bytes;
+	l->frame_bytes = (size_t)bytes * l->channels;
+	l->raw = malloc(LOSSLESS_BLOCK * l->frame_bytes);
+	l->samples = malloc(LOSSLESS_BLOCK * sizeof(*l->samples));
+	/* the verbatim fallback bounds a channel to width bits per sample */
+	l->out = malloc(8 + l->channels * (LOSSLESS_BLOCK * 4 + 2));
+	if (!l->raw || !l->samples || !l->out) {
+		snd_pcm_file_lossless_free(file);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+/* write the raw stream data to the file, coding it when needed */
+static ssize_t snd_pcm_file_output(snd_pcm_file_t *file, const char *buf, size_t len)
+{
+	if (file->lossless)
+		return snd_pcm_file_lossless_write(file->lossless, file->fd, buf, len);
+	return safe_write(file->fd, buf, len);
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * async_write: the audio thread queues the output into a single producer,
+ * single consumer ring and a writer thread empties it into the file.
+ * Only the writer sleeps on the mutex; the audio thread takes it just to
+ * wake an idle writer and never waits for the disk.  When the ring is
+ * full, the data is dropped and counted instead.
+ */
+struct snd_pcm_file_async {
+	snd_pcm_file_t *file;
+	char *buf;
+	size_t size;
+	size_t head;			/* bytes queued, written by the audio thread */
+	size_t tail;			/* bytes written out, by the writer thread */
+	snd_pcm_uframes_t dropped;	/* frames lost to a full ring */
+	int idle;
+	int quit;
+	int err;			/* first write error */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+};
+
+static void *snd_pcm_file_async_thread(void *arg)
+{
+	struct snd_pcm_file_async *async = arg;
+	size_t head, tail, n;
+	ssize_t r;
+
+	for (;;) {
+		tail = async->tail;
+		head = __atomic_load_n(&async->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			pthread_mutex_lock(&async->mutex);
+			__atomic_store_n(&async->idle, 1, __ATOMIC_SEQ_CST);
+			while (__atomic_load_n(&async->head, __ATOMIC_SEQ_CST) == tail &&
+			       !async->quit)
+				pthread_cond_wait(&async->cond, &async->mutex);
+			async->idle = 0;
+			pthread_mutex_unlock(&async->mutex);
+			if (async->quit &&
+			    __atomic_load_n(&async->head, __ATOMIC_ACQUIRE) == tail)
+				break;
+			continue;
+		}
+		n = head - tail;
+		if (n > async->size - tail % async->size)
+			n = async->size - tail % async->size;
+		r = async->err ? (ssize_t)n :
+			snd_pcm_file_output(async->file, async->buf + tail % async->size, n);
+		if (r < 0) {
+			/* keep draining, to not block the audio thread */
+			async->err = r;
+			r = n;
+		}
+		__atomic_store_n(&async->tail, tail + r, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static int snd_pcm_file_async_start(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_async *async;
+	int err;
+
+	if (!file->async_size || file->async)
+		return 0;
+	async = calloc(1, sizeof(*async));
+	if (!async)
+		return -ENOMEM;
+	/* a whole buffer has to fit, it's queued or dropped at once */
+	async->size = file->async_size;
+	if (async->size < file->wbuf_size_bytes)
+		async->size = file->wbuf_size_bytes;
+	async->buf = malloc(async->size);
+	if (!async->buf) {
+		free(async);
+		return -ENOMEM;
+	}
+	async->file = file;
+	pthread_mutex_init(&async->mutex, NULL);
+	pthread_cond_init(&async->cond, NULL);
+	err = pthread_create(&async->thread, NULL, snd_pcm_file_async_thread, async);
+	if (err) {
+		pthread_cond_destroy(&async->cond);
+		pthread_mutex_destroy(&async->mutex);
+		free(async->buf);
+		free(async);
+		return -err;
+	}
+	file->async = async;
+	return 0;
+}
+
+/* flush the ring and stop the writer */
+static void snd_pcm_file_async_stop(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_async *async = file->async;
+
+	if (!async)
+		return;
+	pthread_mutex_lock(&async->mutex);
+	async->quit = 1;
+	pthread_cond_signal(&async->cond);
+	pthread_mutex_unlock(&async->mutex);
+	pthread_join(async->thread, NULL);
+	if (async->err < 0)
+		SNDERR("%s write failed, file data may be corrupt: %s",
+		       file->fname, snd_strerror(async->err));
+	if (async->dropped)
+		SNDERR("%s: %lu frames dropped by async write",
+		       file->fname, async->dropped);
+	pthread_cond_destroy(&async->cond);
+	pthread_mutex_destroy(&async->mutex);
+	free(async->buf);
+	free(async);
+	file->async = NULL;
+}
+
+/* queue the data for the writer thread or drop it if there is no room */
+static void snd_pcm_file_async_write(snd_pcm_t *pcm, const char *buf, size_t len)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	struct snd_pcm_file_async *async = file->async;
+	size_t head = async->head, pos, n;
+
+	if (len > async->size -
+	    (head - __atomic_load_n(&async->tail, __ATOMIC_ACQUIRE))) {
+		async->dropped += snd_pcm_bytes_to_frames(pcm, len);
+		return;
+	}
+	pos = head % async->size;
+	n = async->size - pos;
+	if (n > len)
+		n = len;
+	memcpy(async->buf + pos, buf, n);
+	memcpy(async->buf, buf + n, len - n);
+	__atomic_store_n(&async->head, head + len, __ATOMIC_SEQ_CST);
+	file->filelen += len;
+	if (__atomic_load_n(&async->idle, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&async->mutex);
+		pthread_cond_signal(&async->cond);
+		pthread_mutex_unlock(&async->mutex);
+	}
+}
+#else /* HAVE_LIBPTHREAD */
+struct snd_pcm_file_async {
+	snd_pcm_uframes_t dropped;
+};
+
+static inline int snd_pcm_file_async_start(snd_pcm_file_t *file ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static inline void snd_pcm_file_async_stop(snd_pcm_file_t *file ATTRIBUTE_UNUSED)
+{
+}
+
+static inline void snd_pcm_file_async_write(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+					    const char *buf ATTRIBUTE_UNUSED,
+					    size_t len ATTRIBUTE_UNUSED)
+{
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static int snd_pcm_file_append_value(char **string_p, char **index_ch_p,
 		int *len_p, const char *value)
 {
@@ -286,6 +774,83 @@ static int snd_pcm_file_open_output_file(snd_pcm_file_t *file)
 	return 0;
 }
 
+/* map the whole input file for infile_mmap, falls back to read() on failure */
+static void snd_pcm_file_map_infile(snd_pcm_file_t *file)
+{
+	struct stat st;
+	void *ptr;
+
+	if (fstat(file->ifd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size) {
+		SNDERR("infile_mmap: input is not a mappable file, using read()");
+		return;
+	}
+	ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file->ifd, 0);
+	if (ptr == MAP_FAILED) {
+		SYSERR("infile_mmap: mmap failed, using read()");
+		return;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+#endif
+	file->ifmap = ptr;
+	file->ifmap_size = st.st_size;
+	file->ifmap_pos = 0;
+}
+
+/* fill areas straight from the mapped input file, return bytes copied */
+static int snd_pcm_file_areas_map_infile(snd_pcm_t *pcm,
+					 const snd_pcm_channel_area_t *areas,
+					 snd_pcm_uframes_t offset,
+					 snd_pcm_uframes_t frames)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_channel_area_t areas_if[pcm->channels];
+	snd_pcm_uframes_t avail, n, done = 0;
+
+	while (done < frames) {
+		avail = snd_pcm_bytes_to_frames(pcm, file->ifmap_size - file->ifmap_pos);
+		if (!avail) {
+			if (!file->ifloop || file->ifmap_pos == 0)
+				break;
+			file->ifmap_pos = 0;
+			continue;
+		}
+		n = frames - done;
+		if (n > avail)
+			n = avail;
+		snd_pcm_areas_from_buf(pcm, areas_if, file->ifmap + file->ifmap_pos);
+		snd_pcm_areas_copy(areas, offset + done, areas_if, 0,
+				   pcm->channels, n, pcm->format);
+		file->ifmap_pos += snd_pcm_frames_to_bytes(pcm, n);
+		done += n;
+	}
+	return snd_pcm_frames_to_bytes(pcm, done);
+}
+
+/* read for infile_loop, restarting the input file at its end */
+static ssize_t snd_pcm_file_read_loop(snd_pcm_file_t *file, size_t bytes)
+{
+	size_t done = 0;
+	int rewound = 0;
+	ssize_t r;
+
+	while (done < bytes) {
+		r = read(file->ifd, file->rbuf + done, bytes - done);
+		if (r < 0)
+			return done ? (ssize_t)done : r;
+		if (r == 0) {
+			/* stop on an empty or unseekable input */
+			if (rewound || lseek(file->ifd, 0, SEEK_SET) != 0)
+				break;
+			rewound = 1;
+			continue;
+		}
+		rewound = 0;
+		done += r;
+	}
+	return done;
+}
+
 /* fill areas with data from input file, return bytes red */
 static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 					  const snd_pcm_channel_area_t *areas,
@@ -299,6 +864,9 @@ static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 	if (file->ifd < 0)
 		return -EBADF;
 
+	if (file->ifmap)
+		return snd_pcm_file_areas_map_infile(pcm, areas, offset, frames);
+
 	if (file->rbuf == NULL)
 		return -ENOMEM;
 
@@ -310,7 +878,10 @@ static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 	bytes = snd_pcm_frames_to_bytes(pcm, frames);
 	if (bytes < 0)
 		return bytes;
-	bytes = read(file->ifd, file->rbuf, bytes);
+	if (file->ifloop)
+		bytes = snd_pcm_file_read_loop(file, bytes);
+	else
+		bytes = read(file->ifd, file->rbuf, bytes);
 	if (bytes < 0) {
 		SYSERR("read from file failed, error: %d", bytes);
 		return bytes;
@@ -430,25 +1001,38 @@ static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 			return err;
 		}
 	}
+	if (file->lossless && !file->lossless->header) {
+		err = write_lossless_header(pcm);
+		if (err < 0) {
+			file->wbuf_used_bytes = 0;
+			file->file_ptr_bytes = 0;
+			return err;
+		}
+	}
 
 	while (bytes > 0) {
 		size_t n = bytes;
 		size_t cont = file->wbuf_size_bytes - file->file_ptr_bytes;
 		if (n > cont)
 			n = cont;
-		err = safe_write(file->fd, file->wbuf + file->file_ptr_bytes, n);
-		if (err < 0) {
-			file->wbuf_used_bytes = 0;
-			file->file_ptr_bytes = 0;
-			SYSERR("%s write failed, file data may be corrupt", file->fname);
-			return err;
+		if (file->async) {
+			snd_pcm_file_async_write(pcm, file->wbuf + file->file_ptr_bytes, n);
+			err = n;
+		} else {
+			err = snd_pcm_file_output(file, file->wbuf + file->file_ptr_bytes, n);
+			if (err < 0) {
+				file->wbuf_used_bytes = 0;
+				file->file_ptr_bytes = 0;
+				SYSERR("%s write failed, file data may be corrupt", file->fname);
+				return err;
+			}
+			file->filelen += err;
 		}
 		bytes -= err;
 		file->wbuf_used_bytes -= err;
 		file->file_ptr_bytes += err;
 		if (file->file_ptr_bytes == file->wbuf_size_bytes)
 			file->file_ptr_bytes = 0;
-		file->filelen += err;
 		if ((snd_pcm_uframes_t)err != n)
 			break;
 	}
@@ -492,6 +1076,12 @@ static int snd_pcm_file_add_frames(snd_pcm_t *pcm,
 static int snd_pcm_file_close(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_async_stop(file);
+	if (file->lossless) {
+		if (snd_pcm_file_lossless_flush(file->lossless, file->fd) < 0)
+			SYSERR("%s write failed, file data may be corrupt", file->fname);
+		snd_pcm_file_lossless_free(file);
+	}
 	if (file->fname) {
 		if (file->wav_header.fmt)
 			fixup_wav_header(pcm);
@@ -502,6 +1092,8 @@ static int snd_pcm_file_close(snd_pcm_t *pcm)
 			close(file->fd);
 		}
 	}
+	if (file->ifmap)
+		munmap(file->ifmap, file->ifmap_size);
 	if (file->ifname) {
 		free((void *)file->ifname);
 		close(file->ifd);
@@ -756,6 +1348,7 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	int err = _snd_pcm_hw_params_internal(slave, params);
 	if (err < 0)
 		return err;
+	snd_pcm_profile_link(pcm, slave);
 	file->buffer_bytes = snd_pcm_frames_to_bytes(slave, slave->buffer_size);
 	file->wbuf_size = slave->buffer_size * 2;
 	file->wbuf_size_bytes = snd_pcm_frames_to_bytes(slave, file->wbuf_size);
@@ -795,6 +1388,19 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			return err;
 		}
 	}
+	if (file->format == SND_PCM_FILE_FORMAT_LOSSLESS) {
+		err = snd_pcm_file_lossless_setup(pcm);
+		if (err < 0) {
+			snd_pcm_file_hw_free(pcm);
+			return err;
+		}
+	}
+	err = snd_pcm_file_async_start(file);
+	if (err < 0) {
+		SNDERR("cannot start the async writer for %s", file->fname);
+		snd_pcm_file_hw_free(pcm);
+		return err;
+	}
 
 	/* pointer may have changed - e.g if plug is used. */
 	snd_pcm_unlink_hw_ptr(pcm, file->gen.slave);
@@ -816,6 +1422,9 @@ static void snd_pcm_file_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (file->final_fname)
 		snd_output_printf(out, "Final file PCM (file=%s)\n",
 				file->final_fname);
+	if (file->async)
+		snd_output_printf(out, "Async write (buffer=%zu, dropped=%lu)\n",
+				  file->async_size, file->async->dropped);
 
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
@@ -885,7 +1494,7 @@ static const snd_pcm_fast_ops_t snd_pcm_file_fast_ops = {
  * \param ifd Input file descriptor (if (ifd < 0) && (ifname == NULL), no input
  *            redirection will be performed)
  * \param trunc Truncate the file if it already exists
- * \param fmt File format ("raw" or "wav" are available)
+ * \param fmt File format ("raw", "wav" or "lossless" are available)
  * \param perm File permission
  * \param slave Slave PCM handle
  * \param close_slave When set, the slave PCM handle is closed with copy PCM
@@ -913,6 +1522,8 @@ int snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		format = SND_PCM_FILE_FORMAT_RAW;
 	else if (!strcmp(fmt, "wav"))
 		format = SND_PCM_FILE_FORMAT_WAV;
+	else if (!strcmp(fmt, "lossless"))
+		format = SND_PCM_FILE_FORMAT_LOSSLESS;
 	else {
 		SNDERR("file format %s is unknown", fmt);
 		return -EINVAL;
@@ -1004,11 +1615,33 @@ pcm.name {
 	infile STR		# Input filename - only raw format
 	or
 	infile INT		# Input file descriptor number
-	[format STR]		# File format ("raw" or "wav")
+	[infile_mmap BOOL]	# Map the input file instead of reading it
+	[infile_loop BOOL]	# Restart the input file at its end
+	[format STR]		# File format ("raw", "wav" or "lossless")
 	[perm INT]		# Output file permission (octal, def. 0600)
+	[async_write BOOL]	# Write the file from a separate thread
+	[async_buffer INT]	# Size of the async_write queue in bytes
+				# (def. 1048576)
 }
 \endcode
 
+With async_write enabled, the output is queued to a writer thread instead
+of being written in the audio thread, so a slow disk or a stalled pipe
+doesn't cause xruns.  When the queue is full, the data is dropped and the
+number of lost frames is reported when the PCM is closed.
+
+With infile_mmap, the input file is mapped with sequential read-ahead and
+the capture data is copied straight from the mapping, which saves a read()
+call and a bounce copy per transfer when replaying long multichannel
+captures.  infile_loop replays the input file from the start when its end
+is reached, in both modes.
+
+The lossless format compresses S16, S24 and S32 streams of any channel
+count without loss, using fixed linear prediction and Rice coding of the
+residuals in blocks of 4096 frames; together with async_write the coding
+runs on the writer thread.  The test/file-unpack program converts such
+files back to WAV.
+
 \subsection pcm_plugins_file_funcref Function reference
 
 <UL>
@@ -1043,6 +1676,9 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	const char *format = NULL;
 	long fd = -1, ifd = -1, trunc = 1;
 	long perm = 0600;
+	long async_buffer = ASYNC_BUFFER_DEFAULT;
+	int async_write = 0;
+	int infile_mmap = 0, infile_loop = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1103,6 +1739,39 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 			trunc = err;
 			continue;
 		}
+		if (strcmp(id, "infile_mmap") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			infile_mmap = err;
+			continue;
+		}
+		if (strcmp(id, "infile_loop") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			infile_loop = err;
+			continue;
+		}
+		if (strcmp(id, "async_write") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			async_write = err;
+			continue;
+		}
+		if (strcmp(id, "async_buffer") == 0) {
+			err = snd_config_get_integer(n, &async_buffer);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (async_buffer <= 0) {
+				SNDERR("The field async_buffer must be positive");
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1135,9 +1804,25 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_file_open(pcmp, name, fname, fd, ifname, ifd,
 				trunc, format, perm, spcm, 1, stream);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	if (stream == SND_PCM_STREAM_CAPTURE) {
+		snd_pcm_file_t *file = (*pcmp)->private_data;
+		file->ifloop = infile_loop;
+		if (infile_mmap && file->ifd >= 0)
+			snd_pcm_file_map_infile(file);
+	}
+	if (async_write) {
+#ifdef HAVE_LIBPTHREAD
+		snd_pcm_file_t *file = (*pcmp)->private_data;
+		file->async_size = async_buffer;
+#else
+		SNDERR("async_write is not supported without threads");
+#endif
+	}
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_file_open, SND_PCM_DLSYM_VERSION);
@@ -162,3 +162,16 @@ snd_pcm_chmap_t *snd_pcm_generic_get_chmap(snd_pcm_t *pcm);
 int snd_pcm_generic_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map);
 int snd_pcm_generic_may_wait_for_avail_min(snd_pcm_t *pcm, snd_pcm_uframes_t avail);
 
+/* chain-wide arena for the intermediate buffers of the plugins
+ * (implemented in pcm_plugin.c)
+ */
+#define snd_pcm_arena_link \
+	snd1_pcm_arena_link
+#define snd_pcm_arena_alloc \
+	snd1_pcm_arena_alloc
+#define snd_pcm_arena_free \
+	snd1_pcm_arena_free
+
+void snd_pcm_arena_link(snd_pcm_t *pcm, snd_pcm_t *slave);
+void *snd_pcm_arena_alloc(snd_pcm_t *pcm, size_t size);
+void snd_pcm_arena_free(void *ptr);
@@ -0,0 +1,297 @@
+/**
+ * \file pcm/pcm_group.c
+ * \ingroup PCM_Start_Group
+ * \brief PCM Start Groups
+ * \date 2026
+ *
+ * Starting and stopping a set of PCMs together.
+ */
+/*
+ *  PCM - Start groups
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * \page pcm_start_group PCM start groups
+ *
+ * snd_pcm_link() starts the linked streams at once, but only where the
+ * kernel can link them: hw PCMs, and the plugins passing it to such a
+ * slave.  The PCMs of dmix, of an ioplug or of different cards are
+ * started one after another by the application, each start taking the
+ * time of the previous ones.
+ *
+ * A start group holds a set of PCMs of any type.  snd_pcm_start_group_start()
+ * checks first that all of them are prepared, so that nothing can fail
+ * halfway for a foreseeable reason, and then triggers all of them in a
+ * single loop doing nothing else.  The hw members are also linked in the
+ * kernel when they are added, where possible: they are then started by
+ * one trigger.  The skew achieved, the time between the end of the first
+ * and of the last trigger, is returned, so that the caller can check it
+ * or compensate for it.
+ *
+ * A playback PCM must be filled before the start, as for snd_pcm_start().
+ * A group is not thread-safe, and no lock is taken besides the ones of
+ * the PCMs while they are triggered.
+ *
+ * \code
+ * snd_pcm_start_group_open(&group);
+ * snd_pcm_start_group_add(group, pcm_a);
+ * snd_pcm_start_group_add(group, pcm_b);
+ * snd_pcm_start_group_prepare(group);
+ * ... fill the playback PCMs ...
+ * snd_pcm_start_group_start(group, &skew);
+ * \endcode
+ */
+
+#ifndef DOC_HIDDEN
+
+struct start_member {
+	snd_pcm_t *pcm;
+	int linked;			/* started in the kernel with the anchor */
+};
+
+struct _snd_pcm_start_group {
+	unsigned int count;
+	unsigned int size;
+	struct start_member *members;
+	snd_pcm_t *anchor;		/* hw member the others are linked to */
+};
+
+#endif /* DOC_HIDDEN */
+
+static long long ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+/**
+ * \brief Create a PCM start group
+ * \param groupp Returned group handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_start_group_open(snd_pcm_start_group_t **groupp)
+{
+	snd_pcm_start_group_t *group;
+
+	assert(groupp);
+	group = calloc(1, sizeof(*group));
+	if (!group)
+		return -ENOMEM;
+	*groupp = group;
+	return 0;
+}
+
+/**
+ * \brief Free a PCM start group
+ * \param group Group handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The kernel links made by the group are removed.  The member PCMs are
+ * left open, in their current state.
+ */
+int snd_pcm_start_group_close(snd_pcm_start_group_t *group)
+{
+	unsigned int i;
+
+	assert(group);
+	for (i = 0; i < group->count; i++)
+		if (group->members[i].linked)
+			snd_pcm_unlink(group->members[i].pcm);
+	free(group->members);
+	free(group);
+	return 0;
+}
+
+/**
+ * \brief Add a PCM to a start group
+ * \param group Group handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The PCM must be set up with snd_pcm_hw_params().  A hw PCM is linked
+ * in the kernel to the first hw member when the driver allows it.
+ * Remove the PCM with snd_pcm_start_group_remove() before closing it.
+ */
+int snd_pcm_start_group_add(snd_pcm_start_group_t *group, snd_pcm_t *pcm)
+{
+	struct start_member *m;
+	unsigned int i;
+
+	assert(group && pcm);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	for (i = 0; i < group->count; i++)
+		if (group->members[i].pcm == pcm)
+			return -EBUSY;
+	if (group->count == group->size) {
+		m = realloc(group->members, (group->size + 8) * sizeof(*m));
+		if (!m)
+			return -ENOMEM;
+		group->members = m;
+		group->size += 8;
+	}
+	m = &group->members[group->count++];
+	m->pcm = pcm;
+	m->linked = 0;
+	if (snd_pcm_type(pcm) != SND_PCM_TYPE_HW)
+		return 0;
+	if (!group->anchor)
+		group->anchor = pcm;
+	else if (snd_pcm_link(group->anchor, pcm) >= 0)
+		m->linked = 1;
+	return 0;
+}
+
+/**
+ * \brief Remove a PCM from a start group
+ * \param group Group handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * A kernel link made by the group is removed.
+ */
+int snd_pcm_start_group_remove(snd_pcm_start_group_t *group, snd_pcm_t *pcm)
+{
+	struct start_member *m;
+	unsigned int i;
+	int linked = 0;
+
+	assert(group && pcm);
+	for (i = 0; i < group->count; i++)
+		if (group->members[i].pcm == pcm)
+			break;
+	if (i == group->count)
+		return -ENOENT;
+	m = &group->members[i];
+	if (pcm == group->anchor) {
+		/* the other linked members stay linked together */
+		for (i = 0; i < group->count; i++)
+			if (group->members[i].linked) {
+				linked = 1;
+				break;
+			}
+		group->anchor = NULL;
+		if (linked) {
+			group->members[i].linked = 0;
+			group->anchor = group->members[i].pcm;
+		}
+	}
+	if (m->linked || linked)
+		snd_pcm_unlink(pcm);
+	group->count--;
+	memmove(m, m + 1, (group->count - (m - group->members)) * sizeof(*m));
+	return 0;
+}
+
+/**
+ * \brief Prepare all the PCMs of a start group
+ * \param group Group handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_start_group_prepare(snd_pcm_start_group_t *group)
+{
+	unsigned int i;
+	int err;
+
+	assert(group);
+	for (i = 0; i < group->count; i++) {
+		err = snd_pcm_prepare(group->members[i].pcm);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/**
+ * \brief Start all the PCMs of a start group
+ * \param group Group handle
+ * \param skew Returned time between the first and the last start, or NULL
+ * \return 0 on success otherwise a negative error code
+ *
+ * All the members must be prepared, otherwise -EBADFD is returned and
+ * none is started.  When a start fails, the members already started are
+ * stopped with snd_pcm_drop().  The members linked in the kernel start
+ * with the first hw member and add no skew.
+ */
+int snd_pcm_start_group_start(snd_pcm_start_group_t *group, snd_htimestamp_t *skew)
+{
+	struct timespec first = { 0, 0 }, last = { 0, 0 };
+	unsigned int i, j;
+	long long ns;
+	int err;
+
+	assert(group);
+	for (i = 0; i < group->count; i++)
+		if (snd_pcm_state(group->members[i].pcm) != SND_PCM_STATE_PREPARED)
+			return -EBADFD;
+
+	/* nothing but the triggers in this loop */
+	for (i = 0; i < group->count; i++) {
+		if (group->members[i].linked)
+			continue;
+		err = snd_pcm_start(group->members[i].pcm);
+		if (err < 0)
+			goto error;
+		clock_gettime(CLOCK_MONOTONIC, &last);
+		if (i == 0)
+			first = last;
+	}
+
+	if (skew) {
+		ns = ts_diff_ns(&last, &first);
+		skew->tv_sec = ns / 1000000000;
+		skew->tv_nsec = ns % 1000000000;
+	}
+	return 0;
+
+ error:
+	for (j = 0; j < i; j++)
+		if (!group->members[j].linked)
+			snd_pcm_drop(group->members[j].pcm);
+	return err;
+}
+
+/**
+ * \brief Stop all the PCMs of a start group
+ * \param group Group handle
+ * \return 0 on success otherwise the first negative error code
+ *
+ * The members are stopped with snd_pcm_drop(), in a loop as tight as the
+ * start.  All of them are stopped even when one fails.
+ */
+int snd_pcm_start_group_drop(snd_pcm_start_group_t *group)
+{
+	unsigned int i;
+	int err, res = 0;
+
+	assert(group);
+	for (i = 0; i < group->count; i++) {
+		if (group->members[i].linked)
+			continue;
+		err = snd_pcm_drop(group->members[i].pcm);
+		if (err < 0 && res == 0)
+			res = err;
+	}
+	return res;
+}
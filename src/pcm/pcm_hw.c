@@ -97,6 +97,10 @@ typedef struct {
 	bool mmap_status_fallbacked;
 	bool mmap_control_fallbacked;
 	struct snd_pcm_sync_ptr *sync_ptr;
+	/* share a SYNC_PTR status snapshot until the next wakeup */
+	bool sync_ptr_snapshot;
+	bool sync_ptr_valid;
+	unsigned int sync_ptr_seq;
 
 	bool prepare_reset_sw_params;
 	bool perfect_drain;
@@ -122,12 +126,99 @@ typedef struct {
 #define SNDRV_FILE_PCM_STREAM_CAPTURE		ALSA_DEVICE_DIRECTORY "pcmC%iD%ic"
 #define SNDRV_PCM_VERSION_MAX			SNDRV_PROTOCOL_VERSION(2, 0, 9)
 
+/*
+ * The results of the probes at open, kept for the life of the process:
+ * the protocol version is the one of the kernel, the failed mmaps of the
+ * status and control records depend on the kernel and the card.  Tools
+ * opening every device repeatedly skip these ioctls and mmaps.
+ */
+#define HW_CAPS_CARDS			32
+#define HW_CAPS_STATUS_FALLBACK		(1 << 0)
+#define HW_CAPS_CONTROL_FALLBACK	(1 << 1)
+static int hw_caps_pversion;
+static unsigned char hw_caps_fallback[HW_CAPS_CARDS];
+
 /* update appl_ptr with driver */
 #define FAST_PCM_STATE(hw) \
 	((snd_pcm_state_t) (hw)->mmap_status->state)
 #define FAST_PCM_TSTAMP(hw) \
 	((hw)->mmap_status->tstamp)
 
+/* the descriptor for the transfers queued by pcm_submit.c, if the kernel
+ * read/write on it keeps the library view in sync */
+int snd_pcm_hw_transfer_fd(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw;
+
+	if (pcm->type != SND_PCM_TYPE_HW || !pcm->setup ||
+	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED)
+		return -EINVAL;
+	hw = pcm->private_data;
+	if (hw->mmap_control_fallbacked)
+		return -EINVAL;
+	return hw->fd;
+}
+
+/*
+ * syscall free status snapshot, see snd_pcm_status_fast()
+ *
+ * The kernel updates the status record under its stream lock, which is
+ * not visible here; a snapshot is accepted when the hw_ptr and the
+ * timestamp did not change while the other fields were copied.
+ */
+int snd_pcm_hw_status_fast(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	volatile struct snd_pcm_mmap_status *s = hw->mmap_status;
+	snd_pcm_uframes_t hw_ptr, appl_ptr;
+	snd_pcm_sframes_t avail;
+	unsigned int retry;
+
+	if (hw->mmap_status_fallbacked)
+		return -ENOSYS;
+	memset(status, 0, sizeof(*status));
+	for (retry = 0; ; retry++) {
+		hw_ptr = s->hw_ptr;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		status->tstamp.tv_sec = s->tstamp.tv_sec;
+		status->tstamp.tv_nsec = s->tstamp.tv_nsec;
+		status->audio_tstamp.tv_sec = s->audio_tstamp.tv_sec;
+		status->audio_tstamp.tv_nsec = s->audio_tstamp.tv_nsec;
+		status->state = s->state;
+		status->suspended_state = s->suspended_state;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (s->hw_ptr == hw_ptr &&
+		    s->tstamp.tv_sec == status->tstamp.tv_sec &&
+		    s->tstamp.tv_nsec == status->tstamp.tv_nsec)
+			break;
+		if (retry >= 64)
+			return -EAGAIN;
+	}
+	appl_ptr = hw->mmap_control->appl_ptr;
+
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		avail = hw_ptr + pcm->buffer_size - appl_ptr;
+	else
+		avail = hw_ptr - appl_ptr;
+	if (avail < 0)
+		avail += pcm->boundary;
+	else if ((snd_pcm_uframes_t)avail >= pcm->boundary)
+		avail -= pcm->boundary;
+	status->hw_ptr = hw_ptr;
+	status->appl_ptr = appl_ptr;
+	status->avail = avail;
+	status->avail_max = avail;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		status->delay = pcm->buffer_size - avail;
+	else
+		status->delay = avail;
+	if (SNDRV_PROTOCOL_VERSION(2, 0, 5) > hw->version) {
+		status->tstamp.tv_nsec *= 1000L;
+		status->audio_tstamp.tv_nsec *= 1000L;
+	}
+	return 0;
+}
+
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm)
 {
 	struct timespec res;
@@ -141,16 +232,39 @@ struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm)
 
 static int sync_ptr1(snd_pcm_hw_t *hw, unsigned int flags)
 {
+	unsigned int seq = snd_pcm_wakeup_seq();
 	int err;
 	hw->sync_ptr->flags = flags;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_SYNC_PTR, hw->sync_ptr) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_SYNC_PTR failed (%i)", err);
+		hw->sync_ptr_valid = false;
 		return err;
 	}
+	/* every SYNC_PTR returns the current status */
+	hw->sync_ptr_seq = seq;
+	hw->sync_ptr_valid = true;
 	return 0;
 }
 
+/*
+ * The status snapshot is refreshed at most once per wakeup.  The sequence
+ * is global, so that a wakeup or a trigger on one PCM refreshes also the
+ * PCMs linked to it.
+ */
+static bool sync_ptr_snapshot_valid(snd_pcm_hw_t *hw)
+{
+	return hw->sync_ptr_snapshot && hw->sync_ptr_valid &&
+		hw->sync_ptr_seq == snd_pcm_wakeup_seq();
+}
+
+/* the stream state changed, forget the snapshots */
+static void sync_ptr_snapshot_expire(snd_pcm_hw_t *hw)
+{
+	if (hw->sync_ptr_snapshot)
+		snd_pcm_wakeup_new_seq();
+}
+
 static int issue_avail_min(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_control_fallbacked)
@@ -202,6 +316,8 @@ static int query_status_data(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_status_fallbacked)
 		return 0;
+	if (sync_ptr_snapshot_valid(hw))
+		return 0;
 
 	/*
 	 * Query both of control/status data to avoid unexpected change of
@@ -214,14 +330,13 @@ static int query_status_data(snd_pcm_hw_t *hw)
 
 static int snd_pcm_hw_clear_timer_queue(snd_pcm_hw_t *hw)
 {
+	snd_timer_tread_t rbuf[16];
+
 	if (hw->period_timer_need_poll) {
-		while (poll(&hw->period_timer_pfd, 1, 0) > 0) {
-			snd_timer_tread_t rbuf[4];
-			snd_timer_read(hw->period_timer, rbuf, sizeof(rbuf));
-		}
+		while (poll(&hw->period_timer_pfd, 1, 0) > 0)
+			snd_timer_read_events(hw->period_timer, rbuf, ARRAY_SIZE(rbuf));
 	} else {
-		snd_timer_tread_t rbuf[4];
-		snd_timer_read(hw->period_timer, rbuf, sizeof(rbuf));
+		snd_timer_read_events(hw->period_timer, rbuf, ARRAY_SIZE(rbuf));
 	}
 	return 0;
 }
@@ -526,7 +641,9 @@ static int snd_pcm_hw_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err = 0;
 	int old_period_event = sw_get_period_event(params);
+	int timer_wakeup = sw_get_timer_wakeup(params);
 	sw_set_period_event(params, 0);
+	sw_set_timer_wakeup(params, 0);
 	if ((snd_pcm_tstamp_t) params->tstamp_mode == pcm->tstamp_mode &&
 	    (snd_pcm_tstamp_type_t) params->tstamp_type == pcm->tstamp_type &&
 	    params->period_step == pcm->period_step &&
@@ -578,6 +695,7 @@ static int snd_pcm_hw_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	}
  out:
 	sw_set_period_event(params, old_period_event);
+	sw_set_timer_wakeup(params, timer_wakeup);
 	return err;
 }
 
@@ -631,6 +749,7 @@ static snd_pcm_state_t snd_pcm_hw_state(snd_pcm_t *pcm)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	/* the -ENODEV may come from the snd_disconnect_ioctl() or
 	   snd_power_wait() in kernel */
+	hw->sync_ptr_valid = false;
 	if (query_status_data(hw) == -ENODEV)
 		return SND_PCM_STATE_DISCONNECTED;
 	return (snd_pcm_state_t) hw->mmap_status->state;
@@ -700,6 +819,7 @@ static int snd_pcm_hw_prepare(snd_pcm_t *pcm)
 		SYSMSG("SNDRV_PCM_IOCTL_PREPARE failed (%i)", err);
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	return query_status_and_control_data(hw);
 }
 
@@ -712,6 +832,7 @@ static int snd_pcm_hw_reset(snd_pcm_t *pcm)
 		SYSMSG("SNDRV_PCM_IOCTL_RESET failed (%i)", err);
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	return query_status_and_control_data(hw);
 }
 
@@ -733,6 +854,7 @@ static int snd_pcm_hw_start(snd_pcm_t *pcm)
 #endif
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	return 0;
 }
 
@@ -744,8 +866,8 @@ static int snd_pcm_hw_drop(snd_pcm_t *pcm)
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DROP failed (%i)", err);
 		return err;
-	} else {
 	}
+	sync_ptr_snapshot_expire(hw);
 	return 0;
 }
 
@@ -803,6 +925,7 @@ __skip_silence:
 		SYSMSG("SNDRV_PCM_IOCTL_DRAIN failed (%i)", err);
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	return 0;
 }
 
@@ -815,6 +938,7 @@ static int snd_pcm_hw_pause(snd_pcm_t *pcm, int enable)
 		SYSMSG("SNDRV_PCM_IOCTL_PAUSE failed (%i)", err);
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	return 0;
 }
 
@@ -832,6 +956,7 @@ static snd_pcm_sframes_t snd_pcm_hw_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t fra
 		SYSMSG("SNDRV_PCM_IOCTL_REWIND failed (%i)", err);
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	err = query_status_and_control_data(hw);
 	if (err < 0)
 		return err;
@@ -853,6 +978,7 @@ static snd_pcm_sframes_t snd_pcm_hw_forward(snd_pcm_t *pcm, snd_pcm_uframes_t fr
 			SYSMSG("SNDRV_PCM_IOCTL_FORWARD failed (%i)", err);
 			return err;
 		}
+		sync_ptr_snapshot_expire(hw);
 		err = query_status_and_control_data(hw);
 		if (err < 0)
 			return err;
@@ -890,6 +1016,7 @@ static int snd_pcm_hw_resume(snd_pcm_t *pcm)
 		SYSMSG("SNDRV_PCM_IOCTL_RESUME failed (%i)", err);
 		return err;
 	}
+	sync_ptr_snapshot_expire(hw);
 	return 0;
 }
 
@@ -1073,6 +1200,7 @@ static int map_status_and_control_data(snd_pcm_t *pcm, bool force_fallback)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	struct snd_pcm_sync_ptr *sync_ptr;
+	unsigned char fallback = 0, *cache = NULL;
 	int err;
 
 	/* Preparation for fallback to failure of mmap(2). */
@@ -1081,10 +1209,23 @@ static int map_status_and_control_data(snd_pcm_t *pcm, bool force_fallback)
 		return -ENOMEM;
 	memset(sync_ptr, 0, sizeof(*sync_ptr));
 
+	if (hw->card >= 0 && hw->card < HW_CAPS_CARDS) {
+		cache = &hw_caps_fallback[hw->card];
+		fallback = __atomic_load_n(cache, __ATOMIC_RELAXED);
+	}
 	hw->mmap_status_fallbacked =
-			map_status_data(hw, sync_ptr, force_fallback);
+			map_status_data(hw, sync_ptr, force_fallback ||
+					(fallback & HW_CAPS_STATUS_FALLBACK));
 	hw->mmap_control_fallbacked =
-			map_control_data(hw, sync_ptr, force_fallback);
+			map_control_data(hw, sync_ptr, force_fallback ||
+					 (fallback & HW_CAPS_CONTROL_FALLBACK));
+	if (cache && !force_fallback) {
+		if (hw->mmap_status_fallbacked)
+			fallback |= HW_CAPS_STATUS_FALLBACK;
+		if (hw->mmap_control_fallbacked)
+			fallback |= HW_CAPS_CONTROL_FALLBACK;
+		__atomic_store_n(cache, fallback, __ATOMIC_RELAXED);
+	}
 
 	/* Any fallback mode needs to keep the buffer. */
 	if (hw->mmap_status_fallbacked || hw->mmap_control_fallbacked) {
@@ -1209,6 +1350,7 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 			if (SNDRV_PROTOCOL_VERSION(2, 0, 1) <= hw->version) {
 				if (ioctl(hw->fd, SNDRV_PCM_IOCTL_XRUN) < 0)
 					return -errno;
+				sync_ptr_snapshot_expire(hw);
 			}
 			/* everything is ok, state == SND_PCM_STATE_XRUN at the moment */
 			return -EPIPE;
@@ -1266,42 +1408,18 @@ static int is_chmap_type(int type)
 		type <= SND_CTL_TLVT_CHMAP_PAIRED);
 }
 
-/**
- * \!brief Query the available channel maps
- * \param card the card number
- * \param dev the PCM device number
- * \param subdev the PCM substream index
- * \param stream the direction of PCM stream
- * \return the NULL-terminated array of integer pointers, or NULL at error.
- *
- * This function works like snd_pcm_query_chmaps() but it takes the card,
- * device, substream and stream numbers instead of the already opened
- * snd_pcm_t instance, so that you can query available channel maps of
- * a PCM before actually opening it.
- *
- * As the parameters stand, the query is performed only to the hw PCM
- * devices, not the abstracted PCM object in alsa-lib.
- */
-snd_pcm_chmap_query_t **
-snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
-			     snd_pcm_stream_t stream)
+/* read and parse the channel map TLV of a PCM */
+static snd_pcm_chmap_query_t **chmaps_read(snd_ctl_t *ctl, int dev, int subdev,
+					   snd_pcm_stream_t stream)
 {
-	snd_ctl_t *ctl;
 	snd_ctl_elem_id_t id = {0};
 	unsigned int tlv[2048], *start;
 	unsigned int type;
 	snd_pcm_chmap_query_t **map;
 	int i, ret, nums;
 
-	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
-	if (ret < 0) {
-		SYSMSG("Cannot open the associated CTL");
-		return NULL;
-	}
-
 	__fill_chmap_ctl_id(&id, dev, subdev, stream);
 	ret = snd_ctl_elem_tlv_read(ctl, &id, tlv, sizeof(tlv));
-	snd_ctl_close(ctl);
 	if (ret < 0) {
 		SYSMSG("Cannot read Channel Map TLV");
 		return NULL;
@@ -1355,6 +1473,191 @@ snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
 	return map;
 }
 
+/*
+ * The route plugin queries the channel maps of its slave at each open,
+ * which costs an open of the control device and a TLV read.  The answers
+ * are cached per card, device, substream and stream.  The cache of a card
+ * keeps a control handle subscribed to its events: a changed TLV or an
+ * added or removed element drops the answers of the card, which are
+ * checked with a non-blocking read at each query.  A failed query is
+ * cached too, a driver without the channel map controls is asked once.
+ */
+struct chmap_cache_entry {
+	struct list_head list;
+	int dev;
+	int subdev;
+	snd_pcm_stream_t stream;
+	snd_pcm_chmap_query_t **maps;	/* NULL when the query failed */
+};
+
+struct chmap_cache_card {
+	snd_ctl_t *ctl;			/* NULL when nothing is cached */
+	struct list_head entries;
+};
+
+static struct chmap_cache_card chmap_cache[HW_CAPS_CARDS];
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t chmap_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void chmap_cache_lock(void)
+{
+	pthread_mutex_lock(&chmap_cache_mutex);
+}
+
+static inline void chmap_cache_unlock(void)
+{
+	pthread_mutex_unlock(&chmap_cache_mutex);
+}
+#else
+static inline void chmap_cache_lock(void) {}
+static inline void chmap_cache_unlock(void) {}
+#endif
+
+static void chmap_cache_drop(struct chmap_cache_card *c)
+{
+	struct chmap_cache_entry *e;
+
+	while (!list_empty(&c->entries)) {
+		e = list_entry(c->entries.next, struct chmap_cache_entry, list);
+		list_del(&e->list);
+		snd_pcm_free_chmaps(e->maps);
+		free(e);
+	}
+}
+
+/* read the pending events, the answers are dropped at a TLV change */
+static int chmap_cache_check(struct chmap_cache_card *c)
+{
+	snd_ctl_event_t ev[16], *evp[16];
+	unsigned int mask;
+	int i, n, stale = 0;
+
+	for (i = 0; i < 16; i++)
+		evp[i] = &ev[i];
+	while ((n = snd_ctl_read_events(c->ctl, evp, 16)) > 0) {
+		for (i = 0; i < n; i++) {
+			if (ev[i].type != SND_CTL_EVENT_ELEM)
+				continue;
+			mask = ev[i].data.elem.mask;
+			if (mask == SND_CTL_EVENT_MASK_REMOVE ||
+			    (mask & (SND_CTL_EVENT_MASK_ADD |
+				     SND_CTL_EVENT_MASK_TLV)))
+				stale = 1;
+		}
+	}
+	if (n < 0 && n != -EAGAIN) {
+		/* e.g. the card was disconnected */
+		chmap_cache_drop(c);
+		snd_ctl_close(c->ctl);
+		c->ctl = NULL;
+		return n;
+	}
+	if (stale)
+		chmap_cache_drop(c);
+	return 0;
+}
+
+/*
+ * return a copy of the cached answer in *mapsp, a negative error when
+ * the cache cannot be used and the caller must query the card itself
+ */
+static int chmap_cache_query(int card, int dev, int subdev,
+			     snd_pcm_stream_t stream,
+			     snd_pcm_chmap_query_t ***mapsp)
+{
+	struct chmap_cache_card *c;
+	struct chmap_cache_entry *e;
+	struct list_head *pos;
+	int err;
+
+	if (card < 0 || card >= HW_CAPS_CARDS)
+		return -EINVAL;
+	c = &chmap_cache[card];
+	chmap_cache_lock();
+	if (!c->ctl) {
+		err = snd_ctl_hw_open(&c->ctl, NULL, card, SND_CTL_NONBLOCK);
+		if (err < 0) {
+			c->ctl = NULL;
+			goto unlock;
+		}
+		/* subscribe before the reads, no change can be missed */
+		err = snd_ctl_subscribe_events(c->ctl, 1);
+		if (err < 0) {
+			snd_ctl_close(c->ctl);
+			c->ctl = NULL;
+			goto unlock;
+		}
+		INIT_LIST_HEAD(&c->entries);
+	} else {
+		err = chmap_cache_check(c);
+		if (err < 0)
+			goto unlock;
+	}
+
+	list_for_each(pos, &c->entries) {
+		e = list_entry(pos, struct chmap_cache_entry, list);
+		if (e->dev == dev && e->subdev == subdev && e->stream == stream)
+			goto found;
+	}
+	e = calloc(1, sizeof(*e));
+	if (!e) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+	e->dev = dev;
+	e->subdev = subdev;
+	e->stream = stream;
+	e->maps = chmaps_read(c->ctl, dev, subdev, stream);
+	list_add(&e->list, &c->entries);
+ found:
+	*mapsp = e->maps ? _snd_pcm_copy_chmap_query(e->maps) : NULL;
+	err = 0;
+ unlock:
+	chmap_cache_unlock();
+	return err;
+}
+
+/**
+ * \!brief Query the available channel maps
+ * \param card the card number
+ * \param dev the PCM device number
+ * \param subdev the PCM substream index
+ * \param stream the direction of PCM stream
+ * \return the NULL-terminated array of integer pointers, or NULL at error.
+ *
+ * This function works like snd_pcm_query_chmaps() but it takes the card,
+ * device, substream and stream numbers instead of the already opened
+ * snd_pcm_t instance, so that you can query available channel maps of
+ * a PCM before actually opening it.
+ *
+ * As the parameters stand, the query is performed only to the hw PCM
+ * devices, not the abstracted PCM object in alsa-lib.
+ *
+ * The answers are cached per process, a control handle of the card is
+ * kept open to drop them when the channel map controls change.
+ */
+snd_pcm_chmap_query_t **
+snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
+			     snd_pcm_stream_t stream)
+{
+	snd_ctl_t *ctl;
+	snd_pcm_chmap_query_t **map;
+	int ret;
+
+	if (chmap_cache_query(card, dev, subdev, stream, &map) >= 0)
+		return map;
+
+	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
+	if (ret < 0) {
+		SYSMSG("Cannot open the associated CTL");
+		return NULL;
+	}
+	map = chmaps_read(ctl, dev, subdev, stream);
+	snd_ctl_close(ctl);
+	return map;
+}
+
 enum { CHMAP_CTL_QUERY, CHMAP_CTL_GET, CHMAP_CTL_SET };
 
 static int chmap_caps(snd_pcm_hw_t *hw, int type)
@@ -1600,19 +1903,9 @@ static const snd_pcm_fast_ops_t snd_pcm_hw_fast_ops_timer = {
 	.poll_revents = snd_pcm_hw_poll_revents,
 };
 
-/**
- * \brief Creates a new hw PCM
- * \param pcmp Returns created PCM handle
- * \param name Name of PCM
- * \param fd File descriptor
- * \param sync_ptr_ioctl Boolean flag for sync_ptr ioctl
- * \retval zero on success otherwise a negative error code
- * \warning Using of this function might be dangerous in the sense
- *          of compatibility reasons. The prototype might be freely
- *          changed in future.
- */
-int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
-		       int sync_ptr_ioctl)
+/* info is NULL when not queried by the caller yet */
+static int hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
+		      int sync_ptr_ioctl, const snd_pcm_info_t *infop)
 {
 	int ver, mode;
 	snd_pcm_tstamp_type_t tstamp_type = SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY;
@@ -1624,13 +1917,16 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 
 	assert(pcmp);
 
-	memset(&info, 0, sizeof(info));
-	if (ioctl(fd, SNDRV_PCM_IOCTL_INFO, &info) < 0) {
-		ret = -errno;
-		SYSMSG("SNDRV_PCM_IOCTL_INFO failed (%i)", ret);
-		close(fd);
-		return ret;
-
+	if (infop) {
+		info = *infop;
+	} else {
+		memset(&info, 0, sizeof(info));
+		if (ioctl(fd, SNDRV_PCM_IOCTL_INFO, &info) < 0) {
+			ret = -errno;
+			SYSMSG("SNDRV_PCM_IOCTL_INFO failed (%i)", ret);
+			close(fd);
+			return ret;
+		}
 	}
 
 	if ((fmode = fcntl(fd, F_GETFL)) < 0) {
@@ -1646,11 +1942,15 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 	if (fmode & O_APPEND)
 		mode |= SND_PCM_APPEND;
 
-	if (ioctl(fd, SNDRV_PCM_IOCTL_PVERSION, &ver) < 0) {
-		ret = -errno;
-		SYSMSG("SNDRV_PCM_IOCTL_PVERSION failed (%i)", ret);
-		close(fd);
-		return ret;
+	ver = __atomic_load_n(&hw_caps_pversion, __ATOMIC_RELAXED);
+	if (!ver) {
+		if (ioctl(fd, SNDRV_PCM_IOCTL_PVERSION, &ver) < 0) {
+			ret = -errno;
+			SYSMSG("SNDRV_PCM_IOCTL_PVERSION failed (%i)", ret);
+			close(fd);
+			return ret;
+		}
+		__atomic_store_n(&hw_caps_pversion, ver, __ATOMIC_RELAXED);
 	}
 	if (SNDRV_PROTOCOL_INCOMPATIBLE(ver, SNDRV_PCM_VERSION_MAX))
 		return -SND_ERROR_INCOMPATIBLE_VERSION;
@@ -1732,6 +2032,23 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 	return 0;
 }
 
+/**
+ * \brief Creates a new hw PCM
+ * \param pcmp Returns created PCM handle
+ * \param name Name of PCM
+ * \param fd File descriptor
+ * \param sync_ptr_ioctl Boolean flag for sync_ptr ioctl
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
+		       int sync_ptr_ioctl)
+{
+	return hw_open_fd(pcmp, name, fd, sync_ptr_ioctl, NULL);
+}
+
 /**
  * \brief Creates a new hw PCM
  * \param pcmp Returns created PCM handle
@@ -1760,13 +2077,10 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	int attempt = 0;
 	snd_pcm_info_t info;
 	int fmode;
-	snd_ctl_t *ctl;
+	snd_ctl_t *ctl = NULL;
 
 	assert(pcmp);
 
-	if ((ret = snd_ctl_hw_open(&ctl, NULL, card, 0)) < 0)
-		return ret;
-
 	switch (stream) {
 	case SND_PCM_STREAM_PLAYBACK:
 		filefmt = SNDRV_FILE_PCM_STREAM_PLAYBACK;
@@ -1780,14 +2094,26 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	}
 	sprintf(filename, filefmt, card, device);
 
+	/*
+	 * Only a given subdevice needs the preference set through the
+	 * control device, the kernel takes the first free one otherwise.
+	 */
+	if (subdevice >= 0) {
+		ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
+		if (ret < 0)
+			return ret;
+	}
+
       __again:
       	if (attempt++ > 3) {
 		ret = -EBUSY;
 		goto _err;
 	}
-	ret = snd_ctl_pcm_prefer_subdevice(ctl, subdevice);
-	if (ret < 0)
-		goto _err;
+	if (ctl) {
+		ret = snd_ctl_pcm_prefer_subdevice(ctl, subdevice);
+		if (ret < 0)
+			goto _err;
+	}
 	fmode = O_RDWR;
 	if (mode & SND_PCM_NONBLOCK)
 		fmode |= O_NONBLOCK;
@@ -1801,25 +2127,25 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		SYSMSG("open '%s' failed (%i)", filename, ret);
 		goto _err;
 	}
-	if (subdevice >= 0) {
-		memset(&info, 0, sizeof(info));
-		if (ioctl(fd, SNDRV_PCM_IOCTL_INFO, &info) < 0) {
-			ret = -errno;
-			SYSMSG("SNDRV_PCM_IOCTL_INFO failed (%i)", ret);
-			goto _err;
-		}
-		if (info.subdevice != (unsigned int) subdevice) {
-			close(fd);
-			fd = -1;
-			goto __again;
-		}
+	memset(&info, 0, sizeof(info));
+	if (ioctl(fd, SNDRV_PCM_IOCTL_INFO, &info) < 0) {
+		ret = -errno;
+		SYSMSG("SNDRV_PCM_IOCTL_INFO failed (%i)", ret);
+		goto _err;
 	}
-	snd_ctl_close(ctl);
-	return snd_pcm_hw_open_fd(pcmp, name, fd, sync_ptr_ioctl);
+	if (subdevice >= 0 && info.subdevice != (unsigned int) subdevice) {
+		close(fd);
+		fd = -1;
+		goto __again;
+	}
+	if (ctl)
+		snd_ctl_close(ctl);
+	return hw_open_fd(pcmp, name, fd, sync_ptr_ioctl, &info);
        _err:
 	if (fd >= 0)
 		close(fd);
-	snd_ctl_close(ctl);
+	if (ctl)
+		snd_ctl_close(ctl);
 	return ret;
 }
 
@@ -1837,6 +2163,28 @@ changed by this option.  This influences only on the blocking behavior at
 opening the device.  If you would like to keep the compatibility with the
 older ALSA stuff, turn this option off.
 
+When the kernel cannot map the status record (many ARM kernels, or with the
+sync_ptr_ioctl option), each avail or htimestamp query costs one
+SYNC_PTR ioctl.  The sync_ptr_snapshot option lets the queries share the
+status returned by the last SYNC_PTR until the next return from poll (via
+snd_pcm_wait() or snd_pcm_poll_descriptors_revents()) or the next trigger
+on any PCM, including the linked ones.  The avail value is then as fresh as
+the last wakeup, so the applications busy-polling the avail without waiting
+should not enable it.  The rate-preserving plugins on top of such a device
+(linear, route, softvol...) then keep their avail until the next wakeup as
+well, and account their own transfers arithmetically instead of querying
+the whole chain down to the device again.
+
+The protocol version of the kernel and the failures to map the status and
+control records of a card are probed at the first open and remembered for
+the life of the process, so that the tools opening many devices repeatedly
+save these system calls.  The control device is opened only to select a
+given subdevice.
+
+The channel maps of a device are read once and cached for the next opens.
+A control handle of the card stays open to follow the changes of the
+channel map controls.
+
 \code
 pcm.name {
 	type hw			# Kernel PCM
@@ -1844,6 +2192,7 @@ pcm.name {
 	[device INT]		# Device number (default 0)
 	[subdevice INT]		# Subdevice number (default -1: first available)
 	[sync_ptr_ioctl BOOL]	# Use SYNC_PTR ioctl rather than the direct mmap access for control structures
+	[sync_ptr_snapshot BOOL] # Share one SYNC_PTR status query until the next wakeup
 	[nonblock BOOL]		# Force non-blocking open mode
 	[format STR]		# Restrict only to the given format
 	[channels INT]		# Restrict only to the given channels
@@ -1882,7 +2231,7 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	long card = -1, device = 0, subdevice = -1;
 	const char *str;
-	int err, sync_ptr_ioctl = 0;
+	int err, sync_ptr_ioctl = 0, sync_ptr_snapshot = 0;
 	int min_rate = 0, max_rate = 0, channels = 0, drain_silence = -1;
 	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 	snd_config_t *n;
@@ -1933,6 +2282,13 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 			sync_ptr_ioctl = err;
 			continue;
 		}
+		if (strcmp(id, "sync_ptr_snapshot") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				continue;
+			sync_ptr_snapshot = err;
+			continue;
+		}
 		if (strcmp(id, "nonblock") == 0) {
 			err = snd_config_get_bool(n);
 			if (err < 0)
@@ -2077,6 +2433,8 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	if (chmap)
 		hw->chmap_override = chmap;
 	hw->drain_silence = drain_silence;
+	hw->sync_ptr_snapshot = sync_ptr_snapshot;
+	(*pcmp)->pos_snapshot = sync_ptr_snapshot;
 
 	return 0;
 
@@ -63,6 +63,8 @@ struct snd_pcm_iec958 {
 	unsigned char preamble[3];	/* B/M/W or Z/X/Y */
 	snd_pcm_fast_ops_t fops;
 	int hdmi_mode;
+	/* status bit and preamble of the subframes by the frame counter */
+	uint32_t frame_bits[2][192];	/* first and other channels */
 };
 
 enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
@@ -74,19 +76,13 @@ enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
  * to be sure that bit 4 upt 31 will carry
  * an even number of ones and zeros.
  */
-static unsigned int iec958_parity(unsigned int data)
+static inline unsigned int iec958_parity(unsigned int data)
 {
-	unsigned int parity;
-	int bit;
-
-	data >>= 4;     /* start from bit 4 */
-	parity = 0;
-	for (bit = 4; bit <= 30; bit++) {
-		if (data & 1)
-			parity++;
-		data >>= 1;
-	}
-	return (parity & 1);
+	data &= 0x7ffffff0;	/* bit 4-30 */
+	data ^= data >> 16;
+	data ^= data >> 8;
+	data ^= data >> 4;
+	return (0x6996 >> (data & 0xf)) & 1;
 }
 
 /*
@@ -102,39 +98,45 @@ static unsigned int iec958_parity(unsigned int data)
  *     31   = parity
  */
 
-static inline uint32_t iec958_subframe(snd_pcm_iec958_t *iec, uint32_t data, int channel)
+/*
+ * The channel status bit and the preamble depend only on the frame
+ * counter and on the channel being the first one, so they are made once
+ * per setup (the status bytes are completed in hw_params).
+ */
+static void iec958_frame_bits_update(snd_pcm_iec958_t *iec)
 {
-	unsigned int byte = iec->counter >> 3;
-	unsigned int mask = 1 << (iec->counter - (byte << 3));
+	unsigned int counter;
+	uint32_t status;
+
+	for (counter = 0; counter < 192; counter++) {
+		status = 0;
+		if (iec->status[counter >> 3] & (1 << (counter & 7)))
+			status = 0x40000000;
+		if (counter)
+			iec->frame_bits[0][counter] = status | iec->preamble[PREAMBLE_X];
+		else
+			iec->frame_bits[0][counter] = status | iec->preamble[PREAMBLE_Z];
+		iec->frame_bits[1][counter] = status | iec->preamble[PREAMBLE_Y];
+	}
+}
 
+static inline uint32_t iec958_subframe(const uint32_t *frame_bits,
+				       unsigned int counter, uint32_t data)
+{
 	/* bit 4-27 */
 	data >>= 4;
 	data &= ~0xf;
 
-	/* set IEC status bits (up to 192 bits) */
-	if (iec->status[byte] & mask)
-		data |= 0x40000000;
-
+	/* the preamble is out of the parity slots */
+	data |= frame_bits[counter];
 	if (iec958_parity(data))	/* parity bit 4-30 */
 		data |= 0x80000000;
-
-	/* Preamble */
-	if (channel)
-		data |= iec->preamble[PREAMBLE_Y];	/* odd sub frame, 'Y' */
-	else if (! iec->counter)
-		data |= iec->preamble[PREAMBLE_Z];	/* Block start, 'Z' */
-	else
-		data |= iec->preamble[PREAMBLE_X];	/* even sub frame, 'X' */
-
-	if (iec->byteswap)
-		data = bswap_32(data);
-
 	return data;
 }
 
-static inline int32_t iec958_to_s32(snd_pcm_iec958_t *iec, uint32_t data)
+static inline int32_t iec958_to_s32(unsigned int byteswap, uint32_t data)
 {
-	if (iec->byteswap)
+	if (byteswap)
 		data = bswap_32(data);
 	data &= ~0xf;
 	data <<= 4;
@@ -153,6 +155,7 @@ static void snd_pcm_iec958_decode(snd_pcm_iec958_t *iec,
 #include "plugin_ops.h"
 #undef PUT32_LABELS
 	void *put = put32_labels[iec->getput_idx];
+	unsigned int byteswap = iec->byteswap;
 	unsigned int channel;
 	for (channel = 0; channel < channels; ++channel) {
 		const uint32_t *src;
@@ -167,7 +170,7 @@ static void snd_pcm_iec958_decode(snd_pcm_iec958_t *iec,
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
 		while (frames1-- > 0) {
-			int32_t sample = iec958_to_s32(iec, *src);
+			int32_t sample = iec958_to_s32(byteswap, *src);
 			goto *put;
 #define PUT32_END after
 #include "plugin_ops.h"
@@ -192,7 +195,9 @@ static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 	void *get = get32_labels[iec->getput_idx];
 	unsigned int channel;
 	int32_t sample = 0;
-	int counter = iec->counter;
+	unsigned int counter = iec->counter, frame;
+	unsigned int byteswap = iec->byteswap;
+	const uint32_t *frame_bits;
 	int single_stream = iec->hdmi_mode &&
 			    (iec->status[0] & IEC958_AES0_NONAUDIO) &&
 			    (channels == 8);
@@ -210,28 +215,31 @@ static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 		dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(uint32_t);
 		frames1 = frames;
 
+		frame_bits = iec->frame_bits[channel ? 1 : 0];
 		if (single_stream)
-			iec->counter = (counter + (channel >> 1)) % 192;
+			frame = (counter + (channel >> 1)) % 192;
 		else
-			iec->counter = counter;
+			frame = counter;
 
 		while (frames1-- > 0) {
+			uint32_t data;
 			goto *get;
 #define GET32_END after
 #include "plugin_ops.h"
 #undef GET32_END
 		after:
-			sample = iec958_subframe(iec, sample, channel);
-			// fprintf(stderr, "%d:%08x\n", frames1, sample);
-			*dst = sample;
+			data = iec958_subframe(frame_bits, frame, sample);
+			if (byteswap)
+				data = bswap_32(data);
+			*dst = data;
 			src += src_step;
 			dst += dst_step;
-			iec->counter += counter_step;
-			iec->counter %= 192;
+			frame += counter_step;
+			if (frame >= 192)
+				frame -= 192;
 		}
-		if (single_stream) /* set counter to ch0 value for next iteration */
-			iec->counter = (counter + frames * counter_step) % 192;
 	}
+	iec->counter = (counter + frames * counter_step) % 192;
 }
 #endif /* DOC_HIDDEN */
 
@@ -438,6 +446,7 @@ static int snd_pcm_iec958_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params
 			iec->status[4] |= ws;
 		}
 	}
+	iec958_frame_bits_update(iec);
 	return 0;
 }
 
@@ -30,6 +30,7 @@
 #include "pcm_ioplug.h"
 #include "pcm_ext_parm.h"
 #include "pcm_generic.h"
+#include <sys/stat.h>
 
 #ifndef PIC
 /* entry for static linking */
@@ -43,6 +44,7 @@ typedef struct snd_pcm_ioplug_priv {
 	snd_pcm_ioplug_t *data;
 	struct snd_ext_parm params[SND_PCM_IOPLUG_HW_PARAMS];
 	snd_pcm_uframes_t last_hw;
+	snd_pcm_sframes_t published_hw;	/* atomic, see snd_pcm_ioplug_publish_pointer() */
 	snd_pcm_uframes_t avail_max;
 	snd_htimestamp_t trigger_tstamp;
 } ioplug_priv_t;
@@ -59,7 +61,11 @@ static void snd_pcm_ioplug_hw_ptr_update(snd_pcm_t *pcm)
 	ioplug_priv_t *io = pcm->private_data;
 	snd_pcm_sframes_t hw;
 
-	hw = io->data->callback->pointer(io->data);
+	if (io->data->version >= 0x010003 &&
+	    (io->data->flags & SND_PCM_IOPLUG_FLAG_PUBLISHED_POINTER))
+		hw = __atomic_load_n(&io->published_hw, __ATOMIC_ACQUIRE);
+	else
+		hw = io->data->callback->pointer(io->data);
 	if (hw >= 0) {
 		snd_pcm_uframes_t delta;
 		snd_pcm_uframes_t avail;
@@ -102,9 +108,28 @@ static int snd_pcm_ioplug_info(snd_pcm_t *pcm, snd_pcm_info_t *info)
 	return 0;
 }
 
+static int ioplug_shared_buffer(snd_pcm_ioplug_t *ioplug)
+{
+	return ioplug->version >= 0x010003 &&
+		(ioplug->flags & SND_PCM_IOPLUG_FLAG_SHARED_BUFFER);
+}
+
 static int snd_pcm_ioplug_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
 {
-	return snd_pcm_channel_info_shm(pcm, info, -1);
+	ioplug_priv_t *io = pcm->private_data;
+	int err;
+
+	err = snd_pcm_channel_info_shm(pcm, info, -1);
+	if (err < 0 || !ioplug_shared_buffer(io->data))
+		return err;
+	/* map the ring buffer of the plugin instead of an own buffer */
+	if (pcm->access == SND_PCM_ACCESS_MMAP_NONINTERLEAVED ||
+	    pcm->access == SND_PCM_ACCESS_RW_NONINTERLEAVED)
+		info->first = info->channel * pcm->buffer_size * pcm->sample_bits;
+	info->type = SND_PCM_AREA_MMAP;
+	info->u.mmap.fd = io->data->mmap_fd;
+	info->u.mmap.offset = io->data->mmap_offset;
+	return 0;
 }
 
 static int snd_pcm_ioplug_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
@@ -160,6 +185,7 @@ static int snd_pcm_ioplug_reset(snd_pcm_t *pcm)
 	io->data->appl_ptr = 0;
 	io->data->hw_ptr = 0;
 	io->last_hw = 0;
+	__atomic_store_n(&io->published_hw, 0, __ATOMIC_RELAXED);
 	io->avail_max = 0;
 	return 0;
 }
@@ -428,6 +454,37 @@ static int snd_pcm_ioplug_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	return change;
 }
 
+/* the shared ring must hold the whole buffer */
+static int snd_pcm_ioplug_check_shared_buffer(snd_pcm_ioplug_t *ioplug)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned int bits;
+	struct stat st;
+	off_t size;
+
+	if (page_size <= 0)
+		page_size = 4096;
+	if (ioplug->mmap_fd < 0 || ioplug->mmap_offset < 0 ||
+	    ioplug->mmap_offset % page_size) {
+		SNDERR("ioplug: invalid shared buffer fd %d offset %lld",
+		       ioplug->mmap_fd, (long long)ioplug->mmap_offset);
+		return -EINVAL;
+	}
+	if (fstat(ioplug->mmap_fd, &st) < 0) {
+		SYSERR("fstat failed");
+		return -errno;
+	}
+	bits = snd_pcm_format_physical_width(ioplug->format) * ioplug->channels;
+	size = (off_t)(ioplug->buffer_size * bits / 8);
+	if (S_ISREG(st.st_mode) && st.st_size < ioplug->mmap_offset + size) {
+		SNDERR("ioplug: shared buffer too small (%lld < %lld)",
+		       (long long)(st.st_size - ioplug->mmap_offset),
+		       (long long)size);
+		return -EINVAL;
+	}
+	return 0;
+}
+
 static int snd_pcm_ioplug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	ioplug_priv_t *io = pcm->private_data;
@@ -450,6 +507,8 @@ static int snd_pcm_ioplug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		INTERNAL(snd_pcm_hw_params_get_period_size)(params, &io->data->period_size, 0);
 		INTERNAL(snd_pcm_hw_params_get_buffer_size)(params, &io->data->buffer_size);
 	}
+	if (ioplug_shared_buffer(io->data))
+		return snd_pcm_ioplug_check_shared_buffer(io->data);
 	return 0;
 }
 
@@ -597,13 +656,48 @@ static int snd_pcm_ioplug_pause(snd_pcm_t *pcm, int enable)
 	return 0;
 }
 
+/*
+ * the playback frames passed to the transfer callback left the buffer,
+ * only the plugin can take them back
+ */
+static int ioplug_transfers_playback(ioplug_priv_t *io)
+{
+	return io->data->stream == SND_PCM_STREAM_PLAYBACK &&
+		io->data->callback->transfer && !ioplug_shared_buffer(io->data);
+}
+
+static int ioplug_can_rewind(ioplug_priv_t *io)
+{
+	return !ioplug_transfers_playback(io) ||
+		(io->data->version >= 0x010003 && io->data->callback->rewind);
+}
+
 static snd_pcm_sframes_t snd_pcm_ioplug_rewindable(snd_pcm_t *pcm)
 {
+	ioplug_priv_t *io = pcm->private_data;
+
+	if (!ioplug_can_rewind(io))
+		return 0;
 	return snd_pcm_mmap_hw_rewindable(pcm);
 }
 
 static snd_pcm_sframes_t snd_pcm_ioplug_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
+	ioplug_priv_t *io = pcm->private_data;
+	snd_pcm_sframes_t n;
+
+	n = snd_pcm_ioplug_rewindable(pcm);
+	if (n <= 0)
+		return n;
+	if (frames > (snd_pcm_uframes_t)n)
+		frames = n;
+	if (ioplug_transfers_playback(io)) {
+		n = io->data->callback->rewind(io->data, frames);
+		if (n < 0)
+			return n;
+		if ((snd_pcm_uframes_t)n < frames)
+			frames = n;
+	}
 	snd_pcm_mmap_appl_backward(pcm, frames);
 	return frames;
 }
@@ -613,10 +707,40 @@ static snd_pcm_sframes_t snd_pcm_ioplug_forwardable(snd_pcm_t *pcm)
 	return snd_pcm_mmap_avail(pcm);
 }
 
+static snd_pcm_sframes_t ioplug_priv_transfer_areas(snd_pcm_t *pcm,
+						    const snd_pcm_channel_area_t *areas,
+						    snd_pcm_uframes_t offset,
+						    snd_pcm_uframes_t size);
+
 static snd_pcm_sframes_t snd_pcm_ioplug_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
-	snd_pcm_mmap_appl_forward(pcm, frames);
-	return frames;
+	ioplug_priv_t *io = pcm->private_data;
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t ofs, cont, done = 0;
+	snd_pcm_sframes_t n;
+
+	n = snd_pcm_ioplug_forwardable(pcm);
+	if (n <= 0)
+		return n;
+	if (frames > (snd_pcm_uframes_t)n)
+		frames = n;
+	if (!ioplug_transfers_playback(io)) {
+		snd_pcm_mmap_appl_forward(pcm, frames);
+		return frames;
+	}
+	/* the plugin follows the stream, so pass it the skipped frames too */
+	while (done < frames) {
+		cont = frames - done;
+		__snd_pcm_mmap_begin_generic(pcm, &areas, &ofs, &cont);
+		n = ioplug_priv_transfer_areas(pcm, areas, ofs, cont);
+		if (n <= 0) {
+			if (done)
+				break;
+			return n;
+		}
+		done += n;
+	}
+	return done;
 }
 
 /* need own locking */
@@ -1002,6 +1126,17 @@ When poll_fd, poll_events and mmap_rw fields are changed after
 #snd_pcm_ioplug_create(), call #snd_pcm_ioplug_reinit_status() to
 reflect the changes.
 
+Since version 1.0.3, a plugin whose backend already owns a ring buffer
+(e.g. a memfd shared with a server process) can let alsa-lib use it as
+the PCM buffer by setting #SND_PCM_IOPLUG_FLAG_SHARED_BUFFER in the flags
+field.  The mmap_fd and mmap_offset fields must then describe a mapping
+large enough for buffer_size frames (interleaved or channel after channel,
+following the access type) when the hw_params callback returns.  The
+buffer is mapped shared, the read/write calls behave as in mmap_rw mode
+and #snd_pcm_ioplug_mmap_areas() returns the areas inside the ring, so
+the data written by the application lands in the backend without another
+copy.  The transfer callback may be omitted in this mode.
+
 The driver can set an arbitrary value (pointer) to private_data
 field to refer its own data in the callbacks.
 
@@ -1017,11 +1152,28 @@ the PCM stream is started and stopped, repsectively.  The pointer
 callback returns the current DMA position, which may be called at any
 time.
 
+A backend which advances the position in its own thread doesn't need to
+take a lock in the pointer callback: since version 1.0.3, it can set
+#SND_PCM_IOPLUG_FLAG_PUBLISHED_POINTER and report the position with
+#snd_pcm_ioplug_publish_pointer() instead.  The pointer callback is then
+never called and may be omitted.  The position starts again from zero
+after prepare and reset.
+
 The transfer callback is called when any data transfer happens.  It
 receives the area array, offset and the size to transfer.  The area
 array contains the array of snd_pcm_channel_area_t with the elements
 of number of channels.
 
+The playback frames passed to the transfer callback are no longer in
+the buffer, so they can be rewound only when the plugin takes them back:
+since version 1.0.3, the rewind callback drops up to the given number of
+the latest transferred frames not played yet and returns how many it
+dropped.  Without it, #snd_pcm_rewindable() returns zero for such a
+plugin.  A forward passes the skipped frames to the transfer callback as
+they are in the buffer.  The plugins reading the buffer at their own
+position (without the transfer callback, or with a shared buffer) and
+the capture streams are rewound in the buffer.
+
 When the PCM is closed, close callback is called.  If the driver
 allocates any internal buffers, they should be released in this
 callback.  The hw_params and hw_free callbacks are called when
@@ -1080,8 +1232,10 @@ int snd_pcm_ioplug_create(snd_pcm_ioplug_t *ioplug, const char *name,
 
 	assert(ioplug && ioplug->callback);
 	assert(ioplug->callback->start &&
-	       ioplug->callback->stop &&
-	       ioplug->callback->pointer);
+	       ioplug->callback->stop);
+	assert(ioplug->callback->pointer ||
+	       (ioplug->version >= 0x010003 &&
+		(ioplug->flags & SND_PCM_IOPLUG_FLAG_PUBLISHED_POINTER)));
 
 	/* We support 1.0.0 to current */
 	if (ioplug->version < 0x010000 ||
@@ -1209,21 +1363,42 @@ int snd_pcm_ioplug_reinit_status(snd_pcm_ioplug_t *ioplug)
 		ioplug->pcm->tstamp_type = SND_PCM_TSTAMP_TYPE_MONOTONIC;
 	else
 		ioplug->pcm->tstamp_type = SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY;
-	ioplug->pcm->mmap_rw = ioplug->mmap_rw;
+	/* read/write always go through the shared ring */
+	ioplug->pcm->mmap_rw = ioplug->mmap_rw || ioplug_shared_buffer(ioplug);
 	return 0;
 }
 
+/**
+ * \brief Publish the current position of ioplug
+ * \param ioplug the ioplug handle
+ * \param pos the buffer position, as the pointer callback would return it,
+ *            or a negative error code for Xrun
+ *
+ * Stores the position for a plugin with #SND_PCM_IOPLUG_FLAG_PUBLISHED_POINTER
+ * set.  The store is atomic with release semantics, so a backend thread can
+ * call this function after updating the buffer without taking any lock, and
+ * the avail and delay queries read the position with a single load instead
+ * of calling the pointer callback.
+ */
+void snd_pcm_ioplug_publish_pointer(snd_pcm_ioplug_t *ioplug, snd_pcm_sframes_t pos)
+{
+	ioplug_priv_t *io = ioplug->pcm->private_data;
+
+	__atomic_store_n(&io->published_hw, pos, __ATOMIC_RELEASE);
+}
+
 /**
  * \brief Get mmap area of ioplug
  * \param ioplug the ioplug handle
  * \return the mmap channel areas if available, or NULL
  *
- * Returns the mmap channel areas if available.  When mmap_rw field is not set,
- * this function always returns NULL.
+ * Returns the mmap channel areas if available.  When neither mmap_rw field nor
+ * #SND_PCM_IOPLUG_FLAG_SHARED_BUFFER flag is set, this function always returns
+ * NULL.  With a shared buffer, the areas point directly into the mapped ring.
  */
 const snd_pcm_channel_area_t *snd_pcm_ioplug_mmap_areas(snd_pcm_ioplug_t *ioplug)
 {
-	if (ioplug->mmap_rw)
+	if (ioplug->pcm->mmap_rw)
 		return snd_pcm_mmap_areas(ioplug->pcm);
 	return NULL;
 }
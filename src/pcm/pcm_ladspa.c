@@ -37,6 +37,10 @@
 #include <dirent.h>
 #include <locale.h>
 #include <math.h>
+#include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include "ladspa.h"
 
@@ -63,6 +67,13 @@ typedef struct {
 	unsigned int channels;			/* forced input channels, 0 = auto */
 	unsigned int allocated;			/* count of allocated samples */
 	LADSPA_Data *zero[2];			/* zero input or dummy output */
+	unsigned int threads;			/* threads running the instances, 0 = caller only */
+	struct snd_pcm_ladspa_pool *pool;	/* worker threads */
+	struct snd_pcm_ladspa_instance **stage;	/* instances of the running plugin */
+	unsigned int stage_size;		/* size of array */
+	snd_ctl_t *ctl;				/* card of the bound control ports */
+	int ctl_events;				/* value changes are notified via ctl events */
+	snd_ctl_elem_value_t elem;
 } snd_pcm_ladspa_t;
  
 typedef struct {
@@ -88,6 +99,23 @@ typedef struct snd_pcm_ladspa_instance {
 	struct snd_pcm_ladspa_instance *next;
 } snd_pcm_ladspa_instance_t;
 
+typedef struct {
+	struct list_head list;
+	snd_ctl_elem_id_t id;			/* numid set once loaded */
+	int card;				/* -1 = card of the slave */
+	unsigned int port;			/* LADSPA port */
+	LADSPA_Data *value;			/* the control port value */
+	LADSPA_Data min;			/* port value at the element minimum */
+	LADSPA_Data max;			/* port value at the element maximum */
+	long resolution;			/* element steps of a real port */
+	long emin;				/* element range */
+	long emax;
+	int integer;				/* the element value is the port value */
+	int toggled;				/* boolean element */
+	int log;				/* logarithmic mapping */
+	int dirty;				/* the element must be read again */
+} snd_pcm_ladspa_ctl_t;
+
 typedef struct {
 	LADSPA_PortDescriptor pdesc;		/* port description */
 	unsigned int port_bindings_size;	/* size of array */
@@ -95,6 +123,7 @@ typedef struct {
 	unsigned int controls_size;		/* size of array */
 	unsigned char *controls_initialized;	/* initialized by ALSA user */
 	LADSPA_Data *controls;			/* index = LADSPA control port index */
+	struct list_head ctls;			/* control ports bound to ctl elements */
 } snd_pcm_ladspa_plugin_io_t;
 
 typedef struct {
@@ -174,6 +203,11 @@ static int snd_pcm_ladspa_find_port_idx(unsigned int *res,
 
 static void snd_pcm_ladspa_free_io(snd_pcm_ladspa_plugin_io_t *io)
 {
+	while (!list_empty(&io->ctls)) {
+		snd_pcm_ladspa_ctl_t *c = list_entry(io->ctls.next, snd_pcm_ladspa_ctl_t, list);
+		list_del(&c->list);
+		free(c);
+	}
 	free(io->controls);
 	free(io->controls_initialized);
 }
@@ -192,14 +226,192 @@ static void snd_pcm_ladspa_free_plugins(struct list_head *plugins)
 	}
 }
 
+#ifndef DOC_HIDDEN
+static void snd_pcm_ladspa_run_part(snd_pcm_ladspa_instance_t **instances,
+				    unsigned int count, unsigned long size,
+				    unsigned int part, unsigned int parts)
+{
+	unsigned int idx;
+
+	for (idx = part; idx < count; idx += parts)
+		instances[idx]->desc->run(instances[idx]->handle, size);
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ *  worker pool for the instances of one plugin (threads option)
+ *
+ *  The instances of a plugin with the duplicate policy process separate
+ *  channels, so they can run in parallel.  The caller runs the first
+ *  part itself and waits for the workers before the next plugin in the
+ *  chain is started.
+ */
+struct snd_pcm_ladspa_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+	pid_t pid;			/* the workers exist only in this process */
+	unsigned int threads;		/* number of worker threads */
+	unsigned int generation;	/* incremented for each job */
+	unsigned int parts;		/* parts of the current job */
+	unsigned int pending;		/* workers still running */
+	int quit;
+	struct {
+		snd_pcm_ladspa_instance_t **instances;
+		unsigned int count;
+		unsigned long size;
+	} job;
+	pthread_t tids[];
+};
+
+static void *snd_pcm_ladspa_pool_worker(void *arg)
+{
+	struct snd_pcm_ladspa_pool *pool = arg;
+	unsigned int generation = 0, idx;
+
+	pthread_mutex_lock(&pool->mutex);
+	idx = pool->pending++;
+	pthread_cond_signal(&pool->done_cond);
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+		/* part 0 is run by the caller */
+		if (idx + 1 < pool->parts)
+			snd_pcm_ladspa_run_part(pool->job.instances, pool->job.count,
+						pool->job.size, idx + 1, pool->parts);
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void snd_pcm_ladspa_pool_free(snd_pcm_ladspa_t *ladspa)
+{
+	struct snd_pcm_ladspa_pool *pool = ladspa->pool;
+	unsigned int i;
+
+	if (!pool)
+		return;
+	if (pool->pid == getpid()) {
+		pthread_mutex_lock(&pool->mutex);
+		pool->quit = 1;
+		pthread_cond_broadcast(&pool->start_cond);
+		pthread_mutex_unlock(&pool->mutex);
+		for (i = 0; i < pool->threads; i++)
+			pthread_join(pool->tids[i], NULL);
+	}
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+	ladspa->pool = NULL;
+}
+
+static int snd_pcm_ladspa_pool_create(snd_pcm_ladspa_t *ladspa)
+{
+	struct snd_pcm_ladspa_pool *pool;
+	unsigned int i, threads = ladspa->threads;
+	int err;
+
+	if (threads < 2 || ladspa->pool)
+		return 0;
+	/* the caller is one of the threads */
+	threads--;
+	pool = calloc(1, sizeof(*pool) + threads * sizeof(pthread_t));
+	if (!pool)
+		return -ENOMEM;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	pool->pid = getpid();
+	ladspa->pool = pool;
+	for (i = 0; i < threads; i++) {
+		err = pthread_create(&pool->tids[i], NULL, snd_pcm_ladspa_pool_worker, pool);
+		if (err) {
+			snd_pcm_ladspa_pool_free(ladspa);
+			return -err;
+		}
+		pool->threads++;
+	}
+	/* wait until all workers picked their index */
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending < pool->threads)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pool->pending = 0;
+	pthread_mutex_unlock(&pool->mutex);
+	return 0;
+}
+
+/* run the collected instances of one plugin, returns after all are done */
+static void snd_pcm_ladspa_run_stage(snd_pcm_ladspa_t *ladspa,
+				     unsigned int count, unsigned long size)
+{
+	struct snd_pcm_ladspa_pool *pool = ladspa->pool;
+	unsigned int parts;
+
+	if (!pool || pool->pid != getpid() || count < 2) {
+		snd_pcm_ladspa_run_part(ladspa->stage, count, size, 0, 1);
+		return;
+	}
+	parts = count < pool->threads + 1 ? count : pool->threads + 1;
+	pthread_mutex_lock(&pool->mutex);
+	pool->job.instances = ladspa->stage;
+	pool->job.count = count;
+	pool->job.size = size;
+	pool->parts = parts;
+	pool->pending = pool->threads;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	snd_pcm_ladspa_run_part(ladspa->stage, count, size, 0, parts);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+#else
+static inline void snd_pcm_ladspa_pool_free(snd_pcm_ladspa_t *ladspa ATTRIBUTE_UNUSED)
+{
+}
+
+static inline int snd_pcm_ladspa_pool_create(snd_pcm_ladspa_t *ladspa ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static void snd_pcm_ladspa_run_stage(snd_pcm_ladspa_t *ladspa,
+				     unsigned int count, unsigned long size)
+{
+	snd_pcm_ladspa_run_part(ladspa->stage, count, size, 0, 1);
+}
+#endif /* HAVE_LIBPTHREAD */
+#endif /* DOC_HIDDEN */
+
 static void snd_pcm_ladspa_free(snd_pcm_ladspa_t *ladspa)
 {
         unsigned int idx;
 
+	snd_pcm_ladspa_pool_free(ladspa);
+	free(ladspa->stage);
+	ladspa->stage = NULL;
+	ladspa->stage_size = 0;
+
 	snd_pcm_ladspa_free_plugins(&ladspa->pplugins);
 	snd_pcm_ladspa_free_plugins(&ladspa->cplugins);
+	if (ladspa->ctl) {
+		snd_ctl_close(ladspa->ctl);
+		ladspa->ctl = NULL;
+	}
 	for (idx = 0; idx < 2; idx++) {
-		free(ladspa->zero[idx]);
+		snd_pcm_arena_free(ladspa->zero[idx]);
                 ladspa->zero[idx] = NULL;
         }
         ladspa->allocated = 0;
@@ -333,12 +545,12 @@ static void snd_pcm_ladspa_free_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 					plugin->desc->cleanup(instance->handle);
 				if (instance->input.m_data) {
 				        for (idx = 0; idx < instance->input.channels.size; idx++)
-						free(instance->input.m_data[idx]);
+						snd_pcm_arena_free(instance->input.m_data[idx]);
 					free(instance->input.m_data);
                                 }
 				if (instance->output.m_data) {
 				        for (idx = 0; idx < instance->output.channels.size; idx++)
-						free(instance->output.m_data[idx]);
+						snd_pcm_arena_free(instance->output.m_data[idx]);
 					free(instance->output.m_data);
                                 }
                                 free(instance->input.data);
@@ -676,13 +888,37 @@ static int snd_pcm_ladspa_allocate_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *l
 	return 0;
 }
 
-static LADSPA_Data *snd_pcm_ladspa_allocate_zero(snd_pcm_ladspa_t *ladspa, unsigned int idx)
+static LADSPA_Data *snd_pcm_ladspa_allocate_zero(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa,
+						 unsigned int idx)
 {
-        if (ladspa->zero[idx] == NULL)
-                ladspa->zero[idx] = calloc(ladspa->allocated, sizeof(LADSPA_Data));
+        if (ladspa->zero[idx] == NULL) {
+                ladspa->zero[idx] = snd_pcm_arena_alloc(pcm, sizeof(LADSPA_Data) * ladspa->allocated);
+                if (ladspa->zero[idx])
+                        memset(ladspa->zero[idx], 0, sizeof(LADSPA_Data) * ladspa->allocated);
+        }
         return ladspa->zero[idx];
 }
 
+#ifndef DOC_HIDDEN
+typedef struct {
+	snd_pcm_ladspa_instance_t *instance;	/* last instance writing the channel */
+	unsigned int idx;			/* output index of the instance */
+} snd_pcm_ladspa_writer_t;
+#endif /* DOC_HIDDEN */
+
+static int snd_pcm_ladspa_input_uses(snd_pcm_ladspa_instance_t *instance,
+				     unsigned int chn, void *data)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < instance->input.channels.size; idx++) {
+		if (instance->input.channels.array[idx] == chn &&
+		    instance->input.data[idx] == data)
+			return 1;
+	}
+	return 0;
+}
+
 static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa)
 {
 	struct list_head *list, *pos, *pos1;
@@ -690,7 +926,9 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 	unsigned int channels = 16, nchannels;
 	unsigned int ichannels, ochannels;
 	void **pchannels, **npchannels;
+	snd_pcm_ladspa_writer_t *plast, *nplast;
 	unsigned int idx, chn;
+	int inplace;
 	
         ladspa->allocated = 2048;
         if (pcm->buffer_size > ladspa->allocated)
@@ -703,8 +941,12 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                 ochannels = pcm->channels;
         }
 	pchannels = calloc(1, sizeof(void *) * channels);
-	if (pchannels == NULL)
+	plast = calloc(channels, sizeof(*plast));
+	if (pchannels == NULL || plast == NULL) {
+		free(pchannels);
+		free(plast);
 	        return -ENOMEM;
+	}
 	list = pcm->stream == SND_PCM_STREAM_PLAYBACK ? &ladspa->pplugins : &ladspa->cplugins;
 	list_for_each(pos, list) {
 		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
@@ -725,13 +967,18 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                         }
                         if (nchannels != channels) {
                                 npchannels = realloc(pchannels, nchannels * sizeof(void *));
-                                if (npchannels == NULL) {
-                                        free(pchannels);
-                                        return -ENOMEM;
-                                }
-                                for (idx = channels; idx < nchannels; idx++)
-                                        npchannels[idx] = NULL;
+                                if (npchannels == NULL)
+                                        goto __nomem;
                                 pchannels = npchannels;
+                                nplast = realloc(plast, nchannels * sizeof(*plast));
+                                if (nplast == NULL)
+                                        goto __nomem;
+                                plast = nplast;
+                                for (idx = channels; idx < nchannels; idx++) {
+                                        npchannels[idx] = NULL;
+                                        nplast[idx].instance = NULL;
+                                }
+                                channels = nchannels;
                         }
                         assert(instance->input.data == NULL);
                         assert(instance->input.m_data == NULL);
@@ -744,10 +991,8 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                         if (instance->input.data == NULL ||
                             instance->input.m_data == NULL ||
                             instance->output.data == NULL ||
-                            instance->output.m_data == NULL) {
-                                free(pchannels);
-                                return -ENOMEM;
-                        }
+                            instance->output.m_data == NULL)
+                                goto __nomem;
 			for (idx = 0; idx < instance->input.channels.size; idx++) {
 			        chn = instance->input.channels.array[idx];
 			        if (pchannels[chn] == NULL && chn < ichannels) {
@@ -756,52 +1001,48 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                                 }
 			        instance->input.data[idx] = pchannels[chn];
 			        if (instance->input.data[idx] == NULL) {
-                                        instance->input.data[idx] = snd_pcm_ladspa_allocate_zero(ladspa, 0);
-                                        if (instance->input.data[idx] == NULL) {
-                                                free(pchannels);
-                                                return -ENOMEM;
-                                        }
+                                        instance->input.data[idx] = snd_pcm_ladspa_allocate_zero(pcm, ladspa, 0);
+                                        if (instance->input.data[idx] == NULL)
+                                                goto __nomem;
                                 }
                         }
+			inplace = !LADSPA_IS_INPLACE_BROKEN(plugin->desc->Properties);
                         for (idx = 0; idx < instance->output.channels.size; idx++) {
 			        chn = instance->output.channels.array[idx];
-                                /* FIXME/OPTIMIZE: check if we can remove double alloc */
-                                /* if LADSPA plugin has no broken inplace */
-                                instance->output.data[idx] = malloc(sizeof(LADSPA_Data) * ladspa->allocated);
-                                if (instance->output.data[idx] == NULL) {
-                                        free(pchannels);
-                                        return -ENOMEM;
+			        /* overwrite the intermediate input buffer of the same channel */
+			        /* the buffer stays owned by the instance which allocated it */
+			        if (inplace && pchannels[chn] != NULL &&
+			            snd_pcm_ladspa_input_uses(instance, chn, pchannels[chn])) {
+			                instance->output.data[idx] = pchannels[chn];
+			        } else {
+                                        instance->output.data[idx] = snd_pcm_arena_alloc(pcm, sizeof(LADSPA_Data) * ladspa->allocated);
+                                        if (instance->output.data[idx] == NULL)
+                                                goto __nomem;
+                                        instance->output.m_data[idx] = instance->output.data[idx];
                                 }
-                                pchannels[chn] = instance->output.m_data[idx] = instance->output.data[idx];
+                                pchannels[chn] = instance->output.data[idx];
+                                plast[chn].instance = instance;
+                                plast[chn].idx = idx;
                         }
 		}
 	}
-	/* OPTIMIZE: we have already allocated areas for ALSA output channels */
-	/* next loop deallocates the last output LADSPA areas and connects */
-	/* them to ALSA areas (NULL) or dummy area ladpsa->free[1] ; */
-	/* this algorithm might be optimized to not allocate the last LADSPA outputs */
-	list_for_each(pos, list) {
-		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
-		list_for_each(pos1, &plugin->instances) {
-			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
-                        for (idx = 0; idx < instance->output.channels.size; idx++) {
-        			chn = instance->output.channels.array[idx];
-                                if (instance->output.data[idx] == pchannels[chn]) {
-					free(instance->output.m_data[idx]);
-					instance->output.m_data[idx] = NULL;
-                                        if (chn < ochannels) {
-                                                instance->output.data[idx] = NULL;
-                                        } else {
-                                                instance->output.data[idx] = snd_pcm_ladspa_allocate_zero(ladspa, 1);
-                                                if (instance->output.data[idx] == NULL) {
-                                                        free(pchannels);
-                                                        return -ENOMEM;
-                                                }
-                                        }
-                                }
-                        }
-                }
-        }
+	/* the last LADSPA outputs of each channel are connected to ALSA */
+	/* areas (NULL) or to the dummy area ladspa->zero[1] instead */
+	for (chn = 0; chn < channels; chn++) {
+		instance = plast[chn].instance;
+		if (instance == NULL)
+			continue;
+		idx = plast[chn].idx;
+		snd_pcm_arena_free(instance->output.m_data[idx]);
+		instance->output.m_data[idx] = NULL;
+		if (chn < ochannels) {
+			instance->output.data[idx] = NULL;
+		} else {
+			instance->output.data[idx] = snd_pcm_ladspa_allocate_zero(pcm, ladspa, 1);
+			if (instance->output.data[idx] == NULL)
+				goto __nomem;
+		}
+	}
 #if 0
         printf("zero[0] = %p\n", ladspa->zero[0]);
         printf("zero[1] = %p\n", ladspa->zero[1]);
@@ -817,7 +1058,38 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 	}
 #endif
 	free(pchannels);
+	free(plast);
 	return 0;
+
+      __nomem:
+	free(pchannels);
+	free(plast);
+	return -ENOMEM;
+}
+
+static int snd_pcm_ladspa_allocate_stage(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa)
+{
+	struct list_head *list, *pos, *pos1;
+	unsigned int count, size = 0;
+	void *stage;
+
+	list = pcm->stream == SND_PCM_STREAM_PLAYBACK ? &ladspa->pplugins : &ladspa->cplugins;
+	list_for_each(pos, list) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		count = 0;
+		list_for_each(pos1, &plugin->instances)
+			count++;
+		if (count > size)
+			size = count;
+	}
+	if (size > ladspa->stage_size) {
+		stage = realloc(ladspa->stage, size * sizeof(*ladspa->stage));
+		if (stage == NULL)
+			return -ENOMEM;
+		ladspa->stage = stage;
+		ladspa->stage_size = size;
+	}
+	return snd_pcm_ladspa_pool_create(ladspa);
 }
 
 static int snd_pcm_ladspa_init(snd_pcm_t *pcm)
@@ -836,6 +1108,11 @@ static int snd_pcm_ladspa_init(snd_pcm_t *pcm)
 		snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
 		return err;
 	}
+	err = snd_pcm_ladspa_allocate_stage(pcm, ladspa);
+	if (err < 0) {
+		snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
+		return err;
+	}
 	return 0;
 }
 
@@ -847,6 +1124,252 @@ static int snd_pcm_ladspa_hw_free(snd_pcm_t *pcm)
 	return snd_pcm_generic_hw_free(pcm);
 }
 
+/* the element value of a port value */
+static long snd_pcm_ladspa_ctl_from_port(snd_pcm_ladspa_ctl_t *c, LADSPA_Data val)
+{
+	double x;
+
+	if (val <= c->min)
+		return c->emin;
+	if (val >= c->max)
+		return c->emax;
+	if (c->integer)
+		return lrint(val);
+	if (c->log)
+		x = log(val / c->min) / log(c->max / c->min);
+	else
+		x = (val - c->min) / (c->max - c->min);
+	return c->emin + lrint(x * (c->emax - c->emin));
+}
+
+/* the port value of an element value */
+static LADSPA_Data snd_pcm_ladspa_ctl_to_port(snd_pcm_ladspa_ctl_t *c, long val)
+{
+	double x;
+
+	if (val <= c->emin)
+		return c->min;
+	if (val >= c->emax)
+		return c->max;
+	if (c->integer)
+		return val;
+	x = (double)(val - c->emin) / (c->emax - c->emin);
+	if (c->log)
+		return c->min * pow(c->max / c->min, x);
+	return c->min + (c->max - c->min) * x;
+}
+
+static int snd_pcm_ladspa_read_ctl(snd_pcm_ladspa_t *ladspa, snd_pcm_ladspa_ctl_t *c)
+{
+	int err;
+
+	snd_ctl_elem_value_clear(&ladspa->elem);
+	ladspa->elem.id = c->id;
+	err = snd_ctl_elem_read(ladspa->ctl, &ladspa->elem);
+	if (err < 0)
+		return err;
+	*c->value = snd_pcm_ladspa_ctl_to_port(c, ladspa->elem.value.integer.value[0]);
+	c->dirty = 0;
+	return 0;
+}
+
+/*
+ * find or create the element of a bound control port
+ *
+ * A user element left by a previous open keeps its value, which then
+ * overrides the configured one.  A driver element is used with its own
+ * range, mapped to the port range.
+ */
+static int snd_pcm_ladspa_load_ctl(snd_pcm_ladspa_t *ladspa, snd_pcm_ladspa_ctl_t *c)
+{
+	snd_ctl_elem_info_t cinfo = {0};
+	snd_ctl_elem_type_t type;
+	int err;
+
+	if (c->integer) {
+		c->emin = ceil(c->min);
+		c->emax = floor(c->max);
+		if (c->emin >= c->emax)
+			c->integer = 0;
+	}
+	if (c->toggled) {
+		c->emin = 0;
+		c->emax = 1;
+	} else if (!c->integer) {
+		c->emin = 0;
+		c->emax = c->resolution - 1;
+	}
+	type = c->toggled ? SND_CTL_ELEM_TYPE_BOOLEAN : SND_CTL_ELEM_TYPE_INTEGER;
+
+	snd_ctl_elem_info_set_id(&cinfo, &c->id);
+	err = snd_ctl_elem_info(ladspa->ctl, &cinfo);
+	if (err >= 0 && (cinfo.access & SNDRV_CTL_ELEM_ACCESS_USER) &&
+	    (snd_ctl_elem_info_get_type(&cinfo) != type || cinfo.count != 1 ||
+	     cinfo.value.integer.min != c->emin ||
+	     cinfo.value.integer.max != c->emax)) {
+		err = snd_ctl_elem_remove(ladspa->ctl, &cinfo.id);
+		if (err < 0) {
+			SNDERR("Control %s mismatch", c->id.name);
+			return err;
+		}
+		snd_ctl_elem_info_clear(&cinfo);
+		snd_ctl_elem_info_set_id(&cinfo, &c->id);
+		err = -ENOENT;
+	}
+	if (err == -ENOENT) {
+		if (c->toggled) {
+			snd_ctl_elem_info_set_read_write(&cinfo, 1, 1);
+			err = snd_ctl_add_boolean_elem_set(ladspa->ctl, &cinfo, 1, 1);
+		} else {
+			err = snd_ctl_add_integer_elem_set(ladspa->ctl, &cinfo, 1, 1,
+							   c->emin, c->emax, 0);
+		}
+		if (err < 0) {
+			SNDERR("Cannot add the control %s", c->id.name);
+			return err;
+		}
+		c->id = cinfo.id;
+		snd_ctl_elem_value_clear(&ladspa->elem);
+		ladspa->elem.id = c->id;
+		ladspa->elem.value.integer.value[0] = snd_pcm_ladspa_ctl_from_port(c, *c->value);
+		return snd_ctl_elem_write(ladspa->ctl, &ladspa->elem);
+	}
+	if (err < 0) {
+		SNDERR("Cannot get info for the control %s", c->id.name);
+		return err;
+	}
+	if (!(cinfo.access & SNDRV_CTL_ELEM_ACCESS_USER)) {
+		if ((cinfo.type != SND_CTL_ELEM_TYPE_INTEGER &&
+		     cinfo.type != SND_CTL_ELEM_TYPE_BOOLEAN) ||
+		    cinfo.value.integer.min >= cinfo.value.integer.max) {
+			SNDERR("Control %s cannot be bound", c->id.name);
+			return -EINVAL;
+		}
+		c->emin = cinfo.value.integer.min;
+		c->emax = cinfo.value.integer.max;
+	}
+	c->id = cinfo.id;
+	return snd_pcm_ladspa_read_ctl(ladspa, c);
+}
+
+static int snd_pcm_ladspa_load_ctls(snd_pcm_ladspa_t *ladspa, struct list_head *plugins,
+				    snd_pcm_t *slave, int *cardp)
+{
+	struct list_head *pos, *pos1;
+	char name[16];
+	int card, err;
+
+	list_for_each(pos, plugins) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		list_for_each(pos1, &plugin->input.ctls) {
+			snd_pcm_ladspa_ctl_t *c = list_entry(pos1, snd_pcm_ladspa_ctl_t, list);
+			card = c->card;
+			if (card < 0) {
+				snd_pcm_info_t info = {0};
+				err = snd_pcm_info(slave, &info);
+				if (err < 0)
+					return err;
+				card = snd_pcm_info_get_card(&info);
+				if (card < 0) {
+					SNDERR("No card defined for the control %s", c->id.name);
+					return -EINVAL;
+				}
+			}
+			if (!ladspa->ctl) {
+				sprintf(name, "hw:%d", card);
+				err = snd_ctl_open(&ladspa->ctl, name, 0);
+				if (err < 0) {
+					SNDERR("Cannot open CTL %s", name);
+					return err;
+				}
+				*cardp = card;
+			} else if (card != *cardp) {
+				SNDERR("The bound controls must be on one card");
+				return -EINVAL;
+			}
+			err = snd_pcm_ladspa_load_ctl(ladspa, c);
+			if (err < 0)
+				return err;
+		}
+	}
+	return 0;
+}
+
+/* bind the control ports to their elements, see the ctls field */
+static int snd_pcm_ladspa_bind_ctls(snd_pcm_ladspa_t *ladspa, snd_pcm_t *slave)
+{
+	int card = -1, err;
+
+	err = snd_pcm_ladspa_load_ctls(ladspa, &ladspa->pplugins, slave, &card);
+	if (err < 0)
+		return err;
+	err = snd_pcm_ladspa_load_ctls(ladspa, &ladspa->cplugins, slave, &card);
+	if (err < 0)
+		return err;
+	if (!ladspa->ctl)
+		return 0;
+	/* the values are refreshed on change events, polled otherwise */
+	if (snd_ctl_nonblock(ladspa->ctl, 1) < 0 ||
+	    snd_ctl_subscribe_events(ladspa->ctl, 1) < 0)
+		snd_ctl_nonblock(ladspa->ctl, 0);
+	else
+		ladspa->ctl_events = 1;
+	return 0;
+}
+
+static void snd_pcm_ladspa_mark_ctls(struct list_head *plugins, unsigned int numid)
+{
+	struct list_head *pos, *pos1;
+
+	list_for_each(pos, plugins) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		list_for_each(pos1, &plugin->input.ctls) {
+			snd_pcm_ladspa_ctl_t *c = list_entry(pos1, snd_pcm_ladspa_ctl_t, list);
+			if (c->id.numid == numid)
+				c->dirty = 1;
+		}
+	}
+}
+
+/*
+ * refresh the bound control ports before a transfer
+ *
+ * With the ctl events subscribed, only the changed elements are read,
+ * after draining the pending events by a non-blocking read.  The ports
+ * stay connected to the same values, so the running instances see the
+ * change at their next run.
+ */
+static void snd_pcm_ladspa_update_ctls(snd_pcm_ladspa_t *ladspa, struct list_head *plugins)
+{
+	struct list_head *pos, *pos1;
+
+	if (!ladspa->ctl)
+		return;
+	if (ladspa->ctl_events) {
+		snd_ctl_event_t event;
+		int err;
+
+		while ((err = snd_ctl_read(ladspa->ctl, &event)) > 0) {
+			if (snd_ctl_event_get_type(&event) != SND_CTL_EVENT_ELEM ||
+			    !(snd_ctl_event_elem_get_mask(&event) & SND_CTL_EVENT_MASK_VALUE))
+				continue;
+			snd_pcm_ladspa_mark_ctls(plugins, snd_ctl_event_elem_get_numid(&event));
+		}
+		if (err < 0 && err != -EAGAIN) {
+			/* fall back to reading the values each time */
+			ladspa->ctl_events = 0;
+		}
+	}
+	list_for_each(pos, plugins) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		list_for_each(pos1, &plugin->input.ctls) {
+			snd_pcm_ladspa_ctl_t *c = list_entry(pos1, snd_pcm_ladspa_ctl_t, list);
+			if (c->dirty || !ladspa->ctl_events)
+				snd_pcm_ladspa_read_ctl(ladspa, c);
+		}
+	}
+}
+
 static snd_pcm_uframes_t
 snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -860,11 +1383,12 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
 	snd_pcm_ladspa_instance_t *instance;
 	struct list_head *pos, *pos1;
 	LADSPA_Data *data;
-	unsigned int idx, chn, size1, size2;
+	unsigned int idx, chn, size1, size2, count;
 	
 	if (size > *slave_sizep)
 		size = *slave_sizep;
         size2 = size;
+	snd_pcm_ladspa_update_ctls(ladspa, &ladspa->pplugins);
 #if 0	/* no processing - for testing purposes only */
 	snd_pcm_areas_copy(slave_areas, slave_offset,
 			   areas, offset,
@@ -876,6 +1400,7 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
                         size1 = ladspa->allocated;
         	list_for_each(pos, &ladspa->pplugins) {
         		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+        		count = 0;
         		list_for_each(pos1, &plugin->instances) {
         			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
         			for (idx = 0; idx < instance->input.channels.size; idx++) {
@@ -896,8 +1421,9 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
                                         }
 					instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
         			}
-        			instance->desc->run(instance->handle, size1);
+        			ladspa->stage[count++] = instance;
         		}
+        		snd_pcm_ladspa_run_stage(ladspa, count, size1);
         	}
         	offset += size1;
         	slave_offset += size1;
@@ -921,11 +1447,12 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
 	snd_pcm_ladspa_instance_t *instance;
 	struct list_head *pos, *pos1;
 	LADSPA_Data *data;
-	unsigned int idx, chn, size1, size2;;
+	unsigned int idx, chn, size1, size2, count;
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
         size2 = size;
+	snd_pcm_ladspa_update_ctls(ladspa, &ladspa->cplugins);
 #if 0	/* no processing - for testing purposes only */
 	snd_pcm_areas_copy(areas, offset,
 			   slave_areas, slave_offset,
@@ -937,6 +1464,7 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
                         size1 = ladspa->allocated;
         	list_for_each(pos, &ladspa->cplugins) {
         		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+        		count = 0;
         		list_for_each(pos1, &plugin->instances) {
         			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
         			for (idx = 0; idx < instance->input.channels.size; idx++) {
@@ -957,8 +1485,9 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
                                         }
         		        	instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
         			}
-        			instance->desc->run(instance->handle, size1);
+        			ladspa->stage[count++] = instance;
         		}
+        		snd_pcm_ladspa_run_stage(ladspa, count, size1);
         	}
         	offset += size1;
         	slave_offset += size1;
@@ -973,6 +1502,7 @@ static void snd_pcm_ladspa_dump_direction(snd_pcm_ladspa_plugin_t *plugin,
                                           snd_pcm_ladspa_plugin_io_t *io,
                                           snd_output_t *out)
 {
+	struct list_head *pos;
 	unsigned int idx, midx;
 
 	if (io->port_bindings_size == 0)
@@ -994,6 +1524,11 @@ static void snd_pcm_ladspa_dump_direction(snd_pcm_ladspa_plugin_t *plugin,
         		midx++;
                 }
         }
+	list_for_each(pos, &io->ctls) {
+		snd_pcm_ladspa_ctl_t *c = list_entry(pos, snd_pcm_ladspa_ctl_t, list);
+		snd_output_printf(out, "      %u bound to \"%s\" index %u (%g - %g)\n",
+				  c->port, c->id.name, c->id.index, c->min, c->max);
+	}
 }
 
 static void snd_pcm_ladspa_dump_array(snd_output_t *out,
@@ -1053,6 +1588,8 @@ static void snd_pcm_ladspa_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
 
 	snd_output_printf(out, "LADSPA PCM\n");
+	if (ladspa->threads > 1)
+		snd_output_printf(out, "  Threads: %u\n", ladspa->threads);
 	snd_output_printf(out, "  Playback:\n");
 	snd_pcm_ladspa_plugins_dump(&ladspa->pplugins, out);
 	snd_output_printf(out, "  Capture:\n");
@@ -1083,12 +1620,48 @@ static const snd_pcm_ops_t snd_pcm_ladspa_ops = {
 	.set_chmap = snd_pcm_generic_set_chmap,
 };
 
+/*
+ * check the plugin label and id, returns 1 when they match
+ */
+static int snd_pcm_ladspa_match(const char *dlabel, unsigned long did,
+				const char *label, unsigned long ladspa_id)
+{
+/*
+ * avoid locale problems - see ALSA bug#1553
+ */
+#if 0
+	if (label != NULL && strcmp(label, dlabel))
+		return 0;
+#else
+        char *labellocale;
+        struct lconv *lc;
+        if (label != NULL) {
+                lc = localeconv ();
+                labellocale = malloc (strlen (label) + 1);
+                if (labellocale == NULL)
+                        return -ENOMEM;
+                strcpy (labellocale, label);
+                if (strrchr(labellocale, '.'))
+                        *strrchr (labellocale, '.') = *lc->decimal_point;
+                if (strcmp(label, dlabel) && strcmp(labellocale, dlabel)) {
+                        free(labellocale);
+                        return 0;
+                }
+                free (labellocale);
+        }
+#endif
+	if (ladspa_id > 0 && did != ladspa_id)
+		return 0;
+	return 1;
+}
+
 static int snd_pcm_ladspa_check_file(snd_pcm_ladspa_plugin_t * const plugin,
 				     const char *filename,
 				     const char *label,
 				     const unsigned long ladspa_id)
 {
 	void *handle;
+	int err;
 
 	assert(filename);
 	handle = dlopen(filename, RTLD_LAZY);
@@ -1098,33 +1671,12 @@ static int snd_pcm_ladspa_check_file(snd_pcm_ladspa_plugin_t * const plugin,
 			long idx;
 			const LADSPA_Descriptor *d;
 			for (idx = 0; (d = fcn(idx)) != NULL; idx++) {
-/*
- * avoid locale problems - see ALSA bug#1553
- */
-#if 0
-				if (strcmp(label, d->Label))
-					continue;
-#else
-                                char *labellocale;
-                                struct lconv *lc;
-                                if (label != NULL) {
-                                        lc = localeconv ();
-                                        labellocale = malloc (strlen (label) + 1);
-                                        if (labellocale == NULL) {
-                                        	dlclose(handle);
-                                                return -ENOMEM;
-					}
-                                        strcpy (labellocale, label);
-                                        if (strrchr(labellocale, '.'))
-                                                *strrchr (labellocale, '.') = *lc->decimal_point;
-                                        if (strcmp(label, d->Label) && strcmp(labellocale, d->Label)) {
-                                                free(labellocale);
-                                                continue;
-                                        }
-                                        free (labellocale);
-                                }
-#endif
-				if (ladspa_id > 0 && d->UniqueID != ladspa_id)
+				err = snd_pcm_ladspa_match(d->Label, d->UniqueID, label, ladspa_id);
+				if (err < 0) {
+					dlclose(handle);
+					return err;
+				}
+				if (!err)
 					continue;
 				plugin->filename = strdup(filename);
 				if (plugin->filename == NULL) {
@@ -1191,15 +1743,455 @@ static int snd_pcm_ladspa_check_dir(snd_pcm_ladspa_plugin_t * const plugin,
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ *  persistent index of the plugin descriptors
+ *
+ *  Looking for a plugin by label or id means to dlopen the files in the
+ *  LADSPA path until it is found.  The index remembers the descriptors
+ *  (label, id, port count) of each file, so only the matching file is
+ *  loaded.  A directory is rescanned when its mtime changes and a file
+ *  when its mtime or size changes.  The index is stored as a text file:
+ *
+ *    ALSA-LADSPA-INDEX 1
+ *    D <mtime> <directory>
+ *    F <mtime> <size> <file>
+ *    P <id> <ports> <label>
+ *
+ *  The location is $ALSA_LADSPA_CACHE, an empty value disables the index,
+ *  or $XDG_CACHE_HOME/alsa/ladspa.cache or ~/.cache/alsa/ladspa.cache.
+ */
+
+#define LADSPA_INDEX_MAGIC	"ALSA-LADSPA-INDEX 1"
+
+typedef struct {
+	struct list_head list;
+	unsigned long id;
+	unsigned long ports;
+	char label[];
+} snd_pcm_ladspa_index_desc_t;
+
+typedef struct {
+	struct list_head list;
+	struct list_head descs;
+	long long mtime;
+	long long size;
+	char name[];
+} snd_pcm_ladspa_index_file_t;
+
+typedef struct {
+	struct list_head list;
+	struct list_head files;
+	long long mtime;
+	char path[];
+} snd_pcm_ladspa_index_dir_t;
+
+typedef struct {
+	char *filename;			/* NULL = index disabled */
+	struct list_head dirs;
+	int dirty;
+} snd_pcm_ladspa_index_t;
+
+static void snd_pcm_ladspa_index_free_dir(snd_pcm_ladspa_index_dir_t *dir)
+{
+	struct list_head *pos, *npos, *pos1, *npos1;
+
+	list_for_each_safe(pos, npos, &dir->files) {
+		snd_pcm_ladspa_index_file_t *file = list_entry(pos, snd_pcm_ladspa_index_file_t, list);
+		list_for_each_safe(pos1, npos1, &file->descs)
+			free(list_entry(pos1, snd_pcm_ladspa_index_desc_t, list));
+		free(file);
+	}
+	list_del(&dir->list);
+	free(dir);
+}
+
+static void snd_pcm_ladspa_index_free(snd_pcm_ladspa_index_t *index)
+{
+	while (!list_empty(&index->dirs))
+		snd_pcm_ladspa_index_free_dir(list_entry(index->dirs.next, snd_pcm_ladspa_index_dir_t, list));
+	free(index->filename);
+	index->filename = NULL;
+}
+
+static snd_pcm_ladspa_index_dir_t *snd_pcm_ladspa_index_add_dir(snd_pcm_ladspa_index_t *index,
+								 const char *path,
+								 long long mtime)
+{
+	snd_pcm_ladspa_index_dir_t *dir = malloc(sizeof(*dir) + strlen(path) + 1);
+
+	if (dir == NULL)
+		return NULL;
+	INIT_LIST_HEAD(&dir->files);
+	dir->mtime = mtime;
+	strcpy(dir->path, path);
+	list_add_tail(&dir->list, &index->dirs);
+	return dir;
+}
+
+static snd_pcm_ladspa_index_file_t *snd_pcm_ladspa_index_add_file(snd_pcm_ladspa_index_dir_t *dir,
+								   const char *name,
+								   long long mtime,
+								   long long size)
+{
+	snd_pcm_ladspa_index_file_t *file = malloc(sizeof(*file) + strlen(name) + 1);
+
+	if (file == NULL)
+		return NULL;
+	INIT_LIST_HEAD(&file->descs);
+	file->mtime = mtime;
+	file->size = size;
+	strcpy(file->name, name);
+	list_add_tail(&file->list, &dir->files);
+	return file;
+}
+
+static int snd_pcm_ladspa_index_add_desc(snd_pcm_ladspa_index_file_t *file,
+					 const char *label,
+					 unsigned long id,
+					 unsigned long ports)
+{
+	snd_pcm_ladspa_index_desc_t *desc = malloc(sizeof(*desc) + strlen(label) + 1);
+
+	if (desc == NULL)
+		return -ENOMEM;
+	desc->id = id;
+	desc->ports = ports;
+	strcpy(desc->label, label);
+	list_add_tail(&desc->list, &file->descs);
+	return 0;
+}
+
+static char *snd_pcm_ladspa_index_filename(void)
+{
+	const char *env = getenv("ALSA_LADSPA_CACHE");
+	const char *base;
+	char *filename;
+
+	if (env)
+		return *env ? strdup(env) : NULL;
+	base = getenv("XDG_CACHE_HOME");
+	if (base && *base) {
+		filename = malloc(strlen(base) + sizeof("/alsa/ladspa.cache"));
+		if (filename)
+			sprintf(filename, "%s/alsa/ladspa.cache", base);
+		return filename;
+	}
+	base = getenv("HOME");
+	if (base == NULL || *base == '\0')
+		return NULL;
+	filename = malloc(strlen(base) + sizeof("/.cache/alsa/ladspa.cache"));
+	if (filename)
+		sprintf(filename, "%s/.cache/alsa/ladspa.cache", base);
+	return filename;
+}
+
+/* trim the newline and return the rest of the line after n fields */
+static char *snd_pcm_ladspa_index_field(char *line, unsigned int n)
+{
+	char *p = line;
+
+	line[strcspn(line, "\n")] = '\0';
+	while (n-- > 0) {
+		p = strchr(p, ' ');
+		if (p == NULL)
+			return NULL;
+		p++;
+	}
+	return p;
+}
+
+static void snd_pcm_ladspa_index_load(snd_pcm_ladspa_index_t *index)
+{
+	snd_pcm_ladspa_index_dir_t *dir = NULL;
+	snd_pcm_ladspa_index_file_t *file = NULL;
+	char line[PATH_MAX + 64], *name;
+	long long mtime, size;
+	unsigned long id, ports;
+	FILE *fp;
+
+	INIT_LIST_HEAD(&index->dirs);
+	index->dirty = 0;
+	index->filename = snd_pcm_ladspa_index_filename();
+	if (index->filename == NULL)
+		return;
+	fp = fopen(index->filename, "r");
+	if (fp == NULL)
+		return;
+	if (fgets(line, sizeof(line), fp) == NULL ||
+	    strncmp(line, LADSPA_INDEX_MAGIC "\n", sizeof(LADSPA_INDEX_MAGIC)))
+		goto __error;
+	while (fgets(line, sizeof(line), fp)) {
+		switch (line[0]) {
+		case 'D':
+			name = snd_pcm_ladspa_index_field(line, 2);
+			if (name == NULL || sscanf(line, "D %lld", &mtime) != 1)
+				goto __error;
+			dir = snd_pcm_ladspa_index_add_dir(index, name, mtime);
+			if (dir == NULL)
+				goto __error;
+			file = NULL;
+			break;
+		case 'F':
+			name = snd_pcm_ladspa_index_field(line, 3);
+			if (dir == NULL || name == NULL ||
+			    sscanf(line, "F %lld %lld", &mtime, &size) != 2)
+				goto __error;
+			file = snd_pcm_ladspa_index_add_file(dir, name, mtime, size);
+			if (file == NULL)
+				goto __error;
+			break;
+		case 'P':
+			name = snd_pcm_ladspa_index_field(line, 3);
+			if (file == NULL || name == NULL ||
+			    sscanf(line, "P %lu %lu", &id, &ports) != 2 ||
+			    snd_pcm_ladspa_index_add_desc(file, name, id, ports) < 0)
+				goto __error;
+			break;
+		default:
+			goto __error;
+		}
+	}
+	fclose(fp);
+	return;
+
+      __error:
+	/* start from scratch, the index is rewritten */
+	fclose(fp);
+	while (!list_empty(&index->dirs))
+		snd_pcm_ladspa_index_free_dir(list_entry(index->dirs.next, snd_pcm_ladspa_index_dir_t, list));
+	index->dirty = 1;
+}
+
+static void snd_pcm_ladspa_index_mkdir(char *filename)
+{
+	char *p = filename;
+
+	/* create the missing parent directories */
+	while ((p = strchr(p + 1, '/')) != NULL) {
+		*p = '\0';
+		mkdir(filename, 0755);
+		*p = '/';
+	}
+}
+
+static void snd_pcm_ladspa_index_save(snd_pcm_ladspa_index_t *index)
+{
+	struct list_head *pos, *pos1, *pos2;
+	char *tmpname;
+	FILE *fp;
+	int fd;
+
+	if (index->filename == NULL || !index->dirty)
+		return;
+	tmpname = malloc(strlen(index->filename) + sizeof(".XXXXXX"));
+	if (tmpname == NULL)
+		return;
+	sprintf(tmpname, "%s.XXXXXX", index->filename);
+	snd_pcm_ladspa_index_mkdir(tmpname);
+	fd = mkstemp(tmpname);
+	if (fd < 0 || (fp = fdopen(fd, "w")) == NULL) {
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmpname);
+		}
+		free(tmpname);
+		return;
+	}
+	fprintf(fp, LADSPA_INDEX_MAGIC "\n");
+	list_for_each(pos, &index->dirs) {
+		snd_pcm_ladspa_index_dir_t *dir = list_entry(pos, snd_pcm_ladspa_index_dir_t, list);
+		fprintf(fp, "D %lld %s\n", dir->mtime, dir->path);
+		list_for_each(pos1, &dir->files) {
+			snd_pcm_ladspa_index_file_t *file = list_entry(pos1, snd_pcm_ladspa_index_file_t, list);
+			fprintf(fp, "F %lld %lld %s\n", file->mtime, file->size, file->name);
+			list_for_each(pos2, &file->descs) {
+				snd_pcm_ladspa_index_desc_t *desc = list_entry(pos2, snd_pcm_ladspa_index_desc_t, list);
+				fprintf(fp, "P %lu %lu %s\n", desc->id, desc->ports, desc->label);
+			}
+		}
+	}
+	if (fclose(fp) != 0 || rename(tmpname, index->filename) < 0)
+		unlink(tmpname);
+	free(tmpname);
+}
+
+/*
+ * scan the directory, record the descriptors of all files and keep the
+ * first matching plugin loaded
+ */
+static int snd_pcm_ladspa_index_scan(snd_pcm_ladspa_index_t *index,
+				     snd_pcm_ladspa_plugin_t * const plugin,
+				     const char *path, long long mtime,
+				     const char *label,
+				     const unsigned long ladspa_id)
+{
+	snd_pcm_ladspa_index_dir_t *dir;
+	snd_pcm_ladspa_index_file_t *file;
+	struct dirent64 *dirent;
+	struct stat st;
+	DIR *d;
+	int len = strlen(path), need_slash, found = 0, err = 0;
+	char *filename;
+
+	d = opendir(path);
+	if (!d)
+		return -ENOENT;
+	dir = snd_pcm_ladspa_index_add_dir(index, path, mtime);
+	if (dir == NULL) {
+		closedir(d);
+		return -ENOMEM;
+	}
+	index->dirty = 1;
+	need_slash = path[len - 1] != '/';
+	while ((dirent = readdir64(d)) != NULL) {
+		void *handle;
+		LADSPA_Descriptor_Function fcn;
+		const LADSPA_Descriptor *desc;
+		long idx;
+		int keep = 0;
+
+		filename = malloc(len + strlen(dirent->d_name) + 1 + need_slash);
+		if (filename == NULL) {
+			err = -ENOMEM;
+			break;
+		}
+		strcpy(filename, path);
+		if (need_slash)
+			strcat(filename, "/");
+		strcat(filename, dirent->d_name);
+		if (stat(filename, &st) < 0 || !S_ISREG(st.st_mode)) {
+			free(filename);
+			continue;
+		}
+		file = snd_pcm_ladspa_index_add_file(dir, filename, st.st_mtime, st.st_size);
+		if (file == NULL) {
+			free(filename);
+			err = -ENOMEM;
+			break;
+		}
+		handle = dlopen(filename, RTLD_LAZY);
+		fcn = handle ? (LADSPA_Descriptor_Function)dlsym(handle, "ladspa_descriptor") : NULL;
+		for (idx = 0; fcn && (desc = fcn(idx)) != NULL; idx++) {
+			err = snd_pcm_ladspa_index_add_desc(file, desc->Label, desc->UniqueID, desc->PortCount);
+			if (err >= 0 && !found)
+				err = snd_pcm_ladspa_match(desc->Label, desc->UniqueID, label, ladspa_id);
+			if (err < 0)
+				break;
+			if (err > 0) {
+				plugin->filename = strdup(filename);
+				if (plugin->filename == NULL) {
+					err = -ENOMEM;
+					break;
+				}
+				plugin->dl_handle = handle;
+				plugin->desc = desc;
+				found = keep = 1;
+			}
+		}
+		if (handle && !keep)
+			dlclose(handle);
+		free(filename);
+		if (err < 0)
+			break;
+	}
+	closedir(d);
+	if (err < 0) {
+		if (found) {
+			dlclose(plugin->dl_handle);
+			free(plugin->filename);
+			plugin->dl_handle = NULL;
+			plugin->filename = NULL;
+			plugin->desc = NULL;
+		}
+		return err;
+	}
+	return found;
+}
+
+/*
+ * look for the plugin in one directory of the LADSPA path,
+ * returns 1 when found, 0 or -ENOENT when not
+ */
+static int snd_pcm_ladspa_index_lookup(snd_pcm_ladspa_index_t *index,
+				       snd_pcm_ladspa_plugin_t * const plugin,
+				       const char *path,
+				       const char *label,
+				       const unsigned long ladspa_id)
+{
+	snd_pcm_ladspa_index_dir_t *dir = NULL;
+	struct list_head *pos, *pos1, *pos2;
+	struct stat st;
+	int err;
+
+	if (*path == '\0')
+		return 0;
+	list_for_each(pos, &index->dirs) {
+		dir = list_entry(pos, snd_pcm_ladspa_index_dir_t, list);
+		if (strcmp(dir->path, path) == 0)
+			break;
+		dir = NULL;
+	}
+	if (stat(path, &st) < 0) {
+		if (dir) {
+			snd_pcm_ladspa_index_free_dir(dir);
+			index->dirty = 1;
+		}
+		return -ENOENT;
+	}
+	if (dir == NULL || dir->mtime != (long long)st.st_mtime)
+		goto __rescan;
+	list_for_each(pos1, &dir->files) {
+		snd_pcm_ladspa_index_file_t *file = list_entry(pos1, snd_pcm_ladspa_index_file_t, list);
+		list_for_each(pos2, &file->descs) {
+			snd_pcm_ladspa_index_desc_t *desc = list_entry(pos2, snd_pcm_ladspa_index_desc_t, list);
+			err = snd_pcm_ladspa_match(desc->label, desc->id, label, ladspa_id);
+			if (err < 0)
+				return err;
+			if (!err)
+				continue;
+			if (stat(file->name, &st) < 0 ||
+			    file->mtime != (long long)st.st_mtime ||
+			    file->size != (long long)st.st_size)
+				goto __rescan;
+			err = snd_pcm_ladspa_check_file(plugin, file->name, label, ladspa_id);
+			if (err > 0)
+				return 1;
+			if (err != -ENOENT)
+				return err;
+			goto __rescan;
+		}
+	}
+	/* the file of a changed descriptor is found by the rescan */
+	list_for_each(pos1, &dir->files) {
+		snd_pcm_ladspa_index_file_t *file = list_entry(pos1, snd_pcm_ladspa_index_file_t, list);
+		if (stat(file->name, &st) < 0 ||
+		    file->mtime != (long long)st.st_mtime ||
+		    file->size != (long long)st.st_size)
+			goto __rescan;
+	}
+	return 0;
+
+      __rescan:
+	if (dir)
+		snd_pcm_ladspa_index_free_dir(dir);
+	if (stat(path, &st) < 0)
+		return -ENOENT;
+	return snd_pcm_ladspa_index_scan(index, plugin, path, st.st_mtime, label, ladspa_id);
+}
+#endif /* DOC_HIDDEN */
+
 static int snd_pcm_ladspa_look_for_plugin(snd_pcm_ladspa_plugin_t * const plugin,
 					  const char *path,
 					  const char *label,
 					  const long ladspa_id)
 {
+	snd_pcm_ladspa_index_t index;
 	const char *c;
 	size_t l;
-	int err;
+	int err = -ENOENT;
 	
+	snd_pcm_ladspa_index_load(&index);
 	for (c = path; (l = strcspn(c, ": ")) > 0; ) {
 		char name[l + 1];
 		char *fullpath;
@@ -1207,19 +2199,27 @@ static int snd_pcm_ladspa_look_for_plugin(snd_pcm_ladspa_plugin_t * const plugin
 		name[l] = 0;
 		err = snd_user_file(name, &fullpath);
 		if (err < 0)
-			return err;
-		err = snd_pcm_ladspa_check_dir(plugin, fullpath, label, ladspa_id);
+			break;
+		if (index.filename)
+			err = snd_pcm_ladspa_index_lookup(&index, plugin, fullpath, label, ladspa_id);
+		else
+			err = snd_pcm_ladspa_check_dir(plugin, fullpath, label, ladspa_id);
 		free(fullpath);
 		if (err < 0 && err != -ENOENT)
-			return err;
-		if (err > 0)
-			return 0;
+			break;
+		if (err > 0) {
+			err = 0;
+			break;
+		}
+		err = -ENOENT;
 		c += l;
 		if (!*c)
 			break;
 		c++;
 	}
-	return -ENOENT;
+	snd_pcm_ladspa_index_save(&index);
+	snd_pcm_ladspa_index_free(&index);
+	return err;
 }					  
 
 static int snd_pcm_ladspa_add_default_controls(snd_pcm_ladspa_plugin_t *lplug,
@@ -1368,12 +2368,193 @@ static int snd_pcm_ladspa_parse_bindings(snd_pcm_ladspa_plugin_t *lplug,
 	return 0;
 }
 
+static int snd_pcm_ladspa_parse_ctl(snd_pcm_ladspa_plugin_t *lplug,
+				    snd_pcm_ladspa_ctl_t *c,
+				    unsigned int port,
+				    snd_config_t *conf)
+{
+	const LADSPA_PortRangeHint *hint = &lplug->desc->PortRangeHints[port];
+	snd_config_iterator_t i, next;
+	const char *name = NULL;
+	int has_min = 0, has_max = 0;
+	long index = 0;
+	double dval;
+	int err;
+
+	c->card = -1;
+	c->resolution = 256;
+	snd_ctl_elem_id_set_interface(&c->id, SND_CTL_ELEM_IFACE_MIXER);
+	if (snd_config_get_string(conf, &name) >= 0)
+		goto _name;
+	if (snd_config_get_type(conf) != SND_CONFIG_TYPE_COMPOUND) {
+		SNDERR("ctl definition must be a string or a compound");
+		return -EINVAL;
+	}
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "comment") == 0)
+			continue;
+		if (strcmp(id, "card") == 0) {
+			err = snd_config_get_card(n);
+			if (err < 0)
+				return err;
+			c->card = err;
+			continue;
+		}
+		if (strcmp(id, "iface") == 0 || strcmp(id, "interface") == 0) {
+			err = snd_config_get_ctl_iface(n);
+			if (err < 0)
+				return err;
+			snd_ctl_elem_id_set_interface(&c->id, err);
+			continue;
+		}
+		if (strcmp(id, "name") == 0) {
+			err = snd_config_get_string(n, &name);
+			if (err < 0) {
+				SNDERR("field %s is not a string", id);
+				return err;
+			}
+			continue;
+		}
+		if (strcmp(id, "index") == 0) {
+			err = snd_config_get_integer(n, &index);
+			if (err < 0) {
+				SNDERR("field %s is not an integer", id);
+				return err;
+			}
+			continue;
+		}
+		if (strcmp(id, "min") == 0 || strcmp(id, "max") == 0) {
+			err = snd_config_get_ireal(n, &dval);
+			if (err < 0) {
+				SNDERR("field %s is not a number", id);
+				return err;
+			}
+			if (id[1] == 'i') {
+				c->min = dval;
+				has_min = 1;
+			} else {
+				c->max = dval;
+				has_max = 1;
+			}
+			continue;
+		}
+		if (strcmp(id, "resolution") == 0) {
+			err = snd_config_get_integer(n, &c->resolution);
+			if (err < 0) {
+				SNDERR("field %s is not an integer", id);
+				return err;
+			}
+			if (c->resolution < 2 || c->resolution > 65536) {
+				SNDERR("Invalid resolution %ld", c->resolution);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (name == NULL) {
+		SNDERR("Missing control name");
+		return -EINVAL;
+	}
+ _name:
+	snd_ctl_elem_id_set_name(&c->id, name);
+	snd_ctl_elem_id_set_index(&c->id, index);
+
+	/* the range defaults to the bounds given by the plugin */
+	if (!has_min && LADSPA_IS_HINT_BOUNDED_BELOW(hint->HintDescriptor) &&
+	    !LADSPA_IS_HINT_SAMPLE_RATE(hint->HintDescriptor)) {
+		c->min = hint->LowerBound;
+		has_min = 1;
+	}
+	if (!has_max && LADSPA_IS_HINT_BOUNDED_ABOVE(hint->HintDescriptor) &&
+	    !LADSPA_IS_HINT_SAMPLE_RATE(hint->HintDescriptor)) {
+		c->max = hint->UpperBound;
+		has_max = 1;
+	}
+	c->toggled = LADSPA_IS_HINT_TOGGLED(hint->HintDescriptor);
+	if (c->toggled) {
+		if (!has_min)
+			c->min = 0;
+		if (!has_max)
+			c->max = 1;
+		return 0;
+	}
+	if (!has_min || !has_max || c->min >= c->max) {
+		SNDERR("Control port %s needs a valid min and max", lplug->desc->PortNames[port]);
+		return -EINVAL;
+	}
+	c->integer = LADSPA_IS_HINT_INTEGER(hint->HintDescriptor);
+	c->log = LADSPA_IS_HINT_LOGARITHMIC(hint->HintDescriptor) && c->min > 0;
+	return 0;
+}
+
+static int snd_pcm_ladspa_parse_ctls(snd_pcm_ladspa_plugin_t *lplug,
+				     snd_pcm_ladspa_plugin_io_t *io,
+				     snd_config_t *ctls)
+{
+	snd_config_iterator_t i, next;
+	int err;
+
+	if (snd_config_get_type(ctls) != SND_CONFIG_TYPE_COMPOUND) {
+		SNDERR("ctls definition must be a compound");
+		return -EINVAL;
+	}
+
+	snd_config_for_each(i, next, ctls) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		snd_pcm_ladspa_ctl_t *c;
+		const char *id;
+		long lval;
+		unsigned int port, uval;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		err = safe_strtol(id, &lval);
+		if (err >= 0) {
+			err = snd_pcm_ladspa_find_port(&port, lplug, io->pdesc | LADSPA_PORT_CONTROL, lval);
+		} else {
+			err = snd_pcm_ladspa_find_sport(&port, lplug, io->pdesc | LADSPA_PORT_CONTROL, id);
+		}
+		if (err < 0) {
+			SNDERR("Unable to find an control port (%s)", id);
+			return err;
+		}
+		err = snd_pcm_ladspa_find_port_idx(&uval, lplug, io->pdesc | LADSPA_PORT_CONTROL, port);
+		if (err < 0) {
+			SNDERR("internal error");
+			return err;
+		}
+		c = calloc(1, sizeof(*c));
+		if (c == NULL)
+			return -ENOMEM;
+		err = snd_pcm_ladspa_parse_ctl(lplug, c, port, n);
+		if (err < 0) {
+			free(c);
+			return err;
+		}
+		/* the value is kept across the instances, see connect_controls */
+		if (!io->controls_initialized[uval]) {
+			snd_pcm_ladspa_get_default_cvalue(lplug->desc, port, &io->controls[uval]);
+			io->controls_initialized[uval] = 1;
+		}
+		c->port = port;
+		c->value = &io->controls[uval];
+		list_add_tail(&c->list, &io->ctls);
+	}
+
+	return 0;
+}
+
 static int snd_pcm_ladspa_parse_ioconfig(snd_pcm_ladspa_plugin_t *lplug,
 					 snd_pcm_ladspa_plugin_io_t *io,
 					 snd_config_t *conf)
 {
 	snd_config_iterator_t i, next;
-	snd_config_t *bindings = NULL, *controls = NULL;
+	snd_config_t *bindings = NULL, *controls = NULL, *ctls = NULL;
 	int err;
 
 	/* always add default controls for both input and output */
@@ -1404,6 +2585,10 @@ static int snd_pcm_ladspa_parse_ioconfig(snd_pcm_ladspa_plugin_t *lplug,
 			controls = n;
 			continue;
 		}
+		if (strcmp(id, "ctls") == 0) {
+			ctls = n;
+			continue;
+		}
 	}
 
 	/* ignore values of parameters for output controls */
@@ -1413,6 +2598,16 @@ static int snd_pcm_ladspa_parse_ioconfig(snd_pcm_ladspa_plugin_t *lplug,
 			return err;
 	}
 
+	if (ctls) {
+		if (io->pdesc & LADSPA_PORT_OUTPUT) {
+			SNDERR("ctls are valid only in the input block");
+			return -EINVAL;
+		}
+		err = snd_pcm_ladspa_parse_ctls(lplug, io, ctls);
+		if (err < 0)
+			return err;
+	}
+
 	if (bindings) {
  		err = snd_pcm_ladspa_parse_bindings(lplug, io, bindings);
 		if (err < 0) 
@@ -1495,6 +2690,8 @@ static int snd_pcm_ladspa_add_plugin(struct list_head *list,
 	lplug->policy = policy;
 	lplug->input.pdesc = LADSPA_PORT_INPUT;
 	lplug->output.pdesc = LADSPA_PORT_OUTPUT;
+	INIT_LIST_HEAD(&lplug->input.ctls);
+	INIT_LIST_HEAD(&lplug->output.ctls);
 	INIT_LIST_HEAD(&lplug->instances);
 	if (filename) {
 		err = snd_pcm_ladspa_check_file(lplug, filename, label, ladspa_id);
@@ -1630,6 +2827,11 @@ int snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 			return err;
 		}
 	}
+	err = snd_pcm_ladspa_bind_ctls(ladspa, slave);
+	if (err < 0) {
+		snd_pcm_ladspa_free(ladspa);
+		return err;
+	}
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_LADSPA, name, slave->stream, slave->mode);
 	if (err < 0) {
@@ -1672,6 +2874,31 @@ connected to a dummy sample area.
 
 Instances of LADSPA plugins are created dynamically.
 
+The plugins given by label or id are looked up with the help of an index
+of the descriptors found in the path directories, so only the matching
+library is loaded. The index is kept in the file given by the
+<code>ALSA_LADSPA_CACHE</code> environment variable (an empty value disables
+it) or in <code>$XDG_CACHE_HOME/alsa/ladspa.cache</code>, and a directory is
+scanned again when it or one of its files changes.
+
+<code>threads</code> runs the instances of one plugin in parallel by the
+calling thread and a pool of worker threads (the given number includes
+the caller). Only the plugins with the duplicate policy have more than one
+instance, one per channel. All instances of a plugin are finished before
+the next plugin in the chain is started. The LADSPA plugins must allow
+their instances to run concurrently.
+
+<code>ctls</code> binds input control ports to control elements, so that
+their values can be changed while the stream runs, e.g. from a mixer,
+without reopening the PCM. A user element is created when it does not
+exist yet, with the value given in <code>controls</code> (or the default
+of the port), and it keeps the value set meanwhile for the next opens.
+A real port is mapped to the integer range 0 to resolution - 1, linearly
+or logarithmically following the port hints, an integer port directly to
+its range and a toggled port to a boolean element. An existing driver
+element is used with its own range. The elements changed (known from
+the control events) are read before each transfer.
+
 \code
 pcm.name {
         type ladspa             # ALSA<->LADSPA PCM
@@ -1683,6 +2910,8 @@ pcm.name {
                 pcm { }         # Slave PCM definition
         }
         [channels INT]		# count input channels (input to LADSPA plugin chain)
+	[threads INT]		# number of threads running the plugin instances
+				# (default 0 = run in the caller only)
 	[path STR]		# Path (directory) with LADSPA plugins
 	plugins |		# Definition for both directions
         playback_plugins |	# Definition for playback direction
@@ -1702,6 +2931,22 @@ pcm.name {
 					# or
 					STR INT or REAL	# STR - control port name, INT or REAL - control value
 				}
+				ctls {
+				        # valid only in the input block
+					I or STR STR	# I - control port index, STR - control port name,
+							# STR - element name
+					# or
+					I or STR {
+						name STR	# Element name
+						[index INT]	# Element index (default 0)
+						[iface STR]	# Element interface (default MIXER)
+						[card INT or STR] # Card (default the card of the slave)
+						[min REAL]	# Port value at the element minimum
+						[max REAL]	# Port value at the element maximum
+							# (default the bounds of the port)
+						[resolution INT] # Element steps of a real port (default 256)
+					}
+				}
 			}
 		}
 	}
@@ -1739,7 +2984,7 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_t *spcm;
 	snd_config_t *slave = NULL, *sconf;
 	const char *path = NULL;
-	long channels = 0;
+	long channels = 0, threads = 0;
 	snd_config_t *plugins = NULL, *pplugins = NULL, *cplugins = NULL;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1764,6 +3009,18 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
                                 channels = 0;
 			continue;
 		}
+		if (strcmp(id, "threads") == 0) {
+			err = snd_config_get_integer(n, &threads);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (threads < 0 || threads > 64) {
+				SNDERR("The field threads must be in range 0-64");
+				return -EINVAL;
+			}
+			continue;
+		}
 		if (strcmp(id, "plugins") == 0) {
 			plugins = n;
 			continue;
@@ -1801,6 +3058,10 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	err = snd_pcm_ladspa_open(pcmp, name, path, channels, pplugins, cplugins, spcm, 1);
 	if (err < 0)
 		snd_pcm_close(spcm);
+	else {
+		snd_pcm_ladspa_t *ladspa = (*pcmp)->private_data;
+		ladspa->threads = threads;
+	}
 	return err;
 }
 #ifndef DOC_HIDDEN
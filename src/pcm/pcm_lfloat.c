@@ -30,6 +30,16 @@
 #include "pcm_plugin.h"
 #include "plugin_ops.h"
 #include "bswap.h"
+#include <math.h>
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define LFLOAT_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define LFLOAT_SIMD_NEON
+#include <arm_neon.h>
+#endif
 
 #ifndef DOC_HIDDEN
 
@@ -50,6 +60,8 @@ typedef struct {
 	snd_pcm_plugin_t plug;
 	unsigned int int32_idx;
 	unsigned int float32_idx;
+	snd_pcm_linear_kernel_t kernel;
+	unsigned int src_width, dst_width;	/* physical widths for the kernel */
 	snd_pcm_format_t sformat;
 	void (*func)(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
@@ -182,6 +194,337 @@ void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_area
 	}
 }
 
+/*
+ * Kernels for the native S16/S32 <-> FLOAT conversions on packed sample
+ * arrays.  Integer to float is exact as in the generic code, float to
+ * integer rounds to nearest and saturates.
+ */
+typedef struct {
+	snd_pcm_linear_kernel_t s16_float;
+	snd_pcm_linear_kernel_t s32_float;
+	snd_pcm_linear_kernel_t float_s16;
+	snd_pcm_linear_kernel_t float_s32;
+} lfloat_kernels_t;
+
+static inline int16_t lfloat_to_s16(float f)
+{
+	float x = f * 32768.0f;
+
+	if (x > 32767.0f)
+		x = 32767.0f;
+	else if (x < -32768.0f)
+		x = -32768.0f;
+	return lrintf(x);
+}
+
+static inline int32_t lfloat_to_s32(float f)
+{
+	float x = f * 2147483648.0f;
+
+	if (x >= 2147483648.0f)
+		return 0x7fffffff;
+	if (x <= -2147483648.0f)
+		return (int32_t)0x80000000;
+	return lrintf(x);
+}
+
+static void s16_float_generic(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int16_t *s = src;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++)
+		d[i] = s[i] * (1.0f / 32768.0f);
+}
+
+static void s32_float_generic(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++)
+		d[i] = s[i] * (1.0f / 2147483648.0f);
+}
+
+static void float_s16_generic(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++)
+		d[i] = lfloat_to_s16(s[i]);
+}
+
+static void float_s32_generic(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++)
+		d[i] = lfloat_to_s32(s[i]);
+}
+
+static const lfloat_kernels_t lfloat_kernels_generic = {
+	s16_float_generic, s32_float_generic,
+	float_s16_generic, float_s32_generic
+};
+
+#ifdef LFLOAT_SIMD_X86
+__attribute__((target("sse2")))
+static void s16_float_sse2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int16_t *s = src;
+	float *d = dst;
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(d + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	s16_float_generic(d + i, s + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void s32_float_sse2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		_mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+	}
+	s32_float_generic(d + i, s + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void float_s16_sse2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	const __m128 max = _mm_set1_ps(32767.0f);
+	const __m128 min = _mm_set1_ps(-32768.0f);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(s + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(s + i + 4), scale);
+		a = _mm_max_ps(_mm_min_ps(a, max), min);
+		b = _mm_max_ps(_mm_min_ps(b, max), min);
+		_mm_storeu_si128((__m128i *)(d + i),
+				 _mm_packs_epi32(_mm_cvtps_epi32(a),
+						 _mm_cvtps_epi32(b)));
+	}
+	float_s16_generic(d + i, s + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void float_s32_sse2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	const __m128 scale = _mm_set1_ps(2147483648.0f);
+	const __m128i max = _mm_set1_epi32(0x7fffffff);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(s + i), scale);
+		/* the conversion returns 0x80000000 on overflow */
+		__m128i over = _mm_castps_si128(_mm_cmpge_ps(x, scale));
+		__m128i v = _mm_cvtps_epi32(x);
+		v = _mm_or_si128(_mm_andnot_si128(over, v), _mm_and_si128(over, max));
+		_mm_storeu_si128((__m128i *)(d + i), v);
+	}
+	float_s32_generic(d + i, s + i, samples - i);
+}
+
+static const lfloat_kernels_t lfloat_kernels_sse2 = {
+	s16_float_sse2, s32_float_sse2,
+	float_s16_sse2, float_s32_sse2
+};
+
+__attribute__((target("avx2")))
+static void s16_float_avx2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int16_t *s = src;
+	float *d = dst;
+	const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(s + i)));
+		_mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+	s16_float_generic(d + i, s + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void s32_float_avx2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+		_mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+	s32_float_generic(d + i, s + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void float_s16_avx2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	const __m256 scale = _mm256_set1_ps(32768.0f);
+	const __m256 max = _mm256_set1_ps(32767.0f);
+	const __m256 min = _mm256_set1_ps(-32768.0f);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 16 <= samples; i += 16) {
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(s + i), scale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(s + i + 8), scale);
+		__m256i v;
+		a = _mm256_max_ps(_mm256_min_ps(a, max), min);
+		b = _mm256_max_ps(_mm256_min_ps(b, max), min);
+		/* the pack works per 128-bit lane, restore the order */
+		v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+		v = _mm256_permute4x64_epi64(v, 0xd8);
+		_mm256_storeu_si256((__m256i *)(d + i), v);
+	}
+	float_s16_generic(d + i, s + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void float_s32_avx2(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	const __m256 scale = _mm256_set1_ps(2147483648.0f);
+	const __m256i max = _mm256_set1_epi32(0x7fffffff);
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(s + i), scale);
+		__m256i over = _mm256_castps_si256(_mm256_cmp_ps(x, scale, _CMP_GE_OQ));
+		__m256i v = _mm256_cvtps_epi32(x);
+		v = _mm256_blendv_epi8(v, max, over);
+		_mm256_storeu_si256((__m256i *)(d + i), v);
+	}
+	float_s32_generic(d + i, s + i, samples - i);
+}
+
+static const lfloat_kernels_t lfloat_kernels_avx2 = {
+	s16_float_avx2, s32_float_avx2,
+	float_s16_avx2, float_s32_avx2
+};
+#endif /* LFLOAT_SIMD_X86 */
+
+#ifdef LFLOAT_SIMD_NEON
+static void s16_float_neon(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int16_t *s = src;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		int16x8_t v = vld1q_s16(s + i);
+		vst1q_f32(d + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+					     1.0f / 32768.0f));
+		vst1q_f32(d + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),
+						 1.0f / 32768.0f));
+	}
+	s16_float_generic(d + i, s + i, samples - i);
+}
+
+static void s32_float_neon(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 4 <= samples; i += 4)
+		vst1q_f32(d + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(s + i)),
+					     1.0f / 2147483648.0f));
+	s32_float_generic(d + i, s + i, samples - i);
+}
+
+static void float_s16_neon(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		/* vcvtnq saturates, vqmovn narrows with saturation */
+		int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(s + i), 32768.0f));
+		int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(s + i + 4), 32768.0f));
+		vst1q_s16(d + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+	float_s16_generic(d + i, s + i, samples - i);
+}
+
+static void float_s32_neon(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i + 4 <= samples; i += 4)
+		vst1q_s32(d + i, vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(s + i),
+							    2147483648.0f)));
+	float_s32_generic(d + i, s + i, samples - i);
+}
+
+static const lfloat_kernels_t lfloat_kernels_neon = {
+	s16_float_neon, s32_float_neon,
+	float_s16_neon, float_s32_neon
+};
+#endif /* LFLOAT_SIMD_NEON */
+
+static const lfloat_kernels_t *lfloat_select_kernels(void)
+{
+#if defined(LFLOAT_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return &lfloat_kernels_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return &lfloat_kernels_sse2;
+#elif defined(LFLOAT_SIMD_NEON)
+	return &lfloat_kernels_neon;
+#endif
+	return &lfloat_kernels_generic;
+}
+
+static snd_pcm_linear_kernel_t lfloat_find_kernel(snd_pcm_format_t src_format,
+						  snd_pcm_format_t dst_format)
+{
+	const lfloat_kernels_t *k = lfloat_select_kernels();
+
+	if (src_format == SND_PCM_FORMAT_S16 && dst_format == SND_PCM_FORMAT_FLOAT)
+		return k->s16_float;
+	if (src_format == SND_PCM_FORMAT_S32 && dst_format == SND_PCM_FORMAT_FLOAT)
+		return k->s32_float;
+	if (src_format == SND_PCM_FORMAT_FLOAT && dst_format == SND_PCM_FORMAT_S16)
+		return k->float_s16;
+	if (src_format == SND_PCM_FORMAT_FLOAT && dst_format == SND_PCM_FORMAT_S32)
+		return k->float_s32;
+	return NULL;
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_lfloat_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
@@ -293,6 +636,9 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->kernel = lfloat_find_kernel(src_format, dst_format);
+	lfloat->src_width = snd_pcm_format_physical_width(src_format);
+	lfloat->dst_width = snd_pcm_format_physical_width(dst_format);
 	return 0;
 }
 
@@ -308,10 +654,17 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel &&
+	    snd_pcm_linear_kernel_convert(lfloat->kernel,
+					  slave_areas, slave_offset, lfloat->dst_width,
+					  areas, offset, lfloat->src_width,
+					  pcm->channels, size))
+		;
+	else
+		lfloat->func(slave_areas, slave_offset,
+			     areas, offset, 
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -328,10 +681,17 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel &&
+	    snd_pcm_linear_kernel_convert(lfloat->kernel,
+					  areas, offset, lfloat->dst_width,
+					  slave_areas, slave_offset, lfloat->src_width,
+					  pcm->channels, size))
+		;
+	else
+		lfloat->func(areas, offset, 
+			     slave_areas, slave_offset,
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -43,6 +43,8 @@ typedef struct {
 	unsigned int use_getput;
 	unsigned int conv_idx;
 	unsigned int get_idx, put_idx;
+	snd_pcm_linear_kernel_t kernel;
+	unsigned int src_width, dst_width;	/* physical widths for the kernel */
 	snd_pcm_format_t sformat;
 } snd_pcm_linear_t;
 #endif
@@ -213,6 +215,122 @@ void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufra
 	}
 }
 
+/*
+ * Specialized kernels for the most common conversions, working on
+ * packed sample arrays.  Each one is a simple loop which the compiler
+ * can vectorize; the results are identical to the label based
+ * conversions above.
+ */
+static void linear_s16_to_s32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int16_t *s = src;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++)
+		d[i] = (int32_t)((uint32_t)(uint16_t)s[i] << 16);
+}
+
+static void linear_s32_to_s16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int32_t *s = src;
+	int16_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++)
+		d[i] = (uint32_t)s[i] >> 16;
+}
+
+static void linear_s24_3le_to_s32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const uint8_t *s = src;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++, s += 3)
+		d[i] = (int32_t)((uint32_t)s[0] << 8 | (uint32_t)s[1] << 16 |
+				 (uint32_t)s[2] << 24);
+}
+
+static void linear_s32_to_s24_3le(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	const int32_t *s = src;
+	uint8_t *d = dst;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++, d += 3) {
+		uint32_t v = s[i];
+		d[0] = v >> 8;
+		d[1] = v >> 16;
+		d[2] = v >> 24;
+	}
+}
+
+static snd_pcm_linear_kernel_t linear_find_kernel(snd_pcm_format_t src_format,
+					  snd_pcm_format_t dst_format)
+{
+	if (src_format == SND_PCM_FORMAT_S16 && dst_format == SND_PCM_FORMAT_S32)
+		return linear_s16_to_s32;
+	if (src_format == SND_PCM_FORMAT_S32 && dst_format == SND_PCM_FORMAT_S16)
+		return linear_s32_to_s16;
+	if (src_format == SND_PCM_FORMAT_S24_3LE && dst_format == SND_PCM_FORMAT_S32)
+		return linear_s24_3le_to_s32;
+	if (src_format == SND_PCM_FORMAT_S32 && dst_format == SND_PCM_FORMAT_S24_3LE)
+		return linear_s32_to_s24_3le;
+	return NULL;
+}
+
+/* all channels interleaved in one buffer */
+static int linear_areas_interleaved(const snd_pcm_channel_area_t *areas,
+				    unsigned int channels, unsigned int width)
+{
+	unsigned int channel;
+
+	if (areas[0].first % 8)
+		return 0;
+	for (channel = 0; channel < channels; ++channel) {
+		if (areas[channel].addr != areas[0].addr ||
+		    areas[channel].first != areas[0].first + channel * width ||
+		    areas[channel].step != channels * width)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Run a kernel over interleaved areas at once or over each packed
+ * non-interleaved channel; returns 0 when the areas fit neither layout
+ * and the caller has to use the generic conversion.
+ */
+int snd_pcm_linear_kernel_convert(snd_pcm_linear_kernel_t kernel,
+				  const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				  unsigned int dst_width,
+				  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				  unsigned int src_width,
+				  unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+
+	if (linear_areas_interleaved(src_areas, channels, src_width) &&
+	    linear_areas_interleaved(dst_areas, channels, dst_width)) {
+		kernel(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+		       snd_pcm_channel_area_addr(src_areas, src_offset),
+		       frames * channels);
+		return 1;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		if (src_areas[channel].first % 8 || dst_areas[channel].first % 8 ||
+		    src_areas[channel].step != src_width ||
+		    dst_areas[channel].step != dst_width)
+			return 0;
+	}
+	for (channel = 0; channel < channels; ++channel)
+		kernel(snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset),
+		       snd_pcm_channel_area_addr(&src_areas[channel], src_offset),
+		       frames);
+	return 1;
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_linear_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
@@ -327,6 +445,15 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			linear->conv_idx = snd_pcm_linear_convert_index(linear->sformat,
 									format);
 	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		linear->kernel = linear_find_kernel(format, linear->sformat);
+		linear->src_width = snd_pcm_format_physical_width(format);
+		linear->dst_width = snd_pcm_format_physical_width(linear->sformat);
+	} else {
+		linear->kernel = linear_find_kernel(linear->sformat, format);
+		linear->src_width = snd_pcm_format_physical_width(linear->sformat);
+		linear->dst_width = snd_pcm_format_physical_width(format);
+	}
 	return 0;
 }
 
@@ -342,7 +469,13 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel &&
+	    snd_pcm_linear_kernel_convert(linear->kernel,
+					  slave_areas, slave_offset, linear->dst_width,
+					  areas, offset, linear->src_width,
+					  pcm->channels, size))
+		;
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(slave_areas, slave_offset,
 				      areas, offset, 
 				      pcm->channels, size,
@@ -367,7 +500,13 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel &&
+	    snd_pcm_linear_kernel_convert(linear->kernel,
+					  areas, offset, linear->dst_width,
+					  slave_areas, slave_offset, linear->src_width,
+					  pcm->channels, size))
+		;
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(areas, offset, 
 				      slave_areas, slave_offset,
 				      pcm->channels, size,
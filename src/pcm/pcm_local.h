@@ -113,12 +113,12 @@
 typedef struct _snd_pcm_rbptr {
 	snd_pcm_t *master;
 	volatile snd_pcm_uframes_t *ptr;
-	int fd;
 	off_t offset;
-	int link_dst_count;
 	snd_pcm_t **link_dst;
 	void *private_data;
 	void (*changed)(snd_pcm_t *pcm, snd_pcm_t *src);
+	int fd;
+	int link_dst_count;
 } snd_pcm_rbptr_t;
 
 typedef struct _snd_pcm_channel_info {
@@ -193,11 +193,13 @@ typedef struct {
 
 struct _snd_pcm {
 	void *open_func;
-	char *name;
+	int open_func_ref;		/* open_func holds a dlobj cache reference */
 	snd_pcm_type_t type;
+	char *name;
 	snd_pcm_stream_t stream;
 	int mode;
 	long minperiodtime;		/* in us */
+	snd_pcm_prefault_t prefault;	/* buffers touched at prepare */
 	int poll_fd_count;
 	int poll_fd;
 	unsigned short poll_events;
@@ -208,14 +210,16 @@ struct _snd_pcm {
 	snd_pcm_subformat_t subformat;	/* subformat */
 	unsigned int channels;		/* channels */
 	unsigned int rate;		/* rate in Hz */
-	snd_pcm_uframes_t period_size;
 	unsigned int period_time;	/* period duration */
+	snd_pcm_uframes_t period_size;
 	snd_interval_t periods;
 	snd_pcm_tstamp_t tstamp_mode;	/* timestamp mode */
 	snd_pcm_tstamp_type_t tstamp_type;	/* timestamp type */
 	unsigned int period_step;
 	snd_pcm_uframes_t avail_min;	/* min avail frames for wakeup */
 	int period_event;
+	int timer_wakeup;		/* snd_pcm_wait() sleeps on its own */
+	long long wakeup_margin;	/* learned timer wakeup margin in ns */
 	snd_pcm_uframes_t start_threshold;
 	snd_pcm_uframes_t stop_threshold;
 	snd_pcm_uframes_t silence_threshold;	/* Silence filling happens when
@@ -226,12 +230,12 @@ struct _snd_pcm {
 	unsigned int msbits;		/* used most significant bits */
 	unsigned int rate_num;		/* rate numerator */
 	unsigned int rate_den;		/* rate denominator */
-	unsigned int hw_flags;		/* actual hardware flags */
 	snd_pcm_uframes_t fifo_size;	/* chip FIFO size in frames */
 	snd_pcm_uframes_t buffer_size;
 	snd_interval_t buffer_time;
 	unsigned int sample_bits;
 	unsigned int frame_bits;
+	unsigned int hw_flags;		/* actual hardware flags */
 	snd_pcm_rbptr_t appl;
 	snd_pcm_rbptr_t hw;
 	snd_pcm_uframes_t min_align;
@@ -240,7 +244,11 @@ struct _snd_pcm {
 					 * use the mmaped buffer of the slave
 					 */
 	unsigned int donot_close: 1;	/* don't close this PCM */
+	unsigned int mmap_locked: 1;	/* the mmap buffer was mlocked */
 	unsigned int own_state_check:1; /* plugin has own PCM state check */
+	unsigned int pos_snapshot:1;	/* hw_ptr is held until the next wakeup,
+					 * see snd_pcm_wakeup_seq()
+					 */
 	snd_pcm_channel_info_t *mmap_channels;
 	snd_pcm_channel_area_t *running_areas;
 	snd_pcm_channel_area_t *stopped_areas;
@@ -250,6 +258,12 @@ struct _snd_pcm {
 	snd_pcm_t *fast_op_arg;
 	void *private_data;
 	struct list_head async_handlers;
+	struct snd_pcm_refine_cache *refine_cache;	/* memoized hw_refine results */
+	struct snd_pcm_setup_key *setup_key;	/* last hw_params, for a re-apply */
+	struct snd_pcm_arena *arena;	/* intermediate buffers shared with the
+					 * other plugins of the chain
+					 */
+	struct snd_pcm_profile *profile;	/* stage counters, $ALSA_PCM_PROFILE */
 #ifdef THREAD_SAFE_API
 	int need_lock;		/* true = this PCM (plugin) is thread-unsafe,
 				 * thus it needs a lock.
@@ -258,6 +272,21 @@ struct _snd_pcm {
 				 * it's set depending on $LIBASOUND_THREAD_SAFE.
 				 */
 	pthread_mutex_t lock;
+	struct snd_pcm_snapshot {	/* last locked state/avail/delay
+					 * results, read without the lock
+					 * when the PCM is busy (see pcm.c)
+					 */
+		unsigned int seq;	/* odd while being updated */
+		unsigned int valid;	/* SND_PCM_SNAP_* bits */
+		unsigned int epoch;	/* bumped by state changes, errors */
+		unsigned int state_epoch, avail_epoch, delay_epoch;
+		snd_pcm_uframes_t xfer;	/* frames moved by the application */
+		snd_pcm_uframes_t state_xfer, avail_xfer, delay_xfer;
+		long long state_nsec, avail_nsec, delay_nsec;
+		snd_pcm_state_t state;
+		int delay_running;
+		snd_pcm_sframes_t avail, delay;
+	} snap;
 #endif
 };
 
@@ -284,6 +313,10 @@ struct _snd_pcm {
 	snd1_pcm_open_named_slave
 #define snd_pcm_hw_open_fd \
 	snd1_pcm_hw_open_fd
+#define snd_pcm_hw_transfer_fd \
+	snd1_pcm_hw_transfer_fd
+#define snd_pcm_hw_status_fast \
+	snd1_pcm_hw_status_fast
 #define snd_pcm_wait_nocheck \
 	snd1_pcm_wait_nocheck
 #define snd_pcm_rate_get_default_converter \
@@ -324,8 +357,34 @@ struct _snd_pcm {
 	snd1_pcm_hw_refine_soft
 #define snd_pcm_hw_refine_slave \
 	snd1_pcm_hw_refine_slave
+#define snd_pcm_hw_refine_cache_free \
+	snd1_pcm_hw_refine_cache_free
+#define snd_pcm_arena_put \
+	snd1_pcm_arena_put
+#define snd_pcm_arena_prefault \
+	snd1_pcm_arena_prefault
+#define snd_pcm_mmap_prefault \
+	snd1_pcm_mmap_prefault
+#define snd_pcm_prefault_range \
+	snd1_pcm_prefault_range
+#define snd_pcm_profile_clock \
+	snd1_pcm_profile_clock
+#define snd_pcm_profile_account \
+	snd1_pcm_profile_account
+#define snd_pcm_profile_link \
+	snd1_pcm_profile_link
+#define snd_pcm_hw_refine_new_generation \
+	snd1_pcm_hw_refine_new_generation
+#define snd_pcm_wakeup_seq \
+	snd1_pcm_wakeup_seq
+#define snd_pcm_wakeup_new_seq \
+	snd1_pcm_wakeup_new_seq
 #define snd_pcm_hw_params_slave \
 	snd1_pcm_hw_params_slave
+#define snd_pcm_thread_conf_parse \
+	snd1_pcm_thread_conf_parse
+#define snd_pcm_thread_conf_apply \
+	snd1_pcm_thread_conf_apply
 #define snd_pcm_hw_param_refine_near \
 	snd1_pcm_hw_param_refine_near
 #define snd_pcm_hw_param_refine_multiple \
@@ -444,10 +503,21 @@ static inline snd_pcm_sframes_t __snd_pcm_avail_update(snd_pcm_t *pcm)
 	return pcm->fast_ops->avail_update(pcm->fast_op_arg);
 }
 
+/* discard the lockless snapshot before changing the PCM state */
+#ifdef THREAD_SAFE_API
+static inline void snd_pcm_snap_invalidate(snd_pcm_t *pcm)
+{
+	__atomic_add_fetch(&pcm->snap.epoch, 1, __ATOMIC_RELEASE);
+}
+#else
+#define snd_pcm_snap_invalidate(pcm)	do {} while (0)
+#endif
+
 static inline int __snd_pcm_start(snd_pcm_t *pcm)
 {
 	if (!pcm->fast_ops->start)
 		return -ENOSYS;
+	snd_pcm_snap_invalidate(pcm->fast_op_arg);
 	return pcm->fast_ops->start(pcm->fast_op_arg);
 }
 
@@ -710,6 +780,41 @@ static inline int muldiv_near(int a, int b, int c)
 }
 
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+void snd_pcm_hw_refine_cache_free(snd_pcm_t *pcm);
+void snd_pcm_arena_put(snd_pcm_t *pcm);
+int snd_pcm_arena_prefault(snd_pcm_t *pcm, int lock);
+int snd_pcm_mmap_prefault(snd_pcm_t *pcm, int lock);
+int snd_pcm_prefault_range(void *addr, size_t size, int lock, int own);
+
+/* per-stage transfer counters of a plugin chain, see snd_pcm_get_stage_stats() */
+struct snd_pcm_profile {
+	snd_pcm_t *slave;		/* next stage, set at hw_params */
+	unsigned long long calls;
+	unsigned long long frames;
+	unsigned long long nsec;
+	unsigned long long max_nsec;
+};
+
+unsigned long long snd_pcm_profile_clock(void);
+void snd_pcm_profile_account(struct snd_pcm_profile *prof,
+			     unsigned long long start, snd_pcm_uframes_t frames);
+void snd_pcm_profile_link(snd_pcm_t *pcm, snd_pcm_t *slave);
+
+/* time the processing of a stage itself, not the slave calls */
+static inline unsigned long long snd_pcm_profile_start(snd_pcm_t *pcm)
+{
+	return pcm->profile ? snd_pcm_profile_clock() : 0;
+}
+
+static inline void snd_pcm_profile_stop(snd_pcm_t *pcm, unsigned long long start,
+					snd_pcm_uframes_t frames)
+{
+	if (pcm->profile)
+		snd_pcm_profile_account(pcm->profile, start, frames);
+}
+void snd_pcm_hw_refine_new_generation(void);
+unsigned int snd_pcm_wakeup_seq(void);
+void snd_pcm_wakeup_new_seq(void);
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 #undef _snd_pcm_hw_params
 int snd_pcm_hw_refine_soft(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
@@ -739,6 +844,52 @@ int snd_pcm_hw_params_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 					   snd_pcm_hw_params_t *sparams));
 
 
+/*
+ * The parts of snd_pcm_hw_params_t the refine works on, without the
+ * reserved masks and intervals: less than half of the structure.  The
+ * copies kept during the refine (the saved state of a SND_TRY and the
+ * refine cache) use it.  There is no padding, so it can be hashed and
+ * compared as bytes.
+ */
+typedef struct {
+	snd_pcm_uframes_t fifo_size;
+	unsigned int flags;
+	snd_mask_t masks[SND_PCM_HW_PARAM_LAST_MASK - SND_PCM_HW_PARAM_FIRST_MASK + 1];
+	snd_interval_t intervals[SND_PCM_HW_PARAM_LAST_INTERVAL - SND_PCM_HW_PARAM_FIRST_INTERVAL + 1];
+	unsigned int rmask;
+	unsigned int cmask;
+	unsigned int info;
+	unsigned int msbits;
+	unsigned int rate_num;
+	unsigned int rate_den;
+	unsigned char sync[16];
+	unsigned int pad;
+} snd_pcm_hw_params_compact_t;
+
+static inline void snd_pcm_hw_params_pack(snd_pcm_hw_params_compact_t *dst,
+					  const snd_pcm_hw_params_t *src)
+{
+	dst->fifo_size = src->fifo_size;
+	dst->flags = src->flags;
+	memcpy(dst->masks, src->masks, sizeof(dst->masks));
+	memcpy(dst->intervals, src->intervals, sizeof(dst->intervals));
+	memcpy(&dst->rmask, &src->rmask, 6 * sizeof(unsigned int));
+	memcpy(dst->sync, src->sync, sizeof(dst->sync));
+	dst->pad = 0;
+}
+
+/* the reserved parts of dst are left as they are */
+static inline void snd_pcm_hw_params_unpack(snd_pcm_hw_params_t *dst,
+					    const snd_pcm_hw_params_compact_t *src)
+{
+	dst->fifo_size = src->fifo_size;
+	dst->flags = src->flags;
+	memcpy(dst->masks, src->masks, sizeof(src->masks));
+	memcpy(dst->intervals, src->intervals, sizeof(src->intervals));
+	memcpy(&dst->rmask, &src->rmask, 6 * sizeof(unsigned int));
+	memcpy(dst->sync, src->sync, sizeof(src->sync));
+}
+
 void _snd_pcm_hw_params_any(snd_pcm_hw_params_t *params);
 void _snd_pcm_hw_param_set_empty(snd_pcm_hw_params_t *params,
 				 snd_pcm_hw_param_t var);
@@ -1006,11 +1157,34 @@ snd_pcm_open_slave(snd_pcm_t **pcmp, snd_config_t *root,
 
 #define snd_pcm_conf_generic_id(id) _snd_conf_generic_id(id)
 
+/* scheduling of a helper thread of a plugin */
+#define SND_PCM_THREAD_MAX_CPUS		256
+
+typedef struct {
+	int policy;			/* -1 when inherited */
+	int priority;
+	int affinity;			/* the cpus are set */
+	unsigned char cpus[SND_PCM_THREAD_MAX_CPUS / 8];
+} snd_pcm_thread_conf_t;
+
+static inline void snd_pcm_thread_conf_init(snd_pcm_thread_conf_t *tc)
+{
+	memset(tc, 0, sizeof(*tc));
+	tc->policy = -1;
+}
+
+int snd_pcm_thread_conf_parse(snd_pcm_thread_conf_t *tc, snd_config_t *n,
+			      const char *id);
+void snd_pcm_thread_conf_apply(const snd_pcm_thread_conf_t *tc, const char *who);
+
 int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 		       int sync_ptr_ioctl);
 int __snd_pcm_mmap_emul_open(snd_pcm_t **pcmp, const char *name,
 			     snd_pcm_t *slave, int close_slave);
 
+int snd_pcm_hw_transfer_fd(snd_pcm_t *pcm);
+int snd_pcm_hw_status_fast(snd_pcm_t *pcm, snd_pcm_status_t *status);
+
 int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout);
 
 const snd_config_t *snd_pcm_rate_get_default_converter(snd_config_t *root);
@@ -1165,6 +1339,17 @@ static inline void sw_set_period_event(snd_pcm_sw_params_t *params, int val)
 	params->reserved[sizeof(params->reserved) / sizeof(params->reserved[0]) - 1] = val;
 }
 
+/* same for the timer_wakeup flag, kept in the previous byte */
+static inline int sw_get_timer_wakeup(const snd_pcm_sw_params_t *params)
+{
+	return params->reserved[sizeof(params->reserved) / sizeof(params->reserved[0]) - 2];
+}
+
+static inline void sw_set_timer_wakeup(snd_pcm_sw_params_t *params, int val)
+{
+	params->reserved[sizeof(params->reserved) / sizeof(params->reserved[0]) - 2] = val;
+}
+
 #define PCMINABORT(pcm) (((pcm)->mode & SND_PCM_ABORT) != 0)
 
 static inline snd_pcm_sframes_t pcm_frame_diff(snd_pcm_uframes_t ptr1,
@@ -1220,11 +1405,19 @@ static inline void snd_pcm_unlock(snd_pcm_t *pcm)
 	if (pcm->lock_enabled && pcm->need_lock)
 		pthread_mutex_unlock(&pcm->lock);
 }
+/* returns 0 when the lock is held by somebody else */
+static inline int snd_pcm_trylock(snd_pcm_t *pcm)
+{
+	if (pcm->lock_enabled && pcm->need_lock)
+		return !pthread_mutex_trylock(&pcm->lock);
+	return 1;
+}
 #else /* THREAD_SAFE_API */
 #define __snd_pcm_lock(pcm)		do {} while (0)
 #define __snd_pcm_unlock(pcm)		do {} while (0)
 #define snd_pcm_lock(pcm)		do {} while (0)
 #define snd_pcm_unlock(pcm)		do {} while (0)
+#define snd_pcm_trylock(pcm)		1
 #endif /* THREAD_SAFE_API */
 
 #endif /* __PCM_LOCAL_H */
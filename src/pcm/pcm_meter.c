@@ -31,6 +31,8 @@
 #include "pcm_plugin.h"
 #include "bswap.h"
 #include <time.h>
+#include <math.h>
+#include <sched.h>
 #include <pthread.h>
 #include <dlfcn.h>
 
@@ -38,6 +40,8 @@
 #define atomic_read(ptr)    __atomic_load_n(ptr, __ATOMIC_SEQ_CST )
 #define atomic_add(ptr, n)  __atomic_add_fetch(ptr, n, __ATOMIC_SEQ_CST)
 #define atomic_dec(ptr)     __atomic_sub_fetch(ptr, 1, __ATOMIC_SEQ_CST)
+#define atomic_load_acquire(ptr)	__atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define atomic_store_release(ptr, val)	__atomic_store_n(ptr, val, __ATOMIC_RELEASE)
 #endif
 
 #ifndef PIC
@@ -56,6 +60,14 @@ struct _snd_pcm_scope {
 	struct list_head list;
 };
 
+/*
+ * The meter ring is single producer, single consumer: only the application
+ * thread copies frames into it (at commit for playback, at avail_update for
+ * capture) and publishes its write position in rptr with a release store.
+ * rptr doubles as the sequence counter of the ring; the meter thread and
+ * the scopes load it with acquire semantics and never touch the ring
+ * beyond it, so the audio path never blocks on the scopes.
+ */
 typedef struct _snd_pcm_meter {
 	snd_pcm_generic_t gen;
 	snd_pcm_uframes_t rptr;
@@ -68,10 +80,10 @@ typedef struct _snd_pcm_meter {
 	int running;
 	int reset;
 	pthread_t thread;
-	pthread_mutex_t update_mutex;
 	pthread_mutex_t running_mutex;
 	pthread_cond_t running_cond;
 	struct timespec delay;
+	snd_pcm_thread_conf_t thread_conf;
 	void *dl_handle;
 } snd_pcm_meter_t;
 
@@ -109,12 +121,9 @@ static void snd_pcm_meter_update_main(snd_pcm_t *pcm)
 	snd_pcm_sframes_t frames;
 	snd_pcm_uframes_t rptr, old_rptr;
 	const snd_pcm_channel_area_t *areas;
-	int locked;
-	locked = (pthread_mutex_trylock(&meter->update_mutex) >= 0);
 	areas = snd_pcm_mmap_areas(pcm);
 	rptr = *pcm->hw.ptr;
 	old_rptr = meter->rptr;
-	meter->rptr = rptr;
 	frames = rptr - old_rptr;
 	if (frames < 0)
 		frames += pcm->boundary;
@@ -123,38 +132,16 @@ static void snd_pcm_meter_update_main(snd_pcm_t *pcm)
 		snd_pcm_meter_add_frames(pcm, areas, old_rptr,
 					 (snd_pcm_uframes_t) frames);
 	}
-	if (locked)
-		pthread_mutex_unlock(&meter->update_mutex);
+	atomic_store_release(&meter->rptr, rptr);
 }
 
-static int snd_pcm_meter_update_scope(snd_pcm_t *pcm)
+static int snd_pcm_meter_check_reset(snd_pcm_meter_t *meter)
 {
-	snd_pcm_meter_t *meter = pcm->private_data;
-	snd_pcm_sframes_t frames;
-	snd_pcm_uframes_t rptr, old_rptr;
-	const snd_pcm_channel_area_t *areas;
 	int reset = 0;
-	/* Wait main thread */
-	pthread_mutex_lock(&meter->update_mutex);
-	areas = snd_pcm_mmap_areas(pcm);
- _again:
-	rptr = *pcm->hw.ptr;
-	old_rptr = meter->rptr;
-	if (atomic_read(&meter->reset)) {
+	while (atomic_read(&meter->reset)) {
 		reset = 1;
 		atomic_dec(&meter->reset);
-		goto _again;
 	}
-	meter->rptr = rptr;
-	frames = rptr - old_rptr;
-	if (frames < 0)
-		frames += pcm->boundary;
-	if (frames > 0) {
-		assert((snd_pcm_uframes_t) frames <= pcm->buffer_size);
-		snd_pcm_meter_add_frames(pcm, areas, old_rptr,
-					 (snd_pcm_uframes_t) frames);
-	}
-	pthread_mutex_unlock(&meter->update_mutex);
 	return reset;
 }
 
@@ -192,6 +179,7 @@ static void *snd_pcm_meter_thread(void *data)
 	struct list_head *pos;
 	snd_pcm_scope_t *scope;
 	int reset;
+	snd_pcm_thread_conf_apply(&meter->thread_conf, "meter");
 	list_for_each(pos, &meter->scopes) {
 		scope = list_entry(pos, snd_pcm_scope_t, list);
 		snd_pcm_scope_enable(scope);
@@ -228,16 +216,13 @@ static void *snd_pcm_meter_thread(void *data)
 			if ((snd_pcm_uframes_t) now >= pcm->boundary)
 				now -= pcm->boundary;
 		}
-		meter->now = now;
+		reset = snd_pcm_meter_check_reset(meter);
+		/* capture frames are visible only once the application
+		 * thread has copied them into the ring
+		 */
 		if (pcm->stream == SND_PCM_STREAM_CAPTURE)
-			reset = snd_pcm_meter_update_scope(pcm);
-		else {
-			reset = 0;
-			while (atomic_read(&meter->reset)) {
-				reset = 1;
-				atomic_dec(&meter->reset);
-			}
-		}
+			now = atomic_load_acquire(&meter->rptr);
+		atomic_store_release(&meter->now, now);
 		if (reset) {
 			list_for_each(pos, &meter->scopes) {
 				scope = list_entry(pos, snd_pcm_scope_t, list);
@@ -274,7 +259,6 @@ static int snd_pcm_meter_close(snd_pcm_t *pcm)
 	snd_pcm_meter_t *meter = pcm->private_data;
 	struct list_head *pos, *npos;
 	int err = 0;
-	pthread_mutex_destroy(&meter->update_mutex);
 	pthread_mutex_destroy(&meter->running_mutex);
 	pthread_cond_destroy(&meter->running_cond);
 	if (meter->gen.close_slave)
@@ -298,9 +282,9 @@ static int snd_pcm_meter_prepare(snd_pcm_t *pcm)
 	err = snd_pcm_prepare(meter->gen.slave);
 	if (err >= 0) {
 		if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
-			meter->rptr = *pcm->appl.ptr;
+			atomic_store_release(&meter->rptr, *pcm->appl.ptr);
 		else
-			meter->rptr = *pcm->hw.ptr;
+			atomic_store_release(&meter->rptr, *pcm->hw.ptr);
 	}
 	return err;
 }
@@ -311,7 +295,7 @@ static int snd_pcm_meter_reset(snd_pcm_t *pcm)
 	int err = snd_pcm_reset(meter->gen.slave);
 	if (err >= 0) {
 		if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
-			meter->rptr = *pcm->appl.ptr;
+			atomic_store_release(&meter->rptr, *pcm->appl.ptr);
 	}
 	return err;
 }
@@ -333,7 +317,7 @@ static snd_pcm_sframes_t snd_pcm_meter_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_meter_t *meter = pcm->private_data;
 	snd_pcm_sframes_t err = snd_pcm_rewind(meter->gen.slave, frames);
 	if (err > 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK)
-		meter->rptr = *pcm->appl.ptr;
+		atomic_store_release(&meter->rptr, *pcm->appl.ptr);
 	return err;
 }
 
@@ -342,7 +326,7 @@ static snd_pcm_sframes_t snd_pcm_meter_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_meter_t *meter = pcm->private_data;
 	snd_pcm_sframes_t err = INTERNAL(snd_pcm_forward)(meter->gen.slave, frames);
 	if (err > 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK)
-		meter->rptr = *pcm->appl.ptr;
+		atomic_store_release(&meter->rptr, *pcm->appl.ptr);
 	return err;
 }
 
@@ -357,7 +341,7 @@ static snd_pcm_sframes_t snd_pcm_meter_mmap_commit(snd_pcm_t *pcm,
 		return result;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		snd_pcm_meter_add_frames(pcm, snd_pcm_mmap_areas(pcm), old_rptr, result);
-		meter->rptr = *pcm->appl.ptr;
+		atomic_store_release(&meter->rptr, *pcm->appl.ptr);
 	}
 	return result;
 }
@@ -425,7 +409,11 @@ static int snd_pcm_meter_hw_refine_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *pa
 static int snd_pcm_meter_hw_params_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
-	return _snd_pcm_hw_params_internal(meter->gen.slave, params);
+	int err = _snd_pcm_hw_params_internal(meter->gen.slave, params);
+
+	if (err >= 0)
+		snd_pcm_profile_link(pcm, meter->gen.slave);
+	return err;
 }
 
 static int snd_pcm_meter_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
@@ -580,6 +568,7 @@ int snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name, unsigned int frequenc
 	meter->gen.close_slave = close_slave;
 	meter->delay.tv_sec = 0;
 	meter->delay.tv_nsec = 1000000000 / frequency;
+	snd_pcm_thread_conf_init(&meter->thread_conf);
 	INIT_LIST_HEAD(&meter->scopes);
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_METER, name, slave->stream, slave->mode);
@@ -599,7 +588,6 @@ int snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name, unsigned int frequenc
 	snd_pcm_link_appl_ptr(pcm, slave);
 	*pcmp = pcm;
 
-	pthread_mutex_init(&meter->update_mutex, NULL);
 	pthread_mutex_init(&meter->running_mutex, NULL);
 	pthread_cond_init(&meter->running_cond, NULL);
 	return 0;
@@ -725,6 +713,11 @@ pcm.name {
                 pcm { }         # Slave PCM definition
         }
 	[frequency INT]		# Updates per second
+	[thread_policy STR]	# Scheduling of the scope thread: other, fifo or rr
+	[thread_priority INT]	# Priority for fifo and rr
+	[cpu_affinity INT]	# CPU of the scope thread
+	# or
+	[cpu_affinity STR]	# CPU list like "0,2-3"
 	scopes {
 		ID STR		# Scope name (see pcm_scope)
 		# or
@@ -733,6 +726,24 @@ pcm.name {
 }
 \endcode
 
+The application thread copies the frames into the meter buffer without
+taking any lock and the scopes run in a separate thread at the given
+frequency, reading only the frames published up to
+snd_pcm_meter_get_now().  The scope thread inherits the scheduling of the
+thread setting up the PCM, unless the thread_policy, thread_priority and
+cpu_affinity fields give it its own.
+
+Besides the scopes loaded from external libraries, the library provides
+the loudness scope (type loudness, see snd_pcm_scope_loudness_open()),
+which measures the peak and RMS levels and the EBU R128 loudness of the
+stream:
+
+\code
+pcm_scope.lufs {
+	type loudness
+}
+\endcode
+
 \subsection pcm_plugins_meter_funcref Function reference
 
 <UL>
@@ -765,6 +776,9 @@ int _snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_t *slave = NULL, *sconf;
 	long frequency = -1;
 	snd_config_t *scopes = NULL;
+	snd_pcm_thread_conf_t thread_conf;
+
+	snd_pcm_thread_conf_init(&thread_conf);
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -792,6 +806,11 @@ int _snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name,
 			scopes = n;
 			continue;
 		}
+		err = snd_pcm_thread_conf_parse(&thread_conf, n, id);
+		if (err < 0)
+			return err;
+		if (err > 0)
+			continue;
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -811,6 +830,7 @@ int _snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_close(spcm);
 		return err;
 	}
+	((snd_pcm_meter_t *)(*pcmp)->private_data)->thread_conf = thread_conf;
 	if (!scopes)
 		return 0;
 	snd_config_for_each(i, next, scopes) {
@@ -928,7 +948,7 @@ snd_pcm_uframes_t snd_pcm_meter_get_now(snd_pcm_t *pcm)
 	assert(pcm->type == SND_PCM_TYPE_METER);
 	meter = pcm->private_data;
 	assert(meter->gen.slave->setup);
-	return meter->now;
+	return atomic_load_acquire(&meter->now);
 }
 
 /**
@@ -1224,6 +1244,625 @@ int16_t *snd_pcm_scope_s16_get_channel_buffer(snd_pcm_scope_t *scope,
 	return s16->buf_areas[channel].addr;
 }
 
+#ifndef HAVE_SOFT_FLOAT
+#ifndef DOC_HIDDEN
+#define LOUDNESS_CHUNK		256
+#define LOUDNESS_HIST_MIN	-70.0
+#define LOUDNESS_HIST_STEP	0.1
+#define LOUDNESS_HIST_BINS	1000
+#define LOUDNESS_MOMENTARY	4	/* 100ms sub-blocks in 400ms */
+#define LOUDNESS_SHORT_TERM	30	/* 100ms sub-blocks in 3s */
+
+typedef struct {
+	double b0, b1, b2, a1, a2;
+} snd_pcm_loudness_biquad_t;
+
+typedef struct {
+	double z[2][2];		/* state of the two K-weighting stages */
+	double weight;		/* BS.1770 channel weight */
+	float peak;
+	double sum;		/* sum of squares for the current update */
+	double block;		/* K-weighted energy of the current sub-block */
+} snd_pcm_loudness_channel_t;
+
+typedef struct _snd_pcm_scope_loudness {
+	snd_pcm_t *pcm;
+	snd_pcm_uframes_t old;
+	unsigned int channels;
+	snd_pcm_format_t format;
+	snd_pcm_loudness_biquad_t stage[2];
+	snd_pcm_loudness_channel_t *chn;
+	float *scratch;
+	/* 100ms sub-blocks, the history covers the short-term window */
+	snd_pcm_uframes_t block_frames;
+	snd_pcm_uframes_t block_pos;
+	double history[LOUDNESS_SHORT_TERM];
+	unsigned int history_pos;
+	unsigned int history_len;
+	/* gating histogram of the 400ms blocks for the integrated loudness */
+	unsigned long long hist_count[LOUDNESS_HIST_BINS];
+	double hist_energy[LOUDNESS_HIST_BINS];
+	/* published snapshot, guarded by the sequence counter */
+	unsigned int seq;
+	double *peak;
+	double *rms;
+	double momentary;
+	double short_term;
+	double integrated;
+} snd_pcm_scope_loudness_t;
+
+static double loudness_lufs(double energy)
+{
+	if (energy <= 0)
+		return -INFINITY;
+	return -0.691 + 10 * log10(energy);
+}
+
+/* BS.1770 K-weighting: high shelf pre-filter followed by the RLB high-pass */
+static void loudness_setup_filter(snd_pcm_scope_loudness_t *loud,
+				  unsigned int rate)
+{
+	snd_pcm_loudness_biquad_t *f = loud->stage;
+	double k, q, vh, vb, a0;
+
+	k = tan(M_PI * 1681.974450955533 / rate);
+	q = 0.7071752369554196;
+	vh = pow(10.0, 3.999843853973347 / 20);
+	vb = pow(vh, 0.4996667741545416);
+	a0 = 1 + k / q + k * k;
+	f[0].b0 = (vh + vb * k / q + k * k) / a0;
+	f[0].b1 = 2 * (k * k - vh) / a0;
+	f[0].b2 = (vh - vb * k / q + k * k) / a0;
+	f[0].a1 = 2 * (k * k - 1) / a0;
+	f[0].a2 = (1 - k / q + k * k) / a0;
+
+	k = tan(M_PI * 38.13547087602444 / rate);
+	q = 0.5003270373238773;
+	a0 = 1 + k / q + k * k;
+	f[1].b0 = 1;
+	f[1].b1 = -2;
+	f[1].b2 = 1;
+	f[1].a1 = 2 * (k * k - 1) / a0;
+	f[1].a2 = (1 - k / q + k * k) / a0;
+}
+
+static void loudness_setup_weights(snd_pcm_scope_loudness_t *loud,
+				   snd_pcm_t *spcm)
+{
+	snd_pcm_chmap_t *map = snd_pcm_get_chmap(spcm);
+	unsigned int c;
+
+	for (c = 0; c < loud->channels; c++)
+		loud->chn[c].weight = 1.0;
+	if (!map)
+		return;
+	for (c = 0; c < loud->channels && c < map->channels; c++) {
+		switch (map->pos[c]) {
+		case SND_CHMAP_LFE:
+			loud->chn[c].weight = 0;
+			break;
+		case SND_CHMAP_RL:
+		case SND_CHMAP_RR:
+		case SND_CHMAP_SL:
+		case SND_CHMAP_SR:
+			loud->chn[c].weight = 1.41;
+			break;
+		default:
+			break;
+		}
+	}
+	free(map);
+}
+
+static int loudness_enable(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_loudness_t *loud = scope->private_data;
+	snd_pcm_meter_t *meter = loud->pcm->private_data;
+	snd_pcm_t *spcm = meter->gen.slave;
+
+	switch (spcm->format) {
+	case SND_PCM_FORMAT_S16:
+	case SND_PCM_FORMAT_S24:
+	case SND_PCM_FORMAT_S32:
+	case SND_PCM_FORMAT_FLOAT:
+	case SND_PCM_FORMAT_FLOAT64:
+		break;
+	default:
+		return -EINVAL;
+	}
+	loud->format = spcm->format;
+	loud->channels = spcm->channels;
+	loud->chn = calloc(loud->channels, sizeof(*loud->chn));
+	loud->peak = calloc(loud->channels, sizeof(*loud->peak));
+	loud->rms = calloc(loud->channels, sizeof(*loud->rms));
+	loud->scratch = malloc(LOUDNESS_CHUNK * sizeof(*loud->scratch));
+	if (!loud->chn || !loud->peak || !loud->rms || !loud->scratch) {
+		free(loud->chn);
+		free(loud->peak);
+		free(loud->rms);
+		free(loud->scratch);
+		loud->chn = NULL;
+		loud->peak = loud->rms = NULL;
+		loud->scratch = NULL;
+		return -ENOMEM;
+	}
+	loudness_setup_filter(loud, spcm->rate);
+	loudness_setup_weights(loud, spcm);
+	loud->block_frames = spcm->rate / 10;
+	if (!loud->block_frames)
+		loud->block_frames = 1;
+	return 0;
+}
+
+static void loudness_disable(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_loudness_t *loud = scope->private_data;
+	free(loud->chn);
+	loud->chn = NULL;
+	free(loud->peak);
+	loud->peak = NULL;
+	free(loud->rms);
+	loud->rms = NULL;
+	free(loud->scratch);
+	loud->scratch = NULL;
+}
+
+static void loudness_close(snd_pcm_scope_t *scope)
+{
+	free(scope->private_data);
+}
+
+static void loudness_start(snd_pcm_scope_t *scope ATTRIBUTE_UNUSED)
+{
+}
+
+static void loudness_stop(snd_pcm_scope_t *scope ATTRIBUTE_UNUSED)
+{
+}
+
+/* convert a contiguous run of native samples to float in [-1, 1) */
+static void loudness_load(float *dst, const void *src, snd_pcm_format_t format,
+			  unsigned int n)
+{
+	unsigned int i;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16: {
+		const int16_t *s = src;
+		for (i = 0; i < n; i++)
+			dst[i] = s[i] * (1.0f / 32768);
+		break;
+	}
+	case SND_PCM_FORMAT_S24: {
+		const int32_t *s = src;
+		for (i = 0; i < n; i++)
+			dst[i] = ((int32_t)((uint32_t)s[i] << 8) >> 8) * (1.0f / 8388608);
+		break;
+	}
+	case SND_PCM_FORMAT_S32: {
+		const int32_t *s = src;
+		for (i = 0; i < n; i++)
+			dst[i] = s[i] * (1.0f / 2147483648.0f);
+		break;
+	}
+	case SND_PCM_FORMAT_FLOAT:
+		memcpy(dst, src, n * sizeof(*dst));
+		break;
+	default: {
+		const double *s = src;
+		for (i = 0; i < n; i++)
+			dst[i] = s[i];
+		break;
+	}
+	}
+}
+
+/*
+ * Peak and sum of squares over the scratch buffer.  Kept branch free with
+ * several independent accumulators so that the compiler can vectorize it.
+ */
+static void loudness_accumulate(snd_pcm_loudness_channel_t *chn,
+				const float *x, unsigned int n)
+{
+	float peak[4] = { 0 }, sum[4] = { 0 };
+	unsigned int i, j;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		for (j = 0; j < 4; j++) {
+			float v = fabsf(x[i + j]);
+			peak[j] = v > peak[j] ? v : peak[j];
+			sum[j] += x[i + j] * x[i + j];
+		}
+	}
+	for (; i < n; i++) {
+		float v = fabsf(x[i]);
+		peak[0] = v > peak[0] ? v : peak[0];
+		sum[0] += x[i] * x[i];
+	}
+	for (j = 0; j < 4; j++) {
+		if (peak[j] > chn->peak)
+			chn->peak = peak[j];
+		chn->sum += sum[j];
+	}
+}
+
+static double loudness_kweight(const snd_pcm_loudness_biquad_t *f,
+			       snd_pcm_loudness_channel_t *chn,
+			       const float *x, unsigned int n)
+{
+	double z00 = chn->z[0][0], z01 = chn->z[0][1];
+	double z10 = chn->z[1][0], z11 = chn->z[1][1];
+	double energy = 0;
+	unsigned int i;
+
+	/* transposed direct form II */
+	for (i = 0; i < n; i++) {
+		double y = f[0].b0 * x[i] + z00;
+		double w;
+		z00 = f[0].b1 * x[i] - f[0].a1 * y + z01;
+		z01 = f[0].b2 * x[i] - f[0].a2 * y;
+		w = f[1].b0 * y + z10;
+		z10 = f[1].b1 * y - f[1].a1 * w + z11;
+		z11 = f[1].b2 * y - f[1].a2 * w;
+		energy += w * w;
+	}
+	chn->z[0][0] = z00;
+	chn->z[0][1] = z01;
+	chn->z[1][0] = z10;
+	chn->z[1][1] = z11;
+	return energy;
+}
+
+static double loudness_window(snd_pcm_scope_loudness_t *loud, unsigned int len)
+{
+	unsigned int i, pos = loud->history_pos;
+	double energy = 0;
+
+	if (loud->history_len < len)
+		return 0;
+	for (i = 0; i < len; i++) {
+		pos = (pos + LOUDNESS_SHORT_TERM - 1) % LOUDNESS_SHORT_TERM;
+		energy += loud->history[pos];
+	}
+	return energy / len;
+}
+
+static double loudness_integrated(snd_pcm_scope_loudness_t *loud)
+{
+	unsigned long long count = 0;
+	double energy = 0, gate;
+	int i, first;
+
+	/* absolute gate: the histogram starts at -70 LUFS */
+	for (i = 0; i < LOUDNESS_HIST_BINS; i++) {
+		count += loud->hist_count[i];
+		energy += loud->hist_energy[i];
+	}
+	if (!count)
+		return -INFINITY;
+	/* relative gate 10 LU below the absolutely gated loudness */
+	gate = loudness_lufs(energy / count) - 10;
+	first = (int)ceil((gate - LOUDNESS_HIST_MIN) / LOUDNESS_HIST_STEP);
+	if (first < 0)
+		first = 0;
+	count = 0;
+	energy = 0;
+	for (i = first; i < LOUDNESS_HIST_BINS; i++) {
+		count += loud->hist_count[i];
+		energy += loud->hist_energy[i];
+	}
+	return count ? loudness_lufs(energy / count) : -INFINITY;
+}
+
+/* a 100ms sub-block is complete */
+static void loudness_block_done(snd_pcm_scope_loudness_t *loud)
+{
+	double energy = 0, lufs;
+	unsigned int c;
+	int bin;
+
+	for (c = 0; c < loud->channels; c++) {
+		energy += loud->chn[c].weight * loud->chn[c].block;
+		loud->chn[c].block = 0;
+	}
+	loud->history[loud->history_pos] = energy / loud->block_frames;
+	loud->history_pos = (loud->history_pos + 1) % LOUDNESS_SHORT_TERM;
+	if (loud->history_len < LOUDNESS_SHORT_TERM)
+		loud->history_len++;
+	loud->block_pos = 0;
+
+	/* gating blocks are 400ms long with 75% overlap */
+	energy = loudness_window(loud, LOUDNESS_MOMENTARY);
+	if (energy <= 0)
+		return;
+	lufs = loudness_lufs(energy);
+	bin = (int)((lufs - LOUDNESS_HIST_MIN) / LOUDNESS_HIST_STEP);
+	if (bin < 0)
+		return;
+	if (bin >= LOUDNESS_HIST_BINS)
+		bin = LOUDNESS_HIST_BINS - 1;
+	loud->hist_count[bin]++;
+	loud->hist_energy[bin] += energy;
+}
+
+static void loudness_publish(snd_pcm_scope_loudness_t *loud,
+			     snd_pcm_uframes_t frames)
+{
+	unsigned int c;
+
+	atomic_store_release(&loud->seq, loud->seq + 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	for (c = 0; c < loud->channels; c++) {
+		snd_pcm_loudness_channel_t *chn = &loud->chn[c];
+		loud->peak[c] = chn->peak;
+		loud->rms[c] = frames ? sqrt(chn->sum / frames) : 0;
+		chn->peak = 0;
+		chn->sum = 0;
+	}
+	loud->momentary = loudness_lufs(loudness_window(loud, LOUDNESS_MOMENTARY));
+	loud->short_term = loudness_lufs(loudness_window(loud, LOUDNESS_SHORT_TERM));
+	loud->integrated = loudness_integrated(loud);
+	atomic_store_release(&loud->seq, loud->seq + 1);
+}
+
+static void loudness_update(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_loudness_t *loud = scope->private_data;
+	snd_pcm_meter_t *meter = loud->pcm->private_data;
+	snd_pcm_t *spcm = meter->gen.slave;
+	snd_pcm_uframes_t now = atomic_load_acquire(&meter->now);
+	snd_pcm_sframes_t size, total;
+	snd_pcm_uframes_t offset;
+	unsigned int c;
+
+	size = now - loud->old;
+	if (size < 0)
+		size += spcm->boundary;
+	if (size > (snd_pcm_sframes_t)loud->pcm->buffer_size)
+		size = loud->pcm->buffer_size;
+	if (!size)
+		return;
+	total = size;
+	offset = loud->old % meter->buf_size;
+	while (size > 0) {
+		snd_pcm_uframes_t frames = size;
+		snd_pcm_uframes_t cont = meter->buf_size - offset;
+		if (frames > cont)
+			frames = cont;
+		if (frames > LOUDNESS_CHUNK)
+			frames = LOUDNESS_CHUNK;
+		if (frames > loud->block_frames - loud->block_pos)
+			frames = loud->block_frames - loud->block_pos;
+		for (c = 0; c < loud->channels; c++) {
+			const snd_pcm_channel_area_t *a = &meter->buf_areas[c];
+			snd_pcm_loudness_channel_t *chn = &loud->chn[c];
+			loudness_load(loud->scratch,
+				      snd_pcm_channel_area_addr(a, offset),
+				      loud->format, frames);
+			loudness_accumulate(chn, loud->scratch, frames);
+			if (chn->weight > 0)
+				chn->block += loudness_kweight(loud->stage, chn,
+							       loud->scratch,
+							       frames);
+		}
+		loud->block_pos += frames;
+		if (loud->block_pos == loud->block_frames)
+			loudness_block_done(loud);
+		offset += frames;
+		if (offset == meter->buf_size)
+			offset = 0;
+		size -= frames;
+	}
+	loud->old = now;
+	loudness_publish(loud, total);
+}
+
+static void loudness_reset(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_loudness_t *loud = scope->private_data;
+	snd_pcm_meter_t *meter = loud->pcm->private_data;
+	unsigned int c;
+
+	loud->old = atomic_load_acquire(&meter->now);
+	for (c = 0; c < loud->channels; c++) {
+		double weight = loud->chn[c].weight;
+		memset(&loud->chn[c], 0, sizeof(loud->chn[c]));
+		loud->chn[c].weight = weight;
+	}
+	loud->block_pos = 0;
+	loud->history_pos = 0;
+	loud->history_len = 0;
+	memset(loud->hist_count, 0, sizeof(loud->hist_count));
+	memset(loud->hist_energy, 0, sizeof(loud->hist_energy));
+	loudness_publish(loud, 0);
+}
+
+static const snd_pcm_scope_ops_t loudness_ops = {
+	.enable = loudness_enable,
+	.disable = loudness_disable,
+	.close = loudness_close,
+	.start = loudness_start,
+	.stop = loudness_stop,
+	.update = loudness_update,
+	.reset = loudness_reset,
+};
+
+/* take a consistent copy of the published values */
+static int loudness_snapshot(snd_pcm_scope_t *scope, unsigned int channel,
+			     double *peak, double *rms, double lufs[3])
+{
+	snd_pcm_scope_loudness_t *loud;
+	unsigned int seq;
+
+	assert(scope->ops == &loudness_ops);
+	loud = scope->private_data;
+	if (!scope->enabled || !loud->peak)
+		return -EBADFD;
+	if (peak && channel >= loud->channels)
+		return -EINVAL;
+	do {
+		while ((seq = atomic_load_acquire(&loud->seq)) & 1)
+			sched_yield();
+		if (peak) {
+			*peak = loud->peak[channel];
+			*rms = loud->rms[channel];
+		} else {
+			lufs[0] = loud->momentary;
+			lufs[1] = loud->short_term;
+			lufs[2] = loud->integrated;
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (atomic_load_acquire(&loud->seq) != seq);
+	return 0;
+}
+#endif
+
+/**
+ * \brief Add a loudness scope to a #SND_PCM_TYPE_METER PCM
+ * \param pcm The pcm handle
+ * \param name Scope name
+ * \param scopep Pointer to newly created and added scope
+ * \return 0 on success otherwise a negative error code
+ *
+ * The loudness scope computes the per channel peak and RMS levels and
+ * the EBU R128 momentary, short-term and integrated loudness straight
+ * from the meter buffer in the native S16, S24, S32, FLOAT or FLOAT64
+ * format of the slave.  The scope is not enabled for other formats.
+ * The values are refreshed at the meter frequency and can be read from
+ * any thread with #snd_pcm_scope_loudness_get_levels and
+ * #snd_pcm_scope_loudness_get_lufs.  A build without floating point
+ * returns -EINVAL.
+ */
+int snd_pcm_scope_loudness_open(snd_pcm_t *pcm, const char *name,
+				snd_pcm_scope_t **scopep)
+{
+	snd_pcm_meter_t *meter;
+	snd_pcm_scope_t *scope;
+	snd_pcm_scope_loudness_t *loud;
+	assert(pcm->type == SND_PCM_TYPE_METER);
+	meter = pcm->private_data;
+	scope = calloc(1, sizeof(*scope));
+	if (!scope)
+		return -ENOMEM;
+	loud = calloc(1, sizeof(*loud));
+	if (!loud) {
+		free(scope);
+		return -ENOMEM;
+	}
+	if (name)
+		scope->name = strdup(name);
+	loud->pcm = pcm;
+	loud->momentary = loud->short_term = loud->integrated = -INFINITY;
+	scope->ops = &loudness_ops;
+	scope->private_data = loud;
+	list_add_tail(&scope->list, &meter->scopes);
+	*scopep = scope;
+	return 0;
+}
+
+/**
+ * \brief Get the last peak and RMS levels of a channel from a loudness scope
+ * \param scope loudness scope handle
+ * \param channel Channel
+ * \param peak Returns the peak level (linear, 1.0 is full scale)
+ * \param rms Returns the RMS level (linear, 1.0 is full scale)
+ * \return 0 on success otherwise a negative error code
+ *
+ * The levels cover the frames processed during the last meter update.
+ */
+int snd_pcm_scope_loudness_get_levels(snd_pcm_scope_t *scope,
+				      unsigned int channel,
+				      double *peak, double *rms)
+{
+	assert(peak && rms);
+	return loudness_snapshot(scope, channel, peak, rms, NULL);
+}
+
+/**
+ * \brief Get the EBU R128 loudness values from a loudness scope
+ * \param scope loudness scope handle
+ * \param momentary Returns the momentary (400ms) loudness in LUFS
+ * \param short_term Returns the short-term (3s) loudness in LUFS
+ * \param integrated Returns the gated integrated loudness in LUFS
+ * \return 0 on success otherwise a negative error code
+ *
+ * Any of the pointers may be NULL.  A value is -INFINITY until enough
+ * frames have been measured.  The integrated loudness restarts when
+ * the PCM is prepared again.
+ */
+int snd_pcm_scope_loudness_get_lufs(snd_pcm_scope_t *scope,
+				    double *momentary, double *short_term,
+				    double *integrated)
+{
+	double lufs[3];
+	int err = loudness_snapshot(scope, 0, NULL, NULL, lufs);
+	if (err < 0)
+		return err;
+	if (momentary)
+		*momentary = lufs[0];
+	if (short_term)
+		*short_term = lufs[1];
+	if (integrated)
+		*integrated = lufs[2];
+	return 0;
+}
+
+int _snd_pcm_scope_loudness_open(snd_pcm_t *pcm, const char *name,
+				 snd_config_t *root ATTRIBUTE_UNUSED,
+				 snd_config_t *conf)
+{
+	snd_config_iterator_t i, next;
+	snd_pcm_scope_t *scope;
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "comment") == 0)
+			continue;
+		if (strcmp(id, "type") == 0)
+			continue;
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	return snd_pcm_scope_loudness_open(pcm, name, &scope);
+}
+#else /* HAVE_SOFT_FLOAT */
+
+/* the loudness is measured in floating point only */
+int snd_pcm_scope_loudness_open(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				const char *name ATTRIBUTE_UNUSED,
+				snd_pcm_scope_t **scopep ATTRIBUTE_UNUSED)
+{
+	return -EINVAL;
+}
+
+int snd_pcm_scope_loudness_get_levels(snd_pcm_scope_t *scope ATTRIBUTE_UNUSED,
+				      unsigned int channel ATTRIBUTE_UNUSED,
+				      double *peak ATTRIBUTE_UNUSED,
+				      double *rms ATTRIBUTE_UNUSED)
+{
+	return -EINVAL;
+}
+
+int snd_pcm_scope_loudness_get_lufs(snd_pcm_scope_t *scope ATTRIBUTE_UNUSED,
+				    double *momentary ATTRIBUTE_UNUSED,
+				    double *short_term ATTRIBUTE_UNUSED,
+				    double *integrated ATTRIBUTE_UNUSED)
+{
+	return -EINVAL;
+}
+
+int _snd_pcm_scope_loudness_open(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				 const char *name ATTRIBUTE_UNUSED,
+				 snd_config_t *root ATTRIBUTE_UNUSED,
+				 snd_config_t *conf ATTRIBUTE_UNUSED)
+{
+	SNDERR("The loudness scope is not available without floating point");
+	return -EINVAL;
+}
+#endif /* HAVE_SOFT_FLOAT */
+
 /**
  * \brief allocate an invalid #snd_pcm_scope_t using standard malloc
  * \param ptr returned pointer
@@ -278,22 +278,18 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 		return err;
 	if (pcm->mmap_shadow)
 		return 0;
-	pcm->mmap_channels = calloc(pcm->channels, sizeof(pcm->mmap_channels[0]));
+	/* the running areas follow the channel infos in the same block */
+	pcm->mmap_channels = calloc(pcm->channels, sizeof(pcm->mmap_channels[0]) +
+				    sizeof(pcm->running_areas[0]));
 	if (!pcm->mmap_channels)
 		return -ENOMEM;
-	pcm->running_areas = calloc(pcm->channels, sizeof(pcm->running_areas[0]));
-	if (!pcm->running_areas) {
-		free(pcm->mmap_channels);
-		pcm->mmap_channels = NULL;
-		return -ENOMEM;
-	}
+	pcm->running_areas = (snd_pcm_channel_area_t *)(pcm->mmap_channels + pcm->channels);
 	for (c = 0; c < pcm->channels; ++c) {
 		snd_pcm_channel_info_t *i = &pcm->mmap_channels[c];
 		i->channel = c;
 		err = snd_pcm_channel_info(pcm, i);
 		if (err < 0) {
 			free(pcm->mmap_channels);
-			free(pcm->running_areas);
 			pcm->mmap_channels = NULL;
 			pcm->running_areas = NULL;
 			return err;
@@ -349,6 +345,24 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 			break;
 		case SND_PCM_AREA_SHM:
 #ifdef HAVE_SYS_SHM_H
+			if (i->u.shm.shmid < 0 && !i->u.shm.area) {
+				/* a private memfd, without the SHM limits */
+				i->u.shm.area = snd_shm_area_create_memfd(size, (void **)&ptr);
+				if (i->u.shm.area) {
+					if (pcm->access == SND_PCM_ACCESS_MMAP_INTERLEAVED ||
+					    pcm->access == SND_PCM_ACCESS_RW_INTERLEAVED) {
+						unsigned int c1;
+						for (c1 = c + 1; c1 < pcm->channels; c1++) {
+							snd_pcm_channel_info_t *i1 = &pcm->mmap_channels[c1];
+							if (i1->type == SND_PCM_AREA_SHM &&
+							    i1->u.shm.shmid < 0 && !i1->u.shm.area)
+								i1->u.shm.area = snd_shm_area_share(i->u.shm.area);
+						}
+					}
+					i->addr = ptr;
+					break;
+				}
+			}
 			if (i->u.shm.shmid < 0) {
 				int id;
 				/* FIXME: safer permission? */
@@ -504,6 +518,9 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
+			/* the heap pages stay locked after free() */
+			if (pcm->mmap_locked)
+				munlock(i->addr, size);
 			free(i->addr);
 			break;
 		default:
@@ -511,6 +528,7 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 		}
 		i->addr = NULL;
 	}
+	pcm->mmap_locked = 0;
 	if (pcm->ops->munmap)
 		err = pcm->ops->munmap(pcm);
 	else
@@ -518,12 +536,93 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 	if (err < 0)
 		return err;
 	free(pcm->mmap_channels);
-	free(pcm->running_areas);
 	pcm->mmap_channels = NULL;
 	pcm->running_areas = NULL;
 	return 0;
 }
 
+/*
+ * fault in the pages of a buffer and optionally lock them
+ *
+ * The contents are preserved.  The pages of a buffer owned by the caller
+ * are written to, so that the private mappings get their own copy instead
+ * of the shared zero page; the other buffers may be used by another
+ * process or by the hardware at the same time, they are only read.
+ * Returns a negative error code when the pages could not be locked, they
+ * are faulted in nevertheless.
+ */
+int snd_pcm_prefault_range(void *addr, size_t size, int lock, int own)
+{
+	volatile char *p = addr;
+	size_t psz = page_size();
+	size_t ofs, start;
+	char c;
+	int err = 0;
+
+	if (!size)
+		return 0;
+	if (lock) {
+		if (mlock(addr, size) == 0)
+			return 0;
+		err = -errno;
+	}
+	start = (size_t)addr & ~(psz - 1);
+#ifdef MADV_POPULATE_WRITE
+	/* device mappings refuse it, they are touched below */
+	if (madvise((void *)start, (size_t)addr + size - start,
+		    MADV_POPULATE_WRITE) == 0)
+		return err;
+#endif
+	/* stay inside the buffer, the rest of the first page is not ours */
+	ofs = 0;
+	while (ofs < size) {
+		c = p[ofs];
+		if (own)
+			p[ofs] = c;
+		ofs = start + psz - (size_t)addr;
+		start += psz;
+	}
+	return err;
+}
+
+/* fault in (and lock) the buffer allocated by snd_pcm_mmap() */
+int snd_pcm_mmap_prefault(snd_pcm_t *pcm, int lock)
+{
+	unsigned int c, c1;
+	size_t size, s;
+	int err, res = 0;
+
+	if (pcm->mmap_shadow || !pcm->mmap_channels)
+		return 0;
+	for (c = 0; c < pcm->channels; ++c) {
+		snd_pcm_channel_info_t *i = &pcm->mmap_channels[c];
+
+		if (!i->addr)
+			continue;
+		for (c1 = 0; c1 < c; ++c1)
+			if (pcm->mmap_channels[c1].addr == i->addr)
+				break;
+		if (c1 < c)
+			continue;
+		size = i->first + i->step * (pcm->buffer_size - 1) + pcm->sample_bits;
+		for (c1 = c + 1; c1 < pcm->channels; ++c1) {
+			snd_pcm_channel_info_t *i1 = &pcm->mmap_channels[c1];
+			if (i1->addr != i->addr)
+				continue;
+			s = i1->first + i1->step * (pcm->buffer_size - 1) + pcm->sample_bits;
+			if (s > size)
+				size = s;
+		}
+		err = snd_pcm_prefault_range(i->addr, (size + 7) / 8, lock,
+					     i->type == SND_PCM_AREA_LOCAL);
+		if (err < 0)
+			res = err;
+		else if (lock)
+			pcm->mmap_locked = 1;
+	}
+	return res;
+}
+
 /* called in pcm lock */
 snd_pcm_sframes_t snd_pcm_write_mmap(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
 				     snd_pcm_uframes_t size)
@@ -163,6 +163,7 @@ static int snd_pcm_mmap_emul_hw_params(snd_pcm_t *pcm,
 	err = _snd_pcm_hw_params_internal(map->gen.slave, params);
 	if (err >= 0) {
 		map->mmap_emul = 0;
+		snd_pcm_profile_link(pcm, map->gen.slave);
 		return err;
 	}
 
@@ -199,6 +200,7 @@ static int snd_pcm_mmap_emul_hw_params(snd_pcm_t *pcm,
 	map->hw_ptr = 0;
 	snd_pcm_set_hw_ptr(pcm, &map->hw_ptr, -1, 0);
 	snd_pcm_set_appl_ptr(pcm, &map->appl_ptr, -1, 0);
+	snd_pcm_profile_link(pcm, map->gen.slave);
 	return 0;
 
  _err:
@@ -251,24 +253,6 @@ static int snd_pcm_mmap_emul_reset(snd_pcm_t *pcm)
 	return err;
 }
 
-static snd_pcm_sframes_t
-snd_pcm_mmap_emul_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
-{
-	frames = snd_pcm_generic_rewind(pcm, frames);
-	if (frames > 0)
-		snd_pcm_mmap_appl_backward(pcm, frames);
-	return frames;
-}
-
-static snd_pcm_sframes_t
-snd_pcm_mmap_emul_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
-{
-	frames = snd_pcm_generic_forward(pcm, frames);
-	if (frames > 0)
-		snd_pcm_mmap_appl_forward(pcm, frames);
-	return frames;
-}
-
 /* write out the uncommitted chunk on mmap buffer to the slave PCM */
 static snd_pcm_sframes_t
 sync_slave_write(snd_pcm_t *pcm)
@@ -292,6 +276,73 @@ sync_slave_write(snd_pcm_t *pcm)
 	return size;
 }
 
+/* frames committed on the mmap buffer and not written to the slave yet */
+static snd_pcm_uframes_t pending_frames(snd_pcm_t *pcm)
+{
+	mmap_emul_t *map = pcm->private_data;
+	snd_pcm_sframes_t size;
+
+	size = map->appl_ptr - *map->gen.slave->appl.ptr;
+	if (size < 0)
+		size += pcm->boundary;
+	return size;
+}
+
+/*
+ * Each write to the slave is a transfer, a system call for most slaves.
+ * Applications committing small chunks would pay one per commit, so
+ * while the slave runs with at least a period queued, the commits are
+ * collected until a period is pending.  The rest is written at the next
+ * avail_update which sees a period free in the slave, i.e. when the
+ * application wakes up, and before the operations needing the slave
+ * to be in sync.
+ */
+static int defer_slave_write(snd_pcm_t *pcm)
+{
+	mmap_emul_t *map = pcm->private_data;
+	snd_pcm_t *slave = map->gen.slave;
+	snd_pcm_sframes_t queued;
+
+	if (pending_frames(pcm) >= pcm->period_size)
+		return 0;
+	if (snd_pcm_state(slave) != SND_PCM_STATE_RUNNING)
+		return 0;
+	queued = *slave->appl.ptr - *slave->hw.ptr;
+	if (queued < 0)
+		queued += pcm->boundary;
+	return (snd_pcm_uframes_t)queued >= pcm->period_size;
+}
+
+/* write out the deferred commits before an operation on the slave */
+static void flush_slave_write(snd_pcm_t *pcm)
+{
+	mmap_emul_t *map = pcm->private_data;
+
+	if (map->mmap_emul && pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    pending_frames(pcm))
+		sync_slave_write(pcm);
+}
+
+static snd_pcm_sframes_t
+snd_pcm_mmap_emul_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	flush_slave_write(pcm);
+	frames = snd_pcm_generic_rewind(pcm, frames);
+	if (frames > 0)
+		snd_pcm_mmap_appl_backward(pcm, frames);
+	return frames;
+}
+
+static snd_pcm_sframes_t
+snd_pcm_mmap_emul_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	flush_slave_write(pcm);
+	frames = snd_pcm_generic_forward(pcm, frames);
+	if (frames > 0)
+		snd_pcm_mmap_appl_forward(pcm, frames);
+	return frames;
+}
+
 /* read the available chunk on the slave PCM to mmap buffer */
 static snd_pcm_sframes_t
 sync_slave_read(snd_pcm_t *pcm)
@@ -323,7 +374,7 @@ snd_pcm_mmap_emul_mmap_commit(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
 	snd_pcm_mmap_appl_forward(pcm, size);
 	if (!map->mmap_emul)
 		return snd_pcm_mmap_commit(slave, offset, size);
-	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK && !defer_slave_write(pcm))
 		sync_slave_write(pcm);
 	return size;
 }
@@ -337,9 +388,33 @@ static snd_pcm_sframes_t snd_pcm_mmap_emul_avail_update(snd_pcm_t *pcm)
 		map->hw_ptr = *slave->hw.ptr;
 	else
 		sync_slave_read(pcm);
+	if (map->mmap_emul && pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    pending_frames(pcm) &&
+	    snd_pcm_mmap_avail(pcm) + pending_frames(pcm) >= pcm->avail_min)
+		sync_slave_write(pcm);
 	return snd_pcm_mmap_avail(pcm);
 }
 
+static int snd_pcm_mmap_emul_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	flush_slave_write(pcm);
+	return snd_pcm_generic_status(pcm, status);
+}
+
+static int snd_pcm_mmap_emul_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	flush_slave_write(pcm);
+	return snd_pcm_generic_delay(pcm, delayp);
+}
+
+static int snd_pcm_mmap_emul_drain(snd_pcm_t *pcm)
+{
+	snd_pcm_lock(pcm);
+	flush_slave_write(pcm);
+	snd_pcm_unlock(pcm);
+	return snd_pcm_generic_drain(pcm);
+}
+
 static void snd_pcm_mmap_emul_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
 	mmap_emul_t *map = pcm->private_data;
@@ -372,15 +447,15 @@ static const snd_pcm_ops_t snd_pcm_mmap_emul_ops = {
 };
 
 static const snd_pcm_fast_ops_t snd_pcm_mmap_emul_fast_ops = {
-	.status = snd_pcm_generic_status,
+	.status = snd_pcm_mmap_emul_status,
 	.state = snd_pcm_generic_state,
 	.hwsync = snd_pcm_generic_hwsync,
-	.delay = snd_pcm_generic_delay,
+	.delay = snd_pcm_mmap_emul_delay,
 	.prepare = snd_pcm_mmap_emul_prepare,
 	.reset = snd_pcm_mmap_emul_reset,
 	.start = snd_pcm_generic_start,
 	.drop = snd_pcm_generic_drop,
-	.drain = snd_pcm_generic_drain,
+	.drain = snd_pcm_mmap_emul_drain,
 	.pause = snd_pcm_generic_pause,
 	.rewindable = snd_pcm_generic_rewindable,
 	.rewind = snd_pcm_mmap_emul_rewind,
@@ -55,21 +55,13 @@ typedef struct {
 
 #endif
 
+/*
+ * Segment of a biased magnitude (0x84 - 0x7fff), the position of its
+ * leading one above bit 7.
+ */
 static inline int val_seg(int val)
 {
-	int r = 0;
-	val >>= 7;
-	if (val & 0xf0) {
-		val >>= 4;
-		r += 4;
-	}
-	if (val & 0x0c) {
-		val >>= 2;
-		r += 2;
-	}
-	if (val & 0x02)
-		r += 1;
-	return r;
+	return 31 - __builtin_clz(val >> 7);
 }
 
 /*
@@ -108,15 +100,10 @@ static unsigned char s16_to_ulaw(int pcm_val)	/* 2's complement (16-bit range) *
 	int seg;
 	unsigned char uval;
 
-	if (pcm_val < 0) {
-		pcm_val = 0x84 - pcm_val;
-		mask = 0x7f;
-	} else {
-		pcm_val += 0x84;
-		mask = 0xff;
-	}
-	if (pcm_val > 0x7fff)
-		pcm_val = 0x7fff;
+	/* the signs are random in audio, keep this free of branches */
+	mask = pcm_val < 0 ? 0x7f : 0xff;
+	pcm_val = (pcm_val < 0 ? -pcm_val : pcm_val) + 0x84;
+	pcm_val = pcm_val > 0x7fff ? 0x7fff : pcm_val;
 
 	/* Convert the scaled magnitude to segment number. */
 	seg = val_seg(pcm_val);
@@ -137,22 +124,51 @@ static unsigned char s16_to_ulaw(int pcm_val)	/* 2's complement (16-bit range) *
  *
  * Note that this function expects to be passed the complement of the
  * original code word. This is in keeping with ISDN conventions.
+ *
+ * The table holds the results of all the 256 code words:
+ *
+ *	t = ((~u_val & 0x0f) << 3) + 0x84;
+ *	t <<= (~u_val & 0x70) >> 4;
+ *	return (~u_val & 0x80) ? (0x84 - t) : (t - 0x84);
  */
-static int ulaw_to_s16(unsigned char u_val)
-{
-	int t;
-
-	/* Complement to obtain normal u-law value. */
-	u_val = ~u_val;
-
-	/*
-	 * Extract and bias the quantization bits. Then
-	 * shift up by the segment number and subtract out the bias.
-	 */
-	t = ((u_val & 0x0f) << 3) + 0x84;
-	t <<= (u_val & 0x70) >> 4;
+static const int16_t ulaw_to_s16_table[256] = {
+	-32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+	-23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+	-15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+	-11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316,
+	-7932, -7676, -7420, -7164, -6908, -6652, -6396, -6140,
+	-5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092,
+	-3900, -3772, -3644, -3516, -3388, -3260, -3132, -3004,
+	-2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980,
+	-1884, -1820, -1756, -1692, -1628, -1564, -1500, -1436,
+	-1372, -1308, -1244, -1180, -1116, -1052, -988, -924,
+	-876, -844, -812, -780, -748, -716, -684, -652,
+	-620, -588, -556, -524, -492, -460, -428, -396,
+	-372, -356, -340, -324, -308, -292, -276, -260,
+	-244, -228, -212, -196, -180, -164, -148, -132,
+	-120, -112, -104, -96, -88, -80, -72, -64,
+	-56, -48, -40, -32, -24, -16, -8, 0,
+	32124, 31100, 30076, 29052, 28028, 27004, 25980, 24956,
+	23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764,
+	15996, 15484, 14972, 14460, 13948, 13436, 12924, 12412,
+	11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316,
+	7932, 7676, 7420, 7164, 6908, 6652, 6396, 6140,
+	5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092,
+	3900, 3772, 3644, 3516, 3388, 3260, 3132, 3004,
+	2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980,
+	1884, 1820, 1756, 1692, 1628, 1564, 1500, 1436,
+	1372, 1308, 1244, 1180, 1116, 1052, 988, 924,
+	876, 844, 812, 780, 748, 716, 684, 652,
+	620, 588, 556, 524, 492, 460, 428, 396,
+	372, 356, 340, 324, 308, 292, 276, 260,
+	244, 228, 212, 196, 180, 164, 148, 132,
+	120, 112, 104, 96, 88, 80, 72, 64,
+	56, 48, 40, 32, 24, 16, 8, 0,
+};
 
-	return ((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
+static inline int ulaw_to_s16(unsigned char u_val)
+{
+	return ulaw_to_s16_table[u_val];
 }
 
 #ifndef DOC_HIDDEN
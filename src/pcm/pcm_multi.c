@@ -27,12 +27,15 @@
  */
   
 #include "pcm_local.h"
-#include "pcm_generic.h"
+#include "pcm_plugin.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -41,11 +44,20 @@ const char *_snd_module_pcm_multi = "";
 
 #ifndef DOC_HIDDEN
 
+typedef struct snd_pcm_multi snd_pcm_multi_t;
+
 typedef struct {
 	snd_pcm_t *pcm;
 	unsigned int channels_count;
 	int close_slave;
 	snd_pcm_t *linked;
+	snd_pcm_multi_t *multi;
+	snd_pcm_sframes_t result;	/* of the last slave operation */
+	/* hw_ptr distance to the master slave */
+	snd_pcm_sframes_t drift, drift_min, drift_max;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+#endif
 } snd_pcm_multi_slave_t;
 
 typedef struct {
@@ -53,22 +65,193 @@ typedef struct {
 	unsigned int slave_channel;
 } snd_pcm_multi_channel_t;
 
+enum {
+	MULTI_OP_COMMIT,
+	MULTI_OP_AVAIL,
+	MULTI_OP_HWSYNC,
+	MULTI_OP_DELAY,
+};
+
+#ifdef HAVE_LIBPTHREAD
+/* worker threads servicing the slaves other than the first one */
 typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t job;
+	pthread_cond_t done;
+	unsigned int seq;		/* bumped for each job */
+	unsigned int pending;		/* workers still busy */
+	int quit;
+	unsigned int threads;		/* started workers */
+} snd_pcm_multi_pool_t;
+#endif
+
+struct snd_pcm_multi {
 	snd_pcm_uframes_t appl_ptr, hw_ptr;
 	unsigned int slaves_count;
 	unsigned int master_slave;
 	snd_pcm_multi_slave_t *slaves;
 	unsigned int channels_count;
 	snd_pcm_multi_channel_t *channels;
-} snd_pcm_multi_t;
+	/* the current slave operation */
+	int op;
+	snd_pcm_uframes_t op_offset, op_size;
+	/* frames played by the master since prepare, for the drift rate */
+	snd_pcm_uframes_t master_hw_ptr;
+	unsigned long long master_frames;
+#ifdef HAVE_LIBPTHREAD
+	snd_pcm_multi_pool_t *pool;
+#endif
+};
+
+#endif
+
+static snd_pcm_sframes_t snd_pcm_multi_slave_op(snd_pcm_multi_slave_t *slave)
+{
+	snd_pcm_multi_t *multi = slave->multi;
+	snd_pcm_sframes_t result;
+	int err;
+
+	switch (multi->op) {
+	case MULTI_OP_COMMIT:
+		result = snd_pcm_mmap_commit(slave->pcm, multi->op_offset,
+					     multi->op_size);
+		if (result >= 0 && (snd_pcm_uframes_t)result != multi->op_size)
+			return -EIO;
+		return result;
+	case MULTI_OP_AVAIL:
+		return snd_pcm_avail_update(slave->pcm);
+	case MULTI_OP_HWSYNC:
+		return snd_pcm_hwsync(slave->pcm);
+	case MULTI_OP_DELAY:
+		err = snd_pcm_delay(slave->pcm, &result);
+		return err < 0 ? err : result;
+	default:
+		return -EINVAL;
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *snd_pcm_multi_worker(void *data)
+{
+	snd_pcm_multi_slave_t *slave = data;
+	snd_pcm_multi_pool_t *pool = slave->multi->pool;
+	unsigned int seq = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->seq == seq && !pool->quit)
+			pthread_cond_wait(&pool->job, &pool->mutex);
+		if (pool->quit)
+			break;
+		seq = pool->seq;
+		pthread_mutex_unlock(&pool->mutex);
+		slave->result = snd_pcm_multi_slave_op(slave);
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void snd_pcm_multi_stop_workers(snd_pcm_multi_t *multi)
+{
+	snd_pcm_multi_pool_t *pool = multi->pool;
+	unsigned int i;
+
+	if (!pool)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->job);
+	pthread_mutex_unlock(&pool->mutex);
+	for (i = 0; i < pool->threads; i++)
+		pthread_join(multi->slaves[i + 1].thread, NULL);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->job);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+	multi->pool = NULL;
+}
+
+/* start one thread per slave, the first slave stays on the caller */
+static int snd_pcm_multi_start_workers(snd_pcm_multi_t *multi)
+{
+	snd_pcm_multi_pool_t *pool;
+	unsigned int i;
+	int err;
 
+	if (multi->slaves_count < 2)
+		return 0;
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return -ENOMEM;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->job, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	multi->pool = pool;
+	for (i = 1; i < multi->slaves_count; i++) {
+		err = pthread_create(&multi->slaves[i].thread, NULL,
+				     snd_pcm_multi_worker, &multi->slaves[i]);
+		if (err) {
+			SNDERR("cannot create the slave worker thread");
+			snd_pcm_multi_stop_workers(multi);
+			return -err;
+		}
+		pool->threads++;
+	}
+	return 0;
+}
+#else
+static void snd_pcm_multi_stop_workers(snd_pcm_multi_t *multi ATTRIBUTE_UNUSED)
+{
+}
 #endif
 
+/*
+ * run the operation on all slaves, concurrently when the worker threads
+ * are enabled; return the first error, the results are in slave->result
+ */
+static int snd_pcm_multi_run(snd_pcm_multi_t *multi, int op)
+{
+	unsigned int i;
+
+	multi->op = op;
+#ifdef HAVE_LIBPTHREAD
+	if (multi->pool) {
+		snd_pcm_multi_pool_t *pool = multi->pool;
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->pending = pool->threads;
+		pool->seq++;
+		pthread_cond_broadcast(&pool->job);
+		pthread_mutex_unlock(&pool->mutex);
+		multi->slaves[0].result = snd_pcm_multi_slave_op(&multi->slaves[0]);
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->pending)
+			pthread_cond_wait(&pool->done, &pool->mutex);
+		pthread_mutex_unlock(&pool->mutex);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			if (multi->slaves[i].result < 0)
+				return multi->slaves[i].result;
+		}
+		return 0;
+	}
+#endif
+	for (i = 0; i < multi->slaves_count; ++i) {
+		multi->slaves[i].result = snd_pcm_multi_slave_op(&multi->slaves[i]);
+		if (multi->slaves[i].result < 0)
+			return multi->slaves[i].result;
+	}
+	return 0;
+}
+
 static int snd_pcm_multi_close(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int ret = 0;
+	snd_pcm_multi_stop_workers(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
 		if (slave->close_slave) {
@@ -412,6 +595,49 @@ static snd_pcm_state_t snd_pcm_multi_state(snd_pcm_t *pcm)
 	return snd_pcm_state(slave);
 }
 
+/* follow the hw_ptr distance of each slave to the master */
+static void snd_pcm_multi_drift_update(snd_pcm_multi_t *multi)
+{
+	snd_pcm_t *master = multi->slaves[multi->master_slave].pcm;
+	snd_pcm_uframes_t master_hw_ptr = *master->hw.ptr;
+	snd_pcm_sframes_t d;
+	unsigned int i;
+
+	d = master_hw_ptr - multi->master_hw_ptr;
+	if (d < 0)
+		d += master->boundary;
+	multi->master_frames += d;
+	multi->master_hw_ptr = master_hw_ptr;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_uframes_t boundary = slave->pcm->boundary;
+
+		d = *slave->pcm->hw.ptr - master_hw_ptr;
+		if (d > (snd_pcm_sframes_t)(boundary / 2))
+			d -= boundary;
+		else if (d < -(snd_pcm_sframes_t)(boundary / 2))
+			d += boundary;
+		slave->drift = d;
+		if (d < slave->drift_min)
+			slave->drift_min = d;
+		if (d > slave->drift_max)
+			slave->drift_max = d;
+	}
+}
+
+static void snd_pcm_multi_drift_reset(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	multi->master_hw_ptr = *multi->slaves[multi->master_slave].pcm->hw.ptr;
+	multi->master_frames = 0;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		multi->slaves[i].drift = 0;
+		multi->slaves[i].drift_min = 0;
+		multi->slaves[i].drift_max = 0;
+	}
+}
+
 static void snd_pcm_multi_hwptr_update(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
@@ -440,18 +666,16 @@ static void snd_pcm_multi_hwptr_update(snd_pcm_t *pcm)
 		}
 	}
 	multi->hw_ptr = hw_ptr;
+	snd_pcm_multi_drift_update(multi);
 }
 
 static int snd_pcm_multi_hwsync(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	unsigned int i;
 	int err;
-	for (i = 0; i < multi->slaves_count; ++i) {
-		err = snd_pcm_hwsync(multi->slaves[i].pcm);
-		if (err < 0)
-			return err;
-	}
+	err = snd_pcm_multi_run(multi, MULTI_OP_HWSYNC);
+	if (err < 0)
+		return err;
 	snd_pcm_multi_hwptr_update(pcm);
 	return 0;
 }
@@ -459,15 +683,15 @@ static int snd_pcm_multi_hwsync(snd_pcm_t *pcm)
 static int snd_pcm_multi_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	snd_pcm_sframes_t d, dr = 0;
+	snd_pcm_sframes_t dr = 0;
 	unsigned int i;
 	int err;
+	err = snd_pcm_multi_run(multi, MULTI_OP_DELAY);
+	if (err < 0)
+		return err;
 	for (i = 0; i < multi->slaves_count; ++i) {
-		err = snd_pcm_delay(multi->slaves[i].pcm, &d);
-		if (err < 0)
-			return err;
-		if (dr < d)
-			dr = d;
+		if (dr < multi->slaves[i].result)
+			dr = multi->slaves[i].result;
 	}
 	*delayp = dr;
 	return 0;
@@ -478,13 +702,13 @@ static snd_pcm_sframes_t snd_pcm_multi_avail_update(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	snd_pcm_sframes_t ret = LONG_MAX;
 	unsigned int i;
+	int err;
+	err = snd_pcm_multi_run(multi, MULTI_OP_AVAIL);
+	if (err < 0)
+		return err;
 	for (i = 0; i < multi->slaves_count; ++i) {
-		snd_pcm_sframes_t avail;
-		avail = snd_pcm_avail_update(multi->slaves[i].pcm);
-		if (avail < 0)
-			return avail;
-		if (ret > avail)
-			ret = avail;
+		if (ret > multi->slaves[i].result)
+			ret = multi->slaves[i].result;
 	}
 	snd_pcm_multi_hwptr_update(pcm);
 	return ret;
@@ -512,6 +736,7 @@ static int snd_pcm_multi_prepare(snd_pcm_t *pcm)
 			result = err;
 	}
 	multi->hw_ptr = multi->appl_ptr = 0;
+	snd_pcm_multi_drift_reset(multi);
 	return result;
 }
 
@@ -527,6 +752,7 @@ static int snd_pcm_multi_reset(snd_pcm_t *pcm)
 			result = err;
 	}
 	multi->hw_ptr = multi->appl_ptr = 0;
+	snd_pcm_multi_drift_reset(multi);
 	return result;
 }
 
@@ -783,18 +1009,13 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 						   snd_pcm_uframes_t size)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	snd_pcm_t *slave;
-	unsigned int i;
-	snd_pcm_sframes_t result;
+	int err;
 
-	for (i = 0; i < multi->slaves_count; ++i) {
-		slave = multi->slaves[i].pcm;
-		result = snd_pcm_mmap_commit(slave, offset, size);
-		if (result < 0)
-			return result;
-		if ((snd_pcm_uframes_t)result != size)
-			return -EIO;
-	}
+	multi->op_offset = offset;
+	multi->op_size = size;
+	err = snd_pcm_multi_run(multi, MULTI_OP_COMMIT);
+	if (err < 0)
+		return err;
 	snd_pcm_mmap_appl_forward(pcm, size);
 	return size;
 }
@@ -802,7 +1023,6 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 static int snd_pcm_multi_munmap(snd_pcm_t *pcm)
 {
 	free(pcm->mmap_channels);
-	free(pcm->running_areas);
 	pcm->mmap_channels = NULL;
 	pcm->running_areas = NULL;
 	return 0;
@@ -813,14 +1033,13 @@ static int snd_pcm_multi_mmap(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int c;
 
+	/* one block, as in snd_pcm_mmap() */
 	pcm->mmap_channels = calloc(pcm->channels,
-				    sizeof(pcm->mmap_channels[0]));
-	pcm->running_areas = calloc(pcm->channels,
+				    sizeof(pcm->mmap_channels[0]) +
 				    sizeof(pcm->running_areas[0]));
-	if (!pcm->mmap_channels || !pcm->running_areas) {
-		snd_pcm_multi_munmap(pcm);
+	if (!pcm->mmap_channels)
 		return -ENOMEM;
-	}
+	pcm->running_areas = (snd_pcm_channel_area_t *)(pcm->mmap_channels + pcm->channels);
 
 	/* Copy the slave mmapped buffer data */
 	for (c = 0; c < pcm->channels; c++) {
@@ -1000,6 +1219,28 @@ static void snd_pcm_multi_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	if (pcm->setup && multi->slaves_count > 1) {
+		snd_output_printf(out, "Slave drift to the master over %llu frames%s:\n",
+				  multi->master_frames,
+#ifdef HAVE_LIBPTHREAD
+				  multi->pool ? " (parallel)" : "");
+#else
+				  "");
+#endif
+		for (k = 0; k < multi->slaves_count; ++k) {
+			snd_pcm_multi_slave_t *slave = &multi->slaves[k];
+			if (k == multi->master_slave)
+				continue;
+			snd_output_printf(out, "    %d: %ld frames (min %ld, max %ld)",
+					  k, (long)slave->drift,
+					  (long)slave->drift_min,
+					  (long)slave->drift_max);
+			if (multi->master_frames)
+				snd_output_printf(out, ", %.1f ppm",
+						  slave->drift * 1e6 / multi->master_frames);
+			snd_output_printf(out, "\n");
+		}
+	}
 	for (k = 0; k < multi->slaves_count; ++k) {
 		snd_output_printf(out, "Slave #%d: ", k);
 		snd_pcm_dump(multi->slaves[k].pcm, out);
@@ -1118,6 +1359,7 @@ int snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 		slave->pcm = slaves_pcm[i];
 		slave->channels_count = schannels_count[i];
 		slave->close_slave = close_slaves;
+		slave->multi = multi;
 	}
 	for (i = 0; i < channels_count; ++i) {
 		snd_pcm_multi_channel_t *bind = &multi->channels[i];
@@ -1178,9 +1420,34 @@ pcm.name {
 		}
 	}
 	[master INT]		# Define the master slave
+	[parallel BOOL]		# Service the slaves concurrently
+	[resample BOOL]		# Follow the master clock (playback only)
+	[rate_converter STR]	# Converter for resample
 }
 \endcode
 
+With \c parallel set, the slaves other than the first one get a worker
+thread each, and the commits, avail updates, hwsync and delay queries go
+to all slaves at once instead of one after another, so that a slow slave
+(e.g. the sync_ptr ioctl of an USB device) doesn't delay the others.
+This pays off with many slaves, on the cost of two thread wakeups per
+operation; the workers inherit the scheduling of the thread opening the
+PCM.
+
+The PCM dump reports the hw_ptr distance of each slave to the master
+over the stream, the current value and its range in frames, and the
+drift rate in ppm.
+
+All slaves are expected to run from the same clock.  When they don't,
+e.g. with several USB devices aggregated to one, the slaves drift apart
+and the stream ends in an xrun after a while.  With \c resample set,
+each slave except the master is wrapped in a \ref pcm_plugins_rate "rate"
+plugin in the adaptive mode at the unchanged rate, which corrects its
+conversion ratio by up to 0.1% to keep the buffered amount constant.
+As the application is paced by the master, the other slaves follow the
+master clock.  The converter is taken from \c rate_converter or from
+defaults.pcm.rate_converter, it must support the pitch adjustment.
+
 For example, to bind two PCM streams with two-channel stereo (hw:0,0 and
 hw:0,1) as one 4-channel stereo PCM stream, define like this:
 \code
@@ -1227,6 +1494,29 @@ pcm.quad2 {
 
 */
 
+#ifdef BUILD_PCM_PLUGIN_RATE
+/*
+ * put an adaptive rate plugin keeping the rate on top of the slave, so
+ * that it follows the pace of the application, i.e. of the master slave
+ */
+static int snd_pcm_multi_resample_slave(snd_pcm_t **spcm, snd_config_t *root,
+					const snd_config_t *converter)
+{
+	snd_pcm_t *rpcm;
+	int err;
+
+	if (!converter)
+		converter = snd_pcm_rate_get_default_converter(root);
+	err = snd_pcm_rate_open(&rpcm, NULL, SND_PCM_FORMAT_UNKNOWN, 0,
+				converter, *spcm, 1);
+	if (err < 0)
+		return err;
+	/* the slave is closed with the rate PCM from now on */
+	*spcm = rpcm;
+	return snd_pcm_rate_set_adaptive(rpcm);
+}
+#endif
+
 /**
  * \brief Creates a new Multi PCM
  * \param pcmp Returns created PCM handle
@@ -1258,6 +1548,9 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int slaves_count = 0;
 	long master_slave = 0;
 	unsigned int channels_count = 0;
+	int parallel = 0;
+	int resample = 0;
+	const snd_config_t *rate_converter = NULL;
 	snd_config_for_each(i, inext, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1288,6 +1581,34 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "parallel") == 0) {
+			parallel = snd_config_get_bool(n);
+			if (parallel < 0)
+				return -EINVAL;
+#ifndef HAVE_LIBPTHREAD
+			if (parallel) {
+				SNDERR("parallel needs the thread support");
+				return -EINVAL;
+			}
+#endif
+			continue;
+		}
+		if (strcmp(id, "resample") == 0) {
+			resample = snd_config_get_bool(n);
+			if (resample < 0)
+				return -EINVAL;
+#ifndef BUILD_PCM_PLUGIN_RATE
+			if (resample) {
+				SNDERR("resample needs the rate plugin");
+				return -EINVAL;
+			}
+#endif
+			continue;
+		}
+		if (strcmp(id, "rate_converter") == 0) {
+			rate_converter = n;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1430,12 +1751,29 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			goto _free;
 		snd_config_delete(slaves_conf[idx]);
 		slaves_conf[idx] = NULL;
+#ifdef BUILD_PCM_PLUGIN_RATE
+		if (resample && idx != master_slave) {
+			err = snd_pcm_multi_resample_slave(&slaves_pcm[idx], root,
+							   rate_converter);
+			if (err < 0)
+				goto _free;
+		}
+#endif
 	}
 	err = snd_pcm_multi_open(pcmp, name, slaves_count, master_slave,
 				 slaves_pcm, slaves_channels,
 				 channels_count,
 				 channels_sidx, channels_schannel,
 				 1);
+#ifdef HAVE_LIBPTHREAD
+	if (err >= 0 && parallel) {
+		err = snd_pcm_multi_start_workers((*pcmp)->private_data);
+		if (err < 0) {
+			snd_pcm_close(*pcmp);
+			goto _free_conf;
+		}
+	}
+#endif
 _free:
 	if (err < 0) {
 		for (idx = 0; idx < slaves_count; ++idx) {
@@ -1443,6 +1781,9 @@ _free:
 				snd_pcm_close(slaves_pcm[idx]);
 		}
 	}
+#ifdef HAVE_LIBPTHREAD
+ _free_conf:
+#endif
 	if (slaves_conf) {
 		for (idx = 0; idx < slaves_count; ++idx) {
 			if (slaves_conf[idx])
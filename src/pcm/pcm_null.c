@@ -44,6 +44,8 @@ typedef struct {
 	snd_pcm_uframes_t hw_ptr;
 	int poll_fd;
 	snd_pcm_chmap_query_t **chmap;
+	int offline;			/* timestamps follow the processed frames */
+	unsigned long long frames;	/* frames processed since open */
 } snd_pcm_null_t;
 #endif
 
@@ -55,6 +57,30 @@ static int snd_pcm_null_close(snd_pcm_t *pcm)
 	return 0;
 }
 
+/* the current time, the offline clock runs with the processed frames */
+static void snd_pcm_null_tstamp(snd_pcm_t *pcm, snd_htimestamp_t *tstamp)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	unsigned long long nsec;
+
+	if (!null->offline || !pcm->rate) {
+		gettimestamp(tstamp, pcm->tstamp_type);
+		return;
+	}
+	nsec = null->frames / pcm->rate * 1000000000ULL +
+	       null->frames % pcm->rate * 1000000000ULL / pcm->rate;
+	tstamp->tv_sec = nsec / 1000000000ULL;
+	tstamp->tv_nsec = nsec % 1000000000ULL;
+}
+
+static void snd_pcm_null_advance(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+
+	snd_pcm_mmap_hw_forward(pcm, frames);
+	null->frames += frames;
+}
+
 static int snd_pcm_null_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIBUTE_UNUSED)
 {
 	return 0;
@@ -98,7 +124,9 @@ static int snd_pcm_null_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 	status->trigger_tstamp = null->trigger_tstamp;
 	status->appl_ptr = *pcm->appl.ptr;
 	status->hw_ptr = *pcm->hw.ptr;
-	gettimestamp(&status->tstamp, pcm->tstamp_type);
+	snd_pcm_null_tstamp(pcm, &status->tstamp);
+	if (null->offline)
+		status->audio_tstamp = status->tstamp;
 	status->avail = snd_pcm_null_avail_update(pcm);
 	status->avail_max = pcm->buffer_size;
 	return 0;
@@ -140,6 +168,7 @@ static int snd_pcm_null_start(snd_pcm_t *pcm)
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state == SND_PCM_STATE_PREPARED);
 	null->state = SND_PCM_STATE_RUNNING;
+	snd_pcm_null_tstamp(pcm, &null->trigger_tstamp);
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE)
 		*pcm->hw.ptr = *pcm->appl.ptr + pcm->buffer_size;
 	else
@@ -209,7 +238,7 @@ static snd_pcm_sframes_t snd_pcm_null_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_null_t *null = pcm->private_data;
 	switch (null->state) {
 	case SND_PCM_STATE_RUNNING:
-		snd_pcm_mmap_hw_forward(pcm, frames);
+		snd_pcm_null_advance(pcm, frames);
 		/* Fall through */
 	case SND_PCM_STATE_PREPARED:
 		snd_pcm_mmap_appl_forward(pcm, frames);
@@ -230,7 +259,7 @@ static snd_pcm_sframes_t snd_pcm_null_xfer_areas(snd_pcm_t *pcm,
 						 snd_pcm_uframes_t size)
 {
 	snd_pcm_mmap_appl_forward(pcm, size);
-	snd_pcm_mmap_hw_forward(pcm, size);
+	snd_pcm_null_advance(pcm, size);
 	return size;
 }
 
@@ -295,6 +324,22 @@ static int snd_pcm_null_sw_params(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_sw_pa
 	return 0;
 }
 
+static int snd_pcm_null_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
+				   snd_htimestamp_t *tstamp)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	snd_pcm_sframes_t avail1;
+
+	if (!null->offline)
+		return snd_pcm_generic_real_htimestamp(pcm, avail, tstamp);
+	avail1 = snd_pcm_null_avail_update(pcm);
+	if (avail1 < 0)
+		return avail1;
+	*avail = avail1;
+	snd_pcm_null_tstamp(pcm, tstamp);
+	return 0;
+}
+
 static snd_pcm_chmap_query_t **snd_pcm_null_query_chmaps(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
@@ -315,7 +360,9 @@ static snd_pcm_chmap_t *snd_pcm_null_get_chmap(snd_pcm_t *pcm)
 
 static void snd_pcm_null_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
-	snd_output_printf(out, "Null PCM\n");
+	snd_pcm_null_t *null = pcm->private_data;
+
+	snd_output_printf(out, "Null PCM%s\n", null->offline ? " (offline clock)" : "");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -362,7 +409,7 @@ static const snd_pcm_fast_ops_t snd_pcm_null_fast_ops = {
 	.readn = snd_pcm_null_readn,
 	.avail_update = snd_pcm_null_avail_update,
 	.mmap_commit = snd_pcm_null_mmap_commit,
-	.htimestamp = snd_pcm_generic_real_htimestamp,
+	.htimestamp = snd_pcm_null_htimestamp,
 };
 
 /**
@@ -432,10 +479,20 @@ samples.
 Note: This implementation uses devices /dev/null (playback, must be writable)
 and /dev/full (capture, must be readable).
 
+The stream never waits: the hardware pointer follows the application
+pointer as soon as the data is written or committed, so a plugin chain on
+top of a null PCM runs as fast as the CPU allows.  With the \c offline
+clock, the timestamps reported by the status, #snd_pcm_htimestamp() and
+the trigger timestamp are taken from the number of processed frames at the
+configured rate instead of the system clock.  A rendering through such a
+chain is then reproducible, which suits batch conversions and regression
+tests of whole chains.
+
 \code
 pcm.name {
         type null               # Null PCM
 	[chmap MAP]		# Provide channel maps; MAP is a string array
+	[clock STR]		# Timestamp clock: system (default), offline
 }
 \endcode
 
@@ -468,6 +525,7 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	snd_pcm_null_t *null;
 	snd_pcm_chmap_query_t **chmap = NULL;
+	int offline = 0;
 	int err;
 
 	snd_config_for_each(i, next, conf) {
@@ -486,6 +544,18 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "clock") == 0) {
+			const char *str;
+
+			if (snd_config_get_string(n, &str) < 0 ||
+			    (strcmp(str, "system") && strcmp(str, "offline"))) {
+				SNDERR("Invalid clock, use system or offline");
+				snd_pcm_free_chmaps(chmap);
+				return -EINVAL;
+			}
+			offline = !strcmp(str, "offline");
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		snd_pcm_free_chmaps(chmap);
 		return -EINVAL;
@@ -498,6 +568,7 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 
 	null = (*pcmp)->private_data;
 	null->chmap = chmap;
+	null->offline = offline;
 	return 0;
 }
 #ifndef DOC_HIDDEN
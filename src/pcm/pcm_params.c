@@ -278,12 +278,13 @@ int snd_pcm_hw_param_set_integer(snd_pcm_t *pcm,
 				 snd_pcm_hw_param_t var)
 {
 	snd_pcm_hw_params_t save;
+	snd_pcm_hw_params_compact_t saved;
 	int err;
 	switch (mode) {
 	case SND_CHANGE:
 		break;
 	case SND_TRY:
-		save = *params;
+		snd_pcm_hw_params_pack(&saved, params);
 		break;
 	case SND_TEST:
 		save = *params;
@@ -304,7 +305,7 @@ int snd_pcm_hw_param_set_integer(snd_pcm_t *pcm,
 	return 0;
  _fail:
 	if (mode == SND_TRY)
-		*params = save;
+		snd_pcm_hw_params_unpack(params, &saved);
 	return err;
 }
 
@@ -431,12 +432,13 @@ int snd_pcm_hw_param_set_min(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 			     snd_pcm_hw_param_t var, unsigned int *val, int *dir)
 {
 	snd_pcm_hw_params_t save;
+	snd_pcm_hw_params_compact_t saved;
 	int err;
 	switch (mode) {
 	case SND_CHANGE:
 		break;
 	case SND_TRY:
-		save = *params;
+		snd_pcm_hw_params_pack(&saved, params);
 		break;
 	case SND_TEST:
 		save = *params;
@@ -461,7 +463,7 @@ int snd_pcm_hw_param_set_min(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 	return snd_pcm_hw_param_get_min(params, var, val, dir);
  _fail:
 	if (mode == SND_TRY)
-		*params = save;
+		snd_pcm_hw_params_unpack(params, &saved);
 	if (err < 0 && mode == SND_TRY)
 		dump_hw_params(params, "set_min", var, *val, err);
 	return err;
@@ -508,12 +510,13 @@ int snd_pcm_hw_param_set_max(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 			     snd_pcm_hw_param_t var, unsigned int *val, int *dir)
 {
 	snd_pcm_hw_params_t save;
+	snd_pcm_hw_params_compact_t saved;
 	int err;
 	switch (mode) {
 	case SND_CHANGE:
 		break;
 	case SND_TRY:
-		save = *params;
+		snd_pcm_hw_params_pack(&saved, params);
 		break;
 	case SND_TEST:
 		save = *params;
@@ -538,7 +541,7 @@ int snd_pcm_hw_param_set_max(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 	return snd_pcm_hw_param_get_max(params, var, val, dir);
  _fail:
 	if (mode == SND_TRY)
-		*params = save;
+		snd_pcm_hw_params_unpack(params, &saved);
 	if (err < 0 && mode == SND_TRY)
 		dump_hw_params(params, "set_max", var, *val, err);
 	return err;
@@ -621,12 +624,13 @@ int snd_pcm_hw_param_set_minmax(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 				unsigned int *max, int *maxdir)
 {
 	snd_pcm_hw_params_t save;
+	snd_pcm_hw_params_compact_t saved;
 	int err;
 	switch (mode) {
 	case SND_CHANGE:
 		break;
 	case SND_TRY:
-		save = *params;
+		snd_pcm_hw_params_pack(&saved, params);
 		break;
 	case SND_TEST:
 		save = *params;
@@ -652,7 +656,7 @@ int snd_pcm_hw_param_set_minmax(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 	return snd_pcm_hw_param_get_max(params, var, max, maxdir);
  _fail:
 	if (mode == SND_TRY)
-		*params = save;
+		snd_pcm_hw_params_unpack(params, &saved);
 	if (err < 0)
 		dump_hw_params(params, "set_minmax", var, *min, err);
 	return err;
@@ -716,12 +720,13 @@ int snd_pcm_hw_param_set(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 			 snd_pcm_hw_param_t var, unsigned int val, int dir)
 {
 	snd_pcm_hw_params_t save;
+	snd_pcm_hw_params_compact_t saved;
 	int err;
 	switch (mode) {
 	case SND_CHANGE:
 		break;
 	case SND_TRY:
-		save = *params;
+		snd_pcm_hw_params_pack(&saved, params);
 		break;
 	case SND_TEST:
 		save = *params;
@@ -742,7 +747,7 @@ int snd_pcm_hw_param_set(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 	return 0;
  _fail:
 	if (mode == SND_TRY)
-		*params = save;
+		snd_pcm_hw_params_unpack(params, &saved);
 	if (err < 0 && mode == SND_TRY)
 		dump_hw_params(params, "set", var, val, err);
 	return err;
@@ -773,12 +778,13 @@ int snd_pcm_hw_param_set_mask(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 			      snd_pcm_hw_param_t var, const snd_mask_t *val)
 {
 	snd_pcm_hw_params_t save;
+	snd_pcm_hw_params_compact_t saved;
 	int err;
 	switch (mode) {
 	case SND_CHANGE:
 		break;
 	case SND_TRY:
-		save = *params;
+		snd_pcm_hw_params_pack(&saved, params);
 		break;
 	case SND_TEST:
 		save = *params;
@@ -799,7 +805,7 @@ int snd_pcm_hw_param_set_mask(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 	return 0;
  _fail:
 	if (mode == SND_TRY)
-		*params = save;
+		snd_pcm_hw_params_unpack(params, &saved);
 	return err;
 }
 
@@ -1740,18 +1746,25 @@ static int snd_pcm_hw_rule_format(snd_pcm_hw_params_t *params,
 	snd_pcm_format_t k;
 	snd_mask_t *mask = hw_param_mask(params, rule->var);
 	snd_interval_t *i = hw_param_interval(params, rule->deps[0]);
-	for (k = 0; k <= SND_PCM_FORMAT_LAST; k++) {
-		int bits;
-		if (!snd_pcm_format_mask_test(mask, k))
-			continue;
-		bits = snd_pcm_format_physical_width(k);
-		if (bits < 0)
-			continue;
-		if (!snd_interval_test(i, (unsigned int) bits)) {
-			snd_pcm_format_mask_reset(mask, k);
-			if (snd_mask_empty(mask))
-				return -EINVAL;
-			changed = 1;
+	unsigned int w;
+	/* visit only the formats present in the mask */
+	for (w = 0; w < MASK_SIZE; w++) {
+		uint32_t set = mask->bits[w];
+		while (set) {
+			int bits;
+			k = w * 32 + ffs(set) - 1;
+			set &= set - 1;
+			if (k > SND_PCM_FORMAT_LAST)
+				break;
+			bits = snd_pcm_format_physical_width(k);
+			if (bits < 0)
+				continue;
+			if (!snd_interval_test(i, (unsigned int) bits)) {
+				snd_pcm_format_mask_reset(mask, k);
+				if (snd_mask_empty(mask))
+					return -EINVAL;
+				changed = 1;
+			}
 		}
 	}
 	return changed;
@@ -1766,19 +1779,25 @@ static int snd_pcm_hw_rule_sample_bits(snd_pcm_hw_params_t *params,
 	snd_interval_t *i = hw_param_interval(params, rule->var);
 	snd_mask_t *mask = hw_param_mask(params, rule->deps[0]);
 	int c, changed = 0;
+	unsigned int w;
 	min = UINT_MAX;
 	max = 0;
-	for (k = 0; k <= SND_PCM_FORMAT_LAST; k++) {
-		int bits;
-		if (!snd_pcm_format_mask_test(mask, k))
-			continue;
-		bits = snd_pcm_format_physical_width(k);
-		if (bits < 0)
-			continue;
-		if (min > (unsigned)bits)
-			min = bits;
-		if (max < (unsigned)bits)
-			max = bits;
+	for (w = 0; w < MASK_SIZE; w++) {
+		uint32_t set = mask->bits[w];
+		while (set) {
+			int bits;
+			k = w * 32 + ffs(set) - 1;
+			set &= set - 1;
+			if (k > SND_PCM_FORMAT_LAST)
+				break;
+			bits = snd_pcm_format_physical_width(k);
+			if (bits < 0)
+				continue;
+			if (min > (unsigned)bits)
+				min = bits;
+			if (max < (unsigned)bits)
+				max = bits;
+		}
 	}
 	c = snd_interval_refine_min(i, min, 0);
 	if (c < 0)
@@ -2356,8 +2375,150 @@ static int snd_pcm_sw_params_default(snd_pcm_t *pcm, snd_pcm_sw_params_t *params
 #define REFINE_DEBUG
 #endif
 
+/*
+ * Refining the same configuration space through a deep plugin chain is
+ * expensive and happens a lot: every snd_pcm_hw_params_set_* call walks
+ * the whole chain, and each plugin refines its slave again until the
+ * parameters stop changing.  Remember the last few successful results
+ * for every PCM keyed by the complete input parameters.
+ *
+ * The entries carry the generation they were computed in.  A new
+ * negotiation (snd_pcm_hw_params_any) starts a new generation, which
+ * drops the cached results of all PCMs at once, so a change of the
+ * hardware constraints is seen at the latest by the next negotiation.
+ * hw_free and hw_params release the cache of every PCM in the chain.
+ *
+ * The entries and the key hold only the used parts of the parameters
+ * (snd_pcm_hw_params_compact_t), which halves the bytes copied, hashed
+ * and compared at each refine of each PCM of the chain.
+ */
+#define REFINE_CACHE_SIZE	16
+
+struct snd_pcm_refine_cache_entry {
+	unsigned int generation;
+	unsigned int hash;
+	unsigned int changed;	/* parameters changed by the refine */
+	snd_pcm_hw_params_compact_t in;	/* input with a cleared cmask */
+	snd_pcm_hw_params_compact_t out;
+};
+
+struct snd_pcm_refine_cache {
+	unsigned int next;
+	struct snd_pcm_refine_cache_entry entry[REFINE_CACHE_SIZE];
+};
+
+static unsigned int refine_generation = 1;
+
+/* FNV-1a style hash in four independent 64-bit lanes */
+static unsigned int snd_pcm_hw_params_hash(const snd_pcm_hw_params_compact_t *params)
+{
+	const uint64_t prime = 0x100000001b3ULL;
+	uint64_t h[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL,
+			  0xcbf29ce4ULL, 0x84222325ULL };
+	const unsigned char *p = (const unsigned char *)params;
+	size_t i, n = sizeof(*params) / (4 * sizeof(uint64_t));
+	unsigned int j;
+	uint64_t w;
+
+	for (i = 0; i < n; i++, p += 4 * sizeof(uint64_t)) {
+		for (j = 0; j < 4; j++) {
+			memcpy(&w, p + j * sizeof(w), sizeof(w));
+			h[j] = (h[j] ^ w) * prime;
+		}
+	}
+	for (i = n * 4 * sizeof(uint64_t); i < sizeof(*params); i++)
+		h[0] = (h[0] ^ ((const unsigned char *)params)[i]) * prime;
+	w = h[0] ^ (h[1] * 3) ^ (h[2] * 5) ^ (h[3] * 7);
+	return (unsigned int)(w ^ (w >> 32));
+}
+
+static unsigned int snd_pcm_hw_params_changed(const snd_pcm_hw_params_compact_t *a,
+					      const snd_pcm_hw_params_compact_t *b)
+{
+	unsigned int changed = 0;
+	snd_pcm_hw_param_t k;
+
+	for (k = SND_PCM_HW_PARAM_FIRST_MASK; k <= SND_PCM_HW_PARAM_LAST_MASK; k++)
+		if (memcmp(&a->masks[k - SND_PCM_HW_PARAM_FIRST_MASK],
+			   &b->masks[k - SND_PCM_HW_PARAM_FIRST_MASK],
+			   sizeof(a->masks[0])))
+			changed |= 1 << k;
+	for (k = SND_PCM_HW_PARAM_FIRST_INTERVAL; k <= SND_PCM_HW_PARAM_LAST_INTERVAL; k++)
+		if (memcmp(&a->intervals[k - SND_PCM_HW_PARAM_FIRST_INTERVAL],
+			   &b->intervals[k - SND_PCM_HW_PARAM_FIRST_INTERVAL],
+			   sizeof(a->intervals[0])))
+			changed |= 1 << k;
+	return changed;
+}
+
+static int snd_pcm_hw_refine_cache_lookup(snd_pcm_t *pcm,
+					  const snd_pcm_hw_params_compact_t *in,
+					  snd_pcm_hw_params_t *params,
+					  unsigned int generation,
+					  unsigned int hash)
+{
+	struct snd_pcm_refine_cache *cache = pcm->refine_cache;
+	unsigned int i;
+
+	if (!cache)
+		return 0;
+	for (i = 0; i < REFINE_CACHE_SIZE; i++) {
+		struct snd_pcm_refine_cache_entry *e = &cache->entry[i];
+		if (e->generation == generation && e->hash == hash &&
+		    !memcmp(&e->in, in, sizeof(*in))) {
+			unsigned int cmask = params->cmask;
+			snd_pcm_hw_params_unpack(params, &e->out);
+			params->cmask = cmask | e->changed;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void snd_pcm_hw_refine_cache_store(snd_pcm_t *pcm,
+					  const snd_pcm_hw_params_compact_t *in,
+					  const snd_pcm_hw_params_t *out,
+					  unsigned int generation,
+					  unsigned int hash)
+{
+	struct snd_pcm_refine_cache *cache = pcm->refine_cache;
+	struct snd_pcm_refine_cache_entry *e;
+
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache)
+			return;
+		pcm->refine_cache = cache;
+	}
+	e = &cache->entry[cache->next];
+	cache->next = (cache->next + 1) % REFINE_CACHE_SIZE;
+	e->generation = generation;
+	e->hash = hash;
+	e->in = *in;
+	snd_pcm_hw_params_pack(&e->out, out);
+	e->changed = snd_pcm_hw_params_changed(in, &e->out);
+}
+
+void snd_pcm_hw_refine_cache_free(snd_pcm_t *pcm)
+{
+	free(pcm->refine_cache);
+	pcm->refine_cache = NULL;
+}
+
+/* start a new negotiation, forgetting the results of all PCMs */
+void snd_pcm_hw_refine_new_generation(void)
+{
+	unsigned int gen = __atomic_add_fetch(&refine_generation, 1, __ATOMIC_RELAXED);
+
+	/* generation 0 marks an invalid entry */
+	if (!gen)
+		__atomic_add_fetch(&refine_generation, 1, __ATOMIC_RELAXED);
+}
+
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
+	snd_pcm_hw_params_compact_t in;
+	unsigned int generation, hash;
 	int res;
 #ifdef REFINE_DEBUG
 	snd_output_t *log;
@@ -2368,10 +2529,22 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_output_printf(log, "REFINE called:\n");
 	snd_pcm_hw_params_dump(params, log);
 #endif
+	/* the changed mask only accumulates, it does not affect the result */
+	snd_pcm_hw_params_pack(&in, params);
+	in.cmask = 0;
+	generation = __atomic_load_n(&refine_generation, __ATOMIC_RELAXED);
+	hash = snd_pcm_hw_params_hash(&in);
+	if (snd_pcm_hw_refine_cache_lookup(pcm, &in, params, generation, hash)) {
+		res = 0;
+		goto _done;
+	}
 	if (pcm->ops->hw_refine)
 		res = pcm->ops->hw_refine(pcm->op_arg, params);
 	else
 		res = -ENOSYS;
+	if (res >= 0)
+		snd_pcm_hw_refine_cache_store(pcm, &in, params, generation, hash);
+ _done:
 #ifdef REFINE_DEBUG
 	snd_output_printf(log, "refine done - result = %i\n", res);
 	snd_pcm_hw_params_dump(params, log);
@@ -2380,6 +2553,59 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	return res;
 }
 
+/*
+ * Fast re-apply of the current setup
+ *
+ * Restarting a stream often calls snd_pcm_hw_params() again with the same
+ * parameters, whether the ones built for the first call or the ones it
+ * returned, the single configuration chosen.  Both are remembered at the
+ * end of a full setup.  When the new parameters equal one of them and the
+ * stream is stopped, the refine, the choose and the hw_free/hw_params of
+ * the whole chain are skipped: the plugin buffers and the mmap areas are
+ * kept, only the default sw_params are installed again as after a full
+ * setup.  The change and request masks are left out of the comparison,
+ * they only tell what the refine has to look at.
+ */
+struct snd_pcm_setup_key {
+	snd_pcm_hw_params_compact_t in;		/* parameters asked */
+	snd_pcm_hw_params_compact_t out;	/* configuration installed */
+};
+
+static void setup_key_make(snd_pcm_hw_params_compact_t *key,
+			   const snd_pcm_hw_params_t *params)
+{
+	snd_pcm_hw_params_pack(key, params);
+	key->rmask = 0;
+	key->cmask = 0;
+}
+
+static int setup_key_match(snd_pcm_t *pcm, const snd_pcm_hw_params_compact_t *key)
+{
+	snd_pcm_state_t state;
+
+	if (!pcm->setup || !pcm->setup_key)
+		return 0;
+	if (memcmp(key, &pcm->setup_key->in, sizeof(*key)) &&
+	    memcmp(key, &pcm->setup_key->out, sizeof(*key)))
+		return 0;
+	/* the states a full hw_params is accepted in */
+	state = __snd_pcm_state(pcm);
+	return state == SND_PCM_STATE_SETUP || state == SND_PCM_STATE_PREPARED;
+}
+
+static void setup_key_store(snd_pcm_t *pcm, const snd_pcm_hw_params_compact_t *key,
+			    const snd_pcm_hw_params_t *params)
+{
+	/* without memory, every setup just takes the full path */
+	if (!pcm->setup_key) {
+		pcm->setup_key = malloc(sizeof(*pcm->setup_key));
+		if (!pcm->setup_key)
+			return;
+	}
+	pcm->setup_key->in = *key;
+	setup_key_make(&pcm->setup_key->out, params);
+}
+
 /* Install one of the configurations present in configuration
    space defined by PARAMS.
    The configuration chosen is that obtained fixing in this order:
@@ -2396,7 +2622,14 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	int err;
 	snd_pcm_sw_params_t sw;
+	snd_pcm_hw_params_compact_t key;
 	int fb, min_align;
+
+	setup_key_make(&key, params);
+	if (setup_key_match(pcm, &key)) {
+		snd_pcm_hw_params_unpack(params, &pcm->setup_key->out);
+		goto _sw_params;
+	}
 	err = snd_pcm_hw_refine(pcm, params);
 	if (err < 0)
 		return err;
@@ -2406,6 +2639,7 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		if (err < 0)
 			return err;
 	}
+	snd_pcm_hw_refine_cache_free(pcm);
 	if (pcm->ops->hw_params)
 		err = pcm->ops->hw_params(pcm->op_arg, params);
 	else
@@ -2435,12 +2669,17 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	pcm->min_align = min_align;
 	
 	pcm->hw_flags = params->flags;
+	/* snd_pcm_wait() is driven by a timer, see snd_pcm_wait_timer() */
+	if (pcm->hw_flags & SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP)
+		pcm->wakeup_margin = 1000000;
 	pcm->info = params->info;
 	pcm->msbits = params->msbits;
 	pcm->rate_num = params->rate_num;
 	pcm->rate_den = params->rate_den;
 	pcm->fifo_size = params->fifo_size;
-	
+	setup_key_store(pcm, &key, params);
+
+ _sw_params:
 	/* Default sw params */
 	memset(&sw, 0, sizeof(sw));
 	err = snd_pcm_sw_params_default(pcm, &sw);
@@ -44,6 +44,13 @@ enum snd_pcm_plug_route_policy {
 	PLUG_ROUTE_POLICY_DUP,
 };
 
+typedef struct {
+	snd_pcm_access_t access;
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+} snd_pcm_plug_params_t;
+
 typedef struct {
 	snd_pcm_generic_t gen;
 	snd_pcm_t *req_slave;
@@ -55,6 +62,9 @@ typedef struct {
 	snd_pcm_route_ttable_entry_t *ttable;
 	int ttable_ok;
 	unsigned int tt_ssize, tt_cused, tt_sused;
+	int fused;		/* mix channels in the rate plugin */
+	snd_pcm_t *cache_slave;	/* chain kept over hw_free for the same setup */
+	snd_pcm_plug_params_t cache_clt, cache_slv;
 } snd_pcm_plug_t;
 
 #endif
@@ -63,6 +73,8 @@ static int snd_pcm_plug_close(snd_pcm_t *pcm)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
 	int err, result = 0;
+	if (plug->cache_slave)
+		snd_pcm_close(plug->cache_slave);
 	free(plug->ttable);
 	if (plug->rate_converter) {
 		snd_config_delete(plug->rate_converter);
@@ -348,6 +360,43 @@ static snd_pcm_format_t snd_pcm_plug_slave_format(snd_pcm_format_t format, const
 	return SND_PCM_FORMAT_UNKNOWN;
 }
 
+/* detach the plugin chain and keep it for the next identical hw_params */
+static void snd_pcm_plug_stash(snd_pcm_t *pcm)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	snd_pcm_t *slave = plug->req_slave;
+
+	if (plug->gen.slave == slave)
+		return;
+	if (plug->cache_slave)
+		snd_pcm_close(plug->cache_slave);
+	snd_pcm_unlink_hw_ptr(pcm, plug->gen.slave);
+	snd_pcm_unlink_appl_ptr(pcm, plug->gen.slave);
+	plug->cache_slave = plug->gen.slave;
+	plug->gen.slave = slave;
+	pcm->fast_ops = slave->fast_ops;
+	pcm->fast_op_arg = slave->fast_op_arg;
+}
+
+/* reuse the kept chain when it was built for the same conversions */
+static int snd_pcm_plug_unstash(snd_pcm_t *pcm, snd_pcm_plug_params_t *clt,
+				snd_pcm_plug_params_t *slv)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	snd_pcm_t *cache = plug->cache_slave;
+
+	if (!cache)
+		return 0;
+	plug->cache_slave = NULL;
+	if (memcmp(clt, &plug->cache_clt, sizeof(*clt)) ||
+	    memcmp(slv, &plug->cache_slv, sizeof(*slv))) {
+		snd_pcm_close(cache);
+		return 0;
+	}
+	plug->gen.slave = cache;
+	return 1;
+}
+
 static void snd_pcm_plug_clear(snd_pcm_t *pcm)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
@@ -363,15 +412,6 @@ static void snd_pcm_plug_clear(snd_pcm_t *pcm)
 	}
 }
 
-#ifndef DOC_HIDDEN
-typedef struct {
-	snd_pcm_access_t access;
-	snd_pcm_format_t format;
-	unsigned int channels;
-	unsigned int rate;
-} snd_pcm_plug_params_t;
-#endif
-
 #ifdef BUILD_PCM_PLUGIN_RATE
 static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
 {
@@ -393,23 +433,15 @@ static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plu
 #endif
 
 #ifdef BUILD_PCM_PLUGIN_ROUTE
-static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
+/* fill the clt->channels x slv->channels ttable from the given one or the policy */
+static void snd_pcm_plug_setup_ttable(snd_pcm_t *pcm, snd_pcm_route_ttable_entry_t *ttable,
+				      snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
-	unsigned int tt_ssize, tt_cused, tt_sused;
-	snd_pcm_route_ttable_entry_t *ttable;
-	int err;
-	if (clt->channels == slv->channels &&
-	    (!plug->ttable || plug->ttable_ok))
-		return 0;
-	if (clt->rate != slv->rate &&
-	    clt->channels > slv->channels)
-		return 0;
-	assert(snd_pcm_format_linear(slv->format));
-	tt_ssize = slv->channels;
-	tt_cused = clt->channels;
-	tt_sused = slv->channels;
-	ttable = alloca(tt_cused * tt_sused * sizeof(*ttable));
+	unsigned int tt_ssize = slv->channels;
+	unsigned int tt_cused = clt->channels;
+	unsigned int tt_sused = slv->channels;
+
 	if (plug->ttable) {	/* expand or shrink table */
 		unsigned int c = 0, s = 0;
 		for (c = 0; c < tt_cused; c++) {
@@ -484,6 +516,26 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 			break;
 		}
 	}
+}
+
+static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	unsigned int tt_ssize, tt_cused, tt_sused;
+	snd_pcm_route_ttable_entry_t *ttable;
+	int err;
+	if (clt->channels == slv->channels &&
+	    (!plug->ttable || plug->ttable_ok))
+		return 0;
+	if (clt->rate != slv->rate &&
+	    clt->channels > slv->channels)
+		return 0;
+	assert(snd_pcm_format_linear(slv->format));
+	tt_ssize = slv->channels;
+	tt_cused = clt->channels;
+	tt_sused = slv->channels;
+	ttable = alloca(tt_cused * tt_sused * sizeof(*ttable));
+	snd_pcm_plug_setup_ttable(pcm, ttable, clt, slv);
 	err = snd_pcm_route_open(new, NULL, slv->format, (int) slv->channels, ttable, tt_ssize, tt_cused, tt_sused, plug->gen.slave, plug->gen.slave != plug->req_slave);
 	if (err < 0)
 		return err;
@@ -495,6 +547,57 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 }
 #endif
 
+#if defined(BUILD_PCM_PLUGIN_RATE) && defined(BUILD_PCM_PLUGIN_ROUTE)
+/*
+ * The fused mode: a single rate plugin converts the format and the rate
+ * and mixes the channels in one pass per block, instead of a rate and
+ * a route plugin with their own buffers and passes over the data.
+ */
+static int snd_pcm_plug_change_fused(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	unsigned int tt_ssize, tt_cused, tt_sused;
+	snd_pcm_route_ttable_entry_t *ttable;
+	int err;
+	if (!plug->fused || pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return 0;
+	if (clt->rate == slv->rate)
+		return 0;
+	if (clt->channels == slv->channels &&
+	    (!plug->ttable || plug->ttable_ok))
+		return 0;
+	/* a downmix is cheaper before the rate conversion */
+	if (clt->channels > slv->channels)
+		return 0;
+	if (slv->format != SND_PCM_FORMAT_S16 &&
+	    slv->format != SND_PCM_FORMAT_S32)
+		return 0;
+	if (snd_pcm_format_linear(clt->format) != 1)
+		return 0;
+	tt_ssize = slv->channels;
+	tt_cused = clt->channels;
+	tt_sused = slv->channels;
+	ttable = alloca(tt_cused * tt_sused * sizeof(*ttable));
+	snd_pcm_plug_setup_ttable(pcm, ttable, clt, slv);
+	err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
+				plug->gen.slave, plug->gen.slave != plug->req_slave);
+	if (err < 0)
+		return err;
+	err = snd_pcm_rate_set_route(*new, ttable, tt_ssize, tt_cused, tt_sused);
+	if (err < 0) {
+		/* don't close the slave chain with the new plugin */
+		((snd_pcm_generic_t *)(*new)->private_data)->close_slave = 0;
+		snd_pcm_close(*new);
+		return err;
+	}
+	slv->channels = clt->channels;
+	slv->rate = clt->rate;
+	slv->format = clt->format;
+	slv->access = clt->access;
+	return 1;
+}
+#endif
+
 #ifdef BUILD_PCM_PLUGIN_IEC958
 static int iec958_open(snd_pcm_t **pcmp, const char *name,
 		       snd_pcm_format_t sformat, snd_pcm_t *slave,
@@ -674,6 +777,9 @@ static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
 		snd_pcm_plug_change_mmap,
 #endif
 		snd_pcm_plug_change_format,
+#if defined(BUILD_PCM_PLUGIN_RATE) && defined(BUILD_PCM_PLUGIN_ROUTE)
+		snd_pcm_plug_change_fused,
+#endif
 #ifdef BUILD_PCM_PLUGIN_ROUTE
 		snd_pcm_plug_change_channels,
 #endif
@@ -1057,7 +1163,7 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	INTERNAL(snd_pcm_hw_params_get_format)(&sparams, &slv_params.format);
 	INTERNAL(snd_pcm_hw_params_get_channels)(&sparams, &slv_params.channels);
 	INTERNAL(snd_pcm_hw_params_get_rate)(&sparams, &slv_params.rate, 0);
-	snd_pcm_plug_clear(pcm);
+	snd_pcm_plug_stash(pcm);
 	if (!(clt_params.format == slv_params.format &&
 	      clt_params.channels == slv_params.channels &&
 	      clt_params.rate == slv_params.rate &&
@@ -1065,9 +1171,13 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	      snd_pcm_hw_params_test_access(slave, &sparams,
 					    clt_params.access) >= 0)) {
 		INTERNAL(snd_pcm_hw_params_set_access_first)(slave, &sparams, &slv_params.access);
-		err = snd_pcm_plug_insert_plugins(pcm, &clt_params, &slv_params);
-		if (err < 0)
-			return err;
+		if (!snd_pcm_plug_unstash(pcm, &clt_params, &slv_params)) {
+			err = snd_pcm_plug_insert_plugins(pcm, &clt_params, &slv_params);
+			if (err < 0)
+				return err;
+			plug->cache_clt = clt_params;
+			plug->cache_slv = slv_params;
+		}
 	}
 	slave = plug->gen.slave;
 	err = _snd_pcm_hw_params_internal(slave, params);
@@ -1080,6 +1190,7 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 
 	pcm->fast_ops = slave->fast_ops;
 	pcm->fast_op_arg = slave->fast_op_arg;
+	snd_pcm_profile_link(pcm, slave);
 	snd_pcm_link_hw_ptr(pcm, slave);
 	snd_pcm_link_appl_ptr(pcm, slave);
 	return 0;
@@ -1090,7 +1201,10 @@ static int snd_pcm_plug_hw_free(snd_pcm_t *pcm)
 	snd_pcm_plug_t *plug = pcm->private_data;
 	snd_pcm_t *slave = plug->gen.slave;
 	int err = snd_pcm_hw_free(slave);
-	snd_pcm_plug_clear(pcm);
+	if (err < 0)
+		snd_pcm_plug_clear(pcm);
+	else
+		snd_pcm_plug_stash(pcm);
 	return err;
 }
 
@@ -1236,9 +1350,18 @@ pcm.name {
 	rate_converter [ STR1 STR2 ... ]
 				# type of rate converter
 				# default value is taken from defaults.pcm.rate_converter
+	[fused BOOL]		# mix channels in the rate plugin (default no)
 }
 \endcode
 
+With \c fused enabled, a playback stream which needs both the rate and
+the channel conversion (except a downmix) to a native S16 or S32
+slave format is handled
+by a single rate plugin: the format conversion, the resampling and the
+channel mixing are done block by block through one intermediate buffer,
+instead of a rate and a route plugin.  Other cases fall back to the
+usual chain.
+
 \subsection pcm_plugins_plug_funcref Function reference
 
 <UL>
@@ -1277,6 +1400,7 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int schannels = -1, srate = -1;
 	const snd_config_t *rate_converter = NULL;
+	int fused = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1324,6 +1448,13 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 			continue;
 		}
 #endif
+		if (strcmp(id, "fused") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			fused = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1368,9 +1499,12 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_plug_open(pcmp, name, sformat, schannels, srate, rate_converter,
 				route_policy, ttable, ssize, cused, sused, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_plug_t *)(*pcmp)->private_data)->fused = fused;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_plug_open, SND_PCM_DLSYM_VERSION);
@@ -85,9 +85,237 @@ pcm.rate44100Hz {
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 #include <limits.h>
+#include <sys/mman.h>
 
 #ifndef DOC_HIDDEN
 
+/*
+ * Chain-wide arena for the intermediate buffers
+ *
+ * The scratch buffers of the plugins (rate conversion blocks, mixing
+ * matrices, LADSPA port buffers...) are carved out of a few large
+ * chunks shared by all the plugins of a chain instead of being spread
+ * over the heap.  The blocks are cache line aligned and handed out in
+ * allocation order, which follows the hw_params order of the chain, so
+ * the buffers of the consecutive stages end up next to each other.
+ * Chunks large enough are mmapped and advised to use transparent huge
+ * pages.
+ *
+ * The arena is joined by snd_pcm_generic_hw_params() from the slave
+ * (the allocating stage closest to the hardware creates it) and it is
+ * released with the last PCM of the chain in snd_pcm_free().  A freed
+ * block is reused by a later allocation of the same size or smaller
+ * and the free blocks at the end of a chunk are given back, so a new
+ * hw_params after hw_free does not grow the arena.  Each stage gets its
+ * own blocks: a stage may keep using its buffers while the data is
+ * committed to the slave, so the memory is not shared between the
+ * stages.  With a prefault mode set (see snd_pcm_set_prefault()), the
+ * chunks are faulted in, and locked, at prepare.
+ *
+ * Only the setup paths (hw_params, hw_free, prepare, close) allocate
+ * and free, which are not called concurrently on one chain.
+ */
+#define ARENA_ALIGN		64
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+#define ARENA_HUGE_SIZE		(2 * 1024 * 1024)
+
+struct snd_pcm_arena_chunk {
+	struct snd_pcm_arena_chunk *next;
+	char *base;
+	size_t size;		/* usable bytes at base */
+	size_t used;
+	size_t last;		/* offset of the last block */
+	int mmapped;
+	int locked;		/* mlocked by snd_pcm_arena_prefault() */
+};
+
+struct snd_pcm_arena {
+	unsigned int refs;
+	struct snd_pcm_arena_chunk *chunks;
+};
+
+/* header in front of each block, one cache line */
+typedef union {
+	struct {
+		struct snd_pcm_arena_chunk *chunk;
+		size_t size;	/* with the header */
+		size_t prev;	/* size of the previous block, 0 for the first */
+		int free;
+	} h;
+	char pad[ARENA_ALIGN];
+} snd_pcm_arena_block_t;
+
+static struct snd_pcm_arena_chunk *arena_new_chunk(size_t size)
+{
+	struct snd_pcm_arena_chunk *chunk;
+	void *base;
+
+	chunk = calloc(1, sizeof(*chunk));
+	if (!chunk)
+		return NULL;
+	if (size < ARENA_CHUNK_SIZE)
+		size = ARENA_CHUNK_SIZE;
+	if (size >= ARENA_HUGE_SIZE / 2) {
+		size = (size + ARENA_HUGE_SIZE - 1) & ~((size_t)ARENA_HUGE_SIZE - 1);
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+			madvise(base, size, MADV_HUGEPAGE);
+#endif
+			chunk->mmapped = 1;
+			goto __ok;
+		}
+	}
+	if (posix_memalign(&base, ARENA_ALIGN, size)) {
+		free(chunk);
+		return NULL;
+	}
+ __ok:
+	chunk->base = base;
+	chunk->size = size;
+	return chunk;
+}
+
+static void arena_free_chunk(struct snd_pcm_arena_chunk *chunk)
+{
+	if (chunk->mmapped) {
+		munmap(chunk->base, chunk->size);
+	} else {
+		if (chunk->locked)
+			munlock(chunk->base, chunk->size);
+		free(chunk->base);
+	}
+	free(chunk);
+}
+
+/* first free block of the chunk able to hold need bytes */
+static snd_pcm_arena_block_t *arena_find_free(struct snd_pcm_arena_chunk *chunk,
+					      size_t need)
+{
+	snd_pcm_arena_block_t *block;
+	size_t ofs;
+
+	for (ofs = 0; ofs < chunk->used; ofs += block->h.size) {
+		block = (snd_pcm_arena_block_t *)(chunk->base + ofs);
+		if (block->h.free && block->h.size >= need)
+			return block;
+	}
+	return NULL;
+}
+
+/* share the arena of the slave unless the plugin has one already */
+void snd_pcm_arena_link(snd_pcm_t *pcm, snd_pcm_t *slave)
+{
+	if (pcm->arena || !slave || !slave->arena)
+		return;
+	pcm->arena = slave->arena;
+	pcm->arena->refs++;
+}
+
+/* allocate a cache line aligned block, the contents are undefined */
+void *snd_pcm_arena_alloc(snd_pcm_t *pcm, size_t size)
+{
+	struct snd_pcm_arena *arena = pcm->arena;
+	struct snd_pcm_arena_chunk *chunk;
+	snd_pcm_arena_block_t *block;
+	size_t need;
+
+	if (!arena) {
+		arena = calloc(1, sizeof(*arena));
+		if (!arena)
+			return NULL;
+		arena->refs = 1;
+		pcm->arena = arena;
+	}
+	need = sizeof(*block) + ((size + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1));
+	for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+		block = arena_find_free(chunk, need);
+		if (block) {
+			block->h.free = 0;
+			return block + 1;
+		}
+	}
+	for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+		if (chunk->size - chunk->used >= need)
+			break;
+	}
+	if (!chunk) {
+		chunk = arena_new_chunk(need);
+		if (!chunk)
+			return NULL;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	block = (snd_pcm_arena_block_t *)(chunk->base + chunk->used);
+	block->h.chunk = chunk;
+	block->h.size = need;
+	block->h.prev = chunk->used ? chunk->used - chunk->last : 0;
+	block->h.free = 0;
+	chunk->last = chunk->used;
+	chunk->used += need;
+	return block + 1;
+}
+
+void snd_pcm_arena_free(void *ptr)
+{
+	struct snd_pcm_arena_chunk *chunk;
+	snd_pcm_arena_block_t *block;
+
+	if (!ptr)
+		return;
+	block = (snd_pcm_arena_block_t *)ptr - 1;
+	assert(!block->h.free);
+	block->h.free = 1;
+	chunk = block->h.chunk;
+	/* give back the free blocks at the end of the chunk */
+	while (chunk->used) {
+		block = (snd_pcm_arena_block_t *)(chunk->base + chunk->last);
+		if (!block->h.free)
+			break;
+		chunk->used = chunk->last;
+		chunk->last -= block->h.prev;
+	}
+}
+
+/* drop the reference of the PCM, called from snd_pcm_free() */
+void snd_pcm_arena_put(snd_pcm_t *pcm)
+{
+	struct snd_pcm_arena *arena = pcm->arena;
+	struct snd_pcm_arena_chunk *chunk;
+
+	if (!arena)
+		return;
+	pcm->arena = NULL;
+	if (--arena->refs)
+		return;
+	while ((chunk = arena->chunks) != NULL) {
+		arena->chunks = chunk->next;
+		arena_free_chunk(chunk);
+	}
+	free(arena);
+}
+
+/* fault in (and lock) the chunks of the arena, called at prepare */
+int snd_pcm_arena_prefault(snd_pcm_t *pcm, int lock)
+{
+	struct snd_pcm_arena_chunk *chunk;
+	int err, res = 0;
+
+	if (!pcm->arena)
+		return 0;
+	for (chunk = pcm->arena->chunks; chunk; chunk = chunk->next) {
+		if (lock && chunk->locked)
+			continue;
+		err = snd_pcm_prefault_range(chunk->base, chunk->size, lock, 1);
+		if (err < 0)
+			res = err;
+		else if (lock)
+			chunk->locked = 1;
+	}
+	return res;
+}
+
 static snd_pcm_sframes_t
 snd_pcm_plugin_undo_read(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
 			 const snd_pcm_channel_area_t *res_areas ATTRIBUTE_UNUSED,
@@ -166,6 +394,7 @@ static int snd_pcm_plugin_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
 	int err;
+	plugin->avail_valid = 0;
 	err = snd_pcm_prepare(plugin->gen.slave);
 	if (err < 0)
 		return err;
@@ -176,6 +405,7 @@ static int snd_pcm_plugin_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
 	int err;
+	plugin->avail_valid = 0;
 	err = snd_pcm_reset(plugin->gen.slave);
 	if (err < 0)
 		return err;
@@ -245,17 +475,29 @@ static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 		snd_pcm_uframes_t frames = size;
 		const snd_pcm_channel_area_t *slave_areas;
 		snd_pcm_uframes_t slave_offset;
-		snd_pcm_uframes_t slave_frames = ULONG_MAX;
+		snd_pcm_uframes_t slave_frames = ULONG_MAX, slave_frames2;
+		unsigned long long start;
 		
-		result = snd_pcm_mmap_begin(slave, &slave_areas, &slave_offset, &slave_frames);
+		result = snd_pcm_mmap_begin2(slave, &slave_areas, &slave_offset,
+					     &slave_frames, &slave_frames2);
 		if (result < 0) {
 			err = result;
 			goto error;
 		}
 		if (slave_frames == 0)
 			break;
+		start = snd_pcm_profile_start(pcm);
 		frames = plugin->write(pcm, areas, offset, frames,
 				       slave_areas, slave_offset, &slave_frames);
+		/* go on after the wrap of the slave, committed at once */
+		if (slave_frames2 && frames < size &&
+		    slave_offset + slave_frames == slave->buffer_size) {
+			frames += plugin->write(pcm, areas, offset + frames,
+						size - frames, slave_areas, 0,
+						&slave_frames2);
+			slave_frames += slave_frames2;
+		}
+		snd_pcm_profile_stop(pcm, start, frames);
 		if (CHECK_SANITY(slave_frames > snd_pcm_mmap_playback_avail(slave))) {
 			SNDMSG("write overflow %ld > %ld", slave_frames,
 			       snd_pcm_mmap_playback_avail(slave));
@@ -302,17 +544,29 @@ static snd_pcm_sframes_t snd_pcm_plugin_read_areas(snd_pcm_t *pcm,
 		snd_pcm_uframes_t frames = size;
 		const snd_pcm_channel_area_t *slave_areas;
 		snd_pcm_uframes_t slave_offset;
-		snd_pcm_uframes_t slave_frames = ULONG_MAX;
+		snd_pcm_uframes_t slave_frames = ULONG_MAX, slave_frames2;
+		unsigned long long start;
 		
-		result = snd_pcm_mmap_begin(slave, &slave_areas, &slave_offset, &slave_frames);
+		result = snd_pcm_mmap_begin2(slave, &slave_areas, &slave_offset,
+					     &slave_frames, &slave_frames2);
 		if (result < 0) {
 			err = result;
 			goto error;
 		}
 		if (slave_frames == 0)
 			break;
+		start = snd_pcm_profile_start(pcm);
 		frames = (plugin->read)(pcm, areas, offset, frames,
 				      slave_areas, slave_offset, &slave_frames);
+		/* go on after the wrap of the slave, committed at once */
+		if (slave_frames2 && frames < size &&
+		    slave_offset + slave_frames == slave->buffer_size) {
+			frames += (plugin->read)(pcm, areas, offset + frames,
+					       size - frames, slave_areas, 0,
+					       &slave_frames2);
+			slave_frames += slave_frames2;
+		}
+		snd_pcm_profile_stop(pcm, start, frames);
 		if (CHECK_SANITY(slave_frames > snd_pcm_mmap_capture_avail(slave))) {
 			SNDMSG("read overflow %ld > %ld", slave_frames,
 			       snd_pcm_mmap_playback_avail(slave));
@@ -412,6 +666,7 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 		snd_pcm_uframes_t slave_offset;
 		snd_pcm_uframes_t slave_frames = ULONG_MAX;
 		snd_pcm_sframes_t result;
+		unsigned long long start;
 
 		result = snd_pcm_mmap_begin(slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0) {
@@ -420,8 +675,10 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 		}
 		if (frames > cont)
 			frames = cont;
+		start = snd_pcm_profile_start(pcm);
 		frames = plugin->write(pcm, areas, appl_offset, frames,
 				       slave_areas, slave_offset, &slave_frames);
+		snd_pcm_profile_stop(pcm, start, frames);
 		result = snd_pcm_mmap_commit(slave, slave_offset, slave_frames);
 		if (result > 0 && (snd_pcm_uframes_t)result != slave_frames) {
 			snd_pcm_sframes_t res;
@@ -477,6 +734,7 @@ snd_pcm_plugin_sync_hw_ptr_capture(snd_pcm_t *pcm,
 		snd_pcm_uframes_t slave_offset;
 		snd_pcm_uframes_t slave_frames = ULONG_MAX;
 		snd_pcm_sframes_t result;
+		unsigned long long start;
 		/* As mentioned in the ALSA API (see pcm/pcm.c:942):
 		 * The function #snd_pcm_avail_update()
 		 * have to be called before any mmap begin+commit operation.
@@ -492,8 +750,10 @@ snd_pcm_plugin_sync_hw_ptr_capture(snd_pcm_t *pcm,
 		}
 		if (frames > cont)
 			frames = cont;
+		start = snd_pcm_profile_start(pcm);
 		frames = (plugin->read)(pcm, areas, hw_offset, frames,
 					slave_areas, slave_offset, &slave_frames);
+		snd_pcm_profile_stop(pcm, start, frames);
 		result = snd_pcm_mmap_commit(slave, slave_offset, slave_frames);
 		if (result > 0 && (snd_pcm_uframes_t)result != slave_frames) {
 			snd_pcm_sframes_t res;
@@ -534,14 +794,43 @@ static snd_pcm_sframes_t snd_pcm_plugin_sync_hw_ptr(snd_pcm_t *pcm,
         return slave_size;
 }
 
+/*
+ * Below a pos_snapshot slave, the chain position moves only at a wakeup or
+ * a state change, both bumping the wakeup sequence.  Until then, the avail
+ * read from the slave is reused and only reduced by the frames moved since
+ * then by this plugin, which moves as many on the slave.  The capture with
+ * mmap access is excluded, its avail_update transfers the data.
+ */
 static snd_pcm_sframes_t snd_pcm_plugin_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
 	snd_pcm_t *slave = plugin->gen.slave;
-	snd_pcm_sframes_t slave_size;
+	snd_pcm_sframes_t slave_size, moved;
+	unsigned int seq;
 
+	if (!slave->pos_snapshot ||
+	    (pcm->stream == SND_PCM_STREAM_CAPTURE &&
+	     pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED &&
+	     pcm->access != SND_PCM_ACCESS_RW_NONINTERLEAVED)) {
+		slave_size = snd_pcm_avail_update(slave);
+		return snd_pcm_plugin_sync_hw_ptr(pcm, *slave->hw.ptr, slave_size);
+	}
+
+	seq = snd_pcm_wakeup_seq();
+	if (plugin->avail_valid && plugin->avail_seq == seq) {
+		moved = pcm_frame_diff(*pcm->appl.ptr, plugin->avail_appl,
+				       pcm->boundary);
+		/* a rewind shows as a huge move */
+		if (moved <= plugin->avail)
+			return plugin->avail - moved;
+	}
 	slave_size = snd_pcm_avail_update(slave);
-	return snd_pcm_plugin_sync_hw_ptr(pcm, *slave->hw.ptr, slave_size);
+	slave_size = snd_pcm_plugin_sync_hw_ptr(pcm, *slave->hw.ptr, slave_size);
+	plugin->avail_valid = slave_size >= 0;
+	plugin->avail_seq = seq;
+	plugin->avail_appl = *pcm->appl.ptr;
+	plugin->avail = slave_size;
+	return slave_size;
 }
 
 static int snd_pcm_plugin_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
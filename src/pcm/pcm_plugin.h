@@ -45,6 +45,11 @@ typedef struct {
 	snd_pcm_slave_xfer_areas_undo_func_t undo_write;
 	int (*init)(snd_pcm_t *pcm);
 	snd_pcm_uframes_t appl_ptr, hw_ptr;
+	/* avail of a pos_snapshot slave, kept until the next wakeup */
+	int avail_valid;
+	unsigned int avail_seq;
+	snd_pcm_uframes_t avail_appl;	/* appl_ptr when it was read */
+	snd_pcm_sframes_t avail;
 } snd_pcm_plugin_t;	
 
 /* make local functions really local */
@@ -94,6 +99,13 @@ snd_pcm_sframes_t snd_pcm_plugin_undo_write_generic
 #define snd_pcm_linear_convert_index	snd1_pcm_linear_convert_index
 #define snd_pcm_linear_convert	snd1_pcm_linear_convert
 #define snd_pcm_linear_getput	snd1_pcm_linear_getput
+#define snd_pcm_linear_kernel_convert	snd1_pcm_linear_kernel_convert
+#define snd_pcm_route_matrix_init	snd1_pcm_route_matrix_init
+#define snd_pcm_route_matrix_free	snd1_pcm_route_matrix_free
+#define snd_pcm_route_matrix_convert	snd1_pcm_route_matrix_convert
+#define snd_pcm_route_matrix_compile	snd1_pcm_route_matrix_compile
+#define snd_pcm_rate_set_route		snd1_pcm_rate_set_route
+#define snd_pcm_rate_set_adaptive	snd1_pcm_rate_set_adaptive
 #define snd_pcm_alaw_decode	snd1_pcm_alaw_decode
 #define snd_pcm_alaw_encode	snd1_pcm_alaw_encode
 #define snd_pcm_mulaw_decode	snd1_pcm_mulaw_decode
@@ -113,6 +125,51 @@ void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufra
 			   const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 			   unsigned int channels, snd_pcm_uframes_t frames,
 			   unsigned int get_idx, unsigned int put_idx);
+/* conversion of a packed sample array */
+typedef void (*snd_pcm_linear_kernel_t)(void *dst, const void *src, snd_pcm_uframes_t samples);
+int snd_pcm_linear_kernel_convert(snd_pcm_linear_kernel_t kernel,
+				  const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				  unsigned int dst_width,
+				  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				  unsigned int src_width,
+				  unsigned int channels, snd_pcm_uframes_t frames);
+/* a non-zero coefficient of the mixing matrix, scaled to the formats */
+typedef struct {
+	unsigned int src;
+	float coef;
+} snd_pcm_route_matrix_term_t;
+/* dense channel mixing matrix of the route plugin */
+typedef struct {
+	snd_pcm_format_t src_format;	/* native S16 or S32 */
+	snd_pcm_format_t dst_format;	/* native S16 or S32 */
+	float scale;			/* width change between the formats */
+	unsigned int nsrcs;
+	unsigned int ndsts;
+	float *coef;			/* ndsts x nsrcs */
+	float *work;
+	/* compiled from coef by snd_pcm_route_matrix_compile() */
+	snd_pcm_route_matrix_term_t *terms;	/* the non-zero ones by destination */
+	unsigned int *dst_terms;	/* ndsts + 1 offsets in terms */
+	int *copy;			/* source of a plain copy or -1, by destination */
+	unsigned int *loads;		/* the source channels mixed */
+	unsigned int nloads;
+} snd_pcm_route_matrix_t;
+int snd_pcm_route_matrix_init(snd_pcm_t *pcm, snd_pcm_route_matrix_t *m,
+			      snd_pcm_format_t src_format, snd_pcm_format_t dst_format,
+			      unsigned int nsrcs, unsigned int ndsts);
+int snd_pcm_route_matrix_compile(snd_pcm_t *pcm, snd_pcm_route_matrix_t *m);
+void snd_pcm_route_matrix_free(snd_pcm_route_matrix_t *m);
+void snd_pcm_route_matrix_convert(const snd_pcm_route_matrix_t *m,
+				  const snd_pcm_channel_area_t *dst_areas,
+				  snd_pcm_uframes_t dst_offset,
+				  const snd_pcm_channel_area_t *src_areas,
+				  snd_pcm_uframes_t src_offset,
+				  snd_pcm_uframes_t frames);
+int snd_pcm_rate_set_route(snd_pcm_t *pcm,
+			   const snd_pcm_route_ttable_entry_t *ttable,
+			   unsigned int tt_ssize,
+			   unsigned int tt_cused, unsigned int tt_sused);
+int snd_pcm_rate_set_adaptive(snd_pcm_t *pcm);
 void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
 			 snd_pcm_uframes_t dst_offset,
 			 const snd_pcm_channel_area_t *src_areas,
@@ -0,0 +1,333 @@
+/**
+ * \file pcm/pcm_pool.c
+ * \ingroup PCM_Pool
+ * \brief PCM Handle Pools
+ * \date 2026
+ *
+ * Configured PCM handles parked for a quick reopen.
+ */
+/*
+ *  PCM - Handle pools
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * \page pcm_pool PCM handle pools
+ *
+ * A service playing many short sounds (notifications, voice prompts)
+ * pays for each of them the configuration lookup, the plugin chain
+ * creation, the hw_params negotiation and e.g. the attach to a dmix
+ * server.  A pool keeps the handles returned to it open, set up and
+ * prepared, and hands one back when the same PCM is requested again
+ * with the same parameters, so the first sample can be written at once.
+ *
+ * snd_pcm_pool_get() takes the arguments of snd_pcm_open() and
+ * snd_pcm_set_params().  snd_pcm_pool_put() stops the stream, restores
+ * the software parameters set by snd_pcm_pool_get(), prepares the PCM
+ * and parks it.  A handle whose hardware parameters were changed, or
+ * which cannot be prepared, is closed instead.  When more than
+ * \p max_idle handles would be parked, the one parked the longest is
+ * closed.
+ *
+ * A parked handle keeps its device open, so a hw device stays busy for
+ * the other applications: release the parked handles with
+ * snd_pcm_pool_flush() when the service becomes idle.  A pool is not
+ * thread-safe.
+ *
+ * \code
+ * snd_pcm_pool_open(&pool, 2);
+ * ...
+ * snd_pcm_pool_get(pool, &pcm, "default", SND_PCM_STREAM_PLAYBACK, 0,
+ *		    SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+ *		    2, 48000, 1, 100000);
+ * snd_pcm_writei(pcm, prompt, frames);
+ * snd_pcm_drain(pcm);
+ * snd_pcm_pool_put(pool, pcm);
+ * \endcode
+ */
+
+#ifndef DOC_HIDDEN
+
+struct pool_entry {
+	snd_pcm_t *pcm;
+	char *name;
+	snd_pcm_stream_t stream;
+	int mode;
+	snd_pcm_format_t format;
+	snd_pcm_access_t access;
+	unsigned int channels;
+	unsigned int rate;
+	int soft_resample;
+	unsigned int latency;
+	snd_pcm_hw_params_t hw;		/* the setup made at get */
+	snd_pcm_sw_params_t sw;
+	unsigned int parked;		/* park sequence, 0 while lent */
+};
+
+struct _snd_pcm_pool {
+	unsigned int max_idle;
+	unsigned int count;
+	unsigned int size;
+	unsigned int seq;
+	struct pool_entry *entries;
+};
+
+#endif /* DOC_HIDDEN */
+
+static void pool_remove(snd_pcm_pool_t *pool, unsigned int idx, int do_close)
+{
+	struct pool_entry *e = &pool->entries[idx];
+
+	if (do_close)
+		snd_pcm_close(e->pcm);
+	free(e->name);
+	pool->count--;
+	memmove(e, e + 1, (pool->count - idx) * sizeof(*e));
+}
+
+static int pool_find_lent(snd_pcm_pool_t *pool, snd_pcm_t *pcm)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool->count; i++)
+		if (pool->entries[i].pcm == pcm && !pool->entries[i].parked)
+			return i;
+	return -ENOENT;
+}
+
+/**
+ * \brief Create a PCM handle pool
+ * \param poolp Returned pool handle
+ * \param max_idle Maximal number of the parked handles
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_pool_open(snd_pcm_pool_t **poolp, unsigned int max_idle)
+{
+	snd_pcm_pool_t *pool;
+
+	assert(poolp);
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return -ENOMEM;
+	pool->max_idle = max_idle;
+	*poolp = pool;
+	return 0;
+}
+
+/**
+ * \brief Close the parked handles of a pool
+ * \param pool Pool handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handles taken with snd_pcm_pool_get() and not put back yet stay
+ * open and can still be put back.
+ */
+int snd_pcm_pool_flush(snd_pcm_pool_t *pool)
+{
+	unsigned int i;
+
+	assert(pool);
+	for (i = pool->count; i-- > 0; )
+		if (pool->entries[i].parked)
+			pool_remove(pool, i, 1);
+	return 0;
+}
+
+/**
+ * \brief Free a PCM handle pool
+ * \param pool Pool handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The parked handles are closed.  The handles not put back stay open
+ * and must be closed with snd_pcm_close().
+ */
+int snd_pcm_pool_close(snd_pcm_pool_t *pool)
+{
+	unsigned int i;
+
+	assert(pool);
+	for (i = 0; i < pool->count; i++) {
+		if (pool->entries[i].parked)
+			snd_pcm_close(pool->entries[i].pcm);
+		free(pool->entries[i].name);
+	}
+	free(pool->entries);
+	free(pool);
+	return 0;
+}
+
+/* a parked handle can be handed out when it is still prepared */
+static int pool_ready(snd_pcm_t *pcm)
+{
+	switch (snd_pcm_state(pcm)) {
+	case SND_PCM_STATE_PREPARED:
+		return 1;
+	case SND_PCM_STATE_SETUP:
+	case SND_PCM_STATE_XRUN:
+		return snd_pcm_prepare(pcm) >= 0;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * \brief Get a set up PCM handle from a pool or open a new one
+ * \param pool Pool handle
+ * \param pcmp Returned PCM handle
+ * \param name ASCII identifier of the PCM handle, as for snd_pcm_open()
+ * \param stream Wanted stream
+ * \param mode Open mode (see #SND_PCM_NONBLOCK, #SND_PCM_ASYNC)
+ * \param format required PCM format
+ * \param access required PCM access
+ * \param channels required PCM channels
+ * \param rate required sample rate in Hz
+ * \param soft_resample 0 = disallow alsa-lib resample stream, 1 = allow resampling
+ * \param latency required overall latency in us
+ * \return 0 on success otherwise a negative error code
+ *
+ * A parked handle opened with the same arguments is returned prepared.
+ * Otherwise a new handle is opened and set up with snd_pcm_set_params().
+ * Return the handle with snd_pcm_pool_put() instead of closing it.
+ */
+int snd_pcm_pool_get(snd_pcm_pool_t *pool, snd_pcm_t **pcmp, const char *name,
+		     snd_pcm_stream_t stream, int mode,
+		     snd_pcm_format_t format, snd_pcm_access_t access,
+		     unsigned int channels, unsigned int rate,
+		     int soft_resample, unsigned int latency)
+{
+	struct pool_entry *e;
+	snd_pcm_t *pcm;
+	unsigned int i;
+	int err;
+
+	assert(pool && pcmp && name);
+	for (i = pool->count; i-- > 0; ) {
+		e = &pool->entries[i];
+		if (!e->parked || e->stream != stream || e->mode != mode ||
+		    e->format != format || e->access != access ||
+		    e->channels != channels || e->rate != rate ||
+		    e->soft_resample != soft_resample || e->latency != latency ||
+		    strcmp(e->name, name))
+			continue;
+		if (!pool_ready(e->pcm)) {
+			pool_remove(pool, i, 1);
+			continue;
+		}
+		e->parked = 0;
+		*pcmp = e->pcm;
+		return 0;
+	}
+
+	if (pool->count == pool->size) {
+		e = realloc(pool->entries, (pool->size + 8) * sizeof(*e));
+		if (!e)
+			return -ENOMEM;
+		pool->entries = e;
+		pool->size += 8;
+	}
+	err = snd_pcm_open(&pcm, name, stream, mode);
+	if (err < 0)
+		return err;
+	e = &pool->entries[pool->count];
+	memset(e, 0, sizeof(*e));
+	e->name = strdup(name);
+	if (!e->name) {
+		err = -ENOMEM;
+		goto error;
+	}
+	err = snd_pcm_set_params(pcm, format, access, channels, rate,
+				 soft_resample, latency);
+	if (err >= 0)
+		err = snd_pcm_hw_params_current(pcm, &e->hw);
+	if (err >= 0)
+		err = snd_pcm_sw_params_current(pcm, &e->sw);
+	if (err < 0)
+		goto error;
+	e->pcm = pcm;
+	e->stream = stream;
+	e->mode = mode;
+	e->format = format;
+	e->access = access;
+	e->channels = channels;
+	e->rate = rate;
+	e->soft_resample = soft_resample;
+	e->latency = latency;
+	pool->count++;
+	*pcmp = pcm;
+	return 0;
+
+ error:
+	free(e->name);
+	snd_pcm_close(pcm);
+	return err;
+}
+
+/**
+ * \brief Return a PCM handle to its pool
+ * \param pool Pool handle
+ * \param pcm PCM handle returned by snd_pcm_pool_get()
+ * \return 0 on success otherwise a negative error code
+ *
+ * The stream is stopped (use snd_pcm_drain() before to play the queued
+ * frames).  The handle is then parked, or closed when it cannot be
+ * reused.  In both cases, the caller must not use it anymore.
+ */
+int snd_pcm_pool_put(snd_pcm_pool_t *pool, snd_pcm_t *pcm)
+{
+	snd_pcm_hw_params_t hw;
+	struct pool_entry *e;
+	unsigned int i, idle = 0;
+	int idx, oldest = -1;
+
+	assert(pool && pcm);
+	idx = pool_find_lent(pool, pcm);
+	if (idx < 0)
+		return -EINVAL;
+	e = &pool->entries[idx];
+	if (!pool->max_idle ||
+	    snd_pcm_drop(pcm) < 0 ||
+	    snd_pcm_hw_params_current(pcm, &hw) < 0 ||
+	    memcmp(&hw, &e->hw, sizeof(hw)) ||
+	    snd_pcm_sw_params(pcm, &e->sw) < 0 ||
+	    snd_pcm_prepare(pcm) < 0) {
+		pool_remove(pool, idx, 1);
+		return 0;
+	}
+	e->parked = ++pool->seq;
+
+	/* keep at most max_idle handles, the oldest ones go first */
+	for (;;) {
+		idle = 0;
+		oldest = -1;
+		for (i = 0; i < pool->count; i++) {
+			if (!pool->entries[i].parked)
+				continue;
+			idle++;
+			if (oldest < 0 ||
+			    pool->entries[i].parked < pool->entries[oldest].parked)
+				oldest = i;
+		}
+		if (idle <= pool->max_idle)
+			break;
+		pool_remove(pool, oldest, 1);
+	}
+	return 0;
+}
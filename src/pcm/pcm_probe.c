@@ -0,0 +1,346 @@
+/**
+ * \file pcm/pcm_probe.c
+ * \ingroup PCM_Probe
+ * \brief PCM Latency Probes
+ * \date 2026
+ *
+ * Streaming statistics of the timing of a running PCM.
+ */
+/*
+ *  PCM - Latency probes
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * \page pcm_probe PCM latency probes
+ *
+ * test/latency.c and test/audio_time.c measure the timing of a stream as
+ * standalone tools.  A latency probe gathers the same kind of data for a
+ * PCM of a running application: call snd_pcm_latency_probe_update() at
+ * each wakeup, before the transfer, and read the statistics at any time,
+ * e.g. to export them from a daemon.  Nothing is allocated per update.
+ *
+ * Four values are measured per update, all in microseconds:
+ *
+ * - #SND_PCM_LATENCY_PROBE_SCHED: how late the application woke up,
+ *   i.e. the frames available beyond avail_min,
+ * - #SND_PCM_LATENCY_PROBE_FILL: the queued audio, i.e. the delay of a
+ *   playback and the avail of a capture,
+ * - #SND_PCM_LATENCY_PROBE_JITTER: the difference between the interval
+ *   since the previous update and the period time,
+ * - #SND_PCM_LATENCY_PROBE_DRIFT: the audio time elapsed since the first
+ *   update minus the system time elapsed, from the timestamps of the
+ *   status.  It is measured only when the PCM reports both timestamps,
+ *   see snd_pcm_sw_params_set_tstamp_mode().
+ *
+ * The jitter and the drift are signed.  Each value goes to a histogram
+ * with logarithmic buckets, by its absolute value: bucket 0 holds the
+ * values below 1 us, bucket i the values from 2^(i-1) to 2^i - 1 us and
+ * the last bucket all the larger ones.  The count, minimum, maximum and
+ * mean are kept exactly.  The updates of a PCM not running are
+ * skipped and restart the interval and drift measures.
+ *
+ * A probe is not thread-safe, the updates and the reads of the statistics
+ * must be serialized by the caller.
+ *
+ * \code
+ * snd_pcm_latency_probe_open(&probe, pcm);
+ * for (;;) {
+ *	snd_pcm_wait(pcm, -1);
+ *	snd_pcm_latency_probe_update(probe, NULL);
+ *	snd_pcm_writei(pcm, buf, frames);
+ * }
+ * ...
+ * p99 = snd_pcm_latency_probe_percentile(probe, SND_PCM_LATENCY_PROBE_SCHED, 99);
+ * \endcode
+ */
+
+#ifndef DOC_HIDDEN
+
+#define PROBE_METRICS	(SND_PCM_LATENCY_PROBE_LAST + 1)
+
+struct probe_metric {
+	unsigned long count;
+	long min;
+	long max;
+	long long sum;
+	unsigned long buckets[SND_PCM_LATENCY_PROBE_BUCKETS];
+};
+
+struct _snd_pcm_latency_probe {
+	snd_pcm_t *pcm;
+	struct probe_metric metrics[PROBE_METRICS];
+	struct timespec last;		/* time of the previous update */
+	int running;			/* last and the drift origin are valid */
+	int drift_valid;
+	snd_htimestamp_t audio0;	/* drift origin */
+	snd_htimestamp_t system0;
+};
+
+#endif /* DOC_HIDDEN */
+
+static long long ts_diff_us(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000LL +
+		(a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+static long frames_to_us(snd_pcm_t *pcm, snd_pcm_sframes_t frames)
+{
+	return (long long)frames * 1000000 / pcm->rate;
+}
+
+static unsigned int value_bucket(long value)
+{
+	unsigned long v = value < 0 ? -(unsigned long)value : (unsigned long)value;
+	unsigned int b = 0;
+
+	while (v && b < SND_PCM_LATENCY_PROBE_BUCKETS - 1) {
+		v >>= 1;
+		b++;
+	}
+	return b;
+}
+
+static void metric_add(struct probe_metric *m, long value)
+{
+	if (!m->count || value < m->min)
+		m->min = value;
+	if (!m->count || value > m->max)
+		m->max = value;
+	m->count++;
+	m->sum += value;
+	m->buckets[value_bucket(value)]++;
+}
+
+/**
+ * \brief Create a latency probe for a PCM
+ * \param probep Returned probe handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The probe must be freed with snd_pcm_latency_probe_close() before the
+ * PCM is closed.
+ */
+int snd_pcm_latency_probe_open(snd_pcm_latency_probe_t **probep, snd_pcm_t *pcm)
+{
+	snd_pcm_latency_probe_t *probe;
+
+	assert(probep && pcm);
+	probe = calloc(1, sizeof(*probe));
+	if (!probe)
+		return -ENOMEM;
+	probe->pcm = pcm;
+	*probep = probe;
+	return 0;
+}
+
+/**
+ * \brief Free a latency probe
+ * \param probe Probe handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_latency_probe_close(snd_pcm_latency_probe_t *probe)
+{
+	assert(probe);
+	free(probe);
+	return 0;
+}
+
+/**
+ * \brief Clear the statistics of a latency probe
+ * \param probe Probe handle
+ */
+void snd_pcm_latency_probe_reset(snd_pcm_latency_probe_t *probe)
+{
+	assert(probe);
+	memset(probe->metrics, 0, sizeof(probe->metrics));
+	probe->running = 0;
+	probe->drift_valid = 0;
+}
+
+/**
+ * \brief Measure the current timing of the PCM
+ * \param probe Probe handle
+ * \param status Status of the PCM just read, or NULL to read it here
+ * \return 1 when the values were added, 0 when the PCM is not running,
+ *         otherwise a negative error code
+ *
+ * Call it at each wakeup of the application, before the transfer.  A
+ * daemon reading the status anyway passes it to save a call.
+ */
+int snd_pcm_latency_probe_update(snd_pcm_latency_probe_t *probe,
+				 const snd_pcm_status_t *status)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_status_t st;
+	snd_pcm_sframes_t late;
+	snd_htimestamp_t audio, system;
+	struct timespec now;
+	long long period_us;
+	int err;
+
+	assert(probe);
+	pcm = probe->pcm;
+	if (CHECK_SANITY(!pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!status) {
+		err = snd_pcm_status(pcm, &st);
+		if (err < 0)
+			return err;
+		status = &st;
+	}
+	if (snd_pcm_status_get_state(status) != SND_PCM_STATE_RUNNING) {
+		probe->running = 0;
+		probe->drift_valid = 0;
+		return 0;
+	}
+
+	late = snd_pcm_status_get_avail(status) - pcm->avail_min;
+	metric_add(&probe->metrics[SND_PCM_LATENCY_PROBE_SCHED],
+		   late > 0 ? frames_to_us(pcm, late) : 0);
+	metric_add(&probe->metrics[SND_PCM_LATENCY_PROBE_FILL],
+		   frames_to_us(pcm, pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+				snd_pcm_status_get_delay(status) :
+				(snd_pcm_sframes_t)snd_pcm_status_get_avail(status)));
+
+	if (probe->running) {
+		period_us = frames_to_us(pcm, pcm->period_size);
+		metric_add(&probe->metrics[SND_PCM_LATENCY_PROBE_JITTER],
+			   ts_diff_us(&now, &probe->last) - period_us);
+	}
+	probe->last = now;
+	probe->running = 1;
+
+	snd_pcm_status_get_audio_htstamp(status, &audio);
+	snd_pcm_status_get_htstamp(status, &system);
+	if ((audio.tv_sec || audio.tv_nsec) && (system.tv_sec || system.tv_nsec)) {
+		if (!probe->drift_valid) {
+			probe->audio0 = audio;
+			probe->system0 = system;
+			probe->drift_valid = 1;
+		}
+		metric_add(&probe->metrics[SND_PCM_LATENCY_PROBE_DRIFT],
+			   ts_diff_us(&audio, &probe->audio0) -
+			   ts_diff_us(&system, &probe->system0));
+	}
+	return 1;
+}
+
+/**
+ * \brief Get the summary of a measured value
+ * \param probe Probe handle
+ * \param metric Measured value
+ * \param count Returned number of measures
+ * \param min Returned minimum in us
+ * \param max Returned maximum in us
+ * \param mean Returned mean in us
+ * \return 0 on success otherwise a negative error code
+ *
+ * The minimum, maximum and mean are zero when nothing was measured.
+ */
+int snd_pcm_latency_probe_stats(const snd_pcm_latency_probe_t *probe,
+				snd_pcm_latency_probe_metric_t metric,
+				unsigned long *count, long *min, long *max,
+				long *mean)
+{
+	const struct probe_metric *m;
+
+	assert(probe);
+	if ((unsigned int)metric >= PROBE_METRICS)
+		return -EINVAL;
+	m = &probe->metrics[metric];
+	if (count)
+		*count = m->count;
+	if (min)
+		*min = m->min;
+	if (max)
+		*max = m->max;
+	if (mean)
+		*mean = m->count ? m->sum / (long long)m->count : 0;
+	return 0;
+}
+
+/**
+ * \brief Get the histogram of a measured value
+ * \param probe Probe handle
+ * \param metric Measured value
+ * \param buckets Returned counts of the buckets
+ * \param nbuckets Number of \p buckets
+ * \return the number of buckets filled otherwise a negative error code
+ *
+ * See the \ref pcm_probe page for the bounds of the buckets.  At most
+ * #SND_PCM_LATENCY_PROBE_BUCKETS are filled.
+ */
+int snd_pcm_latency_probe_histogram(const snd_pcm_latency_probe_t *probe,
+				    snd_pcm_latency_probe_metric_t metric,
+				    unsigned long *buckets, unsigned int nbuckets)
+{
+	assert(probe && (buckets || !nbuckets));
+	if ((unsigned int)metric >= PROBE_METRICS)
+		return -EINVAL;
+	if (nbuckets > SND_PCM_LATENCY_PROBE_BUCKETS)
+		nbuckets = SND_PCM_LATENCY_PROBE_BUCKETS;
+	memcpy(buckets, probe->metrics[metric].buckets,
+	       nbuckets * sizeof(*buckets));
+	return nbuckets;
+}
+
+/**
+ * \brief Get a percentile of a measured value
+ * \param probe Probe handle
+ * \param metric Measured value
+ * \param percent Wanted percentile, from 0 to 100
+ * \return the bound in us the percentile is below, otherwise a negative
+ *         error code (-ENODATA when nothing was measured)
+ *
+ * The result is the upper bound of the histogram bucket reaching the
+ * percentile, so it is exact to a factor of two.  For the jitter and the
+ * drift, the percentile is the one of the absolute value.
+ */
+long snd_pcm_latency_probe_percentile(const snd_pcm_latency_probe_t *probe,
+				      snd_pcm_latency_probe_metric_t metric,
+				      unsigned int percent)
+{
+	const struct probe_metric *m;
+	unsigned long long want, seen = 0;
+	unsigned int b;
+
+	assert(probe);
+	if ((unsigned int)metric >= PROBE_METRICS || percent > 100)
+		return -EINVAL;
+	m = &probe->metrics[metric];
+	if (!m->count)
+		return -ENODATA;
+	want = ((unsigned long long)m->count * percent + 99) / 100;
+	if (!want)
+		want = 1;
+	for (b = 0; b < SND_PCM_LATENCY_PROBE_BUCKETS - 1; b++) {
+		seen += m->buckets[b];
+		if (seen >= want)
+			break;
+	}
+	return 1L << b;
+}
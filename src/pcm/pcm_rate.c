@@ -74,14 +74,47 @@ struct _snd_pcm_rate {
 	uint64_t in_formats;
 	uint64_t out_formats;
 	unsigned int format_flags;
+	int low_latency;		/* convert in blocks smaller than a period */
+	snd_pcm_uframes_t cblock;	/* client frames per conversion block */
+	snd_pcm_uframes_t sblock;	/* slave frames per conversion block */
+	int adaptive;			/* drift compensation for playback */
+	snd_pcm_sframes_t adapt_max;	/* max. correction in frames per period */
+	snd_pcm_sframes_t adapt_delta;	/* correction for the next period */
+	snd_pcm_sframes_t adapt_pending; /* committed, not added to hw_ptr yet */
+	int64_t adapt_level;		/* averaged fill level, 16.16 */
+	int64_t adapt_target;		/* settled fill level, 16.16 */
+	int64_t adapt_integ;		/* integral part of the correction, 16.16 */
+	int64_t adapt_frac;		/* fractional correction, 16.16 */
+	unsigned int adapt_periods;
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	unsigned int mix_cchannels;	/* client channels when mixing, 0 otherwise */
+	unsigned int mix_schannels;	/* slave channels when mixing */
+	float *mix_coef;		/* mix_schannels x mix_cchannels */
+	snd_pcm_route_matrix_t matrix;
+	snd_pcm_channel_area_t *mix_buf; /* converted block before mixing */
+#endif
 };
 
+/* the minimal conversion block in the low-latency mode */
+#define LOW_LATENCY_BLOCK_MIN	32
+
+/* adaptive mode: the maximal correction (in ppm), the periods to settle
+ * the target level, the averaging and the PI controller gains (as shifts)
+ */
+#define ADAPT_MAX_PPM		1000
+#define ADAPT_SETTLE		64
+#define ADAPT_AVG_SHIFT		6
+#define ADAPT_GAIN_SHIFT	10
+#define ADAPT_INT_SHIFT		22
+
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
 #endif /* DOC_HIDDEN */
 
-/* allocate a channel area and a temporary buffer for the given size */
+/* allocate a channel area and a temporary buffer for the given size,
+ * the buffer is taken from the arena of the chain
+ */
 static snd_pcm_channel_area_t *
-rate_alloc_tmp_buf(snd_pcm_format_t format,
+rate_alloc_tmp_buf(snd_pcm_t *pcm, snd_pcm_format_t format,
 		   unsigned int channels, unsigned int frames)
 {
 	snd_pcm_channel_area_t *ap;
@@ -91,7 +124,7 @@ rate_alloc_tmp_buf(snd_pcm_format_t format,
 	ap = malloc(sizeof(*ap) * channels);
 	if (!ap)
 		return NULL;
-	ap->addr = malloc(frames * channels * width / 8);
+	ap->addr = snd_pcm_arena_alloc(pcm, (size_t)frames * channels * width / 8);
 	if (!ap->addr) {
 		free(ap);
 		return NULL;
@@ -112,7 +145,7 @@ static void rate_free_tmp_buf(snd_pcm_channel_area_t **ptr)
 	snd_pcm_channel_area_t *c = *ptr;
 
 	if (c) {
-		free(c->addr);
+		snd_pcm_arena_free(c->addr);
 		free(c);
 		*ptr = NULL;
 	}
@@ -124,10 +157,17 @@ static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
 	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+	snd_pcm_format_t f;
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
 		return err;
+	/* float samples only when the converter takes them on both sides,
+	 * they cannot be converted with the linear conversion routines
+	 */
+	for (f = SND_PCM_FORMAT_FLOAT_LE; f <= SND_PCM_FORMAT_FLOAT64_BE; f++)
+		if (rate->in_formats & rate->out_formats & (1ULL << f))
+			snd_pcm_format_mask_set(&format_mask, f);
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_FORMAT,
 					 &format_mask);
 	if (err < 0)
@@ -147,6 +187,14 @@ static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_
 		if (err < 0)
 			return err;
 	}
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_cchannels) {
+		err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_CHANNELS,
+					    rate->mix_cchannels, 0);
+		if (err < 0)
+			return err;
+	}
+#endif
 	params->info &= ~(SND_PCM_INFO_MMAP | SND_PCM_INFO_MMAP_VALID);
 	return 0;
 }
@@ -162,8 +210,14 @@ static int snd_pcm_rate_hw_refine_sprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *
 		_snd_pcm_hw_params_set_format(sparams, rate->sformat);
 		_snd_pcm_hw_params_set_subformat(sparams, SND_PCM_SUBFORMAT_STD);
 	}
-	_snd_pcm_hw_param_set_minmax(sparams, SND_PCM_HW_PARAM_RATE,
-				     rate->srate, 0, rate->srate + 1, -1);
+	if (rate->srate)
+		_snd_pcm_hw_param_set_minmax(sparams, SND_PCM_HW_PARAM_RATE,
+					     rate->srate, 0, rate->srate + 1, -1);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_cchannels)
+		_snd_pcm_hw_param_set(sparams, SND_PCM_HW_PARAM_CHANNELS,
+				      rate->mix_schannels, 0);
+#endif
 	return 0;
 }
 
@@ -182,6 +236,12 @@ static int snd_pcm_rate_hw_refine_schange(snd_pcm_t *pcm, snd_pcm_hw_params_t *p
 			  SND_PCM_HW_PARBIT_SUBFORMAT |
 			  SND_PCM_HW_PARBIT_SAMPLE_BITS |
 			  SND_PCM_HW_PARBIT_FRAME_BITS);
+	if (!rate->srate)
+		links |= SND_PCM_HW_PARBIT_RATE;
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_cchannels)
+		links &= ~SND_PCM_HW_PARBIT_CHANNELS;
+#endif
 	snd_interval_copy(&buffer_size, snd_pcm_hw_param_get_interval(params, SND_PCM_HW_PARAM_BUFFER_SIZE));
 	snd_interval_unfloor(&buffer_size);
 	crate = snd_pcm_hw_param_get_interval(params, SND_PCM_HW_PARAM_RATE);
@@ -215,6 +275,12 @@ static int snd_pcm_rate_hw_refine_cchange(snd_pcm_t *pcm, snd_pcm_hw_params_t *p
 			  SND_PCM_HW_PARBIT_SUBFORMAT |
 			  SND_PCM_HW_PARBIT_SAMPLE_BITS |
 			  SND_PCM_HW_PARBIT_FRAME_BITS);
+	if (!rate->srate)
+		links |= SND_PCM_HW_PARBIT_RATE;
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_cchannels)
+		links &= ~SND_PCM_HW_PARBIT_CHANNELS;
+#endif
 	sbuffer_size = snd_pcm_hw_param_get_interval(sparams, SND_PCM_HW_PARAM_BUFFER_SIZE);
 	crate = snd_pcm_hw_param_get_interval(params, SND_PCM_HW_PARAM_RATE);
 	srate = snd_pcm_hw_param_get_interval(sparams, SND_PCM_HW_PARAM_RATE);
@@ -287,6 +353,9 @@ static int get_best_format(uint64_t mask, snd_pcm_format_t orig)
 	int match = -1;
 	int f, score;
 
+	/* no conversion if the converter handles the format as is */
+	if (mask & (1ULL << orig))
+		return orig;
 	for (f = 0; f <= SND_PCM_FORMAT_LAST; f++) {
 		if (!(mask & (1ULL << f)))
 			continue;
@@ -343,11 +412,92 @@ static int choose_preferred_format(snd_pcm_rate_t *rate)
 		}
 	}
 
+	/* the extra conversion is done by the linear conversion routines */
+	if ((in != rate->orig_in_format &&
+	     (!snd_pcm_format_linear(in) || !snd_pcm_format_linear(rate->orig_in_format))) ||
+	    (out != rate->orig_out_format &&
+	     (!snd_pcm_format_linear(out) || !snd_pcm_format_linear(rate->orig_out_format))))
+		return -ENOENT;
+
 	rate->info.in.format = in;
 	rate->info.out.format = out;
 	return 0;
 }
 
+static snd_pcm_uframes_t rate_gcd(snd_pcm_uframes_t a, snd_pcm_uframes_t b)
+{
+	while (b) {
+		snd_pcm_uframes_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * A period is converted at once unless the low-latency mode is set.
+ * Then the smallest block which keeps the exact ratio of the period sizes
+ * and divides the period is used, so that the converters see the same
+ * phase at each block start as at the period start.
+ */
+static void rate_setup_blocks(snd_pcm_rate_t *rate,
+			      snd_pcm_uframes_t cperiod,
+			      snd_pcm_uframes_t speriod)
+{
+	snd_pcm_uframes_t g, m;
+
+	rate->cblock = cperiod;
+	rate->sblock = speriod;
+	if (!rate->low_latency)
+		return;
+	g = rate_gcd(cperiod, speriod);
+	for (m = 1; m < g; m++) {
+		if (g % m)
+			continue;
+		if (cperiod / g * m >= LOW_LATENCY_BLOCK_MIN &&
+		    speriod / g * m >= LOW_LATENCY_BLOCK_MIN)
+			break;
+	}
+	rate->cblock = cperiod / g * m;
+	rate->sblock = speriod / g * m;
+}
+
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+static void rate_free_mix(snd_pcm_rate_t *rate)
+{
+	snd_pcm_route_matrix_free(&rate->matrix);
+	rate_free_tmp_buf(&rate->mix_buf);
+}
+
+/*
+ * The converted block is kept in mix_buf in the orig_out_format and
+ * mixed to the slave channels and format
+ */
+static int rate_setup_mix(snd_pcm_t *pcm, snd_pcm_rate_side_info_t *sinfo)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	unsigned int size = rate->mix_cchannels * rate->mix_schannels;
+	int err;
+
+	err = snd_pcm_route_matrix_init(pcm, &rate->matrix, rate->orig_out_format,
+					rate->gen.slave->format, rate->mix_cchannels,
+					rate->mix_schannels);
+	if (err < 0)
+		return err;
+	memcpy(rate->matrix.coef, rate->mix_coef, size * sizeof(float));
+	err = snd_pcm_route_matrix_compile(pcm, &rate->matrix);
+	if (err < 0)
+		return err;
+	rate->mix_buf = rate_alloc_tmp_buf(pcm, rate->orig_out_format,
+					   rate->mix_cchannels, sinfo->period_size);
+	if (!rate->mix_buf) {
+		rate_free_mix(rate);
+		return -ENOMEM;
+	}
+	return 0;
+}
+#endif
+
 static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
@@ -400,9 +550,13 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		return -EBUSY;
 	}
 
-	rate->pareas = rate_alloc_tmp_buf(cinfo->format, channels,
-					  cinfo->period_size);
-	rate->sareas = rate_alloc_tmp_buf(sinfo->format, channels,
+	rate_setup_blocks(rate, cinfo->period_size, sinfo->period_size);
+	rate->adapt_max = 0;
+	if (rate->adaptive)
+		rate->adapt_max = rate->cblock * ADAPT_MAX_PPM / 1000000 + 1;
+	rate->pareas = rate_alloc_tmp_buf(pcm, cinfo->format, channels,
+					  cinfo->period_size + rate->adapt_max);
+	rate->sareas = rate_alloc_tmp_buf(pcm, sinfo->format, slave->channels,
 					  sinfo->period_size);
 	if (!rate->pareas || !rate->sareas) {
 		err = -ENOMEM;
@@ -410,6 +564,12 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	}
 
 	rate->orig_in_format = rate->info.in.format;
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	/* resample in the client format, the mixing writes the slave format */
+	if (rate->mix_cchannels &&
+	    (cinfo->format == SND_PCM_FORMAT_S16 || cinfo->format == SND_PCM_FORMAT_S32))
+		rate->info.out.format = cinfo->format;
+#endif
 	rate->orig_out_format = rate->info.out.format;
 	if (choose_preferred_format(rate) < 0) {
 		SNDERR("No matching format in rate plugin");
@@ -441,8 +601,9 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		rate->src_conv_idx =
 			snd_pcm_linear_convert_index(rate->orig_in_format,
 						     rate->info.in.format);
-		rate->src_buf = rate_alloc_tmp_buf(rate->info.in.format,
-						   channels, rate->info.in.period_size);
+		rate->src_buf = rate_alloc_tmp_buf(pcm, rate->info.in.format,
+						   channels, rate->info.in.period_size +
+						   rate->adapt_max);
 		if (!rate->src_buf) {
 			err = -ENOMEM;
 			goto error;
@@ -453,7 +614,7 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		rate->dst_conv_idx =
 			snd_pcm_linear_convert_index(rate->info.out.format,
 						     rate->orig_out_format);
-		rate->dst_buf = rate_alloc_tmp_buf(rate->info.out.format,
+		rate->dst_buf = rate_alloc_tmp_buf(pcm, rate->info.out.format,
 						   channels, rate->info.out.period_size);
 		if (!rate->dst_buf) {
 			err = -ENOMEM;
@@ -461,6 +622,13 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		}
 	}
 
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_cchannels) {
+		err = rate_setup_mix(pcm, sinfo);
+		if (err < 0)
+			goto error;
+	}
+#endif
 	return 0;
 
  error:
@@ -472,6 +640,9 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
  error_pareas:
 	rate_free_tmp_buf(&rate->pareas);
 	rate_free_tmp_buf(&rate->sareas);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	rate_free_mix(rate);
+#endif
 	return err;
 }
 
@@ -481,6 +652,9 @@ static int snd_pcm_rate_hw_free(snd_pcm_t *pcm)
 
 	rate_free_tmp_buf(&rate->pareas);
 	rate_free_tmp_buf(&rate->sareas);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	rate_free_mix(rate);
+#endif
 	if (rate->ops.free)
 		rate->ops.free(rate->obj);
 	rate_free_tmp_buf(&rate->src_buf);
@@ -562,6 +736,13 @@ static int snd_pcm_rate_init(snd_pcm_t *pcm)
 		rate->ops.reset(rate->obj);
 	rate->last_commit_ptr = 0;
 	rate->start_pending = 0;
+	rate->adapt_delta = 0;
+	rate->adapt_pending = 0;
+	rate->adapt_level = 0;
+	rate->adapt_target = 0;
+	rate->adapt_integ = 0;
+	rate->adapt_frac = 0;
+	rate->adapt_periods = 0;
 	return 0;
 }
 
@@ -574,7 +755,16 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 {
 	const snd_pcm_channel_area_t *out_areas;
 	snd_pcm_uframes_t out_offset;
-
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	const snd_pcm_channel_area_t *slave_areas = dst_areas;
+	snd_pcm_uframes_t slave_offset = dst_offset;
+
+	/* mix the final block from the client channels to the slave ones */
+	if (rate->mix_buf) {
+		dst_areas = rate->mix_buf;
+		dst_offset = 0;
+	}
+#endif
 	if (rate->dst_buf) {
 		out_areas = rate->dst_buf;
 		out_offset = 0;
@@ -606,19 +796,40 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 				       rate->dst_buf, 0,
 				       channels, dst_frames,
 				       rate->dst_conv_idx);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_buf)
+		snd_pcm_route_matrix_convert(&rate->matrix,
+					     slave_areas, slave_offset,
+					     rate->mix_buf, 0, dst_frames);
+#endif
 }
 
 static inline void
 snd_pcm_rate_write_areas1(snd_pcm_t *pcm,
 			 const snd_pcm_channel_area_t *areas,
-			 snd_pcm_uframes_t offset,
+			 snd_pcm_uframes_t offset, snd_pcm_uframes_t frames,
 			 const snd_pcm_channel_area_t *slave_areas,
-			 snd_pcm_uframes_t slave_offset)
+			 snd_pcm_uframes_t slave_offset,
+			 snd_pcm_uframes_t slave_frames)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(slave_areas, slave_offset, rate->gen.slave->period_size,
-		   areas, offset, pcm->period_size,
+	unsigned long long start = snd_pcm_profile_start(pcm);
+
+	/* the corrected block is converted with a temporary pitch */
+	if (rate->adapt_delta) {
+		rate->info.in.period_size = frames;
+		rate->info.out.period_size = slave_frames;
+		rate->ops.adjust_pitch(rate->obj, &rate->info);
+	}
+	do_convert(slave_areas, slave_offset, slave_frames,
+		   areas, offset, frames,
 		   pcm->channels, rate);
+	snd_pcm_profile_stop(pcm, start, frames);
+	if (rate->adapt_delta) {
+		rate->info.in.period_size = pcm->period_size;
+		rate->info.out.period_size = rate->gen.slave->period_size;
+		rate->ops.adjust_pitch(rate->obj, &rate->info);
+	}
 }
 
 static inline void
@@ -629,9 +840,12 @@ snd_pcm_rate_read_areas1(snd_pcm_t *pcm,
 			 snd_pcm_uframes_t slave_offset)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(areas, offset, pcm->period_size,
-		   slave_areas, slave_offset, rate->gen.slave->period_size,
+	unsigned long long start = snd_pcm_profile_start(pcm);
+
+	do_convert(areas, offset, rate->cblock,
+		   slave_areas, slave_offset, rate->sblock,
 		   pcm->channels, rate);
+	snd_pcm_profile_stop(pcm, start, rate->cblock);
 }
 
 static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_ptr)
@@ -639,6 +853,7 @@ static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t sl
 	snd_pcm_rate_t *rate;
 	snd_pcm_sframes_t slave_hw_ptr_diff;
 	snd_pcm_sframes_t last_slave_hw_ptr_frac;
+	snd_pcm_sframes_t diff, adj;
 
 	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
 		return;
@@ -657,10 +872,20 @@ static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t sl
 	 * 	fractional part of last_slave_hw_ptr rounded value +
 	 * 	fractional part of updated slave hw ptr's rounded value ]
 	 */
-	rate->hw_ptr += (
-			(((last_slave_hw_ptr_frac + slave_hw_ptr_diff) / rate->gen.slave->period_size) * pcm->period_size) -
-			rate->ops.input_frames(rate->obj, last_slave_hw_ptr_frac) +
-			rate->ops.input_frames(rate->obj, (last_slave_hw_ptr_frac + slave_hw_ptr_diff) % rate->gen.slave->period_size));
+	diff = (((last_slave_hw_ptr_frac + slave_hw_ptr_diff) / rate->gen.slave->period_size) * pcm->period_size) -
+		rate->ops.input_frames(rate->obj, last_slave_hw_ptr_frac) +
+		rate->ops.input_frames(rate->obj, (last_slave_hw_ptr_frac + slave_hw_ptr_diff) % rate->gen.slave->period_size);
+	/* frames added or dropped by the adaptive mode, hw_ptr never
+	 * goes backwards
+	 */
+	if (rate->adapt_pending) {
+		adj = rate->adapt_pending;
+		if (diff + adj < 0)
+			adj = -diff;
+		diff += adj;
+		rate->adapt_pending -= adj;
+	}
+	rate->hw_ptr += diff;
 	rate->last_slave_hw_ptr = slave_hw_ptr;
 
 	rate->hw_ptr %= pcm->boundary;
@@ -745,31 +970,160 @@ static int snd_pcm_rate_reset(snd_pcm_t *pcm)
 	return 0;
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_rewindable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t appl_ptr);
+
+/* the input history re-converted after a rewind, at least the longest
+ * filter of the builtin converters
+ */
+#define REWIND_HISTORY_MIN	512
+
+/*
+ * Playback only: the frames not committed to the slave yet can be always
+ * rewound, the committed ones in whole conversion blocks as long as the
+ * slave can rewind them.  The corrected blocks of the adaptive mode have
+ * no fixed size, so only the uncommitted frames are rewound then.
+ *
+ * Capture: the converted frames stay in the buffer, so the generic
+ * rewind of the application pointer is enough.
+ */
+static snd_pcm_sframes_t snd_pcm_rate_rewindable(snd_pcm_t *pcm)
 {
-	return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_sframes_t avail, frames, slave_frames;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return snd_pcm_mmap_capture_hw_rewindable(pcm);
+	frames = snd_pcm_rate_playback_internal_delay(pcm);
+	if (!rate->adaptive) {
+		slave_frames = snd_pcm_rewindable(rate->gen.slave);
+		if (slave_frames > 0)
+			frames += slave_frames / rate->sblock * rate->cblock;
+	}
+	avail = snd_pcm_mmap_playback_hw_avail(pcm);
+	if (frames > avail)
+		frames = avail;
+	return frames;
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static snd_pcm_sframes_t snd_pcm_rate_forwardable(snd_pcm_t *pcm)
 {
-	return 0;
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return snd_pcm_mmap_capture_avail(pcm);
+	return snd_pcm_mmap_playback_avail(pcm);
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_rewind(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-                                             snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+/*
+ * Bring the converter to the state it had after the block ending at
+ * last_commit_ptr: the converter is reset and the blocks before it are
+ * converted again to a scratch area.  Because the blocks keep the exact
+ * ratio, the phase is the same at every block boundary, and only the
+ * filter history has to be rebuilt.  The client frames are still in the
+ * buffer up to the application pointer before the rewind, old_appl.
+ */
+static void snd_pcm_rate_rewind_history(snd_pcm_t *pcm, snd_pcm_uframes_t old_appl)
 {
-        return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t valid, frames, ptr, ofs, cont;
+
+	if (!rate->ops.reset)
+		return;
+	rate->ops.reset(rate->obj);
+	valid = pcm->buffer_size -
+		pcm_frame_diff(old_appl, rate->last_commit_ptr, pcm->boundary);
+	/* nothing was written before the start of the stream */
+	if (valid > rate->last_commit_ptr)
+		valid = rate->last_commit_ptr;
+	frames = (REWIND_HISTORY_MIN + rate->cblock - 1) / rate->cblock * rate->cblock;
+	if (frames > valid)
+		frames = valid / rate->cblock * rate->cblock;
+	ptr = rate->last_commit_ptr - frames;
+	areas = snd_pcm_mmap_areas(pcm);
+	for (; frames; frames -= rate->cblock, ptr += rate->cblock) {
+		ofs = ptr % pcm->buffer_size;
+		cont = pcm->buffer_size - ofs;
+		if (cont >= rate->cblock) {
+			snd_pcm_rate_write_areas1(pcm, areas, ofs, rate->cblock,
+						  rate->sareas, 0, rate->sblock);
+			continue;
+		}
+		snd_pcm_areas_copy(rate->pareas, 0, areas, ofs,
+				   pcm->channels, cont, pcm->format);
+		snd_pcm_areas_copy(rate->pareas, cont, areas, 0,
+				   pcm->channels, rate->cblock - cont, pcm->format);
+		snd_pcm_rate_write_areas1(pcm, rate->pareas, 0, rate->cblock,
+					  rate->sareas, 0, rate->sblock);
+	}
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-                                              snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+static snd_pcm_sframes_t snd_pcm_rate_rewind(snd_pcm_t *pcm,
+                                             snd_pcm_uframes_t frames)
 {
-        return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_uframes_t uncommitted, blocks;
+	snd_pcm_sframes_t n, result;
+
+	n = snd_pcm_rate_rewindable(pcm);
+	if (n <= 0)
+		return n;
+	if (frames > (snd_pcm_uframes_t)n)
+		frames = n;
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK) {
+		snd_pcm_mmap_appl_backward(pcm, frames);
+		return frames;
+	}
+	uncommitted = snd_pcm_rate_playback_internal_delay(pcm);
+	if (frames > uncommitted) {
+		blocks = (frames - uncommitted) / rate->cblock;
+		if (blocks) {
+			result = snd_pcm_rewind(rate->gen.slave,
+						blocks * rate->sblock);
+			if (result < 0)
+				return result;
+			/* give back a partially rewound block */
+			if (result % rate->sblock) {
+				snd_pcm_forward(rate->gen.slave,
+						result % rate->sblock);
+			}
+			blocks = result / rate->sblock;
+		}
+		if (rate->last_commit_ptr < blocks * rate->cblock)
+			rate->last_commit_ptr += pcm->boundary;
+		rate->last_commit_ptr -= blocks * rate->cblock;
+		if (blocks)
+			snd_pcm_rate_rewind_history(pcm, rate->appl_ptr);
+		frames = uncommitted + blocks * rate->cblock;
+	}
+	snd_pcm_mmap_appl_backward(pcm, frames);
+	return frames;
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm,
+                                              snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_sframes_t n;
+	int err;
+
+	n = snd_pcm_rate_forwardable(pcm);
+	if (n <= 0)
+		return n;
+	if (frames > (snd_pcm_uframes_t)n)
+		frames = n;
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK) {
+		snd_pcm_mmap_appl_forward(pcm, frames);
+		return frames;
+	}
+	err = snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr + frames);
+	if (err < 0)
+		return err;
+	snd_pcm_mmap_appl_forward(pcm, frames);
+	return frames;
 }
 
 static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 				    snd_pcm_uframes_t appl_offset,
-				    snd_pcm_uframes_t size ATTRIBUTE_UNUSED,
+				    snd_pcm_uframes_t size,
 				    snd_pcm_uframes_t slave_size)
 {
 	snd_pcm_uframes_t cont = pcm->buffer_size - appl_offset;
@@ -781,23 +1135,24 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 
 	areas = snd_pcm_mmap_areas(pcm);
 	/*
-	 * Because snd_pcm_rate_write_areas1() below will convert a full source period
-	 * then there had better be a full period available in the current buffer.
+	 * Because snd_pcm_rate_write_areas1() below will convert a full source block
+	 * then there had better be a full block available in the current buffer.
 	 */
-	if (cont >= pcm->period_size) {
+	if (cont >= size) {
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
 		/*
-		 * Because snd_pcm_rate_write_areas1() below will convert to a full slave period
-		 * then there had better be a full slave period available in the slave buffer.
+		 * Because snd_pcm_rate_write_areas1() below will convert to a full slave block
+		 * then there had better be a full slave block available in the slave buffer.
 		 */
-		if (slave_frames < rate->gen.slave->period_size) {
-			snd_pcm_rate_write_areas1(pcm, areas, appl_offset, rate->sareas, 0);
+		if (slave_frames < slave_size) {
+			snd_pcm_rate_write_areas1(pcm, areas, appl_offset, size,
+						  rate->sareas, 0, slave_size);
 			goto __partial;
 		}
-		snd_pcm_rate_write_areas1(pcm, areas, appl_offset,
-					  slave_areas, slave_offset);
+		snd_pcm_rate_write_areas1(pcm, areas, appl_offset, size,
+					  slave_areas, slave_offset, slave_size);
 		/* Only commit the requested slave_size, even if more was actually converted */
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, slave_size);
 		if (result < (snd_pcm_sframes_t)slave_size) {
@@ -815,10 +1170,11 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 				   pcm->format);
 		snd_pcm_areas_copy(rate->pareas, cont,
 				   areas, 0,
-				   pcm->channels, pcm->period_size - cont,
+				   pcm->channels, size - cont,
 				   pcm->format);
 
-		snd_pcm_rate_write_areas1(pcm, rate->pareas, 0, rate->sareas, 0);
+		snd_pcm_rate_write_areas1(pcm, rate->pareas, 0, size,
+					  rate->sareas, 0, slave_size);
 
 		/* ok, commit first fragment */
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
@@ -830,7 +1186,7 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 			cont = slave_size;
 		snd_pcm_areas_copy(slave_areas, slave_offset,
 				   rate->sareas, 0,
-				   pcm->channels, cont,
+				   rate->gen.slave->channels, cont,
 				   rate->gen.slave->format);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
 		if (result < (snd_pcm_sframes_t)cont) {
@@ -860,7 +1216,7 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 #endif
 		snd_pcm_areas_copy(slave_areas, slave_offset,
 				   rate->sareas, xfer,
-				   pcm->channels, cont,
+				   rate->gen.slave->channels, cont,
 				   rate->gen.slave->format);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
 		if (result < (snd_pcm_sframes_t)cont) {
@@ -886,8 +1242,9 @@ static int snd_pcm_rate_commit_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t app
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 
-	return snd_pcm_rate_commit_area(pcm, rate, appl_offset, pcm->period_size,
-					rate->gen.slave->period_size);
+	return snd_pcm_rate_commit_area(pcm, rate, appl_offset,
+					rate->cblock + rate->adapt_delta,
+					rate->sblock);
 }
 
 static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_offset)
@@ -901,16 +1258,16 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 	snd_pcm_sframes_t result;
 
 	areas = snd_pcm_mmap_areas(pcm);
-	if (cont >= pcm->period_size) {
+	if (cont >= rate->cblock) {
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
-		if (slave_frames < rate->gen.slave->period_size)
+		if (slave_frames < rate->sblock)
 			goto __partial;
 		snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
 					 slave_areas, slave_offset);
-		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, rate->gen.slave->period_size);
-		if (result < (snd_pcm_sframes_t)rate->gen.slave->period_size) {
+		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, rate->sblock);
+		if (result < (snd_pcm_sframes_t)rate->sblock) {
 			if (result < 0)
 				return result;
 			result = snd_pcm_rewind(rate->gen.slave, result);
@@ -925,8 +1282,8 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 			return result;
 	      __partial:
 		cont = slave_frames;
-		if (cont > rate->gen.slave->period_size)
-			cont = rate->gen.slave->period_size;
+		if (cont > rate->sblock)
+			cont = rate->sblock;
 		snd_pcm_areas_copy(rate->sareas, 0,
 				   slave_areas, slave_offset,
 				   pcm->channels, cont,
@@ -942,11 +1299,11 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		}
 		xfer = cont;
 
-		if (xfer == rate->gen.slave->period_size)
+		if (xfer == rate->sblock)
 			goto __transfer;
 
 		/* grab second fragment */
-		cont = rate->gen.slave->period_size - cont;
+		cont = rate->sblock - cont;
 		slave_frames = cont;
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
@@ -973,7 +1330,7 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 
 	      __transfer:
 		cont = pcm->buffer_size - hw_offset;
-		if (cont >= pcm->period_size) {
+		if (cont >= rate->cblock) {
 			snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
 						 rate->sareas, 0);
 		} else {
@@ -986,18 +1343,67 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 					   pcm->format);
 			snd_pcm_areas_copy(areas, 0,
 					   rate->pareas, cont,
-					   pcm->channels, pcm->period_size - cont,
+					   pcm->channels, rate->cblock - cont,
 					   pcm->format);
 		}
 	}
 	return 1;
 }
 
+/*
+ * The adaptive mode keeps the total buffered amount (appl_ptr - hw_ptr)
+ * at the level measured after the start.  When the client feeds the data
+ * at a slightly different clock than the slave consumes it, the level
+ * drifts and the number of client frames converted to one slave period
+ * is corrected by up to ADAPT_MAX_PPM.
+ */
+static void snd_pcm_rate_adaptive_update(snd_pcm_t *pcm,
+					 snd_pcm_uframes_t appl_ptr)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	int64_t level, err, corr, max;
+
+	/* the committed correction is applied to hw_ptr with the next sync */
+	rate->adapt_pending += rate->adapt_delta;
+
+	level = (int64_t)pcm_frame_diff(appl_ptr, rate->hw_ptr, pcm->boundary) << 16;
+	if (rate->adapt_periods == 0)
+		rate->adapt_level = level;
+	else
+		rate->adapt_level += (level - rate->adapt_level) >> ADAPT_AVG_SHIFT;
+	if (rate->adapt_periods < ADAPT_SETTLE) {
+		if (++rate->adapt_periods == ADAPT_SETTLE)
+			rate->adapt_target = rate->adapt_level;
+		return;
+	}
+
+	err = rate->adapt_level - rate->adapt_target;
+	max = ((int64_t)rate->cblock << 16) * ADAPT_MAX_PPM / 1000000;
+	/* the integral part follows the steady drift */
+	rate->adapt_integ += err >> ADAPT_INT_SHIFT;
+	if (rate->adapt_integ > max)
+		rate->adapt_integ = max;
+	else if (rate->adapt_integ < -max)
+		rate->adapt_integ = -max;
+	corr = (err >> ADAPT_GAIN_SHIFT) + rate->adapt_integ;
+	if (corr > max)
+		corr = max;
+	else if (corr < -max)
+		corr = -max;
+	rate->adapt_frac += corr;
+	rate->adapt_delta = rate->adapt_frac >> 16;
+	if (rate->adapt_delta > rate->adapt_max)
+		rate->adapt_delta = rate->adapt_max;
+	else if (rate->adapt_delta < -rate->adapt_max)
+		rate->adapt_delta = -rate->adapt_max;
+	rate->adapt_frac -= (int64_t)rate->adapt_delta << 16;
+}
+
 static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t appl_ptr)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	snd_pcm_t *slave = rate->gen.slave;
-	snd_pcm_uframes_t xfer;
+	snd_pcm_uframes_t xfer, psize;
 	snd_pcm_sframes_t slave_size;
 	int err;
 
@@ -1006,18 +1412,23 @@ static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t app
 		return slave_size;
 
 	xfer = pcm_frame_diff(appl_ptr, rate->last_commit_ptr, pcm->boundary);
-	while (xfer >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= rate->gen.slave->period_size) {
+	psize = rate->cblock + rate->adapt_delta;
+	while (xfer >= psize &&
+	       (snd_pcm_uframes_t)slave_size >= rate->sblock) {
 		err = snd_pcm_rate_commit_next_period(pcm, rate->last_commit_ptr % pcm->buffer_size);
 		if (err == 0)
 			break;
 		if (err < 0)
 			return err;
-		xfer -= pcm->period_size;
-		slave_size -= rate->gen.slave->period_size;
-		rate->last_commit_ptr += pcm->period_size;
+		xfer -= psize;
+		slave_size -= rate->sblock;
+		rate->last_commit_ptr += psize;
 		if (rate->last_commit_ptr >= pcm->boundary)
 			rate->last_commit_ptr -= pcm->boundary;
+		if (rate->adaptive) {
+			snd_pcm_rate_adaptive_update(pcm, appl_ptr);
+			psize = rate->cblock + rate->adapt_delta;
+		}
 	}
 	return 0;
 }
@@ -1044,25 +1455,24 @@ static snd_pcm_sframes_t snd_pcm_rate_avail_update_capture(snd_pcm_t *pcm,
 							   snd_pcm_sframes_t slave_size)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	snd_pcm_t *slave = rate->gen.slave;
 	snd_pcm_uframes_t xfer, hw_offset, size;
 	
 	xfer = snd_pcm_mmap_capture_avail(pcm);
 	size = pcm->buffer_size - xfer;
 	hw_offset = snd_pcm_mmap_hw_offset(pcm);
-	while (size >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= slave->period_size) {
+	while (size >= rate->cblock &&
+	       (snd_pcm_uframes_t)slave_size >= rate->sblock) {
 		int err = snd_pcm_rate_grab_next_period(pcm, hw_offset);
 		if (err < 0)
 			return err;
 		if (err == 0)
 			return (snd_pcm_sframes_t)xfer;
-		xfer += pcm->period_size;
-		size -= pcm->period_size;
-		slave_size -= slave->period_size;
-		hw_offset += pcm->period_size;
+		xfer += rate->cblock;
+		size -= rate->cblock;
+		slave_size -= rate->sblock;
+		hw_offset += rate->cblock;
 		hw_offset %= pcm->buffer_size;
-		snd_pcm_mmap_hw_forward(pcm, pcm->period_size);
+		snd_pcm_mmap_hw_forward(pcm, rate->cblock);
 	}
 	return (snd_pcm_sframes_t)xfer;
 }
@@ -1133,6 +1543,8 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 		int commit_err = 0;
 
 		__snd_pcm_lock(pcm);
+		/* the remaining data is committed without corrections */
+		rate->adapt_delta = 0;
 		/* temporarily set avail_min to one */
 		sw_params = rate->sw_params;
 		saved_avail_min = sw_params.avail_min;
@@ -1148,9 +1560,9 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 			err = __snd_pcm_wait_in_lock(rate->gen.slave, SND_PCM_WAIT_DRAIN);
 			if (err < 0)
 				break;
-			if (size > pcm->period_size) {
-				psize = pcm->period_size;
-				spsize = rate->gen.slave->period_size;
+			if (size > rate->cblock) {
+				psize = rate->cblock;
+				spsize = rate->sblock;
 			} else {
 				psize = size;
 				spsize = rate->ops.output_frames(rate->obj, size);
@@ -1262,6 +1674,17 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (rate->ops.dump)
 		rate->ops.dump(rate->obj, out);
 	snd_output_printf(out, "Protocol version: %x\n", rate->plugin_version);
+	if (rate->low_latency && pcm->setup)
+		snd_output_printf(out, "Low-latency mode: blocks %ld -> %ld\n",
+				  rate->cblock, rate->sblock);
+	if (rate->adaptive)
+		snd_output_printf(out, "Adaptive mode: correction %ld frames, pending %ld\n",
+				  rate->adapt_delta, rate->adapt_pending);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->mix_cchannels)
+		snd_output_printf(out, "Channel mixing: %u -> %u\n",
+				  rate->mix_cchannels, rate->mix_schannels);
+#endif
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1278,6 +1701,9 @@ static int snd_pcm_rate_close(snd_pcm_t *pcm)
 		rate->ops.close(rate->obj);
 	if (rate->open_func)
 		snd_dlobj_cache_put(rate->open_func);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	free(rate->mix_coef);
+#endif
 	return snd_pcm_generic_close(pcm);
 }
 
@@ -1307,6 +1733,61 @@ static int snd_pcm_rate_may_wait_for_avail_min(snd_pcm_t *pcm,
 							  snd_pcm_rate_slave_frames);
 }
 
+/* with the channel mixing, a client channel takes its first slave position */
+static snd_pcm_chmap_t *snd_pcm_rate_get_chmap(snd_pcm_t *pcm)
+{
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_chmap_t *map, *slave_map;
+	unsigned int c, s;
+
+	if (!rate->mix_cchannels)
+		return snd_pcm_generic_get_chmap(pcm);
+	slave_map = snd_pcm_generic_get_chmap(pcm);
+	if (!slave_map)
+		return NULL;
+	map = calloc(4, rate->mix_cchannels + 1);
+	if (!map) {
+		free(slave_map);
+		return NULL;
+	}
+	map->channels = rate->mix_cchannels;
+	for (c = 0; c < rate->mix_cchannels; c++) {
+		map->pos[c] = SND_CHMAP_NA;
+		for (s = 0; s < rate->mix_schannels && s < slave_map->channels; s++) {
+			if (rate->mix_coef[s * rate->mix_cchannels + c] != 0) {
+				map->pos[c] = slave_map->pos[s];
+				break;
+			}
+		}
+	}
+	free(slave_map);
+	return map;
+#else
+	return snd_pcm_generic_get_chmap(pcm);
+#endif
+}
+
+static snd_pcm_chmap_query_t **snd_pcm_rate_query_chmaps(snd_pcm_t *pcm)
+{
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_chmap_query_t **maps;
+	snd_pcm_chmap_t *map;
+
+	if (!rate->mix_cchannels)
+		return snd_pcm_generic_query_chmaps(pcm);
+	map = snd_pcm_rate_get_chmap(pcm);
+	if (!map)
+		return NULL;
+	maps = _snd_pcm_make_single_query_chmaps(map);
+	free(map);
+	return maps;
+#else
+	return snd_pcm_generic_query_chmaps(pcm);
+#endif
+}
+
 static const snd_pcm_fast_ops_t snd_pcm_rate_fast_ops = {
 	.status = snd_pcm_rate_status,
 	.state = snd_pcm_rate_state,
@@ -1349,8 +1830,8 @@ static const snd_pcm_ops_t snd_pcm_rate_ops = {
 	.async = snd_pcm_generic_async,
 	.mmap = snd_pcm_generic_mmap,
 	.munmap = snd_pcm_generic_munmap,
-	.query_chmaps = snd_pcm_generic_query_chmaps,
-	.get_chmap = snd_pcm_generic_get_chmap,
+	.query_chmaps = snd_pcm_rate_query_chmaps,
+	.get_chmap = snd_pcm_rate_get_chmap,
 	.set_chmap = snd_pcm_generic_set_chmap,
 };
 
@@ -1395,6 +1876,12 @@ static void rate_initial_setup(snd_pcm_rate_t *rate)
 #ifdef PIC
 static int is_builtin_plugin(const char *type)
 {
+#ifndef HAVE_SOFT_FLOAT
+	if (strcmp(type, "polyphase") == 0 ||
+	    strcmp(type, "polyphase_fast") == 0 ||
+	    strcmp(type, "polyphase_best") == 0)
+		return 1;
+#endif
 	return strcmp(type, "linear") == 0;
 }
 
@@ -1483,7 +1970,7 @@ static int is_string_array(const snd_config_t *conf)
  * \param pcmp Returns created PCM handle
  * \param name Name of PCM
  * \param sformat Slave format
- * \param srate Slave rate
+ * \param srate Slave rate, zero keeps the rate of the client
  * \param converter SRC type string node
  * \param slave Slave PCM handle
  * \param close_slave When set, the slave PCM handle is closed with copy PCM
@@ -1618,11 +2105,66 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+/* the adaptive mode needs a converter which can change the pitch */
+int snd_pcm_rate_set_adaptive(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK) {
+		SNDERR("adaptive mode is supported only for playback");
+		return -EINVAL;
+	}
+	if (!rate->ops.adjust_pitch) {
+		SNDERR("rate converter doesn't support adaptive mode");
+		return -EINVAL;
+	}
+	rate->adaptive = 1;
+	return 0;
+}
+
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+/*
+ * Mix the client channels to the slave channels after the conversion,
+ * the plug plugin uses this instead of a separate route plugin.
+ * The ttable has the same layout as for snd_pcm_route_open().
+ */
+int snd_pcm_rate_set_route(snd_pcm_t *pcm,
+			   const snd_pcm_route_ttable_entry_t *ttable,
+			   unsigned int tt_ssize,
+			   unsigned int tt_cused, unsigned int tt_sused)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	unsigned int c, s;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return -EINVAL;
+	if (rate->sformat != SND_PCM_FORMAT_S16 &&
+	    rate->sformat != SND_PCM_FORMAT_S32)
+		return -EINVAL;
+	if (!tt_cused || !tt_sused)
+		return -EINVAL;
+	free(rate->mix_coef);
+	rate->mix_coef = malloc(tt_cused * tt_sused * sizeof(float));
+	if (!rate->mix_coef)
+		return -ENOMEM;
+	for (c = 0; c < tt_cused; c++)
+		for (s = 0; s < tt_sused; s++)
+			rate->mix_coef[s * tt_cused + c] =
+				(float)ttable[c * tt_ssize + s] /
+				SND_PCM_PLUGIN_ROUTE_FULL;
+	rate->mix_cchannels = tt_cused;
+	rate->mix_schannels = tt_sused;
+	return 0;
+}
+#endif
+
 /*! \page pcm_plugins
 
 \section pcm_plugins_rate Plugin: Rate
 
-This plugin converts a stream rate. The input and output formats must be linear.
+This plugin converts a stream rate. The input and output formats must be linear,
+the float formats are accepted when the converter supports them (the
+built-in linear converter does).
 
 \code
 pcm.name {
@@ -1646,9 +2188,44 @@ pcm.name {
 		name STR	# Convertor type
 		xxx yyy		# optional convertor-specific configuration
 	}
+	[adaptive BOOL]		# Compensate the clock drift (playback only)
+	[low_latency BOOL]	# Convert in blocks smaller than a period
 }
 \endcode
 
+The built-in converters are <code>linear</code> (linear interpolation)
+and the polyphase windowed-sinc FIR converter in three quality tiers,
+<code>polyphase_fast</code>, <code>polyphase</code> and
+<code>polyphase_best</code> (16, 32 and 64 taps at the unity ratio).
+The polyphase converter processes the S16 and S32 formats in float and
+uses the SSE/AVX or NEON instructions when available, it is not built
+with <code>--with-softfloat</code>.  When the ratio
+of the period sizes is a simple one (e.g. 44.1kHz and 48kHz or 48kHz
+and 96kHz), a filter for each output phase is precomputed when the
+stream is set up, otherwise the filters are interpolated.  The other
+converters are loaded from the external plugins.
+
+With <code>adaptive</code> enabled, the plugin follows the amount of the
+buffered data (the difference of the application and hardware pointers)
+and corrects the conversion ratio by up to 0.1% to keep it at the level
+measured after the start.  It is meant for bridges between two cards with
+independent clocks (e.g. the capture of one card written to the
+playback of another one), where the drift would eventually cause an
+xrun.  The converter must support the pitch adjustment (the built-in
+converters do).
+
+The data is normally converted in whole periods, so up to one period
+of data waits in the plugin before it is passed to the slave.  With
+<code>low_latency</code> enabled, the smallest block which keeps the exact
+ratio of the client and slave period sizes (e.g. 147 frames at 44.1kHz
+and 160 frames at 48kHz), but at least 32 frames, is converted as soon
+as it is available.  The playback stream can be rewound by the frames
+not passed to the slave yet and by whole blocks the slave can rewind.
+After rewinding whole blocks, the filter history of the converter is
+rebuilt from the client frames before the new position, so the data
+written again continues without a glitch.  The capture stream can be
+rewound and forwarded within its buffer.
+
 \subsection pcm_plugins_rate_funcref Function reference
 
 <UL>
@@ -1682,6 +2259,8 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int srate = -1;
 	const snd_config_t *converter = NULL;
+	int adaptive = 0;
+	int low_latency = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1698,6 +2277,20 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 			converter = n;
 			continue;
 		}
+		if (strcmp(id, "adaptive") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			adaptive = err;
+			continue;
+		}
+		if (strcmp(id, "low_latency") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			low_latency = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1723,9 +2316,22 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_rate_open(pcmp, name, sformat, (unsigned int) srate,
 				converter, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	if (adaptive) {
+		err = snd_pcm_rate_set_adaptive(*pcmp);
+		if (err < 0) {
+			snd_pcm_close(*pcmp);
+			return err;
+		}
+	}
+	if (low_latency) {
+		snd_pcm_rate_t *rate = (*pcmp)->private_data;
+		rate->low_latency = 1;
+	}
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_rate_open, SND_PCM_DLSYM_VERSION);
@@ -26,24 +26,40 @@
 #include "plugin_ops.h"
 #include "bswap.h"
 #include <inttypes.h>
+#include <math.h>
 
 
 /* LINEAR_DIV needs to be large enough to handle resampling from 768000 -> 8000 */
 #define LINEAR_DIV_SHIFT 19
 #define LINEAR_DIV (1<<LINEAR_DIV_SHIFT)
 
+/* highest integer ratio with a fixed stride function */
+#define LINEAR_RATIO_MAX 4
+
 struct rate_linear {
 	unsigned int get_idx;
 	unsigned int put_idx;
 	unsigned int pitch;
 	unsigned int pitch_shift;	/* for expand interpolation */
 	unsigned int channels;
-	int16_t *old_sample;
+	int get_float;			/* get_idx is a float format index */
+	int put_float;			/* put_idx is a float format index */
+	snd_tmp_float_t *old_sample;	/* .f for the FLOAT, .i for the others */
+	snd_tmp_float_t *prev_sample;	/* for the interleaved functions */
+	unsigned int width;		/* sample width for the interleaved functions */
 	void (*func)(struct rate_linear *rate,
 		     const snd_pcm_channel_area_t *dst_areas,
 		     snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 		     const snd_pcm_channel_area_t *src_areas,
 		     snd_pcm_uframes_t src_offset, unsigned int src_frames);
+	void (*ifunc)(struct rate_linear *rate,
+		      void *dst, unsigned int dst_frames,
+		      const void *src, unsigned int src_frames);
+	unsigned int ratio;		/* integer ratio of the pitch, or 0 */
+	int ratio_weight[LINEAR_RATIO_MAX];	/* expand weights of the phases */
+	void (*nfunc)(struct rate_linear *rate,	/* ifunc for the integer ratios */
+		      void *dst, unsigned int dst_frames,
+		      const void *src, unsigned int src_frames);
 };
 
 static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
@@ -70,18 +86,26 @@ static void linear_expand(struct rate_linear *rate,
 			  const snd_pcm_channel_area_t *src_areas,
 			  snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
-#define GET16_LABELS
-#define PUT16_LABELS
+#define GET32_LABELS
+#define PUT32_LABELS
+#define GET32F_LABELS
+#define PUT32F_LABELS
 #include "plugin_ops.h"
-#undef GET16_LABELS
-#undef PUT16_LABELS
-	void *get = get16_labels[rate->get_idx];
-	void *put = put16_labels[rate->put_idx];
+#undef GET32_LABELS
+#undef PUT32_LABELS
+#undef GET32F_LABELS
+#undef PUT32F_LABELS
+	void *get = rate->get_float ? get32float_labels[rate->get_idx] :
+				      get32_labels[rate->get_idx];
+	void *put = rate->put_float ? put32float_labels[rate->put_idx] :
+				      put32_labels[rate->put_idx];
 	unsigned int get_threshold = rate->pitch;
 	unsigned int channel;
 	unsigned int src_frames1;
 	unsigned int dst_frames1;
-	int16_t sample = 0;
+	int32_t sample = 0;
+	snd_tmp_float_t tmp_float;
+	snd_tmp_double_t tmp_double;
 	unsigned int pos;
 	
 	for (channel = 0; channel < rate->channels; ++channel) {
@@ -90,8 +114,8 @@ static void linear_expand(struct rate_linear *rate,
 		const char *src;
 		char *dst;
 		int src_step, dst_step;
-		int16_t old_sample = 0;
-		int16_t new_sample;
+		int32_t old_sample = 0;
+		int32_t new_sample;
 		int old_weight, new_weight;
 		src = snd_pcm_channel_area_addr(src_area, src_offset);
 		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
@@ -99,7 +123,7 @@ static void linear_expand(struct rate_linear *rate,
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		src_frames1 = 0;
 		dst_frames1 = 0;
-		new_sample = rate->old_sample[channel];
+		new_sample = rate->old_sample[channel].i;
 		pos = get_threshold;
 		while (dst_frames1 < dst_frames) {
 			if (pos >= get_threshold) {
@@ -107,20 +131,24 @@ static void linear_expand(struct rate_linear *rate,
 				old_sample = new_sample;
 				if (src_frames1 < src_frames) {
 					goto *get;
-#define GET16_END after_get
+#define GET32_END after_get
+#define GET32F_END after_get
 #include "plugin_ops.h"
-#undef GET16_END
+#undef GET32_END
+#undef GET32F_END
 				after_get:
 					new_sample = sample;
 				}
 			}
 			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
 			old_weight = 0x10000 - new_weight;
-			sample = (old_sample * old_weight + new_sample * new_weight) >> 16;
+			sample = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
 			goto *put;
-#define PUT16_END after_put
+#define PUT32_END after_put
+#define PUT32F_END after_put
 #include "plugin_ops.h"
-#undef PUT16_END
+#undef PUT32_END
+#undef PUT32F_END
 		after_put:
 			dst += dst_step;
 			dst_frames1++;
@@ -130,7 +158,7 @@ static void linear_expand(struct rate_linear *rate,
 				src_frames1++;
 			}
 		} 
-		rate->old_sample[channel] = new_sample;
+		rate->old_sample[channel].i = new_sample;
 	}
 }
 
@@ -162,7 +190,7 @@ static void linear_expand_s16(struct rate_linear *rate,
 		dst_step = snd_pcm_channel_area_step(dst_area) >> 1;
 		src_frames1 = 0;
 		dst_frames1 = 0;
-		new_sample = rate->old_sample[channel];
+		new_sample = rate->old_sample[channel].i;
 		pos = get_threshold;
 		while (dst_frames1 < dst_frames) {
 			if (pos >= get_threshold) {
@@ -182,7 +210,111 @@ static void linear_expand_s16(struct rate_linear *rate,
 				src_frames1++;
 			}
 		} 
-		rate->old_sample[channel] = new_sample;
+		rate->old_sample[channel].i = new_sample;
+	}
+}
+
+/* optimized version for S32 format */
+static void linear_expand_s32(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int pos;
+	
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const int32_t *src;
+		int32_t *dst;
+		int src_step, dst_step;
+		int32_t old_sample = 0;
+		int32_t new_sample;
+		int old_weight, new_weight;
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		new_sample = rate->old_sample[channel].i;
+		pos = get_threshold;
+		while (dst_frames1 < dst_frames) {
+			if (pos >= get_threshold) {
+				pos -= get_threshold;
+				old_sample = new_sample;
+				if (src_frames1 < src_frames)
+					new_sample = *src;
+			}
+			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+			old_weight = 0x10000 - new_weight;
+			*dst = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
+			dst += dst_step;
+			dst_frames1++;
+			pos += LINEAR_DIV;
+			if (pos >= get_threshold) {
+				src += src_step;
+				src_frames1++;
+			}
+		} 
+		rate->old_sample[channel].i = new_sample;
+	}
+}
+
+/* optimized version for native FLOAT format */
+static void linear_expand_float(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int pos;
+	
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const float *src;
+		float *dst;
+		int src_step, dst_step;
+		float old_sample = 0;
+		float new_sample;
+		int old_weight, new_weight;
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		new_sample = rate->old_sample[channel].f;
+		pos = get_threshold;
+		while (dst_frames1 < dst_frames) {
+			if (pos >= get_threshold) {
+				pos -= get_threshold;
+				old_sample = new_sample;
+				if (src_frames1 < src_frames)
+					new_sample = *src;
+			}
+			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+			old_weight = 0x10000 - new_weight;
+			*dst = (old_sample * old_weight + new_sample * new_weight) * (1.0f / 0x10000);
+			dst += dst_step;
+			dst_frames1++;
+			pos += LINEAR_DIV;
+			if (pos >= get_threshold) {
+				src += src_step;
+				src_frames1++;
+			}
+		} 
+		rate->old_sample[channel].f = new_sample;
 	}
 }
 
@@ -192,18 +324,26 @@ static void linear_shrink(struct rate_linear *rate,
 			  const snd_pcm_channel_area_t *src_areas,
 			  snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
-#define GET16_LABELS
-#define PUT16_LABELS
+#define GET32_LABELS
+#define PUT32_LABELS
+#define GET32F_LABELS
+#define PUT32F_LABELS
 #include "plugin_ops.h"
-#undef GET16_LABELS
-#undef PUT16_LABELS
-	void *get = get16_labels[rate->get_idx];
-	void *put = put16_labels[rate->put_idx];
+#undef GET32_LABELS
+#undef PUT32_LABELS
+#undef GET32F_LABELS
+#undef PUT32F_LABELS
+	void *get = rate->get_float ? get32float_labels[rate->get_idx] :
+				      get32_labels[rate->get_idx];
+	void *put = rate->put_float ? put32float_labels[rate->put_idx] :
+				      put32_labels[rate->put_idx];
 	unsigned int get_increment = rate->pitch;
 	unsigned int channel;
 	unsigned int src_frames1;
 	unsigned int dst_frames1;
-	int16_t sample = 0;
+	int32_t sample = 0;
+	snd_tmp_float_t tmp_float;
+	snd_tmp_double_t tmp_double;
 	unsigned int pos;
 
 	for (channel = 0; channel < rate->channels; ++channel) {
@@ -212,8 +352,8 @@ static void linear_shrink(struct rate_linear *rate,
 		const char *src;
 		char *dst;
 		int src_step, dst_step;
-		int16_t old_sample = 0;
-		int16_t new_sample = 0;
+		int32_t old_sample = 0;
+		int32_t new_sample = 0;
 		int old_weight, new_weight;
 		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
 		src = snd_pcm_channel_area_addr(src_area, src_offset);
@@ -225,9 +365,11 @@ static void linear_shrink(struct rate_linear *rate,
 		while (src_frames1 < src_frames) {
 			
 			goto *get;
-#define GET16_END after_get
+#define GET32_END after_get
+#define GET32F_END after_get
 #include "plugin_ops.h"
-#undef GET16_END
+#undef GET32_END
+#undef GET32F_END
 		after_get:
 			new_sample = sample;
 			src += src_step;
@@ -237,11 +379,13 @@ static void linear_shrink(struct rate_linear *rate,
 				pos -= LINEAR_DIV;
 				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
 				new_weight = 0x10000 - old_weight;
-				sample = (old_sample * old_weight + new_sample * new_weight) >> 16;
+				sample = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
 				goto *put;
-#define PUT16_END after_put
+#define PUT32_END after_put
+#define PUT32F_END after_put
 #include "plugin_ops.h"
-#undef PUT16_END
+#undef PUT32_END
+#undef PUT32F_END
 			after_put:
 				dst += dst_step;
 				dst_frames1++;
@@ -307,6 +451,386 @@ static void linear_shrink_s16(struct rate_linear *rate,
 	}
 }
 
+/* optimized version for S32 format */
+static void linear_shrink_s32(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int get_increment = rate->pitch;
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int pos = 0;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const int32_t *src;
+		int32_t *dst;
+		int src_step, dst_step;
+		int32_t old_sample = 0;
+		int32_t new_sample = 0;
+		int old_weight, new_weight;
+		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		while (src_frames1 < src_frames) {
+			
+			new_sample = *src;
+			src += src_step;
+			src_frames1++;
+			pos += get_increment;
+			if (pos >= LINEAR_DIV) {
+				pos -= LINEAR_DIV;
+				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+				new_weight = 0x10000 - old_weight;
+				*dst = ((int64_t)old_sample * old_weight + (int64_t)new_sample * new_weight) >> 16;
+				dst += dst_step;
+				dst_frames1++;
+				if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+					SNDERR("dst_frames overflow");
+					break;
+				}
+			}
+			old_sample = new_sample;
+		}
+	}
+}
+
+/* optimized version for native FLOAT format */
+static void linear_shrink_float(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int get_increment = rate->pitch;
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int pos = 0;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const float *src;
+		float *dst;
+		int src_step, dst_step;
+		float old_sample = 0;
+		float new_sample = 0;
+		int old_weight, new_weight;
+		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		while (src_frames1 < src_frames) {
+			
+			new_sample = *src;
+			src += src_step;
+			src_frames1++;
+			pos += get_increment;
+			if (pos >= LINEAR_DIV) {
+				pos -= LINEAR_DIV;
+				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+				new_weight = 0x10000 - old_weight;
+				*dst = (old_sample * old_weight + new_sample * new_weight) * (1.0f / 0x10000);
+				dst += dst_step;
+				dst_frames1++;
+				if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+					SNDERR("dst_frames overflow");
+					break;
+				}
+			}
+			old_sample = new_sample;
+		}
+	}
+}
+
+/*
+ * Interleaved versions: all channels of a frame are processed together,
+ * the inner loops over the channels use the same weights and are
+ * vectorized by the compiler.  The results are identical to the
+ * per-channel functions above.
+ */
+static void linear_expand_s16_interleaved(struct rate_linear *rate,
+					  void *dst_ptr, unsigned int dst_frames,
+					  const void *src_ptr, unsigned int src_frames)
+{
+	const int16_t *src = src_ptr;
+	int16_t *dst = dst_ptr;
+	snd_tmp_float_t *new_sample = rate->old_sample;
+	snd_tmp_float_t *old_sample = rate->prev_sample;
+	unsigned int channels = rate->channels;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int src_frames1 = 0;
+	unsigned int dst_frames1;
+	unsigned int pos = get_threshold;
+	unsigned int c;
+	int old_weight, new_weight;
+
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		if (pos >= get_threshold) {
+			pos -= get_threshold;
+			for (c = 0; c < channels; c++)
+				old_sample[c].i = new_sample[c].i;
+			if (src_frames1 < src_frames)
+				for (c = 0; c < channels; c++)
+					new_sample[c].i = src[c];
+		}
+		new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+		old_weight = 0x10000 - new_weight;
+		for (c = 0; c < channels; c++)
+			dst[c] = (old_sample[c].i * old_weight +
+				  new_sample[c].i * new_weight) >> 16;
+		dst += channels;
+		pos += LINEAR_DIV;
+		if (pos >= get_threshold) {
+			src += channels;
+			src_frames1++;
+		}
+	}
+}
+
+static void linear_expand_float_interleaved(struct rate_linear *rate,
+					    void *dst_ptr, unsigned int dst_frames,
+					    const void *src_ptr, unsigned int src_frames)
+{
+	const float *src = src_ptr;
+	float *dst = dst_ptr;
+	snd_tmp_float_t *new_sample = rate->old_sample;
+	snd_tmp_float_t *old_sample = rate->prev_sample;
+	unsigned int channels = rate->channels;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int src_frames1 = 0;
+	unsigned int dst_frames1;
+	unsigned int pos = get_threshold;
+	unsigned int c;
+	int old_weight, new_weight;
+
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		if (pos >= get_threshold) {
+			pos -= get_threshold;
+			for (c = 0; c < channels; c++)
+				old_sample[c].f = new_sample[c].f;
+			if (src_frames1 < src_frames)
+				for (c = 0; c < channels; c++)
+					new_sample[c].f = src[c];
+		}
+		new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+		old_weight = 0x10000 - new_weight;
+		for (c = 0; c < channels; c++)
+			dst[c] = (old_sample[c].f * old_weight +
+				  new_sample[c].f * new_weight) * (1.0f / 0x10000);
+		dst += channels;
+		pos += LINEAR_DIV;
+		if (pos >= get_threshold) {
+			src += channels;
+			src_frames1++;
+		}
+	}
+}
+
+static void linear_shrink_s16_interleaved(struct rate_linear *rate,
+					  void *dst_ptr, unsigned int dst_frames,
+					  const void *src_ptr, unsigned int src_frames)
+{
+	const int16_t *src = src_ptr;
+	int16_t *dst = dst_ptr;
+	snd_tmp_float_t *old_sample = rate->prev_sample;
+	unsigned int channels = rate->channels;
+	unsigned int get_increment = rate->pitch;
+	unsigned int src_frames1;
+	unsigned int dst_frames1 = 0;
+	unsigned int pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+	unsigned int c;
+	int old_weight, new_weight;
+
+	for (c = 0; c < channels; c++)
+		old_sample[c].i = 0;
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		pos += get_increment;
+		if (pos >= LINEAR_DIV) {
+			pos -= LINEAR_DIV;
+			old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+			new_weight = 0x10000 - old_weight;
+			for (c = 0; c < channels; c++)
+				dst[c] = (old_sample[c].i * old_weight +
+					  src[c] * new_weight) >> 16;
+			dst += channels;
+			dst_frames1++;
+			if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+				SNDERR("dst_frames overflow");
+				break;
+			}
+		}
+		for (c = 0; c < channels; c++)
+			old_sample[c].i = src[c];
+		src += channels;
+	}
+}
+
+static void linear_shrink_float_interleaved(struct rate_linear *rate,
+					    void *dst_ptr, unsigned int dst_frames,
+					    const void *src_ptr, unsigned int src_frames)
+{
+	const float *src = src_ptr;
+	float *dst = dst_ptr;
+	snd_tmp_float_t *old_sample = rate->prev_sample;
+	unsigned int channels = rate->channels;
+	unsigned int get_increment = rate->pitch;
+	unsigned int src_frames1;
+	unsigned int dst_frames1 = 0;
+	unsigned int pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+	unsigned int c;
+	int old_weight, new_weight;
+
+	for (c = 0; c < channels; c++)
+		old_sample[c].f = 0;
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		pos += get_increment;
+		if (pos >= LINEAR_DIV) {
+			pos -= LINEAR_DIV;
+			old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+			new_weight = 0x10000 - old_weight;
+			for (c = 0; c < channels; c++)
+				dst[c] = (old_sample[c].f * old_weight +
+					  src[c] * new_weight) * (1.0f / 0x10000);
+			dst += channels;
+			dst_frames1++;
+			if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+				SNDERR("dst_frames overflow");
+				break;
+			}
+		}
+		for (c = 0; c < channels; c++)
+			old_sample[c].f = src[c];
+		src += channels;
+	}
+}
+
+/*
+ * Integer ratio versions of the interleaved functions: with a pitch of
+ * exactly 2, 3 or 4 times LINEAR_DIV (or its half and quarter for the
+ * shrink), and whole source frames in each block, the phases repeat with
+ * a fixed stride.  The expand weights are computed once, the shrink keeps
+ * every ratio-th frame.  The results are identical to the functions above.
+ */
+static void linear_expand_n_s16_interleaved(struct rate_linear *rate,
+					    void *dst_ptr, unsigned int dst_frames ATTRIBUTE_UNUSED,
+					    const void *src_ptr, unsigned int src_frames)
+{
+	const int16_t *src = src_ptr;
+	int16_t *dst = dst_ptr;
+	snd_tmp_float_t *last = rate->old_sample;
+	unsigned int channels = rate->channels;
+	unsigned int ratio = rate->ratio;
+	unsigned int src_frames1, k, c;
+	int old_weight, new_weight;
+
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		for (k = 0; k < ratio; k++) {
+			new_weight = rate->ratio_weight[k];
+			old_weight = 0x10000 - new_weight;
+			for (c = 0; c < channels; c++)
+				dst[c] = (last[c].i * old_weight +
+					  src[c] * new_weight) >> 16;
+			dst += channels;
+		}
+		for (c = 0; c < channels; c++)
+			last[c].i = src[c];
+		src += channels;
+	}
+}
+
+static void linear_expand_n_float_interleaved(struct rate_linear *rate,
+					      void *dst_ptr, unsigned int dst_frames ATTRIBUTE_UNUSED,
+					      const void *src_ptr, unsigned int src_frames)
+{
+	const float *src = src_ptr;
+	float *dst = dst_ptr;
+	snd_tmp_float_t *last = rate->old_sample;
+	unsigned int channels = rate->channels;
+	unsigned int ratio = rate->ratio;
+	unsigned int src_frames1, k, c;
+	int old_weight, new_weight;
+
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		for (k = 0; k < ratio; k++) {
+			new_weight = rate->ratio_weight[k];
+			old_weight = 0x10000 - new_weight;
+			for (c = 0; c < channels; c++)
+				dst[c] = (last[c].f * old_weight +
+					  src[c] * new_weight) * (1.0f / 0x10000);
+			dst += channels;
+		}
+		for (c = 0; c < channels; c++)
+			last[c].f = src[c];
+		src += channels;
+	}
+}
+
+static void linear_shrink_n_s16_interleaved(struct rate_linear *rate,
+					    void *dst_ptr, unsigned int dst_frames,
+					    const void *src_ptr, unsigned int src_frames ATTRIBUTE_UNUSED)
+{
+	const int16_t *src = src_ptr;
+	int16_t *dst = dst_ptr;
+	unsigned int channels = rate->channels;
+	unsigned int stride = rate->ratio * channels;
+	unsigned int dst_frames1, c;
+
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		for (c = 0; c < channels; c++)
+			dst[c] = src[c];
+		dst += channels;
+		src += stride;
+	}
+}
+
+static void linear_shrink_n_float_interleaved(struct rate_linear *rate,
+					      void *dst_ptr, unsigned int dst_frames,
+					      const void *src_ptr, unsigned int src_frames ATTRIBUTE_UNUSED)
+{
+	const float *src = src_ptr;
+	float *dst = dst_ptr;
+	unsigned int channels = rate->channels;
+	unsigned int stride = rate->ratio * channels;
+	unsigned int dst_frames1, c;
+
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		for (c = 0; c < channels; c++)
+			dst[c] = src[c];
+		dst += channels;
+		src += stride;
+	}
+}
+
+/* all channels in one buffer, one frame after another */
+static int areas_interleaved(const snd_pcm_channel_area_t *areas,
+			     unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	if (areas[0].first % 8)
+		return 0;
+	for (c = 0; c < channels; c++) {
+		if (areas[c].addr != areas[0].addr ||
+		    areas[c].first != areas[0].first + c * width ||
+		    areas[c].step != channels * width)
+			return 0;
+	}
+	return 1;
+}
+
 static void linear_convert(void *obj, 
 			   const snd_pcm_channel_area_t *dst_areas,
 			   snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
@@ -314,6 +838,20 @@ static void linear_convert(void *obj,
 			   snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
 	struct rate_linear *rate = obj;
+
+	if (rate->ifunc &&
+	    areas_interleaved(src_areas, rate->channels, rate->width) &&
+	    areas_interleaved(dst_areas, rate->channels, rate->width)) {
+		int whole = rate->pitch >= LINEAR_DIV ?
+			dst_frames == src_frames * rate->ratio :
+			src_frames == dst_frames * rate->ratio;
+		(rate->ratio && whole ? rate->nfunc : rate->ifunc)(rate,
+			    snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			    dst_frames,
+			    snd_pcm_channel_area_addr(src_areas, src_offset),
+			    src_frames);
+		return;
+	}
 	rate->func(rate, dst_areas, dst_offset, dst_frames,
 		   src_areas, src_offset, src_frames);
 }
@@ -324,39 +862,122 @@ static void linear_free(void *obj)
 
 	free(rate->old_sample);
 	rate->old_sample = NULL;
+	free(rate->prev_sample);
+	rate->prev_sample = NULL;
+}
+
+/* index to the get32/put32 float labels */
+static int float_index(snd_pcm_format_t format)
+{
+	int endian;
+
+#ifdef SND_LITTLE_ENDIAN
+	endian = snd_pcm_format_big_endian(format);
+#else
+	endian = snd_pcm_format_little_endian(format);
+#endif
+	return (snd_pcm_format_physical_width(format) == 64 ? 2 : 0) + endian;
 }
 
 static int linear_init(void *obj, snd_pcm_rate_info_t *info)
 {
 	struct rate_linear *rate = obj;
+	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 
-	rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S16);
-	rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, info->out.format);
+	rate->get_float = snd_pcm_format_float(info->in.format) == 1;
+	if (rate->get_float)
+		rate->get_idx = float_index(info->in.format);
+	else
+		rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S32);
+	rate->put_float = snd_pcm_format_float(info->out.format) == 1;
+	if (rate->put_float)
+		rate->put_idx = float_index(info->out.format);
+	else
+		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, info->out.format);
+	if (info->in.format == info->out.format)
+		format = info->in.format;
 	if (info->in.rate < info->out.rate) {
-		if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
+		if (format == SND_PCM_FORMAT_S16)
 			rate->func = linear_expand_s16;
+		else if (format == SND_PCM_FORMAT_S32)
+			rate->func = linear_expand_s32;
+		else if (format == SND_PCM_FORMAT_FLOAT)
+			rate->func = linear_expand_float;
 		else
 			rate->func = linear_expand;
+		if (format == SND_PCM_FORMAT_S16) {
+			rate->ifunc = linear_expand_s16_interleaved;
+			rate->nfunc = linear_expand_n_s16_interleaved;
+		} else if (format == SND_PCM_FORMAT_FLOAT) {
+			rate->ifunc = linear_expand_float_interleaved;
+			rate->nfunc = linear_expand_n_float_interleaved;
+		} else
+			rate->ifunc = NULL;
 		/* pitch is get_threshold */
 	} else {
-		if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
+		if (format == SND_PCM_FORMAT_S16)
 			rate->func = linear_shrink_s16;
+		else if (format == SND_PCM_FORMAT_S32)
+			rate->func = linear_shrink_s32;
+		else if (format == SND_PCM_FORMAT_FLOAT)
+			rate->func = linear_shrink_float;
 		else
 			rate->func = linear_shrink;
+		if (format == SND_PCM_FORMAT_S16) {
+			rate->ifunc = linear_shrink_s16_interleaved;
+			rate->nfunc = linear_shrink_n_s16_interleaved;
+		} else if (format == SND_PCM_FORMAT_FLOAT) {
+			rate->ifunc = linear_shrink_float_interleaved;
+			rate->nfunc = linear_shrink_n_float_interleaved;
+		} else
+			rate->ifunc = NULL;
 		/* pitch is get_increment */
 	}
 	rate->pitch = (((uint64_t)info->out.rate * LINEAR_DIV) +
 		       (info->in.rate / 2)) / info->in.rate;
 	rate->channels = info->channels;
+	rate->width = snd_pcm_format_physical_width(format);
+	rate->ratio = 0;
 
 	free(rate->old_sample);
+	free(rate->prev_sample);
 	rate->old_sample = malloc(sizeof(*rate->old_sample) * rate->channels);
-	if (! rate->old_sample)
+	rate->prev_sample = malloc(sizeof(*rate->prev_sample) * rate->channels);
+	if (! rate->old_sample || ! rate->prev_sample)
 		return -ENOMEM;
 
 	return 0;
 }
 
+/*
+ * detects a pitch that is an exact integer ratio, and computes the
+ * weights of the expand phases as linear_expand() does
+ */
+static void linear_set_ratio(struct rate_linear *rate)
+{
+	unsigned int k;
+
+	rate->ratio = 0;
+	if (!rate->ifunc)
+		return;
+	if (rate->pitch >= LINEAR_DIV) {
+		if (rate->pitch % LINEAR_DIV ||
+		    rate->pitch / LINEAR_DIV > LINEAR_RATIO_MAX)
+			return;
+		rate->ratio = rate->pitch / LINEAR_DIV;
+		for (k = 0; k < rate->ratio; k++)
+			rate->ratio_weight[k] = ((k * LINEAR_DIV) << (16 - rate->pitch_shift)) /
+				(rate->pitch >> rate->pitch_shift);
+	} else {
+		if (LINEAR_DIV % rate->pitch ||
+		    LINEAR_DIV / rate->pitch > LINEAR_RATIO_MAX)
+			return;
+		rate->ratio = LINEAR_DIV / rate->pitch;
+	}
+	if (rate->ratio == 1)
+		rate->ratio = 0;
+}
+
 static int linear_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
 {
 	struct rate_linear *rate = obj;
@@ -387,6 +1008,7 @@ static int linear_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
 		while ((rate->pitch >> rate->pitch_shift) >= (1 << 16))
 			rate->pitch_shift++;
 	}
+	linear_set_ratio(rate);
 	return 0;
 }
 
@@ -412,6 +1034,22 @@ static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
 	return 0;
 }
 
+/* all linear and float formats are converted in one pass */
+static int get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				 uint64_t *in_formats, uint64_t *out_formats,
+				 unsigned int *flags)
+{
+	uint64_t formats = 0;
+	int f;
+
+	for (f = 0; f <= SND_PCM_FORMAT_LAST && f < 64; f++)
+		if (snd_pcm_format_linear(f) == 1 || snd_pcm_format_float(f) == 1)
+			formats |= 1ULL << f;
+	*in_formats = *out_formats = formats;
+	*flags = 0;
+	return 0;
+}
+
 static void linear_dump(ATTRIBUTE_UNUSED void *rate, snd_output_t *out)
 {
 	snd_output_printf(out, "Converter: linear-interpolation\n");
@@ -429,6 +1067,7 @@ static const snd_pcm_rate_ops_t linear_ops = {
 	.version = SND_PCM_RATE_PLUGIN_VERSION,
 	.get_supported_rates = get_supported_rates,
 	.dump = linear_dump,
+	.get_supported_formats = get_supported_formats,
 };
 
 int SND_PCM_RATE_PLUGIN_ENTRY(linear) (ATTRIBUTE_UNUSED unsigned int version,
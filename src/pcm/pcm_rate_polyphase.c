@@ -0,0 +1,630 @@
+/*
+ *  Polyphase FIR rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Windowed-sinc (Kaiser) interpolation with a precomputed filter bank.
+ *
+ * When the ratio of the period sizes reduces to a small number of output
+ * phases (e.g. 147:160 for 44.1kHz <-> 48kHz or 1:2 for 48kHz <-> 96kHz),
+ * the bank holds exactly one filter for each phase and every output sample
+ * is computed with a single dot product.  Otherwise a bank with a fixed
+ * number of phases is built and the two nearest filters are interpolated.
+ *
+ * The samples are processed as float internally, each channel keeps the
+ * last (taps - 1) input samples as history for the next period.
+ */
+
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+#include <math.h>
+#include <inttypes.h>
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define POLYPHASE_SIMD_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define POLYPHASE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+/* the filter length is always a multiple of this */
+#define POLYPHASE_TAPS_ALIGN	8
+#define POLYPHASE_TAPS_MAX	512
+/* max. number of phases for the exact (non-interpolated) bank */
+#define POLYPHASE_EXACT_MAX	1024
+/* max. number of coefficients in the exact bank */
+#define POLYPHASE_BANK_MAX	(128 * 1024)
+
+enum {
+	POLYPHASE_FAST,
+	POLYPHASE_MEDIUM,
+	POLYPHASE_BEST,
+};
+
+static const struct polyphase_quality {
+	const char *name;
+	unsigned int taps;		/* filter length at unity ratio */
+	double cutoff;			/* relative to the lower Nyquist frequency */
+	double beta;			/* Kaiser window parameter */
+	unsigned int phases;		/* phases of the interpolated bank */
+} qualities[] = {
+	[POLYPHASE_FAST] = { "fast", 16, 0.85, 6.0, 64 },
+	[POLYPHASE_MEDIUM] = { "medium", 32, 0.91, 8.0, 128 },
+	[POLYPHASE_BEST] = { "best", 64, 0.95, 10.0, 256 },
+};
+
+/* filter bank, shared through the coefficient cache */
+struct polyphase_bank {
+	unsigned int taps;
+	unsigned int phases;
+	int exact;			/* one filter for each output phase */
+	float coef[];			/* phases (+ 1 if interpolated) * taps */
+};
+
+typedef float (*polyphase_dot_t)(const float *a, const float *b,
+				 unsigned int taps);
+
+struct rate_polyphase {
+	const struct polyphase_quality *quality;
+	unsigned int channels;
+	unsigned int in_period;
+	unsigned int out_period;
+	snd_pcm_format_t in_format;
+	snd_pcm_format_t out_format;
+	unsigned int taps;
+	unsigned int phases;
+	int exact;
+	struct polyphase_bank *filters;
+	const float *bank;		/* filters->coef */
+	unsigned int max_frames;	/* input frames per convert call */
+	float *hist;			/* channels * (taps - 1 + max_frames) */
+	polyphase_dot_t dot;
+};
+
+/*
+ * dot products, all sizes are multiples of POLYPHASE_TAPS_ALIGN
+ */
+static float dot_generic(const float *a, const float *b, unsigned int taps)
+{
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef POLYPHASE_SIMD_X86
+__attribute__((target("sse")))
+static float dot_sse(const float *a, const float *b, unsigned int taps)
+{
+	__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+	float r[4];
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 8) {
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i),
+					       _mm_loadu_ps(b + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+					       _mm_loadu_ps(b + i + 4)));
+	}
+	_mm_storeu_ps(r, _mm_add_ps(s0, s1));
+	return (r[0] + r[1]) + (r[2] + r[3]);
+}
+
+__attribute__((target("avx")))
+static float dot_avx(const float *a, const float *b, unsigned int taps)
+{
+	__m256 s = _mm256_setzero_ps();
+	__m128 h;
+	float r[4];
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 8)
+		s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+						   _mm256_loadu_ps(b + i)));
+	h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+	_mm_storeu_ps(r, h);
+	return (r[0] + r[1]) + (r[2] + r[3]);
+}
+#endif
+
+#ifdef POLYPHASE_SIMD_NEON
+static float dot_neon(const float *a, const float *b, unsigned int taps)
+{
+	float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+	float32x2_t h;
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 8) {
+		s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+		s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+	}
+	s0 = vaddq_f32(s0, s1);
+	h = vadd_f32(vget_low_f32(s0), vget_high_f32(s0));
+	return vget_lane_f32(vpadd_f32(h, h), 0);
+}
+#endif
+
+static polyphase_dot_t select_dot(void)
+{
+#if defined(POLYPHASE_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx"))
+		return dot_avx;
+	if (__builtin_cpu_supports("sse"))
+		return dot_sse;
+#elif defined(POLYPHASE_SIMD_NEON)
+	return dot_neon;
+#endif
+	return dot_generic;
+}
+
+static const char *dot_name(polyphase_dot_t dot)
+{
+#if defined(POLYPHASE_SIMD_X86)
+	if (dot == dot_avx)
+		return "avx";
+	if (dot == dot_sse)
+		return "sse";
+#elif defined(POLYPHASE_SIMD_NEON)
+	if (dot == dot_neon)
+		return "neon";
+#endif
+	return "generic";
+}
+
+/*
+ * filter bank
+ */
+
+/* zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	unsigned int k;
+
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * The filter for the fractional position f (0 <= f < 1) is applied to the
+ * taps input samples ending at the integer position, i.e. the output is
+ * delayed by (taps / 2) input samples.
+ */
+static void build_filter(struct rate_polyphase *rate, unsigned int taps,
+			 float *coef, double f)
+{
+	double half = taps / 2;
+	double fc, x, w, sum = 0;
+	unsigned int k;
+
+	fc = rate->quality->cutoff;
+	if (rate->out_period < rate->in_period)
+		fc = fc * rate->out_period / rate->in_period;
+	for (k = 0; k < taps; k++) {
+		x = k - half - f + 1;
+		if (fabs(x) >= half) {
+			coef[k] = 0;
+			continue;
+		}
+		w = bessel_i0(rate->quality->beta * sqrt(1 - (x / half) * (x / half)));
+		if (x == 0)
+			coef[k] = fc * w;
+		else
+			coef[k] = fc * sin(M_PI * fc * x) / (M_PI * fc * x) * w;
+		sum += coef[k];
+	}
+	/* unity gain for DC in all phases */
+	for (k = 0; k < taps; k++)
+		coef[k] /= sum;
+}
+
+static void *create_bank(void *arg)
+{
+	struct rate_polyphase *rate = arg;
+	struct polyphase_bank *bank;
+	unsigned int taps, phases, entries, p;
+	unsigned int ratio;
+	int exact;
+
+	taps = rate->quality->taps;
+	/* keep the number of zero crossings when downsampling */
+	if (rate->in_period > rate->out_period) {
+		ratio = (rate->in_period + rate->out_period - 1) / rate->out_period;
+		taps *= ratio;
+	}
+	if (taps > POLYPHASE_TAPS_MAX)
+		taps = POLYPHASE_TAPS_MAX;
+	taps = (taps + POLYPHASE_TAPS_ALIGN - 1) & ~(POLYPHASE_TAPS_ALIGN - 1);
+
+	phases = rate->out_period / gcd(rate->in_period, rate->out_period);
+	exact = phases <= POLYPHASE_EXACT_MAX &&
+		phases * taps <= POLYPHASE_BANK_MAX;
+	if (exact)
+		entries = phases;
+	else {
+		phases = rate->quality->phases;
+		entries = phases + 1;
+	}
+
+	bank = malloc(sizeof(*bank) + sizeof(float) * entries * taps);
+	if (!bank)
+		return NULL;
+	bank->taps = taps;
+	bank->phases = phases;
+	bank->exact = exact;
+	for (p = 0; p < entries; p++)
+		build_filter(rate, taps, bank->coef + p * taps,
+			     (double)p / phases);
+	return bank;
+}
+
+/* the bank depends only on the reduced ratio and the quality */
+static int build_bank(struct rate_polyphase *rate)
+{
+	struct polyphase_bank *bank;
+
+	bank = snd_coef_cache_get("polyphase", rate->in_period,
+				  rate->out_period, rate->quality - qualities,
+				  create_bank, free, rate);
+	if (!bank)
+		return -ENOMEM;
+	if (rate->filters)
+		snd_coef_cache_put(rate->filters);
+	rate->filters = bank;
+	rate->taps = bank->taps;
+	rate->phases = bank->phases;
+	rate->exact = bank->exact;
+	rate->bank = bank->coef;
+	return 0;
+}
+
+static int alloc_history(struct rate_polyphase *rate)
+{
+	free(rate->hist);
+	rate->hist = calloc(rate->channels * (rate->taps - 1 + rate->max_frames),
+			    sizeof(float));
+	if (!rate->hist)
+		return -ENOMEM;
+	return 0;
+}
+
+/*
+ * conversion
+ */
+
+static void load_samples(struct rate_polyphase *rate, float *dst,
+			 const snd_pcm_channel_area_t *src_area,
+			 snd_pcm_uframes_t src_offset, unsigned int frames)
+{
+	const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+	int src_step = snd_pcm_channel_area_step(src_area);
+	unsigned int i;
+
+	if (rate->in_format == SND_PCM_FORMAT_S16) {
+		for (i = 0; i < frames; i++, src += src_step)
+			dst[i] = *(const int16_t *)src * (1.0f / 0x8000);
+	} else {
+		for (i = 0; i < frames; i++, src += src_step)
+			dst[i] = *(const int32_t *)src * (1.0f / 0x80000000U);
+	}
+}
+
+static inline void store_sample(struct rate_polyphase *rate, char *dst,
+				float v)
+{
+	if (rate->out_format == SND_PCM_FORMAT_S16) {
+		v *= 0x8000;
+		if (v >= 0x7fff)
+			*(int16_t *)dst = 0x7fff;
+		else if (v <= -0x8000)
+			*(int16_t *)dst = -0x8000;
+		else
+			*(int16_t *)dst = lrintf(v);
+	} else {
+		if (v >= 1.0f)
+			*(int32_t *)dst = 0x7fffffff;
+		else if (v <= -1.0f)
+			*(int32_t *)dst = (int32_t)0x80000000;
+		else
+			*(int32_t *)dst = lrintf(v * 0x80000000U);
+	}
+}
+
+static void polyphase_convert(void *obj,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	struct rate_polyphase *rate = obj;
+	unsigned int taps = rate->taps;
+	unsigned int hist_len = taps - 1 + rate->max_frames;
+	unsigned int step_int, step_frac, interval;
+	unsigned int channel, i;
+	int exact;
+
+	if (!dst_frames)
+		return;
+	if (CHECK_SANITY(src_frames > rate->max_frames)) {
+		SNDERR("src_frames overflow");
+		src_frames = rate->max_frames;
+	}
+	/* the position of the output frame i in the input is
+	 * i * src_frames / dst_frames
+	 */
+	step_int = src_frames / dst_frames;
+	step_frac = src_frames % dst_frames;
+	interval = dst_frames;
+	exact = rate->exact &&
+		(uint64_t)src_frames * rate->out_period ==
+		(uint64_t)dst_frames * rate->in_period;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		float *hist = rate->hist + channel * hist_len;
+		char *dst;
+		int dst_step;
+		unsigned int pos = 0, frac = 0;
+
+		load_samples(rate, hist + taps - 1, &src_areas[channel],
+			     src_offset, src_frames);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		dst_step = snd_pcm_channel_area_step(dst_area);
+		for (i = 0; i < dst_frames; i++) {
+			const float *x = hist + pos;
+			float v;
+
+			if (exact) {
+				/* frac * phases / interval is an integer here */
+				v = rate->dot(x, rate->bank + taps *
+					      (uint64_t)frac * rate->phases / interval,
+					      taps);
+			} else if (rate->exact) {
+				/* partial period, use the nearest filter */
+				unsigned int p = ((uint64_t)frac * rate->phases +
+						  interval / 2) / interval;
+				if (p >= rate->phases)
+					p = rate->phases - 1;
+				v = rate->dot(x, rate->bank + taps * p, taps);
+			} else {
+				uint64_t f = (uint64_t)frac * rate->phases;
+				unsigned int p = f / interval;
+				float w = (float)(f % interval) / interval;
+				const float *c = rate->bank + taps * p;
+				float v0 = rate->dot(x, c, taps);
+				float v1 = rate->dot(x, c + taps, taps);
+				v = v0 + (v1 - v0) * w;
+			}
+			store_sample(rate, dst, v);
+			dst += dst_step;
+			pos += step_int;
+			frac += step_frac;
+			if (frac >= interval) {
+				frac -= interval;
+				pos++;
+			}
+		}
+		memmove(hist, hist + src_frames, (taps - 1) * sizeof(float));
+	}
+}
+
+/*
+ * rate plugin callbacks
+ */
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_polyphase *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->in_period, rate->out_period);
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_polyphase *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->out_period, rate->in_period);
+}
+
+static void set_ratio(struct rate_polyphase *rate, unsigned int in_frames,
+		      unsigned int out_frames)
+{
+	unsigned int g = gcd(in_frames, out_frames);
+
+	rate->in_period = in_frames / g;
+	rate->out_period = out_frames / g;
+}
+
+static void polyphase_free(void *obj)
+{
+	struct rate_polyphase *rate = obj;
+
+	if (rate->filters)
+		snd_coef_cache_put(rate->filters);
+	rate->filters = NULL;
+	rate->bank = NULL;
+	free(rate->hist);
+	rate->hist = NULL;
+}
+
+static int polyphase_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_polyphase *rate = obj;
+	int err;
+
+	rate->channels = info->channels;
+	rate->in_format = info->in.format;
+	rate->out_format = info->out.format;
+	rate->max_frames = info->in.period_size;
+	rate->dot = select_dot();
+	/* the period sizes define the real conversion ratio */
+	if (info->in.period_size && info->out.period_size)
+		set_ratio(rate, info->in.period_size, info->out.period_size);
+	else
+		set_ratio(rate, info->in.rate, info->out.rate);
+
+	err = build_bank(rate);
+	if (err < 0)
+		return err;
+	return alloc_history(rate);
+}
+
+static int polyphase_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_polyphase *rate = obj;
+	unsigned int in_period = rate->in_period;
+	unsigned int out_period = rate->out_period;
+	unsigned int taps = rate->taps;
+	int err;
+
+	if (!info->in.period_size || !info->out.period_size)
+		return -EINVAL;
+	set_ratio(rate, info->in.period_size, info->out.period_size);
+	if (rate->in_period == in_period && rate->out_period == out_period)
+		return 0;
+	err = build_bank(rate);
+	if (err < 0)
+		return err;
+	/* keep the history for small corrections of the ratio */
+	if (rate->taps == taps && info->in.period_size <= rate->max_frames)
+		return 0;
+	if (info->in.period_size > rate->max_frames)
+		rate->max_frames = info->in.period_size;
+	return alloc_history(rate);
+}
+
+static void polyphase_reset(void *obj)
+{
+	struct rate_polyphase *rate = obj;
+
+	if (rate->hist)
+		memset(rate->hist, 0, sizeof(float) * rate->channels *
+		       (rate->taps - 1 + rate->max_frames));
+}
+
+static void polyphase_close(void *obj)
+{
+	free(obj);
+}
+
+static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+			       unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+static int get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				 uint64_t *in_formats, uint64_t *out_formats,
+				 unsigned int *flags)
+{
+	*in_formats = *out_formats = (1ULL << SND_PCM_FORMAT_S16) |
+				     (1ULL << SND_PCM_FORMAT_S32);
+	*flags = 0;
+	return 0;
+}
+
+static void polyphase_dump(void *obj, snd_output_t *out)
+{
+	struct rate_polyphase *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase-fir (%s)\n",
+			  rate->quality->name);
+	if (rate->bank)
+		snd_output_printf(out, "  %u taps, %u %s phases, %s\n",
+				  rate->taps, rate->phases,
+				  rate->exact ? "exact" : "interpolated",
+				  dot_name(rate->dot));
+}
+
+static const snd_pcm_rate_ops_t polyphase_ops = {
+	.close = polyphase_close,
+	.init = polyphase_init,
+	.free = polyphase_free,
+	.reset = polyphase_reset,
+	.adjust_pitch = polyphase_adjust_pitch,
+	.convert = polyphase_convert,
+	.input_frames = input_frames,
+	.output_frames = output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = get_supported_rates,
+	.dump = polyphase_dump,
+	.get_supported_formats = get_supported_formats,
+};
+
+static int polyphase_open(unsigned int version, void **objp,
+			  snd_pcm_rate_ops_t *ops, unsigned int quality)
+{
+	struct rate_polyphase *rate;
+
+	if (version < 0x010003)
+		return -EINVAL;
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+	rate->quality = &qualities[quality];
+
+	*objp = rate;
+	*ops = polyphase_ops;
+	return 0;
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast) (unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return polyphase_open(version, objp, ops, POLYPHASE_FAST);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase) (unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return polyphase_open(version, objp, ops, POLYPHASE_MEDIUM);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best) (unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return polyphase_open(version, objp, ops, POLYPHASE_BEST);
+}
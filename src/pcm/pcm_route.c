@@ -69,8 +69,12 @@ typedef struct {
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
+	/* dense mixing matrix, precompiled at hw_params time */
+	snd_pcm_route_matrix_t matrix;
 } snd_pcm_route_params_t;
 
+#define ROUTE_MATRIX_FRAMES	256
+
 
 typedef void (*route_f)(const snd_pcm_channel_area_t *dst_area,
 			snd_pcm_uframes_t dst_offset,
@@ -395,6 +399,318 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 }
 
+/*
+ * Dense matrix mixing: the source channels are loaded into contiguous
+ * float blocks, each destination channel is then a sum of scaled
+ * blocks.  The inner loops are plain array loops which the compiler
+ * vectorizes.
+ */
+static void route_matrix_load(float *dst, const snd_pcm_channel_area_t *src_area,
+			      snd_pcm_uframes_t src_offset, unsigned int frames,
+			      snd_pcm_format_t format)
+{
+	const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+	int src_step = snd_pcm_channel_area_step(src_area);
+	unsigned int i;
+
+	if (format == SND_PCM_FORMAT_S16) {
+		if (src_step == 2) {
+			const int16_t *s = (const int16_t *)src;
+			for (i = 0; i < frames; i++)
+				dst[i] = s[i];
+		} else {
+			for (i = 0; i < frames; i++, src += src_step)
+				dst[i] = *(const int16_t *)src;
+		}
+	} else {
+		if (src_step == 4) {
+			const int32_t *s = (const int32_t *)src;
+			for (i = 0; i < frames; i++)
+				dst[i] = s[i];
+		} else {
+			for (i = 0; i < frames; i++, src += src_step)
+				dst[i] = *(const int32_t *)src;
+		}
+	}
+}
+
+static void route_matrix_store(const snd_pcm_channel_area_t *dst_area,
+			       snd_pcm_uframes_t dst_offset, const float *src,
+			       unsigned int frames, snd_pcm_format_t format)
+{
+	char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+	int dst_step = snd_pcm_channel_area_step(dst_area);
+	unsigned int i;
+
+	if (format == SND_PCM_FORMAT_S16) {
+		for (i = 0; i < frames; i++, dst += dst_step) {
+			float v = src[i];
+			int16_t sample;
+			if (v > 32767.0f)
+				v = 32767.0f;
+			else if (v < -32768.0f)
+				v = -32768.0f;
+			/* round down as the S32 -> S16 shift does */
+			sample = v;
+			if (sample > v)
+				sample--;
+			*(int16_t *)dst = sample;
+		}
+	} else {
+		for (i = 0; i < frames; i++, dst += dst_step) {
+			float v = src[i];
+			if (v >= 2147483648.0f)
+				*(int32_t *)dst = 0x7fffffff;
+			else if (v <= -2147483648.0f)
+				*(int32_t *)dst = (int32_t)0x80000000;
+			else
+				*(int32_t *)dst = v + (v < 0 ? -0.5f : 0.5f);
+		}
+	}
+}
+
+/* such a destination is a plain sample copy */
+static void route_matrix_copy(const snd_pcm_channel_area_t *dst_area,
+			      snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_area,
+			      snd_pcm_uframes_t src_offset, unsigned int frames,
+			      snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
+{
+	const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+	char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+	int src_step = snd_pcm_channel_area_step(src_area);
+	int dst_step = snd_pcm_channel_area_step(dst_area);
+	unsigned int i;
+
+	if (src_format == dst_format) {
+		snd_pcm_area_copy(dst_area, dst_offset, src_area, src_offset,
+				  frames, dst_format);
+	} else if (src_format == SND_PCM_FORMAT_S16) {
+		for (i = 0; i < frames; i++, src += src_step, dst += dst_step)
+			*(int32_t *)dst = (uint32_t)*(const int16_t *)src << 16;
+	} else {
+		for (i = 0; i < frames; i++, src += src_step, dst += dst_step)
+			*(int16_t *)dst = *(const int32_t *)src >> 16;
+	}
+}
+
+/*
+ * Allocate a zeroed ndsts x nsrcs matrix for the native S16 or S32
+ * formats; the caller fills in the coefficients and compiles them with
+ * snd_pcm_route_matrix_compile().  The width change
+ * between the formats is applied while mixing.  The matrix and its
+ * work buffer are taken from the arena of the chain of pcm.
+ */
+int snd_pcm_route_matrix_init(snd_pcm_t *pcm, snd_pcm_route_matrix_t *m,
+			      snd_pcm_format_t src_format, snd_pcm_format_t dst_format,
+			      unsigned int nsrcs, unsigned int ndsts)
+{
+	if ((src_format != SND_PCM_FORMAT_S16 && src_format != SND_PCM_FORMAT_S32) ||
+	    (dst_format != SND_PCM_FORMAT_S16 && dst_format != SND_PCM_FORMAT_S32))
+		return -EINVAL;
+	m->coef = snd_pcm_arena_alloc(pcm, (size_t)ndsts * nsrcs * sizeof(float));
+	m->work = snd_pcm_arena_alloc(pcm, (nsrcs + 1) * ROUTE_MATRIX_FRAMES * sizeof(float));
+	if (!m->coef || !m->work) {
+		snd_pcm_route_matrix_free(m);
+		return -ENOMEM;
+	}
+	memset(m->coef, 0, (size_t)ndsts * nsrcs * sizeof(float));
+	m->src_format = src_format;
+	m->dst_format = dst_format;
+	if (src_format == dst_format)
+		m->scale = 1.0f;
+	else if (src_format == SND_PCM_FORMAT_S16)
+		m->scale = 65536.0f;
+	else
+		m->scale = 1.0f / 65536.0f;
+	m->nsrcs = nsrcs;
+	m->ndsts = ndsts;
+	return 0;
+}
+
+/*
+ * Compile the coefficients to lists of the non-zero terms of each
+ * destination, with the width change fused in, so that mixing a few of
+ * many channels (e.g. a 64 -> 2 downmix) touches only the used sources.
+ * A destination with a single unity coefficient becomes a plain copy.
+ */
+int snd_pcm_route_matrix_compile(snd_pcm_t *pcm, snd_pcm_route_matrix_t *m)
+{
+	unsigned int dst, src, i, nterms = 0, n = 0;
+	int used;
+
+	for (dst = 0; dst < m->ndsts; dst++)
+		for (src = 0; src < m->nsrcs; src++)
+			if (m->coef[dst * m->nsrcs + src] != 0)
+				nterms++;
+	snd_pcm_arena_free(m->terms);
+	snd_pcm_arena_free(m->dst_terms);
+	snd_pcm_arena_free(m->copy);
+	snd_pcm_arena_free(m->loads);
+	m->terms = snd_pcm_arena_alloc(pcm, (nterms + 1) * sizeof(*m->terms));
+	m->dst_terms = snd_pcm_arena_alloc(pcm, (m->ndsts + 1) * sizeof(*m->dst_terms));
+	m->copy = snd_pcm_arena_alloc(pcm, m->ndsts * sizeof(*m->copy));
+	m->loads = snd_pcm_arena_alloc(pcm, m->nsrcs * sizeof(*m->loads));
+	if (!m->terms || !m->dst_terms || !m->copy || !m->loads) {
+		snd_pcm_route_matrix_free(m);
+		return -ENOMEM;
+	}
+
+	for (dst = 0; dst < m->ndsts; dst++) {
+		const float *coef = m->coef + dst * m->nsrcs;
+		unsigned int first = n;
+
+		m->dst_terms[dst] = n;
+		for (src = 0; src < m->nsrcs; src++) {
+			if (coef[src] == 0)
+				continue;
+			m->terms[n].src = src;
+			m->terms[n].coef = coef[src] * m->scale;
+			n++;
+		}
+		m->copy[dst] = -1;
+		if (n == first + 1 && coef[m->terms[first].src] == 1.0f) {
+			m->copy[dst] = m->terms[first].src;
+			n = first;
+		}
+	}
+	m->dst_terms[m->ndsts] = n;
+
+	/* only the sources of the mixed destinations are loaded */
+	m->nloads = 0;
+	for (src = 0; src < m->nsrcs; src++) {
+		used = 0;
+		for (i = 0; i < n && !used; i++)
+			used = m->terms[i].src == src;
+		if (used)
+			m->loads[m->nloads++] = src;
+	}
+	return 0;
+}
+
+void snd_pcm_route_matrix_free(snd_pcm_route_matrix_t *m)
+{
+	snd_pcm_arena_free(m->coef);
+	m->coef = NULL;
+	snd_pcm_arena_free(m->work);
+	m->work = NULL;
+	snd_pcm_arena_free(m->terms);
+	m->terms = NULL;
+	snd_pcm_arena_free(m->dst_terms);
+	m->dst_terms = NULL;
+	snd_pcm_arena_free(m->copy);
+	m->copy = NULL;
+	snd_pcm_arena_free(m->loads);
+	m->loads = NULL;
+}
+
+void snd_pcm_route_matrix_convert(const snd_pcm_route_matrix_t *m,
+				  const snd_pcm_channel_area_t *dst_areas,
+				  snd_pcm_uframes_t dst_offset,
+				  const snd_pcm_channel_area_t *src_areas,
+				  snd_pcm_uframes_t src_offset,
+				  snd_pcm_uframes_t frames)
+{
+	unsigned int ndsts = m->ndsts;
+	float *acc = m->work;
+	float *in = acc + ROUTE_MATRIX_FRAMES;
+
+	while (frames > 0) {
+		unsigned int n = frames > ROUTE_MATRIX_FRAMES ?
+			ROUTE_MATRIX_FRAMES : frames;
+		unsigned int dst, src, i;
+
+		for (i = 0; i < m->nloads; i++) {
+			src = m->loads[i];
+			route_matrix_load(in + src * ROUTE_MATRIX_FRAMES,
+					  &src_areas[src], src_offset, n,
+					  m->src_format);
+		}
+		for (dst = 0; dst < ndsts; dst++) {
+			const snd_pcm_route_matrix_term_t *t = m->terms + m->dst_terms[dst];
+			const snd_pcm_route_matrix_term_t *end = m->terms + m->dst_terms[dst + 1];
+			const float *s;
+			float c;
+
+			if (m->copy[dst] >= 0) {
+				route_matrix_copy(&dst_areas[dst], dst_offset,
+						  &src_areas[m->copy[dst]], src_offset, n,
+						  m->src_format, m->dst_format);
+				continue;
+			}
+			if (t == end) {
+				snd_pcm_area_silence(&dst_areas[dst], dst_offset, n,
+						     m->dst_format);
+				continue;
+			}
+			s = in + t->src * ROUTE_MATRIX_FRAMES;
+			c = t->coef;
+			for (i = 0; i < n; i++)
+				acc[i] = s[i] * c;
+			for (t++; t < end; t++) {
+				s = in + t->src * ROUTE_MATRIX_FRAMES;
+				c = t->coef;
+				for (i = 0; i < n; i++)
+					acc[i] += s[i] * c;
+			}
+			route_matrix_store(&dst_areas[dst], dst_offset, acc, n,
+					   m->dst_format);
+		}
+		frames -= n;
+		src_offset += n;
+		dst_offset += n;
+	}
+}
+
+/*
+ * Precompile the ttable to a dense matrix when the source and
+ * destination have the same native S16 or S32 format and at least one
+ * destination channel mixes or attenuates its sources.
+ */
+static int route_build_matrix(snd_pcm_t *pcm,
+			      snd_pcm_route_params_t *params,
+			      snd_pcm_format_t src_format,
+			      snd_pcm_format_t dst_format,
+			      unsigned int src_channels,
+			      unsigned int dst_channels)
+{
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	unsigned int dst, src;
+	int mix = 0, err;
+
+	snd_pcm_route_matrix_free(&params->matrix);
+	if (src_format != dst_format ||
+	    (src_format != SND_PCM_FORMAT_S16 && src_format != SND_PCM_FORMAT_S32))
+		return 0;
+	for (dst = 0; dst < params->ndsts && dst < dst_channels; dst++) {
+		if (params->dsts[dst].att || params->dsts[dst].nsrcs > 1)
+			mix = 1;
+	}
+	if (!mix)
+		return 0;
+
+	err = snd_pcm_route_matrix_init(pcm, &params->matrix, src_format, dst_format,
+					src_channels, dst_channels);
+	if (err < 0)
+		return err;
+	for (dst = 0; dst < params->ndsts && dst < dst_channels; dst++) {
+		snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		for (src = 0; src < d->nsrcs; src++) {
+			unsigned int channel = d->srcs[src].channel;
+			if (channel >= src_channels)
+				continue;
+			params->matrix.coef[dst * src_channels + channel] +=
+				d->att ? d->srcs[src].as_float : 1.0f;
+		}
+	}
+	return snd_pcm_route_matrix_compile(pcm, &params->matrix);
+#else
+	(void)params; (void)src_format; (void)dst_format;
+	(void)src_channels; (void)dst_channels;
+#endif
+	return 0;
+}
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
@@ -410,6 +726,12 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
 
+	if (params->matrix.coef && src_channels == params->matrix.nsrcs &&
+	    dst_channels == params->matrix.ndsts) {
+		snd_pcm_route_matrix_convert(&params->matrix, dst_areas, dst_offset,
+					     src_areas, src_offset, frames);
+		return;
+	}
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -440,6 +762,7 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 		}
 		free(params->dsts);
 	}
+	snd_pcm_route_matrix_free(&params->matrix);
 	free(route->chmap);
 	snd_pcm_free_chmaps(route->chmap_override);
 	return snd_pcm_generic_close(pcm);
@@ -544,11 +867,31 @@ static int snd_pcm_route_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_generic_hw_refine);
 }
 
+/* a destination taking a single source at unity is a plain conversion */
+static void route_select_funcs(snd_pcm_route_params_t *params)
+{
+	unsigned int dst;
+
+	for (dst = 0; dst < params->ndsts; dst++) {
+		snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+
+		if (d->nsrcs == 0)
+			d->func = snd_pcm_route_convert1_zero;
+		else if (d->nsrcs == 1 && !d->att)
+			d->func = params->use_getput ?
+				snd_pcm_route_convert1_one_getput :
+				snd_pcm_route_convert1_one;
+		else
+			d->func = snd_pcm_route_convert1_many;
+	}
+}
+
 static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_route_t *route = pcm->private_data;
 	snd_pcm_t *slave = route->plug.gen.slave;
 	snd_pcm_format_t src_format, dst_format;
+	unsigned int channels;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_route_hw_refine_cchange,
 					  snd_pcm_route_hw_refine_sprepare,
@@ -582,6 +925,18 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 #else
 	route->params.sum_idx = UINT64;
 #endif
+	route_select_funcs(&route->params);
+	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		err = route_build_matrix(pcm, &route->params, src_format, dst_format,
+					 channels, slave->channels);
+	else
+		err = route_build_matrix(pcm, &route->params, src_format, dst_format,
+					 slave->channels, channels);
+	if (err < 0)
+		return err;
 	return 0;
 }
 
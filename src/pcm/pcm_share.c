@@ -34,7 +34,6 @@
 #include <string.h>
 #include <signal.h>
 #include <math.h>
-#include <sys/socket.h>
 #include <poll.h>
 #include <pthread.h>
 
@@ -71,6 +70,22 @@ do { \
 #define Pthread_mutex_unlock(mutex) pthread_mutex_unlock(mutex)
 #endif
 
+/*
+ * The slave mutex is taken by clients of any priority, let a real-time
+ * client boost the one holding it instead of waiting behind it.
+ */
+static void snd_pcm_share_mutex_init(pthread_mutex_t *mutex)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+#ifdef _POSIX_THREAD_PRIO_INHERIT
+	pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+#endif
+	pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
 typedef struct {
 	struct list_head clients;
 	struct list_head list;
@@ -88,14 +103,10 @@ typedef struct {
 	snd_pcm_uframes_t silence_frames;
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_uframes_t hw_ptr;
-	int poll[2];
-	int polling;
-	pthread_t thread;
 	pthread_mutex_t mutex;
 #ifdef MUTEX_DEBUG
 	char *mutex_holder;
 #endif
-	pthread_cond_t poll_cond;
 } snd_pcm_share_slave_t;
 
 typedef struct {
@@ -109,9 +120,6 @@ typedef struct {
 	snd_pcm_state_t state;
 	snd_pcm_uframes_t hw_ptr;
 	snd_pcm_uframes_t appl_ptr;
-	int ready;
-	int client_socket;
-	int slave_socket;
 } snd_pcm_share_t;
 
 #endif /* DOC_HIDDEN */
@@ -190,7 +198,6 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_forward(snd_pcm_share_slave_t *sla
 
 /* 
    - stop PCM on xrun
-   - update poll status
    - draining silencing
    - return distance in frames to next event
 */
@@ -200,12 +207,11 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_t *spcm = slave->pcm;
 	snd_pcm_uframes_t buffer_size = spcm->buffer_size;
-	int ready = 1, running = 0;
+	int running = 0;
 	snd_pcm_uframes_t avail = 0, slave_avail;
 	snd_pcm_sframes_t hw_avail;
 	snd_pcm_uframes_t missing = INT_MAX;
 	snd_pcm_sframes_t ready_missing;
-	ssize_t s;
 	// printf("state=%s hw_ptr=%ld appl_ptr=%ld slave appl_ptr=%ld safety=%ld silence=%ld\n", snd_pcm_state_name(share->state), slave->hw_ptr, share->appl_ptr, *slave->pcm->appl_ptr, slave->safety_threshold, slave->silence_frames);
 	switch (share->state) {
 	case SND_PCM_STATE_RUNNING:
@@ -221,7 +227,7 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	avail = snd_pcm_mmap_avail(pcm);
 	if (avail >= pcm->stop_threshold) {
 		_snd_pcm_share_stop(pcm, share->state == SND_PCM_STATE_DRAINING ? SND_PCM_STATE_SETUP : SND_PCM_STATE_XRUN);
-		goto update_poll;
+		return INT_MAX;
 	}
 	hw_avail = buffer_size - avail;
 	slave_avail = snd_pcm_share_slave_avail(slave);
@@ -261,7 +267,6 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 			if ((snd_pcm_uframes_t)hw_avail < missing)
 				missing = hw_avail;
 			running = 1;
-			ready = 0;
 		}
 		break;
 	case SND_PCM_STATE_RUNNING:
@@ -275,7 +280,6 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 		}
 		ready_missing = pcm->avail_min - avail;
 		if (ready_missing > 0) {
-			ready = 0;
 			if (missing > (snd_pcm_uframes_t)ready_missing)
 				missing = ready_missing;
 		}
@@ -286,30 +290,6 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 		return INT_MAX;
 	}
 
- update_poll:
-	if (ready != share->ready) {
-		char buf[1];
-		while (1) {
-			if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
-				if (ready)
-					s = read(share->slave_socket, buf, 1);
-				else
-					s = write(share->client_socket, buf, 1);
-			} else {
-				if (ready)
-					s = write(share->slave_socket, buf, 1);
-				else
-					s = read(share->client_socket, buf, 1);
-			}
-			if (s < 0) {
-				if (errno == EINTR)
-					continue;
-				return INT_MAX;
-			}
-			break;
-		}
-		share->ready = ready;
-	}
 	if (!running)
 		return INT_MAX;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
@@ -347,7 +327,6 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_missing(snd_pcm_share_slave_t *sla
 {
 	snd_pcm_uframes_t missing = INT_MAX;
 	struct list_head *i;
-	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(slave->pcm);
 	slave->hw_ptr = *slave->pcm->hw.ptr;
 	list_for_each(i, &slave->clients) {
 		snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
@@ -359,109 +338,48 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_missing(snd_pcm_share_slave_t *sla
 	return missing;
 }
 
-static void *snd_pcm_share_thread(void *data)
+/* Warning: take the mutex and update the slave avail before to call this */
+/*
+ * Run the bookkeeping of all clients and program the slave avail_min,
+ * so that the slave poll descriptor wakes up the clients at the next
+ * event.  There is no helper thread, this runs from the client calls
+ * and from their poll wakeups.
+ */
+static void _snd_pcm_share_slave_update(snd_pcm_share_slave_t *slave)
 {
-	snd_pcm_share_slave_t *slave = data;
 	snd_pcm_t *spcm = slave->pcm;
-	struct pollfd pfd[2];
+	snd_pcm_uframes_t missing, hw_ptr;
+	snd_pcm_sframes_t avail_min;
 	int err;
 
-	pfd[0].fd = slave->poll[0];
-	pfd[0].events = POLLIN;
-	err = snd_pcm_poll_descriptors(spcm, &pfd[1], 1);
-	if (err != 1) {
-		SNDERR("invalid poll descriptors %d", err);
-		return NULL;
-	}
-	Pthread_mutex_lock(&slave->mutex);
-	err = pipe(slave->poll);
-	if (err < 0) {
-		SYSERR("can't create a pipe");
-		Pthread_mutex_unlock(&slave->mutex);
-		return NULL;
-	}
-	while (slave->open_count > 0) {
-		snd_pcm_uframes_t missing;
-		// printf("begin min_missing\n");
-		missing = _snd_pcm_share_slave_missing(slave);
-		// printf("min_missing=%ld\n", missing);
-		if (missing < INT_MAX) {
-			snd_pcm_uframes_t hw_ptr;
-			snd_pcm_sframes_t avail_min;
-			hw_ptr = slave->hw_ptr + missing;
-			hw_ptr += spcm->period_size - 1;
-			if (hw_ptr >= spcm->boundary)
-				hw_ptr -= spcm->boundary;
-			hw_ptr -= hw_ptr % spcm->period_size;
-			avail_min = hw_ptr - *spcm->appl.ptr;
-			if (spcm->stream == SND_PCM_STREAM_PLAYBACK)
-				avail_min += spcm->buffer_size;
-			if (avail_min < 0)
-				avail_min += spcm->boundary;
-			// printf("avail_min=%d\n", avail_min);
-			if ((snd_pcm_uframes_t)avail_min != spcm->avail_min) {
-				snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
-				err = snd_pcm_sw_params(spcm, &slave->sw_params);
-				if (err < 0) {
-					SYSERR("snd_pcm_sw_params error");
-					Pthread_mutex_unlock(&slave->mutex);
-					return NULL;
-				}
-			}
-			slave->polling = 1;
-			Pthread_mutex_unlock(&slave->mutex);
-			err = poll(pfd, 2, -1);
-			Pthread_mutex_lock(&slave->mutex);
-			if (pfd[0].revents & POLLIN) {
-				char buf[1];
-				read(pfd[0].fd, buf, 1);
-			}
-		} else {
-			slave->polling = 0;
-			pthread_cond_wait(&slave->poll_cond, &slave->mutex);
-		}
-	}
-	Pthread_mutex_unlock(&slave->mutex);
-	return NULL;
+	missing = _snd_pcm_share_slave_missing(slave);
+	if (missing >= INT_MAX)
+		return;
+	hw_ptr = slave->hw_ptr + missing;
+	hw_ptr += spcm->period_size - 1;
+	if (hw_ptr >= spcm->boundary)
+		hw_ptr -= spcm->boundary;
+	hw_ptr -= hw_ptr % spcm->period_size;
+	avail_min = hw_ptr - *spcm->appl.ptr;
+	if (spcm->stream == SND_PCM_STREAM_PLAYBACK)
+		avail_min += spcm->buffer_size;
+	if (avail_min < 0)
+		avail_min += spcm->boundary;
+	if ((snd_pcm_uframes_t)avail_min == spcm->avail_min)
+		return;
+	snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
+	err = snd_pcm_sw_params(spcm, &slave->sw_params);
+	if (err < 0)
+		SYSERR("snd_pcm_sw_params error");
 }
 
 static void _snd_pcm_share_update(snd_pcm_t *pcm)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
-	snd_pcm_t *spcm = slave->pcm;
-	snd_pcm_uframes_t missing;
-	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(spcm);
-	slave->hw_ptr = *slave->pcm->hw.ptr;
-	missing = _snd_pcm_share_missing(pcm);
-	// printf("missing %ld\n", missing);
-	if (!slave->polling) {
-		pthread_cond_signal(&slave->poll_cond);
-		return;
-	}
-	if (missing < INT_MAX) {
-		snd_pcm_uframes_t hw_ptr;
-		snd_pcm_sframes_t avail_min;
-		hw_ptr = slave->hw_ptr + missing;
-		hw_ptr += spcm->period_size - 1;
-		if (hw_ptr >= spcm->boundary)
-			hw_ptr -= spcm->boundary;
-		hw_ptr -= hw_ptr % spcm->period_size;
-		avail_min = hw_ptr - *spcm->appl.ptr;
-		if (spcm->stream == SND_PCM_STREAM_PLAYBACK)
-			avail_min += spcm->buffer_size;
-		if (avail_min < 0)
-			avail_min += spcm->boundary;
-		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min) {
-			int err;
-			snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
-			err = snd_pcm_sw_params(spcm, &slave->sw_params);
-			if (err < 0) {
-				SYSERR("snd_pcm_sw_params error");
-				return;
-			}
-		}
-	}
+
+	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(slave->pcm);
+	_snd_pcm_share_slave_update(slave);
 }
 
 static int snd_pcm_share_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIBUTE_UNUSED)
@@ -800,7 +718,7 @@ static snd_pcm_sframes_t snd_pcm_share_avail_update(snd_pcm_t *pcm)
 			Pthread_mutex_unlock(&slave->mutex);
 			return avail;
 		}
-		share->hw_ptr = *slave->pcm->hw.ptr;
+		_snd_pcm_share_slave_update(slave);
 	}
 	Pthread_mutex_unlock(&slave->mutex);
 	avail = snd_pcm_mmap_avail(pcm);
@@ -814,13 +732,87 @@ static int snd_pcm_share_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_uframes_t savail;
 	int err;
 	Pthread_mutex_lock(&slave->mutex);
-	err = snd_pcm_htimestamp(slave->pcm, avail, tstamp);
+	err = snd_pcm_htimestamp(slave->pcm, &savail, tstamp);
+	if (err >= 0) {
+		if (share->state == SND_PCM_STATE_RUNNING)
+			_snd_pcm_share_update(pcm);
+		/* the client avail, snd_pcm_wait() sleeps on it */
+		*avail = snd_pcm_mmap_avail(pcm);
+	}
 	Pthread_mutex_unlock(&slave->mutex);
 	return err;
 }
 
+static int snd_pcm_share_poll_descriptors_count(snd_pcm_t *pcm)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	return snd_pcm_poll_descriptors_count(share->slave->pcm);
+}
+
+static int snd_pcm_share_poll_descriptors(snd_pcm_t *pcm, struct pollfd *pfds,
+					  unsigned int space)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	return snd_pcm_poll_descriptors(share->slave->pcm, pfds, space);
+}
+
+/*
+ * The clients poll on the slave descriptors, whose avail_min is set to
+ * the nearest event of all clients.  Each wakeup runs the bookkeeping
+ * and reports the client ready only when its own condition is met.
+ */
+static int snd_pcm_share_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
+				      unsigned int nfds, unsigned short *revents)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	snd_pcm_share_slave_t *slave = share->slave;
+	unsigned short events = 0;
+	int err;
+
+	err = snd_pcm_poll_descriptors_revents(slave->pcm, pfds, nfds, &events);
+	if (err < 0)
+		return err;
+	Pthread_mutex_lock(&slave->mutex);
+	switch (share->state) {
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_DRAINING:
+		if (snd_pcm_state(slave->pcm) == SND_PCM_STATE_XRUN) {
+			_snd_pcm_share_stop(pcm, SND_PCM_STATE_XRUN);
+			break;
+		}
+		snd_pcm_avail_update(slave->pcm);
+		_snd_pcm_share_slave_update(slave);
+		break;
+	default:
+		break;
+	}
+	switch (share->state) {
+	case SND_PCM_STATE_XRUN:
+		*revents = POLLERR;
+		break;
+	case SND_PCM_STATE_RUNNING:
+		if (snd_pcm_mmap_avail(pcm) >= pcm->avail_min)
+			*revents = pcm->poll_events;
+		else
+			*revents = 0;
+		break;
+	case SND_PCM_STATE_DRAINING:
+		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+			*revents = 0;
+			break;
+		}
+		/* Fall through */
+	default:
+		*revents = pcm->poll_events;
+		break;
+	}
+	Pthread_mutex_unlock(&slave->mutex);
+	return 0;
+}
+
 /* Call it with mutex held */
 static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 						    snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
@@ -1270,13 +1262,9 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 	Pthread_mutex_lock(&slave->mutex);
 	slave->open_count--;
 	if (slave->open_count == 0) {
-		pthread_cond_signal(&slave->poll_cond);
 		Pthread_mutex_unlock(&slave->mutex);
-		err = pthread_join(slave->thread, 0);
-		assert(err == 0);
 		err = snd_pcm_close(slave->pcm);
 		pthread_mutex_destroy(&slave->mutex);
-		pthread_cond_destroy(&slave->poll_cond);
 		list_del(&slave->list);
 		free(slave);
 		list_del(&share->list);
@@ -1285,8 +1273,6 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 		Pthread_mutex_unlock(&slave->mutex);
 	}
 	Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
-	close(share->client_socket);
-	close(share->slave_socket);
 	free(share->slave_channels);
 	free(share);
 	return err;
@@ -1357,6 +1343,9 @@ static const snd_pcm_fast_ops_t snd_pcm_share_fast_ops = {
 	.avail_update = snd_pcm_share_avail_update,
 	.htimestamp = snd_pcm_share_htimestamp,
 	.mmap_commit = snd_pcm_share_mmap_commit,
+	.poll_descriptors_count = snd_pcm_share_poll_descriptors_count,
+	.poll_descriptors = snd_pcm_share_poll_descriptors,
+	.poll_revents = snd_pcm_share_poll_revents,
 };
 
 /**
@@ -1392,7 +1381,7 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 	char slave_map[32] = { 0 };
 	unsigned int k;
 	snd_pcm_share_slave_t *slave = NULL;
-	int sd[2];
+	struct pollfd pfd;
 
 	assert(pcmp);
 	assert(channels > 0 && sname && channels_map);
@@ -1428,39 +1417,6 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		free(share);
 		return err;
 	}
-	err = socketpair(AF_LOCAL, SOCK_STREAM, 0, sd);
-	if (err < 0) {
-		snd_pcm_free(pcm);
-		free(share->slave_channels);
-		free(share);
-		return -errno;
-	}
-		
-	if (stream == SND_PCM_STREAM_PLAYBACK) {
-		int bufsize = 1;
-		err = setsockopt(sd[0], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
-		if (err >= 0) {
-			struct pollfd pfd;
-			pfd.fd = sd[0];
-			pfd.events = POLLOUT;
-			while ((err = poll(&pfd, 1, 0)) == 1) {
-				char buf[1];
-				err = write(sd[0], buf, 1);
-				assert(err != 0);
-				if (err != 1)
-					break;
-			}
-		}
-	}
-	if (err < 0) {
-		err = -errno;
-		close(sd[0]);
-		close(sd[1]);
-		snd_pcm_free(pcm);
-		free(share->slave_channels);
-		free(share);
-		return err;
-	}
 
 	Pthread_mutex_lock(&snd_pcm_share_slaves_mutex);
 	list_for_each(i, &snd_pcm_share_slaves) {
@@ -1475,8 +1431,6 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		err = snd_pcm_open(&spcm, sname, stream, mode);
 		if (err < 0) {
 			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
-			close(sd[0]);
-			close(sd[1]);
 			snd_pcm_free(pcm);
 			free(share->slave_channels);
 			free(share);
@@ -1488,8 +1442,6 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		if (!slave) {
 			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 			snd_pcm_close(spcm);
-			close(sd[0]);
-			close(sd[1]);
 			snd_pcm_free(pcm);
 			free(share->slave_channels);
 			free(share);
@@ -1502,12 +1454,9 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		slave->rate = srate;
 		slave->period_time = speriod_time;
 		slave->buffer_time = sbuffer_time;
-		pthread_mutex_init(&slave->mutex, NULL);
-		pthread_cond_init(&slave->poll_cond, NULL);
+		snd_pcm_share_mutex_init(&slave->mutex);
 		list_add_tail(&slave->list, &snd_pcm_share_slaves);
 		Pthread_mutex_lock(&slave->mutex);
-		err = pthread_create(&slave->thread, NULL, snd_pcm_share_thread, slave);
-		assert(err == 0);
 		Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 	} else {
 		Pthread_mutex_lock(&slave->mutex);
@@ -1518,8 +1467,6 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 				if (slave_map[sh->slave_channels[k]]) {
 					SNDERR("Slave channel %d is already in use", sh->slave_channels[k]);
 					Pthread_mutex_unlock(&slave->mutex);
-					close(sd[0]);
-					close(sd[1]);
 					snd_pcm_free(pcm);
 					free(share->slave_channels);
 					free(share);
@@ -1531,14 +1478,13 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 
 	share->slave = slave;
 	share->pcm = pcm;
-	share->client_socket = sd[0];
-	share->slave_socket = sd[1];
 	
 	pcm->mmap_rw = 1;
 	pcm->ops = &snd_pcm_share_ops;
 	pcm->fast_ops = &snd_pcm_share_fast_ops;
 	pcm->private_data = share;
-	pcm->poll_fd = share->client_socket;
+	if (snd_pcm_poll_descriptors(slave->pcm, &pfd, 1) == 1)
+		pcm->poll_fd = pfd.fd;
 	pcm->poll_events = stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
 	pcm->tstamp_type = slave->pcm->tstamp_type;
 	snd_pcm_set_hw_ptr(pcm, &share->hw_ptr, -1, 0);
@@ -1567,6 +1513,12 @@ The difference from \ref pcm_plugins_dshare "dshare plugin" is that
 share plugin requires the server program "aserver", while dshare plugin
 doesn't need the explicit server but access to the shared buffer.
 
+The clients poll on the descriptors of the slave PCM, whose avail_min is
+kept at the nearest event of all clients.  There is no helper thread: the
+transfers to the slave and the xrun detection of every client are done
+by whichever client calls into the plugin or wakes up from poll, so the
+slave is kept fed as long as one of the clients transfers or waits.
+
 \code
 pcm.name {
         type share              # Share PCM
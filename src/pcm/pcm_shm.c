@@ -55,9 +55,52 @@ const char *_snd_module_pcm_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_pcm_shm_ctrl_t *ctrl;
+	unsigned int version;		/* protocol of the server */
 } snd_pcm_shm_t;
 #endif
 
+/*
+ * copy the status block published by a protocol 2 server, gives up when
+ * the server looks preempted in the middle of an update
+ */
+static int snd_pcm_shm_read_status(snd_pcm_shm_t *shm, snd_pcm_shm_status_t *copy)
+{
+	volatile snd_pcm_shm_status_t *status = &shm->ctrl->status;
+	unsigned int seq, retries = 64;
+
+	if (shm->version < 2)
+		return -ENOSYS;
+	for (;; retries--) {
+		if (!retries)
+			return -EAGAIN;
+		seq = __atomic_load_n(&status->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		copy->state = status->state;
+		copy->avail = status->avail;
+		copy->delay = status->delay;
+		copy->tstamp.tv_sec = status->tstamp.tv_sec;
+		copy->tstamp.tv_nsec = status->tstamp.tv_nsec;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&status->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+}
+
+static int snd_pcm_shm_state_error(snd_pcm_state_t state)
+{
+	switch (state) {
+	case SND_PCM_STATE_XRUN:
+		return -EPIPE;
+	case SND_PCM_STATE_SUSPENDED:
+		return -ESTRPIPE;
+	case SND_PCM_STATE_DISCONNECTED:
+		return -ENODEV;
+	default:
+		return 0;
+	}
+}
+
 static long snd_pcm_shm_action_fd0(snd_pcm_t *pcm, int *fd)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
@@ -405,6 +448,10 @@ static snd_pcm_state_t snd_pcm_shm_state(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_shm_status_t status;
+
+	if (snd_pcm_shm_read_status(shm, &status) >= 0)
+		return status.state;
 	ctrl->cmd = SND_PCM_IOCTL_STATE;
 	return snd_pcm_shm_action(pcm);
 }
@@ -413,6 +460,11 @@ static int snd_pcm_shm_hwsync(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_shm_status_t status;
+
+	/* the server keeps the hw pointer in sync */
+	if (snd_pcm_shm_read_status(shm, &status) >= 0)
+		return snd_pcm_shm_state_error(status.state);
 	ctrl->cmd = SND_PCM_IOCTL_HWSYNC;
 	return snd_pcm_shm_action(pcm);
 }
@@ -421,7 +473,16 @@ static int snd_pcm_shm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_shm_status_t status;
 	int err;
+
+	if (snd_pcm_shm_read_status(shm, &status) >= 0) {
+		err = snd_pcm_shm_state_error(status.state);
+		if (err < 0)
+			return err;
+		*delayp = status.delay;
+		return 0;
+	}
 	ctrl->cmd = SNDRV_PCM_IOCTL_DELAY;
 	err = snd_pcm_shm_action(pcm);
 	if (err < 0)
@@ -434,7 +495,22 @@ static snd_pcm_sframes_t snd_pcm_shm_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_shm_status_t status;
 	int err;
+
+	/*
+	 * the published value may predate the last wakeup of the PCM, ask
+	 * the server before reporting too little to go on
+	 */
+	if (snd_pcm_shm_read_status(shm, &status) >= 0) {
+		err = snd_pcm_shm_state_error(status.state);
+		if (err < 0)
+			return err;
+		if (status.avail >= pcm->avail_min ||
+		    (status.state != SND_PCM_STATE_RUNNING &&
+		     status.state != SND_PCM_STATE_DRAINING))
+			return status.avail;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_AVAIL_UPDATE;
 	err = snd_pcm_shm_action(pcm);
 	if (err < 0)
@@ -442,11 +518,18 @@ static snd_pcm_sframes_t snd_pcm_shm_avail_update(snd_pcm_t *pcm)
 	return err;
 }
 
-static int snd_pcm_shm_htimestamp(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-				  snd_pcm_uframes_t *avail ATTRIBUTE_UNUSED,
-				  snd_htimestamp_t *tstamp ATTRIBUTE_UNUSED)
+static int snd_pcm_shm_htimestamp(snd_pcm_t *pcm,
+				  snd_pcm_uframes_t *avail,
+				  snd_htimestamp_t *tstamp)
 {
-	return -EIO;	/* not implemented yet */
+	snd_pcm_shm_t *shm = pcm->private_data;
+	snd_pcm_shm_status_t status;
+
+	if (snd_pcm_shm_read_status(shm, &status) < 0)
+		return -EIO;	/* not implemented by protocol 1 */
+	*avail = status.avail;
+	*tstamp = status.tstamp;
+	return 0;
 }
 
 static int snd_pcm_shm_prepare(snd_pcm_t *pcm)
@@ -585,7 +668,9 @@ static int snd_pcm_shm_close(snd_pcm_t *pcm)
 
 static void snd_pcm_shm_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
-	snd_output_printf(out, "Shm PCM\n");
+	snd_pcm_shm_t *shm = pcm->private_data;
+
+	snd_output_printf(out, "Shm PCM (protocol %u)\n", shm->version);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -680,6 +765,7 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 	int err;
 	int result;
 	snd_pcm_shm_ctrl_t *ctrl = NULL;
+	struct shmid_ds ds;
 	int sock = -1;
 	snamelen = strlen(sname);
 	if (snamelen > 255)
@@ -741,6 +827,11 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 
 	shm->socket = sock;
 	shm->ctrl = ctrl;
+	shm->version = 1;
+	if (shmctl(ans.cookie, IPC_STAT, &ds) >= 0 &&
+	    ds.shm_segsz >= PCM_SHM_SIZE &&
+	    ctrl->status.version >= SND_PCM_SHM_PROTOCOL_VERSION)
+		shm->version = SND_PCM_SHM_PROTOCOL_VERSION;
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_SHM, name, stream, mode);
 	if (err < 0) {
@@ -779,6 +870,15 @@ This plugin communicates with aserver via shared memory. It is a raw
 communication without any conversions, but it can be expected worse
 performance.
 
+The commands and the ring buffer updates go through the socket of the
+server.  A server speaking protocol 2 also publishes the state, avail,
+delay and timestamp of the PCM in the shared area, after every command
+and whenever the PCM wakes up, so snd_pcm_state(), snd_pcm_avail_update(),
+snd_pcm_delay(), snd_pcm_hwsync() and snd_pcm_htimestamp() are answered
+locally.  The published values are at most one period old, the plugin
+still asks the server when avail looks smaller than avail_min.  With an
+older server every call is a round trip as before.
+
 \code
 pcm.name {
         type shm                # Shared memory PCM
@@ -32,6 +32,15 @@
 #include <math.h>
 #include <sound/tlv.h>
 
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define SOFTVOL_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SOFTVOL_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_softvol = "";
@@ -46,14 +55,33 @@ typedef struct {
 	unsigned int cchannels;
 	snd_ctl_t *ctl;
 	snd_ctl_elem_value_t elem;
+	int ctl_events;		/* value changes are notified via ctl events */
+	int vol_dirty;		/* cur_vol must be read again */
 	unsigned int cur_vol[2];
 	unsigned int max_val;     /* max index */
 	unsigned int zero_dB_val; /* index at 0 dB */
 	double min_dB;
 	double max_dB;
 	unsigned int *dB_value;
+	unsigned int channels;	/* size of the per-channel arrays */
+	unsigned int *gains;	/* current gain of each channel */
+	void *gtab;		/* gain table for the kernel */
+	void (*kernel)(void *dst, const void *src, snd_pcm_uframes_t samples,
+		       const void *gtab, unsigned int period);
+	int ramp;		/* SOFTVOL_RAMP_* */
+	int ramp_valid;		/* ramp_to holds the applied gains */
+	unsigned int *ramp_from;
+	unsigned int *ramp_to;
+	snd_pcm_uframes_t ramp_pos;
+	snd_pcm_uframes_t ramp_len;
 } snd_pcm_softvol_t;
 
+enum {
+	SOFTVOL_RAMP_NONE,
+	SOFTVOL_RAMP_LINEAR,
+	SOFTVOL_RAMP_EXPONENTIAL,
+};
+
 #define VOL_SCALE_SHIFT		16
 #define VOL_SCALE_MASK          ((1 << VOL_SCALE_SHIFT) - 1)
 
@@ -173,12 +201,25 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 	return swap ? (short)bswap_16((short)fraction) : (short)fraction;
 }
 
+static inline float MULTI_DIV_float(float a, unsigned int b, int swap)
+{
+	union {
+		float f;
+		uint32_t i;
+	} v;
+	v.f = a;
+	if (swap)
+		v.i = bswap_32(v.i);
+	v.f *= (float)b / (1 << VOL_SCALE_SHIFT);
+	if (swap)
+		v.i = bswap_32(v.i);
+	return v.f;
+}
+
 #endif /* DOC_HIDDEN */
 
 /*
  * apply volumue attenuation
- *
- * TODO: use SIMD operations
  */
 
 #ifndef DOC_HIDDEN
@@ -312,6 +353,539 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 
 #endif /* DOC_HIDDEN */
 
+#ifndef DOC_HIDDEN
+/*
+ * Kernels for the packed native S16, S24_LE, S32 and FLOAT samples.
+ *
+ * The gain of the sample i is taken from the table entry i % period,
+ * where period is a multiple of the vector lanes.  The integer kernels
+ * handle the gains up to 0x10000 only (a boost goes through the
+ * MULTI_DIV_* functions) and produce the same results as those:
+ *
+ *   S16:  gtab = { int16 gain[period], int16 mask[period] },
+ *         out = ((in * gain) >> 16) + (in & mask),
+ *         gains from 0x8000 are stored as gain - 0x10000 with mask -1
+ *   S32:  gtab = { uint32 gain[period] }, out = (in * gain) >> 16
+ *   FLOAT: gtab = { float gain[period] }, out = in * gain
+ */
+typedef void (*softvol_kernel_t)(void *dst, const void *src, snd_pcm_uframes_t samples,
+				 const void *gtab, unsigned int period);
+
+typedef struct {
+	softvol_kernel_t s16;
+	softvol_kernel_t s24;
+	softvol_kernel_t s32;
+	softvol_kernel_t flt;
+} softvol_kernels_t;
+
+/* the table period is channels * SOFTVOL_LANES, fits all kernels */
+#define SOFTVOL_LANES	16
+
+static void softvol_s16_tail(int16_t *d, const int16_t *s, snd_pcm_uframes_t samples,
+			     const int16_t *gain, unsigned int period, unsigned int j)
+{
+	const int16_t *mask = gain + period;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = (((int)s[i] * gain[j]) >> 16) + (s[i] & mask[j]);
+		if (++j == period)
+			j = 0;
+	}
+}
+
+static void softvol_s24_tail(int32_t *d, const int32_t *s, snd_pcm_uframes_t samples,
+			     const uint32_t *gain, unsigned int period, unsigned int j)
+{
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++) {
+		int32_t v = (int32_t)((uint32_t)s[i] << 8) >> 8;
+		d[i] = ((int64_t)v * gain[j]) >> 16;
+		if (++j == period)
+			j = 0;
+	}
+}
+
+static void softvol_s32_tail(int32_t *d, const int32_t *s, snd_pcm_uframes_t samples,
+			     const uint32_t *gain, unsigned int period, unsigned int j)
+{
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = ((int64_t)s[i] * gain[j]) >> 16;
+		if (++j == period)
+			j = 0;
+	}
+}
+
+static void softvol_float_tail(float *d, const float *s, snd_pcm_uframes_t samples,
+			       const float *gain, unsigned int period, unsigned int j)
+{
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = s[i] * gain[j];
+		if (++j == period)
+			j = 0;
+	}
+}
+
+static void softvol_s16_generic(void *dst, const void *src, snd_pcm_uframes_t samples,
+				const void *gtab, unsigned int period)
+{
+	softvol_s16_tail(dst, src, samples, gtab, period, 0);
+}
+
+static void softvol_s24_generic(void *dst, const void *src, snd_pcm_uframes_t samples,
+				const void *gtab, unsigned int period)
+{
+	softvol_s24_tail(dst, src, samples, gtab, period, 0);
+}
+
+static void softvol_s32_generic(void *dst, const void *src, snd_pcm_uframes_t samples,
+				const void *gtab, unsigned int period)
+{
+	softvol_s32_tail(dst, src, samples, gtab, period, 0);
+}
+
+static void softvol_float_generic(void *dst, const void *src, snd_pcm_uframes_t samples,
+				  const void *gtab, unsigned int period)
+{
+	softvol_float_tail(dst, src, samples, gtab, period, 0);
+}
+
+static const softvol_kernels_t softvol_kernels_generic = {
+	softvol_s16_generic, softvol_s24_generic,
+	softvol_s32_generic, softvol_float_generic
+};
+
+#ifdef SOFTVOL_SIMD_X86
+__attribute__((target("sse2")))
+static void softvol_s16_sse2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int16_t *s = src, *gain = gtab, *mask = gain + period;
+	int16_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i g = _mm_loadu_si128((const __m128i *)(gain + j));
+		__m128i m = _mm_loadu_si128((const __m128i *)(mask + j));
+		x = _mm_add_epi16(_mm_mulhi_epi16(x, g), _mm_and_si128(x, m));
+		_mm_storeu_si128((__m128i *)(d + i), x);
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s16_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+/* (x * gain) >> 16 of the signed x and 0 <= gain <= 0x10000 */
+__attribute__((target("sse2")))
+static inline __m128i softvol_mul_s32_sse2(__m128i x, __m128i g)
+{
+	__m128i even = _mm_mul_epu32(x, g);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(g, 32));
+	__m128i corr;
+
+	even = _mm_and_si128(_mm_srli_epi64(even, 16), _mm_set_epi32(0, -1, 0, -1));
+	odd = _mm_slli_epi64(_mm_srli_epi64(odd, 16), 32);
+	/* the unsigned product is off by gain << 32 for a negative x */
+	corr = _mm_slli_epi32(_mm_and_si128(_mm_srai_epi32(x, 31), g), 16);
+	return _mm_sub_epi32(_mm_or_si128(even, odd), corr);
+}
+
+__attribute__((target("sse2")))
+static void softvol_s24_sse2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int32_t *s = src;
+	const uint32_t *gain = gtab;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i g = _mm_loadu_si128((const __m128i *)(gain + j));
+		x = _mm_srai_epi32(_mm_slli_epi32(x, 8), 8);
+		_mm_storeu_si128((__m128i *)(d + i), softvol_mul_s32_sse2(x, g));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s24_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+__attribute__((target("sse2")))
+static void softvol_s32_sse2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int32_t *s = src;
+	const uint32_t *gain = gtab;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i g = _mm_loadu_si128((const __m128i *)(gain + j));
+		_mm_storeu_si128((__m128i *)(d + i), softvol_mul_s32_sse2(x, g));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s32_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+__attribute__((target("sse2")))
+static void softvol_float_sse2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			       const void *gtab, unsigned int period)
+{
+	const float *s = src, *gain = gtab;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128 x = _mm_loadu_ps(s + i);
+		_mm_storeu_ps(d + i, _mm_mul_ps(x, _mm_loadu_ps(gain + j)));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	softvol_float_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+static const softvol_kernels_t softvol_kernels_sse2 = {
+	softvol_s16_sse2, softvol_s24_sse2,
+	softvol_s32_sse2, softvol_float_sse2
+};
+
+__attribute__((target("avx2")))
+static void softvol_s16_avx2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int16_t *s = src, *gain = gtab, *mask = gain + period;
+	int16_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 16 <= samples; i += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i g = _mm256_loadu_si256((const __m256i *)(gain + j));
+		__m256i m = _mm256_loadu_si256((const __m256i *)(mask + j));
+		x = _mm256_add_epi16(_mm256_mulhi_epi16(x, g), _mm256_and_si256(x, m));
+		_mm256_storeu_si256((__m256i *)(d + i), x);
+		j += 16;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s16_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+/* (x * gain) >> 16, only the low 32 bits of each product are kept */
+__attribute__((target("avx2")))
+static inline __m256i softvol_mul_s32_avx2(__m256i x, __m256i g)
+{
+	__m256i even = _mm256_mul_epi32(x, g);
+	__m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(x, 32),
+				       _mm256_srli_epi64(g, 32));
+
+	even = _mm256_srli_epi64(even, 16);
+	odd = _mm256_slli_epi64(_mm256_srli_epi64(odd, 16), 32);
+	return _mm256_blend_epi32(even, odd, 0xaa);
+}
+
+__attribute__((target("avx2")))
+static void softvol_s24_avx2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int32_t *s = src;
+	const uint32_t *gain = gtab;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i g = _mm256_loadu_si256((const __m256i *)(gain + j));
+		x = _mm256_srai_epi32(_mm256_slli_epi32(x, 8), 8);
+		_mm256_storeu_si256((__m256i *)(d + i), softvol_mul_s32_avx2(x, g));
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s24_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+__attribute__((target("avx2")))
+static void softvol_s32_avx2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int32_t *s = src;
+	const uint32_t *gain = gtab;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i g = _mm256_loadu_si256((const __m256i *)(gain + j));
+		_mm256_storeu_si256((__m256i *)(d + i), softvol_mul_s32_avx2(x, g));
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s32_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+__attribute__((target("avx2")))
+static void softvol_float_avx2(void *dst, const void *src, snd_pcm_uframes_t samples,
+			       const void *gtab, unsigned int period)
+{
+	const float *s = src, *gain = gtab;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256 x = _mm256_loadu_ps(s + i);
+		_mm256_storeu_ps(d + i, _mm256_mul_ps(x, _mm256_loadu_ps(gain + j)));
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	softvol_float_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+static const softvol_kernels_t softvol_kernels_avx2 = {
+	softvol_s16_avx2, softvol_s24_avx2,
+	softvol_s32_avx2, softvol_float_avx2
+};
+#endif /* SOFTVOL_SIMD_X86 */
+
+#ifdef SOFTVOL_SIMD_NEON
+static void softvol_s16_neon(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int16_t *s = src, *gain = gtab, *mask = gain + period;
+	int16_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		int16x8_t x = vld1q_s16(s + i);
+		int16x8_t g = vld1q_s16(gain + j);
+		int16x4_t lo = vshrn_n_s32(vmull_s16(vget_low_s16(x), vget_low_s16(g)), 16);
+		int16x4_t hi = vshrn_n_s32(vmull_s16(vget_high_s16(x), vget_high_s16(g)), 16);
+		x = vaddq_s16(vcombine_s16(lo, hi), vandq_s16(x, vld1q_s16(mask + j)));
+		vst1q_s16(d + i, x);
+		j += 8;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s16_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+static inline int32x4_t softvol_mul_s32_neon(int32x4_t x, int32x4_t g)
+{
+	int32x2_t lo = vshrn_n_s64(vmull_s32(vget_low_s32(x), vget_low_s32(g)), 16);
+	int32x2_t hi = vshrn_n_s64(vmull_s32(vget_high_s32(x), vget_high_s32(g)), 16);
+	return vcombine_s32(lo, hi);
+}
+
+static void softvol_s24_neon(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int32_t *s = src;
+	const uint32_t *gain = gtab;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		int32x4_t x = vshrq_n_s32(vshlq_n_s32(vld1q_s32(s + i), 8), 8);
+		int32x4_t g = vreinterpretq_s32_u32(vld1q_u32(gain + j));
+		vst1q_s32(d + i, softvol_mul_s32_neon(x, g));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s24_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+static void softvol_s32_neon(void *dst, const void *src, snd_pcm_uframes_t samples,
+			     const void *gtab, unsigned int period)
+{
+	const int32_t *s = src;
+	const uint32_t *gain = gtab;
+	int32_t *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		int32x4_t g = vreinterpretq_s32_u32(vld1q_u32(gain + j));
+		vst1q_s32(d + i, softvol_mul_s32_neon(vld1q_s32(s + i), g));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	softvol_s32_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+static void softvol_float_neon(void *dst, const void *src, snd_pcm_uframes_t samples,
+			       const void *gtab, unsigned int period)
+{
+	const float *s = src, *gain = gtab;
+	float *d = dst;
+	snd_pcm_uframes_t i;
+	unsigned int j = 0;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		vst1q_f32(d + i, vmulq_f32(vld1q_f32(s + i), vld1q_f32(gain + j)));
+		j += 4;
+		if (j == period)
+			j = 0;
+	}
+	softvol_float_tail(d + i, s + i, samples - i, gain, period, j);
+}
+
+static const softvol_kernels_t softvol_kernels_neon = {
+	softvol_s16_neon, softvol_s24_neon,
+	softvol_s32_neon, softvol_float_neon
+};
+#endif /* SOFTVOL_SIMD_NEON */
+
+static const softvol_kernels_t *softvol_select_kernels(void)
+{
+#if defined(SOFTVOL_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return &softvol_kernels_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return &softvol_kernels_sse2;
+#elif defined(SOFTVOL_SIMD_NEON)
+	return &softvol_kernels_neon;
+#endif
+	return &softvol_kernels_generic;
+}
+
+static softvol_kernel_t softvol_find_kernel(snd_pcm_format_t format)
+{
+	const softvol_kernels_t *k = softvol_select_kernels();
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return k->s16;
+	case SND_PCM_FORMAT_S24:
+		return snd_pcm_format_cpu_endian(format) ? k->s24 : NULL;
+	case SND_PCM_FORMAT_S32:
+		return k->s32;
+	case SND_PCM_FORMAT_FLOAT:
+		return k->flt;
+	default:
+		return NULL;
+	}
+}
+
+/* fill the kernel gain table for the given channel gains */
+static void softvol_setup_gtab(snd_pcm_softvol_t *svol, const unsigned int *gains,
+			       unsigned int channels, unsigned int period)
+{
+	unsigned int j;
+
+	for (j = 0; j < period; j++) {
+		/* 0xffff is the 0 dB value */
+		unsigned int g = gains[j % channels];
+		if (g == 0xffff)
+			g = 1 << VOL_SCALE_SHIFT;
+		switch (svol->sformat) {
+		case SND_PCM_FORMAT_S16: {
+			int16_t *gain = svol->gtab;
+			gain[j] = g >= 0x8000 ? (int)g - 0x10000 : (int)g;
+			gain[period + j] = g >= 0x8000 ? -1 : 0;
+			break;
+		}
+		case SND_PCM_FORMAT_FLOAT:
+			((float *)svol->gtab)[j] = (float)g / (1 << VOL_SCALE_SHIFT);
+			break;
+		default:
+			((uint32_t *)svol->gtab)[j] = g;
+			break;
+		}
+	}
+}
+
+/* the start address when the areas are packed interleaved */
+static char *softvol_areas_interleaved(const snd_pcm_channel_area_t *areas,
+				       snd_pcm_uframes_t offset,
+				       unsigned int channels, unsigned int width)
+{
+	unsigned int ch;
+
+	for (ch = 0; ch < channels; ch++) {
+		if (areas[ch].addr != areas[0].addr ||
+		    areas[ch].first != areas[0].first + ch * width ||
+		    areas[ch].step != channels * width)
+			return NULL;
+	}
+	if (areas[0].first % 8)
+		return NULL;
+	return snd_pcm_channel_area_addr(&areas[0], offset);
+}
+
+/*
+ * convert with the SIMD kernel when the gains and the buffer layout
+ * allow it, returns 1 if done
+ */
+static int softvol_convert_kernel(snd_pcm_softvol_t *svol,
+				  const snd_pcm_channel_area_t *dst_areas,
+				  snd_pcm_uframes_t dst_offset,
+				  const snd_pcm_channel_area_t *src_areas,
+				  snd_pcm_uframes_t src_offset,
+				  unsigned int channels,
+				  snd_pcm_uframes_t frames)
+{
+	unsigned int width, ch;
+	char *src, *dst;
+
+	if (!svol->kernel || channels > svol->channels)
+		return 0;
+	if (!snd_pcm_format_float(svol->sformat)) {
+		for (ch = 0; ch < channels; ch++)
+			if (svol->gains[ch] > (1 << VOL_SCALE_SHIFT))
+				return 0;
+	}
+	width = snd_pcm_format_physical_width(svol->sformat);
+	src = softvol_areas_interleaved(src_areas, src_offset, channels, width);
+	dst = softvol_areas_interleaved(dst_areas, dst_offset, channels, width);
+	if (src && dst) {
+		softvol_setup_gtab(svol, svol->gains, channels,
+				   channels * SOFTVOL_LANES);
+		svol->kernel(dst, src, frames * channels, svol->gtab,
+			     channels * SOFTVOL_LANES);
+		return 1;
+	}
+	/* packed non-interleaved channels */
+	for (ch = 0; ch < channels; ch++) {
+		if (src_areas[ch].step != width || src_areas[ch].first % 8 ||
+		    dst_areas[ch].step != width || dst_areas[ch].first % 8)
+			return 0;
+	}
+	for (ch = 0; ch < channels; ch++) {
+		softvol_setup_gtab(svol, svol->gains + ch, 1, SOFTVOL_LANES);
+		svol->kernel(snd_pcm_channel_area_addr(&dst_areas[ch], dst_offset),
+			     snd_pcm_channel_area_addr(&src_areas[ch], src_offset),
+			     frames, svol->gtab, SOFTVOL_LANES);
+	}
+	return 1;
+}
+#endif /* DOC_HIDDEN */
+
 /* 2-channel stereo control */
 static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 				       const snd_pcm_channel_area_t *dst_areas,
@@ -335,6 +909,9 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 				   channels, frames, svol->sformat);
 		return;
 	}
+	if (softvol_convert_kernel(svol, dst_areas, dst_offset,
+				   src_areas, src_offset, channels, frames))
+		return;
 
 	if (svol->max_val == 1) {
 		vol[0] = svol->cur_vol[0] ? 0xffff : 0;
@@ -365,6 +942,11 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+	case SND_PCM_FORMAT_FLOAT_BE:
+		CONVERT_AREA(float,
+			     !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
 	default:
 		break;
 	}
@@ -395,6 +977,9 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 				   channels, frames, svol->sformat);
 		return;
 	}
+	if (softvol_convert_kernel(svol, dst_areas, dst_offset,
+				   src_areas, src_offset, channels, frames))
+		return;
 
 	if (svol->max_val == 1)
 		vol_scale = svol->cur_vol[0] ? 0xffff : 0;
@@ -420,6 +1005,11 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+	case SND_PCM_FORMAT_FLOAT_BE:
+		CONVERT_AREA(float,
+			     !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
 	default:
 		break;
 	}
@@ -428,15 +1018,37 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 /*
  * get the current volume value from driver
  *
- * TODO: mmap support?
+ * With the ctl events subscribed, the value is read only after a change
+ * notification; the pending events are drained by a non-blocking read.
  */
 static void get_current_volume(snd_pcm_softvol_t *svol)
 {
 	unsigned int val;
 	unsigned int i;
 
+	if (svol->ctl_events) {
+		snd_ctl_event_t event;
+		int err;
+
+		while ((err = snd_ctl_read(svol->ctl, &event)) > 0) {
+			if (snd_ctl_event_get_type(&event) != SND_CTL_EVENT_ELEM ||
+			    !(snd_ctl_event_elem_get_mask(&event) & SND_CTL_EVENT_MASK_VALUE))
+				continue;
+			if (!svol->elem.id.numid ||
+			    snd_ctl_event_elem_get_numid(&event) == svol->elem.id.numid)
+				svol->vol_dirty = 1;
+		}
+		if (err < 0 && err != -EAGAIN) {
+			/* fall back to reading the value each time */
+			svol->ctl_events = 0;
+			svol->vol_dirty = 1;
+		}
+		if (!svol->vol_dirty)
+			return;
+	}
 	if (snd_ctl_elem_read(svol->ctl, &svol->elem) < 0)
 		return;
+	svol->vol_dirty = 0;
 	for (i = 0; i < svol->cchannels; i++) {
 		val = svol->elem.value.integer.value[i];
 		if (val > svol->max_val)
@@ -445,6 +1057,212 @@ static void get_current_volume(snd_pcm_softvol_t *svol)
 	}
 }
 
+#ifndef DOC_HIDDEN
+/* the per-channel gains, mapped like GET_VOL_SCALE */
+static void softvol_get_gains(snd_pcm_softvol_t *svol, unsigned int *gains,
+			      unsigned int channels)
+{
+	unsigned int vol[2], vol_c, ch;
+
+	if (svol->cchannels == 1) {
+		if (svol->max_val == 1)
+			vol_c = svol->cur_vol[0] ? 0xffff : 0;
+		else
+			vol_c = svol->dB_value[svol->cur_vol[0]];
+		vol[0] = vol[1] = vol_c;
+	} else if (svol->max_val == 1) {
+		vol[0] = svol->cur_vol[0] ? 0xffff : 0;
+		vol[1] = svol->cur_vol[1] ? 0xffff : 0;
+		vol_c = vol[0] | vol[1];
+	} else {
+		vol[0] = svol->dB_value[svol->cur_vol[0]];
+		vol[1] = svol->dB_value[svol->cur_vol[1]];
+		vol_c = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
+	}
+	for (ch = 0; ch < channels; ch++) {
+		switch (ch) {
+		case 0:
+		case 2:
+			gains[ch] = (channels == ch + 1) ? vol_c : vol[0];
+			break;
+		case 4:
+		case 5:
+			gains[ch] = vol_c;
+			break;
+		default:
+			gains[ch] = vol[ch & 1];
+			break;
+		}
+	}
+}
+
+/* the ramp gain of the channel at the given position */
+static unsigned int softvol_ramp_gain(snd_pcm_softvol_t *svol, unsigned int ch,
+				      snd_pcm_uframes_t pos)
+{
+	unsigned int from = svol->ramp_from[ch], to = svol->ramp_to[ch];
+
+	if (pos >= svol->ramp_len)
+		return to;
+#ifndef HAVE_SOFT_FLOAT
+	if (svol->ramp == SOFTVOL_RAMP_EXPONENTIAL) {
+		double f = from ? from : 1, t = to ? to : 1;
+		return (unsigned int)(f * pow(t / f, (double)pos / svol->ramp_len) + 0.5);
+	}
+#endif
+	return from + ((long long)to - from) * (long long)pos / (long long)svol->ramp_len;
+}
+
+/*
+ * refresh the per-channel gains and start a ramp from the gains applied
+ * so far when they changed
+ */
+static void softvol_update_gains(snd_pcm_t *pcm, snd_pcm_softvol_t *svol)
+{
+	unsigned int ch, channels = svol->channels;
+
+	softvol_get_gains(svol, svol->gains, channels);
+	if (svol->ramp == SOFTVOL_RAMP_NONE)
+		return;
+	if (!svol->ramp_valid) {
+		memcpy(svol->ramp_to, svol->gains, channels * sizeof(*svol->gains));
+		svol->ramp_pos = svol->ramp_len = 0;
+		svol->ramp_valid = 1;
+		return;
+	}
+	if (!memcmp(svol->ramp_to, svol->gains, channels * sizeof(*svol->gains)))
+		return;
+	for (ch = 0; ch < channels; ch++)
+		svol->ramp_from[ch] = softvol_ramp_gain(svol, ch, svol->ramp_pos);
+	memcpy(svol->ramp_to, svol->gains, channels * sizeof(*svol->gains));
+	svol->ramp_pos = 0;
+	svol->ramp_len = pcm->period_size;
+}
+
+static void softvol_apply_sample(snd_pcm_format_t format, char *dst,
+				 const char *src, unsigned int vol)
+{
+	int swap = !snd_pcm_format_cpu_endian(format);
+	int tmp;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		*(short *)dst = vol == 0xffff ? *(const short *)src :
+			MULTI_DIV_short(*(const short *)src, vol, swap);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		*(int *)dst = vol == 0xffff ? *(const int *)src :
+			MULTI_DIV_int(*(const int *)src, vol, swap);
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+		tmp = *(const int *)src << 8;
+		tmp = (signed int) tmp >> 8;
+		*(int *)dst = vol == 0xffff ? *(const int *)src :
+			MULTI_DIV_24(tmp, vol);
+		break;
+	case SND_PCM_FORMAT_S24_3LE:
+		tmp = (unsigned char)src[0] | ((unsigned char)src[1] << 8) |
+		      (((const signed char *) src)[2] << 16);
+		if (vol != 0xffff)
+			tmp = MULTI_DIV_24(tmp, vol);
+		dst[0] = tmp;
+		dst[1] = tmp >> 8;
+		dst[2] = tmp >> 16;
+		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+	case SND_PCM_FORMAT_FLOAT_BE:
+		*(float *)dst = MULTI_DIV_float(*(const float *)src, vol, swap);
+		break;
+	default:
+		break;
+	}
+}
+
+/* apply the running ramp, returns the number of processed frames */
+static snd_pcm_uframes_t softvol_ramp(snd_pcm_softvol_t *svol,
+				      const snd_pcm_channel_area_t *dst_areas,
+				      snd_pcm_uframes_t dst_offset,
+				      const snd_pcm_channel_area_t *src_areas,
+				      snd_pcm_uframes_t src_offset,
+				      unsigned int channels,
+				      snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t pos = svol->ramp_pos, len = svol->ramp_len, fr;
+	unsigned int ch;
+
+	if (frames > len - pos)
+		frames = len - pos;
+	for (ch = 0; ch < channels; ch++) {
+		const char *src = snd_pcm_channel_area_addr(&src_areas[ch], src_offset);
+		char *dst = snd_pcm_channel_area_addr(&dst_areas[ch], dst_offset);
+		unsigned int src_step = snd_pcm_channel_area_step(&src_areas[ch]);
+		unsigned int dst_step = snd_pcm_channel_area_step(&dst_areas[ch]);
+		unsigned int vol = 0, to = svol->ramp_to[ch];
+#ifndef HAVE_SOFT_FLOAT
+		double g = 0, r = 1;
+		if (svol->ramp == SOFTVOL_RAMP_EXPONENTIAL) {
+			double f = svol->ramp_from[ch] ? svol->ramp_from[ch] : 1;
+			r = pow((to ? to : 1) / f, 1.0 / len);
+			g = f * pow(r, pos);
+		}
+#endif
+		for (fr = 1; fr <= frames; fr++) {
+#ifndef HAVE_SOFT_FLOAT
+			if (svol->ramp == SOFTVOL_RAMP_EXPONENTIAL) {
+				g *= r;
+				vol = pos + fr < len ? (unsigned int)(g + 0.5) : to;
+			} else
+#endif
+				vol = softvol_ramp_gain(svol, ch, pos + fr);
+			softvol_apply_sample(svol->sformat, dst, src, vol);
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+	svol->ramp_pos += frames;
+	return frames;
+}
+
+static void softvol_convert(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t done = 0;
+
+	get_current_volume(svol);
+	softvol_update_gains(pcm, svol);
+	if (svol->ramp_pos < svol->ramp_len)
+		done = softvol_ramp(svol, dst_areas, dst_offset,
+				    src_areas, src_offset, pcm->channels, frames);
+	if (done >= frames)
+		return;
+	if (svol->cchannels == 1)
+		softvol_convert_mono_vol(svol, dst_areas, dst_offset + done,
+					 src_areas, src_offset + done,
+					 pcm->channels, frames - done);
+	else
+		softvol_convert_stereo_vol(svol, dst_areas, dst_offset + done,
+					   src_areas, src_offset + done,
+					   pcm->channels, frames - done);
+}
+#endif /* DOC_HIDDEN */
+
+static void softvol_free_gains(snd_pcm_softvol_t *svol)
+{
+	free(svol->gains);
+	free(svol->ramp_from);
+	free(svol->ramp_to);
+	free(svol->gtab);
+	svol->gains = svol->ramp_from = svol->ramp_to = NULL;
+	svol->gtab = NULL;
+	svol->channels = 0;
+}
+
 static void softvol_free(snd_pcm_softvol_t *svol)
 {
 	if (svol->plug.gen.close_slave)
@@ -453,6 +1271,7 @@ static void softvol_free(snd_pcm_softvol_t *svol)
 		snd_ctl_close(svol->ctl);
 	if (svol->dB_value && svol->dB_value != preset_dB_value)
 		free(svol->dB_value);
+	softvol_free_gains(svol);
 	free(svol);
 }
 
@@ -475,7 +1294,9 @@ static int snd_pcm_softvol_hw_refine_cprepare(snd_pcm_t *pcm,
 			(1ULL << SND_PCM_FORMAT_S16_BE) |
 			(1ULL << SND_PCM_FORMAT_S24_LE) |
 			(1ULL << SND_PCM_FORMAT_S32_LE) |
- 			(1ULL << SND_PCM_FORMAT_S32_BE),
+ 			(1ULL << SND_PCM_FORMAT_S32_BE) |
+			(1ULL << SND_PCM_FORMAT_FLOAT_LE) |
+			(1ULL << SND_PCM_FORMAT_FLOAT_BE),
 			(1ULL << (SND_PCM_FORMAT_S24_3LE - 32))
 		}
 	};
@@ -619,6 +1440,7 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 {
 	snd_pcm_softvol_t *svol = pcm->private_data;
 	snd_pcm_t *slave = svol->plug.gen.slave;
+	unsigned int channels;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_softvol_hw_refine_cchange,
 					  snd_pcm_softvol_hw_refine_sprepare,
@@ -631,12 +1453,49 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 	    slave->format != SND_PCM_FORMAT_S24_3LE && 
 	    slave->format != SND_PCM_FORMAT_S24_LE &&
 	    slave->format != SND_PCM_FORMAT_S32_LE &&
-	    slave->format != SND_PCM_FORMAT_S32_BE) {
+	    slave->format != SND_PCM_FORMAT_S32_BE &&
+	    slave->format != SND_PCM_FORMAT_FLOAT_LE &&
+	    slave->format != SND_PCM_FORMAT_FLOAT_BE) {
 		SNDERR("softvol supports only S16_LE, S16_BE, S24_LE, S24_3LE, "
-		       "S32_LE or S32_BE");
+		       "S32_LE, S32_BE, FLOAT_LE or FLOAT_BE");
 		return -EINVAL;
 	}
 	svol->sformat = slave->format;
+	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	softvol_free_gains(svol);
+	svol->gains = calloc(channels, sizeof(*svol->gains));
+	svol->ramp_from = calloc(channels, sizeof(*svol->ramp_from));
+	svol->ramp_to = calloc(channels, sizeof(*svol->ramp_to));
+	svol->gtab = malloc(channels * SOFTVOL_LANES * 2 * sizeof(int32_t));
+	if (!svol->gains || !svol->ramp_from || !svol->ramp_to || !svol->gtab) {
+		softvol_free_gains(svol);
+		return -ENOMEM;
+	}
+	svol->channels = channels;
+	svol->kernel = softvol_find_kernel(svol->sformat);
+	svol->ramp_valid = 0;
+	svol->ramp_pos = svol->ramp_len = 0;
+	return 0;
+}
+
+static int snd_pcm_softvol_hw_free(snd_pcm_t *pcm)
+{
+	snd_pcm_softvol_t *svol = pcm->private_data;
+
+	softvol_free_gains(svol);
+	return snd_pcm_generic_hw_free(pcm);
+}
+
+static int snd_pcm_softvol_init(snd_pcm_t *pcm)
+{
+	snd_pcm_softvol_t *svol = pcm->private_data;
+
+	/* start again from the current volume without a ramp */
+	svol->vol_dirty = 1;
+	svol->ramp_valid = 0;
+	svol->ramp_pos = svol->ramp_len = 0;
 	return 0;
 }
 
@@ -652,13 +1511,8 @@ snd_pcm_softvol_write_areas(snd_pcm_t *pcm,
 	snd_pcm_softvol_t *svol = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, slave_areas, slave_offset,
-					 areas, offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, slave_areas, slave_offset,
-					   areas, offset, pcm->channels, size);
+	softvol_convert(pcm, svol, slave_areas, slave_offset,
+			areas, offset, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -675,13 +1529,8 @@ snd_pcm_softvol_read_areas(snd_pcm_t *pcm,
 	snd_pcm_softvol_t *svol = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, areas, offset, slave_areas,
-					 slave_offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, areas, offset, slave_areas,
-					   slave_offset, pcm->channels, size);
+	softvol_convert(pcm, svol, areas, offset,
+			slave_areas, slave_offset, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -698,6 +1547,10 @@ static void snd_pcm_softvol_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "max_dB: %g\n", svol->max_dB);
 		snd_output_printf(out, "resolution: %d\n", svol->max_val + 1);
 	}
+	if (svol->ramp != SOFTVOL_RAMP_NONE)
+		snd_output_printf(out, "ramp: %s\n",
+				  svol->ramp == SOFTVOL_RAMP_LINEAR ?
+				  "linear" : "exponential");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -841,6 +1694,14 @@ static int softvol_load_control(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
 		}
 	}
 
+	/* the value is refreshed on change events, polled otherwise */
+	svol->vol_dirty = 1;
+	if (snd_ctl_nonblock(svol->ctl, 1) < 0 ||
+	    snd_ctl_subscribe_events(svol->ctl, 1) < 0)
+		snd_ctl_nonblock(svol->ctl, 0);
+	else
+		svol->ctl_events = 1;
+
 	if (svol->max_val == 1)
 		return 0;
 
@@ -880,7 +1741,7 @@ static const snd_pcm_ops_t snd_pcm_softvol_ops = {
 	.info = snd_pcm_generic_info,
 	.hw_refine = snd_pcm_softvol_hw_refine,
 	.hw_params = snd_pcm_softvol_hw_params,
-	.hw_free = snd_pcm_generic_hw_free,
+	.hw_free = snd_pcm_softvol_hw_free,
 	.sw_params = snd_pcm_generic_sw_params,
 	.channel_info = snd_pcm_generic_channel_info,
 	.dump = snd_pcm_softvol_dump,
@@ -928,7 +1789,9 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	    sformat != SND_PCM_FORMAT_S24_3LE && 
 	    sformat != SND_PCM_FORMAT_S24_LE &&
 	    sformat != SND_PCM_FORMAT_S32_LE &&
-	    sformat != SND_PCM_FORMAT_S32_BE)
+	    sformat != SND_PCM_FORMAT_S32_BE &&
+	    sformat != SND_PCM_FORMAT_FLOAT_LE &&
+	    sformat != SND_PCM_FORMAT_FLOAT_BE)
 		return -EINVAL;
 	svol = calloc(1, sizeof(*svol));
 	if (! svol)
@@ -955,6 +1818,7 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	svol->plug.write = snd_pcm_softvol_write_areas;
 	svol->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	svol->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	svol->plug.init = snd_pcm_softvol_init;
 	svol->plug.gen.slave = slave;
 	svol->plug.gen.close_slave = close_slave;
 
@@ -1122,9 +1986,20 @@ pcm.name {
 	[max_dB REAL]           # maximal dB value (default:   0.0)
 	[resolution INT]        # resolution (default: 256)
 				# resolution = 2 means a mute switch
+	[ramp STR]              # volume change ramp: none, linear or
+				# exponential (default: none)
 }
 \endcode
 
+The slave format can be S16, S24 (4 bytes or 3 bytes) or S32 in either
+endianness or FLOAT.  The attenuation of the packed native S16, S24, S32
+and FLOAT samples uses SIMD instructions when the CPU has them.
+
+With \c ramp set, a volume change is not applied at once but faded in
+over one period, linearly or with a constant dB step per frame
+(exponential), to avoid clicks.  The ramp is restarted from the gain
+reached so far when the volume changes again in the middle.
+
 \subsection pcm_plugins_softvol_funcref Function reference
 
 <UL>
@@ -1162,6 +2037,7 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	double min_dB = PRESET_MIN_DB;
 	double max_dB = ZERO_DB;
 	int card = -1, cchannels = 2;
+	int ramp = SOFTVOL_RAMP_NONE;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1204,6 +2080,25 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "ramp") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid ramp value");
+				return err;
+			}
+			if (strcmp(str, "none") == 0)
+				ramp = SOFTVOL_RAMP_NONE;
+			else if (strcmp(str, "linear") == 0)
+				ramp = SOFTVOL_RAMP_LINEAR;
+			else if (strcmp(str, "exponential") == 0)
+				ramp = SOFTVOL_RAMP_EXPONENTIAL;
+			else {
+				SNDERR("Invalid ramp type %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1246,8 +2141,11 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		    sformat != SND_PCM_FORMAT_S24_3LE && 
 		    sformat != SND_PCM_FORMAT_S24_LE &&
 		    sformat != SND_PCM_FORMAT_S32_LE &&
-		    sformat != SND_PCM_FORMAT_S32_BE) {
-			SNDERR("only S16_LE, S16_BE, S24_LE, S24_3LE, S32_LE or S32_BE format is supported");
+		    sformat != SND_PCM_FORMAT_S32_BE &&
+		    sformat != SND_PCM_FORMAT_FLOAT_LE &&
+		    sformat != SND_PCM_FORMAT_FLOAT_BE) {
+			SNDERR("only S16_LE, S16_BE, S24_LE, S24_3LE, S32_LE, S32_BE, "
+			       "FLOAT_LE or FLOAT_BE format is supported");
 			snd_config_delete(sconf);
 			return -EINVAL;
 		}
@@ -1265,6 +2163,10 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 					   resolution, spcm, 1);
 		if (err < 0)
 			snd_pcm_close(spcm);
+		else if (*pcmp != spcm) {
+			snd_pcm_softvol_t *svol = (*pcmp)->private_data;
+			svol->ramp = ramp;
+		}
 	}
 	return err;
 }
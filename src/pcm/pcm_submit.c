@@ -0,0 +1,856 @@
+/**
+ * \file pcm/pcm_submit.c
+ * \ingroup PCM_Submit
+ * \brief PCM Submission Queue
+ * \date 2026
+ *
+ * A queue batching the transfers and the waits of many PCMs.
+ */
+/*
+ *  PCM - Submission queue
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "pcm_local.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define SUBMIT_URING
+#endif
+
+/**
+ * \page pcm_submit PCM submission queue
+ *
+ * A server driving many cards spends a poll() per wakeup and an ioctl per
+ * transfer and per PCM.  The submission queue collects the transfers and
+ * the waits of any number of PCMs: snd_pcm_submit_writei(),
+ * snd_pcm_submit_readi() and snd_pcm_submit_poll() only queue a request
+ * and snd_pcm_submit_run() executes the whole batch.
+ *
+ * When the kernel supports io_uring, the transfers of the interleaved
+ * read/write hw PCMs go to the kernel together with the waits of all
+ * queued PCMs and the timeout, in a single io_uring_enter() call per
+ * wakeup.  The other PCMs are transferred by snd_pcm_writei() or
+ * snd_pcm_readi() and only their waits are batched.  Without io_uring, or
+ * with #SND_PCM_SUBMIT_NO_URING, the waits are done by a single poll() on
+ * the descriptors of all queued PCMs.
+ *
+ * \code
+ * snd_pcm_submit_open(&sub, 16, 0);
+ * for (;;) {
+ * 	for (i = 0; i < n; i++)
+ * 		write_idx[i] = snd_pcm_submit_writei(sub, pcm[i], buf[i], frames);
+ * 	for (i = 0; i < n; i++)
+ * 		poll_idx[i] = snd_pcm_submit_poll(sub, pcm[i]);
+ * 	snd_pcm_submit_run(sub, -1);
+ * 	for (i = 0; i < n; i++) {
+ * 		written = snd_pcm_submit_result(sub, write_idx[i]);
+ * 		ready = snd_pcm_submit_result(sub, poll_idx[i]);
+ * 		...
+ * 	}
+ * }
+ * \endcode
+ */
+
+#ifndef DOC_HIDDEN
+
+/* descriptors per PCM wait */
+#define SUBMIT_MAX_PFDS		4
+
+enum {
+	SUBMIT_WRITE,
+	SUBMIT_READ,
+	SUBMIT_POLL,
+};
+
+struct submit_req {
+	snd_pcm_t *pcm;
+	int type;
+	void *buf;
+	snd_pcm_uframes_t frames;
+	snd_pcm_sframes_t result;
+	int done;
+	unsigned int npfds;
+	struct pollfd pfds[SUBMIT_MAX_PFDS];
+	unsigned int armed;		/* bitmask of the pfds in flight */
+};
+
+#ifdef SUBMIT_URING
+/* user_data tags of the requests not bound to a queue entry */
+#define SUBMIT_TAG_TIMEOUT	(~0ULL)
+#define SUBMIT_TAG_CANCEL	(~1ULL)
+#define SUBMIT_SLOT_XFER	0xff
+
+struct submit_ring {
+	int fd;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_len, cq_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int sq_entries;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned int tail;		/* local SQ tail */
+	unsigned int to_submit;
+	int ext_arg;			/* io_uring_enter() takes a timeout */
+};
+#endif
+
+struct _snd_pcm_submit {
+	unsigned int size;
+	unsigned int count;
+	int finished;		/* the queue holds the results of a run */
+	struct submit_req *reqs;
+	struct pollfd *pfds;	/* poll() backend */
+#ifdef SUBMIT_URING
+	int uring;
+	struct submit_ring ring;
+#endif
+};
+
+#endif /* DOC_HIDDEN */
+
+static int submit_state_error(snd_pcm_t *pcm)
+{
+	switch (snd_pcm_state(pcm)) {
+	case SND_PCM_STATE_XRUN:
+		return -EPIPE;
+	case SND_PCM_STATE_SUSPENDED:
+		return -ESTRPIPE;
+	case SND_PCM_STATE_DISCONNECTED:
+		return -ENODEV;
+	default:
+		return -EIO;
+	}
+}
+
+/* like the avail check in snd_pcm_wait(), returns 1 when no wait is needed */
+static int submit_poll_ready(struct submit_req *req)
+{
+	snd_pcm_t *pcm = req->pcm;
+	int ready;
+
+	__snd_pcm_lock(pcm->fast_op_arg);
+	ready = __snd_pcm_state(pcm) != SND_PCM_STATE_DRAINING &&
+		!snd_pcm_may_wait_for_avail_min(pcm, snd_pcm_mmap_avail(pcm));
+	__snd_pcm_unlock(pcm->fast_op_arg);
+	return ready;
+}
+
+/* evaluate the returned events, 0 means the wait goes on */
+static int submit_poll_result(struct submit_req *req)
+{
+	unsigned short revents;
+	int err;
+
+	err = snd_pcm_poll_descriptors_revents(req->pcm, req->pfds, req->npfds,
+					       &revents);
+	if (err < 0)
+		return err;
+	if (revents & (POLLERR | POLLNVAL))
+		return submit_state_error(req->pcm);
+	return (revents & (POLLIN | POLLOUT)) ? 1 : 0;
+}
+
+static void submit_transfer(struct submit_req *req)
+{
+	if (req->type == SUBMIT_WRITE)
+		req->result = snd_pcm_writei(req->pcm, req->buf, req->frames);
+	else
+		req->result = snd_pcm_readi(req->pcm, req->buf, req->frames);
+	req->done = 1;
+}
+
+static long long submit_elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000000LL +
+		(now.tv_nsec - start->tv_nsec);
+}
+
+static int submit_run_poll(snd_pcm_submit_t *sub, int timeout)
+{
+	struct timespec start;
+	unsigned int i, j, npfds;
+	int ready = 0, wait = 0, err;
+
+	for (i = 0; i < sub->count; i++) {
+		struct submit_req *req = &sub->reqs[i];
+
+		if (req->type != SUBMIT_POLL) {
+			submit_transfer(req);
+		} else if (submit_poll_ready(req)) {
+			req->result = 1;
+			req->done = 1;
+			ready++;
+		} else {
+			wait = 1;
+		}
+	}
+	if (ready || !wait)
+		return ready;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		int t = timeout;
+
+		npfds = 0;
+		for (i = 0; i < sub->count; i++) {
+			struct submit_req *req = &sub->reqs[i];
+
+			if (req->type != SUBMIT_POLL)
+				continue;
+			memcpy(sub->pfds + npfds, req->pfds,
+			       req->npfds * sizeof(*req->pfds));
+			npfds += req->npfds;
+		}
+		if (timeout > 0) {
+			t = timeout - submit_elapsed_ns(&start) / 1000000;
+			if (t < 0)
+				t = 0;
+		}
+		err = poll(sub->pfds, npfds, t);
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!err)
+			return 0;
+		snd_pcm_wakeup_new_seq();
+		npfds = 0;
+		for (i = 0; i < sub->count; i++) {
+			struct submit_req *req = &sub->reqs[i];
+
+			if (req->type != SUBMIT_POLL)
+				continue;
+			for (j = 0; j < req->npfds; j++)
+				req->pfds[j].revents = sub->pfds[npfds + j].revents;
+			npfds += req->npfds;
+			req->result = submit_poll_result(req);
+			if (req->result) {
+				req->done = 1;
+				ready++;
+			}
+		}
+		if (ready)
+			return ready;
+	}
+}
+
+#ifdef SUBMIT_URING
+
+static int ring_enter(struct submit_ring *ring, unsigned int min_complete,
+		      struct __kernel_timespec *ts)
+{
+	unsigned int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+	void *arg = NULL;
+	size_t argsz = 0;
+	int err;
+#ifdef IORING_FEAT_EXT_ARG
+	struct io_uring_getevents_arg ext;
+
+	if (ts) {
+		memset(&ext, 0, sizeof(ext));
+		ext.sigmask_sz = 8;
+		ext.ts = (unsigned long)ts;
+		flags |= IORING_ENTER_EXT_ARG;
+		arg = &ext;
+		argsz = sizeof(ext);
+	}
+#endif
+
+	__atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+	do {
+		err = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit,
+			      min_complete, flags, arg, argsz);
+	} while (err < 0 && errno == EINTR);
+	if (err < 0)
+		return -errno;
+	/* err is the count of the entries consumed, at most to_submit */
+	if ((unsigned int)err < ring->to_submit)
+		ring->to_submit -= err;
+	else
+		ring->to_submit = 0;
+	return 0;
+}
+
+static struct io_uring_sqe *ring_get_sqe(struct submit_ring *ring)
+{
+	struct io_uring_sqe *sqe;
+
+	if (ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+	    ring->sq_entries) {
+		/* the ring is full, hand over the queued entries */
+		if (ring_enter(ring, 0, NULL) < 0)
+			return NULL;
+		if (ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+		    ring->sq_entries)
+			return NULL;
+	}
+	sqe = &ring->sqes[ring->tail & *ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[ring->tail & *ring->sq_mask] = ring->tail & *ring->sq_mask;
+	ring->tail++;
+	ring->to_submit++;
+	return sqe;
+}
+
+static void ring_free(struct submit_ring *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	if (ring->sq_ptr)
+		munmap(ring->sq_ptr, ring->sq_len);
+	if (ring->fd >= 0)
+		close(ring->fd);
+}
+
+static int ring_probe(struct submit_ring *ring)
+{
+	static const unsigned char ops[] = {
+		IORING_OP_READ, IORING_OP_WRITE, IORING_OP_POLL_ADD,
+		IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL,
+	};
+	struct io_uring_probe *probe;
+	size_t size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+	unsigned int i;
+	int err = 0;
+
+	probe = calloc(1, size);
+	if (!probe)
+		return -ENOMEM;
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+		    probe, 256) < 0) {
+		err = -errno;
+		goto out;
+	}
+	for (i = 0; i < sizeof(ops); i++) {
+		if (ops[i] > probe->last_op ||
+		    !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+			err = -EOPNOTSUPP;
+			break;
+		}
+	}
+ out:
+	free(probe);
+	return err;
+}
+
+static int ring_init(struct submit_ring *ring, unsigned int entries)
+{
+	struct io_uring_params p;
+	int err;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -errno;
+	err = ring_probe(ring);
+	if (err < 0)
+		goto error;
+
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_len > ring->sq_len)
+			ring->sq_len = ring->cq_len;
+		ring->cq_len = ring->sq_len;
+	}
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED) {
+		ring->sq_ptr = NULL;
+		err = -errno;
+		goto error;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, ring->fd,
+				    IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED) {
+			ring->cq_ptr = NULL;
+			err = -errno;
+			goto error;
+		}
+	}
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		err = -errno;
+		goto error;
+	}
+	ring->sq_head = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.head);
+	ring->sq_tail = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	ring->cq_head = (unsigned int *)((char *)ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)((char *)ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+#ifdef IORING_FEAT_EXT_ARG
+	ring->ext_arg = !!(p.features & IORING_FEAT_EXT_ARG);
+#endif
+	return 0;
+
+ error:
+	ring_free(ring);
+	return err;
+}
+
+static int ring_arm_poll(struct submit_ring *ring, struct submit_req *req,
+			 unsigned int index)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int j;
+
+	for (j = 0; j < req->npfds; j++) {
+		if (req->armed & (1U << j))
+			continue;
+		sqe = ring_get_sqe(ring);
+		if (!sqe)
+			return -EBUSY;
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = req->pfds[j].fd;
+		sqe->poll_events = req->pfds[j].events;
+		sqe->user_data = ((unsigned long long)index << 8) | j;
+		req->pfds[j].revents = 0;
+		req->armed |= 1U << j;
+	}
+	return 0;
+}
+
+static int ring_cancel(struct submit_ring *ring, unsigned long long user_data)
+{
+	struct io_uring_sqe *sqe = ring_get_sqe(ring);
+
+	if (!sqe)
+		return -EBUSY;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = user_data;
+	sqe->user_data = SUBMIT_TAG_CANCEL;
+	return 0;
+}
+
+struct submit_uring_run {
+	unsigned int xfers;	/* transfers in flight */
+	unsigned int polls;	/* waits in flight */
+	unsigned int cancels;
+	int ready;
+	int timeout_armed;
+	int timed_out;
+	int stopping;
+};
+
+static int submit_uring_arm(snd_pcm_submit_t *sub, struct submit_uring_run *run,
+			    unsigned int index)
+{
+	struct submit_req *req = &sub->reqs[index];
+	unsigned int armed = req->armed;
+	int err;
+
+	err = ring_arm_poll(&sub->ring, req, index);
+	run->polls += __builtin_popcount(req->armed & ~armed);
+	return err;
+}
+
+static int submit_uring_reap(snd_pcm_submit_t *sub, struct submit_uring_run *run)
+{
+	struct submit_ring *ring = &sub->ring;
+	unsigned int head, tail;
+	int err = 0;
+
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+		unsigned long long data = cqe->user_data;
+		struct submit_req *req;
+		unsigned int slot;
+
+		if (data == SUBMIT_TAG_TIMEOUT) {
+			run->timeout_armed = 0;
+			run->timed_out = 1;
+			continue;
+		}
+		if (data == SUBMIT_TAG_CANCEL) {
+			run->cancels--;
+			continue;
+		}
+		req = &sub->reqs[data >> 8];
+		slot = data & 0xff;
+		if (slot == SUBMIT_SLOT_XFER) {
+			if (cqe->res >= 0)
+				req->result = snd_pcm_bytes_to_frames(req->pcm, cqe->res);
+			else
+				req->result = snd_pcm_check_error(req->pcm, cqe->res);
+			req->done = 1;
+			run->xfers--;
+			continue;
+		}
+		req->armed &= ~(1U << slot);
+		run->polls--;
+		if (cqe->res < 0 || req->done)
+			continue;
+		req->pfds[slot].revents = cqe->res;
+		snd_pcm_wakeup_new_seq();
+		req->result = submit_poll_result(req);
+		if (req->result) {
+			req->done = 1;
+			run->ready++;
+		} else if (!run->stopping && !run->timed_out && err >= 0) {
+			/* spurious wakeup */
+			err = submit_uring_arm(sub, run, data >> 8);
+		}
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	return err;
+}
+
+static int submit_run_uring(snd_pcm_submit_t *sub, int timeout)
+{
+	struct submit_ring *ring = &sub->ring;
+	struct submit_uring_run run;
+	struct __kernel_timespec ts;
+	struct timespec start;
+	struct io_uring_sqe *sqe;
+	unsigned int i, j;
+	int err = 0, wait = 0;
+
+	memset(&run, 0, sizeof(run));
+	for (i = 0; i < sub->count; i++) {
+		struct submit_req *req = &sub->reqs[i];
+		int fd;
+
+		if (req->type == SUBMIT_POLL) {
+			if (submit_poll_ready(req)) {
+				req->result = 1;
+				req->done = 1;
+				run.ready++;
+			} else {
+				wait = 1;
+			}
+			continue;
+		}
+		fd = snd_pcm_hw_transfer_fd(req->pcm);
+		sqe = fd >= 0 && req->frames ? ring_get_sqe(ring) : NULL;
+		if (!sqe) {
+			submit_transfer(req);
+			continue;
+		}
+		sqe->opcode = req->type == SUBMIT_WRITE ?
+			IORING_OP_WRITE : IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->addr = (unsigned long)req->buf;
+		sqe->len = snd_pcm_frames_to_bytes(req->pcm, req->frames);
+		sqe->off = -1;
+		sqe->user_data = ((unsigned long long)i << 8) | SUBMIT_SLOT_XFER;
+		run.xfers++;
+	}
+	if (wait && !run.ready) {
+		for (i = 0; i < sub->count && err >= 0; i++) {
+			if (sub->reqs[i].type == SUBMIT_POLL)
+				err = submit_uring_arm(sub, &run, i);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (err >= 0 && timeout >= 0 && !ring->ext_arg) {
+			/* older kernels, a timer request cancelled at the end */
+			sqe = ring_get_sqe(ring);
+			if (sqe) {
+				ts.tv_sec = timeout / 1000;
+				ts.tv_nsec = (timeout % 1000) * 1000000L;
+				sqe->opcode = IORING_OP_TIMEOUT;
+				sqe->addr = (unsigned long)&ts;
+				sqe->len = 1;
+				sqe->user_data = SUBMIT_TAG_TIMEOUT;
+				run.timeout_armed = 1;
+			} else {
+				err = -EBUSY;
+			}
+		}
+	}
+
+	/* one io_uring_enter() per wakeup submits everything and waits */
+	while (err >= 0 &&
+	       (run.xfers || (run.polls && !run.ready && !run.timed_out))) {
+		if (run.polls && !run.ready && !run.timed_out &&
+		    timeout >= 0 && ring->ext_arg) {
+			long long left = timeout * 1000000LL - submit_elapsed_ns(&start);
+
+			if (left <= 0) {
+				run.timed_out = 1;
+				continue;
+			}
+			ts.tv_sec = left / 1000000000LL;
+			ts.tv_nsec = left % 1000000000LL;
+			err = ring_enter(ring, 1, &ts);
+			if (err == -ETIME)
+				err = 0;
+		} else {
+			err = ring_enter(ring, 1, NULL);
+		}
+		if (err >= 0)
+			err = submit_uring_reap(sub, &run);
+	}
+
+	/* collect what is still in flight, the buffers must stay valid */
+	run.stopping = 1;
+	for (i = 0; i < sub->count; i++) {
+		struct submit_req *req = &sub->reqs[i];
+
+		for (j = 0; j < req->npfds; j++) {
+			if ((req->armed & (1U << j)) &&
+			    ring_cancel(ring, ((unsigned long long)i << 8) | j) >= 0)
+				run.cancels++;
+		}
+	}
+	if (run.timeout_armed && ring_cancel(ring, SUBMIT_TAG_TIMEOUT) >= 0)
+		run.cancels++;
+	while (run.xfers || run.polls || run.timeout_armed || run.cancels) {
+		if (ring_enter(ring, 1, NULL) < 0)
+			break;
+		submit_uring_reap(sub, &run);
+	}
+	return err < 0 ? err : run.ready;
+}
+
+#endif /* SUBMIT_URING */
+
+/**
+ * \brief Create a PCM submission queue
+ * \param subp Returns the queue handle
+ * \param entries Number of requests queued at most at once
+ * \param flags #SND_PCM_SUBMIT_NO_URING or 0
+ * \return 0 on success otherwise a negative error code
+ *
+ * See the \ref pcm_submit page for the details.
+ */
+int snd_pcm_submit_open(snd_pcm_submit_t **subp, unsigned int entries, int flags)
+{
+	snd_pcm_submit_t *sub;
+
+	assert(subp);
+	if (!entries)
+		return -EINVAL;
+	sub = calloc(1, sizeof(*sub));
+	if (!sub)
+		return -ENOMEM;
+	sub->size = entries;
+	sub->reqs = calloc(entries, sizeof(*sub->reqs));
+	sub->pfds = calloc(entries * SUBMIT_MAX_PFDS, sizeof(*sub->pfds));
+	if (!sub->reqs || !sub->pfds) {
+		free(sub->reqs);
+		free(sub->pfds);
+		free(sub);
+		return -ENOMEM;
+	}
+#ifdef SUBMIT_URING
+	/* the waits, their cancellation and the timeout */
+	if (!(flags & SND_PCM_SUBMIT_NO_URING) &&
+	    ring_init(&sub->ring, entries * SUBMIT_MAX_PFDS * 2 + 2) >= 0)
+		sub->uring = 1;
+#endif
+	*subp = sub;
+	return 0;
+}
+
+/**
+ * \brief Free a PCM submission queue
+ * \param sub Queue handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The PCMs referred by the queued requests are not closed.
+ */
+int snd_pcm_submit_close(snd_pcm_submit_t *sub)
+{
+	assert(sub);
+#ifdef SUBMIT_URING
+	if (sub->uring)
+		ring_free(&sub->ring);
+#endif
+	free(sub->pfds);
+	free(sub->reqs);
+	free(sub);
+	return 0;
+}
+
+static struct submit_req *submit_add(snd_pcm_submit_t *sub, snd_pcm_t *pcm,
+				     int type)
+{
+	struct submit_req *req;
+
+	if (sub->finished) {
+		sub->count = 0;
+		sub->finished = 0;
+	}
+	if (sub->count >= sub->size)
+		return NULL;
+	req = &sub->reqs[sub->count];
+	memset(req, 0, sizeof(*req));
+	req->pcm = pcm;
+	req->type = type;
+	return req;
+}
+
+static int submit_add_transfer(snd_pcm_submit_t *sub, snd_pcm_t *pcm, int type,
+			       void *buffer, snd_pcm_uframes_t size)
+{
+	struct submit_req *req;
+
+	assert(sub && pcm);
+	assert(size == 0 || buffer);
+	if (!pcm->setup) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	req = submit_add(sub, pcm, type);
+	if (!req)
+		return -EBUSY;
+	req->buf = buffer;
+	req->frames = size;
+	return sub->count++;
+}
+
+/**
+ * \brief Queue an interleaved write
+ * \param sub Queue handle
+ * \param pcm PCM handle
+ * \param buffer Frames containing buffer, valid until snd_pcm_submit_run() returns
+ * \param size Frames to be written
+ * \return the request index on success otherwise a negative error code
+ *
+ * The result of snd_pcm_submit_result() is the one of snd_pcm_writei().
+ */
+int snd_pcm_submit_writei(snd_pcm_submit_t *sub, snd_pcm_t *pcm,
+			  const void *buffer, snd_pcm_uframes_t size)
+{
+	return submit_add_transfer(sub, pcm, SUBMIT_WRITE, (void *)buffer, size);
+}
+
+/**
+ * \brief Queue an interleaved read
+ * \param sub Queue handle
+ * \param pcm PCM handle
+ * \param buffer Frames containing buffer, valid until snd_pcm_submit_run() returns
+ * \param size Frames to be read
+ * \return the request index on success otherwise a negative error code
+ *
+ * The result of snd_pcm_submit_result() is the one of snd_pcm_readi().
+ */
+int snd_pcm_submit_readi(snd_pcm_submit_t *sub, snd_pcm_t *pcm,
+			 void *buffer, snd_pcm_uframes_t size)
+{
+	return submit_add_transfer(sub, pcm, SUBMIT_READ, buffer, size);
+}
+
+/**
+ * \brief Queue a wait for a PCM to get ready
+ * \param sub Queue handle
+ * \param pcm PCM handle
+ * \return the request index on success otherwise a negative error code
+ *
+ * The result of snd_pcm_submit_result() is the one of snd_pcm_wait():
+ * 1 when the PCM is ready, 0 when the timeout of snd_pcm_submit_run()
+ * expired or another queued PCM got ready first, or a negative error code.
+ */
+int snd_pcm_submit_poll(snd_pcm_submit_t *sub, snd_pcm_t *pcm)
+{
+	struct submit_req *req;
+	int npfds, err;
+
+	assert(sub && pcm);
+	npfds = snd_pcm_poll_descriptors_count(pcm);
+	if (npfds <= 0 || npfds > SUBMIT_MAX_PFDS) {
+		SNDERR("Invalid poll_fds %d", npfds);
+		return -EIO;
+	}
+	req = submit_add(sub, pcm, SUBMIT_POLL);
+	if (!req)
+		return -EBUSY;
+	err = snd_pcm_poll_descriptors(pcm, req->pfds, npfds);
+	if (err < 0)
+		return err;
+	req->npfds = err;
+	return sub->count++;
+}
+
+/**
+ * \brief Execute the queued requests
+ * \param sub Queue handle
+ * \param timeout maximum time in milliseconds to wait for a PCM,
+ *        a negative value means infinity
+ * \return the number of the waits finished, 0 on timeout, otherwise
+ *         a negative error code
+ *
+ * All the transfers are completed, then the function returns as soon as
+ * at least one of the queued PCMs waited for is ready, or the timeout
+ * expires.  The results stay available until the next request is queued,
+ * which starts a new batch.
+ */
+int snd_pcm_submit_run(snd_pcm_submit_t *sub, int timeout)
+{
+	int err;
+
+	assert(sub);
+	if (sub->finished)
+		return 0;
+#ifdef SUBMIT_URING
+	if (sub->uring)
+		err = submit_run_uring(sub, timeout);
+	else
+#endif
+		err = submit_run_poll(sub, timeout);
+	sub->finished = 1;
+	return err;
+}
+
+/**
+ * \brief Get the result of an executed request
+ * \param sub Queue handle
+ * \param index Request index returned when it was queued
+ * \return the result of the request, see the queueing functions
+ */
+snd_pcm_sframes_t snd_pcm_submit_result(snd_pcm_submit_t *sub, unsigned int index)
+{
+	assert(sub);
+	if (!sub->finished || index >= sub->count)
+		return -EINVAL;
+	return sub->reqs[index].result;
+}
@@ -0,0 +1,320 @@
+/**
+ * \file pcm/pcm_wakeup.c
+ * \ingroup PCM_Wakeup
+ * \brief PCM Wakeup Groups
+ * \date 2026
+ *
+ * A single timer waking a whole group of PCMs.
+ */
+/*
+ *  PCM - Wakeup groups
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "pcm_local.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
+/**
+ * \page pcm_wakeup PCM wakeup groups
+ *
+ * A server polling the descriptors of many PCMs wakes up once per period
+ * of every PCM, even when all of them run with the same period on the
+ * same card.  A wakeup group replaces these wakeups with a single timer
+ * running at the shortest period of its members.  The server polls the
+ * one descriptor of the group and, after each expiration,
+ * snd_pcm_wakeup_group_ready() tells which members reached their
+ * avail_min.
+ *
+ * The timer is aligned to the member with the shortest period: it
+ * expires when the avail of that PCM reaches avail_min.  When a wakeup
+ * finds this PCM not ready yet, because the timer drifted against the
+ * sound card clock, the timer is re-aligned to it.  A member in an error
+ * state (e.g. an xrun) is reported as ready, so that the caller sees the
+ * error on its next transfer.
+ *
+ * The PCM wakeups still happen in the kernel.  To avoid them as well,
+ * disable them with snd_pcm_hw_params_set_period_wakeup() where the
+ * hardware supports it.
+ *
+ * \code
+ * snd_pcm_wakeup_group_open(&group);
+ * for (i = 0; i < n; i++)
+ * 	snd_pcm_wakeup_group_add(group, pcm[i]);
+ * snd_pcm_wakeup_group_poll_descriptors(group, &pfd, 1);
+ * for (;;) {
+ * 	poll(&pfd, 1, -1);
+ * 	ready = snd_pcm_wakeup_group_ready(group, pcms, n);
+ * 	for (i = 0; i < ready; i++)
+ * 		... transfer on pcms[i] ...
+ * }
+ * \endcode
+ */
+
+#ifndef DOC_HIDDEN
+
+struct _snd_pcm_wakeup_group {
+	int fd;
+	unsigned int count;
+	unsigned int size;
+	snd_pcm_t **pcms;
+	snd_pcm_t *align;		/* member with the shortest period */
+	unsigned long long period_ns;
+};
+
+#endif /* DOC_HIDDEN */
+
+static unsigned long long pcm_period_ns(snd_pcm_t *pcm)
+{
+	return pcm->period_size * 1000000000ULL / pcm->rate;
+}
+
+/* nanoseconds until the avail of pcm reaches avail_min, 0 if already */
+static unsigned long long pcm_time_to_ready(snd_pcm_t *pcm)
+{
+	snd_pcm_sframes_t avail;
+
+	if (snd_pcm_state(pcm) != SND_PCM_STATE_RUNNING)
+		return pcm_period_ns(pcm);
+	avail = snd_pcm_avail_update(pcm);
+	if (avail < 0 || (snd_pcm_uframes_t)avail >= pcm->avail_min)
+		return 0;
+	return (pcm->avail_min - avail) * 1000000000ULL / pcm->rate;
+}
+
+#ifdef HAVE_SYS_TIMERFD_H
+static void ns_to_timespec(unsigned long long ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
+/* (re)start the timer, the first expiration is after delay ns */
+static int group_arm(snd_pcm_wakeup_group_t *group, unsigned long long delay)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (group->period_ns) {
+		/* a zero it_value would disarm the timer */
+		ns_to_timespec(delay ? delay : 1, &its.it_value);
+		ns_to_timespec(group->period_ns, &its.it_interval);
+	}
+	if (timerfd_settime(group->fd, 0, &its, NULL) < 0)
+		return -errno;
+	return 0;
+}
+#else
+static int group_arm(snd_pcm_wakeup_group_t *group ATTRIBUTE_UNUSED,
+		     unsigned long long delay ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+#endif
+
+/* pick the member with the shortest period and align the timer to it */
+static int group_update(snd_pcm_wakeup_group_t *group)
+{
+	unsigned long long ns;
+	unsigned int i;
+
+	group->align = NULL;
+	group->period_ns = 0;
+	for (i = 0; i < group->count; i++) {
+		ns = pcm_period_ns(group->pcms[i]);
+		if (!group->align || ns < group->period_ns) {
+			group->align = group->pcms[i];
+			group->period_ns = ns;
+		}
+	}
+	return group_arm(group, group->align ? pcm_time_to_ready(group->align) : 0);
+}
+
+/**
+ * \brief Create a PCM wakeup group
+ * \param groupp Returned group handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_wakeup_group_open(snd_pcm_wakeup_group_t **groupp)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	snd_pcm_wakeup_group_t *group;
+
+	assert(groupp);
+	group = calloc(1, sizeof(*group));
+	if (!group)
+		return -ENOMEM;
+	group->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (group->fd < 0) {
+		free(group);
+		return -errno;
+	}
+	*groupp = group;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Free a PCM wakeup group
+ * \param group Group handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The member PCMs are left open.
+ */
+int snd_pcm_wakeup_group_close(snd_pcm_wakeup_group_t *group)
+{
+	assert(group);
+	close(group->fd);
+	free(group->pcms);
+	free(group);
+	return 0;
+}
+
+/**
+ * \brief Add a PCM to a wakeup group
+ * \param group Group handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The PCM must be set up with snd_pcm_hw_params() and stay set up while
+ * it is a member.  Remove it with snd_pcm_wakeup_group_remove() before
+ * closing it.  The timer is re-aligned when the shortest period changes.
+ */
+int snd_pcm_wakeup_group_add(snd_pcm_wakeup_group_t *group, snd_pcm_t *pcm)
+{
+	snd_pcm_t **pcms;
+	unsigned int i;
+
+	assert(group && pcm);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	if (!pcm->rate)
+		return -EINVAL;
+	for (i = 0; i < group->count; i++)
+		if (group->pcms[i] == pcm)
+			return -EBUSY;
+	if (group->count == group->size) {
+		pcms = realloc(group->pcms, (group->size + 8) * sizeof(*pcms));
+		if (!pcms)
+			return -ENOMEM;
+		group->pcms = pcms;
+		group->size += 8;
+	}
+	group->pcms[group->count++] = pcm;
+	if (group->align && pcm_period_ns(pcm) >= group->period_ns)
+		return 0;
+	return group_update(group);
+}
+
+/**
+ * \brief Remove a PCM from a wakeup group
+ * \param group Group handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_wakeup_group_remove(snd_pcm_wakeup_group_t *group, snd_pcm_t *pcm)
+{
+	unsigned int i;
+
+	assert(group && pcm);
+	for (i = 0; i < group->count; i++)
+		if (group->pcms[i] == pcm)
+			break;
+	if (i == group->count)
+		return -ENOENT;
+	memmove(group->pcms + i, group->pcms + i + 1,
+		(group->count - i - 1) * sizeof(*group->pcms));
+	group->count--;
+	if (pcm != group->align)
+		return 0;
+	return group_update(group);
+}
+
+/**
+ * \brief Get the poll descriptor of a wakeup group
+ * \param group Group handle
+ * \param pfds Array of poll descriptors
+ * \param space Space in the poll descriptor array
+ * \return count of filled descriptors
+ *
+ * The group has a single descriptor, which becomes readable (POLLIN) at
+ * each expiration of the group timer.
+ */
+int snd_pcm_wakeup_group_poll_descriptors(snd_pcm_wakeup_group_t *group,
+					  struct pollfd *pfds, unsigned int space)
+{
+	assert(group && pfds);
+	if (space < 1)
+		return 0;
+	pfds->fd = group->fd;
+	pfds->events = POLLIN;
+	pfds->revents = 0;
+	return 1;
+}
+
+/**
+ * \brief Acknowledge the group timer and collect the ready PCMs
+ * \param group Group handle
+ * \param pcms Array receiving the ready member PCMs
+ * \param space Number of elements in the pcms array
+ * \return number of PCMs stored in pcms, otherwise a negative error code
+ *
+ * A member is ready when its avail reached avail_min or when it is in an
+ * error state.  Members that do not fit in \p pcms are left for the next
+ * call.  The function never blocks.
+ */
+int snd_pcm_wakeup_group_ready(snd_pcm_wakeup_group_t *group,
+			       snd_pcm_t **pcms, unsigned int space)
+{
+	snd_pcm_sframes_t avail;
+	unsigned int i, n = 0;
+	uint64_t expired;
+	int align_ready = 0;
+
+	assert(group && (pcms || space == 0));
+	/* the timer counter is reset by a read, EAGAIN when not expired */
+	if (read(group->fd, &expired, sizeof(expired)) < 0 && errno != EAGAIN)
+		return -errno;
+	for (i = 0; i < group->count && n < space; i++) {
+		snd_pcm_t *pcm = group->pcms[i];
+
+		avail = snd_pcm_avail_update(pcm);
+		if (avail >= 0 && (snd_pcm_uframes_t)avail < pcm->avail_min)
+			continue;
+		if (pcm == group->align)
+			align_ready = 1;
+		pcms[n++] = pcm;
+	}
+	/* the timer ran ahead of the sound card clock, wait for it */
+	if (group->align && !align_ready && i == group->count &&
+	    snd_pcm_state(group->align) == SND_PCM_STATE_RUNNING) {
+		int err = group_arm(group, pcm_time_to_ready(group->align));
+		if (err < 0)
+			return err;
+	}
+	return n;
+}
@@ -409,6 +409,82 @@ snd_rawmidi_stream_t snd_rawmidi_stream(snd_rawmidi_t *rawmidi)
 	return rawmidi->stream;
 }
 
+/**
+ * \brief set the busy-poll window of an input stream
+ * \param rawmidi RawMidi handle
+ * \param usec the window in microseconds, 0 to disable busy-polling
+ * \return 0 on success otherwise a negative error code
+ *
+ * When a window is set, a read first spins on the stream status until
+ * data arrives or the window expires, and only then returns \c -EAGAIN
+ * (nonblock mode) or sleeps in the kernel (blocking mode).  This trades
+ * CPU time for a lower and steadier input latency than a poll wakeup.
+ * The window used is adaptive: it halves, down to 1/16 of \p usec,
+ * each time it expires without data, and doubles back after each hit,
+ * so an idle stream doesn't keep a core busy.  Only the hw plugin
+ * implements busy-polling; the others ignore the setting.
+ */
+int snd_rawmidi_set_busy_poll(snd_rawmidi_t *rawmidi, unsigned int usec)
+{
+	assert(rawmidi);
+	if (rawmidi->stream != SND_RAWMIDI_STREAM_INPUT)
+		return -EINVAL;
+	rawmidi->busy_poll = usec;
+	return 0;
+}
+
+/**
+ * \brief get the busy-poll window of an input stream
+ * \param rawmidi RawMidi handle
+ * \return the window in microseconds, 0 when busy-polling is disabled
+ */
+unsigned int snd_rawmidi_get_busy_poll(snd_rawmidi_t *rawmidi)
+{
+	assert(rawmidi);
+	return rawmidi->busy_poll;
+}
+
+/**
+ * \brief set the read-ahead buffer of an input stream
+ * \param rawmidi RawMidi handle
+ * \param size the buffer size in bytes, 0 to read into the caller's buffer
+ * \return 0 on success otherwise a negative error code
+ *
+ * Each read of a hw stream is a system call, even when it takes a few
+ * bytes, as a parser fetching a message or a UMP packet at a time does.
+ * With a read-ahead buffer, a read done when the buffer is empty fetches
+ * all the input pending in the kernel, up to \p size bytes, and the next
+ * reads are served from the buffer without a system call.  A read asking
+ * for \p size bytes or more with the buffer empty goes directly to the
+ * caller's buffer.
+ *
+ * The buffered bytes are counted in the avail of snd_rawmidi_status(),
+ * but poll() on the descriptor does not see them: in nonblock mode, read
+ * until \c -EAGAIN before polling again.  Only the hw plugin implements
+ * the buffer, and not in the #SND_RAWMIDI_READ_TSTAMP mode, which already
+ * reads the frames ahead.  The UMP streams of snd_ump_read() use it
+ * through snd_ump_rawmidi().
+ */
+int snd_rawmidi_set_read_ahead(snd_rawmidi_t *rawmidi, size_t size)
+{
+	assert(rawmidi);
+	if (rawmidi->stream != SND_RAWMIDI_STREAM_INPUT)
+		return -EINVAL;
+	rawmidi->read_ahead = size;
+	return 0;
+}
+
+/**
+ * \brief get the read-ahead buffer size of an input stream
+ * \param rawmidi RawMidi handle
+ * \return the buffer size in bytes, 0 when the reads are not buffered
+ */
+size_t snd_rawmidi_get_read_ahead(snd_rawmidi_t *rawmidi)
+{
+	assert(rawmidi);
+	return rawmidi->read_ahead;
+}
+
 /**
  * \brief get count of poll descriptors for RawMidi handle
  * \param rawmidi RawMidi handle
@@ -1155,4 +1231,15 @@ int _snd_rawmidi_ump_block_info(snd_rawmidi_t *rmidi, void *info)
 		return -ENXIO;
 	return rmidi->ops->ump_block_info(rmidi, info);
 }
+
+/* like snd_rawmidi_tread() but only from the already received frames */
+ssize_t _snd_rawmidi_tread_pending(snd_rawmidi_t *rmidi, struct timespec *tstamp,
+				   void *buffer, size_t size)
+{
+	if ((rmidi->params_mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) != SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP)
+		return -EINVAL;
+	if (!rmidi->ops->tread_pending)
+		return 0;
+	return rmidi->ops->tread_pending(rmidi, tstamp, buffer, size);
+}
 #endif /* DOXYGEN */
@@ -49,6 +49,11 @@ typedef struct {
 	size_t buf_fill;	/* filled buffer size in bytes */
 	size_t buf_pos;		/* offset to frame in the read buffer (bytes) */
 	size_t buf_fpos;	/* offset to the frame data array (bytes 0-16) */
+	unsigned int poll_window;	/* current busy-poll window in usec */
+	unsigned char *ra_buf;	/* read-ahead buffer of the plain input */
+	size_t ra_size;
+	size_t ra_pos;
+	size_t ra_fill;
 } snd_rawmidi_hw_t;
 #endif
 
@@ -72,6 +77,7 @@ static int snd_rawmidi_hw_close(snd_rawmidi_t *rmidi)
 		SYSMSG("close failed");
 	}
 	free(hw->buf);
+	free(hw->ra_buf);
 	free(hw);
 	return err;
 }
@@ -148,6 +154,8 @@ static int snd_rawmidi_hw_status(snd_rawmidi_t *rmidi, snd_rawmidi_status_t * st
 		SYSMSG("SNDRV_RAWMIDI_IOCTL_STATUS failed");
 		return -errno;
 	}
+	if (rmidi->stream == SND_RAWMIDI_STREAM_INPUT)
+		status->avail += hw->ra_fill;
 	return 0;
 }
 
@@ -160,6 +168,8 @@ static int snd_rawmidi_hw_drop(snd_rawmidi_t *rmidi)
 		return -errno;
 	}
 	buf_reset(hw);
+	if (rmidi->stream == SND_RAWMIDI_STREAM_INPUT)
+		hw->ra_fill = 0;
 	return 0;
 }
 
@@ -184,10 +194,91 @@ static ssize_t snd_rawmidi_hw_write(snd_rawmidi_t *rmidi, const void *buffer, si
 	return result;
 }
 
+/*
+ * spin on the stream status until some input is available, for at most
+ * the busy-poll window; the window shrinks while it keeps expiring and
+ * grows back to the configured size after each hit
+ */
+static void hw_busy_poll(snd_rawmidi_t *rmidi)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	struct snd_rawmidi_status status;
+	struct timespec start, now;
+	long elapsed;
+
+	if (!rmidi->busy_poll || rmidi->stream != SND_RAWMIDI_STREAM_INPUT)
+		return;
+	if (!hw->poll_window || hw->poll_window > rmidi->busy_poll)
+		hw->poll_window = rmidi->busy_poll;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		memset(&status, 0, sizeof(status));
+		status.stream = rmidi->stream;
+		if (ioctl(hw->fd, SNDRV_RAWMIDI_IOCTL_STATUS, &status) < 0)
+			return;
+		if (status.avail > 0) {
+			hw->poll_window *= 2;
+			return;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000000 +
+			(now.tv_nsec - start.tv_nsec) / 1000;
+		if (elapsed >= (long)hw->poll_window)
+			break;
+	}
+	if (hw->poll_window > rmidi->busy_poll / 16)
+		hw->poll_window /= 2;
+}
+
+/*
+ * serve the reads from a buffer refilled with one read() of all the
+ * pending input, see snd_rawmidi_set_read_ahead()
+ */
+static ssize_t hw_read_ahead(snd_rawmidi_t *rmidi, void *buffer, size_t size)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	ssize_t result;
+	void *buf;
+
+	if (!hw->ra_fill) {
+		if (size >= rmidi->read_ahead) {
+			hw_busy_poll(rmidi);
+			result = read(hw->fd, buffer, size);
+			if (result < 0)
+				return -errno;
+			return result;
+		}
+		if (hw->ra_size != rmidi->read_ahead) {
+			buf = realloc(hw->ra_buf, rmidi->read_ahead);
+			if (buf == NULL)
+				return -ENOMEM;
+			hw->ra_buf = buf;
+			hw->ra_size = rmidi->read_ahead;
+		}
+		hw_busy_poll(rmidi);
+		result = read(hw->fd, hw->ra_buf, hw->ra_size);
+		if (result < 0)
+			return -errno;
+		hw->ra_pos = 0;
+		hw->ra_fill = result;
+	}
+	if (size > hw->ra_fill)
+		size = hw->ra_fill;
+	memcpy(buffer, hw->ra_buf + hw->ra_pos, size);
+	hw->ra_pos += size;
+	hw->ra_fill -= size;
+	return size;
+}
+
 static ssize_t snd_rawmidi_hw_read(snd_rawmidi_t *rmidi, void *buffer, size_t size)
 {
 	snd_rawmidi_hw_t *hw = rmidi->private_data;
 	ssize_t result;
+
+	/* the frames of the timestamp mode are buffered in hw->buf */
+	if (hw->ra_fill || (rmidi->read_ahead && !hw->buf))
+		return hw_read_ahead(rmidi, buffer, size);
+	hw_busy_poll(rmidi);
 	result = read(hw->fd, buffer, size);
 	if (result < 0)
 		return -errno;
@@ -262,6 +353,8 @@ static ssize_t snd_rawmidi_hw_tread(snd_rawmidi_t *rmidi, struct timespec *tstam
 	}
 
 	buf_reset(hw);
+	if (!result)
+		hw_busy_poll(rmidi);
 	ret = read(hw->fd, hw->buf, hw->buf_size);
 	if (ret < 0)
 		return result > 0 ? result : -errno;
@@ -274,6 +367,18 @@ static ssize_t snd_rawmidi_hw_tread(snd_rawmidi_t *rmidi, struct timespec *tstam
 	return ret + result;
 }
 
+static ssize_t snd_rawmidi_hw_tread_pending(snd_rawmidi_t *rmidi,
+					    struct timespec *tstamp,
+					    void *buffer, size_t size)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+
+	tstamp->tv_sec = tstamp->tv_nsec = 0;
+	if (hw->buf_fill < sizeof(struct snd_rawmidi_framing_tstamp))
+		return 0;
+	return read_from_ts_buf(hw, tstamp, buffer, size);
+}
+
 static int snd_rawmidi_hw_ump_endpoint_info(snd_rawmidi_t *rmidi, void *buf)
 {
 	snd_rawmidi_hw_t *hw = rmidi->private_data;
@@ -307,6 +412,7 @@ static const snd_rawmidi_ops_t snd_rawmidi_hw_ops = {
 	.write = snd_rawmidi_hw_write,
 	.read = snd_rawmidi_hw_read,
 	.tread = snd_rawmidi_hw_tread,
+	.tread_pending = snd_rawmidi_hw_tread_pending,
 	.ump_endpoint_info = snd_rawmidi_hw_ump_endpoint_info,
 	.ump_block_info = snd_rawmidi_hw_ump_block_info,
 };
@@ -35,6 +35,7 @@ typedef struct {
 	ssize_t (*write)(snd_rawmidi_t *rawmidi, const void *buffer, size_t size);
 	ssize_t (*read)(snd_rawmidi_t *rawmidi, void *buffer, size_t size);
 	ssize_t (*tread)(snd_rawmidi_t *rawmidi, struct timespec *tstamp, void *buffer, size_t size);
+	ssize_t (*tread_pending)(snd_rawmidi_t *rawmidi, struct timespec *tstamp, void *buffer, size_t size);
 	int (*ump_endpoint_info)(snd_rawmidi_t *rmidi, void *buf);
 	int (*ump_block_info)(snd_rawmidi_t *rmidi, void *buf);
 } snd_rawmidi_ops_t;
@@ -53,6 +54,8 @@ struct _snd_rawmidi {
 	size_t avail_min;
 	unsigned int no_active_sensing: 1;
 	int params_mode;
+	unsigned int busy_poll;		/* busy-poll window in usec, 0 = off */
+	size_t read_ahead;		/* input read-ahead buffer size, 0 = off */
 };
 
 int snd_rawmidi_hw_open(snd_rawmidi_t **input, snd_rawmidi_t **output,
@@ -67,5 +70,7 @@ int snd_rawmidi_virtual_open(snd_rawmidi_t **inputp, snd_rawmidi_t **outputp,
 
 int _snd_rawmidi_ump_endpoint_info(snd_rawmidi_t *rmidi, void *info);
 int _snd_rawmidi_ump_block_info(snd_rawmidi_t *rmidi, void *info);
+ssize_t _snd_rawmidi_tread_pending(snd_rawmidi_t *rmidi, struct timespec *tstamp,
+				   void *buffer, size_t size);
 
 #define _SND_RAWMIDI_OPEN_UMP	(1U << 16)	/* internal open mode bit */
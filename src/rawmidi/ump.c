@@ -119,6 +119,33 @@ int snd_ump_open(snd_ump_t **inputp, snd_ump_t **outputp, const char *name,
 	return err;
 }
 
+/* write out the combined packets, keeping what the device doesn't take */
+static int ump_flush(snd_ump_t *ump)
+{
+	ssize_t ret;
+
+	while (ump->wbuf_fill) {
+		ret = snd_rawmidi_write(ump->rawmidi, ump->wbuf, ump->wbuf_fill);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EAGAIN;
+		memmove(ump->wbuf, ump->wbuf + ret, ump->wbuf_fill - ret);
+		ump->wbuf_fill -= ret;
+	}
+	return 0;
+}
+
+/* microseconds since the oldest buffered write */
+static long ump_wbuf_age(snd_ump_t *ump)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - ump->wbuf_first.tv_sec) * 1000000L +
+		(now.tv_nsec - ump->wbuf_first.tv_nsec) / 1000;
+}
+
 /**
  * \brief close UMP handle
  * \param ump UMP handle
@@ -131,7 +158,10 @@ int snd_ump_close(snd_ump_t *ump)
 {
 	int err;
 
+	ump_flush(ump);
 	err = snd_rawmidi_close(ump->rawmidi);
+	free(ump->wbuf);
+	free(ump->info_cache);
 	free(ump);
 	return err;
 }
@@ -264,6 +294,7 @@ int snd_ump_rawmidi_status(snd_ump_t *ump, snd_rawmidi_status_t *status)
  */
 int snd_ump_drop(snd_ump_t *ump)
 {
+	ump->wbuf_fill = 0;
 	return snd_rawmidi_drop(ump->rawmidi);
 }
 
@@ -277,20 +308,164 @@ int snd_ump_drop(snd_ump_t *ump)
  */
 int snd_ump_drain(snd_ump_t *ump)
 {
+	int err;
+
+	err = ump_flush(ump);
+	if (err < 0)
+		return err;
 	return snd_rawmidi_drain(ump->rawmidi);
 }
 
+/**
+ * \brief combine the UMP writes of an output stream
+ * \param ump UMP handle
+ * \param size the buffer size in bytes, 0 to write each call at once
+ * \param usec the flush deadline in microseconds, 0 to flush when full
+ * \return 0 on success otherwise a negative error code
+ *
+ * Each snd_ump_write() is a system call, which is a lot for a stream
+ * written a packet at a time.  With a combining buffer, the writes are
+ * kept and passed to the device together, when the buffer is full, when
+ * a write comes \p usec after the oldest one kept, and on snd_ump_flush(),
+ * snd_ump_drain() and snd_ump_close().  The library has no timer: when
+ * the application stops writing, it has to flush the buffer itself, e.g.
+ * when snd_ump_flush_timeout() expires.  snd_ump_drop() discards it.
+ *
+ * The size is rounded down to whole 32-bit words.  The packets already
+ * buffered are flushed first.
+ */
+int snd_ump_set_write_combining(snd_ump_t *ump, size_t size, unsigned int usec)
+{
+	unsigned char *buf;
+	int err;
+
+	if (ump->is_input)
+		return -EINVAL;
+	err = ump_flush(ump);
+	if (err < 0)
+		return err;
+	size &= ~(size_t)3;
+	if (size != ump->wbuf_size) {
+		buf = size ? realloc(ump->wbuf, size) : NULL;
+		if (size && !buf)
+			return -ENOMEM;
+		if (!size)
+			free(ump->wbuf);
+		ump->wbuf = buf;
+		ump->wbuf_size = size;
+	}
+	ump->wbuf_usec = usec;
+	return 0;
+}
+
+/**
+ * \brief write out the combined UMP writes
+ * \param ump UMP handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * In nonblock mode, \c -EAGAIN is returned when the device couldn't take
+ * all the buffered packets; the rest stays buffered.
+ */
+int snd_ump_flush(snd_ump_t *ump)
+{
+	if (ump->is_input)
+		return -EINVAL;
+	return ump_flush(ump);
+}
+
+/**
+ * \brief get the time left until the combined UMP writes are due
+ * \param ump UMP handle
+ * \return the time left in microseconds, 0 when the deadline is passed,
+ *         or -1 when nothing is buffered or there is no deadline
+ *
+ * An application waiting for other events uses it as its poll timeout
+ * and calls snd_ump_flush() when it expires.
+ */
+long snd_ump_flush_timeout(snd_ump_t *ump)
+{
+	long age;
+
+	if (!ump->wbuf_fill || !ump->wbuf_usec)
+		return -1;
+	age = ump_wbuf_age(ump);
+	return age >= (long)ump->wbuf_usec ? 0 : (long)ump->wbuf_usec - age;
+}
+
 /**
  * \brief write UMP packets to UMP stream
  * \param ump UMP handle
  * \param buffer buffer containing UMP packets
  * \param size output buffer size in bytes
+ *
+ * With a combining buffer (see snd_ump_set_write_combining()), the
+ * packets may be kept and \p size returned, an error of the device being
+ * then returned by a later call.  A write larger than the buffer goes to
+ * the device after the buffered packets.
  */
 ssize_t snd_ump_write(snd_ump_t *ump, const void *buffer, size_t size)
 {
+	int err;
+
 	if (ump->is_input)
 		return -EINVAL;
-	return snd_rawmidi_write(ump->rawmidi, buffer, size);
+	if (!ump->wbuf_size)
+		return snd_rawmidi_write(ump->rawmidi, buffer, size);
+	if (size > ump->wbuf_size - ump->wbuf_fill) {
+		err = ump_flush(ump);
+		if (err < 0)
+			return err;
+		if (size > ump->wbuf_size)
+			return snd_rawmidi_write(ump->rawmidi, buffer, size);
+	}
+	if (!ump->wbuf_fill)
+		clock_gettime(CLOCK_MONOTONIC, &ump->wbuf_first);
+	memcpy(ump->wbuf + ump->wbuf_fill, buffer, size);
+	ump->wbuf_fill += size;
+	if (ump->wbuf_fill == ump->wbuf_size ||
+	    (ump->wbuf_usec && ump_wbuf_age(ump) >= (long)ump->wbuf_usec))
+		ump_flush(ump);	/* the rest stays buffered, see above */
+	return size;
+}
+
+/*
+ * endpoint and block info cache
+ */
+
+static void ump_info_drop(snd_ump_t *ump)
+{
+	ump->info_cache->ep_valid = 0;
+	ump->info_cache->blk_valid = 0;
+}
+
+/* drop the cached info when the input carries a UMP stream message */
+static void ump_info_scan(snd_ump_t *ump, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint32_t word;
+
+	while (len) {
+		if (ump->scan_bytes || len < 4) {
+			/* a word split between two reads */
+			((unsigned char *)&ump->scan_word)[ump->scan_bytes++] = *p++;
+			len--;
+			if (ump->scan_bytes < 4)
+				continue;
+			word = ump->scan_word;
+			ump->scan_bytes = 0;
+		} else {
+			memcpy(&word, p, 4);
+			p += 4;
+			len -= 4;
+		}
+		if (ump->scan_left) {
+			ump->scan_left--;
+			continue;
+		}
+		if (snd_ump_msg_type(&word) == SND_UMP_MSG_TYPE_STREAM)
+			ump_info_drop(ump);
+		ump->scan_left = snd_ump_packet_length(snd_ump_msg_type(&word)) - 1;
+	}
 }
 
 /**
@@ -302,9 +477,14 @@ ssize_t snd_ump_write(snd_ump_t *ump, const void *buffer, size_t size)
  */
 ssize_t snd_ump_read(snd_ump_t *ump, void *buffer, size_t size)
 {
+	ssize_t ret;
+
 	if (!ump->is_input)
 		return -EINVAL;
-	return snd_rawmidi_read(ump->rawmidi, buffer, size);
+	ret = snd_rawmidi_read(ump->rawmidi, buffer, size);
+	if (ret > 0 && ump->info_cache)
+		ump_info_scan(ump, buffer, ret);
+	return ret;
 }
 
 /**
@@ -318,9 +498,77 @@ ssize_t snd_ump_read(snd_ump_t *ump, void *buffer, size_t size)
 ssize_t snd_ump_tread(snd_ump_t *ump, struct timespec *tstamp, void *buffer,
 		      size_t size)
 {
+	ssize_t ret;
+
+	if (!ump->is_input)
+		return -EINVAL;
+	ret = snd_rawmidi_tread(ump->rawmidi, tstamp, buffer, size);
+	if (ret > 0 && ump->info_cache)
+		ump_info_scan(ump, buffer, ret);
+	return ret;
+}
+
+/**
+ * \brief read complete UMP packets with per-packet timestamps
+ * \param ump UMP handle
+ * \param[out] pkts array receiving the packets, one per 4-word slot
+ * \param[out] tstamps array receiving the timestamp of each packet, or NULL
+ * \param n the number of slots in \p pkts and \p tstamps
+ * \retval the number of packets read otherwise a negative error code
+ *
+ * The stream has to be in timestamp framing mode, see
+ * #snd_rawmidi_params_set_read_mode().  Unlike #snd_ump_tread(), which
+ * returns the bytes sharing a single timestamp, this function splits the
+ * input into whole UMP packets and gives each of them the timestamp of
+ * the frame holding its first word.  At most one read from the device is
+ * done per call, and only when no received frame is pending.  A packet
+ * cut at the end of the received data is kept and completed by the next
+ * call, so 0 may be returned in blocking mode.
+ */
+int snd_ump_read_packets(snd_ump_t *ump, uint32_t (*pkts)[4],
+			 struct timespec *tstamps, unsigned int n)
+{
+	struct timespec tstamp;
+	unsigned int count = 0, len;
+	int did_read = 0;
+	ssize_t ret;
+
 	if (!ump->is_input)
 		return -EINVAL;
-	return snd_rawmidi_tread(ump->rawmidi, tstamp, buffer, size);
+	while (count < n) {
+		if (ump->pkt_bytes < 4)
+			len = 4;
+		else
+			len = snd_ump_packet_length(snd_ump_msg_type(ump->pkt)) * 4;
+		if (ump->pkt_bytes == len) {
+			if (ump->info_cache &&
+			    snd_ump_msg_type(ump->pkt) == SND_UMP_MSG_TYPE_STREAM)
+				ump_info_drop(ump);
+			memcpy(pkts[count], ump->pkt, len);
+			if (tstamps)
+				tstamps[count] = ump->pkt_tstamp;
+			count++;
+			ump->pkt_bytes = 0;
+			continue;
+		}
+		ret = _snd_rawmidi_tread_pending(ump->rawmidi, &tstamp,
+						 (char *)ump->pkt + ump->pkt_bytes,
+						 len - ump->pkt_bytes);
+		if (!ret && !did_read && !count) {
+			ret = snd_rawmidi_tread(ump->rawmidi, &tstamp,
+						(char *)ump->pkt + ump->pkt_bytes,
+						len - ump->pkt_bytes);
+			did_read = 1;
+		}
+		if (ret < 0)
+			return count ? (int)count : (int)ret;
+		if (!ret)
+			break;
+		if (!ump->pkt_bytes)
+			ump->pkt_tstamp = tstamp;
+		ump->pkt_bytes += ret;
+	}
+	return count;
 }
 
 /**
@@ -663,7 +911,54 @@ void snd_ump_endpoint_info_set_product_id(snd_ump_endpoint_info_t *info,
  */
 int snd_ump_endpoint_info(snd_ump_t *ump, snd_ump_endpoint_info_t *info)
 {
-	return _snd_rawmidi_ump_endpoint_info(ump->rawmidi, info);
+	struct ump_info_cache *cache = ump->info_cache;
+	int err;
+
+	if (cache && cache->ep_valid) {
+		*info = cache->ep;
+		return 0;
+	}
+	err = _snd_rawmidi_ump_endpoint_info(ump->rawmidi, info);
+	if (err >= 0 && cache) {
+		cache->ep = *info;
+		cache->ep_valid = 1;
+	}
+	return err;
+}
+
+/**
+ * \brief enable or disable the endpoint and block info cache
+ * \param ump UMP handle
+ * \param enable 1 to enable the cache, 0 to disable and drop it
+ * \return 0 on success otherwise a negative error code
+ *
+ * With the cache, #snd_ump_endpoint_info() and #snd_ump_block_info()
+ * are served from memory after the first query of each item instead of
+ * issuing an ioctl per call.  Calling it again with \p enable set drops
+ * the cached info, e.g. after a change reported by another handle.
+ *
+ * On an input handle, the cache is dropped whenever a UMP stream message
+ * (message type 0x0f, which carries the endpoint and function block
+ * notifications) is read with #snd_ump_read(), #snd_ump_tread() or
+ * #snd_ump_read_packets().  An output handle doesn't see these messages,
+ * so the application has to drop its cache when it learns of a change.
+ */
+int snd_ump_set_info_cache(snd_ump_t *ump, int enable)
+{
+	if (!enable) {
+		free(ump->info_cache);
+		ump->info_cache = NULL;
+		return 0;
+	}
+	if (!ump->info_cache) {
+		ump->info_cache = malloc(sizeof(*ump->info_cache));
+		if (!ump->info_cache)
+			return -ENOMEM;
+		ump->scan_bytes = 0;
+		ump->scan_left = 0;
+	}
+	ump_info_drop(ump);
+	return 0;
 }
 
 /**
@@ -994,7 +1289,20 @@ void snd_ump_block_info_set_name(snd_ump_block_info_t *info,
  */
 int snd_ump_block_info(snd_ump_t *ump, snd_ump_block_info_t *info)
 {
-	return _snd_rawmidi_ump_block_info(ump->rawmidi, info);
+	struct ump_info_cache *cache = ump->info_cache;
+	unsigned int id = info->block_id;
+	int err;
+
+	if (cache && id < SND_UMP_MAX_BLOCKS && (cache->blk_valid & (1U << id))) {
+		*info = cache->blks[id];
+		return 0;
+	}
+	err = _snd_rawmidi_ump_block_info(ump->rawmidi, info);
+	if (err >= 0 && cache && id < SND_UMP_MAX_BLOCKS) {
+		cache->blks[id] = *info;
+		cache->blk_valid |= 1U << id;
+	}
+	return err;
 }
 
 /*
@@ -1099,3 +1407,387 @@ int snd_ump_packet_length(unsigned int type)
 		return 0;
 	return packet_length[type];
 }
+
+/*
+ * MIDI 1.0 byte stream <-> UMP conversion
+ */
+
+#ifndef DOC_HIDDEN
+struct _snd_ump_convert {
+	unsigned int group;	/* UMP group to convert */
+	/* byte stream to UMP */
+	unsigned char status;	/* current (running) status, 0 if none */
+	unsigned char need;	/* data bytes needed by the status */
+	unsigned char len;	/* pending data bytes */
+	unsigned char data[6];
+	unsigned char in_sysex;	/* 1: SysEx started, 2: Start packet sent */
+	/* UMP to byte stream */
+	unsigned char out_sysex;	/* F0 sent, waiting for F7 */
+};
+#endif /* DOC_HIDDEN */
+
+/* number of data bytes for a MIDI 1.0 status byte, -1 if undefined */
+static int midi1_data_len(unsigned char status)
+{
+	static const signed char system_len[16] = {
+		-1, 1, 2, 1, -1, -1, 0, -1, 0, -1, 0, 0, 0, -1, 0, 0
+	};
+
+	if (status < 0xf0)
+		return (status & 0xe0) == 0xc0 ? 1 : 2;
+	return system_len[status & 0x0f];
+}
+
+/**
+ * \brief create a MIDI 1.0 byte stream / UMP converter
+ * \param convp returned converter
+ * \param group the UMP group (0-15) to convert from and to
+ * \return 0 on success otherwise a negative error code
+ *
+ * The converter keeps the state needed for the running status and for
+ * SysEx messages split over several calls or several UMP packets.
+ *
+ * \sa snd_ump_convert_from_bytes(), snd_ump_convert_to_bytes()
+ */
+int snd_ump_convert_new(snd_ump_convert_t **convp, unsigned int group)
+{
+	snd_ump_convert_t *conv;
+
+	assert(convp);
+	if (group >= SND_UMP_MAX_GROUPS)
+		return -EINVAL;
+	conv = calloc(1, sizeof(*conv));
+	if (!conv)
+		return -ENOMEM;
+	conv->group = group;
+	*convp = conv;
+	return 0;
+}
+
+/**
+ * \brief free a MIDI 1.0 byte stream / UMP converter
+ * \param conv converter
+ */
+void snd_ump_convert_free(snd_ump_convert_t *conv)
+{
+	free(conv);
+}
+
+/**
+ * \brief reset the state of a MIDI 1.0 byte stream / UMP converter
+ * \param conv converter
+ *
+ * The pending running status and the unfinished SysEx messages are
+ * dropped in both directions.
+ */
+void snd_ump_convert_reset(snd_ump_convert_t *conv)
+{
+	unsigned int group = conv->group;
+
+	memset(conv, 0, sizeof(*conv));
+	conv->group = group;
+}
+
+static uint32_t *put_sysex7(snd_ump_convert_t *conv, uint32_t *ump,
+			    unsigned int status)
+{
+	const unsigned char *d = conv->data;
+	unsigned char b[6] = { 0 };
+
+	memcpy(b, d, conv->len);
+	*ump++ = ((uint32_t)SND_UMP_MSG_TYPE_DATA << 28) | (conv->group << 24) |
+		(status << 20) | ((uint32_t)conv->len << 16) |
+		(b[0] << 8) | b[1];
+	*ump++ = ((uint32_t)b[2] << 24) | (b[3] << 16) | (b[4] << 8) | b[5];
+	conv->len = 0;
+	return ump;
+}
+
+/**
+ * \brief convert a MIDI 1.0 byte stream to UMP packets
+ * \param conv converter
+ * \param buf MIDI 1.0 bytes
+ * \param len the number of bytes in \p buf
+ * \param ump array receiving the UMP packets
+ * \param words the size of \p ump in 32bit words
+ * \param consumed returns the number of bytes taken from \p buf
+ * \return the number of 32bit words stored in \p ump
+ *
+ * Channel voice messages become MIDI 1.0 CVM packets, system common and
+ * real-time messages become system packets, and SysEx messages become
+ * SysEx7 packets.  The running status is honoured, and an incomplete
+ * message is kept in the converter for the next call.  The conversion
+ * stops early when \p ump is full; the remaining bytes are reported
+ * through \p consumed and have to be passed again.
+ */
+int snd_ump_convert_from_bytes(snd_ump_convert_t *conv, const uint8_t *buf,
+			       size_t len, uint32_t *ump, size_t words,
+			       size_t *consumed)
+{
+	uint32_t *p = ump, *end = ump + words;
+	uint32_t hdr;
+	size_t i;
+	int need;
+
+	hdr = conv->group << 24;
+	for (i = 0; i < len; i++) {
+		unsigned char c = buf[i];
+
+		if (c >= 0xf8) {
+			/* real-time, may be interleaved anywhere */
+			if (midi1_data_len(c) < 0)
+				continue;
+			if (p == end)
+				break;
+			*p++ = ((uint32_t)SND_UMP_MSG_TYPE_SYSTEM << 28) | hdr |
+				((uint32_t)c << 16);
+			continue;
+		}
+		if (conv->in_sysex) {
+			if (!(c & 0x80)) {
+				if (conv->len == 6) {
+					if (end - p < 2)
+						break;
+					p = put_sysex7(conv, p, conv->in_sysex == 1 ?
+						       SND_UMP_SYSEX_STATUS_START :
+						       SND_UMP_SYSEX_STATUS_CONTINUE);
+					conv->in_sysex = 2;
+				}
+				conv->data[conv->len++] = c;
+				continue;
+			}
+			/* F7 or any other status ends the SysEx */
+			if (end - p < 2)
+				break;
+			p = put_sysex7(conv, p, conv->in_sysex == 1 ?
+				       SND_UMP_SYSEX_STATUS_SINGLE :
+				       SND_UMP_SYSEX_STATUS_END);
+			conv->in_sysex = 0;
+			if (c == SND_UMP_MSG_SYSEX_END)
+				continue;
+		}
+		if (c & 0x80) {
+			conv->status = 0;
+			conv->len = 0;
+			if (c == SND_UMP_MSG_SYSEX_START) {
+				conv->in_sysex = 1;
+				continue;
+			}
+			need = midi1_data_len(c);
+			if (need < 0)
+				continue;
+			if (need == 0) {
+				if (p == end)
+					break;
+				*p++ = ((uint32_t)SND_UMP_MSG_TYPE_SYSTEM << 28) |
+					hdr | ((uint32_t)c << 16);
+				continue;
+			}
+			conv->status = c;
+			conv->need = need;
+			continue;
+		}
+		if (!conv->status)
+			continue; /* data byte without status */
+		if (conv->len + 1 == conv->need && p == end)
+			break;
+		conv->data[conv->len++] = c;
+		if (conv->len < conv->need)
+			continue;
+		*p++ = ((uint32_t)(conv->status < 0xf0 ?
+				   SND_UMP_MSG_TYPE_MIDI1_CHANNEL_VOICE :
+				   SND_UMP_MSG_TYPE_SYSTEM) << 28) | hdr |
+			((uint32_t)conv->status << 16) | (conv->data[0] << 8) |
+			(conv->need > 1 ? conv->data[1] : 0);
+		conv->len = 0;
+		if (conv->status >= 0xf0)
+			conv->status = 0; /* no running status */
+	}
+	if (consumed)
+		*consumed = i;
+	return p - ump;
+}
+
+/* downscale a MIDI 2.0 value to the given number of bits */
+static inline unsigned int midi2_scale(uint32_t val, unsigned int srcbits,
+				       unsigned int dstbits)
+{
+	return val >> (srcbits - dstbits);
+}
+
+static int put_cc(uint8_t *b, unsigned char status, unsigned char index,
+		  unsigned char val)
+{
+	b[0] = 0xb0 | (status & 0x0f);
+	b[1] = index;
+	b[2] = val;
+	return 3;
+}
+
+/* convert a MIDI 2.0 CVM packet to MIDI 1.0 bytes, returns the length */
+static int midi2_to_bytes(const uint32_t *ump, uint8_t *b)
+{
+	unsigned char status = snd_ump_msg_status(ump);
+	unsigned char ch = snd_ump_msg_channel(ump);
+	unsigned char byte1 = (ump[0] >> 8) & 0x7f;
+	unsigned char byte2 = ump[0] & 0x7f;
+	uint32_t val = ump[1];
+	unsigned int v;
+	int n = 0;
+
+	switch (status) {
+	case SND_UMP_MSG_NOTE_OFF:
+	case SND_UMP_MSG_NOTE_ON:
+		v = midi2_scale(val >> 16, 16, 7);
+		if (status == SND_UMP_MSG_NOTE_ON && !v && (val >> 16))
+			v = 1; /* keep it a note-on */
+		b[0] = (status << 4) | ch;
+		b[1] = byte1;
+		b[2] = v;
+		return 3;
+	case SND_UMP_MSG_POLY_PRESSURE:
+	case SND_UMP_MSG_CONTROL_CHANGE:
+		b[0] = (status << 4) | ch;
+		b[1] = byte1;
+		b[2] = midi2_scale(val, 32, 7);
+		return 3;
+	case SND_UMP_MSG_PROGRAM_CHANGE:
+		if (ump[0] & 1) { /* bank valid */
+			n += put_cc(b + n, ch, 0, (val >> 8) & 0x7f);
+			n += put_cc(b + n, ch, 32, val & 0x7f);
+		}
+		b[n++] = 0xc0 | ch;
+		b[n++] = (val >> 24) & 0x7f;
+		return n;
+	case SND_UMP_MSG_CHANNEL_PRESSURE:
+		b[0] = 0xd0 | ch;
+		b[1] = midi2_scale(val, 32, 7);
+		return 2;
+	case SND_UMP_MSG_PITCHBEND:
+		v = midi2_scale(val, 32, 14);
+		b[0] = 0xe0 | ch;
+		b[1] = v & 0x7f;
+		b[2] = v >> 7;
+		return 3;
+	case SND_UMP_MSG_RPN:
+	case SND_UMP_MSG_NRPN:
+		v = midi2_scale(val, 32, 14);
+		n += put_cc(b + n, ch, status == SND_UMP_MSG_RPN ? 101 : 99, byte1);
+		n += put_cc(b + n, ch, status == SND_UMP_MSG_RPN ? 100 : 98, byte2);
+		n += put_cc(b + n, ch, 6, v >> 7);
+		n += put_cc(b + n, ch, 38, v & 0x7f);
+		return n;
+	default:
+		return 0; /* no MIDI 1.0 equivalent */
+	}
+}
+
+/**
+ * \brief convert UMP packets to a MIDI 1.0 byte stream
+ * \param conv converter
+ * \param ump UMP packets
+ * \param words the number of 32bit words in \p ump
+ * \param buf buffer receiving the MIDI 1.0 bytes
+ * \param len the size of \p buf in bytes
+ * \param consumed returns the number of 32bit words taken from \p ump
+ * \return the number of bytes stored in \p buf
+ *
+ * Only the packets of the converter group are converted; the others and
+ * the groupless packets are skipped.  System and MIDI 1.0 CVM packets are
+ * copied as they are, and SysEx7 packets are reassembled to a single
+ * F0 ... F7 message.  MIDI 2.0 CVM packets are downscaled to their
+ * MIDI 1.0 counterparts (RPN/NRPN become controller sequences); the ones
+ * without a MIDI 1.0 equivalent and the SysEx8 packets, whose 8bit data
+ * can't be carried by MIDI 1.0, are dropped.
+ *
+ * A trailing incomplete packet isn't consumed, nor a packet that doesn't
+ * fit the room left in \p buf.
+ */
+int snd_ump_convert_to_bytes(snd_ump_convert_t *conv, const uint32_t *ump,
+			     size_t words, uint8_t *buf, size_t len,
+			     size_t *consumed)
+{
+	uint8_t tmp[16];
+	size_t i, n, filled = 0;
+	int plen, need;
+
+	for (i = 0; i < words; i += plen) {
+		unsigned char type = snd_ump_msg_type(ump + i);
+		unsigned char status;
+		unsigned int k, cnt;
+
+		plen = snd_ump_packet_length(type);
+		if (i + plen > words)
+			break;
+		if (snd_ump_msg_type_is_groupless(type) ||
+		    snd_ump_msg_group(ump + i) != conv->group)
+			continue;
+		n = 0;
+		switch (type) {
+		case SND_UMP_MSG_TYPE_SYSTEM:
+			status = (ump[i] >> 16) & 0xff;
+			need = status >= 0xf0 ? midi1_data_len(status) : -1;
+			if (need < 0)
+				break;
+			tmp[n++] = status;
+			if (need > 0)
+				tmp[n++] = (ump[i] >> 8) & 0x7f;
+			if (need > 1)
+				tmp[n++] = ump[i] & 0x7f;
+			break;
+		case SND_UMP_MSG_TYPE_MIDI1_CHANNEL_VOICE:
+			status = (ump[i] >> 16) & 0xff;
+			if (status < 0x80 || status >= 0xf0)
+				break;
+			need = midi1_data_len(status);
+			tmp[n++] = status;
+			tmp[n++] = (ump[i] >> 8) & 0x7f;
+			if (need > 1)
+				tmp[n++] = ump[i] & 0x7f;
+			break;
+		case SND_UMP_MSG_TYPE_DATA:
+			status = snd_ump_sysex_msg_status(ump + i);
+			cnt = snd_ump_sysex_msg_length(ump + i);
+			if (cnt > 6)
+				break;
+			if (status == SND_UMP_SYSEX_STATUS_SINGLE ||
+			    status == SND_UMP_SYSEX_STATUS_START) {
+				if (conv->out_sysex)
+					tmp[n++] = SND_UMP_MSG_SYSEX_END;
+				tmp[n++] = SND_UMP_MSG_SYSEX_START;
+			} else if (!conv->out_sysex) {
+				break; /* continuation without a start */
+			}
+			for (k = 0; k < cnt; k++)
+				tmp[n++] = snd_ump_get_byte(ump + i, k + 2) & 0x7f;
+			if (status == SND_UMP_SYSEX_STATUS_SINGLE ||
+			    status == SND_UMP_SYSEX_STATUS_END)
+				tmp[n++] = SND_UMP_MSG_SYSEX_END;
+			break;
+		case SND_UMP_MSG_TYPE_MIDI2_CHANNEL_VOICE:
+			n = midi2_to_bytes(ump + i, tmp);
+			break;
+		default:
+			break;
+		}
+		if (!n)
+			continue;
+		if (n > len - filled)
+			break;
+		/* a channel or system common message ends a pending SysEx */
+		if (type != SND_UMP_MSG_TYPE_DATA && conv->out_sysex &&
+		    tmp[0] < 0xf8) {
+			if (n + 1 > len - filled)
+				break;
+			buf[filled++] = SND_UMP_MSG_SYSEX_END;
+			conv->out_sysex = 0;
+		}
+		if (type == SND_UMP_MSG_TYPE_DATA)
+			conv->out_sysex = tmp[n - 1] != SND_UMP_MSG_SYSEX_END;
+		memcpy(buf + filled, tmp, n);
+		filled += n;
+	}
+	if (consumed)
+		*consumed = i;
+	return filled;
+}
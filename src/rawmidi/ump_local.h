@@ -4,9 +4,29 @@
 #include "ump_msg.h"
 
 #ifndef DOC_HIDDEN
+/* endpoint and block info cache, see snd_ump_set_info_cache() */
+struct ump_info_cache {
+	snd_ump_endpoint_info_t ep;
+	int ep_valid;
+	uint32_t blk_valid;		/* bitmap of the cached blocks */
+	snd_ump_block_info_t blks[SND_UMP_MAX_BLOCKS];
+};
+
 struct _snd_ump {
 	snd_rawmidi_t *rawmidi;
 	unsigned int flags;
 	int is_input;
+	uint32_t pkt[4];		/* partially read packet */
+	unsigned int pkt_bytes;		/* bytes of pkt read so far */
+	struct timespec pkt_tstamp;	/* timestamp of pkt */
+	unsigned char *wbuf;		/* write-combining buffer */
+	size_t wbuf_size;
+	size_t wbuf_fill;
+	unsigned int wbuf_usec;		/* flush deadline, 0 = when full */
+	struct timespec wbuf_first;	/* time of the oldest buffered write */
+	struct ump_info_cache *info_cache;
+	uint32_t scan_word;		/* partial word seen by the cache scan */
+	unsigned int scan_bytes;	/* bytes of scan_word */
+	unsigned int scan_left;		/* words left of the scanned packet */
 };
 #endif /* DOC_HIDDEN */
@@ -1103,6 +1103,209 @@ int _snd_seq_open_lconf(snd_seq_t **seqp, const char *name,
 }
 #endif
 
+/*
+ * client/port query cache
+ */
+
+static void cache_drop(snd_seq_t *seq)
+{
+	int i;
+
+	for (i = 0; i < seq->cache_clients; i++) {
+		free(seq->cache[i].ports);
+		free(seq->cache[i].ump);
+	}
+	free(seq->cache);
+	seq->cache = NULL;
+	seq->cache_clients = 0;
+}
+
+static void cache_drop_ports(snd_seq_t *seq, int client)
+{
+	int i;
+
+	for (i = 0; i < seq->cache_clients; i++) {
+		if (seq->cache[i].info.client == client) {
+			free(seq->cache[i].ports);
+			seq->cache[i].ports = NULL;
+			seq->cache[i].num_ports = -1;
+			return;
+		}
+	}
+}
+
+static void cache_drop_ump(snd_seq_t *seq, int client)
+{
+	int i;
+
+	for (i = 0; i < seq->cache_clients; i++) {
+		if (seq->cache[i].info.client == client) {
+			free(seq->cache[i].ump);
+			seq->cache[i].ump = NULL;
+			return;
+		}
+	}
+}
+
+/* update the cache from an event of the System:Announce port */
+static void cache_announce(snd_seq_t *seq, const snd_seq_event_t *ev)
+{
+	if (!seq->cache || ev->source.client != SND_SEQ_CLIENT_SYSTEM)
+		return;
+	switch (ev->type) {
+	case SND_SEQ_EVENT_CLIENT_START:
+	case SND_SEQ_EVENT_CLIENT_EXIT:
+	case SND_SEQ_EVENT_CLIENT_CHANGE:
+		cache_drop(seq);
+		break;
+	case SND_SEQ_EVENT_PORT_START:
+	case SND_SEQ_EVENT_PORT_EXIT:
+		/* the port count of the client changes, too */
+		cache_drop(seq);
+		break;
+	case SND_SEQ_EVENT_PORT_CHANGE:
+		cache_drop_ports(seq, ev->data.addr.client);
+		break;
+	case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+	case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
+		/* the use counts of both ports change */
+		cache_drop_ports(seq, ev->data.connect.sender.client);
+		cache_drop_ports(seq, ev->data.connect.dest.client);
+		break;
+	case SND_SEQ_EVENT_UMP_EP_CHANGE:
+	case SND_SEQ_EVENT_UMP_BLOCK_CHANGE:
+		cache_drop_ump(seq, ev->data.addr.client);
+		break;
+	}
+}
+
+static int cache_load_clients(snd_seq_t *seq)
+{
+	snd_seq_cache_client_t *cache = NULL, *c;
+	snd_seq_client_info_t info;
+	int num = 0, alloc = 0;
+
+	if (seq->cache)
+		return 0;
+	memset(&info, 0, sizeof(info));
+	info.client = -1;
+	while (seq->ops->query_next_client(seq, &info) >= 0) {
+		if (num == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			c = realloc(cache, alloc * sizeof(*cache));
+			if (!c) {
+				free(cache);
+				return -ENOMEM;
+			}
+			cache = c;
+		}
+		cache[num].info = info;
+		cache[num].ports = NULL;
+		cache[num].num_ports = -1;
+		cache[num].ump = NULL;
+		num++;
+	}
+	if (!cache) {
+		/* no client at all; keep a valid pointer to mark the cache */
+		cache = malloc(sizeof(*cache));
+		if (!cache)
+			return -ENOMEM;
+	}
+	seq->cache = cache;
+	seq->cache_clients = num;
+	return 0;
+}
+
+static snd_seq_cache_client_t *cache_find_client(snd_seq_t *seq, int client)
+{
+	int lo = 0, hi = seq->cache_clients, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (seq->cache[mid].info.client < client)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return &seq->cache[lo];	/* the first client >= client, maybe the end */
+}
+
+static int cache_load_ports(snd_seq_t *seq, snd_seq_cache_client_t *c)
+{
+	snd_seq_port_info_t info, *ports = NULL, *p;
+	int num = 0, alloc = 0;
+
+	if (c->num_ports >= 0)
+		return 0;
+	memset(&info, 0, sizeof(info));
+	info.addr.client = c->info.client;
+	info.addr.port = -1;
+	while (seq->ops->query_next_port(seq, &info) >= 0) {
+		if (num == alloc) {
+			alloc = alloc ? alloc * 2 : 8;
+			p = realloc(ports, alloc * sizeof(*ports));
+			if (!p) {
+				free(ports);
+				return -ENOMEM;
+			}
+			ports = p;
+		}
+		ports[num++] = info;
+	}
+	c->ports = ports;
+	c->num_ports = num;
+	return 0;
+}
+
+/* the UMP info entry of a client, NULL when it can't be cached */
+static snd_seq_cache_ump_t *cache_load_ump(snd_seq_t *seq, int client)
+{
+	snd_seq_cache_client_t *c;
+
+	if (!seq->query_cache || cache_load_clients(seq) < 0)
+		return NULL;
+	c = cache_find_client(seq, client);
+	if (c == seq->cache + seq->cache_clients || c->info.client != client)
+		return NULL;
+	if (!c->ump) {
+		c->ump = malloc(sizeof(*c->ump));
+		if (!c->ump)
+			return NULL;
+		c->ump->ep_err = 1;
+		c->ump->blk_valid = 0;
+	}
+	return c->ump;
+}
+
+/**
+ * \brief Enable or disable the client/port query cache
+ * \param seq sequencer handle
+ * \param enable 1 to enable the cache, 0 to disable and drop it
+ * \return 0 on success otherwise a negative error code
+ *
+ * With the cache, #snd_seq_query_next_client(), #snd_seq_query_next_port(),
+ * #snd_seq_get_any_client_info(), #snd_seq_get_any_port_info() and the
+ * name lookup of #snd_seq_parse_address() are served from memory after
+ * the first query instead of issuing an ioctl per call.  So are
+ * #snd_seq_get_ump_endpoint_info() and #snd_seq_get_ump_block_info().
+ *
+ * The cache is invalidated by the events received from the
+ * System:Announce port (client and port start, exit and change, and
+ * subscription changes), so the handle should be subscribed to it,
+ * e.g. with snd_seq_connect_from(seq, myport, SND_SEQ_CLIENT_SYSTEM,
+ * SND_SEQ_PORT_SYSTEM_ANNOUNCE), and read its input events; the UMP
+ * info of a client is dropped by #SND_SEQ_EVENT_UMP_EP_CHANGE and
+ * #SND_SEQ_EVENT_UMP_BLOCK_CHANGE.  Without
+ * that, the cache only follows the changes made through this handle.
+ */
+int snd_seq_set_query_cache(snd_seq_t *seq, int enable)
+{
+	assert(seq);
+	cache_drop(seq);
+	seq->query_cache = !!enable;
+	return 0;
+}
+
 /**
  * \brief Close the sequencer
  * \param seq Handle returned from #snd_seq_open()
@@ -1125,6 +1328,8 @@ int snd_seq_close(snd_seq_t *seq)
 	if (seq->dl_handle)
 		snd_dlclose(seq->dl_handle);
 	free(seq->obuf);
+	free(seq->oring);
+	cache_drop(seq);
 	free(seq->ibuf);
 	free(seq->tmpbuf);
 	free(seq->name);
@@ -1334,6 +1539,67 @@ int snd_seq_set_output_buffer_size(snd_seq_t *seq, size_t size)
 	return 0;
 }
 
+/**
+ * \brief Return the growth limit of output buffer
+ * \param seq sequencer handle
+ * \return the limit in bytes, or 0 when the output buffer doesn't grow
+ *
+ * \sa snd_seq_set_output_buffer_limit()
+ */
+size_t snd_seq_get_output_buffer_limit(snd_seq_t *seq)
+{
+	assert(seq);
+	return seq->obufmax;
+}
+
+/**
+ * \brief Let the output buffer grow up to a limit
+ * \param seq sequencer handle
+ * \param size the maximal size of output buffer in bytes, 0 to disable
+ * \return 0 on success otherwise a negative error code
+ *
+ * By default, snd_seq_event_output_buffer() returns \c -EAGAIN once
+ * the output buffer becomes full.  With a non-zero limit, the buffer is
+ * enlarged instead (doubled at each step) until it reaches \p size bytes,
+ * so that a burst of events can be queued at once and leaves with a single
+ * snd_seq_drain_output() call.  The pending events are kept.
+ *
+ * The buffer never shrinks below the size set by
+ * snd_seq_set_output_buffer_size().
+ *
+ * \sa snd_seq_get_output_buffer_limit(), snd_seq_set_output_buffer_size()
+ */
+int snd_seq_set_output_buffer_limit(snd_seq_t *seq, size_t size)
+{
+	assert(seq);
+	if (size && size < sizeof(snd_seq_event_t))
+		return -EINVAL;
+	seq->obufmax = size;
+	return 0;
+}
+
+/*
+ * enlarge the output buffer to hold len more bytes, within the limit
+ */
+static int grow_output_buffer(snd_seq_t *seq, size_t len)
+{
+	size_t size = seq->obufsize;
+	char *newbuf;
+
+	if (seq->obufmax <= size || seq->obufmax - seq->obufused < len)
+		return -EAGAIN;
+	while (size - seq->obufused < len)
+		size *= 2;
+	if (size > seq->obufmax)
+		size = seq->obufmax;
+	newbuf = realloc(seq->obuf, size);
+	if (newbuf == NULL)
+		return -EAGAIN;
+	seq->obuf = newbuf;
+	seq->obufsize = size;
+	return 0;
+}
+
 /**
  * \brief Resize the input buffer
  * \param seq sequencer handle
@@ -2037,7 +2303,17 @@ void snd_seq_client_info_set_event_filter(snd_seq_client_info_t *info, unsigned
  */
 int snd_seq_get_any_client_info(snd_seq_t *seq, int client, snd_seq_client_info_t *info)
 {
+	snd_seq_cache_client_t *c;
+
 	assert(seq && info && client >= 0);
+	if (seq->query_cache && !cache_load_clients(seq)) {
+		c = cache_find_client(seq, client);
+		if (c < seq->cache + seq->cache_clients &&
+		    c->info.client == client) {
+			*info = c->info;
+			return 0;
+		}
+	}
 	memset(info, 0, sizeof(snd_seq_client_info_t));
 	info->client = client;
 	return seq->ops->get_client_info(seq, info);
@@ -2076,6 +2352,7 @@ int snd_seq_set_client_info(snd_seq_t *seq, snd_seq_client_info_t *info)
 	assert(seq && info);
 	info->client = seq->client;
 	info->type = USER_CLIENT;
+	cache_drop(seq);
 	return seq->ops->set_client_info(seq, info);
 }
 
@@ -2095,7 +2372,16 @@ int snd_seq_set_client_info(snd_seq_t *seq, snd_seq_client_info_t *info)
  */
 int snd_seq_query_next_client(snd_seq_t *seq, snd_seq_client_info_t *info)
 {
+	snd_seq_cache_client_t *c;
+
 	assert(seq && info);
+	if (seq->query_cache && !cache_load_clients(seq)) {
+		c = cache_find_client(seq, info->client + 1);
+		if (c == seq->cache + seq->cache_clients)
+			return -ENOENT;
+		*info = c->info;
+		return 0;
+	}
 	return seq->ops->query_next_client(seq, info);
 }
 
@@ -2108,10 +2394,26 @@ int snd_seq_query_next_client(snd_seq_t *seq, snd_seq_client_info_t *info)
  */
 int snd_seq_get_ump_endpoint_info(snd_seq_t *seq, int client, void *info)
 {
+	snd_seq_cache_ump_t *c;
+	int err;
+
 	assert(seq && info);
-	return seq->ops->get_ump_info(seq, client,
-				      SNDRV_SEQ_CLIENT_UMP_INFO_ENDPOINT,
-				      info);
+	c = cache_load_ump(seq, client);
+	if (c && c->ep_err <= 0) {
+		if (!c->ep_err)
+			memcpy(info, &c->ep, sizeof(c->ep));
+		return c->ep_err;
+	}
+	err = seq->ops->get_ump_info(seq, client,
+				     SNDRV_SEQ_CLIENT_UMP_INFO_ENDPOINT,
+				     info);
+	if (c) {
+		/* a client without UMP info is remembered, too */
+		c->ep_err = err;
+		if (!err)
+			memcpy(&c->ep, info, sizeof(c->ep));
+	}
+	return err;
 }
 
 /**
@@ -2124,10 +2426,24 @@ int snd_seq_get_ump_endpoint_info(snd_seq_t *seq, int client, void *info)
  */
 int snd_seq_get_ump_block_info(snd_seq_t *seq, int client, int blk, void *info)
 {
+	snd_seq_cache_ump_t *c = NULL;
+	int err;
+
 	assert(seq && info);
-	return seq->ops->get_ump_info(seq, client,
-				      SNDRV_SEQ_CLIENT_UMP_INFO_BLOCK + blk,
-				      info);
+	if (blk >= 0 && blk < 32)
+		c = cache_load_ump(seq, client);
+	if (c && (c->blk_valid & (1U << blk))) {
+		memcpy(info, &c->blks[blk], sizeof(c->blks[blk]));
+		return 0;
+	}
+	err = seq->ops->get_ump_info(seq, client,
+				     SNDRV_SEQ_CLIENT_UMP_INFO_BLOCK + blk,
+				     info);
+	if (!err && c) {
+		memcpy(&c->blks[blk], info, sizeof(c->blks[blk]));
+		c->blk_valid |= 1U << blk;
+	}
+	return err;
 }
 
 /**
@@ -2139,6 +2455,7 @@ int snd_seq_get_ump_block_info(snd_seq_t *seq, int client, int blk, void *info)
 int snd_seq_set_ump_endpoint_info(snd_seq_t *seq, const void *info)
 {
 	assert(seq && info);
+	cache_drop_ump(seq, seq->client);
 	return seq->ops->set_ump_info(seq,
 				      SNDRV_SEQ_CLIENT_UMP_INFO_ENDPOINT,
 				      info);
@@ -2154,6 +2471,7 @@ int snd_seq_set_ump_endpoint_info(snd_seq_t *seq, const void *info)
 int snd_seq_set_ump_block_info(snd_seq_t *seq, int blk, const void *info)
 {
 	assert(seq && info);
+	cache_drop_ump(seq, seq->client);
 	return seq->ops->set_ump_info(seq,
 				      SNDRV_SEQ_CLIENT_UMP_INFO_BLOCK + blk,
 				      info);
@@ -2713,6 +3031,7 @@ int snd_seq_create_port(snd_seq_t *seq, snd_seq_port_info_t * port)
 {
 	assert(seq && port);
 	port->addr.client = seq->client;
+	cache_drop(seq);
 	return seq->ops->create_port(seq, port);
 }
 
@@ -2733,6 +3052,7 @@ int snd_seq_delete_port(snd_seq_t *seq, int port)
 	memset(&pinfo, 0, sizeof(pinfo));
 	pinfo.addr.client = seq->client;
 	pinfo.addr.port = port;
+	cache_drop(seq);
 	return seq->ops->delete_port(seq, &pinfo);
 }
 
@@ -2748,7 +3068,22 @@ int snd_seq_delete_port(snd_seq_t *seq, int port)
  */
 int snd_seq_get_any_port_info(snd_seq_t *seq, int client, int port, snd_seq_port_info_t * info)
 {
+	snd_seq_cache_client_t *c;
+	int i;
+
 	assert(seq && info && client >= 0 && port >= 0);
+	if (seq->query_cache && !cache_load_clients(seq)) {
+		c = cache_find_client(seq, client);
+		if (c < seq->cache + seq->cache_clients &&
+		    c->info.client == client && !cache_load_ports(seq, c)) {
+			for (i = 0; i < c->num_ports; i++) {
+				if (c->ports[i].addr.port == port) {
+					*info = c->ports[i];
+					return 0;
+				}
+			}
+		}
+	}
 	memset(info, 0, sizeof(snd_seq_port_info_t));
 	info->addr.client = client;
 	info->addr.port = port;
@@ -2784,6 +3119,7 @@ int snd_seq_set_port_info(snd_seq_t *seq, int port, snd_seq_port_info_t * info)
 	assert(seq && info && port >= 0);
 	info->addr.client = seq->client;
 	info->addr.port = port;
+	cache_drop_ports(seq, seq->client);
 	return seq->ops->set_port_info(seq, info);
 }
 
@@ -2806,7 +3142,27 @@ int snd_seq_set_port_info(snd_seq_t *seq, int port, snd_seq_port_info_t * info)
  */
 int snd_seq_query_next_port(snd_seq_t *seq, snd_seq_port_info_t *info)
 {
+	snd_seq_cache_client_t *c;
+	unsigned char next;
+	int i;
+
 	assert(seq && info);
+	if (seq->query_cache && !cache_load_clients(seq)) {
+		c = cache_find_client(seq, info->addr.client);
+		if (c < seq->cache + seq->cache_clients &&
+		    c->info.client == info->addr.client &&
+		    !cache_load_ports(seq, c)) {
+			/* port -1 wraps to 0, like in the kernel */
+			next = info->addr.port + 1;
+			for (i = 0; i < c->num_ports; i++) {
+				if (c->ports[i].addr.port >= next) {
+					*info = c->ports[i];
+					return 0;
+				}
+			}
+			return -ENOENT;
+		}
+	}
 	return seq->ops->query_next_port(seq, info);
 }
 
@@ -4327,6 +4683,8 @@ static void clear_ump_for_legacy_apps(snd_seq_t *seq, snd_seq_event_t *ev)
  * \return the byte size of remaining events. \c -EAGAIN if the buffer becomes full.
  *
  * This function doesn't drain buffer unlike snd_seq_event_output().
+ * When a limit was set with snd_seq_set_output_buffer_limit(), a full
+ * buffer is enlarged up to that limit before \c -EAGAIN is returned.
  *
  * \note
  * For a UMP event, use snd_seq_ump_event_output_buffer() instead.
@@ -4341,9 +4699,11 @@ int snd_seq_event_output_buffer(snd_seq_t *seq, snd_seq_event_t *ev)
 	len = snd_seq_event_length(ev);
 	if (len < 0)
 		return -EINVAL;
-	if ((size_t) len >= seq->obufsize)
+	if ((size_t) len >= seq->obufsize &&
+	    (size_t) len >= seq->obufmax)
 		return -EINVAL;
-	if ((seq->obufsize - seq->obufused) < (size_t) len)
+	if ((seq->obufsize - seq->obufused) < (size_t) len &&
+	    grow_output_buffer(seq, len) < 0)
 		return -EAGAIN;
 	if (snd_seq_ev_is_ump(ev)) {
 		memcpy(seq->obuf + seq->obufused, ev, sizeof(snd_seq_ump_event_t));
@@ -4460,6 +4820,253 @@ int snd_seq_drain_output(snd_seq_t *seq)
 	return 0;
 }
 
+/* the kernel limit of the output pool of a client (SNDRV_SEQ_MAX_EVENTS) */
+#define SEQ_MAX_OUTPUT_POOL	2000
+
+/* enlarge the output pool to hold the given cells, when it's unused */
+static void schedule_batch_pool(snd_seq_t *seq, size_t cells)
+{
+	snd_seq_client_pool_t info;
+
+	if (cells > SEQ_MAX_OUTPUT_POOL)
+		cells = SEQ_MAX_OUTPUT_POOL;
+	if (snd_seq_get_client_pool(seq, &info) < 0 ||
+	    (size_t)info.output_pool >= cells)
+		return;
+	/* resizing a pool in use waits until its events are delivered */
+	if (info.output_free < info.output_pool)
+		return;
+	info.output_pool = cells;
+	snd_seq_set_client_pool(seq, &info);
+}
+
+/**
+ * \brief send an array of scheduled events to the sequencer
+ * \param seq sequencer handle
+ * \param evs the events, with their queue and time already set
+ * \param count the number of events
+ * \return the number of events sent, otherwise a negative error code
+ *
+ * The events are passed to the sequencer in as few writes as possible:
+ * each run of fixed-length events is written straight from \p evs, with
+ * no copy to the output buffer, and a variable-length event is written
+ * on its own.  The events pending in the output buffer are drained
+ * first, so the order is kept.
+ *
+ * When the output pool of the client is unused and smaller than the
+ * batch, it is enlarged first (see snd_seq_set_client_pool_output()), up
+ * to the limit of the kernel, so that a whole sequence can be loaded in
+ * the queue at once.  A pool in use is not resized, as that would wait
+ * for the delivery of its events.
+ *
+ * In the blocking mode, the call waits for room in the pool like
+ * snd_seq_drain_output().  In the non-blocking mode, the events which
+ * don't fit are not sent and their count isn't included in the result;
+ * \c -EAGAIN is returned only when no event could be sent.
+ *
+ * The events must not be UMP events.
+ *
+ * \sa snd_seq_event_output(), snd_seq_drain_output()
+ */
+int snd_seq_schedule_batch(snd_seq_t *seq, snd_seq_event_t *evs,
+			   unsigned int count)
+{
+	size_t cells = 0;
+	unsigned int i, run;
+	ssize_t ret;
+
+	assert(seq && (evs || !count));
+	for (i = 0; i < count; i++) {
+		clear_ump_for_legacy_apps(seq, &evs[i]);
+		if (snd_seq_ev_is_ump(&evs[i]))
+			return -EINVAL;
+		cells++;
+		if (snd_seq_ev_is_variable(&evs[i]))
+			cells += (evs[i].data.ext.len + sizeof(snd_seq_event_t) - 1) /
+				sizeof(snd_seq_event_t);
+	}
+	if (!count)
+		return 0;
+	schedule_batch_pool(seq, cells);
+	ret = snd_seq_drain_output(seq);
+	if (ret)
+		return ret < 0 ? ret : -EAGAIN;
+
+	for (i = 0; i < count; i += run) {
+		if (snd_seq_ev_is_variable(&evs[i])) {
+			ret = snd_seq_event_output_direct(seq, &evs[i]);
+			if (ret < 0)
+				return i ? (int)i : ret;
+			run = 1;
+			continue;
+		}
+		for (run = 1; i + run < count; run++)
+			if (snd_seq_ev_is_variable(&evs[i + run]))
+				break;
+		ret = seq->ops->write(seq, &evs[i], run * sizeof(snd_seq_event_t));
+		if (ret < 0)
+			return i ? (int)i : ret;
+		if ((size_t)ret < run * sizeof(snd_seq_event_t))
+			return i + ret / sizeof(snd_seq_event_t);
+	}
+	return count;
+}
+
+/**
+ * \brief Set up the multi-producer output ring
+ * \param seq sequencer handle
+ * \param slots the number of event slots, 0 to remove the ring
+ * \return 0 on success otherwise a negative error code
+ *
+ * The output ring lets several threads emit events on the same handle
+ * without a lock: each snd_seq_event_output_ring() call reserves a slot
+ * with atomic operations, and a single thread moves the filled slots to
+ * the sequencer with snd_seq_drain_output_ring().
+ *
+ * \p slots is rounded up to a power of two.  Events still in a previous
+ * ring are discarded.  This function must not be called while other
+ * threads output events to the ring.
+ *
+ * \sa snd_seq_event_output_ring(), snd_seq_drain_output_ring()
+ */
+int snd_seq_set_output_ring(snd_seq_t *seq, unsigned int slots)
+{
+	snd_seq_ring_slot_t *ring;
+	unsigned int i, size;
+
+	assert(seq);
+	if (slots > (1U << 20))
+		return -EINVAL;
+	free(seq->oring);
+	seq->oring = NULL;
+	seq->oringmask = 0;
+	seq->oringhead = seq->oringtail = 0;
+	if (!slots)
+		return 0;
+	for (size = 1; size < slots; size <<= 1)
+		;
+	ring = malloc(size * sizeof(*ring));
+	if (ring == NULL)
+		return -ENOMEM;
+	for (i = 0; i < size; i++)
+		ring[i].seq = i;
+	seq->oring = ring;
+	seq->oringmask = size - 1;
+	return 0;
+}
+
+/**
+ * \brief output an event onto the multi-producer output ring
+ * \param seq sequencer handle
+ * \param ev event to be output
+ * \return 0 on success, \c -EAGAIN if the ring is full, otherwise
+ *         a negative error code
+ *
+ * This function may be called from several threads at the same time.
+ * The event is copied into a free slot of the ring set up by
+ * snd_seq_set_output_ring(); it is sent at the next
+ * snd_seq_drain_output_ring() call.  Variable length events are not
+ * accepted since their data can't be held in a slot.
+ *
+ * \sa snd_seq_set_output_ring(), snd_seq_drain_output_ring()
+ */
+int snd_seq_event_output_ring(snd_seq_t *seq, snd_seq_event_t *ev)
+{
+	snd_seq_ring_slot_t *slot;
+	unsigned int pos, cur;
+	ssize_t len;
+
+	assert(seq && ev);
+	if (!seq->oring)
+		return -EBADFD;
+	clear_ump_for_legacy_apps(seq, ev);
+	if (!snd_seq_ev_is_ump(ev) && snd_seq_ev_is_variable(ev))
+		return -EINVAL;
+	len = snd_seq_event_length(ev);
+	if (len < 0)
+		return len;
+	pos = __atomic_load_n(&seq->oringtail, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &seq->oring[pos & seq->oringmask];
+		cur = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (cur == pos) {
+			if (__atomic_compare_exchange_n(&seq->oringtail, &pos, pos + 1,
+							1, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if ((int)(cur - pos) < 0) {
+			return -EAGAIN;
+		} else {
+			pos = __atomic_load_n(&seq->oringtail, __ATOMIC_RELAXED);
+		}
+	}
+	memcpy(&slot->ev, ev, len);
+	slot->len = len;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*
+ * move up to max filled ring slots to the output buffer
+ */
+static unsigned int pull_output_ring(snd_seq_t *seq, unsigned int max)
+{
+	snd_seq_ring_slot_t *slot;
+	unsigned int count = 0;
+
+	while (count < max) {
+		slot = &seq->oring[seq->oringhead & seq->oringmask];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq->oringhead + 1)
+			break;
+		if (seq->obufsize - seq->obufused < slot->len)
+			break;
+		memcpy(seq->obuf + seq->obufused, &slot->ev, slot->len);
+		seq->obufused += slot->len;
+		__atomic_store_n(&slot->seq, seq->oringhead + seq->oringmask + 1,
+				 __ATOMIC_RELEASE);
+		seq->oringhead++;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * \brief drain the multi-producer output ring to sequencer
+ * \param seq sequencer handle
+ * \return 0 when all events are drained and sent to sequencer.
+ *         When events still remain on the output buffer, the byte size of
+ *         remaining events are returned.  On error a negative error code
+ *         is returned.
+ *
+ * The filled ring slots are packed into the output buffer and sent with
+ * snd_seq_drain_output().  At most one ring's worth of events is taken
+ * per call, so that busy producers can't keep the drainer looping.
+ *
+ * Only one thread may call this function at a time, and that thread
+ * owns the output buffer: the other output functions must not be used
+ * concurrently on the same handle.
+ *
+ * \sa snd_seq_set_output_ring(), snd_seq_event_output_ring()
+ */
+int snd_seq_drain_output_ring(snd_seq_t *seq)
+{
+	unsigned int budget;
+	int err;
+
+	assert(seq);
+	if (!seq->oring)
+		return -EBADFD;
+	budget = seq->oringmask + 1;
+	for (;;) {
+		budget -= pull_output_ring(seq, budget);
+		if (!seq->obufused)
+			return 0;
+		err = snd_seq_drain_output(seq);
+		if (err)
+			return err;
+	}
+}
+
 /**
  * \brief extract the first event in output buffer
  * \param seq sequencer handle
@@ -4516,6 +5123,25 @@ static ssize_t snd_seq_event_read_buffer(snd_seq_t *seq)
 	return seq->ibuflen;
 }
 
+/* is the UMP event rejected by snd_seq_set_ump_input_filter()? */
+static int ump_input_filtered(snd_seq_t *seq, const snd_seq_event_t *ev)
+{
+	const uint32_t *ump = ((const snd_seq_ump_event_t *)ev)->ump;
+	unsigned int type = snd_ump_msg_type(ump);
+
+	if (!(seq->ump_filter_types & (1U << type)))
+		return 1;
+	if (snd_ump_msg_type_is_groupless(type))
+		return 0;
+	if (!(seq->ump_filter_groups & (1U << snd_ump_msg_group(ump))))
+		return 1;
+	if (type == SND_UMP_MSG_TYPE_MIDI1_CHANNEL_VOICE ||
+	    type == SND_UMP_MSG_TYPE_MIDI2_CHANNEL_VOICE)
+		return !(seq->ump_filter_channels & (1U << snd_ump_msg_channel(ump)));
+	return 0;
+}
+
+/* returns 0 for an event skipped by the UMP input filter */
 static int snd_seq_event_retrieve_buffer(snd_seq_t *seq, snd_seq_event_t **retp)
 {
 	size_t packet_size = get_packet_size(seq);
@@ -4523,9 +5149,15 @@ static int snd_seq_event_retrieve_buffer(snd_seq_t *seq, snd_seq_event_t **retp)
 	snd_seq_event_t *ev;
 
 	*retp = ev = (snd_seq_event_t *)(seq->ibuf + seq->ibufptr * packet_size);
-	clear_ump_for_legacy_apps(seq, ev);
 	seq->ibufptr++;
 	seq->ibuflen--;
+	if (seq->ump_filter && snd_seq_ev_is_ump(ev) &&
+	    ump_input_filtered(seq, ev)) {
+		*retp = NULL;
+		return 0;
+	}
+	clear_ump_for_legacy_apps(seq, ev);
+	cache_announce(seq, ev);
 	if (! snd_seq_ev_is_variable(ev))
 		return 1;
 	ncells = (ev->data.ext.len + packet_size - 1) / packet_size;
@@ -4575,12 +5207,58 @@ int snd_seq_event_input(snd_seq_t *seq, snd_seq_event_t **ev)
 	int err;
 	assert(seq);
 	*ev = NULL;
-	if (seq->ibuflen <= 0) {
-		if ((err = snd_seq_event_read_buffer(seq)) < 0)
-			return err;
-	}
+	do {
+		if (seq->ibuflen <= 0) {
+			if ((err = snd_seq_event_read_buffer(seq)) < 0)
+				return err;
+		}
+		err = snd_seq_event_retrieve_buffer(seq, ev);
+	} while (!err);
+	return err;
+}
+
+/**
+ * \brief retrieve several events from sequencer
+ * \param seq sequencer handle
+ * \param evs array to store the event pointers
+ * \param max size of \p evs
+ * \return the number of events stored or a negative error code
+ *
+ * Like snd_seq_event_input(), but stores the pointers of up to \p max
+ * events of the input buffer at once.  When the buffer is empty, it is
+ * filled with a single read from the sequencer first, blocking or
+ * returning \c -EAGAIN like snd_seq_event_input(); the events already in
+ * the buffer are returned without reading.
+ *
+ * The events, including the data of the variable-length events, stay in
+ * the input buffer and are not copied.  The pointers are valid until the
+ * next input call or snd_seq_drop_input().
+ *
+ * \sa snd_seq_event_input(), snd_seq_ump_event_input_batch()
+ */
+int snd_seq_event_input_batch(snd_seq_t *seq, snd_seq_event_t **evs,
+			      unsigned int max)
+{
+	unsigned int count;
+	int err;
 
-	return snd_seq_event_retrieve_buffer(seq, ev);
+	assert(seq && (evs || !max));
+	if (max == 0)
+		return 0;
+	do {
+		if (seq->ibuflen <= 0) {
+			if ((err = snd_seq_event_read_buffer(seq)) < 0)
+				return err;
+		}
+		/* the filtered events don't take a slot */
+		for (count = 0; count < max && seq->ibuflen > 0; ) {
+			err = snd_seq_event_retrieve_buffer(seq, &evs[count]);
+			if (err < 0)
+				return count ? (int)count : err;
+			count += err;
+		}
+	} while (!count);
+	return count;
 }
 
 /*
@@ -4730,6 +5408,68 @@ int snd_seq_ump_event_input(snd_seq_t *seq, snd_seq_ump_event_t **ev)
 	return snd_seq_event_input(seq, (snd_seq_event_t **)ev);
 }
 
+/**
+ * \brief set the filter of the UMP input events
+ * \param seq sequencer handle
+ * \param groups bitmap of the accepted UMP groups, bit 0 for group 1
+ * \param channels bitmap of the accepted channels, bit 0 for channel 1
+ * \param types bitmap of the accepted UMP message types
+ *	  (bit #SND_UMP_MSG_TYPE_MIDI2_CHANNEL_VOICE etc.)
+ * \return 0 on success otherwise a negative error code
+ *
+ * The UMP events rejected by the filter are skipped while the input
+ * buffer is parsed by snd_seq_ump_event_input(),
+ * snd_seq_ump_event_input_batch() and the other input functions, so the
+ * application doesn't have to decode and discard them.  The group is
+ * checked for all the message types but the groupless ones (utility and
+ * UMP stream messages), the channel only for the channel voice messages.
+ * The events which are no UMP packets, e.g. the announcements of the
+ * system client, always pass.  Pass all the bits set (e.g. \c ~0U) to
+ * accept everything again.
+ *
+ * The filter is applied by the library, the kernel still delivers the
+ * events: they count in snd_seq_event_input_pending(), and a blocking
+ * input call reads again when all the received events are filtered.
+ *
+ * Calling this function is allowed only when the client is set to
+ * \c SND_SEQ_CLIENT_UMP_MIDI_1_0 or \c SND_SEQ_CLIENT_UMP_MIDI_2_0.
+ */
+int snd_seq_set_ump_input_filter(snd_seq_t *seq, unsigned int groups,
+				 unsigned int channels, unsigned int types)
+{
+	assert(seq);
+	if (!seq->midi_version)
+		return -EBADFD;
+	seq->ump_filter_groups = groups;
+	seq->ump_filter_channels = channels;
+	seq->ump_filter_types = types;
+	seq->ump_filter = (groups & 0xffff) != 0xffff ||
+		(channels & 0xffff) != 0xffff || (types & 0xffff) != 0xffff;
+	return 0;
+}
+
+/**
+ * \brief retrieve several UMP events from sequencer
+ * \param seq sequencer handle
+ * \param evs array to store the UMP event pointers
+ * \param max size of \p evs
+ * \return the number of events stored or a negative error code
+ *
+ * This is a UMP event version of snd_seq_event_input_batch().
+ *
+ * Calling this function is allowed only when the client is set to
+ * \c SND_SEQ_CLIENT_UMP_MIDI_1_0 or \c SND_SEQ_CLIENT_UMP_MIDI_2_0.
+ *
+ * \sa snd_seq_event_input_batch(), snd_seq_ump_event_input()
+ */
+int snd_seq_ump_event_input_batch(snd_seq_t *seq, snd_seq_ump_event_t **evs,
+				  unsigned int max)
+{
+	if (!seq->midi_version)
+		return -EBADFD;
+	return snd_seq_event_input_batch(seq, (snd_seq_event_t **)evs, max);
+}
+
 /*----------------------------------------------------------------*/
 
 /*
@@ -34,6 +34,29 @@
 
 typedef struct snd_seq_queue_client snd_seq_queue_client_t;
 
+/* UMP info of a client in the query cache */
+typedef struct {
+	int ep_err;			/* endpoint query result, 1 until queried */
+	snd_ump_endpoint_info_t ep;
+	uint32_t blk_valid;		/* bitmap of the cached blocks */
+	snd_ump_block_info_t blks[32];
+} snd_seq_cache_ump_t;
+
+/* a client in the query cache */
+typedef struct {
+	snd_seq_client_info_t info;
+	snd_seq_port_info_t *ports;	/* port infos, sorted by port number */
+	int num_ports;			/* -1 until the ports are queried */
+	snd_seq_cache_ump_t *ump;	/* NULL until the UMP info is queried */
+} snd_seq_cache_client_t;
+
+/* a slot of the multi-producer output ring */
+typedef struct {
+	unsigned int seq;	/* slot sequence number */
+	unsigned int len;	/* event length in bytes */
+	snd_seq_ump_event_t ev;
+} snd_seq_ring_slot_t;
+
 
 typedef struct {
 	int (*close)(snd_seq_t *seq);
@@ -86,6 +109,14 @@ struct _snd_seq {
 	char *obuf;		/* output buffer */
 	size_t obufsize;		/* output buffer size */
 	size_t obufused;		/* output buffer used size */
+	size_t obufmax;		/* output buffer growth limit, 0 = fixed */
+	snd_seq_ring_slot_t *oring;	/* multi-producer output ring */
+	unsigned int oringmask;		/* ring size - 1 */
+	unsigned int oringhead;		/* next slot to drain */
+	unsigned int oringtail;		/* next slot to reserve */
+	int query_cache;		/* client/port query cache enabled? */
+	snd_seq_cache_client_t *cache;	/* cached clients, sorted by number */
+	int cache_clients;		/* number of cached clients */
 	char *ibuf;		/* input buffer */
 	size_t ibufptr;		/* current pointer of input buffer */
 	size_t ibuflen;		/* queued length */
@@ -93,6 +124,10 @@ struct _snd_seq {
 	snd_seq_event_t *tmpbuf;	/* temporary event for extracted event */
 	size_t tmpbufsize;		/* size of errbuf */
 	size_t packet_size;		/* input packet alignment size */
+	int ump_filter;			/* UMP input filter set? */
+	unsigned int ump_filter_groups;	/* bitmaps of the accepted packets */
+	unsigned int ump_filter_channels;
+	unsigned int ump_filter_types;
 	int midi_version;	/* current protocol version */
 	int has_queue_tempo_base;	/* support queue tempo-base? */
 
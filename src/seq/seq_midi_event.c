@@ -296,6 +296,77 @@ int snd_midi_event_resize_buffer(snd_midi_event_t *dev, size_t bufsize)
 	return 0;
 }
 
+/* set up a SysEx event on the bytes collected so far */
+static void sysex_event(snd_midi_event_t *dev, snd_seq_event_t *ev)
+{
+	ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+	ev->flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
+	ev->type = SND_SEQ_EVENT_SYSEX;
+	ev->data.ext.len = dev->read;
+	ev->data.ext.ptr = dev->buf;
+}
+
+/*
+ * append the leading data bytes of buf to a pending SysEx message,
+ * up to the buffer size; returns the number of bytes consumed
+ */
+static size_t encode_sysex_run(snd_midi_event_t *dev,
+			       const unsigned char *buf, size_t count)
+{
+	size_t n, room = dev->bufsize - dev->read;
+
+	if (count > room)
+		count = room;
+	for (n = 0; n < count; n++)
+		if (buf[n] & 0x80)
+			break;
+	memcpy(dev->buf + dev->read, buf, n);
+	dev->read += n;
+	return n;
+}
+
+/*
+ * encode a complete channel message at once, with or without running
+ * status, when no other message is pending; returns the number of bytes
+ * used, or 0 to go through the byte parser
+ */
+static long encode_channel_message(snd_midi_event_t *dev,
+				   const unsigned char *buf, long count,
+				   snd_seq_event_t *ev)
+{
+	const unsigned char *data = buf;
+	int type, len;
+
+	if (dev->qlen != 0 || count < 2)
+		return 0;
+	if (buf[0] & 0x80) {
+		if (buf[0] >= 0xf0)
+			return 0;
+		type = (buf[0] >> 4) & 0x07;
+		data++;
+		count--;
+	} else if (dev->type < ST_INVALID) {
+		type = dev->type; /* running status */
+	} else {
+		return 0;
+	}
+	len = status_event[type].qlen;
+	if (count < len || (data[0] & 0x80) || (len > 1 && (data[1] & 0x80)))
+		return 0;
+	if (data != buf)
+		dev->buf[0] = buf[0];
+	dev->buf[1] = data[0];
+	if (len > 1)
+		dev->buf[2] = data[1];
+	dev->type = type;
+	dev->read = len + 1;
+	ev->type = status_event[type].event;
+	ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+	ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
+	status_event[type].encode(dev, ev);
+	return (data - buf) + len;
+}
+
 /**
  * \brief Encodes bytes to sequencer event.
  * \param[in] dev MIDI event parser.
@@ -366,8 +437,26 @@ long snd_midi_event_encode(snd_midi_event_t *dev, const unsigned char *buf, long
 
 	ev->type = SND_SEQ_EVENT_NONE;
 
-	while (count-- > 0) {
+	result = encode_channel_message(dev, buf, count, ev);
+	if (result > 0)
+		return result;
+
+	while (count > 0) {
+		if (dev->type == ST_SYSEX && !(*buf & 0x80)) {
+			/* copy a run of SysEx data bytes at once */
+			size_t n = encode_sysex_run(dev, buf, count);
+			buf += n;
+			count -= n;
+			result += n;
+			if (dev->read >= dev->bufsize) {
+				sysex_event(dev, ev);
+				dev->read = 0; /* continue to parse */
+				return result;
+			}
+			continue;
+		}
 		rc = snd_midi_event_encode_byte(dev, *buf++, ev);
+		count--;
 		result++;
 		if (rc < 0)
 			return rc;
@@ -446,11 +535,7 @@ int snd_midi_event_encode_byte(snd_midi_event_t *dev, int c, snd_seq_event_t *ev
 	} else 	if (dev->type == ST_SYSEX) {
 		if (c == MIDI_CMD_COMMON_SYSEX_END ||
 		    dev->read >= dev->bufsize) {
-			ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
-			ev->flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
-			ev->type = SND_SEQ_EVENT_SYSEX;
-			ev->data.ext.len = dev->read;
-			ev->data.ext.ptr = dev->buf;
+			sysex_event(dev, ev);
 			if (c != MIDI_CMD_COMMON_SYSEX_END)
 				dev->read = 0; /* continue to parse */
 			else
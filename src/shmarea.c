@@ -43,6 +43,7 @@
 #include <poll.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <unistd.h>
 #include "list.h"
 
 #ifndef DOC_HIDDEN
@@ -51,6 +52,8 @@ struct snd_shm_area {
 	int shmid;
 	void *ptr;
 	int share;
+	int fd;			/* memfd, -1 for an IPC SHM segment */
+	size_t size;		/* of the memfd mapping */
 };
 #endif
 
@@ -72,11 +75,104 @@ struct snd_shm_area *snd_shm_area_create(int shmid, void *ptr)
 		area->shmid = shmid;
 		area->ptr = ptr;
 		area->share = 1;
+		area->fd = -1;
+		area->size = 0;
 		list_add_tail(&area->list, &shm_areas);
 	}
 	return area;
 }
 
+#ifdef MFD_CLOEXEC
+/* map a new memfd of size bytes */
+static void *memfd_map(size_t size, unsigned int flags, int *fdp)
+{
+	void *ptr;
+	int fd;
+
+	fd = memfd_create("alsa-mmap", MFD_CLOEXEC | flags);
+	if (fd < 0)
+		return MAP_FAILED;
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return MAP_FAILED;
+	}
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		close(fd);
+		return MAP_FAILED;
+	}
+	*fdp = fd;
+	return ptr;
+}
+#endif
+
+/**
+ * \brief Create a shm area record backed by a new memfd
+ * \param size the size of the area in bytes
+ * \param ptr returned address of the mapped area
+ * \return The allocated shm area record, NULL if fail
+ *
+ * Unlike the IPC SHM segments, the memfd does not count against the
+ * system wide SHM limits and disappears with its last reference, even
+ * when the process crashes. With the LIBASOUND_MMAP_HUGETLB environment
+ * variable set, huge pages are tried first. The record has a reference
+ * counter initialized to 1, its shmid is -1. NULL (with errno set) is
+ * returned when memfd is not supported, the caller may fall back to
+ * an IPC SHM segment then.
+ */
+struct snd_shm_area *snd_shm_area_create_memfd(size_t size, void **ptr)
+{
+#ifdef MFD_CLOEXEC
+	struct snd_shm_area *area;
+	void *map = MAP_FAILED;
+	int fd = -1;
+
+#ifdef MFD_HUGETLB
+	const char *env = getenv("LIBASOUND_MMAP_HUGETLB");
+
+	if (env && *env && *env != '0') {
+		/* a multiple of the (default 2MB) huge page */
+		size_t hsize = (size + (2 << 20) - 1) & ~(size_t)((2 << 20) - 1);
+
+		map = memfd_map(hsize, MFD_HUGETLB, &fd);
+		if (map != MAP_FAILED)
+			size = hsize;
+	}
+#endif
+	/* no huge pages (reserved), use the normal ones */
+	if (map == MAP_FAILED)
+		map = memfd_map(size, 0, &fd);
+	if (map == MAP_FAILED)
+		return NULL;
+	area = snd_shm_area_create(-1, map);
+	if (area == NULL) {
+		munmap(map, size);
+		close(fd);
+		return NULL;
+	}
+	area->fd = fd;
+	area->size = size;
+	*ptr = map;
+	return area;
+#else
+	errno = ENOSYS;
+	return NULL;
+#endif
+}
+
+/**
+ * \brief Get the memfd of a shm area record
+ * \param area shm area record
+ * \return the file descriptor, -1 for an IPC SHM segment
+ *
+ * The descriptor stays owned by the record. It can be passed to another
+ * process, which maps the same pages with mmap() at offset 0.
+ */
+int snd_shm_area_fd(struct snd_shm_area *area)
+{
+	return area ? area->fd : -1;
+}
+
 /**
  * \brief Increase the reference counter of shm area record
  * \param area shm area record
@@ -107,7 +203,12 @@ int snd_shm_area_destroy(struct snd_shm_area *area)
 	if (--area->share)
 		return 0;
 	list_del(&area->list);
-	shmdt(area->ptr);
+	if (area->fd >= 0) {
+		munmap(area->ptr, area->size);
+		close(area->fd);
+	} else {
+		shmdt(area->ptr);
+	}
 	free(area);
 	return 0;
 }
@@ -122,7 +223,8 @@ void snd_shm_area_destructor(void)
 
 	list_for_each(pos, &shm_areas) {
 		area = list_entry(pos, struct snd_shm_area, list);
-		shmdt(area->ptr);
+		if (area->fd < 0)
+			shmdt(area->ptr);
 	}
 }
 #endif /* DOC_HIDDEN */
@@ -310,7 +310,7 @@ int snd_async_add_timer_handler(snd_async_handler_t **handler, snd_timer_t *time
 		return err;
 	h->type = SND_ASYNC_HANDLER_TIMER;
 	h->u.timer = timer;
-	was_empty = list_empty(&timer->async_handlers);
+	was_empty = !_snd_async_signal_used(&timer->async_handlers);
 	list_add_tail(&h->hlist, &timer->async_handlers);
 	if (was_empty) {
 		err = snd_timer_async(timer, snd_async_handler_get_signo(h), getpid());
@@ -323,6 +323,28 @@ int snd_async_add_timer_handler(snd_async_handler_t **handler, snd_timer_t *time
 	return 0;
 }
 
+/**
+ * \brief Add an async handler for a timer called from a thread
+ * \param handler Returned handler handle
+ * \param timer timer handle
+ * \param callback Callback function
+ * \param private_data Callback private data
+ * \return 0 otherwise a negative error code on failure
+ *
+ * The callback is called from a thread polling the timer while new timer
+ * events are pending, it should read them with #snd_timer_read().
+ * No signal is used.  See #snd_async_add_thread_handler for the rules
+ * of the thread callbacks.
+ */
+int snd_async_add_timer_thread_handler(snd_async_handler_t **handler, snd_timer_t *timer,
+				       snd_async_callback_t callback, void *private_data)
+{
+	assert(timer);
+	return _snd_async_add_thread_handler(handler, SND_ASYNC_HANDLER_TIMER, timer,
+					     &timer->async_handlers, callback,
+					     private_data);
+}
+
 /**
  * \brief Return timer handle related to an async handler
  * \param handler Async handler handle
@@ -949,6 +971,50 @@ ssize_t snd_timer_read(snd_timer_t *timer, void *buffer, size_t size)
 	return (timer->ops->read)(timer, buffer, size);
 }
 
+/**
+ * \brief read a batch of timer events
+ * \param timer timer handle opened with #SND_TIMER_OPEN_TREAD
+ * \param events array to store the events
+ * \param count number of elements in the events array
+ * \return number of events read, otherwise a negative error code
+ *
+ * Fetches as many queued events as fit in \p events with a single read
+ * call instead of one call per record. The values of the
+ * #SND_TIMER_EVENT_TICK events are added up on the handle and can be
+ * picked up with #snd_timer_get_ticks() without a status ioctl.
+ */
+int snd_timer_read_events(snd_timer_t *timer, snd_timer_tread_t *events, unsigned int count)
+{
+	ssize_t result;
+	unsigned int i;
+
+	assert(timer);
+	assert(events || count == 0);
+	if (!timer->tread)
+		return -EINVAL;
+	if (count == 0)
+		return 0;
+	result = snd_timer_read(timer, events, count * sizeof(*events));
+	if (result < 0)
+		return result;
+	count = result / sizeof(*events);
+	for (i = 0; i < count; i++)
+		if (events[i].event == SND_TIMER_EVENT_TICK)
+			timer->ticks += events[i].val;
+	return count;
+}
+
+/**
+ * \brief get the number of ticks seen by snd_timer_read_events()
+ * \param timer timer handle
+ * \return sum of the values of all tick events read so far
+ */
+unsigned long snd_timer_get_ticks(snd_timer_t *timer)
+{
+	assert(timer);
+	return timer->ticks;
+}
+
 /**
  * \brief (DEPRECATED) get maximum timer ticks
  * \param info pointer to #snd_timer_info_t structure
@@ -275,6 +275,7 @@ int snd_timer_hw_open(snd_timer_t **handle, const char *name, int dev_class, int
 	tmr->mode = tmode;
 	tmr->name = strdup(name);
 	tmr->poll_fd = fd;
+	tmr->tread = !!(mode & SND_TIMER_OPEN_TREAD);
 	tmr->ops = &snd_timer_hw_ops;
 	INIT_LIST_HEAD(&tmr->async_handlers);
 	*handle = tmr;
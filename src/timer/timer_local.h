@@ -44,6 +44,8 @@ struct _snd_timer {
 	snd_timer_type_t type;
 	int mode;
 	int poll_fd;
+	int tread;			/* opened with SND_TIMER_OPEN_TREAD */
+	unsigned long ticks;		/* ticks seen by snd_timer_read_events() */
 	const snd_timer_ops_t *ops;
 	void *private_data;
 	struct list_head async_handlers;
@@ -69,6 +71,7 @@ struct _snd_timer_query {
 #endif /* DOC_HIDDEN */
 
 int snd_timer_hw_open(snd_timer_t **handle, const char *name, int dev_class, int dev_sclass, int card, int device, int subdevice, int mode);
+int snd_timer_soft_open(snd_timer_t **handle, const char *name, unsigned long resolution, int mode);
 
 int snd_timer_query_hw_open(snd_timer_query_t **handle, const char *name, int mode);
 
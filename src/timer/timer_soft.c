@@ -0,0 +1,262 @@
+/*
+ *  Timer Interface - software timer plugin
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * A timer driven by a timerfd on CLOCK_MONOTONIC instead of a kernel
+ * ALSA timer, for hardware without a suitable one:
+ *
+ *	timer.soft {
+ *		type soft
+ *		resolution 1000000	# tick length in ns (default 1ms)
+ *	}
+ *
+ * A short resolution gives hrtimer precision, the ticks value of the
+ * timer parameters batches that many ticks into one wakeup. Expirations
+ * missed by the reader are folded into the next event, so the ticks
+ * field (or the value of the SND_TIMER_EVENT_TICK event) tells how many
+ * ticks passed.
+ */
+
+#include "timer_local.h"
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_timer_soft = "";
+#endif
+
+#ifdef HAVE_SYS_TIMERFD_H
+
+#include <sys/timerfd.h>
+
+typedef struct {
+	unsigned long resolution;	/* tick length in ns */
+	unsigned int ticks;
+	unsigned int flags;
+	int running;
+	struct timespec tstamp;		/* time of the last event read */
+} snd_timer_soft_t;
+
+static int snd_timer_soft_arm(snd_timer_t *tmr, int enable)
+{
+	snd_timer_soft_t *soft = tmr->private_data;
+	struct itimerspec its;
+	unsigned long long period;
+
+	memset(&its, 0, sizeof(its));
+	if (enable) {
+		period = (unsigned long long)soft->resolution * soft->ticks;
+		its.it_value.tv_sec = period / 1000000000;
+		its.it_value.tv_nsec = period % 1000000000;
+		if (soft->flags & SNDRV_TIMER_PSFLG_AUTO)
+			its.it_interval = its.it_value;
+	}
+	if (timerfd_settime(tmr->poll_fd, 0, &its, NULL) < 0)
+		return -errno;
+	soft->running = enable;
+	return 0;
+}
+
+static int snd_timer_soft_close(snd_timer_t *tmr)
+{
+	int res;
+
+	res = close(tmr->poll_fd) < 0 ? -errno : 0;
+	free(tmr->private_data);
+	return res;
+}
+
+static int snd_timer_soft_nonblock(snd_timer_t *tmr, int nonblock)
+{
+	long flags;
+
+	if ((flags = fcntl(tmr->poll_fd, F_GETFL)) < 0)
+		return -errno;
+	if (nonblock)
+		flags |= O_NONBLOCK;
+	else
+		flags &= ~O_NONBLOCK;
+	if (fcntl(tmr->poll_fd, F_SETFL, flags) < 0)
+		return -errno;
+	return 0;
+}
+
+static int snd_timer_soft_async(snd_timer_t *tmr ATTRIBUTE_UNUSED,
+				int sig ATTRIBUTE_UNUSED,
+				pid_t pid ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int snd_timer_soft_info(snd_timer_t *tmr, snd_timer_info_t *info)
+{
+	snd_timer_soft_t *soft = tmr->private_data;
+
+	memset(info, 0, sizeof(*info));
+	info->card = -1;
+	snd_strlcpy((char *)info->id, "soft", sizeof(info->id));
+	snd_strlcpy((char *)info->name, "timerfd software timer", sizeof(info->name));
+	info->resolution = soft->resolution;
+	return 0;
+}
+
+static int snd_timer_soft_params(snd_timer_t *tmr, snd_timer_params_t *params)
+{
+	snd_timer_soft_t *soft = tmr->private_data;
+
+	soft->ticks = params->ticks ? params->ticks : 1;
+	soft->flags = params->flags;
+	/* the new period takes effect at once, like a restart */
+	if (soft->running)
+		return snd_timer_soft_arm(tmr, 1);
+	return 0;
+}
+
+static int snd_timer_soft_status(snd_timer_t *tmr, snd_timer_status_t *status)
+{
+	snd_timer_soft_t *soft = tmr->private_data;
+
+	memset(status, 0, sizeof(*status));
+	status->tstamp = soft->tstamp;
+	status->resolution = soft->resolution;
+	return 0;
+}
+
+static int snd_timer_soft_start(snd_timer_t *tmr)
+{
+	return snd_timer_soft_arm(tmr, 1);
+}
+
+static int snd_timer_soft_stop(snd_timer_t *tmr)
+{
+	return snd_timer_soft_arm(tmr, 0);
+}
+
+static ssize_t snd_timer_soft_read(snd_timer_t *tmr, void *buffer, size_t size)
+{
+	snd_timer_soft_t *soft = tmr->private_data;
+	uint64_t expired;
+	unsigned int ticks;
+
+	if (size < (tmr->tread ? sizeof(snd_timer_tread_t) : sizeof(snd_timer_read_t)))
+		return -EINVAL;
+	if (read(tmr->poll_fd, &expired, sizeof(expired)) != sizeof(expired))
+		return -errno;
+	clock_gettime(CLOCK_MONOTONIC, &soft->tstamp);
+	ticks = expired * soft->ticks;
+	if (tmr->tread) {
+		snd_timer_tread_t *tr = buffer;
+
+		tr->event = SND_TIMER_EVENT_TICK;
+		tr->tstamp = soft->tstamp;
+		tr->val = ticks;
+		return sizeof(*tr);
+	} else {
+		snd_timer_read_t *r = buffer;
+
+		r->resolution = soft->resolution;
+		r->ticks = ticks;
+		return sizeof(*r);
+	}
+}
+
+static const snd_timer_ops_t snd_timer_soft_ops = {
+	.close = snd_timer_soft_close,
+	.nonblock = snd_timer_soft_nonblock,
+	.async = snd_timer_soft_async,
+	.info = snd_timer_soft_info,
+	.params = snd_timer_soft_params,
+	.status = snd_timer_soft_status,
+	.rt_start = snd_timer_soft_start,
+	.rt_stop = snd_timer_soft_stop,
+	.rt_continue = snd_timer_soft_start,
+	.read = snd_timer_soft_read,
+};
+
+int snd_timer_soft_open(snd_timer_t **handle, const char *name, unsigned long resolution, int mode)
+{
+	snd_timer_soft_t *soft;
+	snd_timer_t *tmr;
+	int fd, flags;
+
+	*handle = NULL;
+	if (!resolution)
+		return -EINVAL;
+	flags = TFD_CLOEXEC;
+	if (mode & SND_TIMER_OPEN_NONBLOCK)
+		flags |= TFD_NONBLOCK;
+	fd = timerfd_create(CLOCK_MONOTONIC, flags);
+	if (fd < 0)
+		return -errno;
+	tmr = calloc(1, sizeof(*tmr));
+	soft = calloc(1, sizeof(*soft));
+	if (!tmr || !soft) {
+		free(tmr);
+		free(soft);
+		close(fd);
+		return -ENOMEM;
+	}
+	soft->resolution = resolution;
+	soft->ticks = 1;
+	soft->flags = SNDRV_TIMER_PSFLG_AUTO;
+	tmr->type = SND_TIMER_TYPE_SOFT;
+	tmr->mode = O_RDONLY | ((mode & SND_TIMER_OPEN_NONBLOCK) ? O_NONBLOCK : 0);
+	tmr->name = strdup(name);
+	tmr->poll_fd = fd;
+	tmr->tread = !!(mode & SND_TIMER_OPEN_TREAD);
+	tmr->ops = &snd_timer_soft_ops;
+	tmr->private_data = soft;
+	INIT_LIST_HEAD(&tmr->async_handlers);
+	*handle = tmr;
+	return 0;
+}
+
+int _snd_timer_soft_open(snd_timer_t **timer, char *name,
+			 snd_config_t *root ATTRIBUTE_UNUSED,
+			 snd_config_t *conf, int mode)
+{
+	snd_config_iterator_t i, next;
+	long resolution = 1000000;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (_snd_conf_generic_id(id))
+			continue;
+		if (strcmp(id, "resolution") == 0) {
+			err = snd_config_get_integer(n, &resolution);
+			if (err < 0)
+				return err;
+			if (resolution <= 0) {
+				SNDERR("Invalid resolution %ld", resolution);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unexpected field %s", id);
+		return -EINVAL;
+	}
+	return snd_timer_soft_open(timer, name, resolution, mode);
+}
+SND_DLSYM_BUILD_VERSION(_snd_timer_soft_open, SND_TIMER_DLSYM_VERSION);
+
+#endif /* HAVE_SYS_TIMERFD_H */
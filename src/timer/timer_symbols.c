@@ -21,9 +21,11 @@
 #ifndef PIC
 
 extern const char *_snd_module_timer_hw;
+extern const char *_snd_module_timer_soft;
 
 static const char **snd_timer_open_objects[] = {
-	&_snd_module_timer_hw
+	&_snd_module_timer_hw,
+	&_snd_module_timer_soft
 };
 	
 void *snd_timer_open_symbols(void)
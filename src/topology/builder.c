@@ -18,6 +18,8 @@
 */
 
 #include "tplg_local.h"
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /* write a block, track the position */
 static ssize_t twrite(snd_tplg_t *tplg, void *data, size_t data_size)
@@ -120,7 +122,7 @@ static int write_elem_block(snd_tplg_t *tplg,
 
 				wsize = twrite(tplg, elem->obj, elem->size);
 				if (wsize < 0)
-					return size;
+					return wsize;
 
 				total_size += wsize;
 				/* get to the end of sub list */
@@ -152,12 +154,17 @@ static size_t calc_manifest_size(snd_tplg_t *tplg)
 	       tplg->manifest.priv.size;
 }
 
-static size_t calc_real_size(struct list_head *base)
+/*
+ * size of the elems in the list with and without the block headers,
+ * computed in a single walk before anything is written
+ */
+static size_t calc_real_size(struct list_head *base, size_t *block_size)
 {
 	struct list_head *pos;
 	struct tplg_elem *elem, *elem_next;
 	size_t size = 0;
 
+	*block_size = 0;
 	list_for_each(pos, base) {
 
 		elem = list_entry(pos, struct tplg_elem, list);
@@ -166,6 +173,8 @@ static size_t calc_real_size(struct list_head *base)
 		if (elem->compound_elem)
 			continue;
 
+		*block_size += elem->size;
+
 		if (elem->size <= 0)
 			continue;
 
@@ -180,26 +189,6 @@ static size_t calc_real_size(struct list_head *base)
 	return size;
 }
 
-static size_t calc_block_size(struct list_head *base)
-{
-	struct list_head *pos;
-	struct tplg_elem *elem;
-	size_t size = 0;
-
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
-
-		/* compound elems have already been copied to other elems */
-		if (elem->compound_elem)
-			continue;
-
-		size += elem->size;
-	}
-
-	return size;
-}
-
 /* write the manifest including its private data */
 static ssize_t write_manifest_data(snd_tplg_t *tplg)
 {
@@ -226,35 +215,50 @@ static ssize_t write_manifest_data(snd_tplg_t *tplg)
 	return ret;
 }
 
-int tplg_write_data(snd_tplg_t *tplg)
+/*
+ * map the output file as the binary buffer, so that the blocks land in
+ * the page cache directly instead of a heap copy written out at the end
+ */
+static int map_output(snd_tplg_t *tplg, int fd, size_t size)
+{
+	void *bin;
+
+	if (ftruncate(fd, size) < 0)
+		return -errno;
+	bin = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (bin == MAP_FAILED)
+		return -errno;
+	tplg->bin = bin;
+	return 0;
+}
+
+/* write out a heap buffer, for outputs without mmap support */
+static int write_output(snd_tplg_t *tplg, int fd)
+{
+	size_t pos = 0;
+	ssize_t r;
+
+	while (pos < tplg->bin_size) {
+		r = write(fd, tplg->bin + pos, tplg->bin_size - pos);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			SNDERR("write error: %s", strerror(errno));
+			return -errno;
+		}
+		pos += r;
+	}
+	return 0;
+}
+
+static int write_blocks(snd_tplg_t *tplg, const size_t *block_sizes)
 {
 	struct tplg_table *tptr;
 	struct list_head *list;
 	ssize_t ret;
-	size_t total_size, size;
+	size_t size;
 	unsigned int index;
 
-	/* calculate total size */
-	total_size = calc_manifest_size(tplg);
-	for (index = 0; index < tplg_table_items; index++) {
-		tptr = &tplg_table[index];
-		if (!tptr->build)
-			continue;
-		list = (struct list_head *)((void *)tplg + tptr->loff);
-		size = calc_real_size(list);
-		total_size += size;
-	}
-
-	/* allocate new binary output */
-	free(tplg->bin);
-	tplg->bin = malloc(total_size);
-	tplg->bin_pos = 0;
-	tplg->bin_size = total_size;
-	if (tplg->bin == NULL) {
-		tplg->bin_size = 0;
-		return -ENOMEM;
-	}
-
 	/* write manifest */
 	ret = write_manifest_data(tplg);
 	if (ret < 0) {
@@ -268,8 +272,8 @@ int tplg_write_data(snd_tplg_t *tplg)
 		if (!tptr->build)
 			continue;
 		list = (struct list_head *)((void *)tplg + tptr->loff);
-		/* calculate the block size in bytes for all elems in this list */
-		size = calc_block_size(list);
+		/* the block size in bytes for all elems in this list */
+		size = block_sizes[index];
 		if (size == 0)
 			continue;
 		tplg_log(tplg, 'B', tplg->bin_pos,
@@ -288,11 +292,85 @@ int tplg_write_data(snd_tplg_t *tplg)
 	tplg_log(tplg, 'B', tplg->bin_pos, "total size is 0x%zx/%zd",
 		 tplg->bin_pos, tplg->bin_pos);
 
-	if (total_size != tplg->bin_pos) {
+	if (tplg->bin_size != tplg->bin_pos) {
 		SNDERR("total size mismatch (%zd != %zd)",
-		       total_size, tplg->bin_pos);
+		       tplg->bin_size, tplg->bin_pos);
 		return -EINVAL;
 	}
 
 	return 0;
 }
+
+/*
+ * build the binary, into tplg->bin or, when outfile is given, straight
+ * into that file
+ */
+int tplg_write_data(snd_tplg_t *tplg, const char *outfile)
+{
+	struct tplg_table *tptr;
+	struct list_head *list;
+	size_t total_size, *block_sizes;
+	unsigned int index;
+	int fd = -1, mapped = 0, err;
+
+	block_sizes = calloc(tplg_table_items, sizeof(*block_sizes));
+	if (block_sizes == NULL)
+		return -ENOMEM;
+
+	/* calculate total size */
+	total_size = calc_manifest_size(tplg);
+	for (index = 0; index < tplg_table_items; index++) {
+		tptr = &tplg_table[index];
+		if (!tptr->build)
+			continue;
+		list = (struct list_head *)((void *)tplg + tptr->loff);
+		total_size += calc_real_size(list, &block_sizes[index]);
+	}
+
+	free(tplg->bin);
+	tplg->bin = NULL;
+	tplg->bin_pos = 0;
+	tplg->bin_size = total_size;
+
+	if (outfile) {
+		fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			err = -errno;
+			SNDERR("failed to open %s err %d", outfile, err);
+			goto out;
+		}
+		mapped = map_output(tplg, fd, total_size) == 0;
+	}
+
+	/* allocate new binary output */
+	if (!mapped) {
+		tplg->bin = malloc(total_size);
+		if (tplg->bin == NULL) {
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
+	err = write_blocks(tplg, block_sizes);
+	if (err >= 0 && fd >= 0 && !mapped)
+		err = write_output(tplg, fd);
+
+ out:
+	if (mapped) {
+		munmap(tplg->bin, total_size);
+		tplg->bin = NULL;
+	}
+	if (fd >= 0) {
+		/* the file is complete or it is not written at all */
+		if (close(fd) < 0 && err >= 0)
+			err = -errno;
+		if (err < 0)
+			unlink(outfile);
+		free(tplg->bin);
+		tplg->bin = NULL;
+	}
+	if (tplg->bin == NULL)
+		tplg->bin_size = 0;
+	free(block_sizes);
+	return err;
+}
@@ -0,0 +1,260 @@
+/*
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of
+  the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+*/
+
+#include "tplg_local.h"
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/*
+ * Build cache of snd_tplg_build_file()
+ *
+ * The cache file holds the binary of the last build and the hash of the
+ * configuration tree it was built from. The tree is hashed after
+ * snd_config_load(), so that changes of included files are seen too.
+ * When the hash matches, the binary is copied out and the parser and the
+ * builder are skipped, which are most of the build time.
+ */
+
+#define TPLG_CACHE_MAGIC	"ALSATPLC"
+#define TPLG_CACHE_VERSION	1
+
+struct tplg_cache_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t abi;
+	uint64_t key;
+	uint64_t size;		/* of the binary after the header */
+};
+
+#define FNV64_OFFSET	0xcbf29ce484222325ULL
+#define FNV64_PRIME	0x100000001b3ULL
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+
+	while (size-- > 0) {
+		h ^= *p++;
+		h *= FNV64_PRIME;
+	}
+	return h;
+}
+
+static uint64_t hash_str(uint64_t h, const char *str)
+{
+	/* include the terminator, so that "ab" "c" differs from "a" "bc" */
+	return hash_bytes(h, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+static uint64_t hash_config(uint64_t h, snd_config_t *cfg)
+{
+	snd_config_iterator_t i, next;
+	snd_config_type_t type;
+	const char *id, *str;
+	long long ll;
+	double d;
+	long l;
+
+	if (snd_config_get_id(cfg, &id) < 0)
+		id = NULL;
+	h = hash_str(h, id);
+	type = snd_config_get_type(cfg);
+	h = hash_bytes(h, &type, sizeof(type));
+	switch (type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		snd_config_get_integer(cfg, &l);
+		h = hash_bytes(h, &l, sizeof(l));
+		break;
+	case SND_CONFIG_TYPE_INTEGER64:
+		snd_config_get_integer64(cfg, &ll);
+		h = hash_bytes(h, &ll, sizeof(ll));
+		break;
+	case SND_CONFIG_TYPE_REAL:
+		snd_config_get_real(cfg, &d);
+		h = hash_bytes(h, &d, sizeof(d));
+		break;
+	case SND_CONFIG_TYPE_STRING:
+		snd_config_get_string(cfg, &str);
+		h = hash_str(h, str);
+		break;
+	case SND_CONFIG_TYPE_COMPOUND:
+		snd_config_for_each(i, next, cfg)
+			h = hash_config(h, snd_config_iterator_entry(i));
+		/* close the compound, the siblings must not look like children */
+		h = hash_bytes(h, "}", 1);
+		break;
+	default:
+		break;
+	}
+	return h;
+}
+
+uint64_t tplg_cache_key(snd_tplg_t *tplg, snd_config_t *cfg)
+{
+	uint64_t h = FNV64_OFFSET;
+	unsigned int flags;
+
+	/* the instance settings change the binary too */
+	flags = tplg->dapm_sort;
+	h = hash_bytes(h, &tplg->version, sizeof(tplg->version));
+	h = hash_bytes(h, &flags, sizeof(flags));
+	return hash_config(h, cfg);
+}
+
+static int write_all(int fd, const void *data, size_t size)
+{
+	ssize_t r;
+
+	while (size > 0) {
+		r = write(fd, data, size);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += r;
+		size -= r;
+	}
+	return 0;
+}
+
+/* map a whole file for reading, a zero sized file is an error */
+static int map_file(const char *file, void **data, size_t *size)
+{
+	struct stat st;
+	int fd, err = 0;
+
+	fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0)
+		err = -errno;
+	else if (st.st_size == 0)
+		err = -ENODATA;
+	if (err == 0) {
+		*data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (*data == MAP_FAILED)
+			err = -errno;
+		else
+			*size = st.st_size;
+	}
+	close(fd);
+	return err;
+}
+
+/* write the cached binary to outfile, -ENOENT when the cache is stale */
+int tplg_cache_restore(snd_tplg_t *tplg, uint64_t key, const char *outfile)
+{
+	const struct tplg_cache_hdr *hdr;
+	void *data;
+	size_t size;
+	int fd, err;
+
+	err = map_file(tplg->cache_file, &data, &size);
+	if (err < 0)
+		return -ENOENT;
+	hdr = data;
+	if (size < sizeof(*hdr) ||
+	    memcmp(hdr->magic, TPLG_CACHE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != TPLG_CACHE_VERSION ||
+	    hdr->abi != SND_SOC_TPLG_ABI_VERSION ||
+	    hdr->key != key || hdr->size != size - sizeof(*hdr)) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		err = -errno;
+		SNDERR("failed to open %s err %d", outfile, err);
+		goto out;
+	}
+	err = write_all(fd, hdr + 1, hdr->size);
+	if (close(fd) < 0 && err >= 0)
+		err = -errno;
+	if (err < 0) {
+		SNDERR("failed to write %s err %d", outfile, err);
+		unlink(outfile);
+	} else {
+		tplg_log(tplg, 'B', 0, "cache: %s reused for %s",
+			 tplg->cache_file, outfile);
+	}
+ out:
+	munmap(data, size);
+	return err;
+}
+
+/*
+ * store the binary just built to outfile in the cache
+ *
+ * The cache is replaced by a rename, so that concurrent builds sharing it
+ * see either the old or the new version.
+ */
+int tplg_cache_store(snd_tplg_t *tplg, uint64_t key, const char *outfile)
+{
+	struct tplg_cache_hdr hdr;
+	char *tmp;
+	void *data;
+	size_t size;
+	int fd, err;
+
+	err = map_file(outfile, &data, &size);
+	if (err < 0)
+		return err;
+	tmp = malloc(strlen(tplg->cache_file) + 16);
+	if (tmp == NULL) {
+		err = -ENOMEM;
+		goto out;
+	}
+	sprintf(tmp, "%s.%d", tplg->cache_file, (int)getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		err = -errno;
+		goto out;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TPLG_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = TPLG_CACHE_VERSION;
+	hdr.abi = SND_SOC_TPLG_ABI_VERSION;
+	hdr.key = key;
+	hdr.size = size;
+	err = write_all(fd, &hdr, sizeof(hdr));
+	if (err >= 0)
+		err = write_all(fd, data, size);
+	if (close(fd) < 0 && err >= 0)
+		err = -errno;
+	if (err >= 0 && rename(tmp, tplg->cache_file) < 0)
+		err = -errno;
+	if (err < 0)
+		unlink(tmp);
+ out:
+	if (err < 0)
+		SNDERR("failed to update the cache %s err %d", tplg->cache_file, err);
+	free(tmp);
+	munmap(data, size);
+	return err;
+}
+
+int snd_tplg_set_cache(snd_tplg_t *tplg, const char *file)
+{
+	char *s = NULL;
+
+	if (file) {
+		s = strdup(file);
+		if (s == NULL)
+			return -ENOMEM;
+	}
+	free(tplg->cache_file);
+	tplg->cache_file = s;
+	return 0;
+}
@@ -342,7 +342,7 @@ end:
 static int get_uuid(const char *str, unsigned char *uuid_le)
 {
 	unsigned long int  val;
-	char *tmp, *s = NULL;
+	char *tmp, *s = NULL, *save;
 	int values = 0, ret = 0;
 
 	tmp = strdup(str);
@@ -352,7 +352,7 @@ static int get_uuid(const char *str, unsigned char *uuid_le)
 	if (strchr(tmp, ':') == NULL)
 		goto data2;
 
-	s = strtok(tmp, ":");
+	s = strtok_r(tmp, ":", &save);
 	while (s != NULL) {
 		errno = 0;
 		val = strtoul(s, NULL, 16);
@@ -370,12 +370,12 @@ static int get_uuid(const char *str, unsigned char *uuid_le)
 		if (values >= 16)
 			break;
 
-		s = strtok(NULL, ":");
+		s = strtok_r(NULL, ":", &save);
 	}
 	goto out;
 
 data2:
-	s = strtok(tmp, ",");
+	s = strtok_r(tmp, ",", &save);
 
 	while (s != NULL) {
 		errno = 0;
@@ -394,7 +394,7 @@ data2:
 		if (values >= 16)
 			break;
 
-		s = strtok(NULL, ",");
+		s = strtok_r(NULL, ",", &save);
 	}
 
 	if (values < 16) {
@@ -435,7 +435,7 @@ static int write_hex(char *buf, char *str, int width)
 
 static int copy_data_hex(char *data, int off, const char *str, int width)
 {
-	char *tmp, *s = NULL, *p = data;
+	char *tmp, *s = NULL, *p = data, *save;
 	int ret;
 
 	tmp = strdup(str);
@@ -443,7 +443,7 @@ static int copy_data_hex(char *data, int off, const char *str, int width)
 		return -ENOMEM;
 
 	p += off;
-	s = strtok(tmp, ",:");
+	s = strtok_r(tmp, ",:", &save);
 
 	while (s != NULL) {
 		ret = write_hex(p, s, width);
@@ -452,7 +452,7 @@ static int copy_data_hex(char *data, int off, const char *str, int width)
 			return ret;
 		}
 
-		s = strtok(NULL, ",:");
+		s = strtok_r(NULL, ",:", &save);
 		p += width;
 	}
 
@@ -540,7 +540,7 @@ static struct tplg_elem *get_tokens(snd_tplg_t *tplg, struct tplg_elem *elem)
 			continue;
 
 		if (!ref->elem) {
-			ref->elem = tplg_elem_lookup(&tplg->token_list,
+			ref->elem = tplg_elem_lookup(tplg, &tplg->token_list,
 				ref->id, SND_TPLG_TYPE_TOKEN, elem->index);
 		}
 
@@ -689,7 +689,7 @@ static int build_tuples(snd_tplg_t *tplg, struct tplg_elem *elem)
 		tplg_dbg("tuples '%s' used by data '%s'", ref->id, elem->id);
 
 		if (!ref->elem)
-			ref->elem = tplg_elem_lookup(&tplg->tuple_list,
+			ref->elem = tplg_elem_lookup(tplg, &tplg->tuple_list,
 				ref->id, SND_TPLG_TYPE_TUPLE, elem->index);
 		tuples = ref->elem;
 		if (!tuples) {
@@ -1505,7 +1505,7 @@ int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 	int priv_data_size, old_priv_data_size;
 	void *obj;
 
-	ref_elem = tplg_elem_lookup(&tplg->pdata_list,
+	ref_elem = tplg_elem_lookup(tplg, &tplg->pdata_list,
 				     ref->id, SND_TPLG_TYPE_DATA, elem->index);
 	if (!ref_elem) {
 		SNDERR("cannot find data '%s' referenced by"
@@ -1625,7 +1625,7 @@ int tplg_add_token(snd_tplg_t *tplg, struct tplg_elem *parent,
 	unsigned int i;
 	size_t size;
 
-	elem = tplg_elem_lookup(&tplg->token_list, parent->id,
+	elem = tplg_elem_lookup(tplg, &tplg->token_list, parent->id,
 				SND_TPLG_TYPE_TOKEN, parent->index);
 	if (elem == NULL) {
 		elem = tplg_elem_new_common(tplg, NULL, parent->id,
@@ -302,6 +302,12 @@ void tplg_elem_free(struct tplg_elem *elem)
 {
 	list_del(&elem->list);
 
+	if (elem->hash_pprev) {
+		*elem->hash_pprev = elem->hash_next;
+		if (elem->hash_next)
+			elem->hash_next->hash_pprev = elem->hash_pprev;
+	}
+
 	tplg_ref_free_list(&elem->ref_list);
 
 	/* free struct snd_tplg_ object,
@@ -328,29 +334,113 @@ void tplg_elem_free_list(struct list_head *base)
 	}
 }
 
-struct tplg_elem *tplg_elem_lookup(struct list_head *base, const char* id,
+#define TPLG_ELEM_HASH_MIN	64
+
+/* FNV-1a of the id, mixed with the list the element belongs to */
+static unsigned int elem_hash(struct list_head *base, const char *id)
+{
+	unsigned int h = 2166136261u ^ (unsigned int)((uintptr_t)base >> 4);
+
+	while (*id) {
+		h ^= (unsigned char)*id++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static void elem_hash_link(struct tplg_elem **bucket, struct tplg_elem *elem)
+{
+	elem->hash_next = *bucket;
+	if (*bucket)
+		(*bucket)->hash_pprev = &elem->hash_next;
+	*bucket = elem;
+	elem->hash_pprev = bucket;
+}
+
+int tplg_elem_hash_init(snd_tplg_t *tplg)
+{
+	tplg->elem_hash = calloc(TPLG_ELEM_HASH_MIN, sizeof(*tplg->elem_hash));
+	if (!tplg->elem_hash)
+		return -ENOMEM;
+	tplg->elem_hash_size = TPLG_ELEM_HASH_MIN;
+	return 0;
+}
+
+/* double the buckets, keep the old ones when out of memory */
+static void elem_hash_grow(snd_tplg_t *tplg)
+{
+	struct tplg_elem **table, *elem, *next;
+	unsigned int i, size = tplg->elem_hash_size * 2;
+
+	table = calloc(size, sizeof(*table));
+	if (!table)
+		return;
+	for (i = 0; i < tplg->elem_hash_size; i++) {
+		for (elem = tplg->elem_hash[i]; elem; elem = next) {
+			next = elem->hash_next;
+			elem_hash_link(&table[elem->hash & (size - 1)], elem);
+		}
+	}
+	free(tplg->elem_hash);
+	tplg->elem_hash = table;
+	tplg->elem_hash_size = size;
+}
+
+static void elem_hash_add(snd_tplg_t *tplg, struct tplg_elem *elem,
+			  struct list_head *base)
+{
+	if (++tplg->elem_hash_count > tplg->elem_hash_size)
+		elem_hash_grow(tplg);
+	elem->hash_list = base;
+	elem->hash = elem_hash(base, elem->id);
+	elem->seq = tplg->elem_seq++;
+	elem_hash_link(&tplg->elem_hash[elem->hash & (tplg->elem_hash_size - 1)],
+		       elem);
+}
+
+/*
+ * find an element by id in the given list
+ *
+ * The result is the one of a scan of the list, which is sorted by index:
+ * the first element with the id, except that for a specific index the
+ * scan stops at the first element of a higher index.
+ */
+struct tplg_elem *tplg_elem_lookup(snd_tplg_t *tplg,
+				   struct list_head *base, const char* id,
 				   unsigned int type, int index)
 {
-	struct list_head *pos;
-	struct tplg_elem *elem;
+	struct tplg_elem *elem, *found = NULL, *prev;
+	unsigned int h;
 
 	if (!base || !id)
 		return NULL;
 
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
+	h = elem_hash(base, id);
+	for (elem = tplg->elem_hash[h & (tplg->elem_hash_size - 1)];
+	     elem; elem = elem->hash_next) {
+		if (elem->hash != h || elem->hash_list != base ||
+		    elem->type != type || strcmp(elem->id, id))
+			continue;
+		/* the first in the list has the lowest index, then seq */
+		if (!found || elem->index < found->index ||
+		    (elem->index == found->index && elem->seq < found->seq))
+			found = elem;
+	}
+	if (!found)
+		return NULL;
 
-		if (!strcmp(elem->id, id) && elem->type == type)
-			return elem;
-		/* SND_TPLG_INDEX_ALL is the default value "0" and applicable
-		   for all use cases */
-		if ((index != SND_TPLG_INDEX_ALL)
-			&& (elem->index > index))
-			break;
+	/* SND_TPLG_INDEX_ALL is the default value "0" and applicable
+	   for all use cases */
+	if ((index != SND_TPLG_INDEX_ALL) && (found->index > index)) {
+		/* the scan reaches it only if it is the first above index */
+		if (found->list.prev != base) {
+			prev = list_entry(found->list.prev, struct tplg_elem, list);
+			if (prev->index > index)
+				return NULL;
+		}
 	}
 
-	return NULL;
+	return found;
 }
 
 /* find an element by type */
@@ -389,13 +479,50 @@ void tplg_elem_insert(struct tplg_elem *elem_p, struct list_head *list)
 	struct list_head *pos, *p = &(elem_p->list);
 	struct tplg_elem *elem;
 
-	list_for_each(pos, list) {
+	/* after the last one not above, the elements come mostly in order */
+	for (pos = list->prev; pos != list; pos = pos->prev) {
 		elem = list_entry(pos, struct tplg_elem, list);
-		if (elem_p->index < elem->index)
+		if (elem->index <= elem_p->index)
 			break;
 	}
-	/* insert item before pos */
-	list_insert(p, pos->prev, pos);
+	/* insert item after pos */
+	list_insert(p, pos, pos->next);
+}
+
+/* move all elements of src into the same lists of tplg, after its own */
+void tplg_elem_merge(snd_tplg_t *tplg, snd_tplg_t *src)
+{
+	struct list_head *pos, *npos, *list, *src_list;
+	struct tplg_elem *elem;
+	unsigned int index, i;
+
+	for (index = 0; index < tplg_table_items; index++) {
+		/* some table entries share a list */
+		for (i = 0; i < index; i++)
+			if (tplg_table[i].loff == tplg_table[index].loff)
+				break;
+		if (i < index)
+			continue;
+		list = (struct list_head *)((void *)tplg + tplg_table[index].loff);
+		src_list = (struct list_head *)((void *)src + tplg_table[index].loff);
+		list_for_each_safe(pos, npos, src_list) {
+			elem = list_entry(pos, struct tplg_elem, list);
+			list_del(&elem->list);
+			/* routes are neither hashed nor always sorted */
+			if (!elem->hash_pprev) {
+				if (list == &tplg->route_list && !tplg->dapm_sort)
+					list_add_tail(&elem->list, list);
+				else
+					tplg_elem_insert(elem, list);
+				continue;
+			}
+			tplg_elem_insert(elem, list);
+			elem_hash_add(tplg, elem, list);
+		}
+	}
+	/* the src hash chains are stale now, forget them */
+	memset(src->elem_hash, 0, src->elem_hash_size * sizeof(*src->elem_hash));
+	src->elem_hash_count = 0;
 }
 
 /* create a new common element and object */
@@ -461,6 +588,7 @@ struct tplg_elem* tplg_elem_new_common(snd_tplg_t *tplg,
 
 	list = (struct list_head *)((void *)tplg + tptr->loff);
 	tplg_elem_insert(elem, list);
+	elem_hash_add(tplg, elem, list);
 	obj_size = tptr->size;
 	elem->free = tptr->free;
 	elem->table = tptr;
@@ -469,7 +597,7 @@ struct tplg_elem* tplg_elem_new_common(snd_tplg_t *tplg,
 	if (obj_size > 0) {
 		obj = calloc(1, obj_size);
 		if (obj == NULL) {
-			free(elem);
+			tplg_elem_free(elem);
 			return NULL;
 		}
 
@@ -19,6 +19,9 @@
 
 #include "tplg_local.h"
 #include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 /*
  * Get integer value
@@ -142,14 +145,193 @@ int tplg_parse_compound(snd_tplg_t *tplg, snd_config_t *cfg,
 	return err;
 }
 
+typedef int (*tplg_parser_t)(snd_tplg_t *tplg, snd_config_t *cfg, void *priv);
+
+static tplg_parser_t tplg_section_parser(const char *id)
+{
+	struct tplg_table *p;
+	unsigned int idx;
+
+	for (idx = 0; idx < tplg_table_items; idx++) {
+		p = &tplg_table[idx];
+		if (p->id && strcmp(id, p->id) == 0)
+			return p->parse;
+		if (p->id2 && strcmp(id, p->id2) == 0)
+			return p->parse;
+	}
+	return NULL;
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+/* below this count of objects the threads cost more than they save */
+#define TPLG_PARSE_PARALLEL_MIN		256
+#define TPLG_PARSE_THREADS_MAX		16
+
+/* one object of a section, e.g. a single widget of SectionWidget */
+struct tplg_parse_item {
+	tplg_parser_t parser;
+	snd_config_t *cfg;
+};
+
+/* a worker parses a contiguous range of objects into its own instance */
+struct tplg_parse_worker {
+	snd_tplg_t *tplg;
+	struct tplg_parse_item *items;
+	unsigned int count;
+	pthread_t thread;
+	int started;
+	int err;
+};
+
+static void *tplg_parse_worker(void *arg)
+{
+	struct tplg_parse_worker *w = arg;
+	unsigned int i;
+
+	for (i = 0; i < w->count; i++) {
+		w->err = w->items[i].parser(w->tplg, w->items[i].cfg, NULL);
+		if (w->err < 0)
+			break;
+	}
+	return NULL;
+}
+
+/*
+ * The sections are independent until the build resolves the references,
+ * so the objects are split into ranges parsed by threads, each into its
+ * own instance. Merging the instances in the order of the ranges gives
+ * the same lists as a serial parse.
+ */
+static int tplg_parse_parallel(snd_tplg_t *tplg, struct tplg_parse_item *items,
+			       unsigned int count)
+{
+	struct tplg_parse_worker *workers;
+	unsigned int i, nworkers, first = 0;
+	int flags, err = 0;
+
+	nworkers = tplg->parse_threads;
+	if (nworkers > count / (TPLG_PARSE_PARALLEL_MIN / 2))
+		nworkers = count / (TPLG_PARSE_PARALLEL_MIN / 2);
+	workers = calloc(nworkers, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+
+	flags = (tplg->verbose ? SND_TPLG_CREATE_VERBOSE : 0) |
+		(tplg->dapm_sort ? 0 : SND_TPLG_CREATE_DAPM_NOSORT);
+	for (i = 0; i < nworkers; i++) {
+		struct tplg_parse_worker *w = &workers[i];
+
+		w->items = items + first;
+		w->count = (unsigned long long)count * (i + 1) / nworkers - first;
+		first += w->count;
+		/* the first range is parsed straight into tplg */
+		w->tplg = i ? snd_tplg_create(flags) : tplg;
+		if (!w->tplg) {
+			err = -ENOMEM;
+			goto out;
+		}
+		if (i && pthread_create(&w->thread, NULL, tplg_parse_worker, w) == 0)
+			w->started = 1;
+	}
+
+	tplg_parse_worker(&workers[0]);
+	for (i = 1; i < nworkers; i++) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+		else
+			tplg_parse_worker(&workers[i]);
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		err = workers[i].err;
+		if (err < 0)
+			break;
+		if (i)
+			tplg_elem_merge(tplg, workers[i].tplg);
+	}
+
+out:
+	for (i = 1; i < nworkers; i++)
+		if (workers[i].tplg)
+			snd_tplg_free(workers[i].tplg);
+	free(workers);
+	return err;
+}
+
+static int tplg_parse_config_parallel(snd_tplg_t *tplg, snd_config_t *cfg)
+{
+	struct tplg_parse_item *items = NULL, *tmp;
+	unsigned int count = 0, size = 0, k;
+	snd_config_iterator_t i, next, j, jnext;
+	snd_config_t *n;
+	tplg_parser_t parser;
+	const char *id;
+	int err = 0;
+
+	/* collect the objects of all sections in the order of a serial parse */
+	snd_config_for_each(i, next, cfg) {
+		n = snd_config_iterator_entry(i);
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+
+		parser = tplg_section_parser(id);
+		if (parser == NULL) {
+			SNDERR("unknown section %s", id);
+			continue;
+		}
+
+		if (snd_config_get_type(n) != SND_CONFIG_TYPE_COMPOUND) {
+			SNDERR("compound type expected for %s", id);
+			err = -EINVAL;
+			goto out;
+		}
+
+		/* like tplg_parse_compound(), an empty section is an error */
+		if (snd_config_iterator_first(n) == snd_config_iterator_end(n)) {
+			err = -EINVAL;
+			goto out;
+		}
+
+		snd_config_for_each(j, jnext, n) {
+			if (count == size) {
+				size = size ? size * 2 : 256;
+				tmp = realloc(items, size * sizeof(*items));
+				if (!tmp) {
+					err = -ENOMEM;
+					goto out;
+				}
+				items = tmp;
+			}
+			items[count].parser = parser;
+			items[count].cfg = snd_config_iterator_entry(j);
+			count++;
+		}
+	}
+
+	if (count >= TPLG_PARSE_PARALLEL_MIN) {
+		err = tplg_parse_parallel(tplg, items, count);
+		goto out;
+	}
+	for (k = 0; k < count; k++) {
+		err = items[k].parser(tplg, items[k].cfg, NULL);
+		if (err < 0)
+			break;
+	}
+
+out:
+	free(items);
+	return err;
+}
+
+#endif /* HAVE_LIBPTHREAD */
+
 static int tplg_parse_config(snd_tplg_t *tplg, snd_config_t *cfg)
 {
-	int (*parser)(snd_tplg_t *tplg, snd_config_t *cfg, void *priv);
+	tplg_parser_t parser;
 	snd_config_iterator_t i, next;
 	snd_config_t *n;
 	const char *id;
-	struct tplg_table *p;
-	unsigned int idx;
 	int err;
 
 	if (snd_config_get_type(cfg) != SND_CONFIG_TYPE_COMPOUND) {
@@ -157,6 +339,11 @@ static int tplg_parse_config(snd_tplg_t *tplg, snd_config_t *cfg)
 		return -EINVAL;
 	}
 
+#ifdef HAVE_LIBPTHREAD
+	if (tplg->parse_threads > 1)
+		return tplg_parse_config_parallel(tplg, cfg);
+#endif
+
 	/* parse topology config sections */
 	snd_config_for_each(i, next, cfg) {
 
@@ -164,19 +351,7 @@ static int tplg_parse_config(snd_tplg_t *tplg, snd_config_t *cfg)
 		if (snd_config_get_id(n, &id) < 0)
 			continue;
 
-		parser = NULL;
-		for (idx = 0; idx < tplg_table_items; idx++) {
-			p = &tplg_table[idx];
-			if (p->id && strcmp(id, p->id) == 0) {
-				parser = p->parse;
-				break;
-			}
-			if (p->id2 && strcmp(id, p->id2) == 0) {
-				parser = p->parse;
-				break;
-			}
-		}
-
+		parser = tplg_section_parser(id);
 		if (parser == NULL) {
 			SNDERR("unknown section %s", id);
 			continue;
@@ -189,24 +364,28 @@ static int tplg_parse_config(snd_tplg_t *tplg, snd_config_t *cfg)
 	return 0;
 }
 
-static int tplg_load_config(snd_tplg_t *tplg, snd_input_t *in)
+static int tplg_load_top(snd_config_t **top, snd_input_t *in)
 {
-	snd_config_t *top;
 	int ret;
 
-	ret = snd_config_top(&top);
+	ret = snd_config_top(top);
 	if (ret < 0)
 		return ret;
 
-	ret = snd_config_load(top, in);
+	ret = snd_config_load(*top, in);
 	if (ret < 0) {
 		SNDERR("could not load configuration");
-		snd_config_delete(top);
+		snd_config_delete(*top);
 		return ret;
 	}
+	return 0;
+}
+
+static int tplg_parse_top(snd_tplg_t *tplg, snd_config_t *top)
+{
+	int ret;
 
 	ret = tplg_parse_config(tplg, top);
-	snd_config_delete(top);
 	if (ret < 0) {
 		SNDERR("failed to parse topology");
 		return ret;
@@ -215,6 +394,20 @@ static int tplg_load_config(snd_tplg_t *tplg, snd_input_t *in)
 	return 0;
 }
 
+static int tplg_load_config(snd_tplg_t *tplg, snd_input_t *in)
+{
+	snd_config_t *top;
+	int ret;
+
+	ret = tplg_load_top(&top, in);
+	if (ret < 0)
+		return ret;
+
+	ret = tplg_parse_top(tplg, top);
+	snd_config_delete(top);
+	return ret;
+}
+
 static int tplg_build_integ(snd_tplg_t *tplg)
 {
 	int err;
@@ -274,7 +467,7 @@ int snd_tplg_load(snd_tplg_t *tplg, const char *buf, size_t size)
 	return err;
 }
 
-static int tplg_build(snd_tplg_t *tplg)
+static int tplg_build(snd_tplg_t *tplg, const char *outfile)
 {
 	int err;
 
@@ -284,7 +477,7 @@ static int tplg_build(snd_tplg_t *tplg)
 		return err;
 	}
 
-	err = tplg_write_data(tplg);
+	err = tplg_write_data(tplg, outfile);
 	if (err < 0) {
 		SNDERR("failed to write data %d", err);
 		return err;
@@ -296,8 +489,10 @@ int snd_tplg_build_file(snd_tplg_t *tplg,
 			const char *infile,
 			const char *outfile)
 {
+	snd_config_t *top;
 	FILE *fp;
 	snd_input_t *in;
+	uint64_t key = 0;
 	int err;
 
 	fp = fopen(infile, "r");
@@ -313,12 +508,30 @@ int snd_tplg_build_file(snd_tplg_t *tplg,
 		return err;
 	}
 
-	err = tplg_load_config(tplg, in);
+	err = tplg_load_top(&top, in);
 	snd_input_close(in);
 	if (err < 0)
 		return err;
 
-	return snd_tplg_build(tplg, outfile);
+	if (tplg->cache_file) {
+		key = tplg_cache_key(tplg, top);
+		err = tplg_cache_restore(tplg, key, outfile);
+		if (err != -ENOENT) {
+			snd_config_delete(top);
+			return err;
+		}
+	}
+
+	err = tplg_parse_top(tplg, top);
+	snd_config_delete(top);
+	if (err < 0)
+		return err;
+
+	err = snd_tplg_build(tplg, outfile);
+	/* a failed cache update costs only the next build */
+	if (err >= 0 && tplg->cache_file)
+		tplg_cache_store(tplg, key, outfile);
+	return err;
 }
 
 int snd_tplg_add_object(snd_tplg_t *tplg, snd_tplg_obj_template_t *t)
@@ -350,30 +563,7 @@ int snd_tplg_add_object(snd_tplg_t *tplg, snd_tplg_obj_template_t *t)
 
 int snd_tplg_build(snd_tplg_t *tplg, const char *outfile)
 {
-	int fd, err;
-	ssize_t r;
-
-	err = tplg_build(tplg);
-	if (err < 0)
-		return err;
-
-	fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (fd < 0) {
-		SNDERR("failed to open %s err %d", outfile, -errno);
-		return -errno;
-	}
-	r = write(fd, tplg->bin, tplg->bin_size);
-	close(fd);
-	if (r < 0) {
-		err = -errno;
-		SNDERR("write error: %s", strerror(errno));
-		return err;
-	}
-	if ((size_t)r != tplg->bin_size) {
-		SNDERR("partial write (%zd != %zd)", r, tplg->bin_size);
-		return -EIO;
-	}
-	return 0;
+	return tplg_build(tplg, outfile);
 }
 
 int snd_tplg_build_bin(snd_tplg_t *tplg,
@@ -381,7 +571,7 @@ int snd_tplg_build_bin(snd_tplg_t *tplg,
 {
 	int err;
 
-	err = tplg_build(tplg);
+	err = tplg_build(tplg, NULL);
 	if (err < 0)
 		return err;
 
@@ -446,9 +636,23 @@ snd_tplg_t *snd_tplg_create(int flags)
 
 	tplg->verbose = !!(flags & SND_TPLG_CREATE_VERBOSE);
 	tplg->dapm_sort = (flags & SND_TPLG_CREATE_DAPM_NOSORT) == 0;
+#ifdef HAVE_LIBPTHREAD
+	if (flags & SND_TPLG_CREATE_PARALLEL) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (cpus > TPLG_PARSE_THREADS_MAX)
+			cpus = TPLG_PARSE_THREADS_MAX;
+		tplg->parse_threads = cpus > 1 ? cpus : 0;
+	}
+#endif
 
 	tplg->manifest.size = sizeof(struct snd_soc_tplg_manifest);
 
+	if (tplg_elem_hash_init(tplg) < 0) {
+		free(tplg);
+		return NULL;
+	}
+
 	INIT_LIST_HEAD(&tplg->tlv_list);
 	INIT_LIST_HEAD(&tplg->widget_list);
 	INIT_LIST_HEAD(&tplg->pcm_list);
@@ -500,6 +704,8 @@ void snd_tplg_free(snd_tplg_t *tplg)
 	tplg_elem_free_list(&tplg->tuple_list);
 	tplg_elem_free_list(&tplg->hw_cfg_list);
 
+	free(tplg->elem_hash);
+	free(tplg->cache_file);
 	free(tplg);
 }
 
@@ -82,7 +82,7 @@ static int tplg_build_stream_caps(snd_tplg_t *tplg,
 	unsigned int i;
 
 	for (i = 0; i < 2; i++) {
-		ref_elem = tplg_elem_lookup(&tplg->pcm_caps_list,
+		ref_elem = tplg_elem_lookup(tplg, &tplg->pcm_caps_list,
 			caps[i].name, SND_TPLG_TYPE_STREAM_CAPS, index);
 
 		if (ref_elem != NULL)
@@ -217,7 +217,7 @@ static int tplg_build_stream_cfg(snd_tplg_t *tplg,
 
 	for (i = 0; i < num_streams; i++) {
 		strm = stream + i;
-		ref_elem = tplg_elem_lookup(&tplg->pcm_config_list,
+		ref_elem = tplg_elem_lookup(tplg, &tplg->pcm_config_list,
 			strm->name, SND_TPLG_TYPE_STREAM_CONFIG, index);
 
 		if (ref_elem && ref_elem->stream_cfg)
@@ -247,7 +247,7 @@ static int build_link(snd_tplg_t *tplg, struct tplg_elem *elem)
 
 		switch (ref->type) {
 		case SND_TPLG_TYPE_HW_CONFIG:
-			ref->elem = tplg_elem_lookup(&tplg->hw_cfg_list,
+			ref->elem = tplg_elem_lookup(tplg, &tplg->hw_cfg_list,
 				ref->id, SND_TPLG_TYPE_HW_CONFIG, elem->index);
 			if (!ref->elem) {
 				SNDERR("cannot find HW config '%s'"
@@ -312,11 +312,11 @@ int tplg_build_links(snd_tplg_t *tplg, unsigned int type)
 
 static int split_format(struct snd_soc_tplg_stream_caps *caps, char *str)
 {
-	char *s = NULL;
+	char *s = NULL, *save;
 	snd_pcm_format_t format;
 	int i = 0;
 
-	s = strtok(str, ",");
+	s = strtok_r(str, ",", &save);
 	while ((s != NULL) && (i < SND_SOC_TPLG_MAX_FORMATS)) {
 		format = snd_pcm_format_value(s);
 		if (format == SND_PCM_FORMAT_UNKNOWN) {
@@ -325,7 +325,7 @@ static int split_format(struct snd_soc_tplg_stream_caps *caps, char *str)
 		}
 
 		caps->formats |= 1ull << format;
-		s = strtok(NULL, ", ");
+		s = strtok_r(NULL, ", ", &save);
 		i++;
 	}
 
@@ -354,11 +354,11 @@ static const char *get_rate_name(int rate)
 
 static int split_rate(struct snd_soc_tplg_stream_caps *caps, char *str)
 {
-	char *s = NULL;
+	char *s = NULL, *save;
 	snd_pcm_rates_t rate;
 	int i = 0;
 
-	s = strtok(str, ",");
+	s = strtok_r(str, ",", &save);
 	while (s) {
 		rate = get_rate_value(s);
 
@@ -368,7 +368,7 @@ static int split_rate(struct snd_soc_tplg_stream_caps *caps, char *str)
 		}
 
 		caps->rates |= 1 << rate;
-		s = strtok(NULL, ", ");
+		s = strtok_r(NULL, ", ", &save);
 		i++;
 	}
 
@@ -17,87 +17,203 @@
 
 #include "tplg_local.h"
 
-#define SAVE_ALLOC_SHIFT	(13)	/* 8192 bytes */
-#define PRINT_ALLOC_SHIFT	(10)	/* 1024 bytes */
+#define SAVE_ALLOC_MIN		(8192)
 #define PRINT_BUF_SIZE_MAX	(1024 * 1024)
-#define NEXT_CHUNK(val, shift)	((((val) >> (shift)) + 1) << (shift))
 
 void tplg_buf_init(struct tplg_buf *buf)
 {
 	buf->dst = NULL;
 	buf->dst_len = 0;
-	buf->printf_buf = NULL;
-	buf->printf_buf_size = 0;
+	buf->dst_size = 0;
 }
 
 void tplg_buf_free(struct tplg_buf *buf)
 {
 	free(buf->dst);
-	free(buf->printf_buf);
 }
 
 char *tplg_buf_detach(struct tplg_buf *buf)
 {
 	char *ret = buf->dst;
-	free(buf->printf_buf);
+
+	/* give back the slack of the doubling */
+	if (ret && buf->dst_size - buf->dst_len > SAVE_ALLOC_MIN) {
+		ret = realloc(buf->dst, buf->dst_len + 1);
+		if (ret == NULL)
+			ret = buf->dst;
+	}
 	return ret;
 }
 
+/* make room for size more characters and the terminator */
+int tplg_buf_reserve(struct tplg_buf *dst, size_t size)
+{
+	size_t t = dst->dst_len + size + 1;
+	char *s;
+
+	if (t <= dst->dst_size)
+		return 0;
+	/* double the buffer, a large output must not be copied too often */
+	if (t < dst->dst_size * 2)
+		t = dst->dst_size * 2;
+	if (t < SAVE_ALLOC_MIN)
+		t = SAVE_ALLOC_MIN;
+	s = realloc(dst->dst, t);
+	if (s == NULL)
+		return -ENOMEM;
+	dst->dst = s;
+	dst->dst_size = t;
+	return 0;
+}
+
+/* append the prefix and a string as is */
+int tplg_save_puts(struct tplg_buf *dst, const char *pfx, const char *str)
+{
+	size_t pl = pfx ? strlen(pfx) : 0;
+	size_t n = strlen(str);
+	int err;
+
+	err = tplg_buf_reserve(dst, pl + n);
+	if (err < 0)
+		return err;
+	if (pl > 0)
+		memcpy(dst->dst + dst->dst_len, pfx, pl);
+	memcpy(dst->dst + dst->dst_len + pl, str, n + 1);
+	dst->dst_len += pl + n;
+	return 0;
+}
+
+/* the formats made only of %s, %u, %d, %i and %% are expanded here */
+static int simple_format(const char *fmt)
+{
+	for (fmt = strchr(fmt, '%'); fmt; fmt = strchr(fmt + 2, '%')) {
+		switch (fmt[1]) {
+		case 's':
+		case 'u':
+		case 'd':
+		case 'i':
+		case '%':
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static char *format_uint(char *end, unsigned int val)
+{
+	do {
+		*--end = '0' + val % 10;
+		val /= 10;
+	} while (val);
+	return end;
+}
+
+/*
+ * almost all lines of the saved text are such formats, appending the
+ * pieces directly is several times faster than vsnprintf()
+ */
+static int save_simple(struct tplg_buf *dst, const char *fmt, va_list va)
+{
+	char num[12], *p, *end = num + sizeof(num);
+	const char *s;
+	size_t n;
+	int err, v;
+
+	while (*fmt) {
+		s = strchr(fmt, '%');
+		n = s ? (size_t)(s - fmt) : strlen(fmt);
+		if (n > 0) {
+			err = tplg_buf_reserve(dst, n);
+			if (err < 0)
+				return err;
+			memcpy(dst->dst + dst->dst_len, fmt, n);
+			dst->dst_len += n;
+		}
+		if (s == NULL)
+			break;
+		switch (s[1]) {
+		case 's':
+			p = va_arg(va, char *);
+			n = strlen(p);
+			break;
+		case 'u':
+			p = format_uint(end, va_arg(va, unsigned int));
+			n = end - p;
+			break;
+		case 'd':
+		case 'i':
+			v = va_arg(va, int);
+			p = format_uint(end, v < 0 ? -(unsigned int)v : (unsigned int)v);
+			if (v < 0)
+				*--p = '-';
+			n = end - p;
+			break;
+		default:
+			p = "%";
+			n = 1;
+			break;
+		}
+		err = tplg_buf_reserve(dst, n);
+		if (err < 0)
+			return err;
+		memcpy(dst->dst + dst->dst_len, p, n);
+		dst->dst_len += n;
+		fmt = s + 2;
+	}
+	if (dst->dst)
+		dst->dst[dst->dst_len] = '\0';
+	return 0;
+}
+
 int tplg_save_printf(struct tplg_buf *dst, const char *pfx, const char *fmt, ...)
 {
 	va_list va;
-	char *s;
-	size_t n, l, t, pl;
-	int ret = 0;
+	size_t n, l, pl;
+	int err;
+
+	pl = pfx ? strlen(pfx) : 0;
+	if (simple_format(fmt)) {
+		err = tplg_save_puts(dst, pfx, "");
+		if (err < 0)
+			return err;
+		va_start(va, fmt);
+		err = save_simple(dst, fmt, va);
+		va_end(va);
+		return err;
+	}
 
-	if (pfx == NULL)
-		pfx = "";
+	/* print straight into the free space */
+	err = tplg_buf_reserve(dst, pl + 128);
+	if (err < 0)
+		return err;
 
+	l = dst->dst_len + pl;
 	va_start(va, fmt);
-	n = vsnprintf(dst->printf_buf, dst->printf_buf_size, fmt, va);
+	n = vsnprintf(dst->dst + l, dst->dst_size - l, fmt, va);
 	va_end(va);
 
 	if (n >= PRINT_BUF_SIZE_MAX) {
-		ret = -EOVERFLOW;
-		goto end;
+		dst->dst[dst->dst_len] = '\0';
+		return -EOVERFLOW;
 	}
 
-	if (n >= dst->printf_buf_size) {
-		t = NEXT_CHUNK(n + 1, PRINT_ALLOC_SHIFT);
-		s = realloc(dst->printf_buf, t);
-		if (!s) {
-			ret = -ENOMEM;
-			goto end;
+	if (n >= dst->dst_size - l) {
+		err = tplg_buf_reserve(dst, pl + n);
+		if (err < 0) {
+			dst->dst[dst->dst_len] = '\0';
+			return err;
 		}
-		dst->printf_buf = s;
-		dst->printf_buf_size = t;
 		va_start(va, fmt);
-		n = vsnprintf(dst->printf_buf, n + 1, fmt, va);
+		vsnprintf(dst->dst + l, n + 1, fmt, va);
 		va_end(va);
 	}
 
-	pl = strlen(pfx);
-	l = dst->dst_len;
-	t = l + pl + n + 1;
-	/* allocate chunks */
-	if (dst->dst == NULL ||
-	    (l >> SAVE_ALLOC_SHIFT) != (t >> SAVE_ALLOC_SHIFT)) {
-		s = realloc(dst->dst, NEXT_CHUNK(t, SAVE_ALLOC_SHIFT));
-		if (s == NULL) {
-			ret = -ENOMEM;
-			goto end;
-		}
-	} else {
-		s = dst->dst;
-	}
-
 	if (pl > 0)
-		strcpy(s + l, pfx);
-	strcpy(s + l + pl, dst->printf_buf);
-	dst->dst = s;
-	dst->dst_len = t - 1;
-end:
-	return ret;
+		memcpy(dst->dst + dst->dst_len, pfx, pl);
+	dst->dst_len = l + n;
+	return 0;
 }
 
 int tplg_nice_value_format(char *dst, size_t dst_size, unsigned int value)
@@ -111,11 +227,11 @@ int tplg_nice_value_format(char *dst, size_t dst_size, unsigned int value)
 	return snprintf(dst, dst_size, "%u", value);
 }
 
-static int tplg_pprint_integer(snd_config_t *n, char **ret)
+/* format an integer into buf, 0 when it needs the generic ascii form */
+static int tplg_pprint_integer(snd_config_t *n, char *buf, size_t size)
 {
 	long lval;
 	int err, type;
-	char buf[16];
 
 	type = snd_config_get_type(n);
 	if (type == SND_CONFIG_TYPE_INTEGER) {
@@ -123,25 +239,19 @@ static int tplg_pprint_integer(snd_config_t *n, char **ret)
 		if (err < 0)
 			return err;
 		if (lval < INT_MIN || lval > UINT_MAX)
-			return snd_config_get_ascii(n, ret);
+			return 0;
 	} else if (type == SND_CONFIG_TYPE_INTEGER64) {
 		long long llval;
 		err = snd_config_get_integer64(n, &llval);
 		if (err < 0)
 			return err;
 		if (llval < INT_MIN || llval > UINT_MAX)
-			return snd_config_get_ascii(n, ret);
+			return 0;
 		lval = llval;
 	} else {
 		lval = 0;
 	}
-	err = tplg_nice_value_format(buf, sizeof(buf), (unsigned int)lval);
-	if (err < 0)
-		return err;
-	*ret = strdup(buf);
-	if (*ret == NULL)
-		return -ENOMEM;
-	return 0;
+	return tplg_nice_value_format(buf, size, (unsigned int)lval);
 }
 
 static int _compar(const void *a, const void *b)
@@ -232,7 +342,8 @@ static int tplg_save_quoted(struct tplg_buf *dst, const char *str)
 	unsigned char *p, *d, *t;
 	int c;
 
-	d = t = alloca(strlen(str) * 5 + 1 + 1);
+	d = t = alloca(strlen(str) * 5 + 2 + 1);
+	*t++ = '\'';
 	for (p = (unsigned char *)str; *p != '\0'; p++) {
 		c = *p;
 		switch (c) {
@@ -276,8 +387,9 @@ static int tplg_save_quoted(struct tplg_buf *dst, const char *str)
 			break;
 		}
 	}
+	*t++ = '\'';
 	*t = '\0';
-	return tplg_save_printf(dst, NULL, "'%s'", d);
+	return tplg_save_puts(dst, NULL, (char *)d);
 }
 
 static int tplg_save_string(struct tplg_buf *dst, const char *str, int id)
@@ -285,7 +397,7 @@ static int tplg_save_string(struct tplg_buf *dst, const char *str, int id)
 	const unsigned char *p = (const unsigned char *)str;
 
 	if (!p || !*p)
-		return tplg_save_printf(dst, NULL, "''");
+		return tplg_save_puts(dst, NULL, "''");
 
 	if (!id && ((*p >= '0' && *p <= '9') || *p == '-'))
 		return tplg_save_quoted(dst, str);
@@ -293,7 +405,7 @@ static int tplg_save_string(struct tplg_buf *dst, const char *str, int id)
 	if (tplg_check_quoted(p))
 		return tplg_save_quoted(dst, str);
 
-	return tplg_save_printf(dst, NULL, "%s", str);
+	return tplg_save_puts(dst, NULL, str);
 }
 
 static int save_config(struct tplg_buf *dst, int level, const char *delim, snd_config_t *src)
@@ -310,32 +422,45 @@ static int save_config(struct tplg_buf *dst, int level, const char *delim, snd_c
 
 	type = snd_config_get_type(src);
 	if (type != SND_CONFIG_TYPE_COMPOUND) {
-		char *val;
+		char num[16], *val = NULL;
+		const char *str = NULL;
+
+		/* the values are formatted without a heap copy when possible */
 		if (type == SND_CONFIG_TYPE_INTEGER ||
 		    type == SND_CONFIG_TYPE_INTEGER64) {
-			err = tplg_pprint_integer(src, &val);
+			err = tplg_pprint_integer(src, num, sizeof(num));
+			if (err > 0)
+				str = num;
+		} else if (type == SND_CONFIG_TYPE_STRING) {
+			err = snd_config_get_string(src, &str);
+			if (err >= 0 && str == NULL)
+				err = -EINVAL;
 		} else {
+			err = 0;
+		}
+		if (err >= 0 && str == NULL) {
 			err = snd_config_get_ascii(src, &val);
+			str = val;
 		}
 		if (err < 0)
 			return err;
 		if (type == SND_CONFIG_TYPE_STRING) {
 			/* hexa array pretty print */
-			id = strchr(val, '\n');
+			id = strchr(str, '\n');
 			if (id) {
-				err = tplg_save_printf(dst, NULL, "\n");
+				err = tplg_save_puts(dst, NULL, "\n");
 				if (err < 0)
 					goto retval;
 				for (id++; *id == '\t'; id++) {
-					err = tplg_save_printf(dst, NULL, "\t");
+					err = tplg_save_puts(dst, NULL, "\t");
 					if (err < 0)
 						goto retval;
 				}
 				delim = "";
 			}
-			err = tplg_save_printf(dst, NULL, "%s'%s'\n", delim, val);
+			err = tplg_save_printf(dst, NULL, "%s'%s'\n", delim, str);
 		} else {
-			err = tplg_save_printf(dst, NULL, "%s%s\n", delim, val);
+			err = tplg_save_printf(dst, NULL, "%s%s\n", delim, str);
 		}
 retval:
 		free(val);
@@ -361,7 +486,7 @@ retval:
 	if (count == 1) {
 		err = snd_config_get_id(s, &id);
 		if (err >= 0 && level > 0)
-			err = tplg_save_printf(dst, NULL, ".");
+			err = tplg_save_puts(dst, NULL, ".");
 		if (err >= 0)
 			err = tplg_save_string(dst, id, 1);
 		if (err >= 0)
@@ -386,7 +511,7 @@ retval:
 		err = snd_config_get_id(s, &id);
 		if (err < 0)
 			return err;
-		err = tplg_save_printf(dst, pfx, "");
+		err = tplg_save_puts(dst, pfx, "");
 		if (err < 0)
 			return err;
 		if (array <= 0) {
@@ -471,7 +596,7 @@ static int tplg_save(snd_tplg_t *tplg, struct tplg_buf *dst,
 			if (gindex >= 0 && elem->index != gindex)
 				continue;
 			if (count > 1) {
-				err = tplg_save_printf(dst, pfx2, "");
+				err = tplg_save_puts(dst, pfx2, "");
 				if (err < 0)
 					goto _err;
 			}
@@ -632,8 +757,11 @@ int snd_tplg_save(snd_tplg_t *tplg, char **dst, int flags)
 		top = top2;
 	}
 
+	/* the checked text has about the size of the first one */
 	tplg_buf_init(&buf2);
-	err = save_config(&buf2, 0, NULL, top);
+	err = tplg_buf_reserve(&buf2, buf.dst_len);
+	if (err >= 0)
+		err = save_config(&buf2, 0, NULL, top);
 	snd_config_delete(top);
 	if (err < 0) {
 		SNDERR("could not save configuration");
@@ -100,6 +100,16 @@ struct snd_tplg {
 	struct list_head mixer_list;
 	struct list_head enum_list;
 	struct list_head bytes_ext_list;
+
+	/* elements of all lists hashed by list and id */
+	struct tplg_elem **elem_hash;
+	unsigned int elem_hash_size;	/* power of two */
+	unsigned int elem_hash_count;	/* inserted, not decreased on free */
+	unsigned int elem_seq;
+
+	unsigned int parse_threads;	/* text parser workers, 0 = serial */
+
+	char *cache_file;	/* build cache of snd_tplg_build_file() */
 };
 
 /* object text references */
@@ -194,6 +204,12 @@ struct tplg_elem {
 	struct list_head ref_list;
 	struct list_head list; /* list of all elements with same type */
 
+	/* chain in the id hash of the topology, see tplg_elem_lookup() */
+	struct tplg_elem *hash_next, **hash_pprev;
+	struct list_head *hash_list;	/* list the element was inserted to */
+	unsigned int hash;
+	unsigned int seq;		/* creation order */
+
 	void (*free)(void *obj);
 };
 
@@ -206,8 +222,7 @@ struct map_elem {
 struct tplg_buf {
 	char *dst;
 	size_t dst_len;
-	char *printf_buf;
-	size_t printf_buf_size;
+	size_t dst_size;	/* allocated bytes */
 };
 
 /* mapping table */
@@ -270,7 +285,7 @@ int tplg_parse_compound(snd_tplg_t *tplg, snd_config_t *cfg,
 	int (*fcn)(snd_tplg_t *, snd_config_t *, void *),
 	void *private);
 
-int tplg_write_data(snd_tplg_t *tplg);
+int tplg_write_data(snd_tplg_t *tplg, const char *outfile);
 
 int tplg_parse_tlv(snd_tplg_t *tplg, snd_config_t *cfg, void *priv);
 int tplg_parse_text(snd_tplg_t *tplg, snd_config_t *cfg, void *priv);
@@ -313,7 +328,14 @@ struct tplg_elem *tplg_elem_new(void);
 void tplg_elem_free(struct tplg_elem *elem);
 void tplg_elem_free_list(struct list_head *base);
 void tplg_elem_insert(struct tplg_elem *elem_p, struct list_head *list);
-struct tplg_elem *tplg_elem_lookup(struct list_head *base,
+void tplg_elem_merge(snd_tplg_t *tplg, snd_tplg_t *src);
+
+uint64_t tplg_cache_key(snd_tplg_t *tplg, snd_config_t *cfg);
+int tplg_cache_restore(snd_tplg_t *tplg, uint64_t key, const char *outfile);
+int tplg_cache_store(snd_tplg_t *tplg, uint64_t key, const char *outfile);
+int tplg_elem_hash_init(snd_tplg_t *tplg);
+struct tplg_elem *tplg_elem_lookup(snd_tplg_t *tplg,
+				struct list_head *base,
 				const char* id,
 				unsigned int type,
 				int index);
@@ -364,7 +386,9 @@ int tplg_add_dai_object(snd_tplg_t *tplg, snd_tplg_obj_template_t *t);
 
 int tplg_nice_value_format(char *dst, size_t dst_size, unsigned int value);
 
+int tplg_buf_reserve(struct tplg_buf *dst, size_t size);
 int tplg_save_printf(struct tplg_buf *dst, const char *prefix, const char *fmt, ...);
+int tplg_save_puts(struct tplg_buf *dst, const char *prefix, const char *str);
 int tplg_save_refs(snd_tplg_t *tplg, struct tplg_elem *elem, unsigned int type,
 		   const char *id, struct tplg_buf *dst, const char *pfx);
 int tplg_save_channels(snd_tplg_t *tplg, struct snd_soc_tplg_channel *channel,
@@ -0,0 +1,276 @@
+/*
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of
+  the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+*/
+
+#include "tplg_local.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Read-only iteration over a binary topology. Unlike snd_tplg_decode(),
+ * nothing is copied or allocated per element: the blocks and elements
+ * are handed out as pointers into the (mapped) binary.
+ */
+
+struct snd_tplg_view {
+	const void *bin;
+	size_t size;
+	size_t map_size;	/* non-zero when bin is our mapping */
+	size_t pos;		/* offset of the next block header */
+	const void *elem;	/* next element of the current block */
+	size_t elem_left;	/* bytes left in the current block */
+	unsigned int type;	/* type of the current block */
+};
+
+int snd_tplg_view_open_buffer(snd_tplg_view_t **view, const void *bin, size_t size)
+{
+	snd_tplg_view_t *v;
+
+	if (view == NULL || (bin == NULL && size > 0))
+		return -EINVAL;
+	v = calloc(1, sizeof(*v));
+	if (v == NULL)
+		return -ENOMEM;
+	v->bin = bin;
+	v->size = size;
+	*view = v;
+	return 0;
+}
+
+int snd_tplg_view_open(snd_tplg_view_t **view, const char *file)
+{
+	struct stat st;
+	void *map;
+	int fd, err;
+
+	if (view == NULL || file == NULL)
+		return -EINVAL;
+	fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err = -errno;
+		SNDERR("failed to open %s: %s", file, strerror(-err));
+		return err;
+	}
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		SNDERR("empty topology file %s", file);
+		return -EINVAL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	err = map == MAP_FAILED ? -errno : 0;
+	close(fd);
+	if (err < 0) {
+		SNDERR("failed to map %s: %s", file, strerror(-err));
+		return err;
+	}
+	err = snd_tplg_view_open_buffer(view, map, st.st_size);
+	if (err < 0) {
+		munmap(map, st.st_size);
+		return err;
+	}
+	(*view)->map_size = st.st_size;
+	return 0;
+}
+
+int snd_tplg_view_close(snd_tplg_view_t *view)
+{
+	int err = 0;
+
+	if (view == NULL)
+		return -EINVAL;
+	if (view->map_size && munmap((void *)view->bin, view->map_size) < 0)
+		err = -errno;
+	free(view);
+	return err;
+}
+
+void snd_tplg_view_rewind(snd_tplg_view_t *view)
+{
+	view->pos = 0;
+	view->elem = NULL;
+	view->elem_left = 0;
+}
+
+int snd_tplg_view_next_block(snd_tplg_view_t *view, snd_tplg_view_block_t *block)
+{
+	const struct snd_soc_tplg_hdr *hdr;
+	size_t pos = view->pos;
+
+	view->elem = NULL;
+	view->elem_left = 0;
+	if (pos == view->size)
+		return 0;
+	if (view->size - pos < sizeof(*hdr)) {
+		SNDERR("incomplete header data at %zd", pos);
+		return -EINVAL;
+	}
+	hdr = view->bin + pos;
+	if (hdr->magic != SND_SOC_TPLG_MAGIC) {
+		SNDERR("bad block magic %08x", hdr->magic);
+		return -EINVAL;
+	}
+	if (hdr->abi != SND_SOC_TPLG_ABI_VERSION) {
+		SNDERR("unsupported ABI version %d", hdr->abi);
+		return -EINVAL;
+	}
+	if (hdr->size != sizeof(*hdr)) {
+		SNDERR("header size mismatch");
+		return -EINVAL;
+	}
+	if (view->size - pos - sizeof(*hdr) < hdr->payload_size) {
+		SNDERR("incomplete payload data at %zd", pos);
+		return -EINVAL;
+	}
+	if (hdr->payload_size < 8) {
+		SNDERR("wrong payload size %d", hdr->payload_size);
+		return -EINVAL;
+	}
+	/* first block must be manifest */
+	if (pos == 0 && hdr->type != SND_SOC_TPLG_TYPE_MANIFEST) {
+		SNDERR("first block must be manifest (value %d)", hdr->type);
+		return -EINVAL;
+	}
+
+	block->type = hdr->type;
+	block->vendor_type = hdr->vendor_type;
+	block->version = hdr->version;
+	block->index = hdr->index;
+	block->count = hdr->count;
+	block->offset = pos;
+	block->payload = view->bin + pos + sizeof(*hdr);
+	block->payload_size = hdr->payload_size;
+
+	view->type = hdr->type;
+	view->elem = block->payload;
+	view->elem_left = block->payload_size;
+	view->pos = pos + sizeof(*hdr) + hdr->payload_size;
+	return 1;
+}
+
+/* size of an element made of a fixed structure and its private data */
+static int view_priv_size(const void *elem, size_t left, size_t fixed,
+			  size_t size_offset, size_t priv_offset, size_t *size)
+{
+	const struct snd_soc_tplg_private *p = elem + priv_offset;
+
+	if (left < fixed || *(const __le32 *)(elem + size_offset) != fixed)
+		return -EINVAL;
+	*size = fixed + p->size;
+	return 0;
+}
+
+#define VIEW_PRIV_SIZE(type, elem, left, esize) \
+	view_priv_size(elem, left, sizeof(type), offsetof(type, size), \
+		       offsetof(type, priv), esize)
+
+/* size of a control (mixer, enum or bytes) including its private data */
+static int view_ctl_size(const void *elem, size_t left, unsigned int type,
+			 size_t *size)
+{
+	switch (type) {
+	case SND_SOC_TPLG_TYPE_MIXER:
+		return VIEW_PRIV_SIZE(struct snd_soc_tplg_mixer_control, elem, left, size);
+	case SND_SOC_TPLG_TYPE_ENUM:
+		return VIEW_PRIV_SIZE(struct snd_soc_tplg_enum_control, elem, left, size);
+	case SND_SOC_TPLG_TYPE_BYTES:
+		return VIEW_PRIV_SIZE(struct snd_soc_tplg_bytes_control, elem, left, size);
+	}
+	SNDERR("wrong control type %d", type);
+	return -EINVAL;
+}
+
+/* size of a widget including its private data and kcontrols */
+static int view_widget_size(const void *elem, size_t left, size_t *size)
+{
+	const struct snd_soc_tplg_dapm_widget *w = elem;
+	const struct snd_soc_tplg_ctl_hdr *chdr;
+	size_t esize, csize;
+	unsigned int i;
+	int err;
+
+	err = VIEW_PRIV_SIZE(struct snd_soc_tplg_dapm_widget, elem, left, &esize);
+	if (err < 0)
+		return err;
+	for (i = 0; i < w->num_kcontrols; i++) {
+		if (esize > left || left - esize < sizeof(*chdr))
+			return -EINVAL;
+		chdr = elem + esize;
+		err = view_ctl_size(chdr, left - esize, chdr->type, &csize);
+		if (err < 0)
+			return err;
+		esize += csize;
+	}
+	*size = esize;
+	return 0;
+}
+
+int snd_tplg_view_next_elem(snd_tplg_view_t *view, const void **elem, size_t *size)
+{
+	const void *e = view->elem;
+	size_t left = view->elem_left, esize = 0;
+	int err;
+
+	if (e == NULL || left == 0)
+		return 0;
+
+	switch (view->type) {
+	case SND_SOC_TPLG_TYPE_MIXER:
+	case SND_SOC_TPLG_TYPE_ENUM:
+	case SND_SOC_TPLG_TYPE_BYTES:
+		err = view_ctl_size(e, left, view->type, &esize);
+		break;
+	case SND_SOC_TPLG_TYPE_DAPM_WIDGET:
+		err = view_widget_size(e, left, &esize);
+		break;
+	case SND_SOC_TPLG_TYPE_DAPM_GRAPH:
+		esize = sizeof(struct snd_soc_tplg_dapm_graph_elem);
+		err = 0;
+		break;
+	case SND_SOC_TPLG_TYPE_PCM:
+		err = VIEW_PRIV_SIZE(struct snd_soc_tplg_pcm, e, left, &esize);
+		break;
+	case SND_SOC_TPLG_TYPE_DAI:
+		err = VIEW_PRIV_SIZE(struct snd_soc_tplg_dai, e, left, &esize);
+		break;
+	case SND_SOC_TPLG_TYPE_DAI_LINK:
+	case SND_SOC_TPLG_TYPE_BACKEND_LINK:
+	case SND_SOC_TPLG_TYPE_CODEC_LINK:
+		err = VIEW_PRIV_SIZE(struct snd_soc_tplg_link_config, e, left, &esize);
+		break;
+	case SND_SOC_TPLG_TYPE_MANIFEST:
+		err = VIEW_PRIV_SIZE(struct snd_soc_tplg_manifest, e, left, &esize);
+		break;
+	default:
+		/* private data and vendor blocks are a single element */
+		esize = left;
+		err = 0;
+		break;
+	}
+	if (err == 0 && esize > left)
+		err = -EINVAL;
+	if (err < 0) {
+		SNDERR("corrupted element of block type %d at %zd",
+		       view->type, (size_t)(e - view->bin));
+		view->elem_left = 0;
+		return err;
+	}
+
+	*elem = e;
+	*size = esize;
+	view->elem = e + esize;
+	view->elem_left = left - esize;
+	return 1;
+}
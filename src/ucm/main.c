@@ -516,7 +516,302 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 	return err;
 }
 
-static int execute_sysw(const char *sysw)
+/*
+ * A plain cset parsed at its first execution. The element info is kept
+ * for the ctl it was read from, and when the value does not depend on the
+ * current one (a single value for all channels, not toggle), the parsed
+ * value too, so that a later execution is a single write.
+ */
+struct ucm_cset {
+	snd_ctl_t *ctl;
+	unsigned int ctl_generation;
+	snd_ctl_elem_id_t id;
+	const char *cset;
+	const char *value;		/* in the cset string */
+	snd_ctl_elem_info_t info;
+	snd_ctl_elem_value_t data;
+	int complete;			/* data holds the value to write */
+};
+
+static int cset_value_complete(struct ucm_cset *c)
+{
+	switch (c->info.type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+	case SND_CTL_ELEM_TYPE_INTEGER:
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		break;
+	default:
+		return 0;
+	}
+	/* snd_ctl_ascii_value_parse() replicates a single value */
+	return c->info.count <= 64 && strchr(c->value, ',') == NULL &&
+	       strcasestr(c->value, "toggle") == NULL;
+}
+
+static int cset_cache_update(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+			     struct ucm_cset *c)
+{
+	int err;
+
+	c->ctl = NULL;
+	memset(&c->info, 0, sizeof(c->info));
+	snd_ctl_elem_info_set_id(&c->info, &c->id);
+	err = snd_ctl_elem_info(ctl, &c->info);
+	if (err < 0)
+		return err;
+	c->complete = cset_value_complete(c);
+	if (c->complete) {
+		memset(&c->data, 0, sizeof(c->data));
+		err = snd_ctl_ascii_value_parse(ctl, &c->data, &c->info, c->value);
+		if (err < 0)
+			return err;
+	}
+	c->ctl = ctl;
+	c->ctl_generation = uc_mgr->ctl_generation;
+	return 0;
+}
+
+static int cset_write(snd_ctl_t *ctl, struct ucm_cset *c)
+{
+	snd_ctl_elem_value_t *value;
+	int err;
+
+	if (c->complete)
+		return snd_ctl_elem_write(ctl, &c->data);
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_value_set_id(value, &c->id);
+	err = snd_ctl_elem_read(ctl, value);
+	if (err < 0)
+		return err;
+	err = snd_ctl_ascii_value_parse(ctl, value, &c->info, c->value);
+	if (err < 0)
+		return err;
+	return snd_ctl_elem_write(ctl, value);
+}
+
+/* write, look the element up again when it was replaced by someone else */
+static int cset_write_retry(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+			    struct ucm_cset *c)
+{
+	int err;
+
+	err = cset_write(ctl, c);
+	if (err == -ENOENT || err == -EINVAL) {
+		err = cset_cache_update(uc_mgr, ctl, c);
+		if (err >= 0)
+			err = cset_write(ctl, c);
+	}
+	return err;
+}
+
+/*
+ * The csets of a verb switch are deferred while the order of the writes
+ * does not matter.  A later cset of the same element replaces the pending
+ * one, so e.g. a switch turned off by the old verb and on by the new one
+ * is not written at all when it is on already.
+ */
+struct ucm_cset_pending {
+	struct list_head list;
+	struct list_head hash_list;
+	snd_ctl_t *ctl;
+	struct ucm_cset *cset;
+};
+
+static bool cset_same_elem(struct ucm_cset *c1, struct ucm_cset *c2)
+{
+	const snd_ctl_elem_id_t *id1 = &c1->info.id, *id2 = &c2->info.id;
+
+	/* not every plugin reports the numid */
+	if (id1->numid && id2->numid)
+		return id1->numid == id2->numid;
+	return snd_ctl_elem_id_compare_set(id1, id2) == 0;
+}
+
+static unsigned int cset_elem_hash(struct ucm_cset *c)
+{
+	const snd_ctl_elem_id_t *id = &c->info.id;
+	const unsigned char *name = id->name;
+	unsigned int h = id->index;
+
+	if (*name == '\0')
+		return id->numid % UCM_CSET_HASH;
+	while (*name)
+		h = h * 31 + *name++;
+	return h % UCM_CSET_HASH;
+}
+
+static int cset_defer(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+		      struct ucm_cset *c)
+{
+	struct list_head *pos, *bucket;
+	struct ucm_cset_pending *p;
+
+	bucket = &uc_mgr->cset_hash[cset_elem_hash(c)];
+	list_for_each(pos, bucket) {
+		p = list_entry(pos, struct ucm_cset_pending, hash_list);
+		if (p->ctl == ctl && cset_same_elem(p->cset, c)) {
+			/* the last write of the element keeps its place */
+			list_del(&p->list);
+			goto __add;
+		}
+	}
+	p = malloc(sizeof(*p));
+	if (p == NULL)
+		return -ENOMEM;
+	p->ctl = ctl;
+	list_add_tail(&p->hash_list, bucket);
+      __add:
+	p->cset = c;
+	list_add_tail(&p->list, &uc_mgr->cset_pending);
+	return 0;
+}
+
+/* the element holds the value of the cset already */
+static int cset_unchanged(snd_ctl_t *ctl, struct ucm_cset *c)
+{
+	snd_ctl_elem_value_t value;
+	unsigned int count = c->info.count;
+	size_t size;
+
+	memset(&value, 0, sizeof(value));
+	value.id = c->data.id;
+	if (snd_ctl_elem_read(ctl, &value) < 0)
+		return 0;
+	switch (c->info.type) {
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		size = count * sizeof(value.value.integer64.value[0]);
+		break;
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		size = count * sizeof(value.value.enumerated.item[0]);
+		break;
+	default:
+		size = count * sizeof(value.value.integer.value[0]);
+		break;
+	}
+	return memcmp(&value.value, &c->data.value, size) == 0;
+}
+
+/* write the deferred csets which change anything, in their order */
+static int cset_flush(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct ucm_cset_pending *p;
+	int err, ret = 0;
+
+	list_for_each_safe(pos, npos, &uc_mgr->cset_pending) {
+		p = list_entry(pos, struct ucm_cset_pending, list);
+		if (ret >= 0 && !cset_unchanged(p->ctl, p->cset)) {
+			err = cset_write_retry(uc_mgr, p->ctl, p->cset);
+			if (err < 0) {
+				uc_error("unable to execute cset '%s'", p->cset->cset);
+				ret = err;
+			}
+		}
+		list_del(&p->list);
+		list_del(&p->hash_list);
+		free(p);
+	}
+	return ret;
+}
+
+static int execute_cset_cached(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+			       struct sequence_element *s)
+{
+	struct ucm_cset *c = s->cset_cache;
+	const char *pos;
+	int err;
+
+	if (c == NULL) {
+		c = calloc(1, sizeof(*c));
+		if (c == NULL)
+			return -ENOMEM;
+		err = __snd_ctl_ascii_elem_id_parse(&c->id, s->data.cset, &pos);
+		if (err < 0) {
+			free(c);
+			return err;
+		}
+		while (*pos && isspace(*pos))
+			pos++;
+		if (!*pos) {
+			uc_error("undefined value for cset >%s<", s->data.cset);
+			free(c);
+			return -EINVAL;
+		}
+		c->cset = s->data.cset;
+		c->value = pos;
+		s->cset_cache = c;
+	}
+	if (c->ctl != ctl || c->ctl_generation != uc_mgr->ctl_generation) {
+		err = cset_cache_update(uc_mgr, ctl, c);
+		if (err < 0)
+			return err;
+	}
+	if (uc_mgr->cset_defer) {
+		if (c->complete)
+			return cset_defer(uc_mgr, ctl, c);
+		/* the value depends on the current one */
+		err = cset_flush(uc_mgr);
+		if (err < 0)
+			return err;
+	}
+	return cset_write_retry(uc_mgr, ctl, c);
+}
+
+/*
+ * The sysfs files written by a sequence stay open until the outermost
+ * sequence returns, so that a knob poked several times by a verb switch
+ * is opened once.  The exec and shell commands may change the sysfs
+ * tree, the files are opened again after them.
+ */
+static void sysw_close_all(snd_use_case_mgr_t *uc_mgr)
+{
+	unsigned int i;
+
+	for (i = 0; i < uc_mgr->sysw_count; i++) {
+		close(uc_mgr->sysw_fds[i].fd);
+		free(uc_mgr->sysw_fds[i].path);
+	}
+	free(uc_mgr->sysw_fds);
+	uc_mgr->sysw_fds = NULL;
+	uc_mgr->sysw_count = 0;
+	uc_mgr->sysw_size = 0;
+}
+
+static int sysw_open(snd_use_case_mgr_t *uc_mgr, const char *path)
+{
+	struct ucm_sysw_fd *f;
+	unsigned int i;
+	char *s;
+	int fd;
+
+	for (i = 0; i < uc_mgr->sysw_count; i++)
+		if (strcmp(uc_mgr->sysw_fds[i].path, path) == 0)
+			return uc_mgr->sysw_fds[i].fd;
+	fd = open(path, O_WRONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (uc_mgr->sysw_count == uc_mgr->sysw_size) {
+		f = realloc(uc_mgr->sysw_fds, (uc_mgr->sysw_size + 8) * sizeof(*f));
+		if (f == NULL)
+			goto __nocache;
+		uc_mgr->sysw_fds = f;
+		uc_mgr->sysw_size += 8;
+	}
+	s = strdup(path);
+	if (s == NULL)
+		goto __nocache;
+	f = &uc_mgr->sysw_fds[uc_mgr->sysw_count++];
+	f->path = s;
+	f->fd = fd;
+	return fd;
+
+__nocache:
+	close(fd);
+	return -ENOMEM;
+}
+
+static int execute_sysw(snd_use_case_mgr_t *uc_mgr, const char *sysw)
 {
 	char path[PATH_MAX];
 	const char *e;
@@ -561,7 +856,11 @@ static int execute_sysw(const char *sysw)
 	}
 	snprintf(path, sizeof(path), "%s/%s", e, s);
 
-	fd = open(path, O_WRONLY|O_CLOEXEC);
+	fd = sysw_open(uc_mgr, path);
+	if (fd == -ENOMEM) {
+		free(s);
+		return fd;
+	}
 	if (fd < 0) {
 		free(s);
 		if (ignore_error)
@@ -569,9 +868,9 @@ static int execute_sysw(const char *sysw)
 		uc_error("unable to open '%s' for write", path);
 		return -EINVAL;
 	}
-	wlen = write(fd, value, len);
+	/* each write stores the whole value again, from the start */
+	wlen = pwrite(fd, value, len, 0);
 	myerrno = errno;
-	close(fd);
 
 	if (ignore_error)
 		goto __end;
@@ -721,6 +1020,27 @@ static int run_device_all_sequence(snd_use_case_mgr_t *uc_mgr, struct use_case_v
 	return 0;
 }
 
+/*
+ * The element must see (or be seen after) the writes of the preceding
+ * csets, e.g. an exec probing the hardware or a sleep after a mute.
+ */
+static bool sequence_element_ordered(unsigned int type)
+{
+	switch (type) {
+	case SEQUENCE_ELEMENT_TYPE_CSET_BIN_FILE:
+	case SEQUENCE_ELEMENT_TYPE_CSET_TLV:
+	case SEQUENCE_ELEMENT_TYPE_CSET_NEW:
+	case SEQUENCE_ELEMENT_TYPE_CTL_REMOVE:
+	case SEQUENCE_ELEMENT_TYPE_SYSSET:
+	case SEQUENCE_ELEMENT_TYPE_SLEEP:
+	case SEQUENCE_ELEMENT_TYPE_EXEC:
+	case SEQUENCE_ELEMENT_TYPE_SHELL:
+	case SEQUENCE_ELEMENT_TYPE_CFGSAVE:
+		return true;
+	}
+	return false;
+}
+
 /**
  * \brief Execute the sequence
  * \param uc_mgr Use case manager
@@ -739,7 +1059,8 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 	char *cdev = NULL;
 	snd_ctl_t *ctl = NULL;
 	struct ctl_list *ctl_list;
-	bool ignore_error;
+	const char *cmd;
+	bool ignore_error, background;
 	int err = 0;
 
 	if (uc_mgr->sequence_hops > 100) {
@@ -749,6 +1070,11 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 	uc_mgr->sequence_hops++;
 	list_for_each(pos, seq) {
 		s = list_entry(pos, struct sequence_element, list);
+		if (uc_mgr->cset_defer && sequence_element_ordered(s->type)) {
+			err = cset_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
+		}
 		switch (s->type) {
 		case SEQUENCE_ELEMENT_TYPE_CDEV:
 			cdev = strdup(s->data.cdev);
@@ -823,14 +1149,21 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 				}
 				ctl = ctl_list->ctl;
 			}
-			err = execute_cset(ctl, s->data.cset, s->type);
+			if (s->type == SEQUENCE_ELEMENT_TYPE_CSET) {
+				err = execute_cset_cached(uc_mgr, ctl, s);
+			} else {
+				err = execute_cset(ctl, s->data.cset, s->type);
+				if (s->type == SEQUENCE_ELEMENT_TYPE_CSET_NEW ||
+				    s->type == SEQUENCE_ELEMENT_TYPE_CTL_REMOVE)
+					uc_mgr->ctl_generation++;
+			}
 			if (err < 0) {
 				uc_error("unable to execute cset '%s'", s->data.cset);
 				goto __fail;
 			}
 			break;
 		case SEQUENCE_ELEMENT_TYPE_SYSSET:
-			err = execute_sysw(s->data.sysw);
+			err = execute_sysw(uc_mgr, s->data.sysw);
 			if (err < 0)
 				goto __fail;
 			break;
@@ -840,8 +1173,13 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 		case SEQUENCE_ELEMENT_TYPE_EXEC:
 			if (s->data.exec == NULL)
 				break;
-			ignore_error = s->data.exec[0] == '-';
-			err = uc_mgr_exec(s->data.exec + (ignore_error ? 1 : 0));
+			sysw_close_all(uc_mgr);
+			cmd = s->data.exec;
+			ignore_error = cmd[0] == '-';
+			if (ignore_error)
+				cmd++;
+			background = cmd[0] == '&';
+			err = uc_mgr_exec(cmd + (background ? 1 : 0), background);
 			if (ignore_error == false && err != 0) {
 				uc_error("exec '%s' failed (exit code %d)", s->data.exec, err);
 				goto __fail;
@@ -850,6 +1188,7 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 		case SEQUENCE_ELEMENT_TYPE_SHELL:
 			if (s->data.exec == NULL)
 				break;
+			sysw_close_all(uc_mgr);
 			ignore_error = s->data.exec[0] == '-';
 shell_retry:
 			err = system(s->data.exec + (ignore_error ? 1 : 0));
@@ -904,13 +1243,15 @@ shell_retry:
 		}
 	}
 	free(cdev);
-	uc_mgr->sequence_hops--;
+	if (--uc_mgr->sequence_hops == 0)
+		sysw_close_all(uc_mgr);
 	return 0;
       __fail_nomem:
 	err = -ENOMEM;
       __fail:
 	free(cdev);
-	uc_mgr->sequence_hops--;
+	if (--uc_mgr->sequence_hops == 0)
+		sysw_close_all(uc_mgr);
 	return err;
 
 }
@@ -1509,7 +1850,7 @@ int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr,
 			  const char *card_name)
 {
 	snd_use_case_mgr_t *mgr;
-	int err;
+	int i, err;
 
 	/* create a new UCM */
 	mgr = calloc(1, sizeof(snd_use_case_mgr_t));
@@ -1524,6 +1865,11 @@ int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr,
 	INIT_LIST_HEAD(&mgr->active_devices);
 	INIT_LIST_HEAD(&mgr->ctl_list);
 	INIT_LIST_HEAD(&mgr->variable_list);
+	INIT_LIST_HEAD(&mgr->regex_list);
+	INIT_LIST_HEAD(&mgr->memo_list);
+	INIT_LIST_HEAD(&mgr->cset_pending);
+	for (i = 0; i < UCM_CSET_HASH; i++)
+		INIT_LIST_HEAD(&mgr->cset_hash[i]);
 	pthread_mutex_init(&mgr->mutex, NULL);
 
 	if (card_name && *card_name == '-') {
@@ -2516,7 +2862,7 @@ static int set_verb_user(snd_use_case_mgr_t *uc_mgr,
 			 const char *verb_name)
 {
 	struct use_case_verb *verb;
-	int err = 0;
+	int err = 0, err2;
 
 	if (uc_mgr->active_verb &&
 	    strcmp(uc_mgr->active_verb->name, verb_name) == 0)
@@ -2528,12 +2874,14 @@ static int set_verb_user(snd_use_case_mgr_t *uc_mgr,
 	} else {
 		verb = NULL;
 	}
+	/* the writes of the old and new verb are merged */
+	uc_mgr->cset_defer = 1;
 	if (uc_mgr->active_verb) {
 		err = handle_transition_verb(uc_mgr, verb);
 		if (err == 0) {
 			err = dismantle_use_case(uc_mgr);
 			if (err < 0)
-				return err;
+				goto __flush;
 		} else if (err == 1) {
 			uc_mgr->active_verb = verb;
 			verb = NULL;
@@ -2547,7 +2895,10 @@ static int set_verb_user(snd_use_case_mgr_t *uc_mgr,
 			uc_error("error: failed to initialize new use case: %s",
 				 verb_name);
 	}
-	return err;
+      __flush:
+	err2 = cset_flush(uc_mgr);
+	uc_mgr->cset_defer = 0;
+	return err < 0 ? err : err2;
 }
 
 
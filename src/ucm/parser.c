@@ -73,7 +73,7 @@ int uc_mgr_config_load_file(snd_use_case_mgr_t *uc_mgr,
 	ucm_filename(filename, sizeof(filename), uc_mgr->conf_format,
 		     file[0] == '/' ? NULL : uc_mgr->conf_dir_name,
 		     file);
-	err = uc_mgr_config_load(uc_mgr->conf_format, filename, cfg);
+	err = uc_mgr_cache_config_load(uc_mgr, uc_mgr->conf_format, filename, cfg);
 	if (err < 0) {
 		uc_error("error: failed to open file %s: %d", filename, err);
 		return err;
@@ -742,7 +742,7 @@ static int parse_libconfig1(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg)
 	if (file) {
 		if (substfile) {
 			snd_config_t *cfg;
-			err = uc_mgr_config_load(uc_mgr->conf_format, file, &cfg);
+			err = uc_mgr_cache_config_load(uc_mgr, uc_mgr->conf_format, file, &cfg);
 			if (err < 0)
 				return err;
 			err = uc_mgr_substitute_tree(uc_mgr, cfg);
@@ -2536,6 +2536,8 @@ static int get_by_card_name(snd_use_case_mgr_t *mgr, const char *card_name)
 
 	snd_ctl_card_info_alloca(&info);
 
+	/* probe all cards at once, the matching uses the shared information */
+	_snd_card_info_prefetch();
 	card = -1;
 	if (snd_card_next(&card) < 0 || card < 0) {
 		uc_error("no soundcards found...");
@@ -2545,20 +2547,20 @@ static int get_by_card_name(snd_use_case_mgr_t *mgr, const char *card_name)
 	while (card >= 0) {
 		char name[32];
 
-		/* clear the list, keep the only one CTL device */
-		uc_mgr_free_ctl_list(mgr);
-
-		sprintf(name, "hw:%d", card);
-		err = get_card_info(mgr, name, &info);
-
-		if (err == 0) {
+		if (_snd_card_info(card, info) == 0) {
 			_driver = snd_ctl_card_info_get_driver(info);
 			_name = snd_ctl_card_info_get_name(info);
 			_long_name = snd_ctl_card_info_get_longname(info);
 			if (!strcmp(card_name, _driver) ||
 			    !strcmp(card_name, _name) ||
-			    !strcmp(card_name, _long_name))
-				return 0;
+			    !strcmp(card_name, _long_name)) {
+				/* clear the list, keep the only one CTL device */
+				uc_mgr_free_ctl_list(mgr);
+				sprintf(name, "hw:%d", card);
+				err = get_card_info(mgr, name, NULL);
+				if (err == 0)
+					return 0;
+			}
 		}
 
 		if (snd_card_next(&card) < 0) {
@@ -2797,7 +2799,7 @@ static int load_toplevel_config(snd_use_case_mgr_t *uc_mgr,
 		return -ENOENT;
 	}
 
-	err = uc_mgr_config_load(2, filename, &tcfg);
+	err = uc_mgr_cache_config_load(uc_mgr, 2, filename, &tcfg);
 	if (err < 0)
 		goto __error;
 
@@ -2807,7 +2809,7 @@ static int load_toplevel_config(snd_use_case_mgr_t *uc_mgr,
 	if (err < 0)
 		goto __error;
 
-	err = uc_mgr_config_load(uc_mgr->conf_format, filename, cfg);
+	err = uc_mgr_cache_config_load(uc_mgr, uc_mgr->conf_format, filename, cfg);
 	if (err < 0) {
 		uc_error("error: could not parse configuration for card %s",
 				uc_mgr->card_name);
@@ -2849,6 +2851,8 @@ int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr)
 		get_by_card_name(uc_mgr, name);
 	}
 
+	uc_mgr_cache_open(uc_mgr);
+
 	err = load_toplevel_config(uc_mgr, &cfg);
 	if (err < 0)
 		goto __error;
@@ -2859,6 +2863,7 @@ int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr)
 		uc_mgr->macros = NULL;
 	}
 	snd_config_delete(cfg);
+	uc_mgr_cache_close(uc_mgr, err >= 0);
 	if (err < 0) {
 		uc_mgr_free_ctl_list(uc_mgr);
 		uc_mgr_free_verb(uc_mgr);
@@ -2867,6 +2872,7 @@ int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr)
 	return err;
 
 __error:
+	uc_mgr_cache_close(uc_mgr, 0);
 	uc_mgr_free_ctl_list(uc_mgr);
 	replace_string(&uc_mgr->conf_dir_name, NULL);
 	return err;
@@ -0,0 +1,396 @@
+/*
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Cache of the parsed UCM configuration files
+ *
+ * When ALSA_UCM_CACHE names a directory, the trees parsed from the
+ * configuration files of a card are stored there in one file per card,
+ * in the binary form of the global configuration cache. The next import
+ * maps the file once and takes the trees of the unchanged files from it
+ * instead of parsing them again. Each tree is checked against the device,
+ * inode, size and mtime of its file.
+ *
+ * Only the parsing is skipped: the conditions, includes, macros and
+ * substitutions depend on the controls and on the state of the system
+ * and they are evaluated again for every import.
+ */
+
+#include "ucm_local.h"
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define ALSA_UCM_CACHE_VAR	"ALSA_UCM_CACHE"
+#define UCM_CACHE_MAGIC		"ALSAUCM"
+#define UCM_CACHE_VERSION	1
+
+struct ucm_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t count;		/* count of the files */
+	uint64_t size;		/* size of the cache */
+};
+
+struct ucm_cache_file {
+	struct list_head list;
+	char *name;
+	uint64_t dev, ino, size, mtime;
+	const void *data;	/* tree in the binary form */
+	size_t len;
+	void *alloc;		/* data when not in the mapped cache */
+	int used;		/* loaded by the current import */
+};
+
+struct ucm_cache {
+	char *path;
+	void *map;
+	size_t map_size;
+	struct list_head files;
+	int changed;
+};
+
+static void cache_free_file(struct ucm_cache_file *f)
+{
+	list_del(&f->list);
+	free(f->name);
+	free(f->alloc);
+	free(f);
+}
+
+static int cache_get(const char **ptr, const char *end, void *data, size_t len)
+{
+	if ((size_t)(end - *ptr) < len)
+		return -EINVAL;
+	memcpy(data, *ptr, len);
+	*ptr += len;
+	return 0;
+}
+
+/* a pointer to len bytes at ptr, the length is stored before them */
+static int cache_get_blob(const char **ptr, const char *end,
+			  const char **data, uint32_t *len)
+{
+	int err;
+
+	err = cache_get(ptr, end, len, sizeof(*len));
+	if (err < 0)
+		return err;
+	if ((size_t)(end - *ptr) < *len)
+		return -EINVAL;
+	*data = *ptr;
+	*ptr += *len;
+	return 0;
+}
+
+static int cache_parse(struct ucm_cache *cache)
+{
+	const char *ptr = cache->map, *end = ptr + cache->map_size;
+	struct ucm_cache_header hdr;
+	struct ucm_cache_file *f;
+	const char *name;
+	uint32_t k, len;
+	int err;
+
+	err = cache_get(&ptr, end, &hdr, sizeof(hdr));
+	if (err < 0)
+		return err;
+	if (memcmp(hdr.magic, UCM_CACHE_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != UCM_CACHE_VERSION ||
+	    hdr.size != cache->map_size)
+		return -ESTALE;
+	for (k = 0; k < hdr.count; k++) {
+		f = calloc(1, sizeof(*f));
+		if (f == NULL)
+			return -ENOMEM;
+		list_add_tail(&f->list, &cache->files);
+		if ((err = cache_get(&ptr, end, &f->dev, sizeof(f->dev))) < 0 ||
+		    (err = cache_get(&ptr, end, &f->ino, sizeof(f->ino))) < 0 ||
+		    (err = cache_get(&ptr, end, &f->size, sizeof(f->size))) < 0 ||
+		    (err = cache_get(&ptr, end, &f->mtime, sizeof(f->mtime))) < 0 ||
+		    (err = cache_get_blob(&ptr, end, &name, &len)) < 0)
+			return err;
+		f->name = strndup(name, len);
+		if (f->name == NULL)
+			return -ENOMEM;
+		err = cache_get_blob(&ptr, end, (const char **)&f->data, &len);
+		if (err < 0)
+			return err;
+		f->len = len;
+	}
+	return ptr == end ? 0 : -EINVAL;
+}
+
+/* file name of the cache of the card, made of its id and its long name */
+static char *cache_path(snd_use_case_mgr_t *uc_mgr, const char *dir)
+{
+	struct ctl_list *ctl_list = uc_mgr_get_master_ctl(uc_mgr);
+	const char *id = uc_mgr->card_name, *s;
+	uint32_t h = 2166136261u;
+	char *path, *p;
+
+	if (ctl_list) {
+		id = snd_ctl_card_info_get_id(ctl_list->ctl_info);
+		for (s = snd_ctl_card_info_get_longname(ctl_list->ctl_info); *s; s++)
+			h = (h ^ (unsigned char)*s) * 16777619u;
+	}
+	path = malloc(strlen(dir) + strlen(id) + 16);
+	if (path == NULL)
+		return NULL;
+	p = path + sprintf(path, "%s/", dir);
+	for (s = id; *s; s++)
+		*p++ = isalnum((unsigned char)*s) || *s == '-' || *s == '.' ? *s : '_';
+	sprintf(p, "-%08x", h);
+	return path;
+}
+
+/*
+ * map the cache of the card, a missing or stale cache is replaced at the
+ * end of the import; the cache must belong to the user as the configuration
+ * can run programs
+ */
+void uc_mgr_cache_open(snd_use_case_mgr_t *uc_mgr)
+{
+	const char *dir = getenv(ALSA_UCM_CACHE_VAR);
+	struct ucm_cache *cache;
+	struct list_head *pos, *npos;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (dir == NULL || *dir == '\0' || uc_mgr->cache)
+		return;
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL)
+		return;
+	INIT_LIST_HEAD(&cache->files);
+	cache->path = cache_path(uc_mgr, dir);
+	if (cache->path == NULL) {
+		free(cache);
+		return;
+	}
+	uc_mgr->cache = cache;
+	fd = open(cache->path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) < 0 || st.st_uid != geteuid() ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH)) || st.st_size == 0) {
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+	cache->map = map;
+	cache->map_size = st.st_size;
+	if (cache_parse(cache) < 0) {
+		list_for_each_safe(pos, npos, &cache->files)
+			cache_free_file(list_entry(pos, struct ucm_cache_file, list));
+	}
+}
+
+static int cache_write(struct ucm_cache *cache)
+{
+	struct ucm_cache_header hdr;
+	struct ucm_cache_file *f;
+	struct list_head *pos;
+	uint32_t len;
+	char *tmp;
+	FILE *fp;
+	int fd, err = 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, UCM_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = UCM_CACHE_VERSION;
+	hdr.size = sizeof(hdr);
+	list_for_each(pos, &cache->files) {
+		f = list_entry(pos, struct ucm_cache_file, list);
+		hdr.count++;
+		hdr.size += 4 * sizeof(uint64_t) + 2 * sizeof(len) +
+			    strlen(f->name) + f->len;
+	}
+
+	tmp = malloc(strlen(cache->path) + 8);
+	if (tmp == NULL)
+		return -ENOMEM;
+	sprintf(tmp, "%s.XXXXXX", cache->path);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		err = -errno;
+		goto __end;
+	}
+	fp = fdopen(fd, "w");
+	if (fp == NULL) {
+		err = -errno;
+		close(fd);
+		goto __unlink;
+	}
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	list_for_each(pos, &cache->files) {
+		f = list_entry(pos, struct ucm_cache_file, list);
+		fwrite(&f->dev, sizeof(f->dev), 1, fp);
+		fwrite(&f->ino, sizeof(f->ino), 1, fp);
+		fwrite(&f->size, sizeof(f->size), 1, fp);
+		fwrite(&f->mtime, sizeof(f->mtime), 1, fp);
+		len = strlen(f->name);
+		fwrite(&len, sizeof(len), 1, fp);
+		fwrite(f->name, 1, len, fp);
+		len = f->len;
+		fwrite(&len, sizeof(len), 1, fp);
+		fwrite(f->data, 1, len, fp);
+	}
+	if (ferror(fp))
+		err = -EIO;
+	if (fclose(fp) != 0 && err == 0)
+		err = -errno;
+	if (err == 0 && rename(tmp, cache->path) < 0)
+		err = -errno;
+ __unlink:
+	if (err < 0)
+		unlink(tmp);
+ __end:
+	free(tmp);
+	return err;
+}
+
+/*
+ * release the cache, with save set after a successful import, store it
+ * again when the import loaded a file which was not cached or when it
+ * did not load all cached files
+ */
+void uc_mgr_cache_close(snd_use_case_mgr_t *uc_mgr, int save)
+{
+	struct ucm_cache *cache = uc_mgr->cache;
+	struct ucm_cache_file *f;
+	struct list_head *pos, *npos;
+
+	if (cache == NULL)
+		return;
+	uc_mgr->cache = NULL;
+	list_for_each_safe(pos, npos, &cache->files) {
+		f = list_entry(pos, struct ucm_cache_file, list);
+		if (!f->used) {
+			cache_free_file(f);
+			cache->changed = 1;
+		}
+	}
+	if (save && cache->changed) {
+		int err = cache_write(cache);
+		if (err < 0)
+			uc_error("unable to update the cache %s: %s",
+				 cache->path, snd_strerror(err));
+	}
+	list_for_each_safe(pos, npos, &cache->files) {
+		f = list_entry(pos, struct ucm_cache_file, list);
+		cache_free_file(f);
+	}
+	if (cache->map)
+		munmap(cache->map, cache->map_size);
+	free(cache->path);
+	free(cache);
+}
+
+static struct ucm_cache_file *cache_find(struct ucm_cache *cache,
+					 const char *file, struct stat *st)
+{
+	struct ucm_cache_file *f;
+	struct list_head *pos;
+
+	list_for_each(pos, &cache->files) {
+		f = list_entry(pos, struct ucm_cache_file, list);
+		if (strcmp(f->name, file))
+			continue;
+		if (f->dev == (uint64_t)st->st_dev &&
+		    f->ino == (uint64_t)st->st_ino &&
+		    f->size == (uint64_t)st->st_size &&
+		    f->mtime == (uint64_t)st->st_mtime)
+			return f;
+		/* the file changed */
+		cache_free_file(f);
+		cache->changed = 1;
+		return NULL;
+	}
+	return NULL;
+}
+
+/*
+ * store the tree parsed from a file; files with include directives are
+ * skipped as the included files are not checked, and so are files
+ * changed within the last second as a further change in the same second
+ * keeps the mtime
+ */
+static void cache_add(struct ucm_cache *cache, const char *file,
+		      struct stat *st, snd_config_t *cfg)
+{
+	struct ucm_cache_file *f;
+
+	if (st->st_mtime >= time(NULL) - 1)
+		return;
+	f = calloc(1, sizeof(*f));
+	if (f == NULL)
+		return;
+	f->name = strdup(file);
+	if (f->name == NULL ||
+	    _snd_config_cache_encode(cfg, &f->alloc, &f->len) < 0) {
+		free(f->name);
+		free(f);
+		return;
+	}
+	f->data = f->alloc;
+	f->dev = st->st_dev;
+	f->ino = st->st_ino;
+	f->size = st->st_size;
+	f->mtime = st->st_mtime;
+	f->used = 1;
+	list_add_tail(&f->list, &cache->files);
+	cache->changed = 1;
+}
+
+/* uc_mgr_config_load() which goes through the cache opened for the import */
+int uc_mgr_cache_config_load(snd_use_case_mgr_t *uc_mgr, int format,
+			     const char *file, snd_config_t **cfg)
+{
+	struct ucm_cache *cache = uc_mgr->cache;
+	struct ucm_cache_file *f;
+	unsigned int includes = 0;
+	snd_config_t *top;
+	struct stat st;
+	int err;
+
+	if (cache == NULL || stat(file, &st) < 0)
+		return uc_mgr_config_load(format, file, cfg);
+	f = cache_find(cache, file, &st);
+	if (f) {
+		err = snd_config_top(&top);
+		if (err < 0)
+			return err;
+		err = _snd_config_cache_decode(top, f->data, f->len);
+		if (err >= 0) {
+			f->used = 1;
+			*cfg = top;
+			return 0;
+		}
+		/* corrupted, parse the file instead */
+		snd_config_delete(top);
+		cache_free_file(f);
+		cache->changed = 1;
+	}
+	err = uc_mgr_config_load_with_include(format, file, cfg, &includes);
+	if (err >= 0 && includes == 0)
+		cache_add(cache, file, &st, *cfg);
+	return err;
+}
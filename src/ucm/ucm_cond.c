@@ -139,7 +139,7 @@ static int if_eval_regex_match(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 {
 	const char *string, *regex_string;
 	char *s;
-	regex_t re;
+	regex_t *re;
 	int options = REG_EXTENDED | REG_ICASE;
 	regmatch_t match[1];
 	int err;
@@ -159,7 +159,7 @@ static int if_eval_regex_match(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, regex_string);
 	if (err < 0)
 		return err;
-	err = regcomp(&re, s, options);
+	err = uc_mgr_regcomp(uc_mgr, &re, s, options);
 	if (err) {
 		uc_error("Regex '%s' compilation failed (code %d)", s, err);
 		free(s);
@@ -168,29 +168,58 @@ static int if_eval_regex_match(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 	free(s);
 
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, string);
-	if (err < 0) {
-		regfree(&re);
+	if (err < 0)
 		return err;
-	}
-	err = regexec(&re, s, ARRAY_SIZE(match), match, 0);
+	err = regexec(re, s, ARRAY_SIZE(match), match, 0);
 	free(s);
-	regfree(&re);
 	return err == 0;
 }
 
+static int control_exists(snd_ctl_t *ctl, snd_ctl_elem_id_t *elem_id,
+			  const char *enumval)
+{
+	snd_ctl_elem_info_t *elem_info;
+	snd_ctl_elem_type_t type;
+	const char *name;
+	int err, i, items;
+
+	snd_ctl_elem_info_alloca(&elem_info);
+
+	snd_ctl_elem_info_set_id(elem_info, elem_id);
+	err = snd_ctl_elem_info(ctl, elem_info);
+	if (err < 0)
+		return 0;
+
+	if (enumval) {
+		type = snd_ctl_elem_info_get_type(elem_info);
+		if (type != SND_CTL_ELEM_TYPE_ENUMERATED)
+			return 0;
+		items = snd_ctl_elem_info_get_items(elem_info);
+		for (i = 0; i < items; i++) {
+			snd_ctl_elem_info_set_item(elem_info, i);
+			err = snd_ctl_elem_info(ctl, elem_info);
+			if (err < 0)
+				return err;
+			name = snd_ctl_elem_info_get_item_name(elem_info);
+			if (strcasecmp(name, enumval) == 0)
+				return 1;
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
 static int if_eval_control_exists(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 {
 	snd_ctl_t *ctl;
 	struct ctl_list *ctl_list;
-	const char *device = NULL, *ctldef, *enumval = NULL, *name;
+	const char *device = NULL, *ctldef, *enumval = NULL, *result;
 	snd_ctl_elem_id_t *elem_id;
-	snd_ctl_elem_info_t *elem_info;
-	snd_ctl_elem_type_t type;
-	char *s;
-	int err, i, items;
+	char *s, *e = NULL, *key, handle[48];
+	int err;
 
 	snd_ctl_elem_id_alloca(&elem_id);
-	snd_ctl_elem_info_alloca(&elem_info);
 
 	err = get_string(eval, "Device", &device);
 	if (err < 0 && err != -ENOENT) {
@@ -214,9 +243,9 @@ static int if_eval_control_exists(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval
 	if (err < 0)
 		return err;
 	err = snd_ctl_ascii_elem_id_parse(elem_id, s);
-	free(s);
 	if (err < 0) {
 		uc_error("unable to parse element identificator (%s)", ctldef);
+		free(s);
 		return -EINVAL;
 	}
 
@@ -224,57 +253,54 @@ static int if_eval_control_exists(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval
 		ctl = uc_mgr_get_ctl(uc_mgr);
 		if (ctl == NULL) {
 			uc_error("cannot determine control device");
+			free(s);
 			return -EINVAL;
 		}
 	} else {
-		err = uc_mgr_get_substituted_value(uc_mgr, &s, device);
-		if (err < 0)
+		err = uc_mgr_get_substituted_value(uc_mgr, &e, device);
+		if (err < 0) {
+			free(s);
 			return err;
-		err = uc_mgr_open_ctl(uc_mgr, &ctl_list, s, 1);
-		free(s);
-		if (err < 0)
+		}
+		err = uc_mgr_open_ctl(uc_mgr, &ctl_list, e, 1);
+		free(e);
+		if (err < 0) {
+			free(s);
 			return err;
+		}
 		ctl = ctl_list->ctl;
 	}
 
-	snd_ctl_elem_info_set_id(elem_info, elem_id);
-	err = snd_ctl_elem_info(ctl, elem_info);
-	if (err < 0)
-		return 0;
-
+	e = NULL;
 	if (enumval) {
-		type = snd_ctl_elem_info_get_type(elem_info);
-		if (type != SND_CTL_ELEM_TYPE_ENUMERATED)
-			return 0;
-		err = uc_mgr_get_substituted_value(uc_mgr, &s, enumval);
-		if (err < 0)
+		err = uc_mgr_get_substituted_value(uc_mgr, &e, enumval);
+		if (err < 0) {
+			free(s);
 			return err;
-		items = snd_ctl_elem_info_get_items(elem_info);
-		for (i = 0; i < items; i++) {
-			snd_ctl_elem_info_set_item(elem_info, i);
-			err = snd_ctl_elem_info(ctl, elem_info);
-			if (err < 0) {
-				free(s);
-				return err;
-			}
-			name = snd_ctl_elem_info_get_item_name(elem_info);
-			if (strcasecmp(name, s) == 0) {
-				free(s);
-				return 1;
-			}
 		}
-		free(s);
-		return 0;
 	}
 
-	return 1;
+	/* the controls of the handle change only with its generation */
+	snprintf(handle, sizeof(handle), "%p:%u", ctl, uc_mgr->ctl_generation);
+	key = uc_mgr_memo_key("ControlExists", handle, s, e ? e : "\001");
+	free(s);
+	if (key && uc_mgr_memo_get(uc_mgr, key, &result) == 0) {
+		err = result[0] == '1';
+	} else {
+		err = control_exists(ctl, elem_id, e);
+		if (key && err >= 0)
+			uc_mgr_memo_put(uc_mgr, key, err ? "1" : "0");
+	}
+	free(key);
+	free(e);
+	return err;
 }
 
 static int if_eval_path(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 {
-	const char *path, *mode = "";
+	const char *path, *mode = "", *result;
 	int err, amode = F_OK;
-	char *s;
+	char *s, *key, mbuf[16];
 
 	if (uc_mgr->conf_format < 4) {
 		uc_error("Path condition is supported in v4+ syntax");
@@ -323,14 +349,23 @@ static int if_eval_path(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 		if (err < 0)
 			return err;
 	}
+	snprintf(mbuf, sizeof(mbuf), "%d", amode);
+	key = uc_mgr_memo_key("Path", s, mbuf, "");
+	if (key && uc_mgr_memo_get(uc_mgr, key, &result) == 0) {
+		err = result[0] == '1';
+	} else {
 #ifdef HAVE_EACCESS
-	err = eaccess(s, amode);
+		err = eaccess(s, amode) ? 0 : 1;
 #else
-	err = access(s, amode);
+		err = access(s, amode) ? 0 : 1;
 #endif
+		if (key)
+			uc_mgr_memo_put(uc_mgr, key, err ? "1" : "0");
+	}
+	free(key);
 	if (s != path)
 		free(s);
-	return err ? 0 : 1;
+	return err;
 }
 
 static int if_eval(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
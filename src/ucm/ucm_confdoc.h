@@ -237,7 +237,7 @@ ctl-remove ARG | Remove ALSA user control element - snd_ctl_ascii_elem_id_parse(
 sysw ARG       | write to sysfs tree
 usleep ARG     | sleep for specified amount of microseconds
 msleep ARG     | sleep for specified amount of milliseconds
-exec ARG       | execute a specific command (without shell - *man execv*)
+exec ARG       | execute a specific command (without shell - *man execv*), a leading '&' does not wait for the command
 shell ARG      | execute a specific command (using shell - *man system*)
 cfg-save ARG   | save LibraryConfig to a file
 
@@ -250,6 +250,7 @@ ctl-remove "name='Bool2'"
 sysw "-/class/sound/ctl-led/speaker/card${CardNumber}/attach:Speaker Channel Switch"
 usleep 10
 exec "/bin/echo hello"
+exec "-&/usr/bin/dsp-trace --start"
 shell "set"
 cfg-save "/tmp/test.conf:+pcm"
 ~~~
@@ -32,6 +32,7 @@
 #include <sys/wait.h>
 #include <limits.h>
 #include <dirent.h>
+#include <spawn.h>
 
 #if defined(__NetBSD__) || defined(__OpenBSD__) || defined(__FreeBSD__) || defined(__DragonFly__)
 #include <signal.h>
@@ -42,8 +43,6 @@ extern char **environ;
 #endif
 #endif
 
-static pthread_mutex_t fork_lock = PTHREAD_MUTEX_INITIALIZER;
-
 /*
  * Search PATH for executable
  */
@@ -177,18 +176,82 @@ static int parse_args(char ***argv, int argc, const char *cmd)
 	return 0;
 }
 
+/*
+ * close the descriptors from 3 up in the child
+ */
+static int spawn_close_fds(posix_spawn_file_actions_t *fa)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+	return posix_spawn_file_actions_addclosefrom_np(fa, 3);
+#else
+	struct dirent *de;
+	DIR *dir;
+	long fd, maxfd;
+	int err = 0;
+
+	/* only the open ones, a close of a free descriptor fails the spawn */
+	dir = opendir("/proc/self/fd");
+	if (dir) {
+		while (err == 0 && (de = readdir(dir)) != NULL) {
+			fd = atol(de->d_name);
+			if (fd >= 3 && fd != dirfd(dir))
+				err = posix_spawn_file_actions_addclose(fa, fd);
+		}
+		closedir(dir);
+		return err;
+	}
+	maxfd = sysconf(_SC_OPEN_MAX);
+	for (fd = 3; err == 0 && fd < maxfd; fd++)
+		if (fcntl(fd, F_GETFD) >= 0)
+			err = posix_spawn_file_actions_addclose(fa, fd);
+	return err;
+#endif
+}
+
+/*
+ * wait for a background process, so that it does not stay a zombie
+ */
+static void *reap_thread(void *arg)
+{
+	pid_t p = (pid_t)(intptr_t)arg;
+
+	while (waitpid(p, NULL, 0) < 0 && errno == EINTR)
+		;
+	return NULL;
+}
+
+static int reap_background(pid_t p)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&thread, &attr, reap_thread, (void *)(intptr_t)p);
+	pthread_attr_destroy(&attr);
+	return -err;
+}
+
 /*
  * execute a binary file
  *
+ * The process is created with posix_spawn(), which does not copy the
+ * address space of the caller (vfork or clone with CLONE_VM). The child
+ * gets /dev/null as stdin, stdout and stderr, no other descriptors, the
+ * default SIGINT and SIGQUIT handlers and its own process group.
+ *
+ * Returns the exit code of the program, or 0 right after the start when
+ * background is set.
  */
-int uc_mgr_exec(const char *prog)
+int uc_mgr_exec(const char *prog, int background)
 {
-	pid_t p, f, maxfd;
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	pid_t p, f;
 	int err = 0, status;
 	char bin[PATH_MAX];
-	struct sigaction sa;
-	struct sigaction intr, quit;
-	sigset_t omask;
+	sigset_t mask;
 	char **argv;
 
 	if (parse_args(&argv, 32, prog))
@@ -207,79 +270,66 @@ int uc_mgr_exec(const char *prog)
 		prog = bin;
 	}
 
-	maxfd = sysconf(_SC_OPEN_MAX);
-
-	/*
-	 * block SIGCHLD signal
-	 * ignore SIGINT and SIGQUIT in parent
-	 */
-
-	memset(&sa, 0, sizeof(sa));
-	sa.sa_handler = SIG_IGN;
-	sigemptyset(&sa.sa_mask);
-	sigaddset(&sa.sa_mask, SIGCHLD);
-
-	pthread_mutex_lock(&fork_lock);
-
-	sigprocmask(SIG_BLOCK, &sa.sa_mask, &omask);
-
-	sigaction(SIGINT, &sa, &intr);
-	sigaction(SIGQUIT, &sa, &quit);
-
-	p = fork();
-
-	if (p == -1) {
-		err = -errno;
-		pthread_mutex_unlock(&fork_lock);
-		uc_error("Unable to fork() for \"%s\" -- %s", prog,
-			 strerror(errno));
+	err = posix_spawn_file_actions_init(&fa);
+	if (err) {
+		err = -err;
 		goto __error;
 	}
-
-	if (p == 0) {
-		f = open("/dev/null", O_RDWR);
-		if (f == -1) {
-			uc_error("pid %d cannot open /dev/null for redirect %s -- %s",
-				 getpid(), prog, strerror(errno));
-			exit(1);
-		}
-
-		close(0);
-		close(1);
-		close(2);
-
-		dup2(f, 0);
-		dup2(f, 1);
-		dup2(f, 2);
-
-		close(f);
-
-		for (f = 3; f < maxfd; f++)
-			close(f);
-
-		/* install default handlers for the forked process */
-		signal(SIGINT, SIG_DFL);
-		signal(SIGQUIT, SIG_DFL);
-
-		execve(prog, argv, environ);
-		exit(1);
+	err = posix_spawnattr_init(&attr);
+	if (err) {
+		posix_spawn_file_actions_destroy(&fa);
+		err = -err;
+		goto __error;
 	}
 
-	sigaction(SIGINT, &intr, NULL);
-	sigaction(SIGQUIT, &quit, NULL);
-	sigprocmask(SIG_SETMASK, &omask, NULL);
-
-	pthread_mutex_unlock(&fork_lock);
-
-	/* make the spawned process a session leader so killing the
+	err = posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDWR, 0);
+	if (!err)
+		err = posix_spawn_file_actions_adddup2(&fa, 0, 1);
+	if (!err)
+		err = posix_spawn_file_actions_adddup2(&fa, 0, 2);
+	if (!err)
+		err = spawn_close_fds(&fa);
+
+	/* install default handlers and the signal mask of the caller */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGQUIT);
+	if (!err)
+		err = posix_spawnattr_setsigdefault(&attr, &mask);
+	pthread_sigmask(SIG_SETMASK, NULL, &mask);
+	if (!err)
+		err = posix_spawnattr_setsigmask(&attr, &mask);
+
+	/* make the spawned process a process group leader so killing the
 	   process group recursively kills any child process that
 	   might have been spawned */
-	setpgid(p, p);
+	if (!err)
+		err = posix_spawnattr_setpgroup(&attr, 0);
+	if (!err)
+		err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF |
+					       POSIX_SPAWN_SETSIGMASK |
+					       POSIX_SPAWN_SETPGROUP);
+	if (!err)
+		err = posix_spawn(&p, prog, &fa, &attr, argv, environ);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+
+	if (err) {
+		uc_error("Unable to spawn \"%s\" -- %s", prog, strerror(err));
+		err = -err;
+		goto __error;
+	}
+
+	if (background) {
+		err = reap_background(p);
+		goto __error;
+	}
 
 	while (1) {
 		f = waitpid(p, &status, 0);
 		if (f == -1) {
-			if (errno == EAGAIN)
+			if (errno == EAGAIN || errno == EINTR)
 				continue;
 			err = -errno;
 			goto __error;
@@ -38,6 +38,7 @@
 
 #include "local.h"
 #include <pthread.h>
+#include <regex.h>
 #include "use-case.h"
 
 #define SYNTAX_VERSION_MAX	7
@@ -86,6 +87,7 @@ struct sequence_element {
 		char *device;
 		struct component_sequence cmpt_seq; /* component sequence */
 	} data;
+	struct ucm_cset *cset_cache;	/* cset parsed at the first use */
 };
 
 /*
@@ -121,6 +123,12 @@ struct ctl_dev {
 	char *device;
 };
 
+/* sysfs file kept open by the running sequences */
+struct ucm_sysw_fd {
+	char *path;
+	int fd;
+};
+
 struct ctl_list {
 	struct list_head list;
 	struct list_head dev_list;
@@ -221,6 +229,8 @@ struct use_case_verb {
 	struct list_head remove_list;
 };
 
+#define UCM_CSET_HASH		64
+
 /*
  *  Manages a sound card and all its use cases.
  */
@@ -235,6 +245,10 @@ struct snd_use_case_mgr {
 	const char *parse_variant;
 	int parse_master_section;
 	int sequence_hops;
+	/* sysfs files written, closed when the outermost sequence ends */
+	struct ucm_sysw_fd *sysw_fds;
+	unsigned int sysw_count;
+	unsigned int sysw_size;
 
 	/* UCM cards list */
 	struct list_head cards_list;
@@ -268,6 +282,16 @@ struct snd_use_case_mgr {
 
 	/* list of opened control devices */
 	struct list_head ctl_list;
+	/* changed when controls are added or removed, or ctls closed */
+	unsigned int ctl_generation;
+	/* plain csets of a verb switch waiting to be written */
+	struct list_head cset_pending;
+	struct list_head cset_hash[UCM_CSET_HASH];
+	int cset_defer;
+
+	/* compiled regular expressions, results of the hardware queries */
+	struct list_head regex_list;
+	struct list_head memo_list;
 
 	/* tree with macros */
 	snd_config_t *macros;
@@ -283,6 +307,9 @@ struct snd_use_case_mgr {
 	 */
 	int in_component_domain;
 	char *cdev;
+
+	/* cache of the parsed files, during the import */
+	struct ucm_cache *cache;
 };
 
 #define uc_error SNDERR
@@ -300,10 +327,17 @@ const char *uc_mgr_sysfs_root(void);
 const char *uc_mgr_config_dir(int format);
 int uc_mgr_config_load_into(int format, const char *file, snd_config_t *cfg);
 int uc_mgr_config_load(int format, const char *file, snd_config_t **cfg);
+int uc_mgr_config_load_with_include(int format, const char *file,
+				    snd_config_t **cfg, unsigned int *includes);
 int uc_mgr_config_load_file(snd_use_case_mgr_t *uc_mgr,  const char *file, snd_config_t **cfg);
 int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr);
 int uc_mgr_scan_master_configs(const char **_list[]);
 
+void uc_mgr_cache_open(snd_use_case_mgr_t *uc_mgr);
+void uc_mgr_cache_close(snd_use_case_mgr_t *uc_mgr, int save);
+int uc_mgr_cache_config_load(snd_use_case_mgr_t *uc_mgr, int format,
+			     const char *file, snd_config_t **cfg);
+
 int uc_mgr_put_to_dev_list(struct dev_list *dev_list, const char *name);
 int uc_mgr_remove_device(struct use_case_verb *verb, const char *name);
 int uc_mgr_rename_device(struct use_case_verb *verb, const char *src,
@@ -338,6 +372,14 @@ void uc_mgr_free_ctl_list(snd_use_case_mgr_t *uc_mgr);
 
 int uc_mgr_add_value(struct list_head *base, const char *key, char *val);
 
+char *uc_mgr_memo_key(const char *type, const char *a, const char *b,
+		      const char *c);
+int uc_mgr_memo_get(snd_use_case_mgr_t *uc_mgr, const char *key,
+		    const char **value);
+void uc_mgr_memo_put(snd_use_case_mgr_t *uc_mgr, const char *key,
+		     const char *value);
+void uc_mgr_free_memo(snd_use_case_mgr_t *uc_mgr);
+
 const char *uc_mgr_get_variable(snd_use_case_mgr_t *uc_mgr,
 				const char *name);
 
@@ -372,8 +414,11 @@ int uc_mgr_evaluate_condition(snd_use_case_mgr_t *uc_mgr,
 int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr,
 			const char *name,
 			snd_config_t *eval);
+int uc_mgr_regcomp(snd_use_case_mgr_t *uc_mgr, regex_t **re,
+		   const char *pattern, int options);
+void uc_mgr_free_regex(snd_use_case_mgr_t *uc_mgr);
 
-int uc_mgr_exec(const char *prog);
+int uc_mgr_exec(const char *prog, int background);
 
 /** The name of the environment variable containing the UCM directory */
 #define ALSA_CONFIG_UCM_VAR "ALSA_CONFIG_UCM"
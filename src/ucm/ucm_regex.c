@@ -87,12 +87,66 @@ static int set_variables(snd_use_case_mgr_t *uc_mgr, const char *data,
 	return 0;
 }
 
+/*
+ * The compiled regular expressions of the configuration, looked up by
+ * the substituted expression and the flags.
+ */
+struct ucm_regex {
+	struct list_head list;
+	regex_t re;
+	int options;
+	char pattern[];
+};
+
+/* like regcomp(), the expression stays valid until the config is freed */
+int uc_mgr_regcomp(snd_use_case_mgr_t *uc_mgr, regex_t **re,
+		   const char *pattern, int options)
+{
+	struct list_head *pos;
+	struct ucm_regex *r;
+	int err;
+
+	list_for_each(pos, &uc_mgr->regex_list) {
+		r = list_entry(pos, struct ucm_regex, list);
+		if (r->options == options && strcmp(r->pattern, pattern) == 0) {
+			*re = &r->re;
+			return 0;
+		}
+	}
+	r = malloc(sizeof(*r) + strlen(pattern) + 1);
+	if (r == NULL)
+		return REG_ESPACE;
+	err = regcomp(&r->re, pattern, options);
+	if (err) {
+		free(r);
+		return err;
+	}
+	r->options = options;
+	strcpy(r->pattern, pattern);
+	list_add(&r->list, &uc_mgr->regex_list);
+	*re = &r->re;
+	return 0;
+}
+
+void uc_mgr_free_regex(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct ucm_regex *r;
+
+	list_for_each_safe(pos, npos, &uc_mgr->regex_list) {
+		r = list_entry(pos, struct ucm_regex, list);
+		list_del(&r->list);
+		regfree(&r->re);
+		free(r);
+	}
+}
+
 int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr, const char *name,
 			snd_config_t *eval)
 {
 	const char *string, *regex_string, *flags_string;
 	char *s;
-	regex_t re;
+	regex_t *re;
 	int options = 0;
 	regmatch_t match[20];
 	int err;
@@ -151,19 +205,18 @@ int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr, const char *name,
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, regex_string);
 	if (err < 0)
 		return err;
-	err = regcomp(&re, s, options);
-	free(s);
+	err = uc_mgr_regcomp(uc_mgr, &re, s, options);
 	if (err) {
-		uc_error("Regex '%s' compilation failed (code %d)", err);
+		uc_error("Regex '%s' compilation failed (code %d)", s, err);
+		free(s);
 		return -EINVAL;
 	}
+	free(s);
 
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, string);
-	if (err < 0) {
-		regfree(&re);
+	if (err < 0)
 		return err;
-	}
-	err = regexec(&re, s, ARRAY_SIZE(match), match, 0);
+	err = regexec(re, s, ARRAY_SIZE(match), match, 0);
 	if (err < 0)
 		err = -errno;
 	else if (err == REG_NOMATCH)
@@ -171,6 +224,5 @@ int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr, const char *name,
 	else
 		err = set_variables(uc_mgr, s, ARRAY_SIZE(match), match, name);
 	free(s);
-	regfree(&re);
 	return err;
 }
@@ -225,7 +225,7 @@ static char *rval_lookup_main(snd_use_case_mgr_t *uc_mgr,
 	const char *s;
 	char *result;
 	regmatch_t match[1];
-	regex_t re;
+	regex_t *re;
 	int err;
 
 	if (uc_mgr->conf_format < 4) {
@@ -262,7 +262,7 @@ static char *rval_lookup_main(snd_use_case_mgr_t *uc_mgr,
 	}
 	if (snd_config_get_string(d, &s))
 		goto null;
-	err = regcomp(&re, s, REG_EXTENDED | REG_ICASE);
+	err = uc_mgr_regcomp(uc_mgr, &re, s, REG_EXTENDED | REG_ICASE);
 	if (err) {
 		uc_error("Regex '%s' compilation failed (code %d)", s, err);
 		goto null;
@@ -273,12 +273,11 @@ static char *rval_lookup_main(snd_use_case_mgr_t *uc_mgr,
 		s = curr->fcn(iter->info);
 		if (s == NULL)
 			continue;
-		if (regexec(&re, s, ARRAY_SIZE(match), match, 0) == 0) {
+		if (regexec(re, s, ARRAY_SIZE(match), match, 0) == 0) {
 			result = curr->retfcn(iter, config);
 			break;
 		}
 	}
-	regfree(&re);
 fin:
 	snd_config_delete(config);
 	if (iter->done)
@@ -289,29 +288,45 @@ null:
 	goto fin;
 }
 
-static struct lookup_iterate *rval_card_lookup1(snd_use_case_mgr_t *uc_mgr,
-						struct lookup_iterate *iter,
+/* the cards are matched by the shared card information, no control is opened */
+static struct lookup_iterate *rval_card_lookup1(struct lookup_iterate *iter,
 						int card)
 {
-	if (snd_card_next(&card) < 0 || card < 0)
-		return NULL;
-	iter->ctl_list = uc_mgr_get_ctl_by_card(uc_mgr, card);
-	if (iter->ctl_list == NULL)
-		return NULL;
-	iter->info = iter->ctl_list->ctl_info;
+	do {
+		if (snd_card_next(&card) < 0 || card < 0)
+			return NULL;
+	} while (_snd_card_info(card, iter->info) < 0);
 	return iter;
 }
 
-static struct lookup_iterate *rval_card_lookup_first(snd_use_case_mgr_t *uc_mgr,
+static struct lookup_iterate *rval_card_lookup_first(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
 						     struct lookup_iterate *iter)
 {
-	return rval_card_lookup1(uc_mgr, iter, -1);
+	_snd_card_info_prefetch();
+	return rval_card_lookup1(iter, -1);
 }
 
-static struct lookup_iterate *rval_card_lookup_next(snd_use_case_mgr_t *uc_mgr,
+static struct lookup_iterate *rval_card_lookup_next(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
 						    struct lookup_iterate *iter)
 {
-	return rval_card_lookup1(uc_mgr, iter, snd_ctl_card_info_get_card(iter->info));
+	return rval_card_lookup1(iter, snd_ctl_card_info_get_card(iter->info));
+}
+
+static int rval_card_lookup_init(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
+				 struct lookup_iterate *iter,
+				 snd_config_t *config ATTRIBUTE_UNUSED)
+{
+	snd_ctl_card_info_t *info;
+
+	if (snd_ctl_card_info_malloc(&info))
+		return -ENOMEM;
+	iter->info = info;
+	return 0;
+}
+
+static void rval_card_lookup_done(struct lookup_iterate *iter)
+{
+	snd_ctl_card_info_free(iter->info);
 }
 
 static char *rval_card_lookup_return(struct lookup_iterate *iter, snd_config_t *config)
@@ -347,6 +362,8 @@ static char *rval_card_lookup(snd_use_case_mgr_t *uc_mgr, const char *query)
 		{ 0 },
 	};
 	struct lookup_iterate iter = {
+		.init = rval_card_lookup_init,
+		.done = rval_card_lookup_done,
 		.first = rval_card_lookup_first,
 		.next = rval_card_lookup_next,
 		.retfcn = rval_card_lookup_return,
@@ -657,14 +674,60 @@ static int rval_evali(snd_use_case_mgr_t *uc_mgr, snd_config_t *node, const char
 		goto __rval;						\
 	}
 
-#define MATCH_VARIABLE2(name, id, fcn, empty_ok)			\
+#define MATCH_VARIABLE2(name, id, fcn, empty_ok, cached)		\
 	if (strncmp((name), (id), sizeof(id) - 1) == 0) {		\
 		idsize = sizeof(id) - 1;				\
 		allow_empty = (empty_ok);				\
 		fcn2 = (fcn);						\
+		memo = (cached) ? (id) : NULL;				\
 		goto __match2;						\
 	}
 
+/*
+ * call fcn2, the results of the lookups which enumerate the cards and
+ * devices or read sysfs are kept in the memo of the manager; the lookups
+ * depend on the opened ctls, so the ctl generation is a part of the key
+ */
+static char *rval_fcn2(snd_use_case_mgr_t *uc_mgr,
+		       char *(*fcn2)(snd_use_case_mgr_t *, const char *id),
+		       const char *memo, const char *id)
+{
+	const char *value;
+	char *key, *rval, gen[16];
+
+	if (memo == NULL)
+		return fcn2(uc_mgr, id);
+	snprintf(gen, sizeof(gen), "%u", uc_mgr->ctl_generation);
+	key = uc_mgr_memo_key(memo, gen, id, "");
+	if (key && uc_mgr_memo_get(uc_mgr, key, &value) == 0) {
+		free(key);
+		return value ? strdup(value) : NULL;
+	}
+	rval = fcn2(uc_mgr, id);
+	if (key)
+		uc_mgr_memo_put(uc_mgr, key, rval);
+	free(key);
+	return rval;
+}
+
+/* make room for len more characters and the terminator */
+static int subs_reserve(char **r, size_t *size, size_t dpos, size_t len)
+{
+	size_t nsize;
+	char *nr;
+
+	if (dpos + len < *size)
+		return 0;
+	for (nsize = *size * 2; nsize <= dpos + len; nsize *= 2)
+		;
+	nr = realloc(*r, nsize);
+	if (nr == NULL)
+		return -ENOMEM;
+	*r = nr;
+	*size = nsize;
+	return 0;
+}
+
 /*
  * skip escaped } character (simple version)
  */
@@ -708,9 +771,9 @@ int uc_mgr_get_substituted_value(snd_use_case_mgr_t *uc_mgr,
 				 char **_rvalue,
 				 const char *value)
 {
-	size_t size, nsize, idsize, rvalsize, dpos = 0;
-	const char *tmp;
-	char *r, *nr, *rval, v2[128];
+	size_t size, idsize, rvalsize, dpos = 0;
+	const char *tmp, *memo;
+	char *r, *rval, v2[128];
 	bool ignore_error, allow_empty;
 	char *(*fcn2)(snd_use_case_mgr_t *, const char *id);
 	int err;
@@ -718,6 +781,16 @@ int uc_mgr_get_substituted_value(snd_use_case_mgr_t *uc_mgr,
 	if (value == NULL)
 		return -ENOENT;
 
+	/* most of the strings have no variable at all */
+	tmp = strchr(value, '$');
+	if (tmp == NULL) {
+		r = strdup(value);
+		if (r == NULL)
+			return -ENOMEM;
+		*_rvalue = r;
+		return 0;
+	}
+
 	size = strlen(value) + 1;
 	r = malloc(size);
 	if (r == NULL)
@@ -725,9 +798,16 @@ int uc_mgr_get_substituted_value(snd_use_case_mgr_t *uc_mgr,
 
 	while (*value) {
 		if (*value != '$') {
-__std:
-			r[dpos++] = *value;
-			value++;
+			/* copy the text up to the next '$' at once */
+			tmp = strchr(value, '$');
+			rvalsize = tmp ? (size_t)(tmp - value) : strlen(value);
+			if (subs_reserve(&r, &size, dpos, rvalsize)) {
+				err = -ENOMEM;
+				goto __error;
+			}
+			memcpy(r + dpos, value, rvalsize);
+			dpos += rvalsize;
+			value += rvalsize;
 			continue;
 		}
 		ignore_error = false;
@@ -735,9 +815,15 @@ __std:
 			value++;
 			ignore_error = true;
 		} else if (value[1] != '{') {
-			goto __std;
+			if (subs_reserve(&r, &size, dpos, 1)) {
+				err = -ENOMEM;
+				goto __error;
+			}
+			r[dpos++] = *value++;
+			continue;
 		}
 		fcn2 = NULL;
+		memo = NULL;
 		MATCH_VARIABLE(value, "${OpenName}", rval_open_name, false);
 		MATCH_VARIABLE(value, "${ConfLibDir}", rval_conf_libdir, false);
 		MATCH_VARIABLE(value, "${ConfTopDir}", rval_conf_topdir, false);
@@ -749,21 +835,20 @@ __std:
 		MATCH_VARIABLE(value, "${CardName}", rval_card_name, false);
 		MATCH_VARIABLE(value, "${CardLongName}", rval_card_longname, false);
 		MATCH_VARIABLE(value, "${CardComponents}", rval_card_components, true);
-		MATCH_VARIABLE2(value, "${env:", rval_env, false);
-		MATCH_VARIABLE2(value, "${sys:", rval_sysfs, false);
-		MATCH_VARIABLE2(value, "${var:", rval_var, true);
-		MATCH_VARIABLE2(value, "${eval:", rval_eval, false);
-		MATCH_VARIABLE2(value, "${find-card:", rval_card_lookup, false);
-		MATCH_VARIABLE2(value, "${find-device:", rval_device_lookup, false);
-		MATCH_VARIABLE2(value, "${CardNumberByName:", rval_card_number_by_name, false);
-		MATCH_VARIABLE2(value, "${CardIdByName:", rval_card_id_by_name, false);
+		MATCH_VARIABLE2(value, "${env:", rval_env, false, false);
+		MATCH_VARIABLE2(value, "${sys:", rval_sysfs, false, true);
+		MATCH_VARIABLE2(value, "${var:", rval_var, true, false);
+		MATCH_VARIABLE2(value, "${eval:", rval_eval, false, false);
+		MATCH_VARIABLE2(value, "${find-card:", rval_card_lookup, false, true);
+		MATCH_VARIABLE2(value, "${find-device:", rval_device_lookup, false, true);
+		MATCH_VARIABLE2(value, "${CardNumberByName:", rval_card_number_by_name, false, false);
+		MATCH_VARIABLE2(value, "${CardIdByName:", rval_card_id_by_name, false, false);
 __merr:
 		err = -EINVAL;
 		tmp = strchr(value, '}');
 		if (tmp) {
-			strncpy(r, value, tmp + 1 - value);
-			r[tmp + 1 - value] = '\0';
-			uc_error("variable '%s' is not known!", r);
+			uc_error("variable '%.*s' is not known!",
+				 (int)(tmp + 1 - value), value);
 		} else {
 			uc_error("variable reference '%s' is not complete", value);
 		}
@@ -786,11 +871,11 @@ __match2:
 					uc_error("define '%s' is not reachable in this context!", v2 + 1);
 					rval = NULL;
 				} else {
-					rval = fcn2(uc_mgr, tmp);
+					rval = rval_fcn2(uc_mgr, fcn2, memo, tmp);
 				}
 			} else {
 __direct_fcn2:
-				rval = fcn2(uc_mgr, v2);
+				rval = rval_fcn2(uc_mgr, fcn2, memo, v2);
 			}
 			goto __rval;
 		}
@@ -802,27 +887,20 @@ __rval:
 				value += idsize;
 				continue;
 			}
-			strncpy(r, value, idsize);
-			r[idsize] = '\0';
-			uc_error("variable '%s' is %s in this context!", r,
+			uc_error("variable '%.*s' is %s in this context!",
+				 (int)idsize, value,
 				 rval ? "empty" : "not defined");
 			err = -EINVAL;
 			goto __error;
 		}
 		value += idsize;
 		rvalsize = strlen(rval);
-		nsize = size + rvalsize - idsize;
-		if (nsize > size) {
-			nr = realloc(r, nsize);
-			if (nr == NULL) {
-				free(rval);
-				err = -ENOMEM;
-				goto __error;
-			}
-			size = nsize;
-			r = nr;
+		if (subs_reserve(&r, &size, dpos, rvalsize)) {
+			free(rval);
+			err = -ENOMEM;
+			goto __error;
 		}
-		strcpy(r + dpos, rval);
+		memcpy(r + dpos, rval, rvalsize);
 		dpos += rvalsize;
 		free(rval);
 	}
@@ -94,6 +94,7 @@ struct ctl_list *uc_mgr_get_ctl_by_name(snd_use_case_mgr_t *uc_mgr, const char *
 {
 	struct list_head *pos;
 	struct ctl_list *ctl_list;
+	snd_ctl_card_info_t *info;
 	const char *s;
 	int idx2, card;
 
@@ -110,23 +111,20 @@ struct ctl_list *uc_mgr_get_ctl_by_name(snd_use_case_mgr_t *uc_mgr, const char *
 		}
 	}
 
+	/* match the shared card information, open only the found card */
+	snd_ctl_card_info_alloca(&info);
+	_snd_card_info_prefetch();
 	idx2 = idx;
 	card = -1;
-	if (snd_card_next(&card) < 0 || card < 0)
-		return NULL;
-
-	while (card >= 0) {
-		ctl_list = uc_mgr_get_ctl_by_card(uc_mgr, card);
-		if (ctl_list == NULL)
-			continue;	/* really? */
-		s = snd_ctl_card_info_get_name(ctl_list->ctl_info);
+	while (snd_card_next(&card) == 0 && card >= 0) {
+		if (_snd_card_info(card, info) < 0)
+			continue;
+		s = snd_ctl_card_info_get_name(info);
 		if (s && strcmp(s, name) == 0) {
 			if (idx2 == 0)
-				return ctl_list;
+				return uc_mgr_get_ctl_by_card(uc_mgr, card);
 			idx2--;
 		}
-		if (snd_card_next(&card) < 0)
-			break;
 	}
 
 	return NULL;
@@ -167,6 +165,8 @@ void uc_mgr_free_ctl_list(snd_use_case_mgr_t *uc_mgr)
 		list_del(&ctl_list->list);
 		uc_mgr_free_ctl(ctl_list);
 	}
+	/* the cached element info refers to the closed handles */
+	uc_mgr->ctl_generation++;
 }
 
 static int uc_mgr_ctl_add_dev(struct ctl_list *ctl_list, const char *device)
@@ -350,7 +350,8 @@ const char *uc_mgr_config_dir(int format)
 	return path;
 }
 
-int uc_mgr_config_load_into(int format, const char *file, snd_config_t *top)
+static int config_load_into(int format, const char *file, snd_config_t *top,
+			    unsigned int *includes)
 {
 	FILE *fp;
 	snd_input_t *in;
@@ -370,7 +371,7 @@ int uc_mgr_config_load_into(int format, const char *file, snd_config_t *top)
 
 	default_paths[0] = uc_mgr_config_dir(format);
 	default_paths[1] = NULL;
-	err = _snd_config_load_with_include(top, in, 0, default_paths);
+	err = _snd_config_load_with_include(top, in, 0, default_paths, includes);
 	if (err < 0) {
 		uc_error("could not load configuration file %s", file);
 		if (in)
@@ -383,7 +384,14 @@ int uc_mgr_config_load_into(int format, const char *file, snd_config_t *top)
 	return 0;
 }
 
-int uc_mgr_config_load(int format, const char *file, snd_config_t **cfg)
+int uc_mgr_config_load_into(int format, const char *file, snd_config_t *top)
+{
+	return config_load_into(format, file, top, NULL);
+}
+
+/* like uc_mgr_config_load(), adds the count of the included files to includes */
+int uc_mgr_config_load_with_include(int format, const char *file,
+				    snd_config_t **cfg, unsigned int *includes)
 {
 	snd_config_t *top;
 	int err;
@@ -391,7 +399,7 @@ int uc_mgr_config_load(int format, const char *file, snd_config_t **cfg)
 	err = snd_config_top(&top);
 	if (err < 0)
 		return err;
-	err = uc_mgr_config_load_into(format, file, top);
+	err = config_load_into(format, file, top, includes);
 	if (err < 0) {
 		snd_config_delete(top);
 		return err;
@@ -400,6 +408,11 @@ int uc_mgr_config_load(int format, const char *file, snd_config_t **cfg)
 	return 0;
 }
 
+int uc_mgr_config_load(int format, const char *file, snd_config_t **cfg)
+{
+	return uc_mgr_config_load_with_include(format, file, cfg, NULL);
+}
+
 static void uc_mgr_free_value1(struct ucm_value *val)
 {
 	free(val->name);
@@ -499,6 +512,7 @@ void uc_mgr_free_sequence_element(struct sequence_element *seq)
 {
 	if (seq == NULL)
 		return;
+	free(seq->cset_cache);
 	switch (seq->type) {
 	case SEQUENCE_ELEMENT_TYPE_CDEV:
 		free(seq->data.cdev);
@@ -713,6 +727,63 @@ int uc_mgr_set_variable(snd_use_case_mgr_t *uc_mgr, const char *name,
 	return 0;
 }
 
+/*
+ * The memo keeps the results of the substitutions and conditions which
+ * query the hardware until the configuration is released. The key holds
+ * the type of the query and its arguments, a NULL value is a failure.
+ */
+char *uc_mgr_memo_key(const char *type, const char *a, const char *b,
+		      const char *c)
+{
+	size_t len = strlen(type) + strlen(a) + strlen(b) + strlen(c) + 4;
+	char *key = malloc(len);
+
+	if (key)
+		snprintf(key, len, "%s\n%s\n%s\n%s", type, a, b, c);
+	return key;
+}
+
+int uc_mgr_memo_get(snd_use_case_mgr_t *uc_mgr, const char *key,
+		    const char **value)
+{
+	struct list_head *pos;
+	struct ucm_value *curr;
+
+	list_for_each(pos, &uc_mgr->memo_list) {
+		curr = list_entry(pos, struct ucm_value, list);
+		if (strcmp(curr->name, key) == 0) {
+			*value = curr->data;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+/* a failed allocation only costs a new query */
+void uc_mgr_memo_put(snd_use_case_mgr_t *uc_mgr, const char *key,
+		     const char *value)
+{
+	struct ucm_value *curr;
+
+	curr = calloc(1, sizeof(struct ucm_value));
+	if (curr == NULL)
+		return;
+	curr->name = strdup(key);
+	curr->data = value ? strdup(value) : NULL;
+	if (curr->name == NULL || (value && curr->data == NULL)) {
+		free(curr->name);
+		free(curr->data);
+		free(curr);
+		return;
+	}
+	list_add(&curr->list, &uc_mgr->memo_list);
+}
+
+void uc_mgr_free_memo(snd_use_case_mgr_t *uc_mgr)
+{
+	uc_mgr_free_value(&uc_mgr->memo_list);
+}
+
 int uc_mgr_delete_variable(snd_use_case_mgr_t *uc_mgr, const char *name)
 {
 	struct list_head *pos;
@@ -763,6 +834,8 @@ void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr)
 	uc_mgr_free_sequence(&uc_mgr->default_list);
 	uc_mgr_free_value(&uc_mgr->value_list);
 	uc_mgr_free_value(&uc_mgr->variable_list);
+	uc_mgr_free_regex(uc_mgr);
+	uc_mgr_free_memo(uc_mgr);
 	free(uc_mgr->comment);
 	free(uc_mgr->conf_dir_name);
 	free(uc_mgr->conf_file_name);
@@ -0,0 +1,247 @@
+/*
+ * benchmark for the concurrent remote PCMs of aserver
+ *
+ * Opens 1, 2, 4, ... playback streams of a shm PCM in as many threads.
+ * Each of them writes a period every period time, like a real-time
+ * client would, and counts the periods whose write wasn't done before
+ * the start of the next one.  The server has to be running, e.g.
+ *
+ *   server.bench { socket "/tmp/aserver.sock" host "localhost" }
+ *   pcm.bench { type shm server bench pcm "null" }
+ *
+ *   aserver [--threads] bench &
+ *   aserver-bench -D bench -n 64
+ *
+ * A level is sustained when no stream missed a period.
+ *
+ * With -S, one more stream writes to another PCM without a break during
+ * the whole run, e.g. a file PCM whose reader is slow, so that its writes
+ * block in the server:
+ *
+ *   pcm.slowfile { type file slave.pcm "null" format raw
+ *                  file "|while :; do dd bs=4096 count=1 of=/dev/null; sleep 0.1; done" }
+ *   pcm.slow { type shm server bench pcm slowfile }
+ *
+ *   aserver-bench -D bench -S slow
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+static const char *device = "bench";
+static const char *slow_device;
+static unsigned int max_streams = 32;
+static unsigned int period_us = 2000;
+static unsigned int seconds = 2;
+
+static pthread_barrier_t barrier;
+
+struct stream {
+	pthread_t thread;
+	int err;
+	unsigned long periods;
+	unsigned long misses;
+	long max_us;
+};
+
+static long ts_diff_us(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000L +
+		(a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+static void ts_add_us(struct timespec *ts, long us)
+{
+	ts->tv_nsec += us * 1000;
+	while (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+static void *stream_thread(void *arg)
+{
+	struct stream *s = arg;
+	struct timespec next, end, now;
+	snd_pcm_uframes_t frames = 48 * period_us / 1000;
+	snd_pcm_t *pcm = NULL;
+	short *buf;
+	long us;
+	int err;
+
+	buf = calloc(frames, 2 * sizeof(*buf));
+	err = buf ? snd_pcm_open(&pcm, device, SND_PCM_STREAM_PLAYBACK, 0) : -ENOMEM;
+	if (err >= 0)
+		err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					 SND_PCM_ACCESS_RW_INTERLEAVED, 2, 48000,
+					 0, period_us * 4);
+	s->err = err;
+	pthread_barrier_wait(&barrier);
+	if (err < 0)
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	end = next;
+	end.tv_sec += seconds;
+	while (ts_diff_us(&end, &next) > 0) {
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		err = snd_pcm_writei(pcm, buf, frames);
+		if (err < 0)
+			snd_pcm_prepare(pcm);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		us = ts_diff_us(&now, &next);
+		if (us > s->max_us)
+			s->max_us = us;
+		s->periods++;
+		ts_add_us(&next, period_us);
+		if (ts_diff_us(&now, &next) > 0) {
+			/* skip the periods lost meanwhile */
+			s->misses++;
+			while (ts_diff_us(&now, &next) > 0)
+				ts_add_us(&next, period_us);
+		}
+	}
+ out:
+	if (pcm)
+		snd_pcm_close(pcm);
+	free(buf);
+	return NULL;
+}
+
+/* the slow stream, never joined */
+static void *slow_thread(void *arg)
+{
+	snd_pcm_t *pcm = arg;
+	snd_pcm_uframes_t frames = 48 * period_us / 1000;
+	short *buf = calloc(frames, 2 * sizeof(*buf));
+
+	if (!buf)
+		return NULL;
+	for (;;)
+		if (snd_pcm_writei(pcm, buf, frames) < 0)
+			snd_pcm_prepare(pcm);
+	return NULL;
+}
+
+static int start_slow(void)
+{
+	pthread_t thread;
+	snd_pcm_t *pcm;
+	int err;
+
+	err = snd_pcm_open(&pcm, slow_device, SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+				 SND_PCM_ACCESS_RW_INTERLEAVED, 2, 48000,
+				 0, period_us * 4);
+	if (err < 0)
+		return err;
+	err = pthread_create(&thread, NULL, slow_thread, pcm);
+	if (err)
+		return -err;
+	pthread_detach(thread);
+	return 0;
+}
+
+static int run_level(unsigned int count)
+{
+	struct stream *streams = calloc(count, sizeof(*streams));
+	unsigned long periods = 0, misses = 0;
+	long max_us = 0;
+	unsigned int i;
+	int err = 0;
+
+	if (!streams)
+		return -ENOMEM;
+	pthread_barrier_init(&barrier, NULL, count);
+	for (i = 0; i < count; i++)
+		pthread_create(&streams[i].thread, NULL, stream_thread, &streams[i]);
+	for (i = 0; i < count; i++) {
+		pthread_join(streams[i].thread, NULL);
+		if (streams[i].err < 0)
+			err = streams[i].err;
+		periods += streams[i].periods;
+		misses += streams[i].misses;
+		if (streams[i].max_us > max_us)
+			max_us = streams[i].max_us;
+	}
+	pthread_barrier_destroy(&barrier);
+	free(streams);
+	if (err < 0) {
+		fprintf(stderr, "%u streams: %s\n", count, snd_strerror(err));
+		return err;
+	}
+	printf("%4u streams  %8lu periods  %6lu missed  max write %6ld us\n",
+	       count, periods, misses, max_us);
+	return misses ? 0 : 1;
+}
+
+static void usage(void)
+{
+	printf("Usage: aserver-bench [options]\n"
+	       "  -D <name>      shm PCM to open (default %s)\n"
+	       "  -S <name>      PCM of an additional slow stream\n"
+	       "  -n <count>     maximal number of streams (default %u)\n"
+	       "  -p <us>        period time (default %u)\n"
+	       "  -t <seconds>   duration of each level (default %u)\n",
+	       device, max_streams, period_us, seconds);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int count, sustained = 0;
+	int c, err;
+
+	while ((c = getopt(argc, argv, "D:S:n:p:t:h")) >= 0) {
+		switch (c) {
+		case 'D':
+			device = optarg;
+			break;
+		case 'S':
+			slow_device = optarg;
+			break;
+		case 'n':
+			max_streams = atoi(optarg);
+			break;
+		case 'p':
+			period_us = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (!max_streams || period_us < 1000 || !seconds) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (slow_device) {
+		err = start_slow();
+		if (err < 0) {
+			fprintf(stderr, "%s: %s\n", slow_device, snd_strerror(err));
+			return EXIT_FAILURE;
+		}
+	}
+	for (count = 1; count <= max_streams; count *= 2) {
+		err = run_level(count);
+		if (err < 0)
+			return EXIT_FAILURE;
+		if (!err)
+			break;
+		sustained = count;
+	}
+	printf("sustained: %u streams with a period of %u us\n",
+	       sustained, period_us);
+	return EXIT_SUCCESS;
+}
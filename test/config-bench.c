@@ -0,0 +1,491 @@
+/*
+ * benchmark for the configuration and the plugin graph setup
+ *
+ * Times the configuration work an application pays before the first
+ * sample, each case run several times, as the mean and the fastest run:
+ *
+ *   - load/cards/FILE: parsing of each cards/ file of the config directory,
+ *   - load/user/NAME, load/file/PATH: typical user configs, and the given
+ *     ones (-f),
+ *   - update/cold, update/nochange: snd_config_update_r() from scratch and
+ *     with nothing changed,
+ *   - pcm-open/NAME: snd_pcm_open() and snd_pcm_close() of the standard
+ *     chains and of the given PCMs (-D),
+ *   - hctl-load/COUNT: snd_hctl_load() of a synthetic ctl plugin with the
+ *     given number of elements (-e),
+ *   - ucm-open/CARD: snd_use_case_mgr_open() and close (-u).
+ *
+ * A case failing (e.g. the PCMs needing a card) is reported with its error.
+ * With -m, the results are printed as tab separated values, one case per
+ * line, for the comparisons between builds:
+ *
+ *   config-bench -m > before.tsv
+ *   config-bench -n 20 -u hw:0 -D plug:null -f ~/.asoundrc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+#include "../include/control_external.h"
+#include "../include/use-case.h"
+
+#define MAX_ARGS	16
+
+static unsigned int runs = 100;
+static int machine;
+static unsigned int ctl_elems = 256;
+static const char *files[MAX_ARGS];
+static unsigned int nfiles;
+static const char *pcms[MAX_ARGS];
+static unsigned int npcms;
+static const char *ucm_cards[MAX_ARGS];
+static unsigned int nucm;
+
+static const char *const std_pcms[] = {
+	"null", "plug:null", "default", "plug:default", "dmix", "surround51",
+};
+
+static const struct {
+	const char *name;
+	const char *conf;
+} user_confs[] = {
+	{ "default-card",
+	  "defaults.pcm.card 1\n"
+	  "defaults.ctl.card 1\n" },
+	{ "dmix-plug",
+	  "pcm.!default { type plug slave.pcm \"mixed\" }\n"
+	  "pcm.mixed {\n"
+	  "	type dmix\n"
+	  "	ipc_key 1024\n"
+	  "	slave { pcm \"hw:0,0\" period_time 0 period_size 1024\n"
+	  "		buffer_size 4096 rate 48000 }\n"
+	  "	bindings { 0 0 1 1 }\n"
+	  "}\n"
+	  "ctl.!default { type hw card 0 }\n" },
+	{ "softvol-asym",
+	  "pcm.!default {\n"
+	  "	type asym\n"
+	  "	playback.pcm { type plug slave.pcm \"boosted\" }\n"
+	  "	capture.pcm { type plug slave.pcm \"dsnoop:0\" }\n"
+	  "}\n"
+	  "pcm.boosted {\n"
+	  "	type softvol\n"
+	  "	slave.pcm \"dmix:0\"\n"
+	  "	control { name \"Pre-Amp\" card 0 }\n"
+	  "	min_dB -5.0\n"
+	  "	max_dB 20.0\n"
+	  "	resolution 6\n"
+	  "}\n" },
+	{ "multi-route",
+	  "pcm.both {\n"
+	  "	type route\n"
+	  "	slave.pcm { type multi\n"
+	  "		slaves.a { pcm \"hw:0\" channels 2 }\n"
+	  "		slaves.b { pcm \"hw:1\" channels 2 }\n"
+	  "		bindings.0 { slave a channel 0 }\n"
+	  "		bindings.1 { slave a channel 1 }\n"
+	  "		bindings.2 { slave b channel 0 }\n"
+	  "		bindings.3 { slave b channel 1 } }\n"
+	  "	ttable.0.0 1\n"
+	  "	ttable.1.1 1\n"
+	  "	ttable.0.2 1\n"
+	  "	ttable.1.3 1\n"
+	  "}\n" },
+};
+
+struct result {
+	double sum;
+	long long min;
+	unsigned int count;
+	int err;
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report(const char *name, const struct result *r)
+{
+	if (machine) {
+		if (r->err < 0)
+			printf("%s\t0\t0\t%u\t%s\n", name, r->count,
+			       snd_strerror(r->err));
+		else
+			printf("%s\t%.0f\t%lld\t%u\tok\n", name,
+			       r->sum / r->count, r->min, r->count);
+		return;
+	}
+	if (r->err < 0)
+		printf("%-40s %s\n", name, snd_strerror(r->err));
+	else
+		printf("%-40s %10.1f us  (min %10.1f us)\n", name,
+		       r->sum / r->count / 1000.0, r->min / 1000.0);
+}
+
+/* a case times its own part of the work in *ns */
+typedef int (*bench_fn)(const void *arg, long long *ns);
+
+static void run(const char *name, bench_fn fn, const void *arg)
+{
+	struct result r = { 0, 0, 0, 0 };
+	long long ns;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < runs; i++) {
+		err = fn(arg, &ns);
+		if (err < 0) {
+			r.err = err;
+			break;
+		}
+		if (!r.count || ns < r.min)
+			r.min = ns;
+		r.sum += ns;
+		r.count++;
+	}
+	report(name, &r);
+}
+
+static int load_input(snd_input_t *in, long long *ns)
+{
+	snd_config_t *top;
+	long long start;
+	int err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	start = now_ns();
+	err = snd_config_load(top, in);
+	*ns = now_ns() - start;
+	snd_config_delete(top);
+	return err;
+}
+
+static int bench_load_file(const void *arg, long long *ns)
+{
+	snd_input_t *in;
+	int err;
+
+	err = snd_input_stdio_open(&in, arg, "r");
+	if (err < 0)
+		return err;
+	err = load_input(in, ns);
+	snd_input_close(in);
+	return err;
+}
+
+static int bench_load_buffer(const void *arg, long long *ns)
+{
+	snd_input_t *in;
+	int err;
+
+	err = snd_input_buffer_open(&in, arg, -1);
+	if (err < 0)
+		return err;
+	err = load_input(in, ns);
+	snd_input_close(in);
+	return err;
+}
+
+static int bench_update_cold(const void *arg ATTRIBUTE_UNUSED, long long *ns)
+{
+	snd_config_t *top = NULL;
+	snd_config_update_t *update = NULL;
+	long long start;
+	int err;
+
+	start = now_ns();
+	err = snd_config_update_r(&top, &update, NULL);
+	*ns = now_ns() - start;
+	if (top)
+		snd_config_delete(top);
+	if (update)
+		snd_config_update_free(update);
+	return err;
+}
+
+static snd_config_t *warm_top;
+static snd_config_update_t *warm_update;
+
+static int bench_update_nochange(const void *arg ATTRIBUTE_UNUSED, long long *ns)
+{
+	long long start;
+	int err;
+
+	start = now_ns();
+	err = snd_config_update_r(&warm_top, &warm_update, NULL);
+	*ns = now_ns() - start;
+	return err;
+}
+
+static int bench_pcm_open(const void *arg, long long *ns)
+{
+	snd_pcm_t *pcm;
+	long long start;
+	int err;
+
+	start = now_ns();
+	err = snd_pcm_open(&pcm, arg, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
+	if (err < 0)
+		return err;
+	snd_pcm_close(pcm);
+	*ns = now_ns() - start;
+	return 0;
+}
+
+/*
+ * synthetic ctl plugin: ctl_elems stereo integer elements, all reading 0
+ */
+static int synth_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return ctl_elems;
+}
+
+static int synth_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			   unsigned int offset, snd_ctl_elem_id_t *id)
+{
+	char name[44];
+
+	snprintf(name, sizeof(name), "Bench %u Playback Volume", offset);
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, name);
+	return 0;
+}
+
+static snd_ctl_ext_key_t synth_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					 const snd_ctl_elem_id_t *id)
+{
+	unsigned int idx;
+
+	if (sscanf(snd_ctl_elem_id_get_name(id), "Bench %u", &idx) != 1 ||
+	    idx >= ctl_elems)
+		return SND_CTL_EXT_KEY_NOT_FOUND;
+	return idx;
+}
+
+static int synth_get_attribute(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			       snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+			       int *type, unsigned int *acc, unsigned int *count)
+{
+	*type = SND_CTL_ELEM_TYPE_INTEGER;
+	*acc = SND_CTL_EXT_ACCESS_READWRITE;
+	*count = 2;
+	return 0;
+}
+
+static int synth_get_integer_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				  snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				  long *imin, long *imax, long *istep)
+{
+	*imin = 0;
+	*imax = 100;
+	*istep = 1;
+	return 0;
+}
+
+static int synth_read_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key ATTRIBUTE_UNUSED, long *value)
+{
+	value[0] = value[1] = 0;
+	return 0;
+}
+
+static const snd_ctl_ext_callback_t synth_callback = {
+	.elem_count = synth_elem_count,
+	.elem_list = synth_elem_list,
+	.find_elem = synth_find_elem,
+	.get_attribute = synth_get_attribute,
+	.get_integer_info = synth_get_integer_info,
+	.read_integer = synth_read_integer,
+};
+
+static int bench_hctl_load(const void *arg ATTRIBUTE_UNUSED, long long *ns)
+{
+	snd_ctl_ext_t ext;
+	snd_hctl_t *hctl;
+	long long start;
+	int err;
+
+	memset(&ext, 0, sizeof(ext));
+	ext.version = SND_CTL_EXT_VERSION;
+	ext.card_idx = -1;
+	strcpy(ext.id, "Bench");
+	strcpy(ext.driver, "Bench");
+	strcpy(ext.name, "Bench");
+	strcpy(ext.longname, "Synthetic bench controls");
+	strcpy(ext.mixername, "Bench");
+	ext.poll_fd = -1;
+	ext.callback = &synth_callback;
+	err = snd_ctl_ext_create(&ext, "bench", 0);
+	if (err < 0)
+		return err;
+	err = snd_hctl_open_ctl(&hctl, ext.handle);
+	if (err < 0) {
+		snd_ctl_close(ext.handle);
+		return err;
+	}
+	start = now_ns();
+	err = snd_hctl_load(hctl);
+	*ns = now_ns() - start;
+	snd_hctl_close(hctl);
+	return err;
+}
+
+static int bench_ucm_open(const void *arg, long long *ns)
+{
+	snd_use_case_mgr_t *uc;
+	long long start;
+	int err;
+
+	start = now_ns();
+	err = snd_use_case_mgr_open(&uc, arg);
+	if (err < 0)
+		return err;
+	snd_use_case_mgr_close(uc);
+	*ns = now_ns() - start;
+	return 0;
+}
+
+static int cards_filter(const struct dirent *d)
+{
+	size_t len = strlen(d->d_name);
+
+	return len > 5 && !strcmp(d->d_name + len - 5, ".conf");
+}
+
+static void run_cards(const char *confdir)
+{
+	struct dirent **names;
+	char dir[256], path[512], name[300];
+	int i, n;
+
+	snprintf(dir, sizeof(dir), "%s/cards", confdir);
+	n = scandir(dir, &names, cards_filter, alphasort);
+	if (n < 0) {
+		fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+		snprintf(name, sizeof(name), "load/cards/%s", names[i]->d_name);
+		run(name, bench_load_file, path);
+		free(names[i]);
+	}
+	free(names);
+}
+
+static void usage(void)
+{
+	printf("Usage: config-bench [options]\n"
+	       "  -n <runs>      runs of each case (default %u)\n"
+	       "  -d <dir>       configuration directory (default $ALSA_CONFIG_DIR)\n"
+	       "  -f <file>      user configuration file to load, repeatable\n"
+	       "  -D <name>      PCM to open besides the standard ones, repeatable\n"
+	       "  -e <count>     elements of the synthetic ctl (default %u)\n"
+	       "  -u <card>      UCM card to open, repeatable\n"
+	       "  -m             tab separated output\n",
+	       runs, ctl_elems);
+}
+
+static int add_arg(const char **args, unsigned int *count, const char *arg)
+{
+	if (*count >= MAX_ARGS)
+		return -1;
+	args[(*count)++] = arg;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *confdir = getenv("ALSA_CONFIG_DIR");
+	char name[300];
+	unsigned int i;
+	int c, err = 0;
+
+	while ((c = getopt(argc, argv, "n:d:f:D:e:u:mh")) >= 0) {
+		switch (c) {
+		case 'n':
+			runs = atoi(optarg);
+			break;
+		case 'd':
+			confdir = optarg;
+			break;
+		case 'f':
+			err = add_arg(files, &nfiles, optarg);
+			break;
+		case 'D':
+			err = add_arg(pcms, &npcms, optarg);
+			break;
+		case 'e':
+			ctl_elems = atoi(optarg);
+			break;
+		case 'u':
+			err = add_arg(ucm_cards, &nucm, optarg);
+			break;
+		case 'm':
+			machine = 1;
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+		if (err < 0) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (!runs) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	if (!confdir)
+		confdir = "/usr/share/alsa";
+	/* the library reads it at the first load */
+	setenv("ALSA_CONFIG_DIR", confdir, 1);
+
+	if (machine)
+		printf("# case\tmean_ns\tmin_ns\truns\tstatus\n");
+	run_cards(confdir);
+	for (i = 0; i < sizeof(user_confs) / sizeof(user_confs[0]); i++) {
+		snprintf(name, sizeof(name), "load/user/%s", user_confs[i].name);
+		run(name, bench_load_buffer, user_confs[i].conf);
+	}
+	for (i = 0; i < nfiles; i++) {
+		snprintf(name, sizeof(name), "load/file/%s", files[i]);
+		run(name, bench_load_file, files[i]);
+	}
+
+	run("update/cold", bench_update_cold, NULL);
+	run("update/nochange", bench_update_nochange, NULL);
+	if (warm_top)
+		snd_config_delete(warm_top);
+	if (warm_update)
+		snd_config_update_free(warm_update);
+
+	for (i = 0; i < sizeof(std_pcms) / sizeof(std_pcms[0]); i++) {
+		snprintf(name, sizeof(name), "pcm-open/%s", std_pcms[i]);
+		run(name, bench_pcm_open, std_pcms[i]);
+	}
+	for (i = 0; i < npcms; i++) {
+		snprintf(name, sizeof(name), "pcm-open/%s", pcms[i]);
+		run(name, bench_pcm_open, pcms[i]);
+	}
+
+	snprintf(name, sizeof(name), "hctl-load/%u", ctl_elems);
+	run(name, bench_hctl_load, NULL);
+
+	for (i = 0; i < nucm; i++) {
+		snprintf(name, sizeof(name), "ucm-open/%s", ucm_cards[i]);
+		run(name, bench_ucm_open, ucm_cards[i]);
+	}
+	return EXIT_SUCCESS;
+}
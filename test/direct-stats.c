@@ -0,0 +1,166 @@
+/*
+ * CPU time of the shared mixes of the direct plugins, per card
+ *
+ * Attaches to dmix, dsnoop or dshare instances and prints, every interval,
+ * the frames their clients mixed or copied, the share of one CPU it took,
+ * and the work of the server forwarding the shared wakeups, e.g.
+ *
+ *   direct-stats dmix:0 dmix:1
+ *   direct-stats -C dsnoop:0
+ *
+ * The tool is a client of each instance itself: it creates the instance
+ * (and opens its slave) when no other client runs.  With -n 0, the totals
+ * since the creation of the instances are printed once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+#include "../include/pcm_plugin.h"
+
+struct instance {
+	const char *name;
+	snd_pcm_t *pcm;
+	char card[64];
+	snd_pcm_direct_stats_t last;
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int open_instance(struct instance *in, snd_pcm_stream_t stream)
+{
+	snd_pcm_info_t *info;
+	char *name;
+	int err, card;
+
+	err = snd_pcm_open(&in->pcm, in->name, stream, SND_PCM_NONBLOCK);
+	if (err < 0)
+		return err;
+	snprintf(in->card, sizeof(in->card), "-");
+	snd_pcm_info_alloca(&info);
+	if (snd_pcm_info(in->pcm, info) >= 0) {
+		card = snd_pcm_info_get_card(info);
+		if (card >= 0 && snd_card_get_name(card, &name) >= 0) {
+			snprintf(in->card, sizeof(in->card), "%d %s", card, name);
+			free(name);
+		}
+	}
+	return snd_pcm_direct_stats_total(in->pcm, &in->last);
+}
+
+static void print_total(struct instance *in, const snd_pcm_direct_stats_t *t)
+{
+	printf("%-12s %-24s %3u clients  %12llu frames  %10llu us",
+	       in->name, in->card, t->clients, t->frames, t->transfer_nsec / 1000);
+	if (t->frames)
+		printf("  %6llu ns/frame", t->transfer_nsec / t->frames);
+	if (t->wakeups)
+		printf("  %llu wakeups %llu us", t->wakeups, t->wakeup_nsec / 1000);
+	printf("\n");
+}
+
+static void print_delta(struct instance *in, const snd_pcm_direct_stats_t *t,
+			long long elapsed)
+{
+	unsigned long long frames = t->frames - in->last.frames;
+	unsigned long long nsec = t->transfer_nsec - in->last.transfer_nsec;
+	unsigned long long wakeups = t->wakeups - in->last.wakeups;
+	unsigned long long wnsec = t->wakeup_nsec - in->last.wakeup_nsec;
+
+	printf("%-12s %-24s %3u clients  %9.0f frames/s  cpu %6.3f%%",
+	       in->name, in->card, t->clients,
+	       frames * 1e9 / elapsed, nsec * 100.0 / elapsed);
+	if (frames)
+		printf("  %6llu ns/frame", nsec / frames);
+	if (wakeups)
+		printf("  server %5.0f wakeups/s cpu %6.3f%%",
+		       wakeups * 1e9 / elapsed, wnsec * 100.0 / elapsed);
+	printf("\n");
+	in->last = *t;
+}
+
+static void usage(void)
+{
+	printf("Usage: direct-stats [options] PCM...\n"
+	       "  -C             open the capture stream (dsnoop)\n"
+	       "  -i <ms>        interval (default 1000)\n"
+	       "  -n <count>     number of intervals, 0 = totals once (default 10)\n");
+}
+
+int main(int argc, char **argv)
+{
+	snd_pcm_stream_t stream = SND_PCM_STREAM_PLAYBACK;
+	unsigned int interval_ms = 1000, count = 10, i, n;
+	struct instance *ins;
+	snd_pcm_direct_stats_t t;
+	struct timespec ts;
+	long long last, now;
+	int c, err, ret = EXIT_SUCCESS;
+
+	while ((c = getopt(argc, argv, "Ci:n:h")) >= 0) {
+		switch (c) {
+		case 'C':
+			stream = SND_PCM_STREAM_CAPTURE;
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind >= argc || !interval_ms) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	n = argc - optind;
+	ins = calloc(n, sizeof(*ins));
+	if (!ins)
+		return EXIT_FAILURE;
+	for (i = 0; i < n; i++) {
+		ins[i].name = argv[optind + i];
+		err = open_instance(&ins[i], stream);
+		if (err < 0) {
+			fprintf(stderr, "%s: %s\n", ins[i].name, snd_strerror(err));
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	if (!count) {
+		for (i = 0; i < n; i++)
+			print_total(&ins[i], &ins[i].last);
+		goto out;
+	}
+	last = now_ns();
+	while (count--) {
+		ts.tv_sec = interval_ms / 1000;
+		ts.tv_nsec = (interval_ms % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+		now = now_ns();
+		for (i = 0; i < n; i++)
+			if (snd_pcm_direct_stats_total(ins[i].pcm, &t) >= 0)
+				print_delta(&ins[i], &t, now - last);
+		last = now;
+	}
+
+ out:
+	for (i = 0; i < n; i++)
+		if (ins[i].pcm)
+			snd_pcm_close(ins[i].pcm);
+	free(ins);
+	return ret;
+}
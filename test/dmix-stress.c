@@ -0,0 +1,223 @@
+/*
+ * multi-client stress test for dmix
+ *
+ * Forks the given number of client processes which all play a sine wave
+ * to the same PCM device for the given time.  Each client measures the
+ * CPU time spent inside snd_pcm_writei() (which includes the mixing)
+ * and reports it together with the number of underruns.
+ *
+ * Running the test with an increasing number of clients against
+ * two dmix definitions, one with "lockless_mix yes" and one without,
+ * shows how the mixing cost scales with the number of concurrent clients:
+ *
+ *   dmix-stress -D plug:dmix_locked -n 1
+ *   dmix-stress -D plug:dmix_locked -n 8
+ *   dmix-stress -D plug:dmix_lockless -n 8
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../include/asoundlib.h"
+
+#define MAX_CLIENTS	64
+
+static const char *pcmdev = "default";
+static int num_clients = 4;
+static int seconds = 5;
+static int periodsize = 1024;
+static int bufsize = 4096;
+static int channels = 2;
+static int rate = 48000;
+
+struct client_result {
+	double cpu_usec;
+	unsigned long frames;
+	unsigned int xruns;
+	int err;
+};
+
+static double timespec_usec(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000.0 + ts->tv_nsec / 1000.0;
+}
+
+static int setup_params(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t size;
+
+	snd_pcm_hw_params_alloca(&hw);
+	if (snd_pcm_hw_params_any(pcm, hw) < 0 ||
+	    snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED) < 0 ||
+	    snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16) < 0 ||
+	    snd_pcm_hw_params_set_channels(pcm, hw, channels) < 0 ||
+	    snd_pcm_hw_params_set_rate(pcm, hw, rate, 0) < 0)
+		return -EINVAL;
+	size = periodsize;
+	snd_pcm_hw_params_set_period_size_near(pcm, hw, &size, 0);
+	size = bufsize;
+	snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &size);
+	return snd_pcm_hw_params(pcm, hw);
+}
+
+static void run_client(int idx, struct client_result *res)
+{
+	snd_pcm_t *pcm;
+	struct timespec t0, t1;
+	short *buf;
+	double phase = 0, step;
+	unsigned long total;
+	int i, c, err;
+
+	memset(res, 0, sizeof(*res));
+	err = snd_pcm_open(&pcm, pcmdev, SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0) {
+		res->err = err;
+		return;
+	}
+	err = setup_params(pcm);
+	if (err < 0) {
+		res->err = err;
+		snd_pcm_close(pcm);
+		return;
+	}
+	buf = malloc(periodsize * channels * sizeof(*buf));
+	if (!buf) {
+		res->err = -ENOMEM;
+		snd_pcm_close(pcm);
+		return;
+	}
+	/* a different tone for each client, at low level to avoid clipping */
+	step = 2 * M_PI * (220.0 * (idx + 1)) / rate;
+	total = (unsigned long)seconds * rate;
+	while (res->frames < total) {
+		for (i = 0; i < periodsize; i++) {
+			short val = 1024 * sin(phase);
+			for (c = 0; c < channels; c++)
+				buf[i * channels + c] = val;
+			phase += step;
+		}
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+		err = snd_pcm_writei(pcm, buf, periodsize);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+		res->cpu_usec += timespec_usec(&t1) - timespec_usec(&t0);
+		if (err == -EPIPE) {
+			res->xruns++;
+			err = snd_pcm_prepare(pcm);
+		}
+		if (err < 0) {
+			res->err = err;
+			break;
+		}
+		res->frames += periodsize;
+	}
+	snd_pcm_drop(pcm);
+	snd_pcm_close(pcm);
+	free(buf);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dmix-stress [-options]\n");
+	fprintf(stderr, "  -D str  Set device name\n");
+	fprintf(stderr, "  -n val  Set number of client processes\n");
+	fprintf(stderr, "  -t val  Set running time (in seconds)\n");
+	fprintf(stderr, "  -r val  Set sample rate\n");
+	fprintf(stderr, "  -c val  Set number of channels\n");
+	fprintf(stderr, "  -p val  Set period size (in frame)\n");
+	fprintf(stderr, "  -b val  Set buffer size (in frame)\n");
+}
+
+int main(int argc, char **argv)
+{
+	int pipes[MAX_CLIENTS][2];
+	pid_t pids[MAX_CLIENTS];
+	struct client_result res;
+	double cpu_total = 0;
+	unsigned long frames_total = 0;
+	unsigned int xruns_total = 0;
+	int i, c, failed = 0;
+
+	while ((c = getopt(argc, argv, "D:n:t:r:c:p:b:")) >= 0) {
+		switch (c) {
+		case 'D':
+			pcmdev = optarg;
+			break;
+		case 'n':
+			num_clients = atoi(optarg);
+			if (num_clients < 1 || num_clients > MAX_CLIENTS) {
+				fprintf(stderr, "invalid number of clients\n");
+				return 1;
+			}
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'p':
+			periodsize = atoi(optarg);
+			break;
+		case 'b':
+			bufsize = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	for (i = 0; i < num_clients; i++) {
+		if (pipe(pipes[i]) < 0) {
+			perror("pipe");
+			return 1;
+		}
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (pids[i] == 0) {
+			close(pipes[i][0]);
+			run_client(i, &res);
+			if (write(pipes[i][1], &res, sizeof(res)) != sizeof(res))
+				_exit(1);
+			_exit(0);
+		}
+		close(pipes[i][1]);
+	}
+
+	for (i = 0; i < num_clients; i++) {
+		if (read(pipes[i][0], &res, sizeof(res)) != sizeof(res)) {
+			fprintf(stderr, "client %d: no result\n", i);
+			failed++;
+		} else if (res.err < 0) {
+			fprintf(stderr, "client %d: error %s\n", i, snd_strerror(res.err));
+			failed++;
+		} else {
+			printf("client %2d: %lu frames, %.1f usec cpu, %.3f usec/frame, %u xruns\n",
+			       i, res.frames, res.cpu_usec,
+			       res.frames ? res.cpu_usec / res.frames : 0.0, res.xruns);
+			cpu_total += res.cpu_usec;
+			frames_total += res.frames;
+			xruns_total += res.xruns;
+		}
+		close(pipes[i][0]);
+		waitpid(pids[i], NULL, 0);
+	}
+
+	if (frames_total)
+		printf("total: %d clients, %.3f usec/frame average, %u xruns\n",
+		       num_clients - failed, cpu_total / frames_total, xruns_total);
+	return failed ? 1 : 0;
+}
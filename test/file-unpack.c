@@ -0,0 +1,238 @@
+/*
+ * decoder for the lossless format of the file plugin
+ *
+ * Converts a file written with "format lossless" back to a WAV file,
+ * or to raw samples with -r:
+ *
+ *   file-unpack capture.alsl capture.wav
+ *   file-unpack -r capture.alsl capture.raw
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "../include/asoundlib.h"
+
+#define LOSSLESS_ESCAPE		24
+#define LOSSLESS_VERBATIM	7
+
+struct bits {
+	const unsigned char *ptr, *end;
+	uint64_t acc;
+	unsigned int nbits;
+};
+
+static int get_bit_error;
+
+static uint32_t get_bits(struct bits *b, unsigned int n)
+{
+	uint32_t val;
+
+	if (!n)
+		return 0;
+	while (b->nbits < n) {
+		if (b->ptr >= b->end) {
+			get_bit_error = 1;
+			return 0;
+		}
+		b->acc = (b->acc << 8) | *b->ptr++;
+		b->nbits += 8;
+	}
+	b->nbits -= n;
+	val = b->acc >> b->nbits;
+	if (n < 32)
+		val &= (1U << n) - 1;
+	return val;
+}
+
+static int32_t get_sample(struct bits *b, unsigned int width)
+{
+	uint32_t v = get_bits(b, width);
+
+	if (width < 32)
+		return (int32_t)(v << (32 - width)) >> (32 - width);
+	return (int32_t)v;
+}
+
+static uint32_t get_le(const unsigned char *p, unsigned int bytes)
+{
+	uint32_t val = 0;
+
+	while (bytes--)
+		val = (val << 8) | p[bytes];
+	return val;
+}
+
+static void put_le(FILE *out, uint32_t val, unsigned int bytes)
+{
+	while (bytes--) {
+		fputc(val & 0xff, out);
+		val >>= 8;
+	}
+}
+
+static int decode_channel(struct bits *b, int32_t *x, unsigned int n,
+			  unsigned int width)
+{
+	unsigned int order, k, i, q;
+	uint64_t u;
+	int64_t e, p;
+
+	order = get_bits(b, 3);
+	if (order == LOSSLESS_VERBATIM) {
+		for (i = 0; i < n; i++)
+			x[i] = get_sample(b, width);
+		return get_bit_error ? -1 : 0;
+	}
+	if (order > 3)
+		return -1;
+	k = get_bits(b, 5);
+	for (i = 0; i < order && i < n; i++)
+		x[i] = get_sample(b, width);
+	for (; i < n; i++) {
+		for (q = 0; q < LOSSLESS_ESCAPE && get_bits(b, 1); q++)
+			;
+		if (q == LOSSLESS_ESCAPE) {
+			u = (uint64_t)get_bits(b, 8) << 32;
+			u |= get_bits(b, 32);
+		} else
+			u = ((uint64_t)q << k) | get_bits(b, k);
+		e = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+		switch (order) {
+		case 0:
+			p = 0;
+			break;
+		case 1:
+			p = x[i - 1];
+			break;
+		case 2:
+			p = 2 * (int64_t)x[i - 1] - x[i - 2];
+			break;
+		default:
+			p = 3 * (int64_t)x[i - 1] - 3 * (int64_t)x[i - 2] + x[i - 3];
+			break;
+		}
+		x[i] = (int32_t)(p + e);
+	}
+	return get_bit_error ? -1 : 0;
+}
+
+static void usage(void)
+{
+	printf("Usage: file-unpack [-r] INPUT OUTPUT\n"
+	       "  -r   write raw samples instead of WAV\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char header[24], bh[8], *payload = NULL;
+	unsigned int channels, rate, block, width, bytes, chn, i;
+	snd_pcm_format_t format;
+	int32_t *samples;
+	uint64_t total = 0;
+	FILE *in, *out;
+	int raw = 0, c;
+
+	while ((c = getopt(argc, argv, "rh")) >= 0) {
+		switch (c) {
+		case 'r':
+			raw = 1;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (argc - optind != 2) {
+		usage();
+		return 1;
+	}
+	in = fopen(argv[optind], "rb");
+	if (!in) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (fread(header, sizeof(header), 1, in) != 1 ||
+	    memcmp(header, "ALSALOSS", 8) || get_le(header + 8, 2) != 1) {
+		fprintf(stderr, "%s: not a lossless file\n", argv[optind]);
+		return 1;
+	}
+	channels = get_le(header + 10, 2);
+	rate = get_le(header + 12, 4);
+	format = get_le(header + 16, 4);
+	block = get_le(header + 20, 4);
+	width = snd_pcm_format_width(format);
+	bytes = snd_pcm_format_physical_width(format) / 8;
+	if (!channels || !block || (bytes != 2 && bytes != 4)) {
+		fprintf(stderr, "%s: unsupported stream\n", argv[optind]);
+		return 1;
+	}
+	samples = malloc((size_t)block * channels * sizeof(*samples));
+	out = fopen(argv[optind + 1], "wb");
+	if (!samples || !out) {
+		perror(argv[optind + 1]);
+		return 1;
+	}
+	if (!raw)
+		fseek(out, 44, SEEK_SET);
+
+	while (fread(bh, sizeof(bh), 1, in) == 1) {
+		unsigned int frames = get_le(bh, 4), size = get_le(bh + 4, 4);
+		struct bits b;
+
+		if (frames > block) {
+			fprintf(stderr, "corrupt block\n");
+			return 1;
+		}
+		payload = realloc(payload, size);
+		if (!payload || fread(payload, 1, size, in) != size) {
+			fprintf(stderr, "truncated block\n");
+			return 1;
+		}
+		memset(&b, 0, sizeof(b));
+		b.ptr = payload;
+		b.end = payload + size;
+		for (chn = 0; chn < channels; chn++) {
+			if (decode_channel(&b, samples + (size_t)chn * block,
+					   frames, width) < 0) {
+				fprintf(stderr, "corrupt block\n");
+				return 1;
+			}
+		}
+		for (i = 0; i < frames; i++)
+			for (chn = 0; chn < channels; chn++)
+				put_le(out, samples[(size_t)chn * block + i], bytes);
+		total += frames;
+	}
+
+	if (!raw) {
+		uint64_t len = total * channels * bytes;
+
+		if (len > 0x7fffffff - 0x24)
+			len = 0x7fffffff - 0x24;
+		fseek(out, 0, SEEK_SET);
+		fwrite("RIFF", 4, 1, out);
+		put_le(out, len + 0x24, 4);
+		fwrite("WAVEfmt ", 8, 1, out);
+		put_le(out, 16, 4);
+		put_le(out, 1, 2);
+		put_le(out, channels, 2);
+		put_le(out, rate, 4);
+		put_le(out, rate * channels * bytes, 4);
+		put_le(out, channels * bytes, 2);
+		put_le(out, width, 2);
+		fwrite("data", 4, 1, out);
+		put_le(out, len, 4);
+	}
+	fclose(out);
+	fclose(in);
+	free(payload);
+	free(samples);
+	printf("%llu frames, %u channels, %u Hz, %s\n",
+	       (unsigned long long)total, channels, rate,
+	       snd_pcm_format_name(format));
+	return 0;
+}
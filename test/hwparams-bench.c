@@ -0,0 +1,167 @@
+/*
+ * benchmark for the hw_params negotiation
+ *
+ * Negotiates the usual playback setup on a few plugin chains built on
+ * top of a null PCM and reports the time per negotiation, from
+ * snd_pcm_hw_params_any() to a completed snd_pcm_hw_params(), as the
+ * mean and the fastest run, the latter being less sensitive to the load
+ * of the machine.  The PCM open and close are not included:
+ *
+ *   hwparams-bench
+ *   hwparams-bench -b -n 2000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+static int iterations = 500;
+static int batch;
+static unsigned int rate = 48000;
+static snd_pcm_uframes_t period_size = 1024;
+
+static const struct {
+	const char *name;
+	const char *conf;
+} chains[] = {
+	{ "null",
+	  "pcm.bench { type null }" },
+	{ "plug",
+	  "pcm.bench { type plug slave.pcm { type null } }" },
+	{ "plug-rate",
+	  "pcm.bench { type plug slave.pcm { type rate"
+	  " slave { pcm { type null } rate 44100 } } }" },
+	{ "plug-route-rate",
+	  "pcm.bench { type plug slave.pcm { type route"
+	  " ttable.0.0 1 ttable.1.1 1 slave { pcm { type rate"
+	  " slave { pcm { type null } rate 44100 format S32 } } channels 2 } } }" },
+	{ "deep",
+	  "pcm.bench { type plug slave.pcm { type route"
+	  " ttable.0.0 1 ttable.1.1 1 slave { pcm { type rate"
+	  " slave { pcm { type lfloat slave { pcm { type hooks"
+	  " slave.pcm { type null } } format FLOAT } } rate 44100 format S32 } }"
+	  " channels 2 } } }" },
+};
+
+static double timespec_usec(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000.0 + ts->tv_nsec / 1000.0;
+}
+
+static int negotiate(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t psize = period_size, bsize = period_size * 4;
+	unsigned int r = rate;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	if (batch) {
+		err = snd_pcm_hw_params_set_batch(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED,
+						  SND_PCM_FORMAT_S16, 2, &r,
+						  &psize, &bsize);
+	} else if ((err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0 &&
+		   (err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16)) >= 0 &&
+		   (err = snd_pcm_hw_params_set_channels(pcm, hw, 2)) >= 0 &&
+		   (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &r, 0)) >= 0 &&
+		   (err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &psize, 0)) >= 0)
+		err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &bsize);
+	if (err < 0)
+		return err;
+	return snd_pcm_hw_params(pcm, hw);
+}
+
+static int bench(const char *name, const char *conf)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	snd_pcm_t *pcm;
+	struct timespec start, end;
+	double usec = 0, t, best = 0;
+	int i, err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		goto out;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto out;
+	for (i = 0; i < iterations; i++) {
+		err = snd_pcm_open_lconf(&pcm, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+		if (err < 0)
+			break;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		err = negotiate(pcm);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		snd_pcm_close(pcm);
+		if (err < 0)
+			break;
+		t = timespec_usec(&end) - timespec_usec(&start);
+		usec += t;
+		if (!i || t < best)
+			best = t;
+	}
+	if (err < 0)
+		fprintf(stderr, "%s: %s\n", name, snd_strerror(err));
+	else
+		printf("%-16s %10.1f us (best %.1f us)\n", name,
+		       usec / iterations, best);
+ out:
+	snd_config_delete(top);
+	return err;
+}
+
+static void usage(void)
+{
+	printf("Usage: hwparams-bench [OPTIONS]\n"
+	       "  -n COUNT   negotiations per chain (default %d)\n"
+	       "  -r RATE    requested rate (default %u)\n"
+	       "  -p FRAMES  requested period size (default %lu)\n"
+	       "  -b         use snd_pcm_hw_params_set_batch()\n",
+	       iterations, rate, period_size);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:r:p:bh")) >= 0) {
+		switch (c) {
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'p':
+			period_size = atoi(optarg);
+			break;
+		case 'b':
+			batch = 1;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (iterations < 1 || !rate || !period_size) {
+		usage();
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(chains) / sizeof(chains[0]); i++)
+		bench(chains[i].name, chains[i].conf);
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * throughput benchmark for the integer <-> float conversions
+ *
+ * Plays through an lfloat plugin on top of a null PCM for each of the
+ * S16/S32 <-> FLOAT pairs and reports the conversion throughput in GB/s
+ * of source data.  The null slave costs a little, so the numbers are a
+ * lower bound of the raw conversion speed:
+ *
+ *   lfloat-bench
+ *   lfloat-bench -c 8 -m 1024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+static int channels = 2;
+static int periodsize = 1024;
+static int megabytes = 256;
+
+static const struct {
+	snd_pcm_format_t client;
+	snd_pcm_format_t slave;
+} pairs[] = {
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16 },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S32 },
+};
+
+static double timespec_sec(const struct timespec *ts)
+{
+	return ts->tv_sec + ts->tv_nsec / 1000000000.0;
+}
+
+static int open_pcm(snd_pcm_t **pcm, snd_pcm_format_t client, snd_pcm_format_t slave)
+{
+	char conf[256];
+	snd_config_t *top;
+	snd_input_t *in;
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t size;
+	int err;
+
+	snprintf(conf, sizeof(conf),
+		 "pcm.bench { type lfloat slave { pcm { type null } format %s } }",
+		 snd_pcm_format_name(slave));
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		goto out;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto out;
+	err = snd_pcm_open_lconf(pcm, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		goto out;
+
+	snd_pcm_hw_params_alloca(&hw);
+	size = periodsize * 4;
+	if ((err = snd_pcm_hw_params_any(*pcm, hw)) < 0 ||
+	    (err = snd_pcm_hw_params_set_access(*pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+	    (err = snd_pcm_hw_params_set_format(*pcm, hw, client)) < 0 ||
+	    (err = snd_pcm_hw_params_set_channels(*pcm, hw, channels)) < 0 ||
+	    (err = snd_pcm_hw_params_set_rate(*pcm, hw, 48000, 0)) < 0 ||
+	    (err = snd_pcm_hw_params_set_buffer_size_near(*pcm, hw, &size)) < 0 ||
+	    (err = snd_pcm_hw_params(*pcm, hw)) < 0) {
+		snd_pcm_close(*pcm);
+		goto out;
+	}
+ out:
+	snd_config_delete(top);
+	return err;
+}
+
+static void fill(void *buf, snd_pcm_format_t format, size_t samples)
+{
+	size_t i;
+
+	for (i = 0; i < samples; i++) {
+		int v = (int)(i * 2654435761u) >> 1;
+		switch (format) {
+		case SND_PCM_FORMAT_S16:
+			((int16_t *)buf)[i] = v >> 15;
+			break;
+		case SND_PCM_FORMAT_S32:
+			((int32_t *)buf)[i] = v;
+			break;
+		default:
+			((float *)buf)[i] = v / 1073741824.0f - 1.0f;
+			break;
+		}
+	}
+}
+
+static int bench(snd_pcm_format_t client, snd_pcm_format_t slave)
+{
+	snd_pcm_t *pcm;
+	struct timespec start, end;
+	size_t frame_bytes = snd_pcm_format_physical_width(client) / 8 * channels;
+	size_t total = (size_t)megabytes * 1024 * 1024;
+	size_t done = 0;
+	double sec;
+	void *buf;
+	int err;
+
+	err = open_pcm(&pcm, client, slave);
+	if (err < 0) {
+		fprintf(stderr, "%s -> %s: %s\n", snd_pcm_format_name(client),
+			snd_pcm_format_name(slave), snd_strerror(err));
+		return err;
+	}
+	buf = malloc(frame_bytes * periodsize);
+	if (!buf) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	fill(buf, client, (size_t)periodsize * channels);
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+	while (done < total) {
+		snd_pcm_sframes_t frames = snd_pcm_writei(pcm, buf, periodsize);
+		if (frames < 0) {
+			frames = snd_pcm_recover(pcm, frames, 0);
+			if (frames < 0) {
+				fprintf(stderr, "write error: %s\n", snd_strerror(frames));
+				break;
+			}
+			continue;
+		}
+		done += frames * frame_bytes;
+	}
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+	sec = timespec_sec(&end) - timespec_sec(&start);
+
+	printf("%-8s -> %-8s %8.3f GB/s\n", snd_pcm_format_name(client),
+	       snd_pcm_format_name(slave), sec > 0 ? done / sec / 1e9 : 0);
+	free(buf);
+	snd_pcm_close(pcm);
+	return 0;
+}
+
+static void usage(void)
+{
+	printf("Usage: lfloat-bench [OPTIONS]\n"
+	       "  -c CHANNELS   number of channels (default %d)\n"
+	       "  -p FRAMES     frames per write (default %d)\n"
+	       "  -m MEGABYTES  source data per format pair (default %d)\n",
+	       channels, periodsize, megabytes);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:p:m:h")) >= 0) {
+		switch (c) {
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'p':
+			periodsize = atoi(optarg);
+			break;
+		case 'm':
+			megabytes = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (channels < 1 || periodsize < 1 || megabytes < 1) {
+		usage();
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++)
+		bench(pairs[i].client, pairs[i].slave);
+	return 0;
+}
@@ -247,6 +247,52 @@ static void test_add(void)
 	ALSA_CHECK(snd_config_delete(c1));
 }
 
+/* large compounds are searched through the index of their ids */
+static void test_add_many(void)
+{
+	snd_config_t *c1, *c2, *c3;
+	char id[16];
+	long val;
+	int k;
+
+	ALSA_CHECK(snd_config_top(&c1));
+	for (k = 0; k < 100; k++) {
+		sprintf(id, "n%d", k);
+		ALSA_CHECK(snd_config_imake_integer(&c2, id, k));
+		ALSA_CHECK(snd_config_add(c1, c2));
+	}
+	for (k = 0; k < 100; k++) {
+		sprintf(id, "n%d", k);
+		ALSA_CHECK(snd_config_search(c1, id, &c2));
+		ALSA_CHECK(snd_config_get_integer(c2, &val));
+		TEST_CHECK(val == k);
+	}
+	TEST_CHECK(snd_config_search(c1, "n100", &c2) == -ENOENT);
+	ALSA_CHECK(snd_config_imake_integer(&c3, "n50", 0));
+	TEST_CHECK(snd_config_add(c1, c3) == -EEXIST);
+	ALSA_CHECK(snd_config_set_id(c3, "n100"));
+	ALSA_CHECK(snd_config_search(c1, "n10", &c2));
+	ALSA_CHECK(snd_config_add_after(c2, c3));
+	ALSA_CHECK(snd_config_search(c1, "n100", &c2));
+	TEST_CHECK(c2 == c3);
+	ALSA_CHECK(snd_config_search(c1, "n20", &c2));
+	TEST_CHECK(snd_config_set_id(c2, "n21") == -EEXIST);
+	ALSA_CHECK(snd_config_set_id(c2, "m20"));
+	TEST_CHECK(snd_config_search(c1, "n20", &c3) == -ENOENT);
+	ALSA_CHECK(snd_config_search(c1, "m20", &c3));
+	TEST_CHECK(c2 == c3);
+	ALSA_CHECK(snd_config_delete(c2));
+	TEST_CHECK(snd_config_search(c1, "m20", &c2) == -ENOENT);
+	ALSA_CHECK(snd_config_search(c1, "n30", &c2));
+	ALSA_CHECK(snd_config_remove(c2));
+	TEST_CHECK(snd_config_search(c1, "n30", &c3) == -ENOENT);
+	ALSA_CHECK(snd_config_add(c1, c2));
+	ALSA_CHECK(snd_config_search(c1, "n30", &c3));
+	TEST_CHECK(c2 == c3);
+	ALSA_CHECK(snd_config_search(c1, "n99", &c2));
+	ALSA_CHECK(snd_config_delete(c1));
+}
+
 static void test_delete(void)
 {
 	snd_config_t *c;
@@ -623,6 +669,7 @@ int main(void)
 	test_search();
 	test_searchv();
 	test_add();
+	test_add_many();
 	test_delete();
 	test_copy();
 	test_make_integer();
@@ -0,0 +1,165 @@
+/*
+ * benchmark for the memory footprint of the PCM handles
+ *
+ * Opens many lightweight ioplug PCMs in the process, like a server of
+ * virtual devices does, and reports the heap bytes used per handle just
+ * after the open and after the hw_params setup.  The plugin does nothing
+ * and all the handles share one poll descriptor.
+ *
+ *   pcm-footprint [-n <count>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <unistd.h>
+#include "../include/asoundlib.h"
+#include "../include/pcm_external.h"
+
+struct vdev {
+	snd_pcm_ioplug_t io;
+	snd_pcm_uframes_t ptr;
+};
+
+static int vdev_start(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int vdev_stop(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t vdev_pointer(snd_pcm_ioplug_t *io)
+{
+	struct vdev *v = io->private_data;
+
+	return v->ptr;
+}
+
+static snd_pcm_sframes_t vdev_transfer(snd_pcm_ioplug_t *io,
+				       const snd_pcm_channel_area_t *areas ATTRIBUTE_UNUSED,
+				       snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+				       snd_pcm_uframes_t size)
+{
+	struct vdev *v = io->private_data;
+
+	v->ptr = (v->ptr + size) % io->buffer_size;
+	return size;
+}
+
+static int vdev_close(snd_pcm_ioplug_t *io)
+{
+	free(io->private_data);
+	return 0;
+}
+
+static const snd_pcm_ioplug_callback_t vdev_callback = {
+	.start = vdev_start,
+	.stop = vdev_stop,
+	.pointer = vdev_pointer,
+	.transfer = vdev_transfer,
+	.close = vdev_close,
+};
+
+static int vdev_open(snd_pcm_t **pcmp, int poll_fd)
+{
+	static const unsigned int access[] = { SND_PCM_ACCESS_RW_INTERLEAVED };
+	static const unsigned int formats[] = { SND_PCM_FORMAT_S16_LE };
+	struct vdev *v;
+	int err;
+
+	v = calloc(1, sizeof(*v));
+	if (!v)
+		return -ENOMEM;
+	v->io.version = SND_PCM_IOPLUG_VERSION;
+	v->io.name = "vdev";
+	v->io.callback = &vdev_callback;
+	v->io.private_data = v;
+	v->io.poll_fd = poll_fd;
+	v->io.poll_events = POLLOUT;
+	err = snd_pcm_ioplug_create(&v->io, "vdev", SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0) {
+		free(v);
+		return err;
+	}
+	if ((err = snd_pcm_ioplug_set_param_list(&v->io, SND_PCM_IOPLUG_HW_ACCESS, 1, access)) < 0 ||
+	    (err = snd_pcm_ioplug_set_param_list(&v->io, SND_PCM_IOPLUG_HW_FORMAT, 1, formats)) < 0 ||
+	    (err = snd_pcm_ioplug_set_param_minmax(&v->io, SND_PCM_IOPLUG_HW_CHANNELS, 2, 2)) < 0 ||
+	    (err = snd_pcm_ioplug_set_param_minmax(&v->io, SND_PCM_IOPLUG_HW_RATE, 48000, 48000)) < 0 ||
+	    (err = snd_pcm_ioplug_set_param_minmax(&v->io, SND_PCM_IOPLUG_HW_PERIOD_BYTES, 64, 65536)) < 0 ||
+	    (err = snd_pcm_ioplug_set_param_minmax(&v->io, SND_PCM_IOPLUG_HW_PERIODS, 2, 64)) < 0) {
+		snd_pcm_ioplug_delete(&v->io);
+		return err;
+	}
+	*pcmp = v->io.pcm;
+	return 0;
+}
+
+static size_t heap_used(void)
+{
+	struct mallinfo2 mi = mallinfo2();
+
+	return mi.uordblks + mi.hblkhd;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int count = 4096, i = 0;
+	snd_pcm_t **pcms;
+	size_t base, opened, setup;
+	int fds[2], c, err;
+
+	while ((c = getopt(argc, argv, "n:h")) >= 0) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			printf("Usage: pcm-footprint [-n <count>]\n");
+			return EXIT_FAILURE;
+		}
+	}
+	if (!count || pipe(fds) < 0)
+		return EXIT_FAILURE;
+	pcms = calloc(count, sizeof(*pcms));
+	if (!pcms)
+		return EXIT_FAILURE;
+
+	/* the first handle initializes the library state shared by all */
+	err = vdev_open(&pcms[0], fds[1]);
+	if (err < 0)
+		goto error;
+	snd_pcm_close(pcms[0]);
+
+	base = heap_used();
+	for (i = 0; i < count; i++) {
+		err = vdev_open(&pcms[i], fds[1]);
+		if (err < 0)
+			goto error;
+	}
+	opened = heap_used();
+	for (i = 0; i < count; i++) {
+		err = snd_pcm_set_params(pcms[i], SND_PCM_FORMAT_S16_LE,
+					 SND_PCM_ACCESS_RW_INTERLEAVED, 2, 48000,
+					 0, 20000);
+		if (err < 0)
+			goto error;
+	}
+	setup = heap_used();
+	printf("%u handles\n", count);
+	printf("open:   %8zu bytes per handle\n", (opened - base) / count);
+	printf("set up: %8zu bytes per handle\n", (setup - base) / count);
+	for (i = 0; i < count; i++)
+		snd_pcm_close(pcms[i]);
+	free(pcms);
+	return EXIT_SUCCESS;
+
+ error:
+	fprintf(stderr, "handle %u: %s\n", i, snd_strerror(err));
+	return EXIT_FAILURE;
+}
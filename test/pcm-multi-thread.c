@@ -15,11 +15,19 @@
  * (0-9).  In addition, it puts the mode suffix ('a' for avail, 'd' for
  * delay, etc) for the random mode, as well as the suffix '!' indicating
  * the error from the called function.
+ *
+ * With -B, the test runs as a lock contention benchmark for the given
+ * number of seconds: nothing is printed while running, and the number
+ * of calls per second and the worst latency of a call are reported for
+ * each worker thread and for the main thread at the end, e.g.
+ *
+ *   pcm-multi-thread -D plug:null -m S -t 4 -B 5
  */
 
 #include <stdio.h>
 #include <pthread.h>
 #include <getopt.h>
+#include <time.h>
 #include "../include/asoundlib.h"
 
 #define MAX_THREADS	10
@@ -30,11 +38,12 @@ enum {
 	MODE_HWSYNC,
 	MODE_TIMESTAMP,
 	MODE_DELAY,
+	MODE_STATE,
 	MODE_RANDOM
 };
 
 static char mode_suffix[] = {
-	'a', 's', 'h', 't', 'd', 'r'
+	'a', 's', 'h', 't', 'd', 'S', 'r'
 };
 
 static const char *pcmdev = "default";
@@ -49,11 +58,35 @@ static snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
 static int running_mode = MODE_AVAIL_UPDATE;
 static int show_value = 0;
 static int quiet = 0;
+static int bench_secs = 0;
+
+struct bench_stat {
+	unsigned long calls;
+	double max_usec;
+};
 
 static pthread_t peeper_threads[MAX_THREADS];
-static int running = 1;
+static struct bench_stat peeper_stats[MAX_THREADS];
+static volatile int running = 1;
 static snd_pcm_t *pcm;
 
+static double now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static void bench_account(struct bench_stat *st, double start)
+{
+	double t = now_usec() - start;
+
+	st->calls++;
+	if (t > st->max_usec)
+		st->max_usec = t;
+}
+
 static void *peeper(void *data)
 {
 	int thread_no = (long)data;
@@ -61,12 +94,15 @@ static void *peeper(void *data)
 	snd_pcm_status_t *stat;
 	snd_htimestamp_t tstamp;
 	int mode = running_mode, err;
+	double start = 0;
 
 	snd_pcm_status_alloca(&stat);
 
 	while (running) {
 		if (running_mode == MODE_RANDOM)
 			mode = rand() % MODE_RANDOM;
+		if (bench_secs)
+			start = now_usec();
 		switch (mode) {
 		case MODE_AVAIL_UPDATE:
 			val = snd_pcm_avail_update(pcm);
@@ -83,11 +119,17 @@ static void *peeper(void *data)
 			err = snd_pcm_htimestamp(pcm, (snd_pcm_uframes_t *)&val,
 						 &tstamp);
 			break;
+		case MODE_STATE:
+			val = snd_pcm_state(pcm);
+			err = 0;
+			break;
 		default:
 			err = snd_pcm_delay(pcm, &val);
 			break;
 		}
 
+		if (bench_secs)
+			bench_account(&peeper_stats[thread_no], start);
 		if (quiet)
 			continue;
 		if (running_mode == MODE_RANDOM) {
@@ -115,16 +157,17 @@ static void usage(void)
 	fprintf(stderr, "  -f str  Set PCM format\n");
 	fprintf(stderr, "  -s str  Set stream direction (playback or capture)\n");
 	fprintf(stderr, "  -t val  Set number of threads\n");
-	fprintf(stderr, "  -m str  Running mode (avail, status, hwsync, timestamp, delay, random)\n");
+	fprintf(stderr, "  -m str  Running mode (avail, status, hwsync, timestamp, delay, State, random)\n");
 	fprintf(stderr, "  -v      Show value\n");
 	fprintf(stderr, "  -q      Quiet mode\n");
+	fprintf(stderr, "  -B val  Benchmark the calls for the given seconds\n");
 }
 
 static int parse_options(int argc, char **argv)
 {
 	int c, i;
 
-	while ((c = getopt(argc, argv, "D:r:f:p:b:s:t:m:vq")) >= 0) {
+	while ((c = getopt(argc, argv, "D:r:f:p:b:s:t:m:vqB:")) >= 0) {
 		switch (c) {
 		case 'D':
 			pcmdev = optarg;
@@ -177,6 +220,14 @@ static int parse_options(int argc, char **argv)
 		case 'q':
 			quiet = 1;
 			break;
+		case 'B':
+			bench_secs = atoi(optarg);
+			if (bench_secs < 1) {
+				fprintf(stderr, "invalid benchmark duration\n");
+				return 1;
+			}
+			quiet = 1;
+			break;
 		default:
 			usage();
 			return 1;
@@ -205,8 +256,17 @@ static int setup_params(void)
 	return 0;
 }
 
+static void bench_report(const char *name, int no,
+			 const struct bench_stat *st, double usec)
+{
+	printf("%s %d: %10.0f calls/s, max %8.1f us\n", name, no,
+	       st->calls * 1000000.0 / usec, st->max_usec);
+}
+
 int main(int argc, char **argv)
 {
+	struct bench_stat main_stat = { 0, 0 };
+	double bench_start = 0, start = 0;
 	char *buf;
 	int i, err;
 
@@ -237,12 +297,21 @@ int main(int argc, char **argv)
 
 	if (stream == SND_PCM_STREAM_CAPTURE)
 		snd_pcm_start(pcm);
+	if (bench_secs)
+		bench_start = now_usec();
 	for (;;) {
 		int size = rand() % (bufsize / 2);
+		if (bench_secs) {
+			start = now_usec();
+			if (start - bench_start >= bench_secs * 1000000.0)
+				break;
+		}
 		if (stream == SND_PCM_STREAM_PLAYBACK)
 			err = snd_pcm_writei(pcm, buf, size);
 		else
 			err = snd_pcm_readi(pcm, buf, size);
+		if (bench_secs)
+			bench_account(&main_stat, start);
 		if (err < 0) {
 			fprintf(stderr, "read/write error %d\n", err);
 			err = snd_pcm_recover(pcm, err, 0);
@@ -254,10 +323,21 @@ int main(int argc, char **argv)
 	}
 
 	running = 0;
-	for (i = 0; i < num_threads; i++)
-		pthread_cancel(peeper_threads[i]);
+	if (!bench_secs) {
+		for (i = 0; i < num_threads; i++)
+			pthread_cancel(peeper_threads[i]);
+	}
 	for (i = 0; i < num_threads; i++)
 		pthread_join(peeper_threads[i], NULL);
 
+	if (bench_secs) {
+		double usec = now_usec() - bench_start;
+
+		bench_report("main  ", 0, &main_stat, usec);
+		for (i = 0; i < num_threads; i++)
+			bench_report("thread", i, &peeper_stats[i], usec);
+		snd_pcm_close(pcm);
+		return 0;
+	}
 	return 1;
 }
@@ -0,0 +1,377 @@
+/*
+ * benchmark for the conversion kernels of the PCM plugins
+ *
+ * Plays through a single plugin on top of a null PCM for a matrix of
+ * sample formats and channel counts and reports the CPU time per frame.
+ * A bare null PCM is measured first, its cost is included in the other
+ * numbers.  The dmix and softvol kernels need a sound card and are only
+ * run with -D and -C respectively:
+ *
+ *   plugin-bench
+ *   plugin-bench -k rate -r linear,speexrate
+ *   plugin-bench -k rate -R 96000,24000
+ *   plugin-bench -D hw:0 -C 0 -c 2,8 -n 4000000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+#define MAX_CHANNELS	32
+
+static unsigned long frames_per_case = 2000000;
+static snd_pcm_uframes_t period_size = 1024;
+static const char *channel_list = "2,6";
+static const char *converter_list = "linear";
+static const char *rate_list = "44100";
+static unsigned int slave_rate;
+static const char *kernel_filter;
+static const char *device;
+static const char *card;
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16,
+	SND_PCM_FORMAT_S32,
+	SND_PCM_FORMAT_FLOAT,
+};
+
+enum {
+	K_NULL,
+	K_COPY,
+	K_COPY_PLANAR,
+	K_LINEAR,
+	K_ROUTE,
+	K_RATE,
+	K_SOFTVOL,
+	K_DMIX,
+};
+
+static const struct {
+	int id;
+	const char *name;
+	int planar;		/* write non-interleaved buffers */
+	int need_device;	/* 1 = -D device, 2 = -C card */
+} kernels[] = {
+	{ K_NULL, "null", 0, 0 },
+	{ K_COPY, "copy", 0, 0 },
+	{ K_COPY_PLANAR, "copy-planar", 1, 0 },
+	{ K_LINEAR, "linear", 0, 0 },
+	{ K_ROUTE, "route", 0, 0 },
+	{ K_RATE, "rate", 0, 0 },
+	{ K_SOFTVOL, "softvol", 0, 2 },
+	{ K_DMIX, "dmix", 0, 1 },
+};
+
+static double timespec_nsec(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000.0 + ts->tv_nsec;
+}
+
+/* mix each output channel from two neighbouring inputs */
+static void route_ttable(char *buf, size_t size, unsigned int channels)
+{
+	unsigned int i;
+	size_t len = 0;
+
+	for (i = 0; i < channels && len < size; i++)
+		len += snprintf(buf + len, size - len,
+				" ttable.%u.%u 0.5 ttable.%u.%u 0.5",
+				i, i, (i + 1) % channels, i);
+}
+
+static int build_conf(char *conf, size_t size, int kernel,
+		      snd_pcm_format_t format, unsigned int channels,
+		      const char *converter)
+{
+	char ttable[MAX_CHANNELS * 48];
+
+	switch (kernel) {
+	case K_NULL:
+		snprintf(conf, size, "pcm.bench { type null }");
+		break;
+	case K_COPY:
+	case K_COPY_PLANAR:
+		snprintf(conf, size, "pcm.bench { type copy slave.pcm { type null } }");
+		break;
+	case K_LINEAR:
+		if (format == SND_PCM_FORMAT_FLOAT)
+			return -EINVAL;
+		snprintf(conf, size,
+			 "pcm.bench { type linear slave { pcm { type null } format %s } }",
+			 format == SND_PCM_FORMAT_S16 ? "S32" : "S16");
+		break;
+	case K_ROUTE:
+		route_ttable(ttable, sizeof(ttable), channels);
+		snprintf(conf, size,
+			 "pcm.bench { type route%s slave { pcm { type null } channels %u } }",
+			 ttable, channels);
+		break;
+	case K_RATE:
+		snprintf(conf, size,
+			 "pcm.bench { type rate converter \"%s\""
+			 " slave { pcm { type null } rate %u } }", converter, slave_rate);
+		break;
+	case K_SOFTVOL:
+		snprintf(conf, size,
+			 "pcm.bench { type softvol slave.pcm { type null }"
+			 " control { name \"Bench Playback Volume\" card \"%s\" } }",
+			 card);
+		break;
+	case K_DMIX:
+		snprintf(conf, size,
+			 "pcm.bench { type dmix ipc_key 0x62656e63"
+			 " slave { pcm \"%s\" format %s channels %u rate 48000 } }",
+			 device, snd_pcm_format_name(format), channels);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int open_pcm(snd_pcm_t **pcm, const char *conf, int planar,
+		    snd_pcm_format_t format, unsigned int channels)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t psize = period_size;
+	snd_pcm_uframes_t size = period_size * 4;
+	int err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		goto out;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto out;
+	err = snd_pcm_open_lconf(pcm, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		goto out;
+
+	snd_pcm_hw_params_alloca(&hw);
+	if ((err = snd_pcm_hw_params_any(*pcm, hw)) < 0 ||
+	    (err = snd_pcm_hw_params_set_access(*pcm, hw, planar ?
+						SND_PCM_ACCESS_RW_NONINTERLEAVED :
+						SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+	    (err = snd_pcm_hw_params_set_format(*pcm, hw, format)) < 0 ||
+	    (err = snd_pcm_hw_params_set_channels(*pcm, hw, channels)) < 0 ||
+	    (err = snd_pcm_hw_params_set_rate(*pcm, hw, 48000, 0)) < 0 ||
+	    (err = snd_pcm_hw_params_set_period_size_near(*pcm, hw, &psize, 0)) < 0 ||
+	    (err = snd_pcm_hw_params_set_buffer_size_near(*pcm, hw, &size)) < 0 ||
+	    (err = snd_pcm_hw_params(*pcm, hw)) < 0)
+		snd_pcm_close(*pcm);
+ out:
+	snd_config_delete(top);
+	return err;
+}
+
+static void fill(void *buf, snd_pcm_format_t format, size_t samples)
+{
+	size_t i;
+
+	for (i = 0; i < samples; i++) {
+		int v = (int)(i * 2654435761u) >> 1;
+		switch (format) {
+		case SND_PCM_FORMAT_S16:
+			((int16_t *)buf)[i] = v >> 15;
+			break;
+		case SND_PCM_FORMAT_S32:
+			((int32_t *)buf)[i] = v;
+			break;
+		default:
+			((float *)buf)[i] = v / 1073741824.0f - 1.0f;
+			break;
+		}
+	}
+}
+
+static int bench(int k, snd_pcm_format_t format, unsigned int channels,
+		 const char *converter)
+{
+	char conf[2048], label[64];
+	snd_pcm_t *pcm;
+	struct timespec start, end;
+	size_t sample_bytes = snd_pcm_format_physical_width(format) / 8;
+	void *bufs[MAX_CHANNELS];
+	unsigned long done = 0;
+	unsigned int i;
+	char *buf;
+	int err;
+
+	if (kernels[k].id == K_RATE)
+		snprintf(label, sizeof(label), "rate/%s/%u", converter, slave_rate);
+	else
+		snprintf(label, sizeof(label), "%s", kernels[k].name);
+	err = build_conf(conf, sizeof(conf), kernels[k].id, format, channels,
+			 converter);
+	if (err < 0)
+		return err;
+	err = open_pcm(&pcm, conf, kernels[k].planar, format, channels);
+	if (err < 0) {
+		printf("%-20s %-8s %2u   %s\n", label, snd_pcm_format_name(format),
+		       channels, snd_strerror(err));
+		return err;
+	}
+	buf = malloc(sample_bytes * channels * period_size);
+	if (!buf) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	fill(buf, format, channels * period_size);
+	for (i = 0; i < channels; i++)
+		bufs[i] = buf + i * sample_bytes * period_size;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+	while (done < frames_per_case) {
+		snd_pcm_sframes_t frames;
+
+		if (kernels[k].planar)
+			frames = snd_pcm_writen(pcm, bufs, period_size);
+		else
+			frames = snd_pcm_writei(pcm, buf, period_size);
+		if (frames < 0) {
+			/* dmix runs in real time, restart on underruns */
+			frames = snd_pcm_recover(pcm, frames, 1);
+			if (frames < 0) {
+				fprintf(stderr, "write error: %s\n", snd_strerror(frames));
+				break;
+			}
+			continue;
+		}
+		done += frames;
+	}
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+
+	printf("%-20s %-8s %2u %8.2f ns/frame\n", label,
+	       snd_pcm_format_name(format), channels,
+	       done ? (timespec_nsec(&end) - timespec_nsec(&start)) / done : 0);
+	free(buf);
+	snd_pcm_close(pcm);
+	return 0;
+}
+
+/* find the item in a comma separated list */
+static int in_list(const char *list, const char *item)
+{
+	size_t len = strlen(item);
+
+	while (list && *list) {
+		if (!strncmp(list, item, len) && (list[len] == ',' || !list[len]))
+			return 1;
+		list = strchr(list, ',');
+		if (list)
+			list++;
+	}
+	return 0;
+}
+
+static void run_kernel(int k)
+{
+	const char *ch, *conv, *r;
+	unsigned int f, channels;
+	char name[64];
+
+	for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		for (ch = channel_list; ch; ch = strchr(ch, ',') ? strchr(ch, ',') + 1 : NULL) {
+			channels = atoi(ch);
+			if (!channels || channels > MAX_CHANNELS)
+				continue;
+			if (kernels[k].id != K_RATE) {
+				bench(k, formats[f], channels, NULL);
+				continue;
+			}
+			for (conv = converter_list; conv;
+			     conv = strchr(conv, ',') ? strchr(conv, ',') + 1 : NULL) {
+				snprintf(name, sizeof(name), "%.*s",
+					 (int)strcspn(conv, ","), conv);
+				for (r = rate_list; r;
+				     r = strchr(r, ',') ? strchr(r, ',') + 1 : NULL) {
+					slave_rate = atoi(r);
+					if (slave_rate)
+						bench(k, formats[f], channels, name);
+				}
+			}
+		}
+	}
+}
+
+static void usage(void)
+{
+	unsigned int i;
+
+	printf("Usage: plugin-bench [OPTIONS]\n"
+	       "  -k LIST      kernels to run (default all):");
+	for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+		printf(" %s", kernels[i].name);
+	printf("\n"
+	       "  -c LIST      channel counts (default %s)\n"
+	       "  -r LIST      rate converters (default %s)\n"
+	       "  -R LIST      slave rates of the converters (default %s)\n"
+	       "  -n FRAMES    frames per case (default %lu)\n"
+	       "  -p FRAMES    frames per write (default %lu)\n"
+	       "  -D DEVICE    hardware device for dmix\n"
+	       "  -C CARD      card of the softvol control\n",
+	       channel_list, converter_list, rate_list, frames_per_case,
+	       period_size);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "k:c:r:R:n:p:D:C:h")) >= 0) {
+		switch (c) {
+		case 'k':
+			kernel_filter = optarg;
+			break;
+		case 'c':
+			channel_list = optarg;
+			break;
+		case 'r':
+			converter_list = optarg;
+			break;
+		case 'R':
+			rate_list = optarg;
+			break;
+		case 'n':
+			frames_per_case = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'D':
+			device = optarg;
+			break;
+		case 'C':
+			card = optarg;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (!frames_per_case || !period_size) {
+		usage();
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+		if (kernel_filter && !in_list(kernel_filter, kernels[i].name))
+			continue;
+		if ((kernels[i].need_device == 1 && !device) ||
+		    (kernels[i].need_device == 2 && !card))
+			continue;
+		run_kernel(i);
+	}
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Round-trip latency of a rawmidi loopback, with optional busy-polling
+ *
+ * The output port has to be connected to the input port, either by a
+ * cable or a virtual loopback device (e.g. snd-virmidi with aconnect).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <getopt.h>
+#include "../include/asoundlib.h"
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: rawmidi-latency [options]\n");
+	fprintf(stderr, "  options:\n");
+	fprintf(stderr, "    -i <rawmidi device> : input device (default hw:0,0)\n");
+	fprintf(stderr, "    -o <rawmidi device> : output device (default hw:0,0)\n");
+	fprintf(stderr, "    -n <count>          : number of round trips (default 1000)\n");
+	fprintf(stderr, "    -b <usec>           : busy-poll window (default 0 = off)\n");
+	fprintf(stderr, "    -p                  : wait with poll() instead of a blocking read\n");
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* read until the 3 bytes of the message came back */
+static int wait_message(snd_rawmidi_t *in, int use_poll, unsigned char *msg)
+{
+	unsigned char buf[3];
+	struct pollfd pfd;
+	int got = 0, err;
+
+	while (got < 3) {
+		err = snd_rawmidi_read(in, buf + got, 3 - got);
+		if (err == -EAGAIN && use_poll) {
+			snd_rawmidi_poll_descriptors(in, &pfd, 1);
+			poll(&pfd, 1, 1000);
+			continue;
+		}
+		if (err < 0)
+			return err;
+		got += err;
+	}
+	return memcmp(buf, msg, 3) ? -EIO : 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *iname = "hw:0,0", *oname = "hw:0,0";
+	snd_rawmidi_t *in = NULL, *out = NULL;
+	unsigned int count = 1000, busy = 0, i;
+	int use_poll = 0, c, err;
+	unsigned char msg[3];
+	long long *lat, t, sum = 0;
+
+	while ((c = getopt(argc, argv, "i:o:n:b:ph")) >= 0) {
+		switch (c) {
+		case 'i':
+			iname = optarg;
+			break;
+		case 'o':
+			oname = optarg;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'b':
+			busy = atoi(optarg);
+			break;
+		case 'p':
+			use_poll = 1;
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (!count) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	err = snd_rawmidi_open(&in, NULL, iname, use_poll ? SND_RAWMIDI_NONBLOCK : 0);
+	if (err < 0) {
+		fprintf(stderr, "snd_rawmidi_open %s failed: %s\n", iname, snd_strerror(err));
+		return EXIT_FAILURE;
+	}
+	err = snd_rawmidi_open(NULL, &out, oname, 0);
+	if (err < 0) {
+		fprintf(stderr, "snd_rawmidi_open %s failed: %s\n", oname, snd_strerror(err));
+		snd_rawmidi_close(in);
+		return EXIT_FAILURE;
+	}
+	snd_rawmidi_set_busy_poll(in, busy);
+	snd_rawmidi_drop(in);
+
+	lat = calloc(count, sizeof(*lat));
+	if (!lat)
+		return EXIT_FAILURE;
+	for (i = 0; i < count; i++) {
+		msg[0] = 0x90;
+		msg[1] = i & 0x7f;
+		msg[2] = 0x40;
+		t = now_ns();
+		err = snd_rawmidi_write(out, msg, 3);
+		if (err == 3)
+			err = wait_message(in, use_poll, msg);
+		if (err < 0) {
+			fprintf(stderr, "round trip %u failed: %s\n", i, snd_strerror(err));
+			break;
+		}
+		lat[i] = now_ns() - t;
+		sum += lat[i];
+	}
+	if (i == count) {
+		qsort(lat, count, sizeof(*lat), cmp_ll);
+		printf("%s, busy-poll %u usec, %u round trips\n",
+		       use_poll ? "poll" : "blocking read", busy, count);
+		printf("  min %.1f  avg %.1f  p50 %.1f  p99 %.1f  max %.1f usec\n",
+		       lat[0] / 1000.0, sum / 1000.0 / count,
+		       lat[count / 2] / 1000.0, lat[count * 99 / 100] / 1000.0,
+		       lat[count - 1] / 1000.0);
+	}
+	free(lat);
+	snd_rawmidi_close(out);
+	snd_rawmidi_close(in);
+	return i == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,328 @@
+/*
+ * benchmark for the sequencer event path
+ *
+ * Loops events from a port back to itself and measures, for each client
+ * pool size given:
+ *
+ * - the throughput of direct events sent in batches through
+ *   snd_seq_event_output() and read back with snd_seq_event_input()
+ * - the round-trip latency of a single direct event
+ * - the scheduling jitter of events queued at a fixed real-time interval,
+ *   as the spread of their arrival time against the schedule
+ *
+ * both with legacy events and, with -u, with UMP (MIDI 2.0) events:
+ *
+ *   seq-bench
+ *   seq-bench -u -p 100,500,2000 -n 5000 -i 500
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+static int count = 2000;
+static int batch = 64;
+static int interval = 1000;	/* usec */
+
+typedef union {
+	snd_seq_event_t ev;
+	snd_seq_ump_event_t uev;
+} bench_event_t;
+
+struct stats {
+	double min, max, sum, sum2;
+	int n;
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void stats_add(struct stats *s, double v)
+{
+	if (!s->n || v < s->min)
+		s->min = v;
+	if (!s->n || v > s->max)
+		s->max = v;
+	s->sum += v;
+	s->sum2 += v * v;
+	s->n++;
+}
+
+static void stats_print(const char *name, const struct stats *s)
+{
+	double mean = s->n ? s->sum / s->n : 0;
+	double var = s->n ? s->sum2 / s->n - mean * mean : 0;
+
+	printf("    %-10s min %8.1f  mean %8.1f  max %8.1f  stddev %7.1f usec\n",
+	       name, s->min, mean, s->max, var > 0 ? sqrt(var) : 0);
+}
+
+static void init_event(bench_event_t *e, int port, int ump)
+{
+	memset(e, 0, sizeof(*e));
+	snd_seq_ev_set_source(&e->ev, port);
+	snd_seq_ev_set_subs(&e->ev);
+	snd_seq_ev_set_direct(&e->ev);
+	if (ump) {
+		/* MIDI 2.0 note-on, group 0, channel 0, note 60 */
+		uint32_t data[2] = { 0x40903c00, 0xffff0000 };
+
+		snd_seq_ev_set_ump_data(&e->uev, data, sizeof(data));
+	} else {
+		snd_seq_ev_set_noteon(&e->ev, 0, 60, 100);
+	}
+}
+
+static int output(snd_seq_t *seq, bench_event_t *e, int ump)
+{
+	if (ump)
+		return snd_seq_ump_event_output(seq, &e->uev);
+	return snd_seq_event_output(seq, &e->ev);
+}
+
+static int input(snd_seq_t *seq, int ump)
+{
+	snd_seq_ump_event_t *uev;
+	snd_seq_event_t *ev;
+
+	if (ump)
+		return snd_seq_ump_event_input(seq, &uev);
+	return snd_seq_event_input(seq, &ev);
+}
+
+static int bench_throughput(snd_seq_t *seq, int port, int ump)
+{
+	bench_event_t e;
+	long long t;
+	int i, j, n, err;
+
+	init_event(&e, port, ump);
+	t = now_ns();
+	for (i = 0; i < count; i += n) {
+		n = count - i < batch ? count - i : batch;
+		for (j = 0; j < n; j++) {
+			err = output(seq, &e, ump);
+			if (err < 0)
+				return err;
+		}
+		err = snd_seq_drain_output(seq);
+		if (err < 0)
+			return err;
+		for (j = 0; j < n; j++) {
+			err = input(seq, ump);
+			if (err < 0)
+				return err;
+		}
+	}
+	t = now_ns() - t;
+	printf("    throughput %.0f events/sec (batches of %d)\n",
+	       count * 1e9 / t, batch);
+	return 0;
+}
+
+static int bench_latency(snd_seq_t *seq, int port, int ump)
+{
+	struct stats s = { 0 };
+	bench_event_t e;
+	long long t;
+	int i, err;
+
+	init_event(&e, port, ump);
+	for (i = 0; i < count; i++) {
+		t = now_ns();
+		err = output(seq, &e, ump);
+		if (err >= 0)
+			err = snd_seq_drain_output(seq);
+		if (err >= 0)
+			err = input(seq, ump);
+		if (err < 0)
+			return err;
+		stats_add(&s, (now_ns() - t) / 1000.0);
+	}
+	stats_print("latency", &s);
+	return 0;
+}
+
+static int bench_jitter(snd_seq_t *seq, int port, int queue, int ump)
+{
+	struct stats s = { 0 };
+	snd_seq_real_time_t rt;
+	bench_event_t e;
+	long long start, sched, *late;
+	int sent = 0, recvd = 0, i, err;
+
+	late = calloc(count, sizeof(*late));
+	if (!late)
+		return -ENOMEM;
+	init_event(&e, port, ump);
+	err = snd_seq_start_queue(seq, queue, NULL);
+	if (err >= 0)
+		err = snd_seq_drain_output(seq);
+	if (err < 0)
+		goto out;
+	start = now_ns();
+	while (recvd < count) {
+		/* keep a batch of events scheduled ahead */
+		while (sent < count && sent - recvd < batch) {
+			sched = (long long)(sent + 1) * interval * 1000;
+			rt.tv_sec = sched / 1000000000;
+			rt.tv_nsec = sched % 1000000000;
+			snd_seq_ev_schedule_real(&e.ev, queue, 0, &rt);
+			err = output(seq, &e, ump);
+			if (err < 0)
+				goto out;
+			sent++;
+		}
+		err = snd_seq_drain_output(seq);
+		if (err >= 0)
+			err = input(seq, ump);
+		if (err < 0)
+			goto out;
+		sched = (long long)(recvd + 1) * interval * 1000;
+		late[recvd++] = now_ns() - start - sched;
+	}
+	/* the queue start and our clock differ by a constant offset */
+	sched = late[0];
+	for (i = 1; i < count; i++)
+		if (late[i] < sched)
+			sched = late[i];
+	for (i = 0; i < count; i++)
+		stats_add(&s, (late[i] - sched) / 1000.0);
+	stats_print("jitter", &s);
+	err = 0;
+ out:
+	snd_seq_stop_queue(seq, queue, NULL);
+	snd_seq_drain_output(seq);
+	free(late);
+	return err;
+}
+
+static int run(int ump, const char *pools)
+{
+	snd_seq_t *seq;
+	char *list, *tok, *save;
+	int port, queue, pool, err;
+
+	err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, 0);
+	if (err < 0) {
+		fprintf(stderr, "snd_seq_open: %s\n", snd_strerror(err));
+		return err;
+	}
+	snd_seq_set_client_name(seq, "seq-bench");
+	if (ump) {
+		err = snd_seq_set_client_midi_version(seq, SND_SEQ_CLIENT_UMP_MIDI_2_0);
+		if (err < 0) {
+			fprintf(stderr, "no UMP support: %s\n", snd_strerror(err));
+			goto out;
+		}
+	}
+	port = snd_seq_create_simple_port(seq, "bench",
+					  SND_SEQ_PORT_CAP_READ |
+					  SND_SEQ_PORT_CAP_WRITE |
+					  SND_SEQ_PORT_CAP_SUBS_READ |
+					  SND_SEQ_PORT_CAP_SUBS_WRITE,
+					  SND_SEQ_PORT_TYPE_MIDI_GENERIC |
+					  SND_SEQ_PORT_TYPE_APPLICATION);
+	if (port < 0) {
+		err = port;
+		goto out;
+	}
+	err = snd_seq_connect_to(seq, port, snd_seq_client_id(seq), port);
+	if (err < 0)
+		goto out;
+	queue = snd_seq_alloc_queue(seq);
+	if (queue < 0) {
+		err = queue;
+		goto out;
+	}
+
+	list = strdup(pools);
+	if (!list) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		pool = atoi(tok);
+		err = snd_seq_set_client_pool_output(seq, pool);
+		if (err >= 0)
+			err = snd_seq_set_client_pool_input(seq, pool);
+		if (err < 0) {
+			fprintf(stderr, "pool size %d: %s\n", pool, snd_strerror(err));
+			break;
+		}
+		printf("%s events, pool %d:\n", ump ? "UMP" : "legacy", pool);
+		err = bench_throughput(seq, port, ump);
+		if (err >= 0)
+			err = bench_latency(seq, port, ump);
+		if (err >= 0)
+			err = bench_jitter(seq, port, queue, ump);
+		if (err < 0) {
+			fprintf(stderr, "benchmark failed: %s\n", snd_strerror(err));
+			break;
+		}
+	}
+	free(list);
+ out:
+	snd_seq_close(seq);
+	return err;
+}
+
+static void usage(void)
+{
+	printf("Usage: seq-bench [options]\n"
+	       "  -n <count>     events per measurement (default %d)\n"
+	       "  -b <count>     events in flight (default %d)\n"
+	       "  -i <usec>      interval of the scheduled events (default %d)\n"
+	       "  -p <list>      client pool sizes, comma separated (default 500)\n"
+	       "  -u             measure UMP events as well\n",
+	       count, batch, interval);
+}
+
+int main(int argc, char **argv)
+{
+	const char *pools = "500";
+	int ump = 0, c;
+
+	while ((c = getopt(argc, argv, "n:b:i:p:uh")) >= 0) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'p':
+			pools = optarg;
+			break;
+		case 'u':
+			ump = 1;
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (count <= 0 || batch <= 0 || interval <= 0) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (run(0, pools) < 0)
+		return EXIT_FAILURE;
+	if (ump && run(1, pools) < 0)
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
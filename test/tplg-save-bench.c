@@ -0,0 +1,199 @@
+/*
+ * benchmark for the topology text export
+ *
+ * Builds a synthetic topology of a given number of mixer controls, data
+ * blocks, widgets and graph routes, loads it once and measures
+ * snd_tplg_save() with each of the save modes: the time of the fastest
+ * run, the size of the text and the growth of the peak RSS of the
+ * process during the first run of the mode.
+ *
+ *   tplg-save-bench
+ *   tplg-save-bench -n 20000 -r 10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "../include/asoundlib.h"
+#include "../include/topology.h"
+
+static int objects = 5000;
+static int runs = 5;
+
+static const struct {
+	const char *name;
+	int flags;
+} modes[] = {
+	{ "nocheck", SND_TPLG_SAVE_NOCHECK },
+	{ "default", 0 },
+	{ "sort", SND_TPLG_SAVE_SORT },
+	{ "groups", SND_TPLG_SAVE_GROUPS | SND_TPLG_SAVE_NOCHECK },
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static long peak_rss_kb(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+/* append to a growing text buffer */
+static int add(char **buf, size_t *len, size_t *size, const char *fmt, ...)
+{
+	va_list va;
+	char *s;
+	int n;
+
+	for (;;) {
+		va_start(va, fmt);
+		n = vsnprintf(*buf + *len, *size - *len, fmt, va);
+		va_end(va);
+		if (n < 0)
+			return -EINVAL;
+		if ((size_t)n < *size - *len)
+			break;
+		s = realloc(*buf, *size * 2 + n);
+		if (!s)
+			return -ENOMEM;
+		*buf = s;
+		*size = *size * 2 + n;
+	}
+	*len += n;
+	return 0;
+}
+
+static char *make_text(size_t *lenp)
+{
+	size_t len = 0, size = 65536;
+	char *buf = malloc(size);
+	int i, err;
+
+	if (!buf)
+		return NULL;
+	buf[0] = '\0';
+	err = add(&buf, &len, &size, "SectionTLV.\"vtlv\" { scale { min \"-6000\" step \"100\" mute \"1\" } }\n");
+	for (i = 0; err >= 0 && i < objects; i++)
+		err = add(&buf, &len, &size,
+			  "SectionControlMixer.\"mix%d\" {\n"
+			  "\tindex \"%d\"\n"
+			  "\tchannel.FL { reg \"%d\" shift \"0\" }\n"
+			  "\tchannel.FR { reg \"%d\" shift \"8\" }\n"
+			  "\tmax \"127\"\n"
+			  "\tops.\"ctl\" { info \"volsw\" get \"256\" put \"256\" }\n"
+			  "\ttlv \"vtlv\"\n"
+			  "}\n"
+			  "SectionData.\"d%d\" { bytes \"0x%02x,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a\" }\n"
+			  "SectionWidget.\"w%d\" {\n"
+			  "\tindex \"%d\"\n"
+			  "\ttype \"pga\"\n"
+			  "\tno_pm \"true\"\n"
+			  "\tmixer [\"mix%d\"]\n"
+			  "\tdata [\"d%d\"]\n"
+			  "}\n",
+			  i, i / 50, i, i, i, i % 256, i, i / 50, i, i);
+	if (err >= 0)
+		err = add(&buf, &len, &size, "SectionGraph.\"g\" { index \"0\" lines [\n");
+	for (i = 1; err >= 0 && i < objects; i++)
+		err = add(&buf, &len, &size, "\t\"w%d, , w%d\"\n", i, i - 1);
+	if (err >= 0)
+		err = add(&buf, &len, &size, "]}\n");
+	if (err < 0) {
+		free(buf);
+		return NULL;
+	}
+	*lenp = len;
+	return buf;
+}
+
+static void usage(void)
+{
+	printf("Usage: tplg-save-bench [options]\n"
+	       "  -n <count>     widgets with their control and data (default %d)\n"
+	       "  -r <count>     runs per mode (default %d)\n",
+	       objects, runs);
+}
+
+int main(int argc, char **argv)
+{
+	snd_tplg_t *tplg;
+	char *text, *out;
+	size_t len, out_len = 0;
+	double t, best;
+	long rss;
+	unsigned int m;
+	int c, i, err;
+
+	while ((c = getopt(argc, argv, "n:r:h")) >= 0) {
+		switch (c) {
+		case 'n':
+			objects = atoi(optarg);
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (objects <= 0 || runs <= 0) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	text = make_text(&len);
+	if (!text)
+		return EXIT_FAILURE;
+	tplg = snd_tplg_create(0);
+	if (!tplg)
+		return EXIT_FAILURE;
+	t = now_ms();
+	err = snd_tplg_load(tplg, text, len);
+	if (err < 0) {
+		fprintf(stderr, "snd_tplg_load: %s\n", snd_strerror(err));
+		return EXIT_FAILURE;
+	}
+	printf("%d objects, %zu bytes of text loaded in %.1f ms\n",
+	       objects, len, now_ms() - t);
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		best = 0;
+		rss = peak_rss_kb();
+		for (i = 0; i < runs; i++) {
+			t = now_ms();
+			err = snd_tplg_save(tplg, &out, modes[m].flags);
+			t = now_ms() - t;
+			if (err < 0) {
+				fprintf(stderr, "snd_tplg_save %s: %s\n",
+					modes[m].name, snd_strerror(err));
+				return EXIT_FAILURE;
+			}
+			if (i == 0)
+				rss = peak_rss_kb() - rss;
+			out_len = strlen(out);
+			free(out);
+			if (i == 0 || t < best)
+				best = t;
+		}
+		printf("  %-8s %8.1f ms  %9zu bytes  peak RSS +%ld kB\n",
+		       modes[m].name, best, out_len, rss);
+	}
+
+	snd_tplg_free(tplg);
+	free(text);
+	return EXIT_SUCCESS;
+}